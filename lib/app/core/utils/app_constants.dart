@@ -13,6 +13,12 @@ class AppConstants {
 
   // Person Detection Keys
   static const String keyPersonDetectionEnabled = 'personDetectionEnabled';
+  static const String keyMotionGateEnabled = 'motionGateEnabled';
+  static const String keyAdaptiveSchedulingEnabled =
+      'adaptiveSchedulingEnabled';
+  static const String keyTiledInferenceEnabled = 'tiledInferenceEnabled';
+  static const String keyInferenceThreadConfig = 'inferenceThreadConfig';
+  static const String keyDetectionStreamUrl = 'detectionStreamUrl';
 
   // Location Services Keys
   static const String keyLocationEnabled = 'locationEnabled';
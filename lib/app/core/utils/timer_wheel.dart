@@ -0,0 +1,142 @@
+import 'dart:async';
+import 'dart:math' as math;
+
+/// A pending callback on a [TimerWheel]
+class TimerWheelEntry {
+  final int deadlineTick;
+  final void Function() _callback;
+  bool _active = true;
+  // Collected by an advance and about to run
+  bool _due = false;
+
+  TimerWheelEntry._(this.deadlineTick, this._callback);
+
+  bool get isActive => _active;
+}
+
+/// Hashed timing wheel on a monotonic clock.
+///
+/// Entries are bucketed by deadline tick, so scheduling and cancelling are
+/// O(1) however many are pending. Nothing ticks while the wheel is idle:
+/// a single one-shot [Timer] is armed for the earliest deadline and
+/// re-armed only when that changes, so long waits cost one wakeup.
+class TimerWheel {
+  final int tickUs;
+  final List<List<TimerWheelEntry>> _slots;
+  final Stopwatch _clock = Stopwatch()..start();
+
+  int _tick = 0;
+  int _pending = 0;
+  Timer? _timer;
+  int _armedTick = -1;
+
+  TimerWheel({
+    Duration tick = const Duration(milliseconds: 1),
+    int slots = 512,
+  })  : tickUs = math.max(1, tick.inMicroseconds),
+        _slots = List.generate(slots, (_) => <TimerWheelEntry>[]);
+
+  /// Microseconds since the wheel was created
+  int get nowUs => _clock.elapsedMicroseconds;
+
+  int get pending => _pending;
+
+  /// Run [callback] once [nowUs] reaches [deadlineUs]
+  TimerWheelEntry scheduleAt(int deadlineUs, void Function() callback) {
+    // Round up so an entry never fires before its deadline, and keep it
+    // ahead of the last tick collected so the next advance visits it
+    final deadlineTick =
+        math.max(_tick + 1, (deadlineUs + tickUs - 1) ~/ tickUs);
+    final entry = TimerWheelEntry._(deadlineTick, callback);
+    _slots[deadlineTick % _slots.length].add(entry);
+    _pending++;
+    if (_armedTick < 0 || deadlineTick < _armedTick) _arm();
+    return entry;
+  }
+
+  TimerWheelEntry schedule(Duration delay, void Function() callback) {
+    return scheduleAt(nowUs + delay.inMicroseconds, callback);
+  }
+
+  void cancel(TimerWheelEntry entry) {
+    if (!entry._active) return;
+    entry._active = false;
+    if (entry._due) return;
+    _slots[entry.deadlineTick % _slots.length].remove(entry);
+    _pending--;
+    if (_pending == 0) _disarm();
+  }
+
+  /// Drop every pending entry without running it
+  void clear() {
+    for (final slot in _slots) {
+      for (final entry in slot) {
+        entry._active = false;
+      }
+      slot.clear();
+    }
+    _pending = 0;
+    _disarm();
+  }
+
+  // Collect everything due up to now. After a gap of a full revolution or
+  // more every slot is visited once rather than every tick.
+  List<TimerWheelEntry> _advance() {
+    final nowTick = nowUs ~/ tickUs;
+    final due = <TimerWheelEntry>[];
+    final steps = math.min(nowTick - _tick, _slots.length);
+    for (var i = 1; i <= steps; i++) {
+      final slot = _slots[(_tick + i) % _slots.length];
+      if (slot.isEmpty) continue;
+      slot.removeWhere((entry) {
+        if (entry.deadlineTick > nowTick) return false;
+        entry._due = true;
+        due.add(entry);
+        return true;
+      });
+    }
+    if (nowTick > _tick) _tick = nowTick;
+    _pending -= due.length;
+    return due;
+  }
+
+  void _onTimer() {
+    _timer = null;
+    _armedTick = -1;
+    final due = _advance()
+      ..sort((a, b) => a.deadlineTick.compareTo(b.deadlineTick));
+    for (final entry in due) {
+      // An earlier callback may have cancelled it
+      if (!entry._active) continue;
+      entry._active = false;
+      entry._callback();
+    }
+    if (_pending > 0 && _armedTick < 0) _arm();
+  }
+
+  void _arm() {
+    var earliest = -1;
+    for (final slot in _slots) {
+      for (final entry in slot) {
+        if (earliest < 0 || entry.deadlineTick < earliest) {
+          earliest = entry.deadlineTick;
+        }
+      }
+    }
+    _timer?.cancel();
+    if (earliest < 0) {
+      _timer = null;
+      _armedTick = -1;
+      return;
+    }
+    _armedTick = earliest;
+    final delayUs = math.max(0, earliest * tickUs - nowUs);
+    _timer = Timer(Duration(microseconds: delayUs), _onTimer);
+  }
+
+  void _disarm() {
+    _timer?.cancel();
+    _timer = null;
+    _armedTick = -1;
+  }
+}
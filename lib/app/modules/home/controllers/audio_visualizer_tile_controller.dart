@@ -1,8 +1,10 @@
+import 'package:flutter/foundation.dart';
 import 'package:flutter/material.dart';
 import 'package:get/get.dart';
 import 'package:media_kit/media_kit.dart';
 import 'dart:async';
-import 'dart:math' as math;
+import 'dart:typed_data';
+import '../../../services/native_audio_spectrum.dart';
 import '../widgets/media_tile.dart'; // Import to reuse the PlayerManager
 
 /// Controller for AudioVisualizerTile to replace StatefulWidget state management
@@ -21,14 +23,20 @@ class AudioVisualizerTileController extends GetxController
   late final PlayerWithController _playerData;
   late AnimationController visualizerController;
   late AnimationController colorController;
-  Timer? _animationTimer;
   StreamSubscription<Duration>? _positionSubscription;
   StreamSubscription<bool>? _playingSubscription;
 
-  // Frequency data simulation
-  final frequencyData = <double>[].obs;
-  static const int _frequencyBars = 64;
-  final math.Random _random = math.Random();
+  // Spectrum from the native analyzer: [barCount] levels followed by
+  // [barCount] peaks. Painted straight from the notifier, so new frames
+  // repaint the bars without rebuilding any widgets.
+  static const int barCount = 64;
+  static const double _spectrumFps = 30;
+  NativeSpectrum? _spectrum;
+  bool _spectrumDisposed = false;
+  // Keeps analyzing briefly after a pause so the bars fall instead of
+  // freezing.
+  Timer? _spectrumIdleTimer;
+  static const Duration _spectrumFallTime = Duration(seconds: 1);
 
   // Color cycling for the visualizer
   final List<Color> _visualizerColors = [
@@ -54,7 +62,7 @@ class AudioVisualizerTileController extends GetxController
     super.onInit();
     WidgetsBinding.instance.addObserver(this);
     _initializeAnimationControllers();
-    _initializeFrequencyData();
+    _initializeSpectrum();
     initializePlayer();
   }
 
@@ -82,9 +90,19 @@ class AudioVisualizerTileController extends GetxController
     )..repeat();
   }
 
-  void _initializeFrequencyData() {
-    frequencyData.value = List.generate(_frequencyBars, (index) => 0.0);
-    _startVisualizerAnimation();
+  Future<void> _initializeSpectrum() async {
+    final spectrum =
+        await NativeAudioSpectrum.create(bars: barCount, fps: _spectrumFps);
+    if (spectrum == null) return;
+    if (_spectrumDisposed) {
+      NativeAudioSpectrum.dispose(spectrum);
+      return;
+    }
+    _spectrum = spectrum;
+    spectrumFrame.value = spectrum.frame;
+    if (!isPlaying.value) {
+      _stopVisualizerAnimation();
+    }
   }
 
   Future<void> initializePlayer() async {
@@ -157,45 +175,20 @@ class AudioVisualizerTileController extends GetxController
   }
 
   void _startVisualizerAnimation() {
-    _animationTimer?.cancel();
-    _animationTimer = Timer.periodic(Duration(milliseconds: 100), (timer) {
-      _updateFrequencyData();
-    });
-  }
-
-  void _stopVisualizerAnimation() {
-    _animationTimer?.cancel();
-    // Gradually fade out the bars
-    for (int i = 0; i < frequencyData.length; i++) {
-      frequencyData[i] = math.max(0.0, frequencyData[i] - 0.1);
+    _spectrumIdleTimer?.cancel();
+    final spectrum = _spectrum;
+    if (spectrum != null) {
+      NativeAudioSpectrum.setActive(spectrum, true);
     }
-    frequencyData.refresh(); // Trigger UI update
   }
 
-  void _updateFrequencyData() {
-    // Simulate frequency data based on audio (since we don't have real FFT data)
-    final newData = <double>[];
-
-    for (int i = 0; i < _frequencyBars; i++) {
-      // Create more realistic frequency distribution
-      // Lower frequencies (bass) should be more prominent
-      final bassWeight = i < _frequencyBars * 0.2 ? 1.5 : 1.0;
-      final midWeight =
-          i >= _frequencyBars * 0.2 && i < _frequencyBars * 0.6 ? 1.2 : 1.0;
-      final trebleWeight = i >= _frequencyBars * 0.6 ? 0.8 : 1.0;
-
-      final baseAmplitude =
-          _random.nextDouble() * bassWeight * midWeight * trebleWeight;
-
-      // Add some momentum to make animation smoother
-      final currentValue = frequencyData.length > i ? frequencyData[i] : 0.0;
-      final targetValue = math.min(1.0, baseAmplitude);
-      final smoothedValue = currentValue + (targetValue - currentValue) * 0.3;
-
-      newData.add(smoothedValue);
-    }
-
-    frequencyData.value = newData;
+  void _stopVisualizerAnimation() {
+    _spectrumIdleTimer?.cancel();
+    final spectrum = _spectrum;
+    if (spectrum == null) return;
+    _spectrumIdleTimer = Timer(_spectrumFallTime, () {
+      NativeAudioSpectrum.setActive(spectrum, false);
+    });
   }
 
   void _handleLifecycleChange(AppLifecycleState state) {
@@ -233,7 +226,13 @@ class AudioVisualizerTileController extends GetxController
     }
 
     // Cancel timers and subscriptions
-    _animationTimer?.cancel();
+    _spectrumIdleTimer?.cancel();
+    _spectrumDisposed = true;
+    final spectrum = _spectrum;
+    _spectrum = null;
+    if (spectrum != null) {
+      NativeAudioSpectrum.dispose(spectrum);
+    }
     _positionSubscription?.cancel();
     _playingSubscription?.cancel();
 
@@ -278,7 +277,7 @@ class AudioVisualizerTileController extends GetxController
       _playerData.player.stop();
       // The listener will update isPlaying.value, but set it here for immediate UI response
       isPlaying.value = false;
-      // Clear the frequency data when stopped
+      // Let the bars fall, then stop analyzing
       _stopVisualizerAnimation();
     }
   }
@@ -286,6 +285,12 @@ class AudioVisualizerTileController extends GetxController
   // Changed to reactive property
   final isPlaying = false.obs;
 
+  /// Bars to paint: live frames once the native analyzer is up, otherwise
+  /// a flat spectrum. Only this reference is observed; the frames repaint
+  /// through the notifier itself.
+  final spectrumFrame = Rx<ValueListenable<Float32List>>(
+      ValueNotifier(Float32List(barCount * 2)));
+
   Color getCurrentVisualizerColor() {
     final progress = colorController.value;
     final colorIndex = (progress * _visualizerColors.length).floor();
@@ -1,3 +1,4 @@
+import 'dart:async';
 import 'package:flutter/material.dart';
 import 'package:get/get.dart';
 import 'package:media_kit/media_kit.dart';
@@ -16,7 +17,11 @@ class MediaTileController extends GetxController with WidgetsBindingObserver {
   final errorMessage = ''.obs;
   final position = Duration.zero.obs;
 
-  late final PlayerWithController _playerData;
+  // The player this controller opened [url] on. The manager owns it and
+  // may hand it to another URL once the last window showing this one
+  // closes, so it is only used while the manager still holds it for [url].
+  PlayerWithController? _playerData;
+  StreamSubscription<Duration>? _positionSubscription;
 
   MediaTileController({
     required this.url,
@@ -45,28 +50,30 @@ class MediaTileController extends GetxController with WidgetsBindingObserver {
   /// Initialize the media player with reactive updates
   Future<void> _initializePlayer() async {
     try {
-      _playerData = MediaPlayerManager().getPlayerFor(url);
+      final playerData = MediaPlayerManager().getPlayerFor(url);
+      _playerData = playerData;
 
-      if (_playerData.isInitialized) {
+      // Set up position listener
+      await _positionSubscription?.cancel();
+      _positionSubscription = playerData.player.streams.position.listen((pos) {
+        position.value = pos;
+      });
+
+      if (playerData.isInitialized) {
         // If already initialized, just update our state reactively
         isInitialized.value = true;
         return;
       }
 
-      // Set up position listener
-      _playerData.player.streams.position.listen((pos) {
-        position.value = pos;
-      });
-
       // Open media
-      await _playerData.player.open(Media(url));
+      await playerData.player.open(Media(url));
 
       // Set playlist mode
       try {
         if (loop) {
-          await _playerData.player.setPlaylistMode(PlaylistMode.loop);
+          await playerData.player.setPlaylistMode(PlaylistMode.loop);
         } else {
-          await _playerData.player.setPlaylistMode(PlaylistMode.none);
+          await playerData.player.setPlaylistMode(PlaylistMode.none);
         }
       } catch (e) {
         print('Warning: Could not set playlist mode: $e');
@@ -74,7 +81,7 @@ class MediaTileController extends GetxController with WidgetsBindingObserver {
       }
 
       // Mark as initialized
-      _playerData.isInitialized = true;
+      playerData.isInitialized = true;
       isInitialized.value = true; // Reactive update
     } catch (error) {
       print('Error initializing video player: $error');
@@ -89,20 +96,23 @@ class MediaTileController extends GetxController with WidgetsBindingObserver {
         // try to recreate the player with new settings
         if (hardwareDetectionService.hasDetectedIssue.value) {
           print('Hardware issue detected, recreating player with new settings');
-          // Force manager to dispose and recreate this player
-          MediaPlayerManager().disposePlayerFor(url);
+          // Force manager to dispose and recreate this player; idle
+          // players were made with the old settings too
+          MediaPlayerManager().disposePlayerFor(url, force: true);
+          MediaPlayerManager().flushPool();
           // Get a new player with updated hardware settings
-          _playerData = MediaPlayerManager().getPlayerFor(url);
+          final playerData = MediaPlayerManager().getPlayerFor(url);
+          _playerData = playerData;
 
           // Try to initialize again with new settings
-          await _playerData.player.open(Media(url));
+          await playerData.player.open(Media(url));
 
           if (loop) {
-            await _playerData.player.setPlaylistMode(PlaylistMode.loop);
+            await playerData.player.setPlaylistMode(PlaylistMode.loop);
           }
 
           // If we got here, the player was successfully recreated with new settings
-          _playerData.isInitialized = true;
+          playerData.isInitialized = true;
           isInitialized.value = true;
           hasError.value = false;
           return;
@@ -117,11 +127,37 @@ class MediaTileController extends GetxController with WidgetsBindingObserver {
     }
   }
 
+  /// Whether the player this controller opened [url] on is still the one
+  /// the manager holds for it. It is not after the tile was closed and
+  /// reopened (the old player went back to the pool, possibly to another
+  /// URL) or after recovery recreated it.
+  bool get hasCurrentPlayer {
+    final playerData = _playerData;
+    return playerData != null &&
+        identical(MediaPlayerManager().playerFor(url), playerData);
+  }
+
+  /// Open [url] again on the manager's current player if it changed under
+  /// this controller; GetX keeps the controller for a tag across tiles
+  void syncPlayer() {
+    if (hasCurrentPlayer || hasError.value) return;
+    // Not during the build that noticed it
+    WidgetsBinding.instance.addPostFrameCallback((_) {
+      if (hasCurrentPlayer || hasError.value) return;
+      print('Player for $url changed, reopening media');
+      isInitialized.value = false;
+      position.value = Duration.zero;
+      _initializePlayer();
+    });
+  }
+
   /// Handle app lifecycle changes
   void handleLifecycleChange(AppLifecycleState state) {
-    if (state == AppLifecycleState.resumed && isInitialized.value) {
+    if (state == AppLifecycleState.resumed &&
+        isInitialized.value &&
+        hasCurrentPlayer) {
       // Resume from the saved position when app comes back to foreground
-      _playerData.player.seek(position.value);
+      _playerData!.player.seek(position.value);
     } else if (state == AppLifecycleState.paused) {
       // Position is already being tracked via the stream listener
     }
@@ -143,6 +179,7 @@ class MediaTileController extends GetxController with WidgetsBindingObserver {
       final currentSetting =
           hardwareDetectionService.isHardwareAccelerationEnabled.value;
       hardwareDetectionService.toggleHardwareAcceleration(!currentSetting);
+      MediaPlayerManager().flushPool();
 
       // Force reload
       hasError.value = false;
@@ -180,32 +217,22 @@ class MediaTileController extends GetxController with WidgetsBindingObserver {
     }
   }
 
-  /// Cleanup resources
+  /// Cleanup resources. The player itself belongs to MediaPlayerManager,
+  /// which stops it when the last window showing [url] releases it; it may
+  /// already be serving another URL from the idle pool, so leave it alone.
   void _cleanup() {
     try {
-      // Check if player is already disposed
-      bool isDisposed = false;
-      try {
-        final _ = _playerData.player.state.playing;
-      } catch (e) {
-        if (e.toString().contains('Player has been disposed')) {
-          isDisposed = true;
-          print('Player for $url was already disposed in MediaTileController');
-        }
-      }
-
-      if (!isDisposed) {
-        _playerData.player.pause();
-        print('MediaTileController for $url disposed');
-      }
+      _positionSubscription?.cancel();
+      _positionSubscription = null;
+      print('MediaTileController for $url disposed');
     } catch (e) {
       print('Error cleaning up MediaTileController resources: $e');
     }
   }
 
   /// Get the player controller for the video widget
-  VideoController get videoController => _playerData.controller;
+  VideoController get videoController => _playerData!.controller;
 
   /// Get the player for direct access
-  Player get player => _playerData.player;
+  Player get player => _playerData!.player;
 }
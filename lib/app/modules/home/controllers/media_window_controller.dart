@@ -7,14 +7,23 @@ class MediaWindowController extends KioskWindowController {
   final String windowName;
   @override
   KioskWindowType get windowType => KioskWindowType.media;
-  final PlayerWithController playerData;
+  final String url;
   final void Function()? onClose;
+  bool _released = false;
 
+  /// Holds a reference to the player for [url] until the window closes;
+  /// windows mirroring the same URL share that player, so play/pause
+  /// applies to all of them
   MediaWindowController({
     required this.windowName,
-    required this.playerData,
+    required this.url,
     this.onClose,
-  });
+  }) {
+    MediaPlayerManager().acquire(url);
+  }
+
+  PlayerWithController get playerData =>
+      MediaPlayerManager().getPlayerFor(url);
 
   @override
   void handleCommand(String action, Map<String, dynamic>? payload) {
@@ -35,19 +44,13 @@ class MediaWindowController extends KioskWindowController {
   @override
   void disposeWindow() {
     try {
-      // Stop the player first to release hardware resources immediately
-      playerData.player.stop();
-      
-      // Dispose with a short delay to prevent race conditions
-      Future.delayed(Duration(milliseconds: 50), () {
-        try {
-          playerData.player.dispose();
-          print('Player disposed for media window: $windowName');
-        } catch (e) {
-          print('Error in delayed player disposal: $e');
-        }
-      });
-      
+      // The player stops once no other window shows it
+      if (!_released) {
+        _released = true;
+        MediaPlayerManager().release(url);
+        print('Player released for media window: $windowName');
+      }
+
       if (onClose != null) onClose!();
     } catch (e) {
       print('Error disposing media window: $e');
@@ -344,10 +344,9 @@ class TilingWindowController extends GetxController {
 
         case TileType.media:
           // Register MediaWindowController for media tiles
-          final playerData = MediaPlayerManager().getPlayerFor(tile.url);
           final controller = MediaWindowController(
             windowName: tile.id,
-            playerData: playerData,
+            url: tile.url,
             onClose: () {
               Get.find<WindowManagerService>().unregisterWindow(tile.id);
             },
@@ -562,10 +561,9 @@ class TilingWindowController extends GetxController {
     selectedTile.value = newTile;
 
     // --- Register MediaWindowController for MQTT/media control ---
-    final playerData = MediaPlayerManager().getPlayerFor(url);
     final controller = MediaWindowController(
       windowName: newTile.id, // Use unique tile ID for MQTT routing
-      playerData: playerData,
+      url: url,
       onClose: () {
         Get.find<WindowManagerService>().unregisterWindow(newTile.id);
       },
@@ -687,10 +685,9 @@ class TilingWindowController extends GetxController {
       _layout.applyLayout(_containerBounds);
     }
     selectedTile.value = newTile;
-    final playerData = MediaPlayerManager().getPlayerFor(url);
     final controller = MediaWindowController(
       windowName: newTile.id,
-      playerData: playerData,
+      url: url,
       onClose: () {
         Get.find<WindowManagerService>().unregisterWindow(newTile.id);
       },
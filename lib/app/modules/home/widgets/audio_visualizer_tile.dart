@@ -1,3 +1,5 @@
+import 'dart:typed_data';
+import 'package:flutter/foundation.dart';
 import 'package:flutter/material.dart';
 import 'package:get/get.dart';
 import '../controllers/audio_visualizer_tile_controller.dart';
@@ -226,11 +228,14 @@ class _AudioVisualizerTileState extends State<AudioVisualizerTile> {
   }
 
   Widget _buildFrequencyBars(AudioVisualizerTileController controller) {
+    // Rebuilt only when the native analyzer comes up; frames and the color
+    // cycle repaint through the painter's listenable.
     return Obx(() => CustomPaint(
           painter: FrequencyBarsPainter(
-            frequencyData: List<double>.from(
-                controller.frequencyData), // Convert RxList to List
-            color: controller.getCurrentVisualizerColor(),
+            frame: controller.spectrumFrame.value,
+            bars: AudioVisualizerTileController.barCount,
+            colorController: controller.colorController,
+            colorOf: controller.getCurrentVisualizerColor,
           ),
           size: Size.infinite,
         ));
@@ -319,54 +324,72 @@ class _AudioVisualizerTileState extends State<AudioVisualizerTile> {
 
 /// Custom painter for frequency visualization bars
 class FrequencyBarsPainter extends CustomPainter {
-  final List<double> frequencyData;
-  final Color color;
+  /// [bars] levels followed by [bars] peak levels, 0..1
+  final ValueListenable<Float32List> frame;
+  final int bars;
+  final Animation<double> colorController;
+  final Color Function() colorOf;
 
   FrequencyBarsPainter({
-    required this.frequencyData,
-    required this.color,
-  });
+    required this.frame,
+    required this.bars,
+    required this.colorController,
+    required this.colorOf,
+  }) : super(repaint: Listenable.merge([frame, colorController]));
 
   @override
   void paint(Canvas canvas, Size size) {
-    if (frequencyData.isEmpty) return;
+    final data = frame.value;
+    if (bars == 0 || data.length < bars * 2) return;
 
+    final color = colorOf();
     final paint = Paint()
       ..style = PaintingStyle.fill
       ..strokeWidth = 1;
+    final peakPaint = Paint()..color = color.withOpacity(0.9);
 
-    final barWidth = size.width / frequencyData.length;
+    final barWidth = size.width / bars;
     final centerY = size.height / 2;
+    final maxHeight = size.height * 0.4;
 
-    for (int i = 0; i < frequencyData.length; i++) {
-      final barHeight = frequencyData[i] * (size.height * 0.4);
-      final x = i * barWidth;
-
-      // Create gradient for each bar
-      final gradient = LinearGradient(
-        begin: Alignment.bottomCenter,
-        end: Alignment.topCenter,
-        colors: [
-          color,
-          color.withOpacity(0.3),
-        ],
-      );
+    // Bars share one gradient spanning the tallest possible bar.
+    paint.shader = LinearGradient(
+      begin: Alignment.bottomCenter,
+      end: Alignment.topCenter,
+      colors: [
+        color,
+        color.withOpacity(0.3),
+      ],
+    ).createShader(
+      Rect.fromLTWH(0, centerY - maxHeight, size.width, maxHeight * 2),
+    );
 
-      paint.shader = gradient.createShader(
-        Rect.fromLTWH(x, centerY - barHeight, barWidth - 2, barHeight * 2),
-      );
+    for (int i = 0; i < bars; i++) {
+      final barHeight = data[i] * maxHeight;
+      final x = i * barWidth;
 
       // Draw the bar (mirrored top and bottom)
       canvas.drawRect(
         Rect.fromLTWH(x, centerY - barHeight, barWidth - 2, barHeight * 2),
         paint,
       );
+
+      final peakHeight = data[bars + i] * maxHeight;
+      if (peakHeight > barHeight + 1) {
+        canvas.drawRect(
+          Rect.fromLTWH(x, centerY - peakHeight - 2, barWidth - 2, 2),
+          peakPaint,
+        );
+        canvas.drawRect(
+          Rect.fromLTWH(x, centerY + peakHeight, barWidth - 2, 2),
+          peakPaint,
+        );
+      }
     }
   }
 
   @override
   bool shouldRepaint(FrequencyBarsPainter oldDelegate) {
-    return frequencyData != oldDelegate.frequencyData ||
-        color != oldDelegate.color;
+    return frame != oldDelegate.frame || bars != oldDelegate.bars;
   }
 }
@@ -6,7 +6,16 @@ import 'package:get/get.dart';
 import '../../../services/media_hardware_detection.dart';
 import '../controllers/media_tile_controller.dart';
 
-// Player manager to keep players persistent across rebuilds
+// Player manager to keep players persistent across rebuilds.
+//
+// There is one player per URL: tiles mirroring the same source show the
+// same video texture, so a stream is pulled and decoded once however many
+// tiles display it, and each tile scales the texture on the GPU. Tiles hold
+// a reference through [acquire]/[release]; when the last one goes, the
+// player is stopped and parked in a small pool of idle players, which new
+// media tiles take instead of starting mpv from scratch. Audio tiles use
+// [getPlayerFor] alone and get plain players, so audio-only layouts never
+// create the pool.
 class MediaPlayerManager {
   static final MediaPlayerManager _instance = MediaPlayerManager._internal();
 
@@ -34,27 +43,166 @@ class MediaPlayerManager {
   Timer? _cleanupTimer;
   final Map<String, DateTime> _lastAccessTime = {};
 
+  // Tiles currently showing each URL
+  final Map<String, int> _refCounts = {};
+  // Idle players, created with the acceleration setting they were made for
+  final List<_PooledPlayer> _pool = [];
+  static const int _poolSize = 2;
+  bool _refillScheduled = false;
+
+  /// Take a reference to the shared player for [url], creating it if this
+  /// is the first tile showing it
+  PlayerWithController acquire(String url) {
+    _refCounts[url] = (_refCounts[url] ?? 0) + 1;
+    if (!_players.containsKey(url)) {
+      _players[url] = _takePooled() ?? _createPlayer();
+      _schedulePoolRefill();
+    }
+    return getPlayerFor(url);
+  }
+
+  /// Drop a tile's reference; the last one stops the player and returns it
+  /// to the idle pool
+  void release(String url) {
+    final refs = (_refCounts[url] ?? 0) - 1;
+    if (refs > 0) {
+      _refCounts[url] = refs;
+      return;
+    }
+    _refCounts.remove(url);
+    final playerData = _players.remove(url);
+    _lastAccessTime.remove(url);
+    if (playerData != null) {
+      _recycle(playerData);
+    }
+  }
+
+  /// Number of tiles sharing the player for [url]
+  int refCount(String url) => _refCounts[url] ?? 0;
+
+  /// The player currently held for [url], without creating one
+  PlayerWithController? playerFor(String url) => _players[url];
+
   PlayerWithController getPlayerFor(String url) {
     // Update last access time when player is requested
     _lastAccessTime[url] = DateTime.now();
 
-    if (!_players.containsKey(url)) {
-      // Get hardware acceleration configuration
+    // Unpooled: only media tiles, through [acquire], use the pool
+    return _players.putIfAbsent(url, _createPlayer);
+  }
+
+  PlayerWithController _createPlayer() {
+    // Get hardware acceleration configuration
+    final hardwareDetectionService = Get.find<MediaHardwareDetectionService>();
+    final playerConfig = hardwareDetectionService.getPlayerConfiguration();
+
+    // Create player with the configuration
+    final player = Player(configuration: playerConfig);
+    final controller = VideoController(player);
+    return PlayerWithController(player, controller);
+  }
+
+  /// An idle player matching the current acceleration setting, if any. A
+  /// pending one-off override always gets a fresh player.
+  PlayerWithController? _takePooled() {
+    final hardwareDetectionService = Get.find<MediaHardwareDetectionService>();
+    if (hardwareDetectionService.hasTemporaryOverride) return null;
+    final hardwareAccel =
+        hardwareDetectionService.isHardwareAccelerationEnabled.value;
+    while (_pool.isNotEmpty) {
+      final pooled = _pool.removeLast();
+      if (pooled.hardwareAccel == hardwareAccel &&
+          !_isDisposed(pooled.player)) {
+        return PlayerWithController(pooled.player, pooled.controller);
+      }
+      _disposeQuietly(pooled.player);
+    }
+    return null;
+  }
+
+  void _recycle(PlayerWithController playerData) {
+    final hardwareDetectionService = Get.find<MediaHardwareDetectionService>();
+    if (_isDisposed(playerData.player)) return;
+    if (_pool.length >= _poolSize ||
+        hardwareDetectionService.hasDetectedIssue.value) {
+      try {
+        playerData.player.stop();
+      } catch (e) {
+        print('Error stopping released player: $e');
+      }
+      Future.delayed(Duration(milliseconds: 100), () {
+        _disposeQuietly(playerData.player);
+      });
+      return;
+    }
+    try {
+      playerData.player.stop();
+      _pool.add(_PooledPlayer(
+        playerData.player,
+        playerData.controller,
+        hardwareDetectionService.isHardwareAccelerationEnabled.value,
+      ));
+    } catch (e) {
+      print('Error parking released player: $e');
+      _disposeQuietly(playerData.player);
+    }
+  }
+
+  /// Top the idle pool up outside the frame that just took a player
+  void _schedulePoolRefill() {
+    if (_refillScheduled) return;
+    _refillScheduled = true;
+    Future.delayed(Duration(milliseconds: 500), () {
+      _refillScheduled = false;
       final hardwareDetectionService =
           Get.find<MediaHardwareDetectionService>();
-      final playerConfig = hardwareDetectionService.getPlayerConfiguration();
+      // Creating one now would consume the override meant for a tile
+      if (hardwareDetectionService.hasTemporaryOverride) return;
+      while (_pool.length < _poolSize) {
+        final playerData = _createPlayer();
+        _pool.add(_PooledPlayer(
+          playerData.player,
+          playerData.controller,
+          hardwareDetectionService.isHardwareAccelerationEnabled.value,
+        ));
+      }
+    });
+  }
+
+  /// Dispose idle players, e.g. after the acceleration setting changed
+  void flushPool() {
+    for (final pooled in _pool) {
+      _disposeQuietly(pooled.player);
+    }
+    _pool.clear();
+  }
 
-      // Create player with the configuration
-      final player = Player(configuration: playerConfig);
-      final controller = VideoController(player);
-      _players[url] = PlayerWithController(player, controller);
+  bool _isDisposed(Player player) {
+    try {
+      final _ = player.state.playing;
+      return false;
+    } catch (e) {
+      return e.toString().contains('Player has been disposed');
     }
-    return _players[url]!;
   }
 
-  /// Safely dispose a specific player by URL
+  void _disposeQuietly(Player player) {
+    try {
+      if (!_isDisposed(player)) player.dispose();
+    } catch (e) {
+      print('Error disposing idle player: $e');
+    }
+  }
+
+  /// Safely dispose a specific player by URL. A player still shared by
+  /// other tiles is kept unless [force] is set (e.g. to recreate it with
+  /// new decoder settings).
   /// Returns true if a player was found and disposed
-  bool disposePlayerFor(String url) {
+  bool disposePlayerFor(String url, {bool force = false}) {
+    if (!force && refCount(url) > 0) {
+      print('Player for $url is still shown by ${refCount(url)} tile(s)');
+      return false;
+    }
     if (_players.containsKey(url)) {
       try {
         final playerData = _players[url]!;
@@ -129,12 +277,17 @@ class MediaPlayerManager {
     }
     _players.clear();
     _lastAccessTime.clear();
+    _refCounts.clear();
+    flushPool();
     _cleanupTimer?.cancel();
   }
 
   /// Force cleanup all players and reset the manager
   /// Use this when black screens start appearing, or device seems unstable
   void resetAllPlayers() {
+    // Idle players are suspect too
+    flushPool();
+
     // Make a copy of URLs to avoid modification during iteration
     final urls = List<String>.from(_players.keys);
 
@@ -214,8 +367,10 @@ class MediaPlayerManager {
     final now = DateTime.now();
     final urlsToRemove = <String>[];
 
-    // Find players that haven't been used in the last 10 minutes
+    // Find players that haven't been used in the last 10 minutes and that
+    // no tile is showing
     for (final url in _players.keys) {
+      if (refCount(url) > 0) continue;
       final lastAccess = _lastAccessTime[url] ?? now;
       if (now.difference(lastAccess).inMinutes > 10) {
         urlsToRemove.add(url);
@@ -249,6 +404,14 @@ class MediaPlayerManager {
   }
 }
 
+class _PooledPlayer {
+  final Player player;
+  final VideoController controller;
+  final bool hardwareAccel;
+
+  _PooledPlayer(this.player, this.controller, this.hardwareAccel);
+}
+
 class PlayerWithController {
   final Player player;
   final VideoController controller;
@@ -274,13 +437,15 @@ class MediaTile extends GetView<MediaTileController> {
   Widget build(BuildContext context) {
     // Initialize controller with URL-specific tag
     Get.put(MediaTileController(url: url, loop: loop), tag: tag);
+    // The controller outlives closed tiles; its player may not have
+    controller.syncPlayer();
 
     return Obx(() {
       if (controller.hasError.value) {
         return _buildErrorWidget();
       }
 
-      if (!controller.isInitialized.value) {
+      if (!controller.isInitialized.value || !controller.hasCurrentPlayer) {
         return _buildLoadingWidget();
       }
 
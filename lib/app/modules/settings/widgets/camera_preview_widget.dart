@@ -3,6 +3,7 @@ import 'package:flutter/material.dart';
 import 'package:flutter_webrtc/flutter_webrtc.dart' as webrtc;
 import 'package:get/get.dart';
 import '../../../core/utils/permissions_manager.dart';
+import '../../../services/native_camera_capture.dart';
 import '../../../services/person_detection_service.dart';
 
 /// Camera resolution modes for different use cases
@@ -43,6 +44,11 @@ class _CameraPreviewWidgetState extends State<CameraPreviewWidget> {
   bool _permissionDenied = false; // Track permission denial
   String _errorMessage = '';
 
+  // Linux: the camera is shared with person detection through the native
+  // camera hub and shown in a texture, instead of opening it a second time
+  final _nativeCapture = NativeCameraCapture();
+  NativeCameraPreview? _nativePreview;
+
   @override
   void initState() {
     super.initState();
@@ -128,7 +134,34 @@ class _CameraPreviewWidgetState extends State<CameraPreviewWidget> {
     await _startCamera();
   }
 
+  /// Show the camera through the native hub. Returns false when that is
+  /// unavailable, so the WebRTC path is used instead.
+  Future<bool> _startNativePreview() async {
+    if (!NativeCameraCapture.isSupported) return false;
+    final dpr = MediaQuery.of(context).devicePixelRatio;
+    final publishWidth = (widget.width * dpr).round().clamp(160, 640);
+    final preview = await _nativeCapture.acquirePreview(
+      deviceId: widget.deviceId.isNotEmpty ? widget.deviceId : null,
+      publishWidth: publishWidth,
+      publishHeight: publishWidth * 3 ~/ 4,
+    );
+    if (preview == null) return false;
+    if (!mounted) {
+      await _nativeCapture.releasePreview(preview);
+      return true;
+    }
+    print('[CameraPreviewWidget] Using native camera hub preview.');
+    setState(() {
+      _nativePreview = preview;
+      _isInitialized = true;
+      _permissionDenied = false;
+      _errorMessage = '';
+    });
+    return true;
+  }
+
   Future<void> _startCamera() async {
+    if (await _startNativePreview()) return;
     try {
       // Check if PersonDetectionService is active and has a camera stream
       final personDetectionService = Get.isRegistered<PersonDetectionService>()
@@ -213,6 +246,11 @@ class _CameraPreviewWidgetState extends State<CameraPreviewWidget> {
 
   void _disposeStream() {
     _retryTimer?.cancel();
+    final nativePreview = _nativePreview;
+    if (nativePreview != null) {
+      _nativePreview = null;
+      _nativeCapture.releasePreview(nativePreview);
+    }
     // Prevent disposing the shared stream used by PersonDetectionService
     try {
       final personDetectionService = Get.isRegistered<PersonDetectionService>()
@@ -274,6 +312,11 @@ class _CameraPreviewWidgetState extends State<CameraPreviewWidget> {
       return _buildErrorWidget(context);
     }
 
+    final nativePreview = _nativePreview;
+    if (nativePreview != null) {
+      return _buildNativePreview(nativePreview);
+    }
+
     return webrtc.RTCVideoView(
       _localRenderer,
       objectFit: widget.fit == BoxFit.contain
@@ -283,6 +326,23 @@ class _CameraPreviewWidgetState extends State<CameraPreviewWidget> {
     );
   }
 
+  Widget _buildNativePreview(NativeCameraPreview preview) {
+    // Mirrored like the WebRTC view; the frame keeps the capture aspect
+    return Transform(
+      alignment: Alignment.center,
+      transform: Matrix4.diagonal3Values(-1, 1, 1),
+      child: FittedBox(
+        fit: widget.fit,
+        clipBehavior: Clip.hardEdge,
+        child: SizedBox(
+          width: widget.width,
+          height: widget.width / preview.aspectRatio,
+          child: Texture(textureId: preview.textureId),
+        ),
+      ),
+    );
+  }
+
   Widget _buildPermissionDeniedWidget(BuildContext context) {
     final isPermanentlyDenied = _errorMessage.contains('permanently denied');
 
@@ -3,6 +3,7 @@ import 'dart:typed_data';
 import 'package:flutter/material.dart';
 import 'package:get/get.dart';
 import '../../../services/person_detection_service.dart';
+import '../../../services/webrtc_texture_bridge.dart';
 import '../controllers/dynamic_bounding_box_controller.dart';
 
 class PersonDetectionDebugWidget extends StatelessWidget {
@@ -416,8 +417,9 @@ class PersonDetectionDebugWidget extends StatelessWidget {
   }
 
   Widget _buildMLStatusInfo(PersonDetectionService service) {
-    final hasOutput = service.debugVisualizationFrame.value != null &&
-        service.debugVisualizationFrame.value!.isNotEmpty;
+    final hasOutput = service.isNativePreviewActive.value ||
+        (service.debugVisualizationFrame.value != null &&
+            service.debugVisualizationFrame.value!.isNotEmpty);
 
     return Container(
       padding: EdgeInsets.all(8),
@@ -525,13 +527,23 @@ class PersonDetectionDebugWidget extends StatelessWidget {
           ),
         ),
         Expanded(
-          child: _buildFrameDisplay(
-            service.rawCapturedFrame.value,
-            'No frame captured',
-            'Waiting for WebRTC frame...',
-            Icons.camera_alt,
-            Colors.blue.shade300,
-          ),
+          child: Obx(() {
+            final texture = service.rawPreviewTexture.value;
+            if (service.isNativePreviewActive.value && texture != null) {
+              return _buildTextureDisplay(
+                texture,
+                service.nativePreviewAspectRatio.value,
+                Colors.blue.shade300,
+              );
+            }
+            return _buildFrameDisplay(
+              service.rawCapturedFrame.value,
+              'No frame captured',
+              'Waiting for WebRTC frame...',
+              Icons.camera_alt,
+              Colors.blue.shade300,
+            );
+          }),
         ),
       ],
     );
@@ -580,12 +592,46 @@ class PersonDetectionDebugWidget extends StatelessWidget {
           ),
         ),
         Expanded(
-          child: _buildMLAnalysisDisplay(service, context),
+          child: Obx(() {
+            final texture = service.debugPreviewTexture.value;
+            if (service.isNativePreviewActive.value && texture != null) {
+              // Boxes and labels are drawn into the texture natively
+              return _buildTextureDisplay(
+                texture,
+                service.nativePreviewAspectRatio.value,
+                Colors.purple.shade300,
+              );
+            }
+            return _buildMLAnalysisDisplay(service, context);
+          }),
         ),
       ],
     );
   }
 
+  /// Live native texture; the frames never pass through Dart
+  Widget _buildTextureDisplay(
+    NativePreviewTexture texture,
+    double aspectRatio,
+    Color borderColor,
+  ) {
+    return Container(
+      decoration: BoxDecoration(
+        border: Border.all(color: borderColor),
+        borderRadius: BorderRadius.circular(8),
+      ),
+      child: ClipRRect(
+        borderRadius: BorderRadius.circular(8),
+        child: Center(
+          child: AspectRatio(
+            aspectRatio: aspectRatio,
+            child: Texture(textureId: texture.textureId),
+          ),
+        ),
+      ),
+    );
+  }
+
   Widget _buildFrameDisplay(
     String? frameData,
     String noDataText,
@@ -1,9 +1,11 @@
+import 'dart:async';
 import 'package:flutter/material.dart';
 import 'package:get/get.dart';
 import 'package:sip_ua/sip_ua.dart';
 import '../services/storage_service.dart';
 import '../core/utils/app_constants.dart';
 import '../services/sip_service.dart';
+import 'native_wyoming_client.dart';
 
 /// Service for handling AI assistant calls
 class AiAssistantService extends GetxService {
@@ -17,6 +19,16 @@ class AiAssistantService extends GetxService {
   final isAiCallActive = false.obs;
   final aiCallState = ''.obs;
 
+  // Wyoming voice satellite (native client on Linux)
+  final isWyomingEnabled = false.obs;
+  final wyomingHost = ''.obs;
+  final wyomingPort = 10700.obs;
+  final wyomingState = 'stopped'.obs;
+  final lastTranscript = ''.obs;
+  // End of speech to the first reply audio being heard
+  final lastResponseLatencyMs = 0.0.obs;
+  StreamSubscription<WyomingClientEvent>? _wyomingSubscription;
+
   // Constructor
   AiAssistantService(this._sipService, this._storageService) {
     // Load settings
@@ -56,6 +68,8 @@ class AiAssistantService extends GetxService {
         }, condition: (registered) => registered == true);
       }
 
+      await _applyWyomingSettings();
+
       debugPrint('AI Assistant Service initialized successfully');
       return this;
     } catch (e) {
@@ -70,11 +84,65 @@ class AiAssistantService extends GetxService {
         _storageService.read<bool>(AppConstants.keyAiEnabled) ?? false;
     aiProviderHost.value =
         _storageService.read<String>(AppConstants.keyAiProviderHost) ?? '';
+    isWyomingEnabled.value =
+        _storageService.read<bool>(AppConstants.keyWyomingEnabled) ?? false;
+    wyomingHost.value =
+        _storageService.read<String>(AppConstants.keyWyomingHost) ?? '';
+    wyomingPort.value =
+        _storageService.read<int>(AppConstants.keyWyomingPort) ?? 10700;
   }
 
   /// Public method to reload AI settings from storage
   void reloadSettings() {
     _loadSettings();
+    _applyWyomingSettings();
+  }
+
+  /// Start, restart or stop the native Wyoming client to match settings
+  Future<void> _applyWyomingSettings() async {
+    if (!NativeWyomingClient.isSupported) return;
+    if (!isWyomingEnabled.value || wyomingHost.value.isEmpty) {
+      await _wyomingSubscription?.cancel();
+      _wyomingSubscription = null;
+      await NativeWyomingClient.stop();
+      wyomingState.value = 'stopped';
+      return;
+    }
+    _wyomingSubscription ??=
+        NativeWyomingClient.events.listen(_onWyomingEvent);
+    final started = await NativeWyomingClient.start(
+      host: wyomingHost.value,
+      port: wyomingPort.value,
+    );
+    debugPrint(started
+        ? '🎙️ Wyoming client listening for ${wyomingHost.value}:${wyomingPort.value}'
+        : '⚠️ Wyoming client could not start');
+  }
+
+  void _onWyomingEvent(WyomingClientEvent event) {
+    wyomingState.value = event.state;
+    switch (event.type) {
+      case 'transcript':
+        lastTranscript.value = event.text ?? '';
+        debugPrint('🎙️ Wyoming transcript (${event.latencyMs?.round()} ms): '
+            '${event.text}');
+        break;
+      case 'response':
+        lastResponseLatencyMs.value = event.latencyMs ?? 0;
+        debugPrint('🎙️ Wyoming reply heard '
+            '${event.latencyMs?.round()} ms after end of speech');
+        break;
+      case 'error':
+        debugPrint('⚠️ Wyoming error: ${event.text}');
+        break;
+    }
+  }
+
+  @override
+  void onClose() {
+    _wyomingSubscription?.cancel();
+    NativeWyomingClient.stop();
+    super.onClose();
   }
 
   /// Handle call state changes
@@ -5,6 +5,7 @@ import 'package:path_provider/path_provider.dart';
 import 'dart:async';
 import 'package:crypto/crypto.dart';
 import 'dart:convert';
+import 'native_sound_mixer.dart';
 
 /// Handles audio playback with caching using media_kit
 class AudioService extends GetxService {
@@ -48,8 +49,14 @@ class AudioService extends GetxService {
     return this;
   }
 
-  /// Initialize a player with a specific sound
+  /// Initialize a player with a specific sound. On Linux the sound is
+  /// cached in the native mixer instead, and a media_kit player is only
+  /// created when that fails.
   Future<void> _initializePlayer(String key, String assetPath) async {
+    if (await NativeSoundMixer.registerAsset(key, assetPath)) {
+      print('🔊 Sound $key will play through the native mixer');
+      return;
+    }
     try {
       print('🔊 Initializing player for sound key: $key, path: $assetPath');
       final player = Player();
@@ -143,6 +150,12 @@ class AudioService extends GetxService {
       await init();
     }
 
+    if (NativeSoundMixer.isRegistered(key) &&
+        await NativeSoundMixer.play(key) != null) {
+      print('🔊 Sound "$key" played through the native mixer');
+      return;
+    }
+
     try {
       // Check if we have the key in our player map
       Player? player = _players[key];
@@ -152,12 +165,10 @@ class AudioService extends GetxService {
             'assets/sounds/${key == notification ? 'notification.wav' : key == wrongPin ? 'wrong.wav' : 'correct.wav'}';
 
         print('Player not found for key "$key", initializing with $assetPath');
-        await _initializePlayer(key, assetPath);
-        player = _players[key];
-
-        if (player == null) {
-          throw Exception('Failed to initialize player for key "$key"');
-        }
+        // Skip the native mixer here: it is either missing or just failed
+        player = Player();
+        await player.open(Media('asset:///$assetPath'), play: false);
+        _players[key] = player;
       }
 
       // Reset to start and play
@@ -329,6 +340,7 @@ class AudioService extends GetxService {
     for (final player in _remotePlayerCache.values) {
       player.dispose();
     }
+    NativeSoundMixer.stopAll();
     super.onClose();
   }
 }
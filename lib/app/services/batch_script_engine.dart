@@ -0,0 +1,265 @@
+import 'dart:async';
+import 'dart:math' as math;
+
+import '../core/utils/timer_wheel.dart';
+
+/// One entry of a compiled batch script. [command] is null for a `wait`,
+/// and [delayUs] is how long it waits (0 for commands). [offsetUs] is the
+/// sum of every wait up to and including the step, measured from the batch
+/// start, which is when it is due in an absolute schedule.
+class BatchStep {
+  final dynamic command;
+  final int delayUs;
+  final int offsetUs;
+
+  const BatchStep(this.command, this.delayUs, this.offsetUs);
+
+  bool get isWait => command == null;
+}
+
+/// A batch script parsed once into steps.
+///
+/// By default a `wait` counts from the moment the step before it finished,
+/// so a slow command pushes back everything after it, as the wait command
+/// is documented. With [absolute], every step is due at its offset from
+/// the batch start instead, so a slow command eats into the wait after it
+/// and the batch keeps to its timetable.
+class CompiledBatch {
+  final List<BatchStep> steps;
+  final int skipped;
+  final bool absolute;
+
+  CompiledBatch(this.steps, this.skipped, {this.absolute = false});
+
+  Duration get duration =>
+      Duration(microseconds: steps.isEmpty ? 0 : steps.last.offsetUs);
+
+  /// Compile the `commands` array of a batch. Maps with a `command` key
+  /// and plain strings are kept as they are for the dispatcher; `wait`
+  /// entries (`seconds`, up to 300) become delays. Anything else is
+  /// skipped.
+  factory CompiledBatch.compile(List<dynamic> commands,
+      {bool absolute = false}) {
+    final steps = <BatchStep>[];
+    var offsetUs = 0;
+    var skipped = 0;
+    for (final command in commands) {
+      if (command is Map &&
+          command['command']?.toString().toLowerCase() == 'wait') {
+        final seconds =
+            double.tryParse(command['seconds']?.toString() ?? '1') ?? 1.0;
+        final delayUs = (seconds.clamp(0, 300) * 1000000).round();
+        offsetUs += delayUs;
+        steps.add(BatchStep(null, delayUs, offsetUs));
+      } else if ((command is Map && command['command'] != null) ||
+          command is String) {
+        steps.add(BatchStep(command, 0, offsetUs));
+      } else {
+        print('[BATCH] Unknown command format: $command');
+        skipped++;
+      }
+    }
+    return CompiledBatch(steps, skipped, absolute: absolute);
+  }
+}
+
+/// Running summary of a series of millisecond samples
+class BatchSampleStats {
+  static const int _maxSamples = 4096;
+
+  final List<double> _samples = [];
+  int count = 0;
+  double _sum = 0;
+  double max = 0;
+
+  void add(double ms) {
+    count++;
+    _sum += ms;
+    if (count == 1 || ms > max) max = ms;
+    if (_samples.length < _maxSamples) _samples.add(ms);
+  }
+
+  double get mean => count == 0 ? 0 : _sum / count;
+
+  double percentile(double p) {
+    if (_samples.isEmpty) return 0;
+    final sorted = List<double>.of(_samples)..sort();
+    final index = ((sorted.length - 1) * p).round();
+    return sorted[index];
+  }
+
+  Map<String, dynamic> toJson() => {
+        'count': count,
+        'mean_ms': _round(mean),
+        'p50_ms': _round(percentile(0.5)),
+        'p95_ms': _round(percentile(0.95)),
+        'max_ms': _round(max),
+      };
+
+  static double _round(double ms) => (ms * 100).round() / 100;
+}
+
+/// A batch started on a [BatchScriptEngine]. [latency] is how long each
+/// command took to dispatch; [drift] is how late each step started
+/// against when it was due.
+class BatchRun {
+  final String name;
+  final CompiledBatch script;
+  final DateTime startedAt = DateTime.now();
+  final BatchSampleStats latency = BatchSampleStats();
+  final BatchSampleStats drift = BatchSampleStats();
+  final Completer<void> _done = Completer<void>();
+
+  String status = 'running'; // running, completed, killed
+  int progress = 0;
+  int failures = 0;
+  int _startUs = 0;
+  int _lastReportUs = 0;
+  TimerWheelEntry? _sleep;
+  Completer<void>? _wake;
+
+  BatchRun._(this.name, this.script);
+
+  int get total => script.steps.length;
+  bool get isRunning => status == 'running';
+
+  /// Completes when the batch finishes or is killed
+  Future<void> get done => _done.future;
+
+  Map<String, dynamic> toJson() => {
+        'batch_id': name,
+        'status': status,
+        'progress': progress,
+        'total': total,
+        'skipped': script.skipped,
+        'failures': failures,
+        'started_at': startedAt.toIso8601String(),
+        'schedule': script.absolute ? 'absolute' : 'relative',
+        'scheduled_seconds': script.duration.inMilliseconds / 1000,
+        'latency': latency.toJson(),
+        'drift': drift.toJson(),
+      };
+}
+
+/// Runs several named batch scripts side by side on one [TimerWheel].
+///
+/// Waits are wheel entries rather than polling loops, so a batch that is
+/// waiting costs nothing until its next step is due, and killing it
+/// cancels the entry and stops it at once.
+class BatchScriptEngine {
+  final Future<void> Function(dynamic command) execute;
+  final void Function(BatchRun run)? onProgress;
+  final int maxConcurrent;
+  final int progressIntervalUs;
+
+  final TimerWheel _wheel = TimerWheel();
+  final Map<String, BatchRun> _runs = {};
+
+  BatchScriptEngine({
+    required this.execute,
+    this.onProgress,
+    this.maxConcurrent = 8,
+    Duration progressInterval = const Duration(milliseconds: 250),
+  }) : progressIntervalUs = progressInterval.inMicroseconds;
+
+  Iterable<BatchRun> get runs => _runs.values;
+
+  BatchRun? operator [](String name) => _runs[name];
+
+  /// Start [script] as [name]. Throws a [StateError] when a batch of that
+  /// name is still running or [maxConcurrent] batches already are.
+  BatchRun start(String name, CompiledBatch script) {
+    if (_runs.containsKey(name)) {
+      throw StateError('Batch "$name" is already running');
+    }
+    if (_runs.length >= maxConcurrent) {
+      throw StateError(
+          'Cannot start batch "$name": $maxConcurrent batches are running');
+    }
+    final run = BatchRun._(name, script);
+    _runs[name] = run;
+    run._startUs = _wheel.nowUs;
+    _report(run, force: true);
+    _run(run);
+    return run;
+  }
+
+  /// Stop the batch [name]; returns false if it is not running
+  bool kill(String name) {
+    final run = _runs[name];
+    if (run == null) return false;
+    _finish(run, 'killed');
+    return true;
+  }
+
+  /// Stop every batch; returns their names
+  List<String> killAll() {
+    final names = _runs.keys.toList();
+    names.forEach(kill);
+    return names;
+  }
+
+  Future<void> _run(BatchRun run) async {
+    // When the step before finished; relative waits count from it
+    var previousEndUs = run._startUs;
+    for (var i = 0; i < run.script.steps.length; i++) {
+      final step = run.script.steps[i];
+      final dueUs = run.script.absolute
+          ? run._startUs + step.offsetUs
+          : previousEndUs + step.delayUs;
+      if (dueUs > _wheel.nowUs) {
+        final wake = Completer<void>();
+        run._wake = wake;
+        run._sleep = _wheel.scheduleAt(dueUs, () {
+          if (!wake.isCompleted) wake.complete();
+        });
+        await wake.future;
+        run._sleep = null;
+        run._wake = null;
+      }
+      if (!run.isRunning) return;
+
+      final startUs = _wheel.nowUs;
+      run.drift.add(math.max(0, startUs - dueUs) / 1000);
+      if (!step.isWait) {
+        try {
+          await execute(step.command);
+        } catch (e, st) {
+          run.failures++;
+          print('[BATCH] ${run.name}: error in step ${i + 1}: $e\n$st');
+        }
+        run.latency.add((_wheel.nowUs - startUs) / 1000);
+        if (!run.isRunning) return;
+      }
+      // A wait ends when it was due, so wheel lateness does not add up
+      // over consecutive waits
+      previousEndUs = step.isWait ? dueUs : _wheel.nowUs;
+      run.progress = i + 1;
+      _report(run);
+    }
+    _finish(run, 'completed');
+  }
+
+  void _finish(BatchRun run, String status) {
+    if (!run.isRunning) return;
+    run.status = status;
+    final sleep = run._sleep;
+    if (sleep != null) _wheel.cancel(sleep);
+    final wake = run._wake;
+    if (wake != null && !wake.isCompleted) wake.complete();
+    _runs.remove(run.name);
+    _report(run, force: true);
+    run._done.complete();
+  }
+
+  // Progress is reported at most every progressInterval per batch, plus
+  // on start and finish
+  void _report(BatchRun run, {bool force = false}) {
+    final callback = onProgress;
+    if (callback == null) return;
+    final now = _wheel.nowUs;
+    if (!force && now - run._lastReportUs < progressIntervalUs) return;
+    run._lastReportUs = now;
+    callback(run);
+  }
+}
@@ -0,0 +1,293 @@
+import 'dart:io';
+import 'dart:math' as math;
+
+/// Operating modes of the adaptive detection scheduler, from most to least
+/// expensive
+enum DetectionMode {
+  /// A person is being tracked: fastest rate, full resolution
+  tracking,
+
+  /// Something is in view or moved recently: normal rate
+  active,
+
+  /// Empty scene: slow rate, reduced resolution
+  idle,
+
+  /// Over budget or under heavy load: the detector only runs when the
+  /// motion gate sees movement, at the lowest resolution
+  motionOnly,
+}
+
+/// Ring frame sizes the scheduler moves between. The model input stays the
+/// same; smaller frames make capture conversion and preprocessing cheaper.
+enum DetectionResolution { low, medium, high }
+
+extension DetectionResolutionSize on DetectionResolution {
+  /// Publish size for the native capture; 0 x 0 keeps the capture size
+  int get width => const [320, 480, 0][index];
+  int get height => const [240, 360, 0][index];
+  String get label => const ['320x240', '480x360', 'full'][index];
+}
+
+/// What the scheduler wants applied until its next evaluation
+class SchedulerDecision {
+  final DetectionMode mode;
+  final Duration interval;
+  final DetectionResolution resolution;
+
+  /// Keep-alive inference interval for the native motion gate
+  final Duration keepAlive;
+
+  /// Why this decision was taken, for the sensor attributes
+  final String reason;
+
+  const SchedulerDecision({
+    required this.mode,
+    required this.interval,
+    required this.resolution,
+    required this.keepAlive,
+    required this.reason,
+  });
+
+  bool sameAs(SchedulerDecision other) =>
+      mode == other.mode &&
+      interval == other.interval &&
+      resolution == other.resolution &&
+      keepAlive == other.keepAlive;
+}
+
+/// Fixed-size window of recent samples with percentile queries
+class RollingPercentile {
+  final int capacity;
+  final List<double> _samples = [];
+  int _next = 0;
+
+  RollingPercentile([this.capacity = 60]);
+
+  int get length => _samples.length;
+
+  void add(double value) {
+    if (_samples.length < capacity) {
+      _samples.add(value);
+    } else {
+      _samples[_next] = value;
+    }
+    _next = (_next + 1) % capacity;
+  }
+
+  /// Nearest-rank percentile, 0 when empty
+  double percentile(double p) {
+    if (_samples.isEmpty) return 0;
+    final sorted = List<double>.from(_samples)..sort();
+    final rank = ((p / 100) * sorted.length).ceil().clamp(1, sorted.length);
+    return sorted[rank - 1];
+  }
+
+  void clear() {
+    _samples.clear();
+    _next = 0;
+  }
+}
+
+/// Picks the detection interval, ring resolution and motion gate settings
+/// from measured stage timings and system load.
+///
+/// The detector may use at most [cpuShare] of one core on average, judged
+/// from the p95 total processing time, and a single frame should finish
+/// within [latencyBudget]. Within those limits the rate follows the scene:
+/// fastest while a person is tracked, backing off step by step while the
+/// scene stays empty. A mode change is only made after it has been
+/// proposed on [stableEvaluations] consecutive evaluations, except that
+/// escalating to [DetectionMode.tracking] happens at once.
+class AdaptiveDetectionScheduler {
+  final double cpuShare;
+  final Duration latencyBudget;
+  final Duration minInterval;
+  final Duration maxInterval;
+
+  /// Load average per core above which the scheduler sheds work
+  final double loadLimit;
+  final int stableEvaluations;
+
+  final RollingPercentile _total = RollingPercentile();
+  final RollingPercentile _inference = RollingPercentile();
+  final RollingPercentile _preprocess = RollingPercentile();
+
+  SchedulerDecision _current;
+  DetectionMode? _pending;
+  int _pendingCount = 0;
+  int _emptyEvaluations = 0;
+  double _lastLoad = 0;
+
+  AdaptiveDetectionScheduler({
+    this.cpuShare = 0.25,
+    this.latencyBudget = const Duration(milliseconds: 250),
+    this.minInterval = const Duration(milliseconds: 500),
+    this.maxInterval = const Duration(seconds: 8),
+    this.loadLimit = 0.9,
+    this.stableEvaluations = 3,
+    Duration initialInterval = const Duration(seconds: 2),
+  }) : _current = SchedulerDecision(
+          mode: DetectionMode.active,
+          interval: initialInterval,
+          resolution: DetectionResolution.high,
+          keepAlive: const Duration(seconds: 10),
+          reason: 'startup',
+        );
+
+  SchedulerDecision get current => _current;
+  double get p95TotalMs => _total.percentile(95);
+  double get p95InferenceMs => _inference.percentile(95);
+  double get p95PreprocessMs => _preprocess.percentile(95);
+  double get loadPerCore => _lastLoad;
+
+  /// Record the stage timings of one frame that actually ran the detector
+  void recordTimings(Map<String, dynamic> timings) {
+    final total = timings['totalProcessingTime'];
+    if (total is! num) return;
+    _total.add(total.toDouble());
+    final inference = timings['inferenceTime'];
+    if (inference is num) _inference.add(inference.toDouble());
+    final preprocess = timings['preprocessingTime'];
+    if (preprocess is num) _preprocess.add(preprocess.toDouble());
+  }
+
+  /// 1-minute load average divided by the core count, or null off Linux
+  static double? readLoadPerCore() {
+    if (!Platform.isLinux) return null;
+    try {
+      final fields = File('/proc/loadavg').readAsStringSync().split(' ');
+      return double.parse(fields.first) / Platform.numberOfProcessors;
+    } catch (e) {
+      return null;
+    }
+  }
+
+  /// Re-evaluate; returns the new decision when it changed, otherwise null
+  SchedulerDecision? evaluate({
+    required bool personTracked,
+    required bool objectsPresent,
+    required bool motionDetected,
+    double? loadPerCore,
+  }) {
+    _lastLoad = loadPerCore ?? 0;
+    final p95 = p95TotalMs;
+
+    // Shortest interval the CPU share allows at the measured cost
+    final budgetInterval = p95 > 0
+        ? Duration(milliseconds: (p95 / cpuShare).ceil())
+        : minInterval;
+    final overLatency = p95 > latencyBudget.inMilliseconds;
+    final overloaded = _lastLoad > loadLimit;
+
+    if (personTracked || objectsPresent || motionDetected) {
+      _emptyEvaluations = 0;
+    } else {
+      _emptyEvaluations++;
+    }
+
+    DetectionMode mode;
+    String reason;
+    if (overloaded && !personTracked) {
+      mode = DetectionMode.motionOnly;
+      reason = 'load ${_lastLoad.toStringAsFixed(2)}/core > $loadLimit';
+    } else if (personTracked) {
+      mode = DetectionMode.tracking;
+      reason = 'person tracked';
+    } else if (_emptyEvaluations >= stableEvaluations) {
+      mode = overLatency ? DetectionMode.motionOnly : DetectionMode.idle;
+      reason = overLatency
+          ? 'empty scene, p95 ${p95.toStringAsFixed(0)}ms over budget'
+          : 'empty scene';
+    } else {
+      mode = DetectionMode.active;
+      reason = objectsPresent ? 'objects in view' : 'recent motion';
+    }
+
+    // Hysteresis: only tracking is entered immediately
+    if (mode == _current.mode || mode == DetectionMode.tracking) {
+      _pending = null;
+      _pendingCount = 0;
+    } else {
+      if (_pending != mode) {
+        _pending = mode;
+        _pendingCount = 0;
+      }
+      _pendingCount++;
+      if (_pendingCount < stableEvaluations) {
+        mode = _current.mode;
+        reason = _current.reason;
+      } else {
+        _pending = null;
+        _pendingCount = 0;
+      }
+    }
+
+    var interval = maxInterval;
+    var resolution = DetectionResolution.low;
+    var keepAlive = const Duration(seconds: 60);
+    switch (mode) {
+      case DetectionMode.tracking:
+        interval = minInterval;
+        resolution = DetectionResolution.high;
+        keepAlive = const Duration(seconds: 5);
+        break;
+      case DetectionMode.active:
+        interval = const Duration(seconds: 1);
+        resolution = DetectionResolution.high;
+        keepAlive = const Duration(seconds: 10);
+        break;
+      case DetectionMode.idle:
+        // Back off further the longer the scene stays empty
+        final steps = math.min(_emptyEvaluations ~/ stableEvaluations, 3);
+        interval = Duration(milliseconds: 2000 << steps);
+        resolution = DetectionResolution.medium;
+        keepAlive = const Duration(seconds: 30);
+        break;
+      case DetectionMode.motionOnly:
+        break;
+    }
+
+    // The CPU share always wins over the scene-driven rate
+    if (budgetInterval > interval) {
+      interval = budgetInterval;
+      reason = '$reason; cpu share ${(cpuShare * 100).round()}%';
+    }
+    if (overLatency && resolution == DetectionResolution.high) {
+      resolution = DetectionResolution.medium;
+      reason = '$reason; p95 ${p95.toStringAsFixed(0)}ms > '
+          '${latencyBudget.inMilliseconds}ms';
+    }
+    if (interval < minInterval) interval = minInterval;
+    if (interval > maxInterval) interval = maxInterval;
+
+    final decision = SchedulerDecision(
+      mode: mode,
+      interval: interval,
+      resolution: resolution,
+      keepAlive: keepAlive,
+      reason: reason,
+    );
+    if (decision.sameAs(_current)) return null;
+    _current = decision;
+    return decision;
+  }
+
+  /// Sensor payload describing the current decision and its inputs
+  Map<String, dynamic> toJson() => {
+        'mode': _current.mode.toString().split('.').last,
+        'interval_ms': _current.interval.inMilliseconds,
+        'resolution': _current.resolution.label,
+        'keepalive_s': _current.keepAlive.inSeconds,
+        'reason': _current.reason,
+        'p95_total_ms': _round(p95TotalMs),
+        'p95_inference_ms': _round(p95InferenceMs),
+        'p95_preprocess_ms': _round(p95PreprocessMs),
+        'samples': _total.length,
+        'load_per_core': _round(_lastLoad),
+        'cpu_share_target': cpuShare,
+        'latency_budget_ms': latencyBudget.inMilliseconds,
+      };
+
+  static double _round(double value) => (value * 10).roundToDouble() / 10;
+}
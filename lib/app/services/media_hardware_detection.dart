@@ -250,6 +250,9 @@ class MediaHardwareDetectionService extends GetxService {
     }
   }
 
+  /// Whether the next player request carries its own acceleration setting
+  bool get hasTemporaryOverride => _useOverride;
+
   /// Set a temporary hardware acceleration override for the next player request
   void setTemporaryHardwareAcceleration(bool enabled) {
     _tempHardwareAccelOverride = enabled;
@@ -220,7 +220,7 @@ class MediaRecoveryService extends GetxService {
       }
 
       // Try to dispose and recreate the player
-      final disposed = manager.disposePlayerFor(url);
+      final disposed = manager.disposePlayerFor(url, force: true);
       if (disposed) {
         // Wait for cleanup to complete - longer delay for RTSP streams
         await Future.delayed(Duration(milliseconds: isRtspStream ? 300 : 200));
@@ -1,7 +1,13 @@
 import 'package:get/get.dart';
+import 'dart:async';
 import 'dart:io';
 import 'package:flutter/foundation.dart';
+import 'package:flutter/painting.dart';
 import 'dart:developer' as developer;
+import 'native_detection_engine.dart';
+import 'native_memory_governor.dart';
+import 'native_system_metrics.dart';
+import 'native_tts.dart';
 
 /// Service for monitoring and managing memory usage
 class MemoryManagerService extends GetxService {
@@ -19,10 +25,23 @@ class MemoryManagerService extends GetxService {
   final Map<Type, DateTime> _serviceLastUsed = {};
   final Map<Type, bool> _serviceAutoDispose = {};
   
+  // Native governor (Linux): pressure comes from the kernel instead of the
+  // RSS heuristic below
+  bool _nativeGovernor = false;
+  StreamSubscription<MemoryPressureEvent>? _pressureSubscription;
+  bool _releasing = false;
+  DateTime? _lastCleanup;
+  
+  // Measured releases, ours and the governor's, newest last
+  static const int _maxRecentReleases = 32;
+  final List<MemoryReleaseReport> _recentReleases = [];
+  
   @override
   Future<MemoryManagerService> onInit() async {
     super.onInit();
     
+    await _startNativeGovernor();
+    
     // Start memory monitoring
     _startMemoryMonitoring();
     
@@ -46,18 +65,64 @@ class MemoryManagerService extends GetxService {
     _updateMemoryMetrics();
   }
   
+  /// Start the native memory governor and act on the pressure it reports
+  Future<void> _startNativeGovernor() async {
+    if (kIsWeb || !NativeMemoryGovernor.isSupported) return;
+    
+    final info = await NativeMemoryGovernor.start();
+    if (info == null) return;
+    _nativeGovernor = true;
+    _pressureSubscription = NativeMemoryGovernor.events.listen(
+      _onPressureEvent,
+      onError: (e) => developer.log('Memory governor events failed: $e'),
+    );
+    developer.log('🧠 Native memory governor started '
+        '(PSI trigger: ${info['psiTrigger']}, cgroup events: ${info['cgroupEvents']}, '
+        'malloc arenas: ${info['arenaMax']})');
+  }
+  
+  void _onPressureEvent(MemoryPressureEvent event) {
+    event.reports.forEach(_recordRelease);
+    memoryUsageMB.value = event.rssKb ~/ 1024;
+    isMemoryPressure.value = event.level != MemoryPressureLevel.none;
+    
+    // The governor releases when pressure rises and once per cooldown while
+    // it lasts; our caches follow at the same pace
+    if (event.reports.isEmpty) return;
+    switch (event.level) {
+      case MemoryPressureLevel.critical:
+        developer.log('🚨 CRITICAL memory pressure: ${event.reason}');
+        _performCriticalCleanup(event.reason);
+        break;
+      case MemoryPressureLevel.moderate:
+        developer.log('⚠️ Memory pressure: ${event.reason}');
+        _performWarningCleanup(event.reason);
+        break;
+      case MemoryPressureLevel.none:
+        // Growth trims need nothing from us
+        break;
+    }
+  }
+  
   /// Update current memory usage metrics
-  void _updateMemoryMetrics() {
+  Future<void> _updateMemoryMetrics() async {
     if (kIsWeb) {
       // Web doesn't have direct memory access
       return;
     }
     
     try {
-      final info = ProcessInfo.currentRss;
-      final memoryBytes = info;
-      final memoryMB = (memoryBytes / (1024 * 1024)).round();
+      // The sampler reads the resident set and the memory actually
+      // available to us: our cgroup's limit, or the machine's
+      final sample =
+          _nativeGovernor ? await NativeSystemMetrics.current() : null;
+      final rssKb = (sample?['rssKb'] as num?)?.round() ??
+          ProcessInfo.currentRss ~/ 1024;
+      final cgroupMaxKb = sample?['cgroupMemoryMaxKb'] as int? ?? -1;
+      final memTotalKb = sample?['memTotalKb'] as int? ?? 0;
+      final limitKb = cgroupMaxKb > 0 ? cgroupMaxKb : memTotalKb;
       
+      final memoryMB = rssKb ~/ 1024;
       memoryUsageMB.value = memoryMB;
       
       // Update peak memory
@@ -65,9 +130,9 @@ class MemoryManagerService extends GetxService {
         peakMemoryMB.value = memoryMB;
       }
       
-      // Calculate percentage (assuming 4GB max for estimation)
-      final estimatedMaxMB = 4096;
-      memoryUsagePercent.value = memoryMB / estimatedMaxMB;
+      // Without the sampler, assume 4GB max for estimation
+      memoryUsagePercent.value =
+          limitKb > 0 ? rssKb / limitKb : memoryMB / 4096;
       
       developer.log('Memory: ${memoryMB}MB (${(memoryUsagePercent.value * 100).toStringAsFixed(1)}%)');
       
@@ -78,16 +143,20 @@ class MemoryManagerService extends GetxService {
   
   /// Check for memory pressure and take action
   void _checkMemoryPressure() {
+    // The native governor reports pressure as the kernel sees it
+    if (_nativeGovernor) return;
+    
     final currentUsage = memoryUsagePercent.value;
+    final usage = '${(currentUsage * 100).toStringAsFixed(1)}%';
     
     if (currentUsage >= criticalThreshold) {
       isMemoryPressure.value = true;
-      developer.log('🚨 CRITICAL memory pressure detected: ${(currentUsage * 100).toStringAsFixed(1)}%');
-      _performCriticalCleanup();
+      developer.log('🚨 CRITICAL memory pressure detected: $usage');
+      _performCriticalCleanup('rss $usage');
     } else if (currentUsage >= warningThreshold) {
       isMemoryPressure.value = true;
-      developer.log('⚠️ Memory pressure warning: ${(currentUsage * 100).toStringAsFixed(1)}%');
-      _performWarningCleanup();
+      developer.log('⚠️ Memory pressure warning: $usage');
+      _performWarningCleanup('rss $usage');
     } else {
       isMemoryPressure.value = false;
     }
@@ -146,33 +215,86 @@ class MemoryManagerService extends GetxService {
   }
   
   /// Perform warning-level memory cleanup
-  void _performWarningCleanup() {
-    developer.log('🧹 Performing warning-level memory cleanup...');
-    
-    // Dispose non-essential visual effects
-    _safelyDisposeService<dynamic>('HaloEffectControllerGetx');
-    _safelyDisposeService<dynamic>('WindowHaloController');
-    
-    // Clear image caches
-    _clearImageCaches();
-    
-    // Suggest garbage collection
-    _suggestGarbageCollection();
+  Future<void> _performWarningCleanup(String reason) async {
+    if (_releasing) return;
+    _releasing = true;
+    try {
+      developer.log('🧹 Performing warning-level memory cleanup...');
+      await _releaseCaches(MemoryPressureLevel.moderate, reason);
+      await _trimNativeHeap(reason);
+    } finally {
+      _releasing = false;
+    }
   }
   
   /// Perform critical-level memory cleanup
-  void _performCriticalCleanup() {
-    developer.log('🚨 Performing critical memory cleanup...');
-    
-    // Dispose all non-essential services
-    _performWarningCleanup();
+  Future<void> _performCriticalCleanup(String reason) async {
+    if (_releasing) return;
+    _releasing = true;
+    try {
+      developer.log('🚨 Performing critical memory cleanup...');
+      await _releaseCaches(MemoryPressureLevel.critical, reason);
+      await _trimNativeHeap(reason);
+    } finally {
+      _releasing = false;
+    }
+  }
+  
+  /// Release caches up to [level], cheapest to rebuild first, measuring
+  /// what each one gave back
+  Future<void> _releaseCaches(MemoryPressureLevel level, String reason) async {
+    await _measureRelease('image_cache', level, reason, _clearImageCaches);
+    await _measureRelease('tts_phrase_cache', level, reason, () async {
+      final bytes = await NativeTts.trimMemory();
+      if (bytes > 0) {
+        developer.log('🗣️ Released ${bytes ~/ 1024} KB of cached phrases');
+      }
+    });
+    // Dispose non-essential visual effects
+    await _measureRelease('halo_services', level, reason, () {
+      _safelyDisposeService<dynamic>('HaloEffectControllerGetx');
+      _safelyDisposeService<dynamic>('WindowHaloController');
+    });
+    if (level != MemoryPressureLevel.critical) return;
     
+    // The detector's tensor arena, unless it ran in the last few seconds
+    await _measureRelease('detector_interpreter', level, reason, () async {
+      await NativeDetectionEngine.trimMemory(idle: Duration(seconds: 10));
+    });
     // Dispose media services if not actively playing
-    _safelyDisposeService<dynamic>('BackgroundMediaService');
-    _safelyDisposeService<dynamic>('MediaControlService');
-    
-    // Force garbage collection
-    _forceGarbageCollection();
+    await _measureRelease('media_services', level, reason, () {
+      _safelyDisposeService<dynamic>('BackgroundMediaService');
+      _safelyDisposeService<dynamic>('MediaControlService');
+    });
+  }
+  
+  Future<void> _measureRelease(String action, MemoryPressureLevel level,
+      String reason, FutureOr<void> Function() release) async {
+    final stopwatch = Stopwatch()..start();
+    final before = await _residentKb();
+    try {
+      await release();
+    } catch (e) {
+      developer.log('Memory release $action failed: $e');
+    }
+    final after = await _residentKb();
+    _recordRelease(MemoryReleaseReport(DateTime.now(), level, reason, action,
+        before, after, stopwatch.elapsedMicroseconds / 1000));
+  }
+  
+  Future<int> _residentKb() async {
+    return await NativeMemoryGovernor.residentKb() ??
+        ProcessInfo.currentRss ~/ 1024;
+  }
+  
+  void _recordRelease(MemoryReleaseReport report) {
+    _lastCleanup = report.time;
+    _recentReleases.add(report);
+    if (_recentReleases.length > _maxRecentReleases) {
+      _recentReleases.removeAt(0);
+    }
+    developer.log('🧹 ${report.action}: ${report.rssBeforeKb ~/ 1024} -> '
+        '${report.rssAfterKb ~/ 1024} MB (${report.reason})');
   }
   
   /// Safely dispose a service if it exists
@@ -190,9 +312,9 @@ class MemoryManagerService extends GetxService {
   /// Clear image caches to free memory
   void _clearImageCaches() {
     try {
-      // Clear Flutter's image cache
+      // Clear Flutter's image cache; images on screen stay alive
       if (!kIsWeb) {
-        // PaintingBinding.instance.imageCache.clear();
+        PaintingBinding.instance.imageCache.clear();
         developer.log('🖼️ Cleared image caches');
       }
     } catch (e) {
@@ -200,28 +322,17 @@ class MemoryManagerService extends GetxService {
     }
   }
   
-  /// Suggest garbage collection
-  void _suggestGarbageCollection() {
+  /// Hand what the releases freed back to the kernel. Dart has no GC
+  /// control, but the native heap (decoded images, plugin buffers) keeps
+  /// freed pages until malloc_trim returns them.
+  Future<void> _trimNativeHeap(String reason) async {
     try {
-      // Force garbage collection on native platforms
-      if (!kIsWeb) {
-        developer.log('🗑️ Suggesting garbage collection...');
-        // Note: Dart doesn't provide direct GC control, but this helps with debugging
+      final report = await NativeMemoryGovernor.trim(reason);
+      if (report != null) {
+        _recordRelease(report);
       }
     } catch (e) {
-      developer.log('Error during garbage collection: $e');
-    }
-  }
-  
-  /// Force garbage collection (more aggressive)
-  void _forceGarbageCollection() {
-    try {
-      _suggestGarbageCollection();
-      
-      // Additional cleanup for critical situations
-      developer.log('🚨 Forced garbage collection due to critical memory pressure');
-    } catch (e) {
-      developer.log('Error during forced garbage collection: $e');
+      developer.log('Error trimming native heap: $e');
     }
   }
   
@@ -232,9 +343,12 @@ class MemoryManagerService extends GetxService {
       'peak_mb': peakMemoryMB.value,
       'usage_percent': (memoryUsagePercent.value * 100).toStringAsFixed(1),
       'memory_pressure': isMemoryPressure.value,
+      'native_governor': _nativeGovernor,
       'registered_services': _getRegisteredServiceCount(),
       'auto_disposable_services': _serviceAutoDispose.length,
-      'last_cleanup': DateTime.now().toIso8601String(),
+      'last_cleanup': _lastCleanup?.toIso8601String() ?? 'never',
+      'recent_releases':
+          _recentReleases.map((report) => report.toJson()).toList(),
     };
   }
   
@@ -242,13 +356,10 @@ class MemoryManagerService extends GetxService {
   void manualCleanup({bool aggressive = false}) {
     developer.log('🧹 Manual memory cleanup requested (aggressive: $aggressive)');
     
-    if (aggressive) {
-      _performCriticalCleanup();
-    } else {
-      _performWarningCleanup();
-    }
-    
-    _updateMemoryMetrics();
+    final cleanup = aggressive
+        ? _performCriticalCleanup('manual')
+        : _performWarningCleanup('manual');
+    cleanup.then((_) => _updateMemoryMetrics());
   }
   
   /// Get count of registered services (workaround for Get.registered not being available)
@@ -261,6 +372,10 @@ class MemoryManagerService extends GetxService {
   @override
   void onClose() {
     developer.log('🧠 Memory Manager Service closing');
+    _pressureSubscription?.cancel();
+    if (_nativeGovernor) {
+      NativeMemoryGovernor.stop();
+    }
     super.onClose();
   }
 }
@@ -18,6 +18,10 @@ import '../services/window_manager_service.dart';
 import '../modules/home/controllers/tiling_window_controller.dart';
 import '../modules/calendar/controllers/calendar_controller.dart';
 import 'mqtt_notification_handler.dart';
+import 'native_frame_timings.dart';
+import 'native_mqtt_client.dart';
+import 'batch_script_engine.dart';
+import 'sensor_publisher.dart';
 import 'media_recovery_service.dart';
 import 'tts_service.dart';
 import 'media_control_service.dart'; // Import the MediaControlService
@@ -95,6 +99,11 @@ class MqttService extends GetxService {
   /// Subscribe to a custom MQTT topic
   void subscribe(String topic, Function(String, String) onMessage) {
     print('Subscribing to topic: $topic');
+    if (_useNative) {
+      _subscriptionHandlers[topic] = onMessage;
+      NativeMqttClient.subscribe(topic, qos: 1);
+      return;
+    }
     _client?.subscribe(topic, MqttQos.atLeastOnce);
     _client?.updates
         ?.listen((List<MqttReceivedMessage<MqttMessage?>>? messages) {
@@ -141,8 +150,7 @@ class MqttService extends GetxService {
     print(
         'MQTT DEBUG: Discovery payload for windows: \\${jsonEncode(payload)}');
     print('MQTT DEBUG: Publishing to topic: $discoveryTopic');
-    publishJsonToTopic(discoveryTopic, payload, retain: true);
-    print('MQTT DEBUG: Published discovery config for windows');
+    _publishDiscoveryConfig('windows', discoveryTopic, jsonEncode(payload));
   }
 
   // Required dependencies
@@ -152,21 +160,58 @@ class MqttService extends GetxService {
   // MQTT client
   MqttServerClient? _client;
 
+  // Native transport on Linux (linux/plugins/kiosk_mqtt); _client stays
+  // null while it is in use
+  bool _useNative = false;
+  bool _nativeConnected = false;
+  StreamSubscription<NativeMqttState>? _nativeStateSub;
+  StreamSubscription<NativeMqttMessage>? _nativeMessageSub;
+  final Map<String, Function(String, String)> _subscriptionHandlers = {};
+
   // Observable properties
   final RxBool isConnected = false.obs;
   final RxString deviceName = ''.obs;
   final RxBool haDiscovery = false.obs;
   final RxBool isOnline = true.obs; // Track online status
 
+  // Remembers what each sensor and discovery topic last carried, so only
+  // changes go to the broker
+  late final SensorPublisher _sensorPublisher =
+      SensorPublisher((topic, payload, retain) {
+    if (!_isTransportConnected) return false;
+    final builder = MqttClientPayloadBuilder();
+    builder.addString(payload);
+    _publishMessage(topic, MqttQos.atLeastOnce, builder.payload!,
+        retain: retain);
+    return true;
+  });
+
+  // Deadbands are in the units each value is published in
+  static const Map<String, SensorPolicy> _sensorPolicies = {
+    'battery': SensorPolicy(deadband: 1),
+    'cpu_usage': SensorPolicy(deadband: 5, minInterval: Duration(seconds: 10)),
+    'memory_usage':
+        SensorPolicy(deadband: 2, minInterval: Duration(seconds: 10)),
+    'latitude': SensorPolicy(deadband: 0.0001),
+    'longitude': SensorPolicy(deadband: 0.0001),
+    'altitude': SensorPolicy(deadband: 5),
+    'location_accuracy': SensorPolicy(deadband: 5),
+  };
+
   // Stats update timer
   Timer? _statsUpdateTimer;
   // Update interval - 30 seconds for more responsive updates
   final int _updateIntervalSeconds = 30;
 
-  // Batch script management
-  bool _batchScriptRunning = false;
-  String? _currentBatchId;
-  // Timer? _batchTimeoutTimer; // Unused, commented out
+  // Batch script management: named batches run side by side on one timer
+  // wheel
+  late final BatchScriptEngine _batchEngine = BatchScriptEngine(
+    execute: (command) => command is String
+        ? _processCommand(command)
+        : _processCommandObject(command),
+    onProgress: _onBatchProgress,
+  );
+  String? _currentBatchId; // Most recently started batch
   // Utility: Parse a hex string to color with robust error handling
   Color _hexToColor(String hexString) {
     if (hexString.isEmpty) {
@@ -234,112 +279,113 @@ class MqttService extends GetxService {
     return '#${color.value.toRadixString(16).padLeft(8, '0').substring(2).toUpperCase()}';
   }
 
-  // Batch script management: process a managed batch (fully implemented)
+  // Batch script management: compile and start a managed batch
   Future<void> _processManagedBatch(dynamic cmdObj) async {
     // Parse commands array
     final List<dynamic>? commands = cmdObj['commands'] as List<dynamic>?;
     if (commands == null || commands.isEmpty) {
       print('[BATCH] No commands provided in batch');
-      batchStatus.value = 'idle';
       return;
     }
 
-    _batchScriptRunning = true;
-    _batchKillRequested = false;
-    _currentBatchId = DateTime.now().millisecondsSinceEpoch.toString();
-    batchStatus.value = 'running';
-    batchProgress.value = 0;
-    batchTotal.value = commands.length;
+    // Waits count from the end of the command before them unless the batch
+    // asks for an absolute timetable
+    final script = CompiledBatch.compile(commands,
+        absolute: cmdObj['schedule']?.toString().toLowerCase() == 'absolute');
+    final name = (cmdObj['name'] ?? cmdObj['batch_id'])?.toString() ??
+        DateTime.now().millisecondsSinceEpoch.toString();
 
-    print('[BATCH] Starting batch script with ${commands.length} commands');
+    final BatchRun run;
+    try {
+      run = _batchEngine.start(name, script);
+    } on StateError catch (e) {
+      final errorMsg = 'Cannot start new batch script: ${e.message}';
+      print('❌ [MQTT] $errorMsg');
 
-    for (int i = 0; i < commands.length; i++) {
-      if (_batchKillRequested) {
-        print('[BATCH] Batch kill requested, stopping at command $i');
-        batchStatus.value = 'killed';
-        break;
+      // Publish error to response topic if specified
+      if (cmdObj['response_topic'] != null) {
+        publishJsonToTopic(
+            cmdObj['response_topic'],
+            {
+              'success': false,
+              'error': errorMsg,
+              'current_batch_id': _currentBatchId,
+              'batch_status': batchStatus.value,
+              'running_batches':
+                  _batchEngine.runs.map((run) => run.name).toList(),
+            },
+            retain: false);
       }
+      return;
+    }
 
-      final dynamic command = commands[i];
-      batchProgress.value = i + 1;
-
-      print('[BATCH] Executing command ${i + 1}/${commands.length}: $command');
-
-      try {
-        // Simulate command processing: if it's a wait, actually wait
-        if (command is Map &&
-            command['command']?.toString().toLowerCase() == 'wait') {
-          // Perform wait in increments to allow kill checks
-          final seconds =
-              double.tryParse(command['seconds']?.toString() ?? '1') ?? 1.0;
-          final int totalMs = (seconds * 1000).clamp(0, 300000).toInt();
-          print('[BATCH] Waiting for $seconds seconds');
-          int elapsed = 0;
-          const int chunkMs = 200;
-          while (elapsed < totalMs && !_batchKillRequested) {
-            final int waitMs =
-                (totalMs - elapsed) >= chunkMs ? chunkMs : (totalMs - elapsed);
-            await Future.delayed(Duration(milliseconds: waitMs));
-            elapsed += waitMs;
-          }
-          if (_batchKillRequested) {
-            print('[BATCH] Batch killed during wait');
-            batchStatus.value = 'killed';
-            break;
-          }
-        } else if (command is Map && command['command'] != null) {
-          // Recursively process as a single command (await async handling)
-          await _processCommand(jsonEncode(command));
-        } else if (command is String) {
-          // If it's a string, treat as a simple command
-          await _processCommand(command);
-        } else {
-          print('[BATCH] Unknown command format: $command');
-        }
-      } catch (e, st) {
-        print('[BATCH] Error processing command $i: $e\n$st');
-        // Optionally, you could break or continue on error
-      }
+    _currentBatchId = name;
+    print('[BATCH] Starting batch script "$name" with ${script.steps.length} '
+        'steps over ${script.duration.inMilliseconds} ms');
+    await run.done;
+
+    print('[BATCH] Batch script "$name" ${run.status}: '
+        'latency ${run.latency.toJson()}, drift ${run.drift.toJson()}');
+    if (cmdObj['response_topic'] != null) {
+      publishJsonToTopic(
+          cmdObj['response_topic'],
+          {
+            'success': run.status == 'completed',
+            ...run.toJson(),
+            'command': 'batch',
+            'timestamp': DateTime.now().toIso8601String(),
+          },
+          retain: false);
     }
+  }
 
-    if (_batchKillRequested) {
-      print('[BATCH] Batch script was killed');
-      batchStatus.value = 'killed';
-    } else {
-      print('[BATCH] Batch script completed');
-      batchStatus.value = 'idle';
-    }
-    _batchScriptRunning = false;
-    _currentBatchId = null;
-    _batchKillRequested = false;
-    batchProgress.value = 0;
-    batchTotal.value = 0;
+  /// Mirror batch progress into the observables and publish it, with the
+  /// step latency and drift statistics, on kingkiosk/<device>/batch/<id>
+  void _onBatchProgress(BatchRun run) {
+    if (run.name == _currentBatchId) {
+      batchStatus.value = run.isRunning
+          ? 'running'
+          : run.status == 'killed'
+              ? 'killed'
+              : 'idle';
+      batchProgress.value = run.isRunning ? run.progress : 0;
+      batchTotal.value = run.isRunning ? run.total : 0;
+      if (!run.isRunning) _currentBatchId = null;
+    }
+    if (!_isTransportConnected) return;
+    final id = run.name.replaceAll(RegExp(r'[^\w-]'), '_');
+    publishJsonToTopic('kingkiosk/${deviceName.value}/batch/$id', {
+      ...run.toJson(),
+      'timestamp': DateTime.now().toIso8601String(),
+    });
   }
 
-  // Batch script management: kill batch script (stub)
-  Map<String, dynamic> _killBatchScript() {
-    // TODO: Implement batch kill logic
-    if (_batchScriptRunning) {
-      _batchKillRequested = true;
-      _batchScriptRunning = false;
-      final killedId = _currentBatchId;
-      _currentBatchId = null;
-      batchStatus.value = 'killed';
+  // Batch script management: kill one named batch, or all of them
+  Map<String, dynamic> _killBatchScript([String? name]) {
+    final killed = name != null
+        ? (_batchEngine.kill(name) ? [name] : <String>[])
+        : _batchEngine.killAll();
+    if (killed.isNotEmpty) {
       return {
         'success': true,
-        'message': 'Batch script killed',
-        'killed_batch_id': killedId,
+        'message': killed.length == 1
+            ? 'Batch script killed'
+            : '${killed.length} batch scripts killed',
+        'killed_batch_id': killed.first,
+        'killed_batch_ids': killed,
       };
     } else {
       return {
         'success': false,
-        'message': 'No batch script running',
+        'message': name != null
+            ? 'No batch script "$name" running'
+            : 'No batch script running',
         'killed_batch_id': null,
+        'killed_batch_ids': killed,
       };
     }
   }
 
-  bool _batchKillRequested = false;
   final RxString batchStatus = 'idle'.obs; // idle, running, killed
   final RxInt batchProgress = 0.obs; // Current command index
   final RxInt batchTotal = 0.obs; // Total commands in batch
@@ -499,6 +545,11 @@ class MqttService extends GetxService {
           'MQTT already connected or connecting, skipping new connect attempt');
       return isConnected.value;
     }
+    if (_useNative && _nativeStateSub != null) {
+      print(
+          'MQTT already connected or connecting, skipping new connect attempt');
+      return isConnected.value;
+    }
 
     // Check if already connecting or connected
     if (_client != null &&
@@ -509,6 +560,16 @@ class MqttService extends GetxService {
 
     print('Connecting to MQTT broker: $brokerUrl:$port');
 
+    if (NativeMqttClient.isSupported) {
+      final connected = await _connectNative(
+          brokerUrl: brokerUrl,
+          port: port,
+          username: username,
+          password: password);
+      if (connected != null) return connected;
+      print('Native MQTT transport not available, using mqtt_client');
+    }
+
     try {
       // Initialize client with a unique client ID
       final String clientId = '${deviceName.value}_${Random().nextInt(100000)}';
@@ -556,6 +617,7 @@ class MqttService extends GetxService {
           if (currentState == MqttConnectionState.connected) {
             print(
                 '📡 Connected to MQTT broker, ensuring topics are subscribed');
+            _sensorPublisher.invalidateAll();
             _subscribeToCommands();
           }
         }
@@ -595,13 +657,13 @@ class MqttService extends GetxService {
         // Subscribe to command topics
         _subscribeToCommands();
 
+        // The broker may have restarted without its retained configs
+        _sensorPublisher.invalidateAll();
+
         // Set up Home Assistant discovery if enabled
         if (haDiscovery.value) {
           print('Setting up Home Assistant discovery');
-
-          // Use the debug flow to ensure all sensors are published correctly
-          print('Using debug flow to ensure all sensors are registered');
-          forcePublishAllSensors();
+          _setupHomeAssistantDiscoveryWithDebug();
         } else {
           print('Home Assistant discovery disabled');
         }
@@ -633,6 +695,22 @@ class MqttService extends GetxService {
 
   /// Disconnect from the MQTT broker with improved error handling
   Future<void> disconnect() async {
+    if (_useNative) {
+      publishStatus('offline');
+      _stopStatsUpdate();
+      await _nativeStateSub?.cancel();
+      await _nativeMessageSub?.cancel();
+      _nativeStateSub = null;
+      _nativeMessageSub = null;
+      // Returns at once; the queue, offline status included, drains on the
+      // transport thread before it sends DISCONNECT
+      await NativeMqttClient.disconnect(lingerMs: 1000);
+      _nativeConnected = false;
+      _useNative = false;
+      isConnected.value = false;
+      debugPrint('MQTT Disconnected successfully');
+      return;
+    }
     if (_client != null) {
       try {
         // Publish offline status before disconnecting
@@ -662,12 +740,11 @@ class MqttService extends GetxService {
 
   /// Publish the device status (online/offline)
   void publishStatus(String status) {
-    if (_client != null &&
-        _client!.connectionStatus!.state == MqttConnectionState.connected) {
+    if (_isTransportConnected) {
       final builder = MqttClientPayloadBuilder();
       builder.addString(status);
 
-      _client!.publishMessage(
+      _publishMessage(
         'kingkiosk/${deviceName.value}/status',
         MqttQos.atLeastOnce,
         builder.payload!,
@@ -679,15 +756,13 @@ class MqttService extends GetxService {
   /// Publish a JSON payload to an MQTT topic
   void publishJsonToTopic(String topic, Map<String, dynamic> payload,
       {bool retain = false}) {
-    if (_client != null &&
-        _client!.connectionStatus != null &&
-        _client!.connectionStatus!.state == MqttConnectionState.connected) {
+    if (_isTransportConnected) {
       try {
         final builder = MqttClientPayloadBuilder();
         final jsonString = jsonEncode(payload);
         builder.addString(jsonString);
 
-        _client!.publishMessage(
+        _publishMessage(
           topic,
           MqttQos.atLeastOnce,
           builder.payload!,
@@ -704,6 +779,142 @@ class MqttService extends GetxService {
     }
   }
 
+  /// Whether the active transport, native or mqtt_client, is connected
+  bool get _isTransportConnected {
+    if (_useNative) return _nativeConnected;
+    return _client != null &&
+        _client!.connectionStatus != null &&
+        _client!.connectionStatus!.state == MqttConnectionState.connected;
+  }
+
+  /// Publish through the active transport
+  void _publishMessage(String topic, MqttQos qos, List<int> payload,
+      {bool retain = false}) {
+    if (_useNative) {
+      NativeMqttClient.publish(topic, payload,
+          qos: qos == MqttQos.atMostOnce ? 0 : 1, retain: retain);
+      return;
+    }
+    // Always the Uint8Buffer of an MqttClientPayloadBuilder
+    _client?.publishMessage(topic, qos, payload as dynamic, retain: retain);
+  }
+
+  /// Connect through the native transport. Returns null when the plugin is
+  /// not available, otherwise whether the broker accepted the connection.
+  Future<bool?> _connectNative({
+    required String brokerUrl,
+    required int port,
+    String? username,
+    String? password,
+  }) async {
+    final String clientId = '${deviceName.value}_${Random().nextInt(100000)}';
+    final firstState = Completer<bool>();
+
+    _nativeStateSub = NativeMqttClient.states.listen((state) {
+      print('📡 MQTT connection state changed to: ${state.state}'
+          '${state.error != null ? ' (${state.error})' : ''}');
+      final wasConnected = _nativeConnected;
+      _nativeConnected = state.isConnected;
+      isConnected.value = state.isConnected;
+      if (!firstState.isCompleted &&
+          (state.isConnected || state.error != null)) {
+        firstState.complete(state.isConnected);
+      }
+      // Every connect, the first included, even when it came after
+      // connect() had given up waiting
+      if (state.isConnected && !wasConnected) _onNativeConnected();
+    });
+    _nativeMessageSub = NativeMqttClient.messages.listen(_onNativeMessage);
+
+    final started = await NativeMqttClient.connect(
+      host: brokerUrl,
+      port: port,
+      clientId: clientId,
+      username: username,
+      password: password,
+      keepAliveSeconds: 30,
+      willTopic: 'kingkiosk/${deviceName.value}/status',
+      rateLimits: {
+        // Retained base64 screenshots are large; only the newest matters
+        'kingkiosk/${deviceName.value}/screenshot': 1000,
+      },
+    );
+    if (!started) {
+      await _nativeStateSub?.cancel();
+      await _nativeMessageSub?.cancel();
+      _nativeStateSub = null;
+      _nativeMessageSub = null;
+      return null;
+    }
+    _useNative = true;
+
+    final connected = await firstState.future
+        .timeout(Duration(seconds: 10), onTimeout: () => false);
+    if (!connected) {
+      // Keeps retrying in the background like mqtt_client's auto reconnect
+      print('MQTT Connection failed: broker not reachable yet');
+      return false;
+    }
+
+    print('MQTT Connected successfully to: $brokerUrl:$port (native)');
+    return true;
+  }
+
+  /// Post-connect work for the native transport, run on every transition
+  /// to connected. The transport publishes "online" and resubscribes by
+  /// itself; this covers topics added while it was down.
+  void _onNativeConnected() {
+    // The broker may have restarted without its retained configs
+    _sensorPublisher.invalidateAll();
+    _subscribeToCommands();
+    if (haDiscovery.value) {
+      print('Setting up Home Assistant discovery');
+      _setupHomeAssistantDiscoveryWithDebug();
+    } else {
+      print('Home Assistant discovery disabled');
+    }
+    _startStatsUpdate();
+  }
+
+  void _onNativeMessage(NativeMqttMessage message) {
+    try {
+      if (message.topic.endsWith('/command') ||
+          message.topic.endsWith('/commands')) {
+        print('🎯 Processing as command message on topic: ${message.topic}');
+        if (message.json != null) {
+          // Already parsed on the transport thread
+          _processCommandObject(message.json);
+        } else {
+          _processCommand(message.payload);
+        }
+      }
+      _subscriptionHandlers.forEach((filter, onMessage) {
+        if (_topicMatches(filter, message.topic)) {
+          onMessage(message.topic, message.payload);
+        }
+      });
+    } catch (e) {
+      print('❌ Error processing MQTT message: ${e.toString()}');
+    }
+  }
+
+  static bool _topicMatches(String filter, String topic) {
+    if (topic.startsWith(r'$') &&
+        (filter.startsWith('+') || filter.startsWith('#'))) {
+      return false;
+    }
+    final filterLevels = filter.split('/');
+    final topicLevels = topic.split('/');
+    for (var i = 0; i < filterLevels.length; i++) {
+      if (filterLevels[i] == '#') return true;
+      if (i >= topicLevels.length) return false;
+      if (filterLevels[i] != '+' && filterLevels[i] != topicLevels[i]) {
+        return false;
+      }
+    }
+    return filterLevels.length == topicLevels.length;
+  }
+
   /// Clean up resources when service is closed
   @override
   void onClose() {
@@ -711,9 +922,7 @@ class MqttService extends GetxService {
 
     try {
       // First publish offline status if connected
-      if (_client != null &&
-          _client!.connectionStatus != null &&
-          _client!.connectionStatus!.state == MqttConnectionState.connected) {
+      if (_isTransportConnected) {
         publishStatus('offline');
         debugPrint('Published offline status before disconnect');
       }
@@ -732,16 +941,18 @@ class MqttService extends GetxService {
     super.onClose();
   }
 
-  /// Start timer to periodically update device stats
+  /// Start timer to periodically update device stats; safe to call on
+  /// every (re)connect, a running timer is kept
   void _startStatsUpdate() {
-    // Cancel existing timer if any
-    _stopStatsUpdate();
+    // The first round after a (re)connect goes out in full
+    _sensorPublisher.invalidateValues();
 
-    // Create new timer
-    _statsUpdateTimer = Timer.periodic(
-      Duration(seconds: _updateIntervalSeconds),
-      (_) => _publishSensorValues(),
-    );
+    if (_statsUpdateTimer?.isActive != true) {
+      _statsUpdateTimer = Timer.periodic(
+        Duration(seconds: _updateIntervalSeconds),
+        (_) => _publishSensorValues(),
+      );
+    }
 
     // Publish stats immediately
     _publishSensorValues();
@@ -805,11 +1016,56 @@ class MqttService extends GetxService {
       _publishDirectValue('altitude', altitude.toStringAsFixed(2));
       _publishDirectValue('location_accuracy', accuracy.toStringAsFixed(2));
       _publishDirectValue('location_status', locationStatus);
+
+      // Publisher counters, at most every five minutes
+      _sensorPublisher.publishValue(
+        'kingkiosk/${deviceName.value}/diagnostics/publisher',
+        jsonEncode(_sensorPublisher.stats()),
+        policy: SensorPolicy(minInterval: Duration(minutes: 5)),
+        retain: false,
+      );
+
+      // Runner frame clock histograms (Linux only)
+      _publishFrameTimings();
     } catch (e) {
       print('Error publishing sensor values: $e');
     }
   }
 
+  /// Publish the runner's frame clock statistics for its last complete
+  /// window: presented frame rate, interval and latency percentiles, jank
+  Future<void> _publishFrameTimings() async {
+    if (!NativeFrameTimings.isSupported) return;
+    final timings = await NativeFrameTimings.get();
+    if (timings == null || timings.window.frames == 0) return;
+    if (!isConnected.value) return;
+
+    final window = timings.window;
+    final payload = {
+      'fps': double.parse(window.fps.toStringAsFixed(1)),
+      'refresh_hz': double.parse(timings.refreshHz.toStringAsFixed(1)),
+      'frames': window.frames,
+      'janky_frames': window.jankyFrames,
+      'jank_percent': double.parse((window.jankRatio * 100).toStringAsFixed(2)),
+      'missed_vsyncs': window.missedVsyncs,
+      'idle_gaps': window.idleGaps,
+      'interval_p50_ms': window.interval.p50Ms,
+      'interval_p99_ms': window.interval.p99Ms,
+      'interval_max_ms': window.interval.maxMs,
+      'paint_p99_ms': window.paint.p99Ms,
+      'present_latency_p50_ms': window.presentLatency.p50Ms,
+      'present_latency_p99_ms': window.presentLatency.p99Ms,
+      'window_ms': timings.windowMs,
+    };
+    // One window's worth at most once a minute
+    _sensorPublisher.publishValue(
+      'kingkiosk/${deviceName.value}/frame_timing',
+      jsonEncode(payload),
+      policy: SensorPolicy(minInterval: Duration(seconds: 60)),
+      retain: false,
+    );
+  }
+
   /// Subscribe to command topics
   void _subscribeToCommands() {
     if (!isConnected.value) {
@@ -820,12 +1076,13 @@ class MqttService extends GetxService {
     final commandsTopic = 'kingkiosk/${deviceName.value}/commands';
     try {
       print('🔄 Subscribing to command topic: ${commandTopic}');
-      _client!.subscribe(commandTopic, MqttQos.atMostOnce);
+      _subscribeTopic(commandTopic, MqttQos.atMostOnce);
       print('🔄 Subscribing to commands topic: ${commandsTopic}');
-      _client!.subscribe(commandsTopic, MqttQos.atMostOnce);
+      _subscribeTopic(commandsTopic, MqttQos.atMostOnce);
       print(
           '✅ Successfully requested subscription to command topics: ${commandTopic}, ${commandsTopic}');
       print('ℹ️ Device name being used: ${deviceName.value}');
+      if (_useNative) return;
       try {
         print('ℹ️ Attempting to list active subscriptions:');
         final connectionStatus = _client!.connectionStatus;
@@ -840,6 +1097,15 @@ class MqttService extends GetxService {
     }
   }
 
+  void _subscribeTopic(String topic, MqttQos qos) {
+    if (_useNative) {
+      NativeMqttClient.subscribe(topic,
+          qos: qos == MqttQos.atMostOnce ? 0 : 1);
+    } else {
+      _client!.subscribe(topic, qos);
+    }
+  }
+
   /// Process received commands
   Future<void> _processCommand(String command) async {
     print('🎯 Processing command: "$command"');
@@ -885,6 +1151,12 @@ class MqttService extends GetxService {
       return;
     }
 
+    await _processCommandObject(cmdObj);
+  }
+
+  /// Dispatch a parsed command; the native transport delivers commands
+  /// already parsed and comes straight here
+  Future<void> _processCommandObject(dynamic cmdObj) async {
     if (cmdObj is Map) {
       print('🔄 [MQTT] cmdObj["command"]: ${cmdObj['command']}');
     } else {
@@ -908,28 +1180,8 @@ class MqttService extends GetxService {
     // --- Handle batch commands array first ---
     if (cmdObj['commands'] is List ||
         cmdObj['command']?.toString().toLowerCase() == 'batch') {
-      // Check if another batch script is already running
-      if (_batchScriptRunning) {
-        final errorMsg =
-            'Cannot start new batch script: another batch script is already running (ID: $_currentBatchId)';
-        print('❌ [MQTT] $errorMsg');
-
-        // Publish error to response topic if specified
-        if (cmdObj['response_topic'] != null) {
-          publishJsonToTopic(
-              cmdObj['response_topic'],
-              {
-                'success': false,
-                'error': errorMsg,
-                'current_batch_id': _currentBatchId,
-                'batch_status': batchStatus.value,
-              },
-              retain: false);
-        }
-        return;
-      }
-
-      // Start managed batch processing
+      // Start managed batch processing; a batch with the same name that is
+      // still running is rejected there
       await _processManagedBatch(cmdObj);
       return;
     } // --- Only handle commands that are JSON with a 'command' key ---
@@ -1438,7 +1690,7 @@ class MqttService extends GetxService {
           print('🧪 [MQTT] Running media health check test (no reset)');
 
           // Publish health status report
-          if (isConnected.value && _client != null) {
+          if (_isTransportConnected) {
             publishJsonToTopic(
               'kingkiosk/${deviceName.value}/status/media_health',
               healthStatus,
@@ -1474,7 +1726,7 @@ class MqttService extends GetxService {
 
           // Send status report back to MQTT if enabled
           try {
-            if (isConnected.value && _client != null) {
+            if (_isTransportConnected) {
               final topic = 'kingkiosk/${deviceName.value}/status/media_reset';
 
               // Create report payload
@@ -1809,7 +2061,8 @@ class MqttService extends GetxService {
 
     // --- kill_batch_script command to stop running batch script ---
     if (cmdObj['command']?.toString().toLowerCase() == 'kill_batch_script') {
-      final result = _killBatchScript();
+      final result = _killBatchScript(
+          (cmdObj['name'] ?? cmdObj['batch_id'])?.toString());
       print('🛑 [MQTT] Kill batch script result: $result');
 
       // Publish result to response topic if specified
@@ -1820,6 +2073,7 @@ class MqttService extends GetxService {
               'success': result['success'],
               'message': result['message'],
               'killed_batch_id': result['killed_batch_id'],
+              'killed_batch_ids': result['killed_batch_ids'],
               'command': 'kill_batch_script',
               'timestamp': DateTime.now().toIso8601String(),
             },
@@ -1830,14 +2084,18 @@ class MqttService extends GetxService {
 
     // --- batch_status command to check current batch status ---
     if (cmdObj['command']?.toString().toLowerCase() == 'batch_status') {
+      final name = (cmdObj['name'] ?? cmdObj['batch_id'])?.toString();
+      final run = name != null ? _batchEngine[name] : null;
       final status = {
-        'success': true,
-        'batch_running': _batchScriptRunning,
-        'batch_id': _currentBatchId,
-        'status': batchStatus.value,
-        'progress': batchProgress.value,
-        'total': batchTotal.value,
-        'kill_requested': _batchKillRequested,
+        'success': name == null || run != null,
+        'batch_running': _batchEngine.runs.isNotEmpty,
+        'batch_id': name ?? _currentBatchId,
+        'status': run?.status ?? batchStatus.value,
+        'progress': run?.progress ?? batchProgress.value,
+        'total': run?.total ?? batchTotal.value,
+        'batches': (run != null ? [run] : _batchEngine.runs)
+            .map((run) => run.toJson())
+            .toList(),
         'command': 'batch_status',
         'timestamp': DateTime.now().toIso8601String(),
       };
@@ -2059,24 +2317,29 @@ class MqttService extends GetxService {
     }
   }
 
-  /// Publish a direct value to a sensor topic without wrapping it in JSON
+  /// Publish a direct value to a sensor topic without wrapping it in JSON,
+  /// if it changed enough since the last publish
   void _publishDirectValue(String name, String value) {
     if (!isConnected.value) return;
 
-    final topic = 'kingkiosk/${deviceName.value}/$name';
-    final builder = MqttClientPayloadBuilder();
-
     // Directly publish the value as a string - Home Assistant expects this format
-    builder.addString(value);
-
-    _client!.publishMessage(
-      topic,
-      MqttQos.atLeastOnce,
-      builder.payload!,
-      retain: true,
+    _sensorPublisher.publishValue(
+      'kingkiosk/${deviceName.value}/$name',
+      value,
+      policy: _sensorPolicies[name] ?? const SensorPolicy(),
     );
   }
 
+  /// Publish a retained discovery config unless the broker already has the
+  /// same payload from us
+  void _publishDiscoveryConfig(String name, String topic, String payload) {
+    if (_sensorPublisher.publishRetainedConfig(topic, payload)) {
+      print('MQTT DEBUG: Published discovery config for $name');
+    } else {
+      print('MQTT DEBUG: Discovery config for $name unchanged or offline, skipped');
+    }
+  }
+
   /// Force publish all sensors immediately - used for debugging
   void forcePublishAllSensors() {
     if (!isConnected.value) {
@@ -2090,43 +2353,39 @@ class MqttService extends GetxService {
       // Enhancing with more device info logging
       print('MQTT DEBUG: Current device information:');
       print('MQTT DEBUG: Device name: ${deviceName.value}');
-      print(
-          'MQTT DEBUG: Connection state: ${_client!.connectionStatus!.state}');
-      print('MQTT DEBUG: Client ID: ${_client!.clientIdentifier}');
+      if (_client != null) {
+        print(
+            'MQTT DEBUG: Connection state: ${_client!.connectionStatus!.state}');
+        print('MQTT DEBUG: Client ID: ${_client!.clientIdentifier}');
 
-      // List all client properties
-      print('MQTT DEBUG: Client properties:');
-      print('MQTT DEBUG: - Keep alive: ${_client!.keepAlivePeriod}');
-      print('MQTT DEBUG: - Auto reconnect: ${_client!.autoReconnect}');
+        // List all client properties
+        print('MQTT DEBUG: Client properties:');
+        print('MQTT DEBUG: - Keep alive: ${_client!.keepAlivePeriod}');
+        print('MQTT DEBUG: - Auto reconnect: ${_client!.autoReconnect}');
 
-      // Try to get connection message details safely
-      try {
-        print(
-            'MQTT DEBUG: - Connection message: ${_client!.connectionMessage.toString()}');
-      } catch (e) {
-        print('MQTT DEBUG: - Connection message not available: $e');
+        // Try to get connection message details safely
+        try {
+          print(
+              'MQTT DEBUG: - Connection message: ${_client!.connectionMessage.toString()}');
+        } catch (e) {
+          print('MQTT DEBUG: - Connection message not available: $e');
+        }
+      } else {
+        print('MQTT DEBUG: Using native transport');
       }
 
-      // First delete existing discovery configs
+      // First delete existing discovery configs, and forget everything the
+      // publisher has sent so none of it is skipped
       _deleteAllDiscoveryConfigs();
+      _sensorPublisher.invalidateAll();
+      _subscribeToCommands();
 
-      // Wait briefly
-      Future.delayed(Duration(milliseconds: 300), () {
-        // Then re-create all discovery configs with debug logging
+      // Give Home Assistant a moment to drop the entities, then re-create
+      // them and send every value in one pass
+      Future.delayed(Duration(milliseconds: 500), () {
         _setupHomeAssistantDiscoveryWithDebug();
-
-        // Wait for discovery to be processed, then publish values
-        Future.delayed(Duration(milliseconds: 500), () {
-          _publishSensorValuesWithDebug();
-
-          // Run MQTT messaging tests to verify functionality with longer delays
-          print('MQTT DEBUG: Running MQTT messaging tests after 2 seconds...');
-          Future.delayed(Duration(seconds: 2), () {
-            // First, re-subscribe to important topics
-            _subscribeToCommands();
-            // Then run the test (removed testCommandProcessing call)
-          });
-        });
+        _publishSensorValuesWithDebug();
+        print('MQTT DEBUG: Publisher counters: ${_sensorPublisher.stats()}');
       });
     } catch (e) {
       print('MQTT DEBUG: Error in force publish: $e');
@@ -2152,15 +2411,17 @@ class MqttService extends GetxService {
         'location_status',
         'object_detection',
         'person_presence',
-        'person_confidence'
+        'person_confidence',
+        'frame_rate',
+        'frame_interval_p99',
+        'missed_vsyncs',
+        'present_latency_p99'
       ];
 
       for (final sensor in sensors) {
         final topic = 'homeassistant/sensor/${deviceName.value}_$sensor/config';
         // To delete a retained message, publish an empty message
-        _client!.publishMessage(
-            topic, MqttQos.atLeastOnce, MqttClientPayloadBuilder().payload!,
-            retain: true);
+        _sensorPublisher.publishRetainedConfig(topic, '', force: true);
         print('MQTT DEBUG: Deleted discovery config for $sensor');
       }
     } catch (e) {
@@ -2199,11 +2460,58 @@ class MqttService extends GetxService {
       // Person Detection Sensors
       print('MQTT DEBUG: Setting up person detection sensors');
       _setupPersonDetectionDiscovery();
+
+      // Frame clock sensors (Linux runner only)
+      if (NativeFrameTimings.isSupported) {
+        print('MQTT DEBUG: Setting up frame timing sensors');
+        _setupFrameTimingDiscovery();
+      }
     } catch (e) {
       print('MQTT DEBUG: Error setting up discovery: $e');
     }
   }
 
+  /// Set up frame clock discovery sensors from the frame_timing payload
+  void _setupFrameTimingDiscovery() {
+    final stateTopic = 'kingkiosk/${deviceName.value}/frame_timing';
+
+    _setupJsonDiscoverySensor(
+      'frame_rate',
+      'Presented Frame Rate',
+      stateTopic,
+      '{{ value_json.fps }}',
+      unit: 'fps',
+      icon: 'mdi:monitor-eye',
+      attributes: true,
+    );
+
+    _setupJsonDiscoverySensor(
+      'frame_interval_p99',
+      'Frame Interval p99',
+      stateTopic,
+      '{{ value_json.interval_p99_ms }}',
+      unit: 'ms',
+      icon: 'mdi:timer-sand',
+    );
+
+    _setupJsonDiscoverySensor(
+      'missed_vsyncs',
+      'Missed Vsyncs',
+      stateTopic,
+      '{{ value_json.missed_vsyncs }}',
+      icon: 'mdi:monitor-off',
+    );
+
+    _setupJsonDiscoverySensor(
+      'present_latency_p99',
+      'Present Latency p99',
+      stateTopic,
+      '{{ value_json.present_latency_p99_ms }}',
+      unit: 'ms',
+      icon: 'mdi:timer-outline',
+    );
+  }
+
   /// Set up person detection discovery sensors with JSON value templates
   void _setupPersonDetectionDiscovery() {
     // Object Detection sensor (JSON payload)
@@ -2236,6 +2544,44 @@ class MqttService extends GetxService {
       unit: '%',
       icon: 'mdi:percent',
     );
+
+    // Motion gate sensors (native engine only; published with detections)
+    _setupJsonDiscoverySensor(
+      'motion_score',
+      'Motion Score',
+      'kingkiosk/${deviceName.value}/motion_gate',
+      '{{ (value_json.motion_score * 100) | round(1) }}',
+      unit: '%',
+      icon: 'mdi:motion-sensor',
+      attributes: true,
+    );
+
+    _setupJsonDiscoverySensor(
+      'inference_skipped_frames',
+      'Inference Skipped Frames',
+      'kingkiosk/${deviceName.value}/motion_gate',
+      '{{ value_json.frames_skipped }}',
+      icon: 'mdi:debug-step-over',
+    );
+
+    // Adaptive scheduler sensors (native engine only)
+    _setupJsonDiscoverySensor(
+      'detection_mode',
+      'Detection Mode',
+      'kingkiosk/${deviceName.value}/detection_scheduler',
+      '{{ value_json.mode }}',
+      icon: 'mdi:speedometer',
+      attributes: true,
+    );
+
+    _setupJsonDiscoverySensor(
+      'detection_interval',
+      'Detection Interval',
+      'kingkiosk/${deviceName.value}/detection_scheduler',
+      '{{ value_json.interval_ms }}',
+      unit: 'ms',
+      icon: 'mdi:timer-outline',
+    );
   }
 
   /// Set up a JSON-based discovery sensor with value templates
@@ -2288,16 +2634,7 @@ class MqttService extends GetxService {
     print('MQTT DEBUG: Discovery payload for $name: $payload');
     print('MQTT DEBUG: Publishing to topic: $discoveryTopic');
 
-    final builder = MqttClientPayloadBuilder();
-    builder.addString(payload);
-
-    _client!.publishMessage(
-      discoveryTopic,
-      MqttQos.atLeastOnce,
-      builder.payload!,
-      retain: true,
-    );
-    print('MQTT DEBUG: Published discovery config for $name');
+    _publishDiscoveryConfig(name, discoveryTopic, payload);
   }
 
   /// Set up a single discovery sensor with detailed logging
@@ -2355,16 +2692,7 @@ class MqttService extends GetxService {
     print('MQTT DEBUG: Discovery payload for $name: $payload');
     print('MQTT DEBUG: Publishing to topic: $discoveryTopic');
 
-    final builder = MqttClientPayloadBuilder();
-    builder.addString(payload);
-
-    _client!.publishMessage(
-      discoveryTopic,
-      MqttQos.atLeastOnce,
-      builder.payload!,
-      retain: true,
-    );
-    print('MQTT DEBUG: Published discovery config for $name');
+    _publishDiscoveryConfig(name, discoveryTopic, payload);
   }
 
   /// Publish sensor values with detailed debug info
@@ -2448,19 +2776,12 @@ class MqttService extends GetxService {
     if (!isConnected.value) return;
 
     final topic = 'kingkiosk/${deviceName.value}/$name';
-    final builder = MqttClientPayloadBuilder();
-
-    // Directly publish the value as a string
-    builder.addString(value);
 
     print('MQTT DEBUG: Publishing to topic $topic: "$value"');
 
-    _client!.publishMessage(
-      topic,
-      MqttQos.atLeastOnce,
-      builder.payload!,
-      retain: true,
-    );
+    // Directly publish the value as a string; forced, but recorded so the
+    // next periodic round only sends changes
+    _sensorPublisher.publishValue(topic, value, force: true);
     print('MQTT DEBUG: Published value for $name');
   }
 
@@ -2512,7 +2833,7 @@ class MqttService extends GetxService {
               'person_detection': status,
               'timestamp': DateTime.now().toIso8601String(),
             }));
-            _client?.publishMessage(
+            _publishMessage(
                 confirmTopic, MqttQos.atLeastOnce, builder.payload!);
             print('👤 [MQTT] Sent person detection confirmation message');
           } catch (e) {
@@ -2543,7 +2864,7 @@ class MqttService extends GetxService {
               'error': 'PersonDetectionService not available',
               'timestamp': DateTime.now().toIso8601String(),
             }));
-            _client?.publishMessage(
+            _publishMessage(
                 confirmTopic, MqttQos.atLeastOnce, builder.payload!);
             print('👤 [MQTT] Sent person detection error message');
           } catch (e) {
@@ -2615,7 +2936,7 @@ class MqttService extends GetxService {
               'timestamp': DateTime.now().toIso8601String(),
               'path': path
             }));
-            _client?.publishMessage(
+            _publishMessage(
                 confirmTopic, MqttQos.atLeastOnce, builder.payload!,
                 retain: false);
             print('📸 [MQTT] Screenshot confirmation published');
@@ -2636,7 +2957,7 @@ class MqttService extends GetxService {
             'timestamp': DateTime.now().toIso8601String(),
             'error': e.toString()
           }));
-          _client?.publishMessage(
+          _publishMessage(
               confirmTopic, MqttQos.atLeastOnce, builder.payload!,
               retain: false);
         } catch (_) {
@@ -2655,7 +2976,7 @@ class MqttService extends GetxService {
       final topic = 'kingkiosk/${deviceName.value}/screenshot';
       final builder = MqttClientPayloadBuilder();
       builder.addString(base64Image);
-      _client?.publishMessage(topic, MqttQos.atLeastOnce, builder.payload!,
+      _publishMessage(topic, MqttQos.atLeastOnce, builder.payload!,
           retain: true);
       print('📤 Published screenshot to Home Assistant');
     } catch (e) {
@@ -2691,7 +3012,7 @@ class MqttService extends GetxService {
       final payload = jsonEncode(discoveryConfig);
       final builder = MqttClientPayloadBuilder();
       builder.addString(payload);
-      _client?.publishMessage(
+      _publishMessage(
           discoveryTopic, MqttQos.atLeastOnce, builder.payload!,
           retain: true);
       print('✅ Setup Home Assistant discovery for screenshot sensor');
@@ -3541,8 +3862,7 @@ class MqttService extends GetxService {
             'enabled': enabled,
             'timestamp': DateTime.now().toIso8601String(),
           }));
-          _client?.publishMessage(
-              confirmTopic, MqttQos.atLeastOnce, builder.payload!);
+          _publishMessage(confirmTopic, MqttQos.atLeastOnce, builder.payload!);
           print('🌟 [MQTT] Sent halo effect confirmation message');
         } catch (e) {
           print('❌ Error sending confirmation message: $e');
@@ -3716,8 +4036,7 @@ class MqttService extends GetxService {
         'enabled': enabled,
         'timestamp': DateTime.now().toIso8601String(),
       }));
-      _client?.publishMessage(
-          confirmTopic, MqttQos.atLeastOnce, builder.payload!);
+      _publishMessage(confirmTopic, MqttQos.atLeastOnce, builder.payload!);
       print('🌟 [MQTT] Sent window halo effect confirmation message');
     }
   }
@@ -0,0 +1,113 @@
+import 'dart:async';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:flutter/foundation.dart';
+import 'package:flutter/services.dart';
+
+/// One visualizer's bars from the native spectrum analyzer
+/// (linux/plugins/kiosk_audio). [frame] holds [bars] smoothed levels
+/// followed by [bars] peak levels, all 0..1, and is replaced at the
+/// analyzer's frame rate.
+class NativeSpectrum {
+  final int id;
+  final int bars;
+  final double fps;
+  final ValueNotifier<Float32List> frame;
+
+  NativeSpectrum._(this.id, this.bars, this.fps)
+      : frame = ValueNotifier(Float32List(bars * 2));
+}
+
+/// Client for the native audio analysis engine registered by the Linux
+/// runner. The plugin taps what the default output is playing (PulseAudio
+/// or PipeWire monitor), so every tile sees the mix of all playing media.
+class NativeAudioSpectrum {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/audio',
+  );
+  static const EventChannel _spectrumChannel = EventChannel(
+    'com.ki.king_kiosk/audio/spectrum',
+  );
+
+  static final Map<int, NativeSpectrum> _spectra = {};
+  static StreamSubscription<dynamic>? _subscription;
+
+  /// Only the Linux runner ships the native engine
+  static bool get isSupported => Platform.isLinux;
+
+  /// Start an analyzer; returns null when the plugin or a capture backend
+  /// is missing, in which case the caller shows a flat spectrum
+  static Future<NativeSpectrum?> create({
+    int bars = 64,
+    double fps = 30,
+    Map<String, dynamic> options = const {},
+  }) async {
+    if (!isSupported) return null;
+    try {
+      final info = await _channel.invokeMapMethod<String, dynamic>(
+        'createSpectrum',
+        {...options, 'bars': bars, 'fps': fps},
+      );
+      if (info == null) return null;
+      final spectrum = NativeSpectrum._(
+        info['id'] as int,
+        info['bars'] as int,
+        (info['fps'] as num).toDouble(),
+      );
+      _spectra[spectrum.id] = spectrum;
+      _subscription ??=
+          _spectrumChannel.receiveBroadcastStream().listen(_onFrame);
+      return spectrum;
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Native audio spectrum unavailable: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Pause or resume analysis; capture stops while no analyzer is active
+  static Future<void> setActive(NativeSpectrum spectrum, bool active) async {
+    try {
+      await _channel.invokeMethod(
+        'setSpectrumActive',
+        {'id': spectrum.id, 'active': active},
+      );
+    } catch (e) {
+      print('⚠️ Failed to update native audio spectrum: $e');
+    }
+  }
+
+  static Future<void> dispose(NativeSpectrum spectrum) async {
+    _spectra.remove(spectrum.id);
+    if (_spectra.isEmpty) {
+      await _subscription?.cancel();
+      _subscription = null;
+    }
+    try {
+      await _channel.invokeMethod('disposeSpectrum', {'id': spectrum.id});
+    } catch (e) {
+      print('⚠️ Failed to dispose native audio spectrum: $e');
+    }
+  }
+
+  static Future<Map<String, dynamic>?> getInfo() async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>(
+        'getSpectrumInfo',
+      );
+    } catch (e) {
+      return null;
+    }
+  }
+
+  static void _onFrame(dynamic event) {
+    if (event is! Map) return;
+    final spectrum = _spectra[event['id']];
+    final frame = event['frame'];
+    if (spectrum != null && frame is Float32List) {
+      spectrum.frame.value = frame;
+    }
+  }
+}
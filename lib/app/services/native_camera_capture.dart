@@ -0,0 +1,405 @@
+import 'dart:io';
+import 'package:flutter/services.dart';
+
+/// A V4L2 camera node reported by the native capture backend
+class NativeCamera {
+  final String path;
+  final String name;
+
+  /// Matches the deviceId flutter_webrtc reports for the same camera
+  final String busInfo;
+
+  NativeCamera({required this.path, required this.name, required this.busInfo});
+}
+
+/// A camera shown in a Flutter texture through the native camera hub
+class NativeCameraPreview {
+  final int consumerId;
+  final int textureId;
+  final String device;
+
+  /// Capture size the camera actually runs at, which the hub may have
+  /// raised for another consumer of the same camera
+  int captureWidth;
+  int captureHeight;
+
+  NativeCameraPreview({
+    required this.consumerId,
+    required this.textureId,
+    required this.device,
+    this.captureWidth = 0,
+    this.captureHeight = 0,
+  });
+
+  double get aspectRatio => captureWidth > 0 && captureHeight > 0
+      ? captureWidth / captureHeight
+      : 4 / 3;
+}
+
+/// Client for the V4L2 capture backend in linux/plugins/kiosk_vision.
+///
+/// Frames are captured from mmap'd driver buffers and published straight
+/// into the native frame ring the detection engine reads from, so
+/// person detection does not need a WebRTC getUserMedia stream.
+///
+/// Each camera is opened once by the native camera hub and shared: the
+/// detector ([start]) and any number of previews ([acquirePreview]) get
+/// their frames at their own rate and size from the same stream, instead
+/// of each opening the device, which V4L2 mostly refuses anyway.
+class NativeCameraCapture {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/vision',
+  );
+
+  bool _isRunning = false;
+  bool _isStream = false;
+  String? activeDevice;
+  String? activeFormat;
+
+  static bool get isSupported => Platform.isLinux;
+
+  bool get isRunning => _isRunning;
+
+  /// Whether the ring is fed by [startStream] rather than a local camera
+  bool get isStream => _isStream;
+
+  /// Whether [deviceId] names a network camera or a video file rather than
+  /// a local camera: rtsp://, http(s)://, file:// or a path outside /dev
+  static bool isStreamUrl(String? deviceId) {
+    if (deviceId == null || deviceId.isEmpty) return false;
+    return deviceId.contains('://') ||
+        (deviceId.startsWith('/') && !deviceId.startsWith('/dev/'));
+  }
+
+  Future<List<NativeCamera>> listCameras() async {
+    if (!isSupported) return [];
+    try {
+      final cameras = await _channel.invokeListMethod<dynamic>('listCameras');
+      return (cameras ?? [])
+          .cast<Map<dynamic, dynamic>>()
+          .map((c) => NativeCamera(
+                path: c['path'] as String,
+                name: c['name'] as String,
+                busInfo: c['busInfo'] as String,
+              ))
+          .toList();
+    } on MissingPluginException {
+      return [];
+    } on PlatformException catch (e) {
+      print('⚠️ Failed to list V4L2 cameras: ${e.message}');
+      return [];
+    }
+  }
+
+  /// Start capturing. [deviceId] may be a /dev/video path or a
+  /// flutter_webrtc deviceId; the first camera is used when it matches none.
+  /// [format] is one of auto, yuyv, nv12 or mjpeg. [publishWidth] and
+  /// [publishHeight] downscale frames before they reach the ring.
+  Future<bool> start({
+    String? deviceId,
+    int width = 640,
+    int height = 480,
+    int fps = 15,
+    double publishFps = 5,
+    String format = 'auto',
+    int publishWidth = 0,
+    int publishHeight = 0,
+  }) async {
+    if (!isSupported) return false;
+
+    final camera = await _resolveCamera(deviceId);
+    if (camera == null) return false;
+
+    try {
+      final info = await _channel.invokeMapMethod<String, dynamic>(
+        'startCapture',
+        {
+          'device': camera.path,
+          'width': width,
+          'height': height,
+          'fps': fps,
+          'publishFps': publishFps,
+          'format': format,
+          'publishWidth': publishWidth,
+          'publishHeight': publishHeight,
+        },
+      );
+      _isRunning = true;
+      _isStream = false;
+      activeDevice = camera.path;
+      activeFormat = info?['format'] as String?;
+      print(
+        '📹 Native V4L2 capture started on ${camera.path} (${camera.name}): '
+        '${info?['width']}x${info?['height']} $activeFormat '
+        '@ ${(info?['fps'] as double? ?? 0).toStringAsFixed(1)}fps',
+      );
+      return true;
+    } on MissingPluginException {
+      print('⚠️ Native capture not registered on this platform');
+    } on PlatformException catch (e) {
+      print('⚠️ Native V4L2 capture failed on ${camera.path}: ${e.message}');
+    }
+    _isRunning = false;
+    return false;
+  }
+
+  /// Feed the ring from an IP camera (RTSP, HTTP MJPEG) or a video file,
+  /// which loops. Connecting and reconnecting happen natively in the
+  /// background, so this returns true as soon as the source is set up;
+  /// [getInfo] reports `connected` and `lastError`. Frames are only decoded
+  /// as far as [publishFps] needs them, and keyframes only while [setIdle]
+  /// is on.
+  Future<bool> startStream({
+    required String url,
+    double publishFps = 5,
+    int publishWidth = 0,
+    int publishHeight = 0,
+    bool rtspTcp = true,
+  }) async {
+    if (!isSupported) return false;
+    try {
+      await _channel.invokeMapMethod<String, dynamic>(
+        'startCapture',
+        {
+          'url': url,
+          'publishFps': publishFps,
+          'publishWidth': publishWidth,
+          'publishHeight': publishHeight,
+          'rtspTcp': rtspTcp,
+        },
+      );
+      _isRunning = true;
+      _isStream = true;
+      activeDevice = url;
+      activeFormat = 'stream';
+      print('📹 Native stream source started: $url');
+      return true;
+    } on MissingPluginException {
+      print('⚠️ Native capture not registered on this platform');
+    } on PlatformException catch (e) {
+      print('⚠️ Native stream source failed for $url: ${e.message}');
+    }
+    _isRunning = false;
+    _isStream = false;
+    return false;
+  }
+
+  /// Decode only keyframes of a stream source while the detector has
+  /// nothing to do; no effect on local cameras
+  Future<void> setIdle(bool idle) async {
+    if (!_isRunning || !_isStream) return;
+    try {
+      await _channel.invokeMethod('setCaptureIdle', {'idle': idle});
+    } catch (e) {
+      print('⚠️ Failed to set native stream idle: $e');
+    }
+  }
+
+  Future<NativeCamera?> _resolveCamera(String? deviceId) async {
+    final cameras = await listCameras();
+    if (cameras.isEmpty) return null;
+    return cameras.firstWhere(
+      (c) => c.path == deviceId || c.busInfo == deviceId,
+      orElse: () => cameras.first,
+    );
+  }
+
+  /// Show a camera in a new texture, sharing the stream with the detector
+  /// and other previews of the same camera. [width], [height] and [fps]
+  /// are the least the preview needs from the camera; frames reach the
+  /// texture at most [publishFps] times a second, at [publishWidth] x
+  /// [publishHeight] (0 for the capture size). Returns null when the
+  /// camera or the hub is unavailable; pass the result to [releasePreview].
+  Future<NativeCameraPreview?> acquirePreview({
+    String? deviceId,
+    int width = 640,
+    int height = 480,
+    int fps = 15,
+    double publishFps = 15,
+    int publishWidth = 0,
+    int publishHeight = 0,
+    String format = 'auto',
+  }) async {
+    if (!isSupported) return null;
+
+    final camera = await _resolveCamera(deviceId);
+    if (camera == null) return null;
+    try {
+      final info = await _channel.invokeMapMethod<String, dynamic>(
+        'acquireCamera',
+        {
+          'device': camera.path,
+          'width': width,
+          'height': height,
+          'fps': fps,
+          'publishFps': publishFps,
+          'format': format,
+          'publishWidth': publishWidth,
+          'publishHeight': publishHeight,
+        },
+      );
+      if (info == null) return null;
+      final preview = info['preview'] as Map<dynamic, dynamic>;
+      print(
+        '📹 Native camera preview on ${camera.path}: '
+        '${info['width']}x${info['height']} ${info['format']}, '
+        'texture ${preview['textureId']}',
+      );
+      return NativeCameraPreview(
+        consumerId: info['consumerId'] as int,
+        textureId: preview['textureId'] as int,
+        device: camera.path,
+        captureWidth: info['width'] as int,
+        captureHeight: info['height'] as int,
+      );
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Native camera preview failed on ${camera.path}: '
+          '${e.message}');
+      return null;
+    }
+  }
+
+  /// Change the rate and size frames reach [preview] at, without touching
+  /// the stream
+  Future<bool> updatePreview(
+    NativeCameraPreview preview, {
+    required double publishFps,
+    int publishWidth = 0,
+    int publishHeight = 0,
+  }) async {
+    if (!isSupported) return false;
+    try {
+      final info = await _channel.invokeMapMethod<String, dynamic>(
+        'updateCameraConsumer',
+        {
+          'consumerId': preview.consumerId,
+          'publishFps': publishFps,
+          'publishWidth': publishWidth,
+          'publishHeight': publishHeight,
+        },
+      );
+      if (info == null) return false;
+      preview.captureWidth = info['width'] as int;
+      preview.captureHeight = info['height'] as int;
+      return true;
+    } catch (e) {
+      print('⚠️ Failed to update native camera preview: $e');
+      return false;
+    }
+  }
+
+  /// Dispose the texture of [preview]; the camera closes once nothing else
+  /// uses it
+  Future<void> releasePreview(NativeCameraPreview preview) async {
+    if (!isSupported) return;
+    try {
+      await _channel.invokeMethod(
+        'releaseCamera',
+        {'consumerId': preview.consumerId},
+      );
+    } catch (e) {
+      print('⚠️ Failed to release native camera preview: $e');
+    }
+  }
+
+  /// Open cameras with their capture stats and consumers
+  Future<List<Map<String, dynamic>>> getHubInfo() async {
+    if (!isSupported) return [];
+    try {
+      final sessions =
+          await _channel.invokeListMethod<dynamic>('getCameraHubInfo');
+      return (sessions ?? [])
+          .map((s) => Map<String, dynamic>.from(s as Map))
+          .toList();
+    } catch (e) {
+      return [];
+    }
+  }
+
+  Future<void> stop() async {
+    if (!_isRunning) return;
+    _isRunning = false;
+    _isStream = false;
+    activeDevice = null;
+    activeFormat = null;
+    try {
+      await _channel.invokeMethod('stopCapture');
+    } catch (e) {
+      print('⚠️ Failed to stop native capture: $e');
+    }
+  }
+
+  /// Change how often and at what size frames are published into the ring
+  /// without restarting the stream. 0 keeps every frame / the capture size.
+  Future<bool> setPublishing({
+    required double publishFps,
+    int publishWidth = 0,
+    int publishHeight = 0,
+  }) async {
+    if (!_isRunning) return false;
+    try {
+      await _channel.invokeMethod('setCapturePublishing', {
+        'publishFps': publishFps,
+        'publishWidth': publishWidth,
+        'publishHeight': publishHeight,
+      });
+      return true;
+    } catch (e) {
+      print('⚠️ Failed to update native capture publishing: $e');
+      return false;
+    }
+  }
+
+  /// Record the frames fed to the detector to [path] for offline replay
+  /// with the kiosk_vision_replay tool. [maxMb] of 0 records until
+  /// [stopRecording]; [metadata] is stored in the file header.
+  Future<Map<String, dynamic>?> startRecording(
+    String path, {
+    int maxMb = 0,
+    Map<String, String> metadata = const {},
+  }) async {
+    if (!isSupported) return null;
+    try {
+      final stats = await _channel.invokeMapMethod<String, dynamic>(
+        'startRecording',
+        {'path': path, 'maxMb': maxMb, 'metadata': metadata},
+      );
+      print('⏺️ Recording detector frames to $path');
+      return stats;
+    } on PlatformException catch (e) {
+      print('⚠️ Failed to start frame recording: ${e.message}');
+      return null;
+    }
+  }
+
+  Future<Map<String, dynamic>?> stopRecording() async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>('stopRecording');
+    } catch (e) {
+      print('⚠️ Failed to stop frame recording: $e');
+      return null;
+    }
+  }
+
+  Future<Map<String, dynamic>?> getRecordingInfo() async {
+    if (!isSupported) return null;
+    try {
+      return await _channel
+          .invokeMapMethod<String, dynamic>('getRecordingInfo');
+    } catch (e) {
+      return null;
+    }
+  }
+
+  Future<Map<String, dynamic>?> getInfo() async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>('getCaptureInfo');
+    } catch (e) {
+      return null;
+    }
+  }
+}
@@ -0,0 +1,174 @@
+import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:flutter/services.dart';
+
+/// Source layouts understood by the native converter
+enum YuvFormat { yuyv, nv12, i420 }
+
+/// Packed output layouts, in the order of the native PixelFormat enum
+enum RgbFormat { rgba, bgra, rgb }
+
+typedef _ConvertYuvNative = Int32 Function(
+  Pointer<Uint8> data,
+  IntPtr size,
+  Int32 format,
+  Int32 width,
+  Int32 height,
+  Int32 stride,
+  Pointer<Uint8> dst,
+  Int32 dstStride,
+  Int32 dstWidth,
+  Int32 dstHeight,
+  Int32 dstFormat,
+);
+typedef _ConvertYuv = int Function(
+  Pointer<Uint8> data,
+  int size,
+  int format,
+  int width,
+  int height,
+  int stride,
+  Pointer<Uint8> dst,
+  int dstStride,
+  int dstWidth,
+  int dstHeight,
+  int dstFormat,
+);
+typedef _MallocNative = Pointer<Uint8> Function(IntPtr size);
+typedef _Malloc = Pointer<Uint8> Function(int size);
+typedef _FreeNative = Void Function(Pointer<Uint8> pointer);
+typedef _Free = void Function(Pointer<Uint8> pointer);
+
+/// YUV to RGB conversion through the SIMD kernels in
+/// linux/plugins/kiosk_vision, called synchronously over dart:ffi.
+///
+/// The kiosk_vision plugin is linked into the runner, so the exported
+/// kiosk_vision_convert_yuv symbol is looked up in the process itself.
+/// Downscaling is fused into the conversion: pass a smaller [dstWidth] /
+/// [dstHeight] to get e.g. a model-sized frame straight from a camera
+/// buffer.
+class NativeColorConvert {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/vision',
+  );
+
+  static _ConvertYuv? _convert;
+  static _Malloc? _malloc;
+  static _Free? _free;
+  static bool _resolved = false;
+
+  static bool get isSupported => Platform.isLinux && _resolve();
+
+  static bool _resolve() {
+    if (_resolved) return _convert != null;
+    _resolved = true;
+    try {
+      final process = DynamicLibrary.process();
+      _convert = process.lookupFunction<_ConvertYuvNative, _ConvertYuv>(
+        'kiosk_vision_convert_yuv',
+      );
+      _malloc = process.lookupFunction<_MallocNative, _Malloc>('malloc');
+      _free = process.lookupFunction<_FreeNative, _Free>('free');
+    } catch (e) {
+      print('⚠️ Native color conversion unavailable: $e');
+      _convert = null;
+    }
+    return _convert != null;
+  }
+
+  /// Converts [yuv] ([width] x [height], luma row pitch [stride] or tightly
+  /// packed when 0) to [output] pixels at [dstWidth] x [dstHeight], which
+  /// default to the source size. Returns null if the buffer is too small or
+  /// the native library is missing.
+  static Uint8List? convert(
+    Uint8List yuv, {
+    required YuvFormat format,
+    required int width,
+    required int height,
+    int stride = 0,
+    int? dstWidth,
+    int? dstHeight,
+    RgbFormat output = RgbFormat.rgba,
+  }) {
+    if (!isSupported) return null;
+    final outWidth = dstWidth ?? width;
+    final outHeight = dstHeight ?? height;
+    if (outWidth <= 0 || outHeight <= 0) return null;
+    final bytesPerPixel = output == RgbFormat.rgb ? 3 : 4;
+    final dstStride = outWidth * bytesPerPixel;
+    final dstSize = dstStride * outHeight;
+
+    final src = _malloc!(yuv.length);
+    final dst = _malloc!(dstSize);
+    if (src == nullptr || dst == nullptr) {
+      if (src != nullptr) _free!(src);
+      if (dst != nullptr) _free!(dst);
+      return null;
+    }
+    try {
+      src.asTypedList(yuv.length).setAll(0, yuv);
+      final ok = _convert!(
+        src,
+        yuv.length,
+        format.index,
+        width,
+        height,
+        stride,
+        dst,
+        dstStride,
+        outWidth,
+        outHeight,
+        output.index,
+      );
+      if (ok == 0) return null;
+      return Uint8List.fromList(dst.asTypedList(dstSize));
+    } finally {
+      _free!(src);
+      _free!(dst);
+    }
+  }
+
+  /// Checks every SIMD kernel against the scalar reference byte for byte.
+  static Future<Map<String, dynamic>?> verify() async {
+    if (!Platform.isLinux) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>(
+        'verifyColorConversion',
+      );
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Color conversion self-test failed: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Times the SIMD and scalar converters per source format.
+  static Future<Map<String, dynamic>?> benchmark({
+    int srcWidth = 640,
+    int srcHeight = 480,
+    int dstWidth = 300,
+    int dstHeight = 300,
+    int iterations = 200,
+  }) async {
+    if (!Platform.isLinux) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>(
+        'benchmarkColorConversion',
+        {
+          'srcWidth': srcWidth,
+          'srcHeight': srcHeight,
+          'dstWidth': dstWidth,
+          'dstHeight': dstHeight,
+          'iterations': iterations,
+        },
+      );
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Color conversion benchmark failed: ${e.message}');
+      return null;
+    }
+  }
+}
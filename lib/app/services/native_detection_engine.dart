@@ -0,0 +1,555 @@
+import 'dart:async';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:flutter/services.dart';
+
+/// An object followed across frames by the native tracker. Only confirmed
+/// tracks are reported; [misses] > 0 means the box is a prediction while the
+/// detector briefly lost the object.
+class NativeTrack {
+  final int id;
+  final int classId;
+  final double x1, y1, x2, y2;
+  final double score;
+  final int hits;
+  final int misses;
+
+  /// Size of one record in the packed track list sent by the plugin
+  static const int recordSize = 32;
+
+  NativeTrack({
+    required this.id,
+    required this.classId,
+    required this.x1,
+    required this.y1,
+    required this.x2,
+    required this.y2,
+    required this.score,
+    required this.hits,
+    required this.misses,
+  });
+
+  /// Decode the packed records (TrackRecord in kiosk_vision_plugin.cc)
+  static List<NativeTrack> decodeAll(Uint8List bytes) {
+    final data = ByteData.sublistView(bytes);
+    final tracks = <NativeTrack>[];
+    for (int offset = 0;
+        offset + recordSize <= bytes.length;
+        offset += recordSize) {
+      tracks.add(NativeTrack(
+        id: data.getUint32(offset, Endian.host),
+        classId: data.getInt32(offset + 4, Endian.host),
+        x1: data.getFloat32(offset + 8, Endian.host),
+        y1: data.getFloat32(offset + 12, Endian.host),
+        x2: data.getFloat32(offset + 16, Endian.host),
+        y2: data.getFloat32(offset + 20, Endian.host),
+        score: data.getFloat32(offset + 24, Endian.host),
+        hits: data.getUint16(offset + 28, Endian.host),
+        misses: data.getUint16(offset + 30, Endian.host),
+      ));
+    }
+    return tracks;
+  }
+}
+
+/// How the native engine splits a frame before inference
+enum NativeTilingMode {
+  /// One center-crop resize of the whole frame
+  off,
+
+  /// Overlapping grid over the crop, visited within the tile budget
+  grid,
+
+  /// Crops around tracked objects and the motion region
+  roi,
+  gridAndRoi,
+}
+
+/// Result of one frame processed by the native detection engine
+class NativeDetectionResult {
+  /// Packed boxes, [boxStride] floats each: x1, y1, x2, y2, score, classId.
+  /// Empty when [isTracking]; the engine then only reports [tracks]
+  final Float32List boxes;
+
+  /// Confirmed tracks after this frame, when native tracking is enabled
+  final List<NativeTrack> tracks;
+  final bool isTracking;
+  final int rawCount;
+
+  /// Ring frame the boxes belong to; 0 when the frame was sent by value
+  final int frameId;
+  final int frameWidth;
+  final int frameHeight;
+  final Map<String, dynamic> timings;
+
+  /// Set when the native motion gate found the scene unchanged and did not
+  /// run the detector; [boxes] is then empty and the previous detections
+  /// still apply
+  final bool skipped;
+
+  /// Set when the detector ran only because the keep-alive was due
+  final bool keepAlive;
+
+  /// Fraction of the frame that changed, or null with the motion gate off
+  final double? motionScore;
+
+  /// Crops run through the interpreter (1 without tiling) and whether they
+  /// went in as one batch
+  final int crops;
+  final bool batched;
+
+  static const int boxStride = 6;
+
+  NativeDetectionResult({
+    required this.boxes,
+    this.tracks = const [],
+    this.isTracking = false,
+    required this.rawCount,
+    this.frameId = 0,
+    required this.frameWidth,
+    required this.frameHeight,
+    required this.timings,
+    this.skipped = false,
+    this.keepAlive = false,
+    this.motionScore,
+    this.crops = 1,
+    this.batched = false,
+  });
+
+  int get length => boxes.length ~/ boxStride;
+}
+
+/// A frame published into the native frame ring. Only the slot and frame id
+/// cross the channel; the pixels stay in native memory.
+class NativeFrameRef {
+  final int slot;
+  final int frameId;
+  final int timestampUs;
+  final int width;
+  final int height;
+
+  NativeFrameRef({
+    required this.slot,
+    required this.frameId,
+    required this.timestampUs,
+    required this.width,
+    required this.height,
+  });
+
+  factory NativeFrameRef.fromMap(Map<dynamic, dynamic> map) {
+    return NativeFrameRef(
+      slot: map['slot'] as int,
+      frameId: map['frameId'] as int,
+      timestampUs: map['timestampUs'] as int,
+      width: map['width'] as int,
+      height: map['height'] as int,
+    );
+  }
+}
+
+/// Client for the native TensorFlow Lite engine registered by the Linux runner
+/// (linux/plugins/kiosk_vision).
+///
+/// The engine parses the model and allocates tensors once, then keeps the
+/// interpreter warm on its own worker thread, so per-frame calls only pay for
+/// preprocessing, inference and output parsing.
+class NativeDetectionEngine {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/vision',
+  );
+  static const EventChannel _frameChannel = EventChannel(
+    'com.ki.king_kiosk/vision/frames',
+  );
+
+  /// Ring frames older than this are treated as a stalled producer
+  static const Duration frameStaleAfter = Duration(seconds: 1);
+
+  StreamSubscription<dynamic>? _frameSubscription;
+  NativeFrameRef? _latestFrame;
+  DateTime? _latestFrameAt;
+
+  bool _isLoaded = false;
+  int inputWidth = 0;
+  int inputHeight = 0;
+  bool isQuantized = false;
+
+  /// Thread setup the interpreter currently runs with
+  int numThreadsInUse = 0;
+  List<int> cpusInUse = const [];
+  int niceInUse = 0;
+  String? threadWarning;
+
+  /// Only the Linux runner ships the native engine
+  static bool get isSupported => Platform.isLinux;
+
+  bool get isLoaded => _isLoaded;
+
+  /// Newest frame announced by a native producer, or null if none arrived
+  /// within [frameStaleAfter]
+  NativeFrameRef? get freshRingFrame {
+    final at = _latestFrameAt;
+    if (at == null || DateTime.now().difference(at) > frameStaleAfter) {
+      return null;
+    }
+    return _latestFrame;
+  }
+
+  /// Start tracking frames published into the native frame ring
+  void startFrameEvents() {
+    if (!isSupported || _frameSubscription != null) return;
+    _frameSubscription = _frameChannel.receiveBroadcastStream().listen(
+      (event) {
+        _latestFrame = NativeFrameRef.fromMap(event as Map<dynamic, dynamic>);
+        _latestFrameAt = DateTime.now();
+      },
+      onError: (Object e) => print('⚠️ Native frame ring events failed: $e'),
+    );
+  }
+
+  void stopFrameEvents() {
+    _frameSubscription?.cancel();
+    _frameSubscription = null;
+    _latestFrame = null;
+    _latestFrameAt = null;
+  }
+
+  /// Load the model once; returns false if the engine is unavailable.
+  ///
+  /// [numThreads] sizes the interpreter (and XNNPACK) thread pool, 0 for one
+  /// per core minus one. [cpus] pins inference to those CPUs and [nice]
+  /// lowers its priority below the UI; a refused setting is reported in
+  /// [threadWarning] and does not fail the load. The model is warmed up
+  /// before this returns, so the first real frame is not the slow one.
+  Future<bool> loadModel(
+    Uint8List modelBytes, {
+    int numThreads = 0,
+    List<int>? cpus,
+    int nice = 0,
+  }) async {
+    if (!isSupported) return false;
+
+    try {
+      final info = await _channel.invokeMapMethod<String, dynamic>(
+        'loadModel',
+        {
+          'modelBytes': modelBytes,
+          'numThreads': numThreads,
+          if (cpus != null) 'cpus': cpus,
+          'nice': nice,
+        },
+      );
+      if (info == null) return false;
+
+      inputWidth = info['inputWidth'] as int;
+      inputHeight = info['inputHeight'] as int;
+      isQuantized = info['quantized'] as bool;
+      _updateThreadInfo(info);
+      _isLoaded = true;
+      print(
+        '🧠 Native detection engine loaded ${inputWidth}x$inputHeight '
+        '${isQuantized ? "quantized" : "float"} model in '
+        '${(info['modelLoadTime'] as double).toStringAsFixed(1)}ms, '
+        '$numThreadsInUse threads on ${_cpuLabel(cpusInUse)}, '
+        'warm-up ${(info['warmupFirstMs'] as double).toStringAsFixed(1)}ms '
+        'then ${(info['warmupMs'] as double).toStringAsFixed(1)}ms',
+      );
+      if (threadWarning != null) {
+        print('⚠️ Native inference thread setup: $threadWarning');
+      }
+      return true;
+    } on MissingPluginException {
+      print('⚠️ Native detection engine not registered on this platform');
+    } on PlatformException catch (e) {
+      print('⚠️ Native detection engine failed to load model: ${e.message}');
+    }
+    _isLoaded = false;
+    return false;
+  }
+
+  /// Run detection on an encoded (PNG/JPEG) or raw RGBA frame
+  Future<NativeDetectionResult> detectFrame(
+    Uint8List frame, {
+    int width = 0,
+    int height = 0,
+    String format = 'auto',
+    double threshold = 0.5,
+  }) async {
+    final result = await _channel.invokeMapMethod<String, dynamic>(
+      'detectFrame',
+      {
+        'frame': frame,
+        'width': width,
+        'height': height,
+        'format': format,
+        'threshold': threshold,
+      },
+    );
+    return _parseResult(result);
+  }
+
+  /// Run detection on a frame still held in the native frame ring. If the
+  /// producer has already reused the slot, the newest frame is used instead
+  /// when [allowNewer] is set, otherwise a [PlatformException] is thrown.
+  Future<NativeDetectionResult> detectRingFrame(
+    NativeFrameRef frame, {
+    double threshold = 0.5,
+    bool allowNewer = true,
+  }) async {
+    final result = await _channel.invokeMapMethod<String, dynamic>(
+      'detectRingFrame',
+      {
+        'slot': frame.slot,
+        'frameId': frame.frameId,
+        'allowNewer': allowNewer,
+        'threshold': threshold,
+      },
+    );
+    return _parseResult(result);
+  }
+
+  NativeDetectionResult _parseResult(Map<String, dynamic>? result) {
+    if (result == null) {
+      throw PlatformException(
+          code: 'VISION_ERROR', message: 'Empty detection result');
+    }
+
+    final tracks = result['tracks'] as Uint8List?;
+    return NativeDetectionResult(
+      boxes: result['boxes'] as Float32List? ?? Float32List(0),
+      tracks: tracks != null ? NativeTrack.decodeAll(tracks) : const [],
+      isTracking: tracks != null,
+      rawCount: result['rawCount'] as int,
+      frameId: result['frameId'] as int? ?? 0,
+      frameWidth: result['frameWidth'] as int,
+      frameHeight: result['frameHeight'] as int,
+      skipped: result['skipped'] as bool? ?? false,
+      keepAlive: result['keepAlive'] as bool? ?? false,
+      motionScore: result['motionScore'] as double?,
+      crops: result['crops'] as int? ?? 1,
+      batched: result['batched'] as bool? ?? false,
+      timings: {
+        'decodeTime': result['decodeTime'],
+        'motionTime': result['motionTime'],
+        'preprocessingTime': result['preprocessingTime'],
+        'modelLoadTime': result['modelLoadTime'],
+        'inferenceTime': result['inferenceTime'],
+        'resultsParsingTime': result['resultsParsingTime'],
+        'totalProcessingTime': result['totalProcessingTime'],
+      },
+    );
+  }
+
+  /// Configure native post-processing: [classThresholds] overrides the
+  /// per-frame threshold for individual class ids, boxes overlapping by more
+  /// than [nmsIou] are suppressed, and with [tracking] results carry
+  /// confirmed tracks instead of raw boxes. A track is confirmed after
+  /// [trackMinHits] consecutive detections and dropped after
+  /// [trackMaxMisses] consecutive frames without one.
+  Future<void> configurePostprocess({
+    Map<int, double> classThresholds = const {},
+    double nmsIou = 0.5,
+    bool classAgnosticNms = false,
+    bool tracking = true,
+    double trackMatchIou = 0.3,
+    int trackMinHits = 2,
+    int trackMaxMisses = 3,
+  }) async {
+    if (!isSupported) return;
+    try {
+      await _channel.invokeMethod('configurePostprocess', {
+        'classThresholds': classThresholds,
+        'nmsIou': nmsIou,
+        'classAgnosticNms': classAgnosticNms,
+        'tracking': tracking,
+        'trackMatchIou': trackMatchIou,
+        'trackMinHits': trackMinHits,
+        'trackMaxMisses': trackMaxMisses,
+      });
+    } on MissingPluginException {
+      return;
+    } on PlatformException catch (e) {
+      print('⚠️ Failed to configure native post-processing: ${e.message}');
+    }
+  }
+
+  /// Configure tiled inference for distant, small objects. Besides the
+  /// full-frame pass ([includeFullFrame]) up to [maxTiles] crops run per
+  /// frame: ROIs around tracks and motion first, then tiles of a
+  /// [gridSize] x [gridSize] grid overlapping by [overlap], round-robin
+  /// when the grid exceeds the budget. Results stay in the coordinates of
+  /// the single-resize path.
+  Future<void> setTiling({
+    NativeTilingMode mode = NativeTilingMode.off,
+    bool includeFullFrame = true,
+    int gridSize = 2,
+    double overlap = 0.2,
+    int maxTiles = 4,
+    double roiMargin = 0.5,
+    bool batch = true,
+  }) async {
+    if (!isSupported) return;
+    try {
+      await _channel.invokeMethod('setTiling', {
+        'mode': mode.toString().split('.').last,
+        'includeFullFrame': includeFullFrame,
+        'gridSize': gridSize,
+        'overlap': overlap,
+        'maxTiles': maxTiles,
+        'roiMargin': roiMargin,
+        'batch': batch,
+      });
+    } on MissingPluginException {
+      return;
+    } on PlatformException catch (e) {
+      print('⚠️ Failed to configure tiled inference: ${e.message}');
+    }
+  }
+
+  /// Run the PNG/JPEG frames in [clipPath] through the single resize and
+  /// through tiling as configured here, and compare cost (meanMs, p95Ms,
+  /// cropsPerFrame) and recall. [labels], one packed box list per frame in
+  /// the [NativeDetectionResult.boxes] layout, are the ground truth;
+  /// without them recall is relative to every object either pass found.
+  Future<List<Map<String, dynamic>>?> benchmarkTiling({
+    required String clipPath,
+    NativeTilingMode mode = NativeTilingMode.gridAndRoi,
+    int gridSize = 2,
+    int maxTiles = 4,
+    int maxFrames = 200,
+    double clipFps = 10,
+    double threshold = 0.5,
+    List<Float32List>? labels,
+  }) async {
+    if (!isSupported) return null;
+    try {
+      final results = await _channel.invokeListMethod<dynamic>(
+        'benchmarkTiling',
+        {
+          'clipPath': clipPath,
+          'mode': mode.toString().split('.').last,
+          'gridSize': gridSize,
+          'maxTiles': maxTiles,
+          'maxFrames': maxFrames,
+          'clipFps': clipFps,
+          'threshold': threshold,
+          if (labels != null) 'labels': labels,
+        },
+      );
+      return results
+          ?.map((entry) => Map<String, dynamic>.from(entry as Map))
+          .toList();
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Tiling benchmark failed: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Time the loaded model at each of [threadCounts] (default 1 up to the
+  /// core count), unpinned and pinned to the highest CPUs, and keep the
+  /// cheapest setup whose p95 is within 10% of the best. Returns the
+  /// chosen numThreads/cpus/nice plus the per-setup 'results' (threads,
+  /// cpus, firstMs, meanMs, p50Ms, p95Ms), or null if unavailable.
+  Future<Map<String, dynamic>?> benchmarkThreads({
+    List<int>? threadCounts,
+    int iterations = 20,
+  }) async {
+    if (!isSupported || !_isLoaded) return null;
+    try {
+      final result = await _channel.invokeMapMethod<String, dynamic>(
+        'benchmarkThreads',
+        {
+          if (threadCounts != null) 'threadCounts': threadCounts,
+          'iterations': iterations,
+        },
+      );
+      if (result == null) return null;
+      _updateThreadInfo(result);
+      return result;
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Thread benchmark failed: ${e.message}');
+      return null;
+    }
+  }
+
+  void _updateThreadInfo(Map<String, dynamic> info) {
+    numThreadsInUse = info['numThreads'] as int? ?? 0;
+    cpusInUse = List<int>.from(info['cpus'] as List? ?? const []);
+    niceInUse = info['nice'] as int? ?? 0;
+    threadWarning = info['threadWarning'] as String?;
+  }
+
+  static String _cpuLabel(List<int> cpus) =>
+      cpus.isEmpty ? 'all CPUs' : 'CPUs ${cpus.join(",")}';
+
+  /// Configure the motion gate that runs before the detector. Frames whose
+  /// changed fraction stays below [motionThreshold] are skipped, except for
+  /// one keep-alive inference every [keepAlive]. Omitted values keep their
+  /// current setting. Returns the gate stats, or null if unavailable.
+  Future<Map<String, dynamic>?> setMotionGate({
+    required bool enabled,
+    double? motionThreshold,
+    int? pixelThreshold,
+    Duration? keepAlive,
+  }) async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>(
+        'setMotionGate',
+        {
+          'enabled': enabled,
+          if (motionThreshold != null) 'motionThreshold': motionThreshold,
+          if (pixelThreshold != null) 'pixelThreshold': pixelThreshold,
+          if (keepAlive != null) 'keepAliveMs': keepAlive.inMilliseconds,
+        },
+      );
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Failed to configure motion gate: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Motion gate counters: framesEvaluated, framesSkipped, framesTriggered,
+  /// keepAliveRuns and lastScore
+  Future<Map<String, dynamic>?> getMotionStats() async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>('getMotionStats');
+    } catch (e) {
+      return null;
+    }
+  }
+
+  /// Release the interpreter, its tensor arena and thread pool if no frame
+  /// ran for [idle]; the model stays loaded and the next frame recreates
+  /// them. Returns whether they were released.
+  static Future<bool> trimMemory(
+      {Duration idle = const Duration(minutes: 1)}) async {
+    if (!isSupported) return false;
+    try {
+      final result = await _channel.invokeMapMethod<String, dynamic>(
+          'trimMemory', {'idleMs': idle.inMilliseconds});
+      return result?['interpreterReleased'] == true;
+    } catch (e) {
+      print('⚠️ Native detection engine trimMemory failed: $e');
+      return false;
+    }
+  }
+
+  /// Release the interpreter and model memory
+  Future<void> unload() async {
+    stopFrameEvents();
+    if (!_isLoaded) return;
+    _isLoaded = false;
+    try {
+      await _channel.invokeMethod('unloadModel');
+    } catch (e) {
+      print('⚠️ Failed to unload native detection engine: $e');
+    }
+  }
+}
@@ -0,0 +1,162 @@
+import 'dart:io';
+import 'package:flutter/services.dart';
+
+/// Percentiles of one frame timing histogram, in milliseconds
+class FrameHistogram {
+  final int count;
+  final double minMs;
+  final double meanMs;
+  final double p50Ms;
+  final double p90Ms;
+  final double p99Ms;
+  final double p999Ms;
+  final double maxMs;
+
+  FrameHistogram(this.count, this.minMs, this.meanMs, this.p50Ms, this.p90Ms,
+      this.p99Ms, this.p999Ms, this.maxMs);
+
+  factory FrameHistogram.fromMap(Map<dynamic, dynamic>? map) {
+    double value(String key) => (map?[key] as num?)?.toDouble() ?? 0;
+    return FrameHistogram(map?['count'] as int? ?? 0, value('minMs'),
+        value('meanMs'), value('p50Ms'), value('p90Ms'), value('p99Ms'),
+        value('p999Ms'), value('maxMs'));
+  }
+
+  Map<String, dynamic> toJson() => {
+        'count': count,
+        'min_ms': minMs,
+        'mean_ms': meanMs,
+        'p50_ms': p50Ms,
+        'p90_ms': p90Ms,
+        'p99_ms': p99Ms,
+        'p999_ms': p999Ms,
+        'max_ms': maxMs,
+      };
+}
+
+/// Frame clock statistics over one span of time. [interval] is between
+/// frames on the glass when the compositor reports presentation times,
+/// [paint] is the frame clock's work per frame and [presentLatency] is
+/// from a frame's start to it being shown. A janky frame came at least
+/// half a refresh interval late; [missedVsyncs] counts the refreshes
+/// skipped. Gaps while nothing animated are counted in [idleGaps] only.
+class FrameTimingWindow {
+  final double durationMs;
+  final int frames;
+  final int jankyFrames;
+  final int missedVsyncs;
+  final int idleGaps;
+  final int presentedFrames;
+  final double fps;
+  final FrameHistogram interval;
+  final FrameHistogram paint;
+  final FrameHistogram presentLatency;
+
+  FrameTimingWindow(
+      this.durationMs,
+      this.frames,
+      this.jankyFrames,
+      this.missedVsyncs,
+      this.idleGaps,
+      this.presentedFrames,
+      this.fps,
+      this.interval,
+      this.paint,
+      this.presentLatency);
+
+  factory FrameTimingWindow.fromMap(Map<dynamic, dynamic>? map) {
+    return FrameTimingWindow(
+      (map?['durationMs'] as num?)?.toDouble() ?? 0,
+      map?['frames'] as int? ?? 0,
+      map?['jankyFrames'] as int? ?? 0,
+      map?['missedVsyncs'] as int? ?? 0,
+      map?['idleGaps'] as int? ?? 0,
+      map?['presentedFrames'] as int? ?? 0,
+      (map?['fps'] as num?)?.toDouble() ?? 0,
+      FrameHistogram.fromMap(map?['interval'] as Map?),
+      FrameHistogram.fromMap(map?['paint'] as Map?),
+      FrameHistogram.fromMap(map?['presentLatency'] as Map?),
+    );
+  }
+
+  /// Share of frames that missed at least one vsync
+  double get jankRatio => frames > 0 ? jankyFrames / frames : 0;
+}
+
+class FrameTimings {
+  final int refreshIntervalUs;
+  final int windowMs;
+
+  /// The last complete window of [windowMs]
+  final FrameTimingWindow window;
+
+  /// Since the runner started or timings were reset
+  final FrameTimingWindow total;
+
+  FrameTimings(this.refreshIntervalUs, this.windowMs, this.window, this.total);
+
+  double get refreshHz => refreshIntervalUs > 0 ? 1e6 / refreshIntervalUs : 0;
+}
+
+/// Client for the frame clock instrumentation in the Linux runner
+/// (linux/runner/frame_clock_monitor.cc). The runner hooks the GdkFrameClock
+/// of the top-level window and keeps HdrHistogram-style histograms of frame
+/// intervals, paint times and presentation latency, so missed vsyncs and
+/// compositor stalls that Dart frame callbacks never see are measured on
+/// the glass.
+class NativeFrameTimings {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/frame_timing',
+  );
+
+  /// Only the Linux runner is instrumented
+  static bool get isSupported => Platform.isLinux;
+
+  /// Totals and the last complete window, or null when unavailable
+  static Future<FrameTimings?> get() async {
+    if (!isSupported) return null;
+    try {
+      final result =
+          await _channel.invokeMapMethod<String, dynamic>('getFrameTimings');
+      return result == null ? null : _parse(result);
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Native frame timings failed: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Change the reporting [window] and the [idleGap] beyond which a pause
+  /// between frames counts as idle rather than a stall
+  static Future<FrameTimings?> configure(
+      {Duration? window, Duration? idleGap}) async {
+    if (!isSupported) return null;
+    try {
+      final result = await _channel
+          .invokeMapMethod<String, dynamic>('configureFrameTimings', {
+        if (window != null) 'windowMs': window.inMilliseconds,
+        if (idleGap != null) 'idleGapMs': idleGap.inMilliseconds,
+      });
+      return result == null ? null : _parse(result);
+    } catch (e) {
+      print('⚠️ Native frame timings configure failed: $e');
+      return null;
+    }
+  }
+
+  static Future<void> reset() async {
+    try {
+      await _channel.invokeMethod('resetFrameTimings');
+    } catch (_) {}
+  }
+
+  static FrameTimings _parse(Map<String, dynamic> map) {
+    return FrameTimings(
+      map['refreshIntervalUs'] as int? ?? 0,
+      map['windowMs'] as int? ?? 0,
+      FrameTimingWindow.fromMap(map['window'] as Map?),
+      FrameTimingWindow.fromMap(map['total'] as Map?),
+    );
+  }
+}
@@ -0,0 +1,190 @@
+import 'dart:io';
+import 'package:flutter/services.dart';
+
+/// Memory pressure as judged by the native governor
+enum MemoryPressureLevel { none, moderate, critical }
+
+MemoryPressureLevel _parseLevel(Object? name) {
+  switch (name) {
+    case 'moderate':
+      return MemoryPressureLevel.moderate;
+    case 'critical':
+      return MemoryPressureLevel.critical;
+    default:
+      return MemoryPressureLevel.none;
+  }
+}
+
+/// One release action and what it did to our resident set
+class MemoryReleaseReport {
+  final DateTime time;
+  final MemoryPressureLevel level;
+  final String reason;
+  final String action;
+  final int rssBeforeKb;
+  final int rssAfterKb;
+  final double durationMs;
+
+  MemoryReleaseReport(this.time, this.level, this.reason, this.action,
+      this.rssBeforeKb, this.rssAfterKb, this.durationMs);
+
+  factory MemoryReleaseReport.fromMap(Map<dynamic, dynamic> map) {
+    return MemoryReleaseReport(
+      DateTime.fromMillisecondsSinceEpoch(map['wallMs'] as int? ?? 0),
+      _parseLevel(map['level']),
+      map['reason'] as String? ?? '',
+      map['action'] as String? ?? '',
+      map['rssBeforeKb'] as int? ?? 0,
+      map['rssAfterKb'] as int? ?? 0,
+      (map['durationMs'] as num?)?.toDouble() ?? 0,
+    );
+  }
+
+  /// Negative when the action grew the resident set
+  int get releasedKb => rssBeforeKb - rssAfterKb;
+
+  Map<String, dynamic> toJson() => {
+        'time': time.toIso8601String(),
+        'level': level.toString().split('.').last,
+        'reason': reason,
+        'action': action,
+        'rssBeforeKb': rssBeforeKb,
+        'rssAfterKb': rssAfterKb,
+        'durationMs': durationMs,
+      };
+}
+
+/// A pressure level change, or native releases the governor just made
+class MemoryPressureEvent {
+  final MemoryPressureLevel level;
+  final String reason;
+  final int rssKb;
+  final List<MemoryReleaseReport> reports;
+
+  MemoryPressureEvent(this.level, this.reason, this.rssKb, this.reports);
+}
+
+/// Client for the memory governor in the Linux system plugin
+/// (linux/plugins/kiosk_system). A native thread waits on a kernel PSI
+/// trigger and our cgroup's memory.events and judges every sampler sample
+/// (PSI, MemAvailable, resident set); under pressure it calls malloc_trim
+/// and reports the pressure here so Dart can release its own caches and
+/// those of the other plugins, cheapest first. glibc malloc arenas are
+/// capped when the plugin registers.
+class NativeMemoryGovernor {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/system',
+  );
+  static const EventChannel _eventChannel = EventChannel(
+    'com.ki.king_kiosk/system/memory',
+  );
+
+  static Stream<MemoryPressureEvent>? _events;
+
+  /// Only the Linux runner ships the governor
+  static bool get isSupported => Platform.isLinux;
+
+  static Stream<MemoryPressureEvent> get events {
+    return _events ??= _eventChannel
+        .receiveBroadcastStream()
+        .where((event) => event is Map)
+        .map((event) => MemoryPressureEvent(
+              _parseLevel(event['level']),
+              event['reason'] as String? ?? '',
+              event['rssKb'] as int? ?? 0,
+              (event['reports'] as List? ?? const [])
+                  .whereType<Map>()
+                  .map((report) => MemoryReleaseReport.fromMap(report))
+                  .toList(),
+            ));
+  }
+
+  /// Start the governor, or apply new settings to the running one; starts
+  /// the system sampler too if it is not running. Pressure is moderate
+  /// when tasks stalled on memory for [moderatePsiSome] of the sampler
+  /// interval or MemAvailable falls under [moderateHeadroom] of MemTotal,
+  /// and critical at [criticalPsiFull] fully stalled or
+  /// [criticalHeadroom]. Our resident set over [rssSoftLimitKb] or
+  /// [rssHardLimitKb] counts as pressure too (0 disables). Without
+  /// pressure malloc_trim runs after [trimGrowthKb] of growth. Releases at
+  /// the same level are at least [cooldownMs] apart. [arenaMax] caps
+  /// malloc arenas created from now on. Returns the governor info, or null
+  /// when the plugin is not available.
+  static Future<Map<String, dynamic>?> start({
+    int? evaluateMs,
+    double? moderatePsiSome,
+    double? criticalPsiFull,
+    double? moderateHeadroom,
+    double? criticalHeadroom,
+    int? rssSoftLimitKb,
+    int? rssHardLimitKb,
+    int? trimGrowthKb,
+    int? cooldownMs,
+    int? arenaMax,
+  }) async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>('startGovernor', {
+        if (evaluateMs != null) 'evaluateMs': evaluateMs,
+        if (moderatePsiSome != null) 'moderatePsiSome': moderatePsiSome,
+        if (criticalPsiFull != null) 'criticalPsiFull': criticalPsiFull,
+        if (moderateHeadroom != null) 'moderateHeadroom': moderateHeadroom,
+        if (criticalHeadroom != null) 'criticalHeadroom': criticalHeadroom,
+        if (rssSoftLimitKb != null) 'rssSoftLimitKb': rssSoftLimitKb,
+        if (rssHardLimitKb != null) 'rssHardLimitKb': rssHardLimitKb,
+        if (trimGrowthKb != null) 'trimGrowthKb': trimGrowthKb,
+        if (cooldownMs != null) 'cooldownMs': cooldownMs,
+        if (arenaMax != null) 'arenaMax': arenaMax,
+      });
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Native memory governor unavailable: ${e.message}');
+      return null;
+    }
+  }
+
+  static Future<void> stop() async {
+    try {
+      await _channel.invokeMethod('stopGovernor');
+    } catch (_) {}
+  }
+
+  /// Measured malloc_trim, for after caches were released; the report is
+  /// kept with the governor's own
+  static Future<MemoryReleaseReport?> trim(String reason) async {
+    if (!isSupported) return null;
+    try {
+      final result = await _channel
+          .invokeMapMethod<String, dynamic>('trimMemory', {'reason': reason});
+      return result == null ? null : MemoryReleaseReport.fromMap(result);
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Native malloc_trim failed: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Our resident set from /proc/self/statm, read now
+  static Future<int?> residentKb() async {
+    if (!isSupported) return null;
+    try {
+      final kb = await _channel.invokeMethod<int>('getResidentKb');
+      return kb != null && kb >= 0 ? kb : null;
+    } catch (_) {
+      return null;
+    }
+  }
+
+  /// Settings, current level, peak resident set, release totals and the
+  /// most recent release reports
+  static Future<Map<String, dynamic>?> getInfo() async {
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>(
+          'getGovernorInfo');
+    } catch (_) {
+      return null;
+    }
+  }
+}
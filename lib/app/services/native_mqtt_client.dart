@@ -0,0 +1,231 @@
+import 'dart:async';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:flutter/services.dart';
+
+/// A publish received by the native transport. [json] is the payload
+/// already decoded on the client thread when it looked like JSON (comments,
+/// trailing commas and quoted JSON strings are accepted, as in
+/// `MqttService._processCommand`), otherwise null.
+class NativeMqttMessage {
+  final String topic;
+  final String payload;
+  final int qos;
+  final bool retain;
+  final dynamic json;
+
+  NativeMqttMessage(this.topic, this.payload, this.qos, this.retain, this.json);
+}
+
+/// Connection state reported by the native transport: `connecting`,
+/// `connected` or `stopped`, with the reason the last connection was lost.
+class NativeMqttState {
+  final String state;
+  final String? error;
+
+  NativeMqttState(this.state, this.error);
+
+  bool get isConnected => state == 'connected';
+}
+
+/// Client for the MQTT transport registered by the Linux runner
+/// (linux/plugins/kiosk_mqtt). The broker connection lives on its own
+/// epoll thread: publishes are queued natively and coalesced into batched
+/// socket writes, bounded by per-topic rate limits and a queue that drops
+/// old messages instead of growing, and incoming commands arrive here
+/// already parsed.
+class NativeMqttClient {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/mqtt',
+  );
+  static const EventChannel _eventChannel = EventChannel(
+    'com.ki.king_kiosk/mqtt/events',
+  );
+
+  static Stream<dynamic>? _events;
+  static Stream<NativeMqttState>? _states;
+  static Stream<NativeMqttMessage>? _messages;
+
+  // Publishes made in the same microtask go over the channel together
+  static final List<Map<String, dynamic>> _pending = [];
+  static bool _flushScheduled = false;
+
+  /// Only the Linux runner ships the native transport
+  static bool get isSupported => Platform.isLinux;
+
+  static Stream<dynamic> get _rawEvents =>
+      _events ??= _eventChannel.receiveBroadcastStream().asBroadcastStream();
+
+  static Stream<NativeMqttState> get states {
+    return _states ??= _rawEvents
+        .where((event) => event is Map && event['type'] == 'state')
+        .map((event) => NativeMqttState(
+              event['state'] as String,
+              event['error'] as String?,
+            ));
+  }
+
+  /// Incoming publishes; each socket read arrives as one channel event
+  static Stream<NativeMqttMessage> get messages {
+    return _messages ??= _rawEvents
+        .where((event) => event is Map && event['type'] == 'messages')
+        .expand((event) => (event['messages'] as List).map((m) {
+              final payload = m['payload'];
+              return NativeMqttMessage(
+                m['topic'] as String,
+                payload is String
+                    ? payload
+                    : String.fromCharCodes(payload as Uint8List),
+                m['qos'] as int? ?? 0,
+                m['retain'] == true,
+                _toJson(m['json']),
+              );
+            }));
+  }
+
+  /// Start connecting to [host] in the background; the transport keeps
+  /// reconnecting until [disconnect]. [willTopic] gets [willPayload] from
+  /// the broker when the connection is lost and [birthPayload] after every
+  /// connect. [rateLimits] maps topic filters to the minimum interval
+  /// between publishes, later ones replacing any still waiting. Returns
+  /// false when the plugin is not available.
+  static Future<bool> connect({
+    required String host,
+    required int port,
+    required String clientId,
+    String? username,
+    String? password,
+    int keepAliveSeconds = 30,
+    bool mqtt5 = false,
+    String? willTopic,
+    String willPayload = 'offline',
+    String birthPayload = 'online',
+    int? maxQueuedMessages,
+    bool dropNewest = false,
+    Map<String, int> rateLimits = const {},
+  }) async {
+    if (!isSupported) return false;
+    try {
+      await _channel.invokeMethod('connect', {
+        'host': host,
+        'port': port,
+        'clientId': clientId,
+        'protocolVersion': mqtt5 ? 5 : 4,
+        if (username != null && username.isNotEmpty) 'username': username,
+        if (password != null) 'password': password,
+        'keepAliveSeconds': keepAliveSeconds,
+        if (willTopic != null) 'willTopic': willTopic,
+        'willPayload': willPayload,
+        'birthPayload': birthPayload,
+        if (maxQueuedMessages != null) 'maxQueuedMessages': maxQueuedMessages,
+        'dropNewest': dropNewest,
+        'rateLimits': _rules(rateLimits),
+      });
+      return true;
+    } on MissingPluginException {
+      return false;
+    } on PlatformException catch (e) {
+      print('⚠️ Native MQTT unavailable: ${e.message}');
+      return false;
+    }
+  }
+
+  /// Send what is queued and disconnect, giving up after [lingerMs]
+  static Future<void> disconnect({int lingerMs = 1000}) async {
+    await _flush();
+    try {
+      await _channel.invokeMethod('disconnect', {'lingerMs': lingerMs});
+    } catch (e) {
+      print('⚠️ Native MQTT failed to disconnect: $e');
+    }
+  }
+
+  /// Queue a publish; [payload] is a String or a list of bytes. QoS 2 is
+  /// sent as QoS 1.
+  static void publish(String topic, Object payload,
+      {int qos = 0, bool retain = false}) {
+    _pending.add({
+      'topic': topic,
+      'payload': payload is String
+          ? payload
+          : payload is Uint8List
+              ? payload
+              : Uint8List.fromList(payload as List<int>),
+      'qos': qos,
+      'retain': retain,
+    });
+    if (!_flushScheduled) {
+      _flushScheduled = true;
+      scheduleMicrotask(_flush);
+    }
+  }
+
+  static Future<void> subscribe(String topic, {int qos = 0}) async {
+    try {
+      await _channel.invokeMethod('subscribe', {'topic': topic, 'qos': qos});
+    } catch (e) {
+      print('⚠️ Native MQTT failed to subscribe to $topic: $e');
+    }
+  }
+
+  static Future<void> unsubscribe(String topic) async {
+    try {
+      await _channel.invokeMethod('unsubscribe', {'topic': topic});
+    } catch (e) {
+      print('⚠️ Native MQTT failed to unsubscribe from $topic: $e');
+    }
+  }
+
+  /// Replace the per-topic rate limits (topic filter to interval in ms)
+  static Future<void> setRateLimits(Map<String, int> rateLimits) async {
+    try {
+      await _channel
+          .invokeMethod('setRateLimits', {'rules': _rules(rateLimits)});
+    } catch (e) {
+      print('⚠️ Native MQTT failed to set rate limits: $e');
+    }
+  }
+
+  /// Connection, traffic and queue counters
+  static Future<Map<String, dynamic>?> getInfo() async {
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>('getInfo');
+    } catch (_) {
+      return null;
+    }
+  }
+
+  static Future<void> _flush() async {
+    _flushScheduled = false;
+    if (_pending.isEmpty) return;
+    final messages = List<Map<String, dynamic>>.of(_pending);
+    _pending.clear();
+    try {
+      final dropped = await _channel
+          .invokeMethod<int>('publishBatch', {'messages': messages});
+      if (dropped != null && dropped > 0) {
+        print('⚠️ Native MQTT queue full, dropped $dropped message(s)');
+      }
+    } catch (e) {
+      print('⚠️ Native MQTT failed to publish: $e');
+    }
+  }
+
+  static List<Map<String, dynamic>> _rules(Map<String, int> rateLimits) {
+    return rateLimits.entries
+        .map((rule) => {'filter': rule.key, 'intervalMs': rule.value})
+        .toList();
+  }
+
+  // Give channel maps the same shape jsonDecode would
+  static dynamic _toJson(dynamic value) {
+    if (value is Map) {
+      return value.map<String, dynamic>(
+          (key, v) => MapEntry(key.toString(), _toJson(v)));
+    }
+    if (value is List && value is! Uint8List) {
+      return value.map(_toJson).toList();
+    }
+    return value;
+  }
+}
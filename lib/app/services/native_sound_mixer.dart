@@ -0,0 +1,128 @@
+import 'dart:io';
+import 'package:flutter/services.dart';
+
+/// Client for the native sound-effect mixer registered by the Linux runner
+/// (linux/plugins/kiosk_audio). Sounds are decoded once into memory and
+/// every trigger mixes into a single output stream, so alerts start within
+/// a few milliseconds and overlap instead of waiting for a player.
+class NativeSoundMixer {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/audio',
+  );
+
+  static final Set<String> _registered = {};
+
+  /// Only the Linux runner ships the native mixer
+  static bool get isSupported => Platform.isLinux;
+
+  static bool isRegistered(String key) => _registered.contains(key);
+
+  /// Decode a WAV asset into the mixer's cache under [key]. Returns false
+  /// when the plugin is missing or the file can't be decoded, in which case
+  /// the caller keeps its own player.
+  static Future<bool> registerAsset(String key, String assetPath) async {
+    if (!isSupported) return false;
+    try {
+      final data = await rootBundle.load(assetPath);
+      return await register(
+        key,
+        data.buffer.asUint8List(data.offsetInBytes, data.lengthInBytes),
+      );
+    } catch (e) {
+      print('⚠️ Failed to load sound asset $assetPath: $e');
+      return false;
+    }
+  }
+
+  static Future<bool> register(String key, Uint8List wavBytes) async {
+    if (!isSupported) return false;
+    try {
+      final info = await _channel.invokeMapMethod<String, dynamic>(
+        'registerSound',
+        {'key': key, 'bytes': wavBytes},
+      );
+      if (info == null) return false;
+      _registered.add(key);
+      print('🔊 Native mixer cached "$key" (${info['durationMs']} ms)');
+      return true;
+    } on MissingPluginException {
+      return false;
+    } on PlatformException catch (e) {
+      print('⚠️ Native mixer rejected "$key": ${e.message}');
+      return false;
+    }
+  }
+
+  static Future<void> unregister(String key) async {
+    if (!_registered.remove(key)) return;
+    try {
+      await _channel.invokeMethod('unregisterSound', {'key': key});
+    } catch (e) {
+      print('⚠️ Failed to unregister native sound "$key": $e');
+    }
+  }
+
+  /// Start a registered sound; returns its voice id, or null when it could
+  /// not be played (e.g. no output device)
+  static Future<int?> play(
+    String key, {
+    double gain = 1.0,
+    bool loop = false,
+  }) async {
+    if (!_registered.contains(key)) return null;
+    try {
+      return await _channel.invokeMethod<int>(
+        'playSound',
+        {'key': key, 'gain': gain, 'loop': loop},
+      );
+    } catch (e) {
+      print('⚠️ Native mixer failed to play "$key": $e');
+      return null;
+    }
+  }
+
+  static Future<void> stop(int voiceId) async {
+    try {
+      await _channel.invokeMethod('stopSound', {'voiceId': voiceId});
+    } catch (e) {
+      print('⚠️ Failed to stop native sound: $e');
+    }
+  }
+
+  static Future<void> setGain(int voiceId, double gain) async {
+    try {
+      await _channel.invokeMethod(
+        'setSoundGain',
+        {'voiceId': voiceId, 'gain': gain},
+      );
+    } catch (e) {
+      print('⚠️ Failed to set native sound gain: $e');
+    }
+  }
+
+  static Future<void> stopAll() async {
+    if (_registered.isEmpty) return;
+    try {
+      await _channel.invokeMethod('stopAllSounds');
+    } catch (e) {
+      print('⚠️ Failed to stop native sounds: $e');
+    }
+  }
+
+  static Future<void> setMasterGain(double gain) async {
+    try {
+      await _channel.invokeMethod('setSoundMasterGain', {'gain': gain});
+    } catch (e) {
+      print('⚠️ Failed to set native mixer gain: $e');
+    }
+  }
+
+  static Future<Map<String, dynamic>?> getInfo() async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>('getMixerInfo');
+    } catch (e) {
+      return null;
+    }
+  }
+}
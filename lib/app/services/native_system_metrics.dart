@@ -0,0 +1,169 @@
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:flutter/services.dart';
+
+/// Min, max and mean of one metric over a window, with its newest value
+class NativeMetricWindow {
+  final double min;
+  final double max;
+  final double avg;
+  final double last;
+  final int count;
+
+  NativeMetricWindow(this.min, this.max, this.avg, this.last, this.count);
+
+  Map<String, dynamic> toJson() =>
+      {'min': min, 'max': max, 'avg': avg, 'last': last, 'count': count};
+}
+
+/// Samples in column form: [timeMs] on the monotonic clock, [wallMs] since
+/// the epoch, and one column per metric. A NaN entry means the metric's
+/// source could not be read for that sample.
+class NativeMetricsHistory {
+  final Int64List timeMs;
+  final Int64List wallMs;
+  final Map<String, Float64List> metrics;
+
+  NativeMetricsHistory(this.timeMs, this.wallMs, this.metrics);
+
+  int get length => timeMs.length;
+}
+
+/// Client for the system sampler registered by the Linux runner
+/// (linux/plugins/kiosk_system). One native thread reads /proc/stat,
+/// /proc/meminfo, /proc/self/smaps_rollup, PSI, thermal zones, CPU
+/// frequency and our cgroup v2 limits at a fixed rate into a lock-free
+/// ring, so Dart only pays for the values it asks for.
+///
+/// Metric names (see `getInfo()['metrics']`): cpu, cpuIowait,
+/// cpuFreqRatio, memAvailableKb, memUsedRatio, swapUsedKb, rssKb, pssKb,
+/// processSwapKb, psiCpuSome, psiMemorySome, psiMemoryFull, psiIoSome,
+/// psiIoFull, tempMaxC, cgroupMemoryKb, cgroupCpuThrottled. Ratios and
+/// pressure are shares between 0 and 1.
+class NativeSystemMetrics {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/system',
+  );
+
+  /// Only the Linux runner ships the sampler
+  static bool get isSupported => Platform.isLinux;
+
+  /// Start sampling every [intervalMs], keeping [history] samples (rounded
+  /// up to a power of two). smaps_rollup walks every mapping, so process
+  /// memory is re-read at most every [processIntervalMs]. Calling again
+  /// reconfigures the running sampler; its history is kept unless it has
+  /// to grow. Returns false when the plugin is not available.
+  static Future<bool> startSampler({
+    int intervalMs = 1000,
+    int history = 1024,
+    int processIntervalMs = 5000,
+  }) async {
+    if (!isSupported) return false;
+    try {
+      await _channel.invokeMethod('startSampler', {
+        'intervalMs': intervalMs,
+        'history': history,
+        'processIntervalMs': processIntervalMs,
+      });
+      return true;
+    } on MissingPluginException {
+      return false;
+    } on PlatformException catch (e) {
+      print('⚠️ Native system sampler unavailable: ${e.message}');
+      return false;
+    }
+  }
+
+  static Future<void> stopSampler() async {
+    try {
+      await _channel.invokeMethod('stopSampler');
+    } catch (_) {}
+  }
+
+  /// The newest sample: timeMs, wallMs, every readable metric by name, plus
+  /// cores, thermalC, memTotalKb, swapTotalKb and the cgroup limits. Null
+  /// before the sampler has taken one.
+  static Future<Map<String, dynamic>?> current() async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>('getCurrent');
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Native system sampler failed: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Min, max and mean over the last [window] for [metrics], or for every
+  /// metric when null. Metrics without samples in the window are left out.
+  static Future<Map<String, NativeMetricWindow>?> window(Duration window,
+      {List<String>? metrics}) async {
+    if (!isSupported) return null;
+    try {
+      final result =
+          await _channel.invokeMapMethod<String, dynamic>('getWindow', {
+        'windowMs': window.inMilliseconds,
+        if (metrics != null) 'metrics': metrics,
+      });
+      if (result == null) return null;
+      final summaries = <String, NativeMetricWindow>{};
+      result.forEach((name, value) {
+        if (value is Map) {
+          summaries[name] = NativeMetricWindow(
+            (value['min'] as num).toDouble(),
+            (value['max'] as num).toDouble(),
+            (value['avg'] as num).toDouble(),
+            (value['last'] as num).toDouble(),
+            value['count'] as int,
+          );
+        }
+      });
+      return summaries;
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Native system sampler failed: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Samples from the last [window] (the whole ring when null), the newest
+  /// [maxSamples] at most, for [metrics] or every metric.
+  static Future<NativeMetricsHistory?> history(
+      {Duration? window, int? maxSamples, List<String>? metrics}) async {
+    if (!isSupported) return null;
+    try {
+      final result =
+          await _channel.invokeMapMethod<String, dynamic>('getHistory', {
+        if (window != null) 'windowMs': window.inMilliseconds,
+        if (maxSamples != null) 'maxSamples': maxSamples,
+        if (metrics != null) 'metrics': metrics,
+      });
+      if (result == null) return null;
+      final columns = <String, Float64List>{};
+      result.forEach((name, value) {
+        if (value is Float64List) columns[name] = value;
+      });
+      return NativeMetricsHistory(
+        result['timeMs'] as Int64List,
+        result['wallMs'] as Int64List,
+        columns,
+      );
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Native system sampler failed: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Sampler configuration, cost per sample and the metric names
+  static Future<Map<String, dynamic>?> getInfo() async {
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>('getInfo');
+    } catch (_) {
+      return null;
+    }
+  }
+}
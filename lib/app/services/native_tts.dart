@@ -0,0 +1,167 @@
+import 'dart:async';
+import 'dart:io';
+import 'package:flutter/services.dart';
+
+/// One update from the native speech engine for the utterance [id]:
+/// `start` (with [cached] and [latencyMs] from the speak call to the
+/// first sample being heard), `done` ([interrupted] after a stop) or
+/// `error`.
+class NativeTtsEvent {
+  final String type;
+  final int id;
+  final bool cached;
+  final double latencyMs;
+  final bool interrupted;
+  final String? error;
+
+  NativeTtsEvent(this.type, this.id, this.cached, this.latencyMs,
+      this.interrupted, this.error);
+}
+
+/// Client for the offline speech engine registered by the Linux runner
+/// (linux/plugins/kiosk_audio). espeak-ng or piper synthesize into a
+/// memory and disk phrase cache keyed by text, voice, rate and pitch, and
+/// queued utterances are synthesized ahead and played back to back on one
+/// output stream.
+class NativeTts {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/audio',
+  );
+  static const EventChannel _eventChannel = EventChannel(
+    'com.ki.king_kiosk/audio/tts',
+  );
+
+  static Stream<NativeTtsEvent>? _events;
+
+  /// Only the Linux runner ships the native engine
+  static bool get isSupported => Platform.isLinux;
+
+  static Stream<NativeTtsEvent> get events {
+    return _events ??= _eventChannel
+        .receiveBroadcastStream()
+        .where((event) => event is Map)
+        .map((event) => NativeTtsEvent(
+              event['type'] as String,
+              event['id'] as int,
+              event['cached'] == true,
+              (event['latencyMs'] as num?)?.toDouble() ?? 0,
+              event['interrupted'] == true,
+              event['error'] as String?,
+            ));
+  }
+
+  /// Start the engine; returns its info, or null when neither espeak-ng
+  /// nor piper is installed. [engine] is `auto`, `espeak-ng` or `piper`;
+  /// [voice] is the default espeak-ng voice or piper .onnx model. Phrases
+  /// are cached under [cacheDir] (the user cache directory by default, an
+  /// empty string for memory only).
+  static Future<Map<String, dynamic>?> configure({
+    String engine = 'auto',
+    String? voice,
+    String? cacheDir,
+    int? gapMs,
+    Map<String, dynamic> options = const {},
+  }) async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>('configureTts', {
+        ...options,
+        'engine': engine,
+        if (voice != null) 'voice': voice,
+        if (cacheDir != null) 'cacheDir': cacheDir,
+        if (gapMs != null) 'gapMs': gapMs,
+      });
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Native TTS unavailable: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Queue [text] behind anything already speaking; returns the
+  /// utterance id, or null on failure
+  static Future<int?> speak(
+    String text, {
+    String? voice,
+    String? language,
+    double rate = 0.5,
+    double pitch = 1.0,
+    double volume = 1.0,
+  }) async {
+    try {
+      return await _channel.invokeMethod<int>('ttsSpeak', {
+        'text': text,
+        if (voice != null) 'voice': voice,
+        if (language != null) 'language': language,
+        'rate': rate,
+        'pitch': pitch,
+        'volume': volume,
+      });
+    } catch (e) {
+      print('⚠️ Native TTS failed to queue speech: $e');
+      return null;
+    }
+  }
+
+  /// Synthesize [text] into the phrase cache without speaking it
+  static Future<void> prefetch(
+    String text, {
+    String? voice,
+    String? language,
+    double rate = 0.5,
+    double pitch = 1.0,
+  }) async {
+    try {
+      await _channel.invokeMethod('ttsPrefetch', {
+        'text': text,
+        if (voice != null) 'voice': voice,
+        if (language != null) 'language': language,
+        'rate': rate,
+        'pitch': pitch,
+      });
+    } catch (e) {
+      print('⚠️ Native TTS failed to prefetch: $e');
+    }
+  }
+
+  /// Drop the queue and fade out the utterance playing
+  static Future<void> stop() => _invoke('ttsStop');
+
+  static Future<void> setPaused(bool paused) =>
+      _invoke('ttsSetPaused', {'paused': paused});
+
+  static Future<void> clearCache() => _invoke('ttsClearCache');
+
+  /// Drop the phrases cached in memory, keeping the disk cache; returns
+  /// the bytes released
+  static Future<int> trimMemory() async {
+    if (!isSupported) return 0;
+    try {
+      final result =
+          await _channel.invokeMapMethod<String, dynamic>('trimMemory');
+      return result?['phraseCacheBytes'] as int? ?? 0;
+    } catch (e) {
+      print('⚠️ Native TTS trimMemory failed: $e');
+      return 0;
+    }
+  }
+
+  /// Queue, synthesis timings, stalls and phrase cache counters
+  static Future<Map<String, dynamic>?> getInfo() async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>('getTtsInfo');
+    } catch (e) {
+      return null;
+    }
+  }
+
+  static Future<void> _invoke(String method, [dynamic arguments]) async {
+    try {
+      await _channel.invokeMethod(method, arguments);
+    } catch (e) {
+      print('⚠️ Native TTS $method failed: $e');
+    }
+  }
+}
@@ -0,0 +1,104 @@
+import 'dart:async';
+import 'dart:io';
+import 'package:flutter/services.dart';
+
+/// One update from the native Wyoming client: a state change
+/// (`stopped`, `connecting`, `listening`, `streaming`, `waiting`,
+/// `speaking`), a transcript, the first response audio being heard, or an
+/// error. [latencyMs] is measured from the end of speech.
+class WyomingClientEvent {
+  final String type;
+  final String state;
+  final String? text;
+  final double? latencyMs;
+
+  WyomingClientEvent(this.type, this.state, this.text, this.latencyMs);
+}
+
+/// Client for the native Wyoming voice satellite registered by the Linux
+/// runner (linux/plugins/kiosk_audio). Microphone capture, voice activity
+/// detection, the TCP event stream and reply playback all run natively;
+/// Dart only starts it and listens for updates.
+class NativeWyomingClient {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/audio',
+  );
+  static const EventChannel _eventChannel = EventChannel(
+    'com.ki.king_kiosk/audio/wyoming',
+  );
+
+  static Stream<WyomingClientEvent>? _events;
+
+  /// Only the Linux runner ships the native client
+  static bool get isSupported => Platform.isLinux;
+
+  static Stream<WyomingClientEvent> get events {
+    return _events ??= _eventChannel
+        .receiveBroadcastStream()
+        .where((event) => event is Map)
+        .map((event) => WyomingClientEvent(
+              event['type'] as String,
+              event['state'] as String,
+              event['text'] as String?,
+              (event['latencyMs'] as num?)?.toDouble(),
+            ));
+  }
+
+  /// Connect to a Wyoming server and start listening. With [pipeline] each
+  /// utterance is sent as a run-pipeline from [startStage] to [endStage]
+  /// and the spoken reply is played; otherwise it is only transcribed.
+  /// [options] may tune the voice activity detector (thresholdDb,
+  /// minLevelDbfs, endSilenceMs, maxSegmentMs, preRollMs) or pick a
+  /// microphone (device).
+  static Future<bool> start({
+    required String host,
+    required int port,
+    bool pipeline = true,
+    String startStage = 'asr',
+    String endStage = 'tts',
+    String? language,
+    Map<String, dynamic> options = const {},
+  }) async {
+    if (!isSupported) return false;
+    try {
+      await _channel.invokeMethod('startWyoming', {
+        ...options,
+        'host': host,
+        'port': port,
+        'pipeline': pipeline,
+        'startStage': startStage,
+        'endStage': endStage,
+        if (language != null) 'language': language,
+      });
+      return true;
+    } on MissingPluginException {
+      return false;
+    } on PlatformException catch (e) {
+      print('⚠️ Native Wyoming client unavailable: ${e.message}');
+      return false;
+    }
+  }
+
+  static Future<void> stop() async {
+    if (!isSupported) return;
+    try {
+      await _channel.invokeMethod('stopWyoming');
+    } catch (e) {
+      print('⚠️ Failed to stop native Wyoming client: $e');
+    }
+  }
+
+  /// Connection state, traffic counters and end-of-speech latencies
+  /// (transcriptLatency, firstAudioLatency, responseLatency, each with
+  /// count/lastMs/p50Ms/p95Ms/maxMs)
+  static Future<Map<String, dynamic>?> getInfo() async {
+    if (!isSupported) return null;
+    try {
+      return await _channel.invokeMapMethod<String, dynamic>(
+        'getWyomingInfo',
+      );
+    } catch (e) {
+      return null;
+    }
+  }
+}
@@ -3,6 +3,8 @@ import 'dart:io';
 import 'package:flutter/foundation.dart';
 import 'package:flutter/material.dart';
 import 'package:get/get.dart';
+import 'native_frame_timings.dart';
+import 'native_system_metrics.dart';
 
 /// A service to monitor app performance metrics
 /// Useful for determining minimum system requirements
@@ -15,6 +17,14 @@ class PerformanceMonitorService extends GetxService {
   final RxInt frozenFrameCount = 0.obs;
   final RxList<String> performanceWarnings = <String>[].obs;
   
+  // Frames as the Linux runner's frame clock put them on the glass, over
+  // its last complete window; Dart frame callbacks miss compositor stalls
+  final RxDouble presentedFrameRate = 0.0.obs;
+  final RxInt jankyFrames = 0.obs;
+  final RxInt missedVsyncs = 0.obs;
+  final RxDouble frameIntervalP99Ms = 0.0.obs;
+  final RxDouble presentLatencyP99Ms = 0.0.obs;
+  
   // Internal counters
   int _lastFrameTime = DateTime.now().millisecondsSinceEpoch;
   int _frameTimesIndex = 0;
@@ -23,6 +33,7 @@ class PerformanceMonitorService extends GetxService {
   // Background monitoring timers
   Timer? _frameRateTimer;
   Timer? _memoryReportTimer;
+  Timer? _frameTimingTimer;
   
   // Device information
   final RxString deviceModel = 'Unknown'.obs;
@@ -52,6 +63,9 @@ class PerformanceMonitorService extends GetxService {
     // Start memory monitoring
     _startMemoryMonitoring();
     
+    // Start native frame clock monitoring
+    _startFrameTimingMonitoring();
+    
     // Start frame rate calculation timer
     _frameRateTimer = Timer.periodic(Duration(seconds: 1), (_) {
       _calculateFrameRate();
@@ -64,6 +78,7 @@ class PerformanceMonitorService extends GetxService {
   void stopMonitoring() {
     _frameRateTimer?.cancel();
     _memoryReportTimer?.cancel();
+    _frameTimingTimer?.cancel();
     print('Performance monitoring stopped');
     _generateReport();
   }
@@ -107,8 +122,14 @@ class PerformanceMonitorService extends GetxService {
   
   /// Start memory usage monitoring
   void _startMemoryMonitoring() {
+    NativeSystemMetrics.startSampler();
     _memoryReportTimer = Timer.periodic(Duration(seconds: 5), (_) async {
-      if (kReleaseMode) {
+      // The native sampler has already read the resident set; in MB
+      final sample = await NativeSystemMetrics.current();
+      final rssKb = sample?['rssKb'] as num?;
+      if (rssKb != null) {
+        memoryUsage.value = rssKb ~/ 1024;
+      } else if (kReleaseMode) {
         // In release mode, we can only estimate based on non-precise methods
         memoryUsage.value = 0; // No reliable way in release mode
       } else {
@@ -119,6 +140,22 @@ class PerformanceMonitorService extends GetxService {
     });
   }
   
+  /// Poll the runner's frame clock histograms
+  void _startFrameTimingMonitoring() {
+    if (!NativeFrameTimings.isSupported) return;
+    _frameTimingTimer = Timer.periodic(Duration(seconds: 5), (_) async {
+      final timings = await NativeFrameTimings.get();
+      // Nothing until the first window has closed
+      if (timings == null || timings.window.frames == 0) return;
+      final window = timings.window;
+      presentedFrameRate.value = window.fps;
+      jankyFrames.value = window.jankyFrames;
+      missedVsyncs.value = window.missedVsyncs;
+      frameIntervalP99Ms.value = window.interval.p99Ms;
+      presentLatencyP99Ms.value = window.presentLatency.p99Ms;
+    });
+  }
+  
   /// Collect device information
   void _collectDeviceInfo() {
     if (Platform.isAndroid) {
@@ -144,6 +181,12 @@ class PerformanceMonitorService extends GetxService {
     report.writeln('Total Frames: ${frameCount.value}');
     report.writeln('Slow Frames: ${slowFrameCount.value} (${(slowFrameCount.value / frameCount.value * 100).toStringAsFixed(1)}%)');
     report.writeln('Frozen Frames: ${frozenFrameCount.value}');
+    if (NativeFrameTimings.isSupported) {
+      report.writeln('Presented Frame Rate: ${presentedFrameRate.value.toStringAsFixed(1)} FPS');
+      report.writeln('Janky Frames: ${jankyFrames.value} (${missedVsyncs.value} missed vsyncs)');
+      report.writeln('Frame Interval p99: ${frameIntervalP99Ms.value.toStringAsFixed(1)} ms');
+      report.writeln('Present Latency p99: ${presentLatencyP99Ms.value.toStringAsFixed(1)} ms');
+    }
     report.writeln('Performance Verdict: ${_getPerformanceVerdict()}');
     
     final reportString = report.toString();
@@ -14,6 +14,10 @@ import '../core/utils/permissions_manager.dart';
 import 'storage_service.dart';
 import 'mqtt_service_consolidated.dart';
 import 'media_device_service.dart';
+import 'native_camera_capture.dart';
+import 'native_detection_engine.dart';
+import 'detection_scheduler.dart';
+import 'webrtc_texture_bridge.dart';
 
 /// Data structure for passing inference data to background processing
 class InferenceData {
@@ -66,6 +70,9 @@ class DetectionBox {
   final int classId;
   final String? className;
 
+  /// Stable id from the native tracker; null for untracked detections
+  final int? trackId;
+
   DetectionBox({
     required this.x1,
     required this.y1,
@@ -74,6 +81,7 @@ class DetectionBox {
     required this.confidence,
     required this.classId,
     this.className,
+    this.trackId,
   });
 }
 
@@ -580,6 +588,10 @@ class PersonDetectionService extends GetxService {
   Uint8List? _modelBytes; // Store model bytes for background processing
   bool _isQuantizedModel =
       false; // Track if the model is quantized (uint8) or float
+  // Warm native interpreter (Linux) - avoids rebuilding the model per frame
+  final NativeDetectionEngine _nativeEngine = NativeDetectionEngine();
+  final NativeCameraCapture _nativeCapture = NativeCameraCapture();
+  final RxBool isRecordingFrames = false.obs;
   // Observable properties
   final RxBool isEnabled = false.obs;
   final RxBool isPersonPresent = false.obs;
@@ -599,8 +611,48 @@ class PersonDetectionService extends GetxService {
   final RxMap<String, double> objectConfidences = <String, double>{}.obs;
   final RxBool anyObjectDetected = false.obs;
 
+  // Native motion gate (Linux): the detector only runs when enough of the
+  // frame changed, or when the periodic keep-alive inference is due
+  final RxBool isMotionGateEnabled = true.obs;
+  final RxDouble motionScore = 0.0.obs;
+  final RxInt framesSkippedByMotion = 0.obs;
+  final RxInt keepAliveInferences = 0.obs;
+
+  // Adaptive scheduling (Linux native engine): interval, ring resolution and
+  // motion gate follow measured stage timings, system load and the scene
+  final RxBool isAdaptiveSchedulingEnabled = true.obs;
+  final RxString detectionMode = 'active'.obs;
+  final RxString schedulerReason = ''.obs;
+  final AdaptiveDetectionScheduler _scheduler = AdaptiveDetectionScheduler();
+  Timer? _schedulerTimer;
+  static const Duration schedulerEvaluationInterval = Duration(seconds: 5);
+
+  // Tiled inference (Linux native engine): extra crops of the frame so
+  // small, distant people survive the resize; the tile budget follows the
+  // scheduler mode
+  final RxBool isTiledInferenceEnabled = false.obs;
+
+  // IP camera or video file for detection instead of a local camera
+  // (Linux native engine); empty uses the selected local camera
+  final RxString detectionStreamUrl = ''.obs;
+
+  // Native inference runs below the UI's priority; the thread count and
+  // CPU pinning are measured once per device and then reused
+  static const int inferenceNice = 5;
+
   // Debug visualization properties
   final RxBool isDebugVisualizationEnabled = false.obs;
+
+  // Native preview textures (Linux): ring frames scaled natively, the debug
+  // one with the detector's boxes drawn in, so debug mode adds no PNG or
+  // base64 work while the native frame ring is fed
+  final WebRtcTextureBridge _textureBridge = WebRtcTextureBridge();
+  final Rxn<NativePreviewTexture> rawPreviewTexture =
+      Rxn<NativePreviewTexture>();
+  final Rxn<NativePreviewTexture> debugPreviewTexture =
+      Rxn<NativePreviewTexture>();
+  final RxBool isNativePreviewActive = false.obs;
+  final RxDouble nativePreviewAspectRatio = (4 / 3).obs;
   final RxList<DetectionBox> latestDetectionBoxes = <DetectionBox>[].obs;
   final RxnString debugVisualizationFrame =
       RxnString(); // Base64 encoded processed frame with bounding boxes
@@ -662,6 +714,45 @@ class PersonDetectionService extends GetxService {
         _storageService.read<bool>(AppConstants.keyPersonDetectionEnabled) ??
             true;
 
+    isMotionGateEnabled.value =
+        _storageService.read<bool>(AppConstants.keyMotionGateEnabled) ?? true;
+    ever(isMotionGateEnabled, (bool enabled) {
+      _storageService.write(AppConstants.keyMotionGateEnabled, enabled);
+      if (_nativeEngine.isLoaded) {
+        _nativeEngine.setMotionGate(enabled: enabled);
+      }
+    });
+
+    isAdaptiveSchedulingEnabled.value =
+        _storageService.read<bool>(AppConstants.keyAdaptiveSchedulingEnabled) ??
+            true;
+    ever(isAdaptiveSchedulingEnabled, (bool enabled) {
+      _storageService.write(AppConstants.keyAdaptiveSchedulingEnabled, enabled);
+      if (enabled) {
+        _startScheduler();
+      } else {
+        _stopScheduler(restoreDefaults: true);
+      }
+    });
+
+    isTiledInferenceEnabled.value =
+        _storageService.read<bool>(AppConstants.keyTiledInferenceEnabled) ??
+            false;
+    ever(isTiledInferenceEnabled, (bool enabled) {
+      _storageService.write(AppConstants.keyTiledInferenceEnabled, enabled);
+      _applyTiling();
+    });
+
+    detectionStreamUrl.value =
+        _storageService.read<String>(AppConstants.keyDetectionStreamUrl) ?? '';
+    ever(detectionStreamUrl, (String url) {
+      _storageService.write(AppConstants.keyDetectionStreamUrl, url);
+      if (isEnabled.value) {
+        // An empty URL switches back to the selected local camera
+        switchCamera(url);
+      }
+    });
+
     // Initialize if enabled
     if (isEnabled.value) {
       final modelInitialized = await _initializeModel();
@@ -844,8 +935,10 @@ class PersonDetectionService extends GetxService {
 
   @override
   void onClose() {
+    _stopPreviewTextures();
     _stopDetection();
     _interpreter?.close();
+    _nativeEngine.unload();
     super.onClose();
   }
 
@@ -1078,6 +1171,33 @@ class PersonDetectionService extends GetxService {
         );
         _modelBytes = modelData.buffer.asUint8List();
 
+        // On Linux, load the model once into the native engine so frames are
+        // no longer run through Interpreter.fromBuffer in an isolate
+        if (NativeDetectionEngine.isSupported && !_nativeEngine.isLoaded) {
+          final threads = _storedInferenceThreads();
+          if (await _nativeEngine.loadModel(
+            _modelBytes!,
+            numThreads: threads?['numThreads'] as int? ?? 0,
+            cpus: threads == null
+                ? null
+                : List<int>.from(threads['cpus'] as List? ?? const []),
+            nice: inferenceNice,
+          )) {
+            if (threads == null) {
+              await _tuneInferenceThreads();
+            }
+            _publishInferenceConfig();
+            _nativeEngine.startFrameEvents();
+            await _nativeEngine.configurePostprocess(
+              classThresholds: {personClassId: confidenceThreshold},
+            );
+            await _nativeEngine.setMotionGate(
+              enabled: isMotionGateEnabled.value,
+            );
+            _applyTiling();
+          }
+        }
+
         // Create interpreter with GPU delegate on Android for better performance
         if (Platform.isAndroid) {
           try {
@@ -1361,6 +1481,39 @@ class PersonDetectionService extends GetxService {
         }
       }
 
+      // An IP camera or video file feeds the native engine's frame ring
+      // like a local camera would
+      final streamUrl = NativeCameraCapture.isStreamUrl(actualDeviceId)
+          ? actualDeviceId
+          : (deviceId == null || deviceId.isEmpty) &&
+                  detectionStreamUrl.value.isNotEmpty
+              ? detectionStreamUrl.value
+              : null;
+      if (streamUrl != null) {
+        if (_nativeEngine.isLoaded &&
+            await _nativeCapture.startStream(url: streamUrl)) {
+          isFrameSourceReal.value = true;
+          frameSourceStatus.value = 'Native stream ($streamUrl)';
+          _startFrameProcessing();
+          print('✅ Person detection started using stream $streamUrl');
+          return true;
+        }
+        print('⚠️ Stream source unavailable, using the local camera');
+        actualDeviceId = null;
+      }
+
+      // On Linux, capture straight from V4L2 into the native engine's frame
+      // ring; the WebRTC stream below is only the fallback
+      if (_nativeEngine.isLoaded &&
+          await _nativeCapture.start(deviceId: actualDeviceId)) {
+        isFrameSourceReal.value = true;
+        frameSourceStatus.value =
+            'Native V4L2 capture (${_nativeCapture.activeDevice}, ${_nativeCapture.activeFormat})';
+        _startFrameProcessing();
+        print('✅ Person detection started using native V4L2 capture');
+        return true;
+      }
+
       // Initialize video renderer if not already done
       if (_videoRenderer == null) {
         _videoRenderer = webrtc.RTCVideoRenderer();
@@ -1437,6 +1590,12 @@ class PersonDetectionService extends GetxService {
   void _stopDetection() {
     _processingTimer?.cancel();
     _processingTimer = null;
+    _stopScheduler();
+
+    if (isRecordingFrames.value) {
+      stopFrameRecording();
+    }
+    _nativeCapture.stop();
 
     // Clean up camera stream and video renderer - direct approach
     _cameraStream?.getTracks().forEach((track) => track.stop());
@@ -1473,6 +1632,189 @@ class PersonDetectionService extends GetxService {
     print(
       '📊 Frame processing timer started: check every ${checkInterval.inMilliseconds}ms, analyze every ${analysisInterval.inMilliseconds}ms',
     );
+
+    if (_schedulerTimer == null) {
+      _startScheduler();
+    }
+  }
+
+  /// Start periodic scheduler evaluation; only the native engine reports
+  /// the stage timings it needs
+  void _startScheduler() {
+    if (!isAdaptiveSchedulingEnabled.value ||
+        !_nativeEngine.isLoaded ||
+        _processingTimer == null) {
+      return;
+    }
+    _schedulerTimer?.cancel();
+    _schedulerTimer = Timer.periodic(
+      schedulerEvaluationInterval,
+      (_) => _evaluateScheduler(),
+    );
+    print('📊 Adaptive detection scheduler started');
+  }
+
+  void _stopScheduler({bool restoreDefaults = false}) {
+    _schedulerTimer?.cancel();
+    _schedulerTimer = null;
+    if (!restoreDefaults) return;
+
+    detectionMode.value = 'manual';
+    schedulerReason.value = '';
+    setAnalysisInterval(defaultAnalysisInterval);
+    if (_nativeEngine.isLoaded) {
+      _nativeEngine.setMotionGate(
+        enabled: isMotionGateEnabled.value,
+        keepAlive: const Duration(seconds: 10),
+      );
+    }
+    if (_nativeCapture.isRunning) {
+      _nativeCapture.setPublishing(publishFps: 0);
+      _nativeCapture.setIdle(false);
+    }
+  }
+
+  /// Feed the scheduler the current scene and load, and apply its decision
+  /// when it changed
+  void _evaluateScheduler() {
+    final personTracked = detectedObjects.any(
+      (box) => box.classId == personClassId && box.trackId != null,
+    );
+    final decision = _scheduler.evaluate(
+      personTracked: personTracked || isPersonPresent.value,
+      objectsPresent: detectedObjects.isNotEmpty,
+      motionDetected: motionScore.value >= 0.02,
+      loadPerCore: AdaptiveDetectionScheduler.readLoadPerCore(),
+    );
+    if (decision == null) return;
+
+    final mode = decision.mode.toString().split('.').last;
+    print(
+      '📊 Scheduler: $mode, every ${decision.interval.inMilliseconds}ms at '
+      '${decision.resolution.label} (${decision.reason})',
+    );
+    detectionMode.value = mode;
+    schedulerReason.value = decision.reason;
+
+    setAnalysisInterval(decision.interval);
+    _nativeEngine.setMotionGate(
+      enabled: isMotionGateEnabled.value ||
+          decision.mode == DetectionMode.motionOnly,
+      keepAlive: decision.keepAlive,
+    );
+    if (_nativeCapture.isRunning) {
+      // Two ring frames per analysis keep the motion gate's reference fresh
+      final publishFps =
+          (2000 / decision.interval.inMilliseconds).clamp(0.25, 4.0);
+      _nativeCapture.setPublishing(
+        publishFps: publishFps.toDouble(),
+        publishWidth: decision.resolution.width,
+        publishHeight: decision.resolution.height,
+      );
+      // Streams decode keyframes only while nothing is going on
+      _nativeCapture.setIdle(decision.mode == DetectionMode.idle);
+    }
+    _applyTiling();
+    _publishSchedulerState();
+  }
+
+  /// Push the tiling setting to the native engine. Tiles cost one extra
+  /// inference each, so the budget shrinks as the scheduler backs off.
+  void _applyTiling() {
+    if (!_nativeEngine.isLoaded) return;
+    int maxTiles = 0;
+    if (isTiledInferenceEnabled.value) {
+      switch (_scheduler.current.mode) {
+        case DetectionMode.tracking:
+        case DetectionMode.active:
+          maxTiles = 4;
+          break;
+        case DetectionMode.idle:
+          maxTiles = 2;
+          break;
+        case DetectionMode.motionOnly:
+          break;
+      }
+    }
+    _nativeEngine.setTiling(
+      mode: maxTiles > 0 ? NativeTilingMode.gridAndRoi : NativeTilingMode.off,
+      maxTiles: maxTiles,
+    );
+  }
+
+  /// Thread setup saved by an earlier benchmark on this machine, or null
+  /// when there is none or the core count has changed since
+  Map<String, dynamic>? _storedInferenceThreads() {
+    final stored =
+        _storageService.read<String>(AppConstants.keyInferenceThreadConfig);
+    if (stored == null) return null;
+    try {
+      final config = Map<String, dynamic>.from(jsonDecode(stored) as Map);
+      if (config['cores'] != Platform.numberOfProcessors) return null;
+      return config;
+    } catch (e) {
+      return null;
+    }
+  }
+
+  /// Measure the loaded model at each thread count and keep the cheapest
+  /// setup close to the fastest one; the engine switches to it directly
+  Future<void> _tuneInferenceThreads() async {
+    print('⏱️ Benchmarking native inference thread counts...');
+    final result = await _nativeEngine.benchmarkThreads();
+    if (result == null) return;
+    _storageService.write(
+      AppConstants.keyInferenceThreadConfig,
+      jsonEncode({
+        'numThreads': result['numThreads'],
+        'cpus': result['cpus'],
+        'cores': Platform.numberOfProcessors,
+      }),
+    );
+    final cpus = _nativeEngine.cpusInUse;
+    print(
+      '✅ Native inference set to ${_nativeEngine.numThreadsInUse} threads'
+      '${cpus.isEmpty ? "" : " on CPUs ${cpus.join(",")}"}',
+    );
+  }
+
+  void _publishInferenceConfig() {
+    try {
+      if (!Get.isRegistered<MqttService>()) return;
+      final mqttService = Get.find<MqttService>();
+      if (!mqttService.isConnected.value) return;
+      mqttService.publishJsonToTopic(
+        'kingkiosk/${mqttService.deviceName.value}/inference_config',
+        {
+          'num_threads': _nativeEngine.numThreadsInUse,
+          'cpus': _nativeEngine.cpusInUse,
+          'nice': _nativeEngine.niceInUse,
+          'cores': Platform.numberOfProcessors,
+          if (_nativeEngine.threadWarning != null)
+            'warning': _nativeEngine.threadWarning,
+          'timestamp': DateTime.now().toIso8601String(),
+        },
+      );
+    } catch (e) {
+      print('❌ Error publishing inference config: $e');
+    }
+  }
+
+  void _publishSchedulerState() {
+    try {
+      if (!Get.isRegistered<MqttService>()) return;
+      final mqttService = Get.find<MqttService>();
+      if (!mqttService.isConnected.value) return;
+      mqttService.publishJsonToTopic(
+        'kingkiosk/${mqttService.deviceName.value}/detection_scheduler',
+        {
+          ..._scheduler.toJson(),
+          'timestamp': DateTime.now().toIso8601String(),
+        },
+      );
+    } catch (e) {
+      print('❌ Error publishing detection scheduler state: $e');
+    }
   }
 
   /// Wait for the video stream to be ready for frame capture
@@ -1573,13 +1915,37 @@ class PersonDetectionService extends GetxService {
 
   /// Process the current camera frame for person detection
   Future<void> _processCurrentFrame() async {
-    if (_videoRenderer == null || isProcessing.value || !_shouldRunAnalysis()) {
+    if ((_videoRenderer == null && !_nativeCapture.isRunning) ||
+        isProcessing.value ||
+        !_shouldRunAnalysis()) {
       return;
     }
 
     try {
       isProcessing.value = true;
 
+      // Frames already published into the native frame ring are detected in
+      // place, skipping captureFrame() and any encode/decode round trip
+      final ringFrame = _nativeEngine.isLoaded
+          ? _nativeEngine.freshRingFrame
+          : null;
+      isNativePreviewActive.value =
+          ringFrame != null && debugPreviewTexture.value != null;
+      if (ringFrame != null) {
+        if (ringFrame.height > 0) {
+          nativePreviewAspectRatio.value = ringFrame.width / ringFrame.height;
+        }
+        final enhancedResult = await _runNativeInference(ringFrame: ringFrame);
+        confidence.value = enhancedResult.maxPersonConfidence;
+        _processAllDetectedObjects(enhancedResult.detectionBoxes);
+        if (isDebugVisualizationEnabled.value) {
+          latestDetectionBoxes.value = enhancedResult.detectionBoxes;
+        }
+        _markAnalysisPerformed();
+        _updatePresenceAndPublish();
+        return;
+      }
+
       // If TensorFlow Lite interpreter is available, use real detection
       if (_interpreter != null) {
         // Capture frame from video renderer
@@ -1677,10 +2043,12 @@ class PersonDetectionService extends GetxService {
             isQuantizedModel: _isQuantizedModel,
           );
 
-          final enhancedResult = await compute(
-            _runEnhancedInferenceInBackground,
-            enhancedInferenceData,
-          );
+          final enhancedResult = _nativeEngine.isLoaded
+              ? await _runNativeInference(frameData: frameData)
+              : await compute(
+                  _runEnhancedInferenceInBackground,
+                  enhancedInferenceData,
+                );
 
           if (enhancedResult.error != null) {
             throw Exception(
@@ -1849,21 +2217,7 @@ class PersonDetectionService extends GetxService {
           _markAnalysisPerformed();
         }
 
-        // Update presence detection
-        final wasPersonPresent = isPersonPresent.value;
-        isPersonPresent.value = confidence.value > confidenceThreshold;        // Publish to MQTT if status changed or periodically for all objects
-        if (wasPersonPresent != isPersonPresent.value ||
-            framesProcessed.value % 20 == 0) {
-          print('🔄 Publishing detection data - status changed: ${wasPersonPresent != isPersonPresent.value}, periodic: ${framesProcessed.value % 20 == 0}');
-          _publishAllDetections();
-          if (wasPersonPresent != isPersonPresent.value) {
-            print(
-              '🚨 Person presence changed: ${isPersonPresent.value ? "DETECTED" : "NOT DETECTED"} (confidence: ${confidence.value.toStringAsFixed(3)})',
-            );
-          }
-        }
-
-        framesProcessed.value++;
+        _updatePresenceAndPublish();
       } else {
         // Fallback mode: Simulate person detection for development/testing
         // This provides basic functionality when TensorFlow Lite is not available
@@ -1877,6 +2231,154 @@ class PersonDetectionService extends GetxService {
     }
   }
 
+  /// Update presence from the latest confidence and publish on change or
+  /// periodically for all objects
+  void _updatePresenceAndPublish() {
+    final wasPersonPresent = isPersonPresent.value;
+    isPersonPresent.value = confidence.value > confidenceThreshold;
+    // Tracked objects appearing or leaving also count as a state change;
+    // per-frame score jitter does not
+    final trackSignature = _trackSignature();
+    final tracksChanged = trackSignature != _lastTrackSignature;
+    _lastTrackSignature = trackSignature;
+    if (wasPersonPresent != isPersonPresent.value ||
+        tracksChanged ||
+        framesProcessed.value % 20 == 0) {
+      print('🔄 Publishing detection data - status changed: ${wasPersonPresent != isPersonPresent.value}, tracks changed: $tracksChanged, periodic: ${framesProcessed.value % 20 == 0}');
+      _publishAllDetections();
+      if (wasPersonPresent != isPersonPresent.value) {
+        print(
+          '🚨 Person presence changed: ${isPersonPresent.value ? "DETECTED" : "NOT DETECTED"} (confidence: ${confidence.value.toStringAsFixed(3)})',
+        );
+      }
+    }
+
+    framesProcessed.value++;
+  }
+
+  String _lastTrackSignature = '';
+
+  /// Sorted class:track id pairs of the current objects, empty when the
+  /// detections are not tracked
+  String _trackSignature() {
+    final ids = detectedObjects
+        .where((box) => box.trackId != null)
+        .map((box) => '${box.classId}:${box.trackId}')
+        .toList()
+      ..sort();
+    return ids.join(',');
+  }
+
+  /// Run a frame through the warm native engine and map the packed boxes
+  /// back onto the same result structure the isolate path produces. Either
+  /// [frameData] is sent over the channel or [ringFrame] is read in place.
+  Future<EnhancedInferenceResult> _runNativeInference({
+    Uint8List? frameData,
+    NativeFrameRef? ringFrame,
+  }) async {
+    final result = ringFrame != null
+        ? await _nativeEngine.detectRingFrame(
+            ringFrame,
+            threshold: objectDetectionThreshold,
+          )
+        : await _nativeEngine.detectFrame(
+            frameData!,
+            width: inputWidth,
+            height: inputHeight,
+            threshold: objectDetectionThreshold,
+          );
+
+    if (!result.skipped) {
+      _scheduler.recordTimings(result.timings);
+    }
+
+    if (result.motionScore != null) {
+      motionScore.value = result.motionScore!;
+      if (result.skipped) {
+        framesSkippedByMotion.value++;
+      } else if (result.keepAlive) {
+        keepAliveInferences.value++;
+      }
+    }
+
+    // Static scene: the previous detections still describe it. With
+    // tracking on the engine already carries the tracks over.
+    if (result.skipped && !result.isTracking) {
+      return EnhancedInferenceResult(
+        maxPersonConfidence: confidence.value,
+        numDetections: detectedObjects.length,
+        detectionBoxes: detectedObjects.toList(),
+        debugMetrics: {
+          'frameNumber': framesProcessed.value,
+          ...result.timings,
+          'isNativeEngine': true,
+          'isRingFrame': ringFrame != null,
+          'motionSkipped': true,
+          'motionScore': result.motionScore,
+        },
+      );
+    }
+
+    double maxPersonConfidence = 0.0;
+    final detectionBoxes = <DetectionBox>[];
+    for (final track in result.tracks) {
+      detectionBoxes.add(
+        DetectionBox(
+          x1: track.x1,
+          y1: track.y1,
+          x2: track.x2,
+          y2: track.y2,
+          confidence: track.score,
+          classId: track.classId,
+          className: _getClassNameForId(track.classId),
+          trackId: track.id,
+        ),
+      );
+      if (track.classId == personClassId &&
+          track.score > maxPersonConfidence) {
+        maxPersonConfidence = track.score;
+      }
+    }
+    for (int i = 0; i < result.length; i++) {
+      final offset = i * NativeDetectionResult.boxStride;
+      final classId = result.boxes[offset + 5].toInt();
+      final score = result.boxes[offset + 4];
+      detectionBoxes.add(
+        DetectionBox(
+          x1: result.boxes[offset],
+          y1: result.boxes[offset + 1],
+          x2: result.boxes[offset + 2],
+          y2: result.boxes[offset + 3],
+          confidence: score,
+          classId: classId,
+          className: _getClassNameForId(classId),
+        ),
+      );
+      if (classId == personClassId && score > maxPersonConfidence) {
+        maxPersonConfidence = score;
+      }
+    }
+
+    return EnhancedInferenceResult(
+      maxPersonConfidence: maxPersonConfidence,
+      numDetections: result.rawCount,
+      detectionBoxes: detectionBoxes,
+      debugMetrics: {
+        'frameNumber': framesProcessed.value,
+        ...result.timings,
+        'inputDimensions':
+            '${_nativeEngine.inputWidth}x${_nativeEngine.inputHeight}x$numChannels',
+        'rawFrameSize': frameData?.length ?? 0,
+        'detectionCount': detectionBoxes.length,
+        'isNativeEngine': true,
+        'isRingFrame': ringFrame != null,
+        'isTracking': result.isTracking,
+        'crops': result.crops,
+        if (result.motionScore != null) 'motionScore': result.motionScore,
+      },
+    );
+  }
+
   /// Simulate person detection when TensorFlow Lite is not available
   void _simulatePersonDetection() {
     // Simple simulation: randomly detect person presence
@@ -2294,6 +2796,7 @@ class PersonDetectionService extends GetxService {
                 (box) => {
                   'class_name': box.className,
                   'class_id': box.classId,
+                  if (box.trackId != null) 'track_id': box.trackId,
                   'confidence': box.confidence,
                   'bounding_box': {
                     'x1': box.x1,
@@ -2335,6 +2838,23 @@ class PersonDetectionService extends GetxService {
         );
         print('✅ Successfully published person presence data');
 
+        if (_nativeEngine.isLoaded && isMotionGateEnabled.value) {
+          mqttService.publishJsonToTopic(
+            'kingkiosk/${mqttService.deviceName.value}/motion_gate',
+            {
+              'motion_score': motionScore.value,
+              'frames_skipped': framesSkippedByMotion.value,
+              'keepalive_inferences': keepAliveInferences.value,
+              'frames_processed': framesProcessed.value,
+              'timestamp': DateTime.now().toIso8601String(),
+            },
+          );
+        }
+
+        if (_schedulerTimer != null) {
+          _publishSchedulerState();
+        }
+
         print(
           '📡 Published object detection data: ${objectCounts.length} object types detected (above ${(objectDetectionThreshold * 100).toInt()}% threshold)',
         );
@@ -2422,13 +2942,15 @@ class PersonDetectionService extends GetxService {
     return await startDetection(deviceId: deviceId);
   }
 
-  /// Get available camera devices from MediaDeviceService
+  /// Get available camera devices from MediaDeviceService, plus the
+  /// configured stream URL, which [switchCamera] accepts too
   List<String> getAvailableCameras() {
     try {
       final mediaDeviceService = Get.find<MediaDeviceService>();
-      return mediaDeviceService.videoInputs
-          .map((device) => device.deviceId)
-          .toList();
+      return [
+        ...mediaDeviceService.videoInputs.map((device) => device.deviceId),
+        if (detectionStreamUrl.value.isNotEmpty) detectionStreamUrl.value,
+      ];
     } catch (e) {
       print('⚠️ MediaDeviceService not available for camera enumeration: $e');
       return [];
@@ -2600,6 +3122,7 @@ class PersonDetectionService extends GetxService {
   /// Enable debug visualization to show detection boxes
   void enableDebugVisualization() {
     isDebugVisualizationEnabled.value = true;
+    _startPreviewTextures();
     print(
       '🐛 Debug visualization enabled - will capture real WebRTC frames when available',
     );
@@ -2619,9 +3142,46 @@ class PersonDetectionService extends GetxService {
     isDebugVisualizationEnabled.value = false;
     latestDetectionBoxes.clear();
     debugVisualizationFrame.value = null;
+    _stopPreviewTextures();
     print('🐛 Debug visualization disabled');
   }
 
+  /// Create the raw and annotated preview textures for the debug view
+  Future<void> _startPreviewTextures() async {
+    if (!WebRtcTextureBridge.isSupported ||
+        debugPreviewTexture.value != null) {
+      return;
+    }
+    final labels = List<String>.generate(90, _getClassNameForId);
+    final raw = await _textureBridge.create(
+      maxWidth: 480,
+      maxFps: 10,
+      overlay: false,
+    );
+    final annotated = await _textureBridge.create(labels: labels);
+    // Debug mode may have been switched off while the textures were created
+    if (!isDebugVisualizationEnabled.value) {
+      if (raw != null) _textureBridge.dispose(raw);
+      if (annotated != null) _textureBridge.dispose(annotated);
+      return;
+    }
+    rawPreviewTexture.value = raw;
+    debugPreviewTexture.value = annotated;
+    if (annotated != null) {
+      print('🖼️ Native preview texture ${annotated.textureId} created');
+    }
+  }
+
+  void _stopPreviewTextures() {
+    isNativePreviewActive.value = false;
+    final raw = rawPreviewTexture.value;
+    final annotated = debugPreviewTexture.value;
+    rawPreviewTexture.value = null;
+    debugPreviewTexture.value = null;
+    if (raw != null) _textureBridge.dispose(raw);
+    if (annotated != null) _textureBridge.dispose(annotated);
+  }
+
   /// Toggle debug visualization
   void toggleDebugVisualization() {
     if (isDebugVisualizationEnabled.value) {
@@ -2651,6 +3211,36 @@ class PersonDetectionService extends GetxService {
     return _cameraStream != null && _videoRenderer != null && isEnabled.value;
   }
 
+  /// Record the frames the native detector sees, so a field problem can be
+  /// replayed offline with the kiosk_vision_replay tool. Unlike
+  /// [_analyzeAndSaveFrameData] this keeps every frame with its timestamp.
+  Future<bool> startFrameRecording(String path, {int maxMb = 512}) async {
+    if (!_nativeCapture.isRunning) {
+      print('⚠️ Frame recording needs the native capture path');
+      return false;
+    }
+    final stats = await _nativeCapture.startRecording(
+      path,
+      maxMb: maxMb,
+      metadata: {
+        'confidenceThreshold': confidenceThreshold.toString(),
+        'detectionMode': _scheduler.current.mode.toString(),
+      },
+    );
+    isRecordingFrames.value = stats != null;
+    return isRecordingFrames.value;
+  }
+
+  Future<Map<String, dynamic>?> stopFrameRecording() async {
+    isRecordingFrames.value = false;
+    final stats = await _nativeCapture.stopRecording();
+    if (stats != null) {
+      print('⏹️ Frame recording stopped: ${stats['framesWritten']} frames, '
+          '${stats['framesDropped']} dropped');
+    }
+    return stats;
+  }
+
   /// Public getter for the current camera stream (for use in settings preview widget)
   webrtc.MediaStream? get cameraStream => _cameraStream;
 
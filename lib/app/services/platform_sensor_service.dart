@@ -8,6 +8,7 @@ import 'package:battery_plus/battery_plus.dart';
 import 'package:device_info_plus/device_info_plus.dart';
 import 'package:geolocator/geolocator.dart';
 import '../core/utils/permissions_manager.dart';
+import 'native_system_metrics.dart';
 
 // These methods have been integrated directly into _getDeviceInfo
 // to simplify the code and avoid unused methods
@@ -155,6 +156,10 @@ class PlatformSensorService extends GetxService {
     // Initialize battery monitoring
     _initBatteryMonitoring();
 
+    // On Linux CPU and memory come from the native sampler, which reads
+    // /proc on its own thread; the timer below only picks up its values
+    NativeSystemMetrics.startSampler();
+
     // Start periodic monitoring for other resources
     _resourceMonitorTimer =
         Timer.periodic(const Duration(seconds: 60), (timer) async {
@@ -218,10 +223,23 @@ class PlatformSensorService extends GetxService {
       accelerometerZ.value = (DateTime.now().millisecond % 50) / 100;
 
       // Update system resource usage
-      // In a real app, you'd get these from system APIs
-      // For now, we'll generate semi-random values that seem realistic
-      cpuUsage.value = (DateTime.now().millisecond % 100) / 100;
-      memoryUsage.value = (DateTime.now().second % 100) / 100;
+      final sample = await NativeSystemMetrics.current();
+      if (sample != null) {
+        // Averaged over the interval rather than one instant
+        final window = await NativeSystemMetrics.window(
+            const Duration(seconds: 60),
+            metrics: ['cpu', 'memUsedRatio']);
+        cpuUsage.value = window?['cpu']?.avg ??
+            (sample['cpu'] as num?)?.toDouble() ??
+            cpuUsage.value;
+        memoryUsage.value =
+            (sample['memUsedRatio'] as num?)?.toDouble() ?? memoryUsage.value;
+      } else if (!NativeSystemMetrics.isSupported) {
+        // In a real app, you'd get these from system APIs
+        // For now, we'll generate semi-random values that seem realistic
+        cpuUsage.value = (DateTime.now().millisecond % 100) / 100;
+        memoryUsage.value = (DateTime.now().second % 100) / 100;
+      }
 
       developer.log('Updated all sensor data');
     } catch (e) {
@@ -0,0 +1,189 @@
+import '../core/utils/timer_wheel.dart';
+
+/// When a sensor value is worth publishing. Numeric values closer than
+/// [deadband] to the last published one are suppressed; values that never
+/// change are re-published every [heartbeat]; changes arriving within
+/// [minInterval] of the last publish are held back and only the newest is
+/// sent once it has passed.
+class SensorPolicy {
+  final double deadband;
+  final Duration minInterval;
+  final Duration heartbeat;
+
+  const SensorPolicy({
+    this.deadband = 0,
+    this.minInterval = const Duration(seconds: 1),
+    this.heartbeat = const Duration(minutes: 5),
+  });
+}
+
+class _TopicState {
+  String? value;
+  int sentUs = -1;
+  String? held;
+  bool heldRetain = true;
+  TimerWheelEntry? flush;
+}
+
+/// Publisher layer between MqttService and the transport that remembers
+/// what each topic last carried.
+///
+/// Sensor values go out only when they change beyond their policy's
+/// deadband, rate limited and with a heartbeat. Retained configs such as
+/// Home Assistant discovery are compared by hash and re-sent only when
+/// their payload changes.
+///
+/// [_send] returns whether the transport took the message; only then is
+/// it remembered, so nothing produced while disconnected is suppressed
+/// later.
+class SensorPublisher {
+  final bool Function(String topic, String payload, bool retain) _send;
+  final TimerWheel _wheel = TimerWheel(tick: Duration(milliseconds: 10));
+  final Map<String, _TopicState> _values = {};
+  final Map<String, int> _configHashes = {};
+
+  int sent = 0;
+  int heartbeats = 0;
+  int suppressed = 0;
+  int deadbanded = 0;
+  int coalesced = 0;
+  int configsSent = 0;
+  int configsSkipped = 0;
+
+  SensorPublisher(this._send);
+
+  /// Publish a sensor value on [topic] if [policy] says it is due.
+  /// [force] skips change detection and rate limiting. Returns whether it
+  /// was sent now.
+  bool publishValue(String topic, String value,
+      {SensorPolicy policy = const SensorPolicy(),
+      bool retain = true,
+      bool force = false}) {
+    final state = _values.putIfAbsent(topic, () => _TopicState());
+    final now = _wheel.nowUs;
+    final sinceUs = state.sentUs < 0 ? null : now - state.sentUs;
+
+    if (!force && state.value != null && sinceUs != null) {
+      final heartbeatDue = sinceUs >= policy.heartbeat.inMicroseconds;
+      if (!heartbeatDue) {
+        if (value == state.value) {
+          _dropHeld(state);
+          suppressed++;
+          return false;
+        }
+        if (_withinDeadband(state.value!, value, policy.deadband)) {
+          _dropHeld(state);
+          deadbanded++;
+          return false;
+        }
+        final waitUs = policy.minInterval.inMicroseconds - sinceUs;
+        if (waitUs > 0) {
+          if (state.held != null) coalesced++;
+          state.held = value;
+          state.heldRetain = retain;
+          state.flush ??= _wheel.scheduleAt(
+              now + waitUs, () => _flushHeld(topic, state));
+          return false;
+        }
+      } else if (value == state.value) {
+        heartbeats++;
+      }
+    }
+
+    _dropHeld(state);
+    return _sendValue(topic, state, value, retain);
+  }
+
+  /// Publish a retained config unless the same payload already went out
+  /// on [topic]; an empty payload deletes it. [force] always sends.
+  bool publishRetainedConfig(String topic, String payload,
+      {bool force = false}) {
+    final hash = _fnv1a(payload);
+    if (!force && _configHashes[topic] == hash) {
+      configsSkipped++;
+      return false;
+    }
+    if (!_send(topic, payload, true)) return false;
+    _configHashes[topic] = hash;
+    configsSent++;
+    return true;
+  }
+
+  /// Forget the last published values so the next round goes out in full.
+  /// Config hashes are kept.
+  void invalidateValues() {
+    for (final state in _values.values) {
+      _dropHeld(state);
+    }
+    _values.clear();
+  }
+
+  /// Forget everything, so configs are re-sent too; call on every connect,
+  /// a broker restarted without persistence has lost its retained configs
+  void invalidateAll() {
+    invalidateValues();
+    _configHashes.clear();
+  }
+
+  Map<String, dynamic> stats() => {
+        'sent': sent,
+        'heartbeats': heartbeats,
+        'suppressed_unchanged': suppressed,
+        'suppressed_deadband': deadbanded,
+        'coalesced': coalesced,
+        'held': _values.values.where((state) => state.held != null).length,
+        'configs_sent': configsSent,
+        'configs_skipped': configsSkipped,
+        'suppression_ratio': _ratio(
+            suppressed + deadbanded + coalesced + configsSkipped,
+            sent + configsSent),
+      };
+
+  bool _sendValue(String topic, _TopicState state, String value, bool retain) {
+    if (!_send(topic, value, retain)) return false;
+    state.value = value;
+    state.sentUs = _wheel.nowUs;
+    sent++;
+    return true;
+  }
+
+  void _flushHeld(String topic, _TopicState state) {
+    state.flush = null;
+    final held = state.held;
+    if (held == null || !identical(_values[topic], state)) return;
+    state.held = null;
+    _sendValue(topic, state, held, state.heldRetain);
+  }
+
+  void _dropHeld(_TopicState state) {
+    state.held = null;
+    final flush = state.flush;
+    if (flush != null) _wheel.cancel(flush);
+    state.flush = null;
+  }
+
+  static bool _withinDeadband(String last, String value, double deadband) {
+    if (deadband <= 0) return false;
+    final a = double.tryParse(last);
+    final b = double.tryParse(value);
+    if (a == null || b == null) return false;
+    return (a - b).abs() < deadband;
+  }
+
+  static double _ratio(int suppressed, int sent) {
+    final total = suppressed + sent;
+    if (total == 0) return 0;
+    return (suppressed / total * 1000).round() / 1000;
+  }
+
+  // 32-bit FNV-1a over the UTF-16 code units; the multiply by the FNV
+  // prime (2^24 + 0x193) is split so it stays exact on the web too
+  static int _fnv1a(String value) {
+    var hash = 0x811c9dc5;
+    for (final unit in value.codeUnits) {
+      hash ^= unit;
+      hash = (((hash << 24) & 0xffffffff) + hash * 0x193) & 0xffffffff;
+    }
+    return hash;
+  }
+}
@@ -3,6 +3,7 @@ import 'dart:io';
 import 'package:flutter/foundation.dart';
 import 'package:flutter_tts/flutter_tts.dart';
 import 'package:get/get.dart';
+import 'native_tts.dart';
 
 class TtsService extends GetxService {
   static TtsService get to => Get.find();
@@ -35,15 +36,26 @@ class TtsService extends GetxService {
   final RxBool isWeb = false.obs;
   final RxBool isDesktop = false.obs;
 
+  // Offline engine with a phrase cache (Linux runner only). Utterances
+  // queue natively; flutter_tts stays as the fallback.
+  final RxBool useNativeEngine = false.obs;
+  StreamSubscription<NativeTtsEvent>? _nativeEvents;
+  final Map<int, Map<String, dynamic>> _nativePending = {};
+
   @override
   Future<void> onInit() async {
     super.onInit();
     _detectPlatform();
     await _initializeTts();
+    await _initializeNativeTts();
   }
 
   @override
   void onClose() {
+    _nativeEvents?.cancel();
+    if (useNativeEngine.value) {
+      NativeTts.stop();
+    }
     _flutterTts?.stop();
     super.onClose();
   }
@@ -83,6 +95,44 @@ class TtsService extends GetxService {
     }
   }
 
+  Future<void> _initializeNativeTts() async {
+    if (!NativeTts.isSupported) return;
+    final info = await NativeTts.configure();
+    if (info == null) return;
+    _nativeEvents = NativeTts.events.listen(_onNativeEvent);
+    useNativeEngine.value = true;
+    engineName.value = info['engine'] as String? ?? 'native';
+    isInitialized.value = true;
+    print('TtsService: Native ${engineName.value} engine ready '
+        '(${info['diskPhrases']} cached phrases)');
+  }
+
+  void _onNativeEvent(NativeTtsEvent event) {
+    switch (event.type) {
+      case 'start':
+        isSpeaking.value = true;
+        isPaused.value = false;
+        print('TtsService: Speech started '
+            '(${event.cached ? 'cached' : 'synthesized'}, '
+            '${event.latencyMs.toStringAsFixed(0)} ms)');
+        break;
+      case 'done':
+        _nativePending.remove(event.id);
+        isSpeaking.value = _nativePending.isNotEmpty;
+        break;
+      case 'error':
+        final command = _nativePending.remove(event.id);
+        isSpeaking.value = _nativePending.isNotEmpty;
+        lastError.value = 'TTS Error: ${event.error}';
+        print('TtsService: Native engine failed: ${event.error}');
+        // Usually a voice the offline engine does not know
+        if (command != null) {
+          _executeSpeakCommand(command);
+        }
+        break;
+    }
+  }
+
   void _setupEventHandlers() {
     _flutterTts?.setStartHandler(() {
       isSpeaking.value = true;
@@ -209,6 +259,11 @@ class TtsService extends GetxService {
       'timestamp': DateTime.now().millisecondsSinceEpoch,
     };
 
+    // The native engine queues everything itself and synthesizes ahead
+    if (useNativeEngine.value) {
+      return await _speakNative(command);
+    }
+
     if (queue || isSpeaking.value) {
       commandQueue.add(command);
       print('TtsService: Added to queue. Queue size: ${commandQueue.length}');
@@ -218,6 +273,44 @@ class TtsService extends GetxService {
     return await _executeSpeakCommand(command);
   }
 
+  Future<bool> _speakNative(Map<String, dynamic> command) async {
+    final voice = command['voice'] as String? ??
+        (currentVoice.value.isEmpty ? null : currentVoice.value);
+    final id = await NativeTts.speak(
+      command['text'],
+      voice: voice,
+      language: command['language'] ?? currentLanguage.value,
+      rate: command['speechRate'] ?? speechRate.value,
+      pitch: command['pitch'] ?? pitch.value,
+      volume: command['volume'] ?? volume.value,
+    );
+    if (id == null) {
+      return await _executeSpeakCommand(command);
+    }
+    _nativePending[id] = command;
+    return true;
+  }
+
+  /// Synthesize [text] into the native phrase cache ahead of time, so its
+  /// first announcement starts immediately. No-op with flutter_tts.
+  Future<bool> prefetch(
+    String text, {
+    String? language,
+    String? voice,
+    double? speechRate,
+    double? pitch,
+  }) async {
+    if (!useNativeEngine.value || text.trim().isEmpty) return false;
+    await NativeTts.prefetch(
+      text,
+      voice: voice ?? (currentVoice.value.isEmpty ? null : currentVoice.value),
+      language: language ?? currentLanguage.value,
+      rate: speechRate ?? this.speechRate.value,
+      pitch: pitch ?? this.pitch.value,
+    );
+    return true;
+  }
+
   Future<bool> _executeSpeakCommand(Map<String, dynamic> command) async {
     try {
       isProcessingQueue.value = true;
@@ -263,9 +356,15 @@ class TtsService extends GetxService {
     if (!isInitialized.value) return false;
 
     try {
+      if (useNativeEngine.value) {
+        await NativeTts.stop();
+        _nativePending.clear();
+        isSpeaking.value = false;
+        isPaused.value = false;
+      }
       final result = await _flutterTts?.stop();
       clearQueue();
-      return result == 1;
+      return result == 1 || useNativeEngine.value;
     } catch (e) {
       lastError.value = 'Stop failed: $e';
       return false;
@@ -277,6 +376,11 @@ class TtsService extends GetxService {
     if (!isInitialized.value || !isSpeaking.value) return false;
 
     try {
+      if (useNativeEngine.value) {
+        await NativeTts.setPaused(true);
+        isPaused.value = true;
+        return true;
+      }
       final result = await _flutterTts?.pause();
       return result == 1;
     } catch (e) {
@@ -290,6 +394,11 @@ class TtsService extends GetxService {
     if (!isInitialized.value || !isPaused.value) return false;
 
     try {
+      if (useNativeEngine.value) {
+        await NativeTts.setPaused(false);
+        isPaused.value = false;
+        return true;
+      }
       // Note: Not all platforms support resume
       if (isAndroid.value || isIOS.value) {
         // For mobile platforms, we might need to re-speak from where we paused
@@ -310,7 +419,7 @@ class TtsService extends GetxService {
     try {
       final clampedVolume = vol.clamp(0.0, 1.0);
       final result = await _flutterTts?.setVolume(clampedVolume);
-      if (result == 1) {
+      if (result == 1 || useNativeEngine.value) {
         volume.value = clampedVolume;
         return true;
       }
@@ -328,7 +437,7 @@ class TtsService extends GetxService {
     try {
       final clampedRate = rate.clamp(0.0, 1.0);
       final result = await _flutterTts?.setSpeechRate(clampedRate);
-      if (result == 1) {
+      if (result == 1 || useNativeEngine.value) {
         speechRate.value = clampedRate;
         return true;
       }
@@ -346,7 +455,7 @@ class TtsService extends GetxService {
     try {
       final clampedPitch = p.clamp(0.5, 2.0);
       final result = await _flutterTts?.setPitch(clampedPitch);
-      if (result == 1) {
+      if (result == 1 || useNativeEngine.value) {
         pitch.value = clampedPitch;
         return true;
       }
@@ -430,7 +539,7 @@ class TtsService extends GetxService {
       'pitch': pitch.value,
       'language': currentLanguage.value,
       'voice': currentVoice.value,
-      'queueSize': commandQueue.length,
+      'queueSize': commandQueue.length + _nativePending.length,
       'lastError': lastError.value,
       'platform': {
         'android': isAndroid.value,
@@ -439,6 +548,7 @@ class TtsService extends GetxService {
         'desktop': isDesktop.value,
       },
       'engine': engineName.value,
+      'nativeEngine': useNativeEngine.value,
     };
   }
 
@@ -549,6 +659,35 @@ class TtsService extends GetxService {
             'voices': availableVoices.toList()
           };
 
+        case 'prefetch':
+          final texts = command['texts'] is List
+              ? List<String>.from(command['texts'])
+              : <String>[command['text'] ?? command['message'] ?? ''];
+          var queued = 0;
+          for (final text in texts) {
+            if (await prefetch(
+              text,
+              language: command['language'],
+              voice: command['voice'],
+              speechRate: command['speechRate']?.toDouble() ??
+                  command['rate']?.toDouble(),
+              pitch: command['pitch']?.toDouble(),
+            )) {
+              queued++;
+            }
+          }
+          return {
+            'success': queued > 0,
+            'action': 'prefetch',
+            'count': queued
+          };
+
+        case 'clearcache':
+          if (useNativeEngine.value) {
+            await NativeTts.clearCache();
+          }
+          return {'success': useNativeEngine.value, 'action': 'clearCache'};
+
         case 'clearqueue':
           clearQueue();
           return {'success': true, 'action': 'clearQueue'};
@@ -579,8 +718,9 @@ class TtsService extends GetxService {
             'commandId': command['id'] ?? 'batch_$i'
           });
 
-          // Add small delay between commands to prevent audio overlap
-          if (i < commands.length - 1) {
+          // Add small delay between commands to prevent audio overlap;
+          // the native engine queues and spaces utterances itself
+          if (i < commands.length - 1 && !useNativeEngine.value) {
             final action = command['action'] ?? command['command'] ?? 'speak';
             if (action.toString().toLowerCase() == 'speak' ||
                 action.toString().toLowerCase() == 'say') {
@@ -0,0 +1,114 @@
+import 'dart:io';
+import 'package:flutter/services.dart';
+
+/// One Flutter texture fed from the native frame ring
+class NativePreviewTexture {
+  final int textureId;
+  int width;
+  int height;
+
+  NativePreviewTexture({
+    required this.textureId,
+    this.width = 0,
+    this.height = 0,
+  });
+
+  /// Width over height of the last rendered frame, 4:3 before the first
+  double get aspectRatio => width > 0 && height > 0 ? width / height : 4 / 3;
+}
+
+/// Client for the pixel buffer textures in linux/plugins/kiosk_vision.
+///
+/// Frames published into the native frame ring, by the WebRTC track sink
+/// or the V4L2 capture, are scaled into a texture on the producer thread
+/// and, with [overlay] on, get the detector's latest boxes and labels drawn
+/// in natively. Show one with `Texture(textureId: ...)`: the picture
+/// updates in place and nothing is PNG encoded, base64 encoded or decoded
+/// in Dart, so a live preview and the detection debug view cost about one
+/// frame copy each.
+class WebRtcTextureBridge {
+  static const MethodChannel _channel = MethodChannel(
+    'com.ki.king_kiosk/vision',
+  );
+
+  /// Only the Linux runner registers the texture plugin
+  static bool get isSupported => Platform.isLinux;
+
+  /// Create a texture. Frames wider than [maxWidth] are scaled down and
+  /// frames faster than [maxFps] dropped; [labels] names class ids in the
+  /// overlay. Returns null when unavailable.
+  Future<NativePreviewTexture?> create({
+    int maxWidth = 640,
+    double maxFps = 15,
+    bool overlay = true,
+    List<String>? labels,
+  }) async {
+    if (!isSupported) return null;
+    try {
+      final info = await _channel.invokeMapMethod<String, dynamic>(
+        'createPreviewTexture',
+        {
+          'maxWidth': maxWidth,
+          'maxFps': maxFps,
+          'overlay': overlay,
+          if (labels != null) 'labels': labels,
+        },
+      );
+      if (info == null) return null;
+      return NativePreviewTexture(textureId: info['textureId'] as int);
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Failed to create native preview texture: ${e.message}');
+      return null;
+    }
+  }
+
+  /// Change the settings of [texture]; omitted values are kept. Also
+  /// refreshes its frame size. Returns the render stats (framesRendered,
+  /// framesSkipped, renderTime), or null if unavailable.
+  Future<Map<String, dynamic>?> configure(
+    NativePreviewTexture texture, {
+    int? maxWidth,
+    double? maxFps,
+    bool? overlay,
+    List<String>? labels,
+  }) async {
+    if (!isSupported) return null;
+    try {
+      final info = await _channel.invokeMapMethod<String, dynamic>(
+        'configurePreviewTexture',
+        {
+          'textureId': texture.textureId,
+          if (maxWidth != null) 'maxWidth': maxWidth,
+          if (maxFps != null) 'maxFps': maxFps,
+          if (overlay != null) 'overlay': overlay,
+          if (labels != null) 'labels': labels,
+        },
+      );
+      if (info == null) return null;
+      texture.width = info['width'] as int;
+      texture.height = info['height'] as int;
+      return info;
+    } on MissingPluginException {
+      return null;
+    } on PlatformException catch (e) {
+      print('⚠️ Failed to configure native preview texture: ${e.message}');
+      return null;
+    }
+  }
+
+  Future<void> dispose(NativePreviewTexture texture) async {
+    if (!isSupported) return;
+    try {
+      await _channel.invokeMethod(
+        'disposePreviewTexture',
+        {'textureId': texture.textureId},
+      );
+    } on MissingPluginException {
+      // Nothing to release
+    } on PlatformException catch (e) {
+      print('⚠️ Failed to dispose native preview texture: ${e.message}');
+    }
+  }
+}
@@ -0,0 +1,28 @@
+#ifndef FLUTTER_PLUGIN_KIOSK_AUDIO_PLUGIN_H_
+#define FLUTTER_PLUGIN_KIOSK_AUDIO_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_BEGIN_DECLS
+
+#ifdef FLUTTER_PLUGIN_IMPL
+#define FLUTTER_PLUGIN_EXPORT __attribute__((visibility("default")))
+#else
+#define FLUTTER_PLUGIN_EXPORT
+#endif
+
+typedef struct _KioskAudioPlugin KioskAudioPlugin;
+typedef struct {
+  GObjectClass parent_class;
+} KioskAudioPluginClass;
+
+FLUTTER_PLUGIN_EXPORT GType kiosk_audio_plugin_get_type();
+
+// Registers the native audio engine on the "com.ki.king_kiosk/audio"
+// method channel.
+FLUTTER_PLUGIN_EXPORT void kiosk_audio_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+G_END_DECLS
+
+#endif  // FLUTTER_PLUGIN_KIOSK_AUDIO_PLUGIN_H_
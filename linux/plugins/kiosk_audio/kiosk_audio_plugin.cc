@@ -0,0 +1,912 @@
+#include "include/kiosk_audio/kiosk_audio_plugin.h"
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "sound_mixer.h"
+#include "spectrum_hub.h"
+#include "speech_engine.h"
+#include "wav_decoder.h"
+#include "wyoming_client.h"
+
+#ifdef KIOSK_AUDIO_HAVE_PULSE
+#include "pulse_capture.h"
+#include "pulse_playback.h"
+#endif
+
+#define KIOSK_AUDIO_PLUGIN(obj)                                     \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), kiosk_audio_plugin_get_type(), \
+                              KioskAudioPlugin))
+
+namespace {
+
+const char kChannelName[] = "com.ki.king_kiosk/audio";
+const char kSpectrumChannelName[] = "com.ki.king_kiosk/audio/spectrum";
+const char kWyomingChannelName[] = "com.ki.king_kiosk/audio/wyoming";
+const char kTtsChannelName[] = "com.ki.king_kiosk/audio/tts";
+const char kErrorCode[] = "AUDIO_ERROR";
+
+FlValue* lookup(FlValue* args, const char* key, FlValueType type) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  FlValue* value = fl_value_lookup_string(args, key);
+  return value != nullptr && fl_value_get_type(value) == type ? value
+                                                              : nullptr;
+}
+
+int64_t lookup_int(FlValue* args, const char* key, int64_t fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_INT);
+  return value != nullptr ? fl_value_get_int(value) : fallback;
+}
+
+double lookup_double(FlValue* args, const char* key, double fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_FLOAT);
+  return value != nullptr ? fl_value_get_float(value) : fallback;
+}
+
+bool lookup_bool(FlValue* args, const char* key, bool fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_BOOL);
+  return value != nullptr ? fl_value_get_bool(value) : fallback;
+}
+
+std::string lookup_string(FlValue* args, const char* key,
+                          const char* fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_STRING);
+  return value != nullptr ? fl_value_get_string(value) : fallback;
+}
+
+kiosk_audio::SpectrumConfig spectrum_config_from_args(FlValue* args) {
+  kiosk_audio::SpectrumConfig config;
+  config.bars = static_cast<int>(lookup_int(args, "bars", config.bars));
+  config.fft_size =
+      static_cast<int>(lookup_int(args, "fftSize", config.fft_size));
+  config.fps = lookup_double(args, "fps", config.fps);
+  config.min_hz = lookup_double(args, "minHz", config.min_hz);
+  config.max_hz = lookup_double(args, "maxHz", config.max_hz);
+  config.floor_db = lookup_double(args, "floorDb", config.floor_db);
+  config.ceiling_db = lookup_double(args, "ceilingDb", config.ceiling_db);
+  config.tilt_db_per_octave =
+      lookup_double(args, "tiltDbPerOctave", config.tilt_db_per_octave);
+  config.attack = lookup_double(args, "attack", config.attack);
+  config.release_per_s =
+      lookup_double(args, "releasePerSecond", config.release_per_s);
+  config.peak_hold_s =
+      lookup_double(args, "peakHoldMs", config.peak_hold_s * 1000) / 1000;
+  config.peak_decay_per_s =
+      lookup_double(args, "peakDecayPerSecond", config.peak_decay_per_s);
+  return config;
+}
+
+FlValue* spectrum_config_to_value(const kiosk_audio::SpectrumConfig& config) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "bars", fl_value_new_int(config.bars));
+  fl_value_set_string_take(map, "fftSize", fl_value_new_int(config.fft_size));
+  fl_value_set_string_take(map, "fps", fl_value_new_float(config.fps));
+  fl_value_set_string_take(map, "minHz", fl_value_new_float(config.min_hz));
+  fl_value_set_string_take(map, "maxHz", fl_value_new_float(config.max_hz));
+  return map;
+}
+
+FlValue* spectrum_stats_to_value(const kiosk_audio::SpectrumHubStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "capturing",
+                           fl_value_new_bool(stats.capturing));
+  fl_value_set_string_take(map, "sampleRate",
+                           fl_value_new_int(stats.sample_rate));
+  fl_value_set_string_take(map, "analyzers",
+                           fl_value_new_int(stats.analyzers));
+  fl_value_set_string_take(map, "active", fl_value_new_int(stats.active));
+  fl_value_set_string_take(map, "blocks",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.blocks)));
+  fl_value_set_string_take(map, "frames",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames)));
+  if (!stats.source_error.empty()) {
+    fl_value_set_string_take(map, "error",
+                             fl_value_new_string(stats.source_error.c_str()));
+  }
+  return map;
+}
+
+FlValue* mixer_stats_to_value(const kiosk_audio::SoundMixerStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "open", fl_value_new_bool(stats.open));
+  fl_value_set_string_take(map, "sampleRate",
+                           fl_value_new_int(stats.sample_rate));
+  fl_value_set_string_take(map, "sounds", fl_value_new_int(stats.clips));
+  fl_value_set_string_take(map, "cachedBytes",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.cached_bytes)));
+  fl_value_set_string_take(map, "voices", fl_value_new_int(stats.voices));
+  fl_value_set_string_take(map, "played",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.played)));
+  fl_value_set_string_take(map, "stolen",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.stolen)));
+  fl_value_set_string_take(map, "blocks",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.blocks)));
+  fl_value_set_string_take(map, "latencyMs",
+                           fl_value_new_float(stats.latency_us / 1000.0));
+  if (!stats.error.empty()) {
+    fl_value_set_string_take(map, "error",
+                             fl_value_new_string(stats.error.c_str()));
+  }
+  return map;
+}
+
+kiosk_audio::WyomingConfig wyoming_config_from_args(FlValue* args) {
+  kiosk_audio::WyomingConfig config;
+  config.host = lookup_string(args, "host", config.host.c_str());
+  config.port = static_cast<int>(lookup_int(args, "port", config.port));
+  config.pipeline = lookup_bool(args, "pipeline", config.pipeline);
+  config.start_stage =
+      lookup_string(args, "startStage", config.start_stage.c_str());
+  config.end_stage = lookup_string(args, "endStage", config.end_stage.c_str());
+  config.language = lookup_string(args, "language", "");
+  config.pre_roll_ms =
+      static_cast<int>(lookup_int(args, "preRollMs", config.pre_roll_ms));
+  config.response_timeout_ms = static_cast<int>(
+      lookup_int(args, "responseTimeoutMs", config.response_timeout_ms));
+  kiosk_audio::VadConfig& vad = config.vad;
+  vad.threshold_db = lookup_double(args, "thresholdDb", vad.threshold_db);
+  vad.min_level_dbfs =
+      lookup_double(args, "minLevelDbfs", vad.min_level_dbfs);
+  vad.start_ms = static_cast<int>(lookup_int(args, "startMs", vad.start_ms));
+  vad.end_silence_ms =
+      static_cast<int>(lookup_int(args, "endSilenceMs", vad.end_silence_ms));
+  vad.max_segment_ms =
+      static_cast<int>(lookup_int(args, "maxSegmentMs", vad.max_segment_ms));
+  return config;
+}
+
+FlValue* latency_to_value(const kiosk_audio::LatencySummary& summary) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "count",
+                           fl_value_new_int(static_cast<int64_t>(
+                               summary.count)));
+  fl_value_set_string_take(map, "lastMs",
+                           fl_value_new_float(summary.last_ms));
+  fl_value_set_string_take(map, "p50Ms", fl_value_new_float(summary.p50_ms));
+  fl_value_set_string_take(map, "p95Ms", fl_value_new_float(summary.p95_ms));
+  fl_value_set_string_take(map, "maxMs", fl_value_new_float(summary.max_ms));
+  return map;
+}
+
+FlValue* wyoming_stats_to_value(const kiosk_audio::WyomingStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(
+      map, "state",
+      fl_value_new_string(kiosk_audio::WyomingStateName(stats.state)));
+  fl_value_set_string_take(map, "connected",
+                           fl_value_new_bool(stats.connected));
+  fl_value_set_string_take(map, "reconnects",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.reconnects)));
+  fl_value_set_string_take(map, "segments",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.segments)));
+  fl_value_set_string_take(map, "chunksSent",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.chunks_sent)));
+  fl_value_set_string_take(map, "bytesSent",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.bytes_sent)));
+  fl_value_set_string_take(map, "responses",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.responses)));
+  fl_value_set_string_take(map, "samplesDropped",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.samples_dropped)));
+  fl_value_set_string_take(map, "noiseFloorDb",
+                           fl_value_new_float(stats.noise_floor_db));
+  fl_value_set_string_take(map, "transcriptLatency",
+                           latency_to_value(stats.transcript));
+  fl_value_set_string_take(map, "firstAudioLatency",
+                           latency_to_value(stats.first_audio));
+  fl_value_set_string_take(map, "responseLatency",
+                           latency_to_value(stats.heard));
+  fl_value_set_string_take(
+      map, "lastTranscript",
+      fl_value_new_string(stats.last_transcript.c_str()));
+  if (!stats.last_error.empty()) {
+    fl_value_set_string_take(map, "error",
+                             fl_value_new_string(stats.last_error.c_str()));
+  }
+  return map;
+}
+
+const char* wyoming_update_type(kiosk_audio::WyomingUpdate::Kind kind) {
+  switch (kind) {
+    case kiosk_audio::WyomingUpdate::Kind::kState:
+      return "state";
+    case kiosk_audio::WyomingUpdate::Kind::kTranscript:
+      return "transcript";
+    case kiosk_audio::WyomingUpdate::Kind::kResponseAudio:
+      return "response";
+    case kiosk_audio::WyomingUpdate::Kind::kError:
+      return "error";
+  }
+  return "state";
+}
+
+kiosk_audio::SpeechRequest speech_request_from_args(FlValue* args) {
+  kiosk_audio::SpeechRequest request;
+  request.text = lookup_string(args, "text", "");
+  request.voice = lookup_string(args, "voice", "");
+  request.language =
+      lookup_string(args, "language", request.language.c_str());
+  request.rate =
+      static_cast<float>(lookup_double(args, "rate", request.rate));
+  request.pitch =
+      static_cast<float>(lookup_double(args, "pitch", request.pitch));
+  return request;
+}
+
+kiosk_audio::SpeechEngineConfig speech_config_from_args(FlValue* args) {
+  kiosk_audio::SpeechEngineConfig config;
+  config.gap_ms = static_cast<int>(lookup_int(args, "gapMs", config.gap_ms));
+  config.lookahead =
+      static_cast<int>(lookup_int(args, "lookahead", config.lookahead));
+  config.cache.memory_bytes = static_cast<size_t>(
+      lookup_int(args, "memoryCacheMb", config.cache.memory_bytes >> 20))
+      << 20;
+  config.cache.disk_bytes = static_cast<size_t>(
+      lookup_int(args, "diskCacheMb", config.cache.disk_bytes >> 20))
+      << 20;
+  FlValue* directory = lookup(args, "cacheDir", FL_VALUE_TYPE_STRING);
+  if (directory != nullptr) {
+    // An empty directory keeps phrases in memory only.
+    config.cache.directory = fl_value_get_string(directory);
+  } else {
+    g_autofree gchar* path =
+        g_build_filename(g_get_user_cache_dir(), "king_kiosk", "tts", nullptr);
+    config.cache.directory = path;
+  }
+  return config;
+}
+
+FlValue* speech_stats_to_value(const kiosk_audio::SpeechEngineStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "engine",
+                           fl_value_new_string(stats.engine.c_str()));
+  fl_value_set_string_take(map, "open", fl_value_new_bool(stats.open));
+  fl_value_set_string_take(map, "paused", fl_value_new_bool(stats.paused));
+  fl_value_set_string_take(map, "queued", fl_value_new_int(stats.queued));
+  fl_value_set_string_take(map, "speaking", fl_value_new_int(stats.speaking));
+  fl_value_set_string_take(map, "prefetching",
+                           fl_value_new_int(stats.prefetching));
+  fl_value_set_string_take(map, "spoken",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.spoken)));
+  fl_value_set_string_take(map, "synthesized",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.synthesized)));
+  fl_value_set_string_take(map, "failed",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.failed)));
+  fl_value_set_string_take(map, "stalls",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.stalls)));
+  fl_value_set_string_take(map, "lastSynthesisMs",
+                           fl_value_new_float(stats.last_synthesis_ms));
+  fl_value_set_string_take(map, "averageSynthesisMs",
+                           fl_value_new_float(stats.average_synthesis_ms));
+  fl_value_set_string_take(map, "lastStartMs",
+                           fl_value_new_float(stats.last_start_ms));
+  fl_value_set_string_take(map, "cachedPhrases",
+                           fl_value_new_int(stats.cache.entries));
+  fl_value_set_string_take(map, "memoryCacheBytes",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.cache.memory_bytes)));
+  fl_value_set_string_take(map, "diskPhrases",
+                           fl_value_new_int(stats.cache.disk_entries));
+  fl_value_set_string_take(map, "diskCacheBytes",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.cache.disk_bytes)));
+  fl_value_set_string_take(map, "memoryHits",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.cache.memory_hits)));
+  fl_value_set_string_take(map, "diskHits",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.cache.disk_hits)));
+  fl_value_set_string_take(map, "misses",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.cache.misses)));
+  if (!stats.error.empty()) {
+    fl_value_set_string_take(map, "error",
+                             fl_value_new_string(stats.error.c_str()));
+  }
+  return map;
+}
+
+const char* speech_update_type(kiosk_audio::SpeechUpdate::Kind kind) {
+  switch (kind) {
+    case kiosk_audio::SpeechUpdate::Kind::kStart:
+      return "start";
+    case kiosk_audio::SpeechUpdate::Kind::kDone:
+      return "done";
+    case kiosk_audio::SpeechUpdate::Kind::kError:
+      return "error";
+  }
+  return "done";
+}
+
+}  // namespace
+
+struct _KioskAudioPlugin {
+  GObject parent_instance;
+
+  // Output monitor shared by every visualizer tile.
+  kiosk_audio::SpectrumHub* spectrum_hub;
+  FlEventChannel* spectrum_channel;
+  gboolean spectrum_listening;
+  // Newest frame per analyzer, waiting for the main loop. A slow main loop
+  // only ever sees the latest bars, never a backlog.
+  std::mutex* spectrum_mutex;
+  std::map<int, std::vector<float>>* spectrum_frames;
+  std::atomic<bool>* spectrum_event_pending;
+
+  // One output stream for every sound effect.
+  kiosk_audio::SoundMixer* sound_mixer;
+
+  // Voice satellite; null until started.
+  kiosk_audio::WyomingClient* wyoming;
+  FlEventChannel* wyoming_channel;
+  gboolean wyoming_listening;
+  // Updates are few and each matters, so they queue rather than coalesce.
+  std::mutex* wyoming_mutex;
+  std::vector<kiosk_audio::WyomingUpdate>* wyoming_updates;
+  std::atomic<bool>* wyoming_event_pending;
+
+  // Offline speech; null until configured.
+  kiosk_audio::SpeechEngine* speech;
+  FlEventChannel* tts_channel;
+  gboolean tts_listening;
+  std::mutex* tts_mutex;
+  std::vector<kiosk_audio::SpeechUpdate>* tts_updates;
+  std::atomic<bool>* tts_event_pending;
+};
+
+G_DEFINE_TYPE(KioskAudioPlugin, kiosk_audio_plugin, g_object_get_type())
+
+static gboolean deliver_spectrum_frames(gpointer user_data) {
+  KioskAudioPlugin* self = KIOSK_AUDIO_PLUGIN(user_data);
+  self->spectrum_event_pending->store(false);
+  std::map<int, std::vector<float>> frames;
+  {
+    std::lock_guard<std::mutex> lock(*self->spectrum_mutex);
+    frames.swap(*self->spectrum_frames);
+  }
+  if (self->spectrum_listening) {
+    for (const auto& entry : frames) {
+      g_autoptr(FlValue) event = fl_value_new_map();
+      fl_value_set_string_take(event, "id", fl_value_new_int(entry.first));
+      fl_value_set_string_take(
+          event, "frame",
+          fl_value_new_float32_list(entry.second.data(),
+                                    entry.second.size()));
+      fl_event_channel_send(self->spectrum_channel, event, nullptr, nullptr);
+    }
+  }
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Runs on the capture thread.
+static void on_spectrum_frame(KioskAudioPlugin* self, int id,
+                              const std::vector<float>& frame) {
+  {
+    std::lock_guard<std::mutex> lock(*self->spectrum_mutex);
+    (*self->spectrum_frames)[id] = frame;
+  }
+  if (!self->spectrum_event_pending->exchange(true)) {
+    g_idle_add(deliver_spectrum_frames, g_object_ref(self));
+  }
+}
+
+static gboolean deliver_wyoming_updates(gpointer user_data) {
+  KioskAudioPlugin* self = KIOSK_AUDIO_PLUGIN(user_data);
+  self->wyoming_event_pending->store(false);
+  std::vector<kiosk_audio::WyomingUpdate> updates;
+  {
+    std::lock_guard<std::mutex> lock(*self->wyoming_mutex);
+    updates.swap(*self->wyoming_updates);
+  }
+  if (self->wyoming_listening) {
+    for (const kiosk_audio::WyomingUpdate& update : updates) {
+      g_autoptr(FlValue) event = fl_value_new_map();
+      fl_value_set_string_take(
+          event, "type", fl_value_new_string(wyoming_update_type(update.kind)));
+      fl_value_set_string_take(
+          event, "state",
+          fl_value_new_string(kiosk_audio::WyomingStateName(update.state)));
+      if (!update.text.empty()) {
+        fl_value_set_string_take(event, "text",
+                                 fl_value_new_string(update.text.c_str()));
+      }
+      if (update.latency_ms > 0) {
+        fl_value_set_string_take(event, "latencyMs",
+                                 fl_value_new_float(update.latency_ms));
+      }
+      fl_event_channel_send(self->wyoming_channel, event, nullptr, nullptr);
+    }
+  }
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Runs on the Wyoming client and playback threads.
+static void on_wyoming_update(KioskAudioPlugin* self,
+                              const kiosk_audio::WyomingUpdate& update) {
+  {
+    std::lock_guard<std::mutex> lock(*self->wyoming_mutex);
+    self->wyoming_updates->push_back(update);
+  }
+  if (!self->wyoming_event_pending->exchange(true)) {
+    g_idle_add(deliver_wyoming_updates, g_object_ref(self));
+  }
+}
+
+static FlMethodErrorResponse* wyoming_listen_cb(FlEventChannel* channel,
+                                                FlValue* args,
+                                                gpointer user_data) {
+  KIOSK_AUDIO_PLUGIN(user_data)->wyoming_listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* wyoming_cancel_cb(FlEventChannel* channel,
+                                                FlValue* args,
+                                                gpointer user_data) {
+  KIOSK_AUDIO_PLUGIN(user_data)->wyoming_listening = FALSE;
+  return nullptr;
+}
+
+static gboolean deliver_tts_updates(gpointer user_data) {
+  KioskAudioPlugin* self = KIOSK_AUDIO_PLUGIN(user_data);
+  self->tts_event_pending->store(false);
+  std::vector<kiosk_audio::SpeechUpdate> updates;
+  {
+    std::lock_guard<std::mutex> lock(*self->tts_mutex);
+    updates.swap(*self->tts_updates);
+  }
+  if (self->tts_listening) {
+    for (const kiosk_audio::SpeechUpdate& update : updates) {
+      g_autoptr(FlValue) event = fl_value_new_map();
+      fl_value_set_string_take(
+          event, "type", fl_value_new_string(speech_update_type(update.kind)));
+      fl_value_set_string_take(event, "id", fl_value_new_int(update.id));
+      fl_value_set_string_take(event, "cached",
+                               fl_value_new_bool(update.cached));
+      fl_value_set_string_take(event, "latencyMs",
+                               fl_value_new_float(update.latency_ms));
+      fl_value_set_string_take(event, "interrupted",
+                               fl_value_new_bool(update.interrupted));
+      if (!update.error.empty()) {
+        fl_value_set_string_take(event, "error",
+                                 fl_value_new_string(update.error.c_str()));
+      }
+      fl_event_channel_send(self->tts_channel, event, nullptr, nullptr);
+    }
+  }
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Runs on the speech engine's playback thread.
+static void on_speech_update(KioskAudioPlugin* self,
+                             const kiosk_audio::SpeechUpdate& update) {
+  {
+    std::lock_guard<std::mutex> lock(*self->tts_mutex);
+    self->tts_updates->push_back(update);
+  }
+  if (!self->tts_event_pending->exchange(true)) {
+    g_idle_add(deliver_tts_updates, g_object_ref(self));
+  }
+}
+
+static FlMethodErrorResponse* tts_listen_cb(FlEventChannel* channel,
+                                            FlValue* args,
+                                            gpointer user_data) {
+  KIOSK_AUDIO_PLUGIN(user_data)->tts_listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* tts_cancel_cb(FlEventChannel* channel,
+                                            FlValue* args,
+                                            gpointer user_data) {
+  KIOSK_AUDIO_PLUGIN(user_data)->tts_listening = FALSE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* spectrum_listen_cb(FlEventChannel* channel,
+                                                 FlValue* args,
+                                                 gpointer user_data) {
+  KIOSK_AUDIO_PLUGIN(user_data)->spectrum_listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* spectrum_cancel_cb(FlEventChannel* channel,
+                                                 FlValue* args,
+                                                 gpointer user_data) {
+  KIOSK_AUDIO_PLUGIN(user_data)->spectrum_listening = FALSE;
+  return nullptr;
+}
+
+static void handle_create_spectrum(KioskAudioPlugin* self,
+                                   FlMethodCall* method_call, FlValue* args) {
+  std::string error;
+  const int id =
+      self->spectrum_hub->Add(spectrum_config_from_args(args), &error);
+  if (id == 0) {
+    fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                 nullptr, nullptr);
+    return;
+  }
+  kiosk_audio::SpectrumConfig config;
+  self->spectrum_hub->analyzer_config(id, &config);
+  g_autoptr(FlValue) value = spectrum_config_to_value(config);
+  fl_value_set_string_take(value, "id", fl_value_new_int(id));
+  fl_method_call_respond_success(method_call, value, nullptr);
+}
+
+static void handle_register_sound(KioskAudioPlugin* self,
+                                  FlMethodCall* method_call, FlValue* args) {
+  const std::string key = lookup_string(args, "key", "");
+  FlValue* bytes = lookup(args, "bytes", FL_VALUE_TYPE_UINT8_LIST);
+  if (key.empty() || bytes == nullptr) {
+    fl_method_call_respond_error(method_call, kErrorCode,
+                                 "registerSound needs a key and bytes",
+                                 nullptr, nullptr);
+    return;
+  }
+  const kiosk_audio::SoundMixerConfig& config = self->sound_mixer->config();
+  std::shared_ptr<kiosk_audio::PcmClip> clip(new kiosk_audio::PcmClip());
+  std::string error;
+  if (!kiosk_audio::DecodeWav(fl_value_get_uint8_list(bytes),
+                              fl_value_get_length(bytes), config.sample_rate,
+                              config.channels, clip.get(), &error) ||
+      !self->sound_mixer->Register(key, clip, &error)) {
+    fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                 nullptr, nullptr);
+    return;
+  }
+  g_autoptr(FlValue) value = fl_value_new_map();
+  fl_value_set_string_take(value, "frames",
+                           fl_value_new_int(static_cast<int64_t>(
+                               clip->frames())));
+  fl_value_set_string_take(
+      value, "durationMs",
+      fl_value_new_int(static_cast<int64_t>(clip->frames() * 1000 /
+                                            config.sample_rate)));
+  fl_value_set_string_take(value, "bytes",
+                           fl_value_new_int(static_cast<int64_t>(
+                               clip->samples.size() * sizeof(float))));
+  fl_method_call_respond_success(method_call, value, nullptr);
+}
+
+static void handle_play_sound(KioskAudioPlugin* self,
+                              FlMethodCall* method_call, FlValue* args) {
+  std::string error;
+  const int voice = self->sound_mixer->Play(
+      lookup_string(args, "key", ""),
+      static_cast<float>(lookup_double(args, "gain", 1.0)),
+      lookup_bool(args, "loop", false), &error);
+  if (voice == 0) {
+    fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                 nullptr, nullptr);
+    return;
+  }
+  g_autoptr(FlValue) value = fl_value_new_int(voice);
+  fl_method_call_respond_success(method_call, value, nullptr);
+}
+
+static void handle_start_wyoming(KioskAudioPlugin* self,
+                                 FlMethodCall* method_call, FlValue* args) {
+  // Joins the old client's threads before its replacement opens the
+  // microphone.
+  delete self->wyoming;
+  self->wyoming = nullptr;
+
+  std::unique_ptr<kiosk_audio::PcmSource> microphone;
+  std::unique_ptr<kiosk_audio::PcmSink> speaker;
+#ifdef KIOSK_AUDIO_HAVE_PULSE
+  kiosk_audio::PulseCaptureConfig capture;
+  capture.device = lookup_string(args, "device", "@DEFAULT_SOURCE@");
+  // What Wyoming speech-to-text servers expect; the server resamples.
+  capture.sample_rate = 16000;
+  capture.stream_name = "Assistant microphone";
+  microphone.reset(new kiosk_audio::PulseCapture(capture));
+  speaker.reset(new kiosk_audio::PulsePlayback("Assistant"));
+#endif
+  self->wyoming = new kiosk_audio::WyomingClient(
+      std::move(microphone), std::move(speaker),
+      [self](const kiosk_audio::WyomingUpdate& update) {
+        on_wyoming_update(self, update);
+      });
+  std::string error;
+  if (!self->wyoming->Start(wyoming_config_from_args(args), &error)) {
+    delete self->wyoming;
+    self->wyoming = nullptr;
+    fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                 nullptr, nullptr);
+    return;
+  }
+  fl_method_call_respond_success(method_call, nullptr, nullptr);
+}
+
+static void handle_configure_tts(KioskAudioPlugin* self,
+                                 FlMethodCall* method_call, FlValue* args) {
+  // Joins the old engine's threads; anything it had queued is dropped.
+  delete self->speech;
+  self->speech = nullptr;
+
+  std::string error;
+  std::unique_ptr<kiosk_audio::SpeechSynthesizer> synthesizer =
+      kiosk_audio::CreateSpeechSynthesizer(
+          lookup_string(args, "engine", "auto"),
+          lookup_string(args, "voice", ""),
+          static_cast<int>(lookup_int(args, "timeoutMs", 30000)), &error);
+  if (!synthesizer) {
+    fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                 nullptr, nullptr);
+    return;
+  }
+  std::unique_ptr<kiosk_audio::PcmSink> speaker;
+#ifdef KIOSK_AUDIO_HAVE_PULSE
+  speaker.reset(new kiosk_audio::PulsePlayback("Announcements"));
+#endif
+  self->speech = new kiosk_audio::SpeechEngine(
+      std::move(synthesizer), std::move(speaker),
+      speech_config_from_args(args),
+      [self](const kiosk_audio::SpeechUpdate& update) {
+        on_speech_update(self, update);
+      });
+  g_autoptr(FlValue) stats = speech_stats_to_value(self->speech->stats());
+  fl_method_call_respond_success(method_call, stats, nullptr);
+}
+
+static void handle_tts_method(KioskAudioPlugin* self, const gchar* method,
+                              FlMethodCall* method_call, FlValue* args) {
+  if (self->speech == nullptr) {
+    fl_method_call_respond_error(method_call, kErrorCode,
+                                 "Speech engine is not configured", nullptr,
+                                 nullptr);
+    return;
+  }
+  if (strcmp(method, "ttsSpeak") == 0) {
+    std::string error;
+    const int id = self->speech->Speak(
+        speech_request_from_args(args),
+        static_cast<float>(lookup_double(args, "volume", 1.0)), &error);
+    if (id == 0) {
+      fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                   nullptr, nullptr);
+      return;
+    }
+    g_autoptr(FlValue) value = fl_value_new_int(id);
+    fl_method_call_respond_success(method_call, value, nullptr);
+    return;
+  }
+  if (strcmp(method, "ttsPrefetch") == 0) {
+    self->speech->Prefetch(speech_request_from_args(args));
+  } else if (strcmp(method, "ttsStop") == 0) {
+    self->speech->Stop();
+  } else if (strcmp(method, "ttsSetPaused") == 0) {
+    self->speech->set_paused(lookup_bool(args, "paused", true));
+  } else if (strcmp(method, "ttsClearCache") == 0) {
+    self->speech->ClearCache();
+  } else {
+    g_autoptr(FlValue) stats = speech_stats_to_value(self->speech->stats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+    return;
+  }
+  fl_method_call_respond_success(method_call, nullptr, nullptr);
+}
+
+static void kiosk_audio_plugin_handle_method_call(KioskAudioPlugin* self,
+                                                  FlMethodCall* method_call) {
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  if (strcmp(method, "createSpectrum") == 0) {
+    handle_create_spectrum(self, method_call, args);
+  } else if (strcmp(method, "setSpectrumActive") == 0) {
+    self->spectrum_hub->SetActive(static_cast<int>(lookup_int(args, "id", 0)),
+                                  lookup_bool(args, "active", true));
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "disposeSpectrum") == 0) {
+    const int id = static_cast<int>(lookup_int(args, "id", 0));
+    self->spectrum_hub->Remove(id);
+    {
+      std::lock_guard<std::mutex> lock(*self->spectrum_mutex);
+      self->spectrum_frames->erase(id);
+    }
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "getSpectrumInfo") == 0) {
+    g_autoptr(FlValue) stats =
+        spectrum_stats_to_value(self->spectrum_hub->stats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+  } else if (strcmp(method, "registerSound") == 0) {
+    handle_register_sound(self, method_call, args);
+  } else if (strcmp(method, "unregisterSound") == 0) {
+    self->sound_mixer->Unregister(lookup_string(args, "key", ""));
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "playSound") == 0) {
+    handle_play_sound(self, method_call, args);
+  } else if (strcmp(method, "stopSound") == 0) {
+    const bool stopped = self->sound_mixer->Stop(
+        static_cast<int>(lookup_int(args, "voiceId", 0)));
+    g_autoptr(FlValue) value = fl_value_new_bool(stopped);
+    fl_method_call_respond_success(method_call, value, nullptr);
+  } else if (strcmp(method, "setSoundGain") == 0) {
+    const bool updated = self->sound_mixer->SetGain(
+        static_cast<int>(lookup_int(args, "voiceId", 0)),
+        static_cast<float>(lookup_double(args, "gain", 1.0)));
+    g_autoptr(FlValue) value = fl_value_new_bool(updated);
+    fl_method_call_respond_success(method_call, value, nullptr);
+  } else if (strcmp(method, "stopAllSounds") == 0) {
+    self->sound_mixer->StopAll();
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "setSoundMasterGain") == 0) {
+    self->sound_mixer->set_master_gain(
+        static_cast<float>(lookup_double(args, "gain", 1.0)));
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "startWyoming") == 0) {
+    handle_start_wyoming(self, method_call, args);
+  } else if (strcmp(method, "stopWyoming") == 0) {
+    delete self->wyoming;
+    self->wyoming = nullptr;
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "getWyomingInfo") == 0) {
+    g_autoptr(FlValue) stats =
+        self->wyoming != nullptr
+            ? wyoming_stats_to_value(self->wyoming->stats())
+            : wyoming_stats_to_value(kiosk_audio::WyomingStats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+  } else if (strcmp(method, "configureTts") == 0) {
+    handle_configure_tts(self, method_call, args);
+  } else if (strcmp(method, "ttsSpeak") == 0 ||
+             strcmp(method, "ttsPrefetch") == 0 ||
+             strcmp(method, "ttsStop") == 0 ||
+             strcmp(method, "ttsSetPaused") == 0 ||
+             strcmp(method, "ttsClearCache") == 0 ||
+             strcmp(method, "getTtsInfo") == 0) {
+    handle_tts_method(self, method, method_call, args);
+  } else if (strcmp(method, "trimMemory") == 0) {
+    // Registered sounds stay: the app owns them and would have to decode
+    // them again to play.
+    const int64_t phrase_bytes =
+        self->speech != nullptr
+            ? static_cast<int64_t>(self->speech->ReleaseMemory())
+            : 0;
+    g_autoptr(FlValue) result = fl_value_new_map();
+    fl_value_set_string_take(result, "phraseCacheBytes",
+                             fl_value_new_int(phrase_bytes));
+    fl_method_call_respond_success(method_call, result, nullptr);
+  } else if (strcmp(method, "getMixerInfo") == 0) {
+    g_autoptr(FlValue) stats =
+        mixer_stats_to_value(self->sound_mixer->stats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+  } else {
+    fl_method_call_respond_not_implemented(method_call, nullptr);
+  }
+}
+
+static void kiosk_audio_plugin_dispose(GObject* object) {
+  KioskAudioPlugin* self = KIOSK_AUDIO_PLUGIN(object);
+  // Joins the capture thread, the only producer of spectrum frames.
+  delete self->spectrum_hub;
+  self->spectrum_hub = nullptr;
+  delete self->spectrum_frames;
+  self->spectrum_frames = nullptr;
+  delete self->spectrum_mutex;
+  self->spectrum_mutex = nullptr;
+  delete self->spectrum_event_pending;
+  self->spectrum_event_pending = nullptr;
+  delete self->sound_mixer;
+  self->sound_mixer = nullptr;
+  // Joins the client and playback threads, the producers of updates.
+  delete self->wyoming;
+  self->wyoming = nullptr;
+  delete self->wyoming_updates;
+  self->wyoming_updates = nullptr;
+  delete self->wyoming_mutex;
+  self->wyoming_mutex = nullptr;
+  delete self->wyoming_event_pending;
+  self->wyoming_event_pending = nullptr;
+  // Joins the playback thread, the producer of speech updates.
+  delete self->speech;
+  self->speech = nullptr;
+  delete self->tts_updates;
+  self->tts_updates = nullptr;
+  delete self->tts_mutex;
+  self->tts_mutex = nullptr;
+  delete self->tts_event_pending;
+  self->tts_event_pending = nullptr;
+  g_clear_object(&self->tts_channel);
+  g_clear_object(&self->wyoming_channel);
+  g_clear_object(&self->spectrum_channel);
+  G_OBJECT_CLASS(kiosk_audio_plugin_parent_class)->dispose(object);
+}
+
+static void kiosk_audio_plugin_class_init(KioskAudioPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = kiosk_audio_plugin_dispose;
+}
+
+static void kiosk_audio_plugin_init(KioskAudioPlugin* self) {
+  self->spectrum_mutex = new std::mutex();
+  self->spectrum_frames = new std::map<int, std::vector<float>>();
+  self->spectrum_event_pending = new std::atomic<bool>(false);
+  self->wyoming_mutex = new std::mutex();
+  self->wyoming_updates = new std::vector<kiosk_audio::WyomingUpdate>();
+  self->wyoming_event_pending = new std::atomic<bool>(false);
+  self->tts_mutex = new std::mutex();
+  self->tts_updates = new std::vector<kiosk_audio::SpeechUpdate>();
+  self->tts_event_pending = new std::atomic<bool>(false);
+  std::unique_ptr<kiosk_audio::PcmSource> monitor;
+  std::unique_ptr<kiosk_audio::PcmSink> output;
+#ifdef KIOSK_AUDIO_HAVE_PULSE
+  kiosk_audio::PulseCaptureConfig config;
+  config.stream_name = "Visualizer";
+  monitor.reset(new kiosk_audio::PulseCapture(config));
+  output.reset(new kiosk_audio::PulsePlayback("Sound effects"));
+#endif
+  self->sound_mixer = new kiosk_audio::SoundMixer(std::move(output));
+  self->spectrum_hub = new kiosk_audio::SpectrumHub(
+      std::move(monitor),
+      [self](int id, const std::vector<float>& frame) {
+        on_spectrum_frame(self, id, frame);
+      });
+}
+
+static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
+                           gpointer user_data) {
+  KioskAudioPlugin* plugin = KIOSK_AUDIO_PLUGIN(user_data);
+  kiosk_audio_plugin_handle_method_call(plugin, method_call);
+}
+
+void kiosk_audio_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  KioskAudioPlugin* plugin = KIOSK_AUDIO_PLUGIN(
+      g_object_new(kiosk_audio_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  plugin->spectrum_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           kSpectrumChannelName, FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->spectrum_channel,
+                                       spectrum_listen_cb, spectrum_cancel_cb,
+                                       plugin, nullptr);
+
+  plugin->wyoming_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           kWyomingChannelName, FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->wyoming_channel,
+                                       wyoming_listen_cb, wyoming_cancel_cb,
+                                       plugin, nullptr);
+
+  plugin->tts_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           kTtsChannelName, FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->tts_channel, tts_listen_cb,
+                                       tts_cancel_cb, plugin, nullptr);
+
+  g_object_unref(plugin);
+}
@@ -0,0 +1,30 @@
+#ifndef PLUGINS_KIOSK_AUDIO_PCM_SINK_H_
+#define PLUGINS_KIOSK_AUDIO_PCM_SINK_H_
+
+#include <cstddef>
+#include <string>
+
+namespace kiosk_audio {
+
+// An output stream of interleaved float samples in -1..1. Write() blocks
+// while the device buffer is full, which paces the caller.
+class PcmSink {
+ public:
+  virtual ~PcmSink() = default;
+
+  // |block_frames| is the size of each Write() and sets the latency the
+  // device buffer is sized for.
+  virtual bool Open(int sample_rate, int channels, int block_frames,
+                    std::string* error) = 0;
+  virtual void Close() = 0;
+  virtual bool is_open() const = 0;
+
+  virtual bool Write(const float* samples, size_t frames,
+                     std::string* error) = 0;
+  // Time until a sample written now is heard; 0 when unknown.
+  virtual int latency_us() = 0;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_PCM_SINK_H_
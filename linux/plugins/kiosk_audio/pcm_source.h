@@ -0,0 +1,31 @@
+#ifndef PLUGINS_KIOSK_AUDIO_PCM_SOURCE_H_
+#define PLUGINS_KIOSK_AUDIO_PCM_SOURCE_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace kiosk_audio {
+
+// A stream of mono float samples in -1..1, delivered in small blocks on the
+// source's own thread.
+class PcmSource {
+ public:
+  using SampleCallback =
+      std::function<void(const float* samples, size_t count)>;
+
+  virtual ~PcmSource() = default;
+
+  // |callback| runs on the source thread until Stop() returns.
+  virtual bool Start(SampleCallback callback, std::string* error) = 0;
+  virtual void Stop() = 0;
+
+  virtual bool is_running() const = 0;
+  virtual int sample_rate() const = 0;
+  // Why the source last failed or reconnected; empty when healthy.
+  virtual std::string last_error() const = 0;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_PCM_SOURCE_H_
@@ -0,0 +1,337 @@
+#include "phrase_cache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace kiosk_audio {
+
+namespace {
+
+const char kExtension[] = ".wav";
+
+void PutU16(std::vector<uint8_t>* out, uint16_t value) {
+  out->push_back(static_cast<uint8_t>(value));
+  out->push_back(static_cast<uint8_t>(value >> 8));
+}
+
+void PutU32(std::vector<uint8_t>* out, uint32_t value) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    out->push_back(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+// 16-bit PCM halves the disk footprint of float and is what the engines
+// produce anyway.
+std::vector<uint8_t> EncodeWav16(const PcmClip& clip) {
+  const uint32_t data_bytes =
+      static_cast<uint32_t>(clip.samples.size() * sizeof(int16_t));
+  std::vector<uint8_t> out;
+  out.reserve(44 + data_bytes);
+  out.insert(out.end(), {'R', 'I', 'F', 'F'});
+  PutU32(&out, 36 + data_bytes);
+  out.insert(out.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+  PutU32(&out, 16);
+  PutU16(&out, 1);
+  PutU16(&out, static_cast<uint16_t>(clip.channels));
+  PutU32(&out, static_cast<uint32_t>(clip.sample_rate));
+  PutU32(&out, static_cast<uint32_t>(clip.sample_rate * clip.channels * 2));
+  PutU16(&out, static_cast<uint16_t>(clip.channels * 2));
+  PutU16(&out, 16);
+  out.insert(out.end(), {'d', 'a', 't', 'a'});
+  PutU32(&out, data_bytes);
+  for (float sample : clip.samples) {
+    const float clamped = std::min(std::max(sample, -1.0f), 1.0f);
+    PutU16(&out, static_cast<uint16_t>(
+                     static_cast<int16_t>(std::lround(clamped * 32767))));
+  }
+  return out;
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* data) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  uint8_t buffer[65536];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    data->insert(data->end(), buffer, buffer + count);
+  }
+  const bool ok = ferror(file) == 0;
+  fclose(file);
+  return ok;
+}
+
+bool WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+  // Written aside and renamed, so a crash never leaves a truncated phrase
+  // behind under its real name.
+  const std::string temporary = path + ".tmp";
+  FILE* file = fopen(temporary.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  const bool written =
+      fwrite(data.data(), 1, data.size(), file) == data.size();
+  if (fclose(file) != 0 || !written ||
+      rename(temporary.c_str(), path.c_str()) != 0) {
+    unlink(temporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+void MakeDirectories(const std::string& path) {
+  for (size_t slash = path.find('/', 1); slash != std::string::npos;
+       slash = path.find('/', slash + 1)) {
+    mkdir(path.substr(0, slash).c_str(), 0755);
+  }
+  mkdir(path.c_str(), 0755);
+}
+
+bool EndsWith(const char* value, const char* suffix) {
+  const size_t length = strlen(value);
+  const size_t suffix_length = strlen(suffix);
+  return length >= suffix_length &&
+         strcmp(value + length - suffix_length, suffix) == 0;
+}
+
+size_t ClipBytes(const PcmClip& clip) {
+  return clip.samples.size() * sizeof(float);
+}
+
+}  // namespace
+
+PhraseCache::PhraseCache(const PhraseCacheConfig& config, int sample_rate,
+                         int channels)
+    : config_(config), sample_rate_(sample_rate), channels_(channels) {
+  if (!config_.directory.empty()) {
+    MakeDirectories(config_.directory);
+    ScanDisk();
+  }
+}
+
+std::string PhraseCache::Key(const std::string& engine,
+                             const SpeechRequest& request) {
+  // Rate and pitch in hundredths, so float noise from the Dart side does
+  // not miss the cache.
+  const std::string material =
+      engine + '\x1f' + request.voice + '\x1f' + request.language + '\x1f' +
+      std::to_string(std::lround(request.rate * 100)) + '\x1f' +
+      std::to_string(std::lround(request.pitch * 100)) + '\x1f' +
+      request.text;
+  // FNV-1a; 64 bits make a collision among a kiosk's phrases negligible.
+  uint64_t hash = 14695981039346656037ull;
+  for (char c : material) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ull;
+  }
+  char key[17];
+  snprintf(key, sizeof(key), "%016llx",
+           static_cast<unsigned long long>(hash));
+  return key;
+}
+
+std::shared_ptr<const PcmClip> PhraseCache::FindInMemory(
+    const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  order_.splice(order_.begin(), order_, it->second.position);
+  memory_hits_++;
+  return it->second.clip;
+}
+
+std::shared_ptr<const PcmClip> PhraseCache::Find(const std::string& key) {
+  std::shared_ptr<const PcmClip> clip = FindInMemory(key);
+  if (clip || config_.directory.empty()) {
+    if (!clip) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      misses_++;
+    }
+    return clip;
+  }
+
+  const std::string path = PathFor(key);
+  std::vector<uint8_t> data;
+  std::shared_ptr<PcmClip> loaded(new PcmClip());
+  std::string error;
+  if (!ReadFile(path, &data)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    misses_++;
+    return nullptr;
+  }
+  if (!DecodeWav(data.data(), data.size(), sample_rate_, channels_,
+                 loaded.get(), &error)) {
+    unlink(path.c_str());
+    std::lock_guard<std::mutex> lock(mutex_);
+    disk_entries_ = std::max(disk_entries_ - 1, 0);
+    disk_bytes_ -= std::min(disk_bytes_, data.size());
+    misses_++;
+    return nullptr;
+  }
+  // The modification time doubles as the last use for pruning.
+  utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+  std::lock_guard<std::mutex> lock(mutex_);
+  disk_hits_++;
+  Insert(key, loaded);
+  return loaded;
+}
+
+void PhraseCache::Store(const std::string& key,
+                        std::shared_ptr<const PcmClip> clip) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Insert(key, clip);
+  }
+  if (config_.directory.empty()) {
+    return;
+  }
+  const std::vector<uint8_t> data = EncodeWav16(*clip);
+  if (!WriteFile(PathFor(key), data)) {
+    return;
+  }
+  bool over_budget;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    disk_entries_++;
+    disk_bytes_ += data.size();
+    over_budget = disk_bytes_ > config_.disk_bytes;
+  }
+  if (over_budget) {
+    ScanDisk();
+  }
+}
+
+void PhraseCache::Clear() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    order_.clear();
+    memory_bytes_ = 0;
+  }
+  if (config_.directory.empty()) {
+    return;
+  }
+  DIR* directory = opendir(config_.directory.c_str());
+  if (directory != nullptr) {
+    while (struct dirent* entry = readdir(directory)) {
+      if (EndsWith(entry->d_name, kExtension)) {
+        unlink((config_.directory + "/" + entry->d_name).c_str());
+      }
+    }
+    closedir(directory);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  disk_entries_ = 0;
+  disk_bytes_ = 0;
+}
+
+size_t PhraseCache::ReleaseMemory() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const size_t released = memory_bytes_;
+  entries_.clear();
+  order_.clear();
+  memory_bytes_ = 0;
+  return released;
+}
+
+PhraseCacheStats PhraseCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  PhraseCacheStats stats;
+  stats.entries = static_cast<int>(entries_.size());
+  stats.memory_bytes = memory_bytes_;
+  stats.disk_entries = disk_entries_;
+  stats.disk_bytes = disk_bytes_;
+  stats.memory_hits = memory_hits_;
+  stats.disk_hits = disk_hits_;
+  stats.misses = misses_;
+  return stats;
+}
+
+std::string PhraseCache::PathFor(const std::string& key) const {
+  return config_.directory + "/" + key + kExtension;
+}
+
+void PhraseCache::Insert(const std::string& key,
+                         std::shared_ptr<const PcmClip> clip) {
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    memory_bytes_ -= ClipBytes(*it->second.clip);
+    order_.erase(it->second.position);
+    entries_.erase(it);
+  }
+  order_.push_front(key);
+  memory_bytes_ += ClipBytes(*clip);
+  entries_[key] = Entry{std::move(clip), order_.begin()};
+  // The newest phrase stays even when it alone exceeds the budget; it is
+  // about to be played.
+  while (memory_bytes_ > config_.memory_bytes && order_.size() > 1) {
+    auto victim = entries_.find(order_.back());
+    memory_bytes_ -= ClipBytes(*victim->second.clip);
+    entries_.erase(victim);
+    order_.pop_back();
+  }
+}
+
+void PhraseCache::ScanDisk() {
+  struct File {
+    time_t modified;
+    std::string path;
+    size_t size;
+  };
+  std::vector<File> files;
+  size_t total = 0;
+  DIR* directory = opendir(config_.directory.c_str());
+  if (directory == nullptr) {
+    return;
+  }
+  while (struct dirent* entry = readdir(directory)) {
+    if (!EndsWith(entry->d_name, kExtension)) {
+      continue;
+    }
+    File file;
+    file.path = config_.directory + "/" + entry->d_name;
+    struct stat info;
+    if (stat(file.path.c_str(), &info) != 0) {
+      continue;
+    }
+    file.modified = info.st_mtime;
+    file.size = static_cast<size_t>(info.st_size);
+    total += file.size;
+    files.push_back(std::move(file));
+  }
+  closedir(directory);
+
+  size_t remaining = files.size();
+  if (total > config_.disk_bytes) {
+    // Down to 90% so the next few phrases do not trigger another scan.
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) {
+      return a.modified < b.modified;
+    });
+    const size_t target = config_.disk_bytes / 10 * 9;
+    for (const File& file : files) {
+      if (total <= target) {
+        break;
+      }
+      if (unlink(file.path.c_str()) == 0) {
+        total -= file.size;
+        remaining--;
+      }
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  disk_entries_ = static_cast<int>(remaining);
+  disk_bytes_ = total;
+}
+
+}  // namespace kiosk_audio
@@ -0,0 +1,95 @@
+#ifndef PLUGINS_KIOSK_AUDIO_PHRASE_CACHE_H_
+#define PLUGINS_KIOSK_AUDIO_PHRASE_CACHE_H_
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "speech_synthesizer.h"
+#include "wav_decoder.h"
+
+namespace kiosk_audio {
+
+struct PhraseCacheConfig {
+  // Where synthesized phrases are kept across restarts; empty keeps them
+  // in memory only.
+  std::string directory;
+  // Decoded float samples; about six minutes of speech at 22.05 kHz.
+  size_t memory_bytes = 32 << 20;
+  // 16-bit WAV files. The least recently used are deleted beyond this.
+  size_t disk_bytes = 64 << 20;
+};
+
+struct PhraseCacheStats {
+  int entries = 0;
+  size_t memory_bytes = 0;
+  int disk_entries = 0;
+  size_t disk_bytes = 0;
+  uint64_t memory_hits = 0;
+  uint64_t disk_hits = 0;
+  uint64_t misses = 0;
+};
+
+// Synthesized speech keyed by everything that changes the audio: engine,
+// voice, language, rate, pitch and text. Volume is applied at playback,
+// so it does not split the cache.
+class PhraseCache {
+ public:
+  // Clips are stored and returned at |sample_rate| and |channels|.
+  PhraseCache(const PhraseCacheConfig& config, int sample_rate,
+              int channels);
+
+  // Disallow copy and assign.
+  PhraseCache(const PhraseCache&) = delete;
+  PhraseCache& operator=(const PhraseCache&) = delete;
+
+  static std::string Key(const std::string& engine,
+                         const SpeechRequest& request);
+
+  // Memory only; never touches the disk.
+  std::shared_ptr<const PcmClip> FindInMemory(const std::string& key);
+  // Memory, then disk; a disk hit is promoted to memory.
+  std::shared_ptr<const PcmClip> Find(const std::string& key);
+  void Store(const std::string& key, std::shared_ptr<const PcmClip> clip);
+  // Forgets memory and disk entries.
+  void Clear();
+  // Forgets memory entries only; they are found on disk again. Returns the
+  // bytes released.
+  size_t ReleaseMemory();
+
+  PhraseCacheStats stats() const;
+
+ private:
+  struct Entry {
+    std::shared_ptr<const PcmClip> clip;
+    std::list<std::string>::iterator position;
+  };
+
+  std::string PathFor(const std::string& key) const;
+  // Called with |mutex_| held.
+  void Insert(const std::string& key, std::shared_ptr<const PcmClip> clip);
+  // Recounts the directory, deleting the oldest files when over budget.
+  void ScanDisk();
+
+  const PhraseCacheConfig config_;
+  const int sample_rate_;
+  const int channels_;
+
+  mutable std::mutex mutex_;
+  // Most recently used first.
+  std::list<std::string> order_;
+  std::unordered_map<std::string, Entry> entries_;
+  size_t memory_bytes_ = 0;
+  int disk_entries_ = 0;
+  size_t disk_bytes_ = 0;
+  uint64_t memory_hits_ = 0;
+  uint64_t disk_hits_ = 0;
+  uint64_t misses_ = 0;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_PHRASE_CACHE_H_
@@ -0,0 +1,109 @@
+#include "pulse_capture.h"
+
+#include <pulse/error.h>
+#include <pulse/simple.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace kiosk_audio {
+
+namespace {
+
+const int kReconnectMinMs = 500;
+const int kReconnectMaxMs = 10000;
+
+}  // namespace
+
+PulseCapture::PulseCapture(const PulseCaptureConfig& config)
+    : config_(config) {}
+
+PulseCapture::~PulseCapture() {
+  Stop();
+}
+
+bool PulseCapture::Start(SampleCallback callback, std::string* error) {
+  Stop();
+  if (config_.sample_rate <= 0 || config_.block_ms <= 0) {
+    *error = "Invalid capture format";
+    return false;
+  }
+  SetError(std::string());
+  running_ = true;
+  thread_ = std::thread(&PulseCapture::CaptureLoop, this, std::move(callback));
+  return true;
+}
+
+void PulseCapture::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    running_ = false;
+  }
+  wait_.notify_all();
+  // A read returns within one block: monitors and microphones deliver
+  // silence too.
+  thread_.join();
+}
+
+std::string PulseCapture::last_error() const {
+  std::lock_guard<std::mutex> lock(error_mutex_);
+  return last_error_;
+}
+
+void PulseCapture::SetError(const std::string& error) {
+  std::lock_guard<std::mutex> lock(error_mutex_);
+  last_error_ = error;
+}
+
+void PulseCapture::CaptureLoop(SampleCallback callback) {
+  pa_sample_spec spec;
+  spec.format = PA_SAMPLE_FLOAT32NE;
+  spec.rate = static_cast<uint32_t>(config_.sample_rate);
+  spec.channels = 1;
+  const size_t block =
+      static_cast<size_t>(config_.sample_rate) * config_.block_ms / 1000;
+  // Ask the server for block-sized fragments rather than its default of
+  // up to two seconds, which would make the bars lag the sound.
+  pa_buffer_attr attr;
+  attr.maxlength = static_cast<uint32_t>(-1);
+  attr.tlength = static_cast<uint32_t>(-1);
+  attr.prebuf = static_cast<uint32_t>(-1);
+  attr.minreq = static_cast<uint32_t>(-1);
+  attr.fragsize = static_cast<uint32_t>(block * sizeof(float));
+  std::vector<float> samples(block);
+
+  int delay_ms = kReconnectMinMs;
+  while (running_.load()) {
+    int code = 0;
+    pa_simple* stream = pa_simple_new(
+        nullptr, "King Kiosk", PA_STREAM_RECORD, config_.device.c_str(),
+        config_.stream_name.c_str(), &spec, nullptr, &attr, &code);
+    if (stream != nullptr) {
+      SetError(std::string());
+      delay_ms = kReconnectMinMs;
+      while (running_.load()) {
+        if (pa_simple_read(stream, samples.data(),
+                           samples.size() * sizeof(float), &code) < 0) {
+          break;
+        }
+        callback(samples.data(), samples.size());
+      }
+      pa_simple_free(stream);
+      if (!running_.load()) {
+        break;
+      }
+    }
+    SetError(std::string("PulseAudio: ") + pa_strerror(code));
+
+    std::unique_lock<std::mutex> lock(wait_mutex_);
+    wait_.wait_for(lock, std::chrono::milliseconds(delay_ms),
+                   [this]() { return !running_.load(); });
+    delay_ms = std::min(delay_ms * 2, kReconnectMaxMs);
+  }
+}
+
+}  // namespace kiosk_audio
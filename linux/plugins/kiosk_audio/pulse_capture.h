@@ -0,0 +1,62 @@
+#ifndef PLUGINS_KIOSK_AUDIO_PULSE_CAPTURE_H_
+#define PLUGINS_KIOSK_AUDIO_PULSE_CAPTURE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "pcm_source.h"
+
+namespace kiosk_audio {
+
+struct PulseCaptureConfig {
+  // Source name; "@DEFAULT_MONITOR@" taps whatever the default output is
+  // playing, "@DEFAULT_SOURCE@" is the default microphone.
+  std::string device = "@DEFAULT_MONITOR@";
+  int sample_rate = 48000;
+  // Samples per callback; small enough for display-rate analysis.
+  int block_ms = 10;
+  // Stream name shown in pavucontrol and pw-top.
+  std::string stream_name = "Capture";
+};
+
+// Records mono float PCM through the PulseAudio simple API, which PipeWire
+// also serves through pipewire-pulse. The server does the channel mixdown
+// and resampling. If the server goes away the capture thread reconnects
+// with a growing delay until stopped.
+class PulseCapture : public PcmSource {
+ public:
+  explicit PulseCapture(const PulseCaptureConfig& config);
+  ~PulseCapture() override;
+
+  // Disallow copy and assign.
+  PulseCapture(const PulseCapture&) = delete;
+  PulseCapture& operator=(const PulseCapture&) = delete;
+
+  bool Start(SampleCallback callback, std::string* error) override;
+  void Stop() override;
+
+  bool is_running() const override { return running_.load(); }
+  int sample_rate() const override { return config_.sample_rate; }
+  std::string last_error() const override;
+
+ private:
+  void CaptureLoop(SampleCallback callback);
+  void SetError(const std::string& error);
+
+  PulseCaptureConfig config_;
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  // Wakes the capture thread out of a reconnect delay.
+  std::mutex wait_mutex_;
+  std::condition_variable wait_;
+
+  mutable std::mutex error_mutex_;
+  std::string last_error_;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_PULSE_CAPTURE_H_
@@ -0,0 +1,85 @@
+#include "pulse_playback.h"
+
+#include <pulse/error.h>
+#include <pulse/simple.h>
+
+namespace kiosk_audio {
+
+namespace {
+
+// Server-side buffer, in blocks. Two would underrun on a busy machine;
+// more only adds latency.
+const int kBufferedBlocks = 3;
+
+}  // namespace
+
+PulsePlayback::PulsePlayback(const std::string& stream_name)
+    : stream_name_(stream_name) {}
+
+PulsePlayback::~PulsePlayback() {
+  Close();
+}
+
+bool PulsePlayback::Open(int sample_rate, int channels, int block_frames,
+                         std::string* error) {
+  Close();
+  pa_sample_spec spec;
+  spec.format = PA_SAMPLE_FLOAT32NE;
+  spec.rate = static_cast<uint32_t>(sample_rate);
+  spec.channels = static_cast<uint8_t>(channels);
+  const uint32_t block_bytes =
+      static_cast<uint32_t>(block_frames * channels * sizeof(float));
+  // The server defaults to a two second buffer; ask for a few blocks and
+  // start playing as soon as the first one arrives.
+  pa_buffer_attr attr;
+  attr.maxlength = static_cast<uint32_t>(-1);
+  attr.tlength = block_bytes * kBufferedBlocks;
+  attr.prebuf = block_bytes;
+  attr.minreq = block_bytes;
+  attr.fragsize = static_cast<uint32_t>(-1);
+
+  int code = 0;
+  stream_ = pa_simple_new(nullptr, "King Kiosk", PA_STREAM_PLAYBACK, nullptr,
+                          stream_name_.c_str(), &spec, nullptr, &attr, &code);
+  if (stream_ == nullptr) {
+    *error = std::string("PulseAudio: ") + pa_strerror(code);
+    return false;
+  }
+  channels_ = channels;
+  return true;
+}
+
+void PulsePlayback::Close() {
+  if (stream_ == nullptr) {
+    return;
+  }
+  int code = 0;
+  pa_simple_drain(stream_, &code);
+  pa_simple_free(stream_);
+  stream_ = nullptr;
+}
+
+bool PulsePlayback::Write(const float* samples, size_t frames,
+                          std::string* error) {
+  int code = 0;
+  if (stream_ == nullptr ||
+      pa_simple_write(stream_, samples, frames * channels_ * sizeof(float),
+                      &code) < 0) {
+    *error = std::string("PulseAudio: ") +
+             (stream_ == nullptr ? "stream closed" : pa_strerror(code));
+    return false;
+  }
+  return true;
+}
+
+int PulsePlayback::latency_us() {
+  if (stream_ == nullptr) {
+    return 0;
+  }
+  int code = 0;
+  const pa_usec_t latency = pa_simple_get_latency(stream_, &code);
+  return latency == static_cast<pa_usec_t>(-1) ? 0
+                                               : static_cast<int>(latency);
+}
+
+}  // namespace kiosk_audio
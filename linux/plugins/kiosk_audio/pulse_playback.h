@@ -0,0 +1,42 @@
+#ifndef PLUGINS_KIOSK_AUDIO_PULSE_PLAYBACK_H_
+#define PLUGINS_KIOSK_AUDIO_PULSE_PLAYBACK_H_
+
+#include <string>
+
+#include "pcm_sink.h"
+
+struct pa_simple;
+
+namespace kiosk_audio {
+
+// Float playback through the PulseAudio simple API (or pipewire-pulse),
+// with the server buffer kept to a few blocks so a sound starts within
+// about 20 ms of being written.
+class PulsePlayback : public PcmSink {
+ public:
+  // |stream_name| is shown in pavucontrol and pw-top.
+  explicit PulsePlayback(const std::string& stream_name);
+  ~PulsePlayback() override;
+
+  // Disallow copy and assign.
+  PulsePlayback(const PulsePlayback&) = delete;
+  PulsePlayback& operator=(const PulsePlayback&) = delete;
+
+  bool Open(int sample_rate, int channels, int block_frames,
+            std::string* error) override;
+  void Close() override;
+  bool is_open() const override { return stream_ != nullptr; }
+
+  bool Write(const float* samples, size_t frames,
+             std::string* error) override;
+  int latency_us() override;
+
+ private:
+  std::string stream_name_;
+  pa_simple* stream_ = nullptr;
+  int channels_ = 0;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_PULSE_PLAYBACK_H_
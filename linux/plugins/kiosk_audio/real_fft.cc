@@ -0,0 +1,97 @@
+#include "real_fft.h"
+
+#include <cmath>
+
+namespace kiosk_audio {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+}  // namespace
+
+RealFft::RealFft(int size)
+    : size_(size),
+      half_(size / 2),
+      bit_reverse_(size / 2),
+      twiddle_re_(size / 2),
+      twiddle_im_(size / 2),
+      split_re_(size / 2 + 1),
+      split_im_(size / 2 + 1),
+      work_re_(size / 2),
+      work_im_(size / 2) {
+  int bits = 0;
+  while ((1 << bits) < half_) {
+    bits++;
+  }
+  for (int i = 0; i < half_; ++i) {
+    int reversed = 0;
+    for (int bit = 0; bit < bits; ++bit) {
+      reversed |= ((i >> bit) & 1) << (bits - 1 - bit);
+    }
+    bit_reverse_[i] = reversed;
+  }
+  for (int h = 1; h < half_; h <<= 1) {
+    for (int j = 0; j < h; ++j) {
+      const double angle = -kPi * j / h;
+      twiddle_re_[h - 1 + j] = static_cast<float>(std::cos(angle));
+      twiddle_im_[h - 1 + j] = static_cast<float>(std::sin(angle));
+    }
+  }
+  for (int k = 0; k <= half_; ++k) {
+    const double angle = -2 * kPi * k / size_;
+    split_re_[k] = static_cast<float>(std::cos(angle));
+    split_im_[k] = static_cast<float>(std::sin(angle));
+  }
+}
+
+void RealFft::Forward(const float* input, float* re, float* im) {
+  // Even samples as the real part, odd as the imaginary part.
+  float* wr = work_re_.data();
+  float* wi = work_im_.data();
+  for (int i = 0; i < half_; ++i) {
+    const int source = bit_reverse_[i];
+    wr[i] = input[2 * source];
+    wi[i] = input[2 * source + 1];
+  }
+
+  for (int h = 1; h < half_; h <<= 1) {
+    const float* tr = twiddle_re_.data() + h - 1;
+    const float* ti = twiddle_im_.data() + h - 1;
+    for (int start = 0; start < half_; start += 2 * h) {
+      float* ar = wr + start;
+      float* ai = wi + start;
+      float* br = ar + h;
+      float* bi = ai + h;
+      for (int j = 0; j < h; ++j) {
+        const float xr = br[j] * tr[j] - bi[j] * ti[j];
+        const float xi = br[j] * ti[j] + bi[j] * tr[j];
+        br[j] = ar[j] - xr;
+        bi[j] = ai[j] - xi;
+        ar[j] += xr;
+        ai[j] += xi;
+      }
+    }
+  }
+
+  // X[k] = E[k] + W^k O[k], where E and O are the spectra of the even and
+  // odd samples recovered from Z[k] and conj(Z[N/2 - k]).
+  for (int k = 0; k <= half_; ++k) {
+    const int a = k == half_ ? 0 : k;
+    const int b = k == 0 ? 0 : half_ - k;
+    const float a_re = wr[a];
+    const float a_im = wi[a];
+    const float b_re = wr[b];
+    const float b_im = -wi[b];
+    const float even_re = 0.5f * (a_re + b_re);
+    const float even_im = 0.5f * (a_im + b_im);
+    const float odd_re = 0.5f * (a_im - b_im);
+    const float odd_im = -0.5f * (a_re - b_re);
+    const float c = split_re_[k];
+    const float s = split_im_[k];
+    re[k] = even_re + c * odd_re - s * odd_im;
+    im[k] = even_im + c * odd_im + s * odd_re;
+  }
+}
+
+}  // namespace kiosk_audio
@@ -0,0 +1,41 @@
+#ifndef PLUGINS_KIOSK_AUDIO_REAL_FFT_H_
+#define PLUGINS_KIOSK_AUDIO_REAL_FFT_H_
+
+#include <vector>
+
+namespace kiosk_audio {
+
+// Forward FFT of a real signal of power-of-two size N, computed as an N/2
+// point complex FFT plus a split step.
+//
+// Real and imaginary parts are kept in separate arrays and each stage's
+// twiddles are stored contiguously, so the butterfly loops run over
+// consecutive floats and are vectorized by the compiler at -O3.
+class RealFft {
+ public:
+  // |size| must be a power of two, at least 4.
+  explicit RealFft(int size);
+
+  int size() const { return size_; }
+  int bins() const { return size_ / 2 + 1; }
+
+  // Transforms |size| samples into bins() complex values.
+  void Forward(const float* input, float* re, float* im);
+
+ private:
+  int size_;
+  int half_;
+  std::vector<int> bit_reverse_;
+  // Per stage of span 2h, h twiddles starting at offset h - 1.
+  std::vector<float> twiddle_re_;
+  std::vector<float> twiddle_im_;
+  // exp(-2 pi i k / size) for the split step, k = 0 .. size / 2.
+  std::vector<float> split_re_;
+  std::vector<float> split_im_;
+  std::vector<float> work_re_;
+  std::vector<float> work_im_;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_REAL_FFT_H_
@@ -0,0 +1,62 @@
+#include "sample_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace kiosk_audio {
+
+namespace {
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+}  // namespace
+
+SampleRing::SampleRing(size_t capacity)
+    : buffer_(RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2))),
+      mask_(buffer_.size() - 1) {}
+
+size_t SampleRing::Write(const float* samples, size_t count) {
+  const size_t write = write_.load(std::memory_order_relaxed);
+  const size_t read = read_.load(std::memory_order_acquire);
+  const size_t room = buffer_.size() - (write - read);
+  const size_t n = std::min(count, room);
+  const size_t start = write & mask_;
+  const size_t first = std::min(n, buffer_.size() - start);
+  memcpy(&buffer_[start], samples, first * sizeof(float));
+  memcpy(&buffer_[0], samples + first, (n - first) * sizeof(float));
+  write_.store(write + n, std::memory_order_release);
+  if (n < count) {
+    dropped_.fetch_add(count - n, std::memory_order_relaxed);
+  }
+  return n;
+}
+
+size_t SampleRing::Read(float* out, size_t count) {
+  const size_t read = read_.load(std::memory_order_relaxed);
+  const size_t write = write_.load(std::memory_order_acquire);
+  const size_t n = std::min(count, write - read);
+  const size_t start = read & mask_;
+  const size_t first = std::min(n, buffer_.size() - start);
+  memcpy(out, &buffer_[start], first * sizeof(float));
+  memcpy(out + first, &buffer_[0], (n - first) * sizeof(float));
+  read_.store(read + n, std::memory_order_release);
+  return n;
+}
+
+void SampleRing::Clear() {
+  read_.store(write_.load(std::memory_order_acquire),
+              std::memory_order_release);
+}
+
+size_t SampleRing::available() const {
+  return write_.load(std::memory_order_acquire) -
+         read_.load(std::memory_order_acquire);
+}
+
+}  // namespace kiosk_audio
@@ -0,0 +1,45 @@
+#ifndef PLUGINS_KIOSK_AUDIO_SAMPLE_RING_H_
+#define PLUGINS_KIOSK_AUDIO_SAMPLE_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kiosk_audio {
+
+// Lock-free single-producer, single-consumer ring of samples. The capture
+// thread writes and never waits; when the reader falls behind by a whole
+// ring, the newest samples are dropped and counted.
+class SampleRing {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit SampleRing(size_t capacity);
+
+  // Disallow copy and assign.
+  SampleRing(const SampleRing&) = delete;
+  SampleRing& operator=(const SampleRing&) = delete;
+
+  // Producer. Returns how many samples fit.
+  size_t Write(const float* samples, size_t count);
+  // Consumer. Returns how many samples were copied into |out|.
+  size_t Read(float* out, size_t count);
+  // Consumer. Discards everything buffered.
+  void Clear();
+
+  size_t available() const;
+  size_t capacity() const { return buffer_.size(); }
+  uint64_t dropped() const { return dropped_.load(); }
+
+ private:
+  std::vector<float> buffer_;
+  size_t mask_;
+  // Free-running positions; the difference is the fill level.
+  std::atomic<size_t> write_{0};
+  std::atomic<size_t> read_{0};
+  std::atomic<uint64_t> dropped_{0};
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_SAMPLE_RING_H_
@@ -0,0 +1,269 @@
+#include "sound_mixer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace kiosk_audio {
+
+namespace {
+
+// How often the mixer thread refreshes the reported output latency.
+const uint64_t kLatencyPollBlocks = 200;
+
+}  // namespace
+
+SoundMixer::SoundMixer(std::unique_ptr<PcmSink> sink,
+                       const SoundMixerConfig& config)
+    : sink_(std::move(sink)), config_(config) {
+  if (sink_) {
+    thread_ = std::thread(&SoundMixer::MixLoop, this);
+  }
+}
+
+SoundMixer::~SoundMixer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  wake_.notify_all();
+  // A write returns within one block.
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+bool SoundMixer::Register(const std::string& key,
+                          std::shared_ptr<const PcmClip> clip,
+                          std::string* error) {
+  if (!clip || clip->frames() == 0) {
+    *error = "Sound is empty";
+    return false;
+  }
+  if (clip->sample_rate != config_.sample_rate ||
+      clip->channels != config_.channels) {
+    *error = "Sound does not match the mixer format";
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  clips_[key] = std::move(clip);
+  return true;
+}
+
+void SoundMixer::Unregister(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  clips_.erase(key);
+}
+
+bool SoundMixer::has_clip(const std::string& key) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return clips_.count(key) > 0;
+}
+
+int SoundMixer::Play(const std::string& key, float gain, bool loop,
+                     std::string* error) {
+  if (!sink_) {
+    *error = "Built without an audio playback backend";
+    return 0;
+  }
+  int id = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto clip = clips_.find(key);
+    if (clip == clips_.end()) {
+      *error = "Unknown sound: " + key;
+      return 0;
+    }
+    int playing = 0;
+    for (const Voice& voice : voices_) {
+      playing += voice.stopping ? 0 : 1;
+    }
+    if (playing >= config_.max_voices) {
+      // Voices are kept in start order; prefer cutting a one-shot over a
+      // loop that something is relying on.
+      Voice* victim = nullptr;
+      for (Voice& voice : voices_) {
+        if (!voice.stopping &&
+            (victim == nullptr || (victim->loop && !voice.loop))) {
+          victim = &voice;
+        }
+      }
+      if (victim != nullptr) {
+        victim->stopping = true;
+        stolen_++;
+      }
+    }
+    Voice voice;
+    id = voice.id = next_voice_id_++;
+    voice.clip = clip->second;
+    voice.position = 0;
+    voice.gain = voice.target_gain = std::max(gain, 0.0f);
+    voice.loop = loop;
+    voice.stopping = false;
+    voices_.push_back(std::move(voice));
+    played_++;
+  }
+  wake_.notify_one();
+  return id;
+}
+
+bool SoundMixer::Stop(int voice) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Voice& entry : voices_) {
+    if (entry.id == voice && !entry.stopping) {
+      entry.stopping = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SoundMixer::SetGain(int voice, float gain) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Voice& entry : voices_) {
+    if (entry.id == voice && !entry.stopping) {
+      entry.target_gain = std::max(gain, 0.0f);
+      return true;
+    }
+  }
+  return false;
+}
+
+void SoundMixer::StopAll() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Voice& entry : voices_) {
+    entry.stopping = true;
+  }
+}
+
+void SoundMixer::set_master_gain(float gain) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  master_gain_ = std::max(gain, 0.0f);
+}
+
+SoundMixerStats SoundMixer::stats() const {
+  SoundMixerStats stats;
+  stats.open = open_.load();
+  stats.sample_rate = config_.sample_rate;
+  stats.latency_us = latency_us_.load();
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats.clips = static_cast<int>(clips_.size());
+  for (const auto& entry : clips_) {
+    stats.cached_bytes += entry.second->samples.size() * sizeof(float);
+  }
+  for (const Voice& voice : voices_) {
+    stats.voices += voice.stopping ? 0 : 1;
+  }
+  stats.played = played_;
+  stats.stolen = stolen_;
+  stats.blocks = blocks_;
+  stats.error = last_error_;
+  return stats;
+}
+
+void SoundMixer::SetError(const std::string& error) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  last_error_ = error;
+}
+
+void SoundMixer::MixLoop() {
+  std::vector<float> block(
+      static_cast<size_t>(config_.block_frames) * config_.channels);
+  const auto idle = std::chrono::milliseconds(config_.idle_close_ms);
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      const auto has_work = [this]() {
+        return !running_ || !voices_.empty();
+      };
+      if (!open_.load()) {
+        wake_.wait(lock, has_work);
+      } else if (!wake_.wait_for(lock, idle, has_work)) {
+        lock.unlock();
+        sink_->Close();
+        open_ = false;
+        latency_us_ = 0;
+        continue;
+      }
+      if (!running_) {
+        break;
+      }
+      MixBlock(block.data());
+      blocks_++;
+    }
+
+    std::string error;
+    if (!sink_->is_open()) {
+      if (!sink_->Open(config_.sample_rate, config_.channels,
+                       config_.block_frames, &error)) {
+        // An alert played seconds late is worse than one not played; drop
+        // the voices and retry on the next trigger.
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_error_ = error;
+        voices_.clear();
+        continue;
+      }
+      open_ = true;
+      SetError(std::string());
+    }
+    // Blocks while the device buffer is full, which paces this loop.
+    if (!sink_->Write(block.data(), config_.block_frames, &error)) {
+      SetError(error);
+      sink_->Close();
+      open_ = false;
+      continue;
+    }
+    if (blocks_ % kLatencyPollBlocks == 1) {
+      latency_us_ = sink_->latency_us();
+    }
+  }
+  sink_->Close();
+  open_ = false;
+}
+
+void SoundMixer::MixBlock(float* out) {
+  const int channels = config_.channels;
+  const int frames = config_.block_frames;
+  std::fill(out, out + static_cast<size_t>(frames) * channels, 0.0f);
+
+  for (Voice& voice : voices_) {
+    const float target = voice.stopping ? 0.0f : voice.target_gain;
+    // Gain changes ramp across the block rather than stepping.
+    const float delta = (target - voice.gain) / frames;
+    const float* samples = voice.clip->samples.data();
+    const size_t clip_frames = voice.clip->frames();
+    float gain = voice.gain;
+    for (int i = 0; i < frames && voice.position < clip_frames; ++i) {
+      gain += delta;
+      const float* frame = samples + voice.position * channels;
+      float* mixed = out + static_cast<size_t>(i) * channels;
+      for (int c = 0; c < channels; ++c) {
+        mixed[c] += frame[c] * gain;
+      }
+      if (++voice.position == clip_frames && voice.loop) {
+        voice.position = 0;
+      }
+    }
+    voice.gain = target;
+  }
+  voices_.erase(std::remove_if(voices_.begin(), voices_.end(),
+                               [](const Voice& voice) {
+                                 return voice.stopping ||
+                                        voice.position >=
+                                            voice.clip->frames();
+                               }),
+                voices_.end());
+
+  const float delta = (master_gain_ - applied_master_gain_) / frames;
+  float gain = applied_master_gain_;
+  for (int i = 0; i < frames; ++i) {
+    gain += delta;
+    float* mixed = out + static_cast<size_t>(i) * channels;
+    for (int c = 0; c < channels; ++c) {
+      mixed[c] = std::min(1.0f, std::max(-1.0f, mixed[c] * gain));
+    }
+  }
+  applied_master_gain_ = master_gain_;
+}
+
+}  // namespace kiosk_audio
@@ -0,0 +1,124 @@
+#ifndef PLUGINS_KIOSK_AUDIO_SOUND_MIXER_H_
+#define PLUGINS_KIOSK_AUDIO_SOUND_MIXER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pcm_sink.h"
+#include "wav_decoder.h"
+
+namespace kiosk_audio {
+
+struct SoundMixerConfig {
+  int sample_rate = 48000;
+  int channels = 2;
+  // 5 ms at 48 kHz. Together with the sink's few buffered blocks this
+  // keeps a trigger under 20 ms from being heard.
+  int block_frames = 240;
+  // The oldest one-shot is cut when a new sound would exceed this.
+  int max_voices = 32;
+  // The output stream is closed after this long without sound so the
+  // device can suspend.
+  int idle_close_ms = 60000;
+};
+
+struct SoundMixerStats {
+  bool open = false;
+  int sample_rate = 0;
+  int clips = 0;
+  size_t cached_bytes = 0;
+  int voices = 0;
+  uint64_t played = 0;
+  uint64_t stolen = 0;
+  uint64_t blocks = 0;
+  int latency_us = 0;
+  std::string error;
+};
+
+// Plays preloaded clips through a single output stream. Any number of
+// one-shots and loops overlap, each with its own gain, and a trigger only
+// has to wait for the next block instead of a player opening its own
+// device.
+class SoundMixer {
+ public:
+  // |sink| may be null when no playback backend was built; Play() then
+  // fails.
+  explicit SoundMixer(std::unique_ptr<PcmSink> sink,
+                      const SoundMixerConfig& config = SoundMixerConfig());
+  ~SoundMixer();
+
+  // Disallow copy and assign.
+  SoundMixer(const SoundMixer&) = delete;
+  SoundMixer& operator=(const SoundMixer&) = delete;
+
+  const SoundMixerConfig& config() const { return config_; }
+
+  // |clip| must already be at the mixer's rate and channel count, see
+  // DecodeWav(). Replacing a key leaves voices of the old clip playing.
+  bool Register(const std::string& key, std::shared_ptr<const PcmClip> clip,
+                std::string* error);
+  void Unregister(const std::string& key);
+  bool has_clip(const std::string& key) const;
+
+  // Returns the new voice's id, or 0 with |error| set. A looping voice
+  // plays until stopped.
+  int Play(const std::string& key, float gain, bool loop, std::string* error);
+  // Both fade over one block to avoid clicks. Return false for voices
+  // that already ended.
+  bool Stop(int voice);
+  bool SetGain(int voice, float gain);
+  void StopAll();
+  void set_master_gain(float gain);
+
+  SoundMixerStats stats() const;
+
+ private:
+  struct Voice {
+    int id;
+    std::shared_ptr<const PcmClip> clip;
+    size_t position;
+    float gain;
+    float target_gain;
+    bool loop;
+    bool stopping;
+  };
+
+  void MixLoop();
+  // Sums one block of every voice into |out| and retires finished voices.
+  // Called with |mutex_| held.
+  void MixBlock(float* out);
+  void SetError(const std::string& error);
+
+  std::unique_ptr<PcmSink> sink_;
+  const SoundMixerConfig config_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool running_ = true;
+  std::map<std::string, std::shared_ptr<const PcmClip>> clips_;
+  std::vector<Voice> voices_;
+  int next_voice_id_ = 1;
+  float master_gain_ = 1.0f;
+  float applied_master_gain_ = 1.0f;
+  uint64_t played_ = 0;
+  uint64_t stolen_ = 0;
+  uint64_t blocks_ = 0;
+  std::string last_error_;
+
+  // Written by the mixer thread, which alone touches |sink_|.
+  std::atomic<bool> open_{false};
+  std::atomic<int> latency_us_{0};
+
+  std::thread thread_;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_SOUND_MIXER_H_
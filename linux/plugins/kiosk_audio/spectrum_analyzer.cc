@@ -0,0 +1,159 @@
+#include "spectrum_analyzer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace kiosk_audio {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Keeps log10 finite on digital silence.
+const float kPowerFloor = 1e-12f;
+
+int ClampFftSize(int size) {
+  int rounded = 256;
+  while (rounded < size && rounded < 16384) {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+SpectrumConfig Sanitize(SpectrumConfig config, int sample_rate) {
+  config.bars = std::max(1, std::min(config.bars, 512));
+  config.fft_size = ClampFftSize(config.fft_size);
+  config.fps = std::max(1.0, std::min(config.fps, 120.0));
+  const double nyquist = sample_rate / 2.0;
+  config.max_hz = std::min(config.max_hz, nyquist * 0.95);
+  config.min_hz = std::max(1.0, std::min(config.min_hz, config.max_hz / 2));
+  if (config.ceiling_db <= config.floor_db) {
+    config.ceiling_db = config.floor_db + 1;
+  }
+  config.attack = std::max(0.0, std::min(config.attack, 1.0));
+  return config;
+}
+
+}  // namespace
+
+SpectrumAnalyzer::SpectrumAnalyzer(const SpectrumConfig& config,
+                                   int sample_rate)
+    : config_(Sanitize(config, sample_rate)),
+      fft_(config_.fft_size),
+      hop_(std::max<size_t>(1, static_cast<size_t>(sample_rate /
+                                                   config_.fps))),
+      hop_s_(static_cast<double>(hop_) / sample_rate),
+      window_(config_.fft_size),
+      history_(config_.fft_size, 0.0f),
+      windowed_(config_.fft_size),
+      re_(fft_.bins()),
+      im_(fft_.bins()),
+      power_(fft_.bins()),
+      frame_(config_.bars * 2, 0.0f),
+      hold_s_(config_.bars, 0.0f) {
+  const int size = config_.fft_size;
+  for (int i = 0; i < size; ++i) {
+    window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2 * kPi * i / size));
+  }
+
+  const double bin_hz = static_cast<double>(sample_rate) / size;
+  const double ratio = config_.max_hz / config_.min_hz;
+  const double step = 1.0 / config_.bars;
+  for (int i = 0; i < config_.bars; ++i) {
+    const double low = config_.min_hz * std::pow(ratio, i * step);
+    const double high = config_.min_hz * std::pow(ratio, (i + 1) * step);
+    const double center = std::sqrt(low * high);
+    Band band;
+    band.first_bin = static_cast<int>(std::ceil(low / bin_hz));
+    band.last_bin = std::min(static_cast<int>(std::ceil(high / bin_hz)) - 1,
+                             fft_.bins() - 1);
+    band.center_bin = static_cast<float>(center / bin_hz);
+    band.tilt_db = static_cast<float>(config_.tilt_db_per_octave *
+                                      std::log2(center / 1000.0));
+    bands_.push_back(band);
+  }
+}
+
+bool SpectrumAnalyzer::Push(const float* samples, size_t count) {
+  bool completed = false;
+  const size_t size = history_.size();
+  while (count > 0) {
+    const size_t take =
+        std::min({count, hop_ - since_frame_, size - write_pos_});
+    std::copy(samples, samples + take, history_.begin() + write_pos_);
+    samples += take;
+    count -= take;
+    write_pos_ = (write_pos_ + take) % size;
+    since_frame_ += take;
+    if (since_frame_ == hop_) {
+      since_frame_ = 0;
+      Analyze();
+      completed = true;
+    }
+  }
+  return completed;
+}
+
+void SpectrumAnalyzer::Analyze() {
+  const size_t size = history_.size();
+  // Oldest sample first.
+  const size_t tail = size - write_pos_;
+  for (size_t i = 0; i < tail; ++i) {
+    windowed_[i] = history_[write_pos_ + i] * window_[i];
+  }
+  for (size_t i = 0; i < write_pos_; ++i) {
+    windowed_[tail + i] = history_[i] * window_[tail + i];
+  }
+  fft_.Forward(windowed_.data(), re_.data(), im_.data());
+
+  // A full-scale sine peaks at size / 4 through the Hann window.
+  const float scale = 16.0f / (static_cast<float>(size) * size);
+  for (size_t k = 0; k < power_.size(); ++k) {
+    power_[k] = (re_[k] * re_[k] + im_[k] * im_[k]) * scale;
+  }
+
+  const float range_db =
+      static_cast<float>(config_.ceiling_db - config_.floor_db);
+  const float rise = static_cast<float>(config_.attack);
+  const float fall = static_cast<float>(config_.release_per_s * hop_s_);
+  const float peak_fall = static_cast<float>(config_.peak_decay_per_s * hop_s_);
+  const int bars = config_.bars;
+  for (int i = 0; i < bars; ++i) {
+    const Band& band = bands_[i];
+    float power = 0;
+    if (band.first_bin <= band.last_bin) {
+      for (int k = band.first_bin; k <= band.last_bin; ++k) {
+        power = std::max(power, power_[k]);
+      }
+    } else {
+      // Narrower than a bin: interpolate between the neighbours.
+      const int below = std::min(static_cast<int>(band.center_bin),
+                                 static_cast<int>(power_.size()) - 2);
+      const float t = band.center_bin - below;
+      power = power_[below] * (1 - t) + power_[below + 1] * t;
+    }
+    const float db = 10.0f * std::log10(power + kPowerFloor) + band.tilt_db;
+    const float target = std::max(
+        0.0f, std::min(1.0f, (db - static_cast<float>(config_.floor_db)) /
+                                 range_db));
+
+    float& level = frame_[i];
+    if (target > level) {
+      level += (target - level) * rise;
+    } else {
+      level = std::max(target, level - fall);
+    }
+
+    float& peak = frame_[bars + i];
+    if (level >= peak) {
+      peak = level;
+      hold_s_[i] = static_cast<float>(config_.peak_hold_s);
+    } else if (hold_s_[i] > 0) {
+      hold_s_[i] -= static_cast<float>(hop_s_);
+    } else {
+      peak = std::max(level, peak - peak_fall);
+    }
+  }
+}
+
+}  // namespace kiosk_audio
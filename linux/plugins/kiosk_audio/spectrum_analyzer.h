@@ -0,0 +1,89 @@
+#ifndef PLUGINS_KIOSK_AUDIO_SPECTRUM_ANALYZER_H_
+#define PLUGINS_KIOSK_AUDIO_SPECTRUM_ANALYZER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "real_fft.h"
+
+namespace kiosk_audio {
+
+struct SpectrumConfig {
+  int bars = 64;
+  // Power of two; 2048 at 48 kHz resolves ~23 Hz, enough for the bass bars.
+  int fft_size = 2048;
+  // Frames per second; the analysis hop is sample_rate / fps.
+  double fps = 30;
+  // Bars are spaced evenly in log frequency over this range.
+  double min_hz = 40;
+  double max_hz = 16000;
+  // Level range mapped to 0..1, in dB relative to a full-scale sine.
+  double floor_db = -70;
+  double ceiling_db = -10;
+  // Boost per octave above 1 kHz, and cut below, so that music, which
+  // loses about this much per octave, shows a level spectrum.
+  double tilt_db_per_octave = 3;
+  // Fraction of a rise applied per frame; falls are linear, in full bar
+  // heights per second.
+  double attack = 0.7;
+  double release_per_s = 2.0;
+  // Peak markers stay put this long, then fall at |peak_decay_per_s|.
+  double peak_hold_s = 0.4;
+  double peak_decay_per_s = 0.8;
+};
+
+// Turns mono PCM into visualizer bars: Hann window, real FFT, log frequency
+// bands, level mapping and attack / release smoothing with falling peaks.
+//
+// Frames are timed by the samples pushed, not the wall clock, so the same
+// audio always gives the same bars.
+class SpectrumAnalyzer {
+ public:
+  SpectrumAnalyzer(const SpectrumConfig& config, int sample_rate);
+
+  // Disallow copy and assign.
+  SpectrumAnalyzer(const SpectrumAnalyzer&) = delete;
+  SpectrumAnalyzer& operator=(const SpectrumAnalyzer&) = delete;
+
+  // Appends |count| samples in -1..1. Returns true when at least one frame
+  // was completed; frame() then holds the newest.
+  bool Push(const float* samples, size_t count);
+
+  // |bars| smoothed levels followed by |bars| peak levels, all 0..1.
+  const std::vector<float>& frame() const { return frame_; }
+  const SpectrumConfig& config() const { return config_; }
+
+ private:
+  struct Band {
+    int first_bin;
+    int last_bin;
+    // Fractional bin of the band center, for bands narrower than a bin.
+    float center_bin;
+    float tilt_db;
+  };
+
+  void Analyze();
+
+  SpectrumConfig config_;
+  RealFft fft_;
+  size_t hop_;
+  double hop_s_;
+  std::vector<Band> bands_;
+  std::vector<float> window_;
+
+  // Last fft_size samples, circular.
+  std::vector<float> history_;
+  size_t write_pos_ = 0;
+  size_t since_frame_ = 0;
+
+  std::vector<float> windowed_;
+  std::vector<float> re_;
+  std::vector<float> im_;
+  std::vector<float> power_;
+  std::vector<float> frame_;
+  std::vector<float> hold_s_;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_SPECTRUM_ANALYZER_H_
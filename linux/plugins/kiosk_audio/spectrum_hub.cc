@@ -0,0 +1,124 @@
+#include "spectrum_hub.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace kiosk_audio {
+
+SpectrumHub::SpectrumHub(std::unique_ptr<PcmSource> source,
+                         FrameCallback callback)
+    : source_(std::move(source)), callback_(std::move(callback)) {}
+
+SpectrumHub::~SpectrumHub() {
+  if (source_) {
+    source_->Stop();
+  }
+}
+
+int SpectrumHub::Add(const SpectrumConfig& config, std::string* error) {
+  if (!source_) {
+    *error = "Built without an audio capture backend";
+    return 0;
+  }
+  int id = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    id = next_id_++;
+    Entry entry;
+    entry.id = id;
+    entry.active = true;
+    entry.analyzer.reset(new SpectrumAnalyzer(config, source_->sample_rate()));
+    entries_.push_back(std::move(entry));
+  }
+  UpdateSource();
+  return id;
+}
+
+void SpectrumHub::SetActive(int id, bool active) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (Entry& entry : entries_) {
+      if (entry.id == id) {
+        entry.active = active;
+      }
+    }
+  }
+  UpdateSource();
+}
+
+void SpectrumHub::Remove(int id) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+                                  [id](const Entry& entry) {
+                                    return entry.id == id;
+                                  }),
+                   entries_.end());
+  }
+  UpdateSource();
+}
+
+bool SpectrumHub::analyzer_config(int id, SpectrumConfig* config) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (const Entry& entry : entries_) {
+    if (entry.id == id) {
+      *config = entry.analyzer->config();
+      return true;
+    }
+  }
+  return false;
+}
+
+SpectrumHubStats SpectrumHub::stats() const {
+  SpectrumHubStats stats;
+  if (source_) {
+    stats.capturing = source_->is_running();
+    stats.sample_rate = source_->sample_rate();
+    stats.source_error = source_->last_error();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats.analyzers = static_cast<int>(entries_.size());
+  for (const Entry& entry : entries_) {
+    stats.active += entry.active ? 1 : 0;
+  }
+  stats.blocks = blocks_;
+  stats.frames = frames_;
+  return stats;
+}
+
+void SpectrumHub::OnSamples(const float* samples, size_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  blocks_++;
+  for (Entry& entry : entries_) {
+    if (entry.active && entry.analyzer->Push(samples, count)) {
+      frames_++;
+      callback_(entry.id, entry.analyzer->frame());
+    }
+  }
+}
+
+void SpectrumHub::UpdateSource() {
+  if (!source_) {
+    return;
+  }
+  std::lock_guard<std::mutex> source_lock(source_mutex_);
+  bool wanted = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const Entry& entry : entries_) {
+      wanted = wanted || entry.active;
+    }
+  }
+  if (wanted && !source_->is_running()) {
+    std::string error;
+    source_->Start(
+        [this](const float* samples, size_t count) {
+          OnSamples(samples, count);
+        },
+        &error);
+  } else if (!wanted && source_->is_running()) {
+    source_->Stop();
+  }
+}
+
+}  // namespace kiosk_audio
@@ -0,0 +1,84 @@
+#ifndef PLUGINS_KIOSK_AUDIO_SPECTRUM_HUB_H_
+#define PLUGINS_KIOSK_AUDIO_SPECTRUM_HUB_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pcm_source.h"
+#include "spectrum_analyzer.h"
+
+namespace kiosk_audio {
+
+struct SpectrumHubStats {
+  bool capturing = false;
+  int sample_rate = 0;
+  int analyzers = 0;
+  int active = 0;
+  uint64_t blocks = 0;
+  uint64_t frames = 0;
+  std::string source_error;
+};
+
+// Feeds one PCM source to any number of analyzers, one per visualizer
+// tile. The source only runs while at least one analyzer is active, so a
+// paused or hidden tile costs nothing and each playing one costs a single
+// FFT per frame.
+class SpectrumHub {
+ public:
+  // Called on the source thread with the analyzer's frame; must not call
+  // back into the hub.
+  using FrameCallback =
+      std::function<void(int id, const std::vector<float>& frame)>;
+
+  // |source| may be null when no capture backend was built; Add() then
+  // fails.
+  SpectrumHub(std::unique_ptr<PcmSource> source, FrameCallback callback);
+  ~SpectrumHub();
+
+  // Disallow copy and assign.
+  SpectrumHub(const SpectrumHub&) = delete;
+  SpectrumHub& operator=(const SpectrumHub&) = delete;
+
+  // Returns the new analyzer's id, or 0 with |error| set. New analyzers
+  // start active.
+  int Add(const SpectrumConfig& config, std::string* error);
+  void SetActive(int id, bool active);
+  void Remove(int id);
+
+  // Effective settings of an analyzer after clamping.
+  bool analyzer_config(int id, SpectrumConfig* config) const;
+  SpectrumHubStats stats() const;
+
+ private:
+  struct Entry {
+    int id;
+    bool active;
+    std::unique_ptr<SpectrumAnalyzer> analyzer;
+  };
+
+  void OnSamples(const float* samples, size_t count);
+  // Starts or stops the source to match the active analyzers.
+  void UpdateSource();
+
+  std::unique_ptr<PcmSource> source_;
+  FrameCallback callback_;
+
+  // Held by the source thread while it feeds the analyzers.
+  mutable std::mutex mutex_;
+  std::vector<Entry> entries_;
+  int next_id_ = 1;
+  uint64_t blocks_ = 0;
+  uint64_t frames_ = 0;
+
+  // Serializes starting and stopping the source. Never held with |mutex_|,
+  // since stopping joins the thread that takes |mutex_|.
+  std::mutex source_mutex_;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_SPECTRUM_HUB_H_
@@ -0,0 +1,367 @@
+#include "speech_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+namespace kiosk_audio {
+
+namespace {
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+SpeechEngine::SpeechEngine(std::unique_ptr<SpeechSynthesizer> synthesizer,
+                           std::unique_ptr<PcmSink> sink,
+                           const SpeechEngineConfig& config,
+                           UpdateCallback callback)
+    : synthesizer_(std::move(synthesizer)),
+      sink_(std::move(sink)),
+      config_(config),
+      callback_(std::move(callback)),
+      engine_id_(synthesizer_->name()),
+      cache_(config.cache, config.sample_rate, 1) {
+  synthesis_thread_ = std::thread(&SpeechEngine::SynthesisLoop, this);
+  if (sink_) {
+    playback_thread_ = std::thread(&SpeechEngine::PlaybackLoop, this);
+  }
+}
+
+SpeechEngine::~SpeechEngine() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    running_ = false;
+  }
+  synthesizer_->Cancel();
+  wake_synthesis_.notify_all();
+  wake_playback_.notify_all();
+  synthesis_thread_.join();
+  // A write returns within one block.
+  if (playback_thread_.joinable()) {
+    playback_thread_.join();
+  }
+}
+
+int SpeechEngine::Speak(const SpeechRequest& request, float volume,
+                        std::string* error) {
+  if (!sink_) {
+    *error = "Built without an audio playback backend";
+    return 0;
+  }
+  std::shared_ptr<Item> item(new Item());
+  item->request = request;
+  item->key = PhraseCache::Key(engine_id_, request);
+  item->volume = std::min(std::max(volume, 0.0f), 1.0f);
+  item->queued_us = NowUs();
+  // A cached phrase skips the synthesis thread altogether.
+  item->clip = cache_.FindInMemory(item->key);
+  item->ready = item->cached = item->clip != nullptr;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  item->id = next_id_++;
+  queue_.push_back(item);
+  if (item->ready) {
+    wake_playback_.notify_one();
+  } else {
+    wake_synthesis_.notify_one();
+  }
+  return item->id;
+}
+
+void SpeechEngine::Prefetch(const SpeechRequest& request) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (static_cast<int>(prefetch_.size()) >= config_.max_prefetch) {
+    return;
+  }
+  prefetch_.push_back(request);
+  wake_synthesis_.notify_one();
+}
+
+void SpeechEngine::Stop() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  queue_.clear();
+  prefetch_.clear();
+  paused_ = false;
+  interrupt_ = speaking_ != 0;
+  wake_playback_.notify_all();
+}
+
+void SpeechEngine::set_paused(bool paused) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  paused_ = paused;
+  wake_playback_.notify_all();
+}
+
+void SpeechEngine::ClearCache() {
+  cache_.Clear();
+}
+
+size_t SpeechEngine::ReleaseMemory() {
+  return cache_.ReleaseMemory();
+}
+
+SpeechEngineStats SpeechEngine::stats() const {
+  SpeechEngineStats stats;
+  stats.engine = engine_id_;
+  stats.open = open_.load();
+  stats.cache = cache_.stats();
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats.paused = paused_;
+  stats.queued = static_cast<int>(queue_.size());
+  stats.speaking = speaking_;
+  stats.prefetching = static_cast<int>(prefetch_.size());
+  stats.spoken = spoken_;
+  stats.synthesized = synthesized_;
+  stats.failed = failed_;
+  stats.stalls = stalls_;
+  stats.last_synthesis_ms = last_synthesis_ms_;
+  stats.average_synthesis_ms =
+      synthesized_ > 0 ? total_synthesis_ms_ / synthesized_ : 0;
+  stats.last_start_ms = last_start_ms_;
+  stats.error = last_error_;
+  return stats;
+}
+
+std::shared_ptr<SpeechEngine::Item> SpeechEngine::NextToRender() {
+  const size_t window =
+      std::min(queue_.size(), static_cast<size_t>(config_.lookahead));
+  for (size_t i = 0; i < window; ++i) {
+    if (!queue_[i]->ready && queue_[i] != rendering_) {
+      return queue_[i];
+    }
+  }
+  return nullptr;
+}
+
+std::shared_ptr<const PcmClip> SpeechEngine::Render(
+    const SpeechRequest& request, const std::string& key, bool* cached,
+    std::string* error) {
+  std::shared_ptr<const PcmClip> clip = cache_.Find(key);
+  *cached = clip != nullptr;
+  if (clip) {
+    return clip;
+  }
+  const int64_t start_us = NowUs();
+  std::vector<uint8_t> wav;
+  std::shared_ptr<PcmClip> decoded(new PcmClip());
+  if (!synthesizer_->Synthesize(request, &wav, error) ||
+      !DecodeWav(wav.data(), wav.size(), config_.sample_rate, 1,
+                 decoded.get(), error)) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_++;
+    last_error_ = *error;
+    return nullptr;
+  }
+  const double elapsed_ms = (NowUs() - start_us) / 1000.0;
+  cache_.Store(key, decoded);
+  std::lock_guard<std::mutex> lock(mutex_);
+  synthesized_++;
+  last_synthesis_ms_ = elapsed_ms;
+  total_synthesis_ms_ += elapsed_ms;
+  return decoded;
+}
+
+void SpeechEngine::SynthesisLoop() {
+  while (true) {
+    std::shared_ptr<Item> item;
+    SpeechRequest request;
+    std::string key;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_synthesis_.wait(lock, [this, &item]() {
+        item = NextToRender();
+        return !running_ || item || !prefetch_.empty();
+      });
+      if (!running_) {
+        return;
+      }
+      if (item) {
+        rendering_ = item;
+        request = item->request;
+        key = item->key;
+      } else {
+        request = prefetch_.front();
+        prefetch_.pop_front();
+        key = PhraseCache::Key(engine_id_, request);
+      }
+    }
+
+    bool cached = false;
+    std::string error;
+    std::shared_ptr<const PcmClip> clip =
+        Render(request, key, &cached, &error);
+    if (!item) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    rendering_ = nullptr;
+    item->clip = std::move(clip);
+    item->cached = cached;
+    item->error = error;
+    item->ready = true;
+    wake_playback_.notify_one();
+  }
+}
+
+void SpeechEngine::PlaybackLoop() {
+  // Whether the previous utterance ended with more queued, so a wait for
+  // synthesis now is an audible stall.
+  bool continuing = false;
+  while (true) {
+    std::shared_ptr<Item> item;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto ready = [this]() {
+        return !running_ ||
+               (!paused_ && !queue_.empty() && queue_.front()->ready);
+      };
+      if (!ready()) {
+        if (continuing && !queue_.empty() && !paused_) {
+          stalls_++;
+        }
+        if (open_.load()) {
+          if (!wake_playback_.wait_for(
+                  lock, std::chrono::milliseconds(config_.idle_close_ms),
+                  ready)) {
+            lock.unlock();
+            // Let the device suspend between announcements.
+            sink_->Close();
+            open_ = false;
+            continue;
+          }
+        } else {
+          wake_playback_.wait(lock, ready);
+        }
+      }
+      continuing = false;
+      if (!running_) {
+        break;
+      }
+      item = queue_.front();
+      queue_.pop_front();
+      speaking_ = item->id;
+      interrupt_ = false;
+      // The lookahead window moved on.
+      wake_synthesis_.notify_one();
+    }
+
+    SpeechUpdate update;
+    update.id = item->id;
+    if (!item->clip) {
+      update.kind = SpeechUpdate::Kind::kError;
+      update.error = item->error;
+    } else if (!open_.load() &&
+               !sink_->Open(config_.sample_rate, 1,
+                            config_.sample_rate * config_.block_ms / 1000,
+                            &update.error)) {
+      update.kind = SpeechUpdate::Kind::kError;
+      SetError(update.error);
+    } else {
+      open_ = true;
+      const bool finished = PlayItem(*item);
+      update.kind = SpeechUpdate::Kind::kDone;
+      update.interrupted = !finished;
+      std::lock_guard<std::mutex> lock(mutex_);
+      spoken_++;
+      continuing = finished && !queue_.empty();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      speaking_ = 0;
+    }
+    callback_(update);
+    if (continuing) {
+      WriteGap();
+    }
+  }
+  if (open_.load()) {
+    sink_->Close();
+    open_ = false;
+  }
+}
+
+bool SpeechEngine::PlayItem(const Item& item) {
+  const PcmClip& clip = *item.clip;
+  const size_t block_frames = std::max<size_t>(
+      1, static_cast<size_t>(config_.sample_rate) * config_.block_ms / 1000);
+  std::vector<float> block(block_frames);
+  std::string error;
+
+  SpeechUpdate start;
+  start.kind = SpeechUpdate::Kind::kStart;
+  start.id = item.id;
+  start.cached = item.cached;
+  start.latency_ms =
+      (NowUs() - item.queued_us + sink_->latency_us()) / 1000.0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_start_ms_ = start.latency_ms;
+  }
+  callback_(start);
+
+  size_t position = 0;
+  while (position < clip.frames()) {
+    bool fade_out = false;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_playback_.wait(lock, [this]() {
+        return !running_ || interrupt_ || !paused_;
+      });
+      fade_out = !running_ || interrupt_;
+    }
+    const size_t frames = std::min(block_frames, clip.frames() - position);
+    for (size_t i = 0; i < frames; ++i) {
+      // A stopped utterance ramps down over one block instead of clicking.
+      const float ramp = fade_out ? 1.0f - static_cast<float>(i) / frames
+                                  : 1.0f;
+      block[i] = clip.samples[position + i] * item.volume * ramp;
+    }
+    if (!sink_->Write(block.data(), frames, &error)) {
+      SetError(error);
+      sink_->Close();
+      open_ = false;
+      return false;
+    }
+    position += frames;
+    if (fade_out) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void SpeechEngine::WriteGap() {
+  const size_t block_frames = std::max<size_t>(
+      1, static_cast<size_t>(config_.sample_rate) * config_.block_ms / 1000);
+  const std::vector<float> silence(block_frames, 0.0f);
+  size_t gap = static_cast<size_t>(config_.sample_rate) * config_.gap_ms /
+               1000;
+  std::string error;
+  while (gap > 0) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (queue_.empty() || !running_) {
+        return;
+      }
+    }
+    const size_t frames = std::min(block_frames, gap);
+    if (!sink_->Write(silence.data(), frames, &error)) {
+      return;
+    }
+    gap -= frames;
+  }
+}
+
+void SpeechEngine::SetError(const std::string& error) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  last_error_ = error;
+}
+
+}  // namespace kiosk_audio
@@ -0,0 +1,176 @@
+#ifndef PLUGINS_KIOSK_AUDIO_SPEECH_ENGINE_H_
+#define PLUGINS_KIOSK_AUDIO_SPEECH_ENGINE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "pcm_sink.h"
+#include "phrase_cache.h"
+#include "speech_synthesizer.h"
+
+namespace kiosk_audio {
+
+struct SpeechEngineConfig {
+  // Mono at the rate espeak-ng and most piper voices produce; the sound
+  // server resamples.
+  int sample_rate = 22050;
+  int block_ms = 20;
+  // Silence between queued utterances, like a pause between sentences.
+  int gap_ms = 150;
+  // Queued utterances synthesized ahead of the one playing.
+  int lookahead = 4;
+  // Pending prefetches beyond this are dropped.
+  int max_prefetch = 64;
+  // The output stream is closed after this long without speech.
+  int idle_close_ms = 30000;
+  PhraseCacheConfig cache;
+};
+
+struct SpeechUpdate {
+  enum class Kind { kStart, kDone, kError };
+  Kind kind = Kind::kStart;
+  int id = 0;
+  // kStart: served from the phrase cache.
+  bool cached = false;
+  // kStart: from Speak() to the first sample being heard.
+  double latency_ms = 0;
+  // kDone: cut short by Stop().
+  bool interrupted = false;
+  std::string error;
+};
+
+struct SpeechEngineStats {
+  std::string engine;
+  bool open = false;
+  bool paused = false;
+  int queued = 0;
+  int speaking = 0;
+  int prefetching = 0;
+  uint64_t spoken = 0;
+  uint64_t synthesized = 0;
+  uint64_t failed = 0;
+  // Queued utterances that were not synthesized by the time the previous
+  // one ended.
+  uint64_t stalls = 0;
+  double last_synthesis_ms = 0;
+  double average_synthesis_ms = 0;
+  double last_start_ms = 0;
+  PhraseCacheStats cache;
+  std::string error;
+};
+
+// Speaks queued utterances through one output stream.
+//
+// A synthesis thread works through the queue up to |lookahead| items ahead
+// of playback, consulting the phrase cache first, so a repeated
+// announcement starts as soon as the stream accepts it. The playback
+// thread writes utterance after utterance without reopening the stream,
+// so a batch plays back to back instead of paying engine startup between
+// items.
+class SpeechEngine {
+ public:
+  using UpdateCallback = std::function<void(const SpeechUpdate& update)>;
+
+  // |synthesizer| is required. |sink| may be null when no playback backend
+  // was built; Speak() then fails. |callback| runs on the engine's threads.
+  SpeechEngine(std::unique_ptr<SpeechSynthesizer> synthesizer,
+               std::unique_ptr<PcmSink> sink,
+               const SpeechEngineConfig& config, UpdateCallback callback);
+  ~SpeechEngine();
+
+  // Disallow copy and assign.
+  SpeechEngine(const SpeechEngine&) = delete;
+  SpeechEngine& operator=(const SpeechEngine&) = delete;
+
+  // Queues |request| behind anything already queued and returns its id,
+  // or 0 with |error| set. |volume| is 0..1 and applied at playback.
+  int Speak(const SpeechRequest& request, float volume, std::string* error);
+  // Synthesizes into the cache without playing, after queued utterances.
+  void Prefetch(const SpeechRequest& request);
+  // Drops the queue and fades out the utterance playing. An utterance
+  // being synthesized still lands in the cache.
+  void Stop();
+  void set_paused(bool paused);
+  void ClearCache();
+  // Drops the cached clips held in memory, keeping the disk cache. Returns
+  // the bytes released.
+  size_t ReleaseMemory();
+
+  SpeechEngineStats stats() const;
+
+ private:
+  struct Item {
+    int id = 0;
+    SpeechRequest request;
+    std::string key;
+    float volume = 1.0f;
+    int64_t queued_us = 0;
+    bool ready = false;
+    bool cached = false;
+    std::shared_ptr<const PcmClip> clip;
+    std::string error;
+  };
+
+  void SynthesisLoop();
+  void PlaybackLoop();
+  // Cache, then engine. Called without |mutex_|.
+  std::shared_ptr<const PcmClip> Render(const SpeechRequest& request,
+                                        const std::string& key, bool* cached,
+                                        std::string* error);
+  // First queued item within the lookahead that still needs audio.
+  // Called with |mutex_| held.
+  std::shared_ptr<Item> NextToRender();
+  // Plays |item| to the end or until Stop(); returns false if stopped.
+  bool PlayItem(const Item& item);
+  // The pause before the next queued utterance; cut short if the queue
+  // empties meanwhile.
+  void WriteGap();
+  void SetError(const std::string& error);
+
+  std::unique_ptr<SpeechSynthesizer> synthesizer_;
+  std::unique_ptr<PcmSink> sink_;
+  const SpeechEngineConfig config_;
+  const UpdateCallback callback_;
+  // Voice settings outside the request that change the audio.
+  const std::string engine_id_;
+  PhraseCache cache_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_synthesis_;
+  std::condition_variable wake_playback_;
+  bool running_ = true;
+  bool paused_ = false;
+  // Set by Stop() for the utterance playing.
+  bool interrupt_ = false;
+  std::deque<std::shared_ptr<Item>> queue_;
+  std::deque<SpeechRequest> prefetch_;
+  // Being synthesized, so NextToRender() skips it.
+  std::shared_ptr<Item> rendering_;
+  int next_id_ = 1;
+  int speaking_ = 0;
+  uint64_t spoken_ = 0;
+  uint64_t synthesized_ = 0;
+  uint64_t failed_ = 0;
+  uint64_t stalls_ = 0;
+  double last_synthesis_ms_ = 0;
+  double total_synthesis_ms_ = 0;
+  double last_start_ms_ = 0;
+  std::string last_error_;
+
+  // Written by the playback thread, which alone touches |sink_|.
+  std::atomic<bool> open_{false};
+
+  std::thread synthesis_thread_;
+  std::thread playback_thread_;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_SPEECH_ENGINE_H_
@@ -0,0 +1,315 @@
+#include "speech_synthesizer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+extern char** environ;
+
+namespace kiosk_audio {
+
+namespace {
+
+const int kPollMs = 100;
+
+int64_t NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+bool EndsWith(const std::string& value, const char* suffix) {
+  const size_t length = strlen(suffix);
+  return value.size() >= length &&
+         value.compare(value.size() - length, length, suffix) == 0;
+}
+
+// Speed factor relative to normal: 0.5x at rate 0, 2x at rate 1.
+double SpeedFactor(float rate) {
+  return std::pow(2.0, (std::min(std::max(rate, 0.0f), 1.0f) - 0.5) * 2);
+}
+
+// espeak-ng ships a handful of regional voices; everything else is
+// named by its language alone.
+std::string EspeakVoiceFor(const std::string& language) {
+  std::string voice = language;
+  std::transform(voice.begin(), voice.end(), voice.begin(), [](char c) {
+    return c == '_' ? '-' : static_cast<char>(tolower(c));
+  });
+  static const char* const kRegional[] = {"en-us", "en-gb", "pt-br",
+                                          "es-419", "fr-be", "fr-ch"};
+  for (const char* regional : kRegional) {
+    if (voice == regional) {
+      return voice;
+    }
+  }
+  return voice.substr(0, voice.find('-'));
+}
+
+// Formats from integers, since %f follows the UI locale's decimal comma.
+std::string FormatDecimal(double value) {
+  const int milli = static_cast<int>(std::lround(value * 1000));
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%d.%03d", milli / 1000, milli % 1000);
+  return buffer;
+}
+
+// Keeps a write to a dead child's stdin from killing the process; the
+// write fails with EPIPE instead.
+class ScopedBlockSigpipe {
+ public:
+  ScopedBlockSigpipe() {
+    sigemptyset(&pipe_);
+    sigaddset(&pipe_, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipe_, &saved_);
+  }
+  ~ScopedBlockSigpipe() {
+    // Consume a SIGPIPE raised meanwhile so it is not delivered on
+    // unblock.
+    const struct timespec zero = {0, 0};
+    while (sigtimedwait(&pipe_, nullptr, &zero) == SIGPIPE) {
+    }
+    pthread_sigmask(SIG_SETMASK, &saved_, nullptr);
+  }
+
+ private:
+  sigset_t pipe_;
+  sigset_t saved_;
+};
+
+}  // namespace
+
+CommandSynthesizer::CommandSynthesizer(Engine engine,
+                                       const std::string& executable,
+                                       const std::string& default_voice,
+                                       int timeout_ms)
+    : engine_(engine),
+      executable_(executable),
+      default_voice_(default_voice),
+      timeout_ms_(timeout_ms) {}
+
+const char* CommandSynthesizer::name() const {
+  return engine_ == Engine::kPiper ? "piper" : "espeak-ng";
+}
+
+std::vector<std::string> CommandSynthesizer::Arguments(
+    const SpeechRequest& request) const {
+  const double speed = SpeedFactor(request.rate);
+  if (engine_ == Engine::kPiper) {
+    const std::string& model =
+        EndsWith(request.voice, ".onnx") ? request.voice : default_voice_;
+    return {executable_, "--model", model, "--output_file", "-",
+            "--length_scale", FormatDecimal(1.0 / speed)};
+  }
+  std::string voice = request.voice;
+  if (voice.empty() || EndsWith(voice, ".onnx")) {
+    voice = default_voice_.empty() ? EspeakVoiceFor(request.language)
+                                   : default_voice_;
+  }
+  const int words_per_minute =
+      std::min(std::max(static_cast<int>(175 * speed), 80), 450);
+  const int pitch =
+      std::min(std::max(static_cast<int>(50 * request.pitch), 0), 99);
+  return {executable_, "--stdout", "--stdin", "-b", "1",
+          "-v", voice, "-s", std::to_string(words_per_minute),
+          "-p", std::to_string(pitch)};
+}
+
+bool CommandSynthesizer::Synthesize(const SpeechRequest& request,
+                                    std::vector<uint8_t>* wav,
+                                    std::string* error) {
+  if (engine_ == Engine::kPiper && default_voice_.empty() &&
+      !EndsWith(request.voice, ".onnx")) {
+    *error = "piper needs a voice model";
+    return false;
+  }
+  const std::vector<std::string> arguments = Arguments(request);
+  std::vector<char*> argv;
+  for (const std::string& argument : arguments) {
+    argv.push_back(const_cast<char*>(argument.c_str()));
+  }
+  argv.push_back(nullptr);
+
+  int input[2];
+  int output[2];
+  if (pipe2(input, O_CLOEXEC) != 0) {
+    *error = std::string("pipe: ") + strerror(errno);
+    return false;
+  }
+  if (pipe2(output, O_CLOEXEC) != 0) {
+    *error = std::string("pipe: ") + strerror(errno);
+    close(input[0]);
+    close(input[1]);
+    return false;
+  }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, input[0], STDIN_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, output[1], STDOUT_FILENO);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  pid_t pid = 0;
+  const int spawned = posix_spawn(&pid, executable_.c_str(), &actions,
+                                  nullptr, argv.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  close(input[0]);
+  close(output[1]);
+  if (spawned != 0) {
+    *error = executable_ + ": " + strerror(spawned);
+    close(input[1]);
+    close(output[0]);
+    return false;
+  }
+
+  ScopedBlockSigpipe block_sigpipe;
+  fcntl(input[1], F_SETFL, O_NONBLOCK);
+  int stdin_fd = input[1];
+  size_t written = 0;
+  const std::string& text = request.text;
+  const int64_t deadline = NowMs() + timeout_ms_;
+  bool failed = false;
+  uint8_t buffer[16384];
+  wav->clear();
+  while (true) {
+    if (cancelled_.load()) {
+      *error = "Cancelled";
+      failed = true;
+      break;
+    }
+    if (NowMs() > deadline) {
+      *error = std::string(name()) + " timed out";
+      failed = true;
+      break;
+    }
+    struct pollfd fds[2];
+    fds[0].fd = output[0];
+    fds[0].events = POLLIN;
+    fds[1].fd = stdin_fd;
+    fds[1].events = POLLOUT;
+    const int ready = poll(fds, stdin_fd >= 0 ? 2 : 1, kPollMs);
+    if (ready < 0 && errno != EINTR) {
+      *error = std::string("poll: ") + strerror(errno);
+      failed = true;
+      break;
+    }
+    if (ready <= 0) {
+      continue;
+    }
+    if (stdin_fd >= 0 && fds[1].revents != 0) {
+      const ssize_t count = write(stdin_fd, text.data() + written,
+                                  text.size() - written);
+      if (count > 0) {
+        written += static_cast<size_t>(count);
+      }
+      // EOF tells the engine the text is complete.
+      if (written == text.size() || (count < 0 && errno != EAGAIN)) {
+        close(stdin_fd);
+        stdin_fd = -1;
+      }
+    }
+    if (fds[0].revents != 0) {
+      const ssize_t count = read(output[0], buffer, sizeof(buffer));
+      if (count > 0) {
+        wav->insert(wav->end(), buffer, buffer + count);
+      } else if (count == 0 || errno != EINTR) {
+        break;
+      }
+    }
+  }
+  if (stdin_fd >= 0) {
+    close(stdin_fd);
+  }
+  close(output[0]);
+  if (failed) {
+    kill(pid, SIGKILL);
+  }
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  if (failed) {
+    return false;
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    *error = std::string(name()) + " failed; check the voice name";
+    return false;
+  }
+  if (wav->size() <= 44) {
+    *error = std::string(name()) + " produced no audio";
+    return false;
+  }
+  return true;
+}
+
+std::string FindExecutable(const std::string& name) {
+  if (name.empty()) {
+    return std::string();
+  }
+  if (name.find('/') != std::string::npos) {
+    return access(name.c_str(), X_OK) == 0 ? name : std::string();
+  }
+  const char* path = getenv("PATH");
+  std::string directories = path != nullptr ? path : "/usr/local/bin:/usr/bin";
+  size_t start = 0;
+  while (start <= directories.size()) {
+    size_t end = directories.find(':', start);
+    if (end == std::string::npos) {
+      end = directories.size();
+    }
+    const std::string directory = directories.substr(start, end - start);
+    if (!directory.empty()) {
+      const std::string candidate = directory + "/" + name;
+      if (access(candidate.c_str(), X_OK) == 0) {
+        return candidate;
+      }
+    }
+    start = end + 1;
+  }
+  return std::string();
+}
+
+std::unique_ptr<SpeechSynthesizer> CreateSpeechSynthesizer(
+    const std::string& engine, const std::string& default_voice,
+    int timeout_ms, std::string* error) {
+  const bool want_piper =
+      engine == "piper" ||
+      (engine == "auto" && EndsWith(default_voice, ".onnx"));
+  if (want_piper) {
+    const std::string piper = FindExecutable("piper");
+    if (!piper.empty()) {
+      return std::unique_ptr<SpeechSynthesizer>(new CommandSynthesizer(
+          CommandSynthesizer::Engine::kPiper, piper, default_voice,
+          timeout_ms));
+    }
+    if (engine == "piper") {
+      *error = "piper is not installed";
+      return nullptr;
+    }
+  }
+  if (engine != "auto" && engine != "espeak-ng") {
+    *error = "Unknown speech engine " + engine;
+    return nullptr;
+  }
+  const std::string espeak = FindExecutable("espeak-ng");
+  if (espeak.empty()) {
+    *error = "espeak-ng is not installed";
+    return nullptr;
+  }
+  // A piper model is no use to espeak-ng.
+  return std::unique_ptr<SpeechSynthesizer>(new CommandSynthesizer(
+      CommandSynthesizer::Engine::kEspeakNg, espeak,
+      EndsWith(default_voice, ".onnx") ? std::string() : default_voice,
+      timeout_ms));
+}
+
+}  // namespace kiosk_audio
@@ -0,0 +1,84 @@
+#ifndef PLUGINS_KIOSK_AUDIO_SPEECH_SYNTHESIZER_H_
+#define PLUGINS_KIOSK_AUDIO_SPEECH_SYNTHESIZER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kiosk_audio {
+
+// One utterance, with the same units as flutter_tts so TtsService can
+// hand over its settings unchanged.
+struct SpeechRequest {
+  std::string text;
+  // Engine voice: an espeak-ng voice name or a piper .onnx model path.
+  // Empty picks the voice for |language|.
+  std::string voice;
+  std::string language = "en-US";
+  // 0..1, 0.5 is the engine's normal speed.
+  float rate = 0.5f;
+  // 0.5..2, 1 is normal. piper voices ignore it.
+  float pitch = 1.0f;
+};
+
+// Offline text to speech.
+class SpeechSynthesizer {
+ public:
+  virtual ~SpeechSynthesizer() = default;
+
+  virtual const char* name() const = 0;
+  // Writes a RIFF WAVE file to |wav|. Blocks until done; called from one
+  // thread at a time.
+  virtual bool Synthesize(const SpeechRequest& request,
+                          std::vector<uint8_t>* wav, std::string* error) = 0;
+  // Makes a running Synthesize() give up; used on shutdown.
+  virtual void Cancel() = 0;
+};
+
+// Runs the espeak-ng or piper command line once per utterance, text on
+// stdin and WAV on stdout. Spawning costs a few milliseconds next to
+// synthesis itself, and a crash in the engine cannot take the kiosk down.
+class CommandSynthesizer : public SpeechSynthesizer {
+ public:
+  enum class Engine { kEspeakNg, kPiper };
+
+  // |default_voice| is used for requests without a voice of the engine's
+  // kind; piper needs one to run at all.
+  CommandSynthesizer(Engine engine, const std::string& executable,
+                     const std::string& default_voice, int timeout_ms);
+
+  // Disallow copy and assign.
+  CommandSynthesizer(const CommandSynthesizer&) = delete;
+  CommandSynthesizer& operator=(const CommandSynthesizer&) = delete;
+
+  const char* name() const override;
+  bool Synthesize(const SpeechRequest& request, std::vector<uint8_t>* wav,
+                  std::string* error) override;
+  void Cancel() override { cancelled_ = true; }
+
+ private:
+  std::vector<std::string> Arguments(const SpeechRequest& request) const;
+
+  const Engine engine_;
+  const std::string executable_;
+  const std::string default_voice_;
+  const int timeout_ms_;
+  std::atomic<bool> cancelled_{false};
+};
+
+// Full path of |name| on $PATH, or empty. Paths containing a slash are
+// only checked for being executable.
+std::string FindExecutable(const std::string& name);
+
+// Picks the engine for |engine| ("auto", "espeak-ng" or "piper"); "auto"
+// prefers piper when |default_voice| is an .onnx model. Returns null with
+// |error| set when the engine is not installed.
+std::unique_ptr<SpeechSynthesizer> CreateSpeechSynthesizer(
+    const std::string& engine, const std::string& default_voice,
+    int timeout_ms, std::string* error);
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_SPEECH_SYNTHESIZER_H_
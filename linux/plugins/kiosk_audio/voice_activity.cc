@@ -0,0 +1,89 @@
+#include "voice_activity.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace kiosk_audio {
+
+namespace {
+
+// Per-frame noise floor smoothing towards louder and quieter frames, and
+// while speech is going on.
+const double kFloorRise = 0.02;
+const double kFloorFall = 0.5;
+const double kFloorRiseInSpeech = 0.002;
+
+int MsToFrames(int ms, int frame_ms) {
+  return std::max(1, (ms + frame_ms - 1) / frame_ms);
+}
+
+}  // namespace
+
+VoiceActivityDetector::VoiceActivityDetector(const VadConfig& config)
+    : config_(config) {
+  config_.sample_rate = std::max(config_.sample_rate, 8000);
+  config_.frame_ms = std::min(std::max(config_.frame_ms, 10), 100);
+  frame_samples_ = config_.sample_rate * config_.frame_ms / 1000;
+  start_frames_ = MsToFrames(config_.start_ms, config_.frame_ms);
+  end_frames_ = MsToFrames(config_.end_silence_ms, config_.frame_ms);
+  max_frames_ = MsToFrames(config_.max_segment_ms, config_.frame_ms);
+}
+
+void VoiceActivityDetector::Reset() {
+  in_speech_ = false;
+  run_ = 0;
+  segment_frames_ = 0;
+}
+
+VadEvent VoiceActivityDetector::Process(const float* frame) {
+  double energy = 0;
+  int crossings = 0;
+  for (int i = 0; i < frame_samples_; ++i) {
+    energy += static_cast<double>(frame[i]) * frame[i];
+    if (i > 0 && (frame[i] >= 0) != (frame[i - 1] >= 0)) {
+      crossings++;
+    }
+  }
+  level_db_ = 10 * std::log10(energy / frame_samples_ + 1e-12);
+  const double zero_crossing_rate =
+      static_cast<double>(crossings) / frame_samples_;
+  if (!floor_valid_) {
+    noise_floor_db_ = level_db_;
+    floor_valid_ = true;
+  }
+
+  const double above_floor = level_db_ - noise_floor_db_;
+  const bool speech =
+      level_db_ > config_.min_level_dbfs &&
+      above_floor > config_.threshold_db &&
+      (zero_crossing_rate < config_.max_zero_crossing_rate ||
+       above_floor > 2 * config_.threshold_db);
+
+  if (level_db_ < noise_floor_db_) {
+    noise_floor_db_ += (level_db_ - noise_floor_db_) * kFloorFall;
+  } else {
+    noise_floor_db_ += (level_db_ - noise_floor_db_) *
+                       (speech ? kFloorRiseInSpeech : kFloorRise);
+  }
+
+  if (!in_speech_) {
+    run_ = speech ? run_ + 1 : 0;
+    if (run_ >= start_frames_) {
+      in_speech_ = true;
+      run_ = 0;
+      segment_frames_ = start_frames_;
+      return VadEvent::kSpeechStart;
+    }
+    return VadEvent::kNone;
+  }
+
+  segment_frames_++;
+  run_ = speech ? 0 : run_ + 1;
+  if (run_ >= end_frames_ || segment_frames_ >= max_frames_) {
+    Reset();
+    return VadEvent::kSpeechEnd;
+  }
+  return VadEvent::kNone;
+}
+
+}  // namespace kiosk_audio
@@ -0,0 +1,63 @@
+#ifndef PLUGINS_KIOSK_AUDIO_VOICE_ACTIVITY_H_
+#define PLUGINS_KIOSK_AUDIO_VOICE_ACTIVITY_H_
+
+namespace kiosk_audio {
+
+struct VadConfig {
+  int sample_rate = 16000;
+  int frame_ms = 20;
+  // A speech frame is this far above the tracked noise floor...
+  double threshold_db = 10;
+  // ...and above this absolute level.
+  double min_level_dbfs = -50;
+  // Zero crossings per sample above which a frame counts as hiss or fan
+  // noise rather than voiced speech, unless it is twice the threshold
+  // above the floor.
+  double max_zero_crossing_rate = 0.3;
+  // Speech needed before a segment starts, and silence before it ends.
+  int start_ms = 60;
+  int end_silence_ms = 700;
+  // Longer segments are ended regardless.
+  int max_segment_ms = 15000;
+};
+
+enum class VadEvent { kNone, kSpeechStart, kSpeechEnd };
+
+// Energy and zero-crossing voice activity detector, cheap enough to run on
+// every capture block. The noise floor follows the room: it drops at once
+// to quieter frames and creeps up under steady noise, so a running fan or
+// a TV in the background stops counting as speech after a few seconds.
+class VoiceActivityDetector {
+ public:
+  explicit VoiceActivityDetector(const VadConfig& config);
+
+  // Samples per Process() call.
+  int frame_samples() const { return frame_samples_; }
+  const VadConfig& config() const { return config_; }
+
+  // Classifies one frame of frame_samples() mono samples.
+  VadEvent Process(const float* frame);
+  void Reset();
+
+  bool in_speech() const { return in_speech_; }
+  double level_db() const { return level_db_; }
+  double noise_floor_db() const { return noise_floor_db_; }
+
+ private:
+  VadConfig config_;
+  int frame_samples_;
+  int start_frames_;
+  int end_frames_;
+  int max_frames_;
+
+  bool in_speech_ = false;
+  bool floor_valid_ = false;
+  double level_db_ = -100;
+  double noise_floor_db_ = -100;
+  int run_ = 0;
+  int segment_frames_ = 0;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_VOICE_ACTIVITY_H_
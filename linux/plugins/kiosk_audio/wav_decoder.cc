@@ -0,0 +1,131 @@
+#include "wav_decoder.h"
+
+#include <cstring>
+
+namespace kiosk_audio {
+
+namespace {
+
+const uint16_t kFormatPcm = 1;
+const uint16_t kFormatFloat = 3;
+const uint16_t kFormatExtensible = 0xFFFE;
+
+uint16_t ReadU16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadU32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+float ReadSample(const uint8_t* p, uint16_t format, int bits) {
+  if (format == kFormatFloat) {
+    float value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+  }
+  switch (bits) {
+    case 8:
+      return (static_cast<int>(p[0]) - 128) / 128.0f;
+    case 16:
+      return static_cast<int16_t>(ReadU16(p)) / 32768.0f;
+    case 24: {
+      const int32_t value =
+          static_cast<int32_t>(static_cast<uint32_t>(p[0]) << 8 |
+                               static_cast<uint32_t>(p[1]) << 16 |
+                               static_cast<uint32_t>(p[2]) << 24) >>
+          8;
+      return value / 8388608.0f;
+    }
+    default:
+      return static_cast<int32_t>(ReadU32(p)) / 2147483648.0f;
+  }
+}
+
+}  // namespace
+
+bool DecodeWav(const uint8_t* data, size_t size, int sample_rate,
+               int channels, PcmClip* clip, std::string* error) {
+  if (size < 12 || memcmp(data, "RIFF", 4) != 0 ||
+      memcmp(data + 8, "WAVE", 4) != 0) {
+    *error = "Not a WAV file";
+    return false;
+  }
+
+  uint16_t format = 0;
+  int source_channels = 0;
+  int source_rate = 0;
+  int bits = 0;
+  const uint8_t* pcm = nullptr;
+  size_t pcm_size = 0;
+  size_t offset = 12;
+  while (offset + 8 <= size) {
+    const uint8_t* chunk = data + offset;
+    const size_t chunk_size = ReadU32(chunk + 4);
+    const size_t available = size - offset - 8;
+    if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 &&
+        available >= 16) {
+      format = ReadU16(chunk + 8);
+      source_channels = ReadU16(chunk + 10);
+      source_rate = static_cast<int>(ReadU32(chunk + 12));
+      bits = ReadU16(chunk + 22);
+      if (format == kFormatExtensible && chunk_size >= 26 &&
+          available >= 26) {
+        // The sub-format GUID starts with the plain format tag.
+        format = ReadU16(chunk + 32);
+      }
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      pcm = chunk + 8;
+      // Streaming writers leave the size at 0 or 0xFFFFFFFF.
+      pcm_size = chunk_size == 0 || chunk_size > available ? available
+                                                           : chunk_size;
+      break;
+    }
+    // Chunks are padded to an even size.
+    offset += 8 + chunk_size + (chunk_size & 1);
+  }
+
+  const bool supported =
+      (format == kFormatPcm &&
+       (bits == 8 || bits == 16 || bits == 24 || bits == 32)) ||
+      (format == kFormatFloat && bits == 32);
+  if (pcm == nullptr || !supported || source_channels <= 0 ||
+      source_rate <= 0 || channels <= 0 || sample_rate <= 0) {
+    *error = "Unsupported WAV encoding";
+    return false;
+  }
+
+  const size_t frame_bytes = static_cast<size_t>(source_channels) * bits / 8;
+  const size_t source_frames = pcm_size / frame_bytes;
+  if (source_frames == 0) {
+    *error = "WAV file has no samples";
+    return false;
+  }
+  const double step = static_cast<double>(source_rate) / sample_rate;
+  const size_t frames =
+      static_cast<size_t>((source_frames - 1) / step) + 1;
+
+  clip->channels = channels;
+  clip->sample_rate = sample_rate;
+  clip->samples.assign(frames * channels, 0.0f);
+  for (size_t i = 0; i < frames; ++i) {
+    const double position = i * step;
+    const size_t first = static_cast<size_t>(position);
+    const size_t second = first + 1 < source_frames ? first + 1 : first;
+    const float t = static_cast<float>(position - first);
+    for (int c = 0; c < channels; ++c) {
+      const int source_channel = c < source_channels ? c : 0;
+      const size_t sample_offset = source_channel * bits / 8;
+      const float a =
+          ReadSample(pcm + first * frame_bytes + sample_offset, format, bits);
+      const float b =
+          ReadSample(pcm + second * frame_bytes + sample_offset, format, bits);
+      clip->samples[i * channels + c] = a + (b - a) * t;
+    }
+  }
+  return true;
+}
+
+}  // namespace kiosk_audio
@@ -0,0 +1,32 @@
+#ifndef PLUGINS_KIOSK_AUDIO_WAV_DECODER_H_
+#define PLUGINS_KIOSK_AUDIO_WAV_DECODER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kiosk_audio {
+
+// Decoded sound, ready to mix.
+struct PcmClip {
+  // Interleaved, |channels| samples per frame, -1..1.
+  std::vector<float> samples;
+  int channels = 0;
+  int sample_rate = 0;
+
+  size_t frames() const {
+    return channels > 0 ? samples.size() / channels : 0;
+  }
+};
+
+// Decodes a RIFF WAVE file (8/16/24/32-bit integer or 32-bit float PCM,
+// including WAVE_FORMAT_EXTENSIBLE) into |clip|, converted to |channels|
+// (mono is copied to both sides, extra channels are dropped) and
+// resampled linearly to |sample_rate|.
+bool DecodeWav(const uint8_t* data, size_t size, int sample_rate,
+               int channels, PcmClip* clip, std::string* error);
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_WAV_DECODER_H_
@@ -0,0 +1,704 @@
+#include "wyoming_client.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace kiosk_audio {
+
+namespace {
+
+// Latency samples kept for the percentiles.
+const size_t kLatencyWindow = 100;
+// A server that stops reading for this much audio is treated as gone.
+const size_t kMaxOutgoingBytes = 4 * 1024 * 1024;
+// Poll tick; bounds how late the response timeout and Stop() are noticed.
+const int kPollMs = 200;
+
+int64_t NowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+LatencySummary Summarize(const std::vector<double>& samples) {
+  LatencySummary summary;
+  if (samples.empty()) {
+    return summary;
+  }
+  std::vector<double> sorted(samples);
+  std::sort(sorted.begin(), sorted.end());
+  summary.count = samples.size();
+  summary.last_ms = samples.back();
+  summary.p50_ms = sorted[sorted.size() / 2];
+  summary.p95_ms = sorted[std::min(sorted.size() - 1,
+                                   sorted.size() * 95 / 100)];
+  summary.max_ms = sorted.back();
+  return summary;
+}
+
+std::string AudioFormatJson(int rate, int64_t timestamp_ms) {
+  return "{\"rate\":" + std::to_string(rate) +
+         ",\"width\":2,\"channels\":1,\"timestamp\":" +
+         std::to_string(timestamp_ms) + "}";
+}
+
+// Converts little-endian integer PCM of |width| bytes to float.
+void DecodePcm(const std::vector<uint8_t>& payload, int width,
+               std::vector<float>* samples) {
+  const size_t count = width > 0 ? payload.size() / width : 0;
+  samples->resize(count);
+  const uint8_t* p = payload.data();
+  for (size_t i = 0; i < count; ++i, p += width) {
+    switch (width) {
+      case 1:
+        (*samples)[i] = (static_cast<int>(p[0]) - 128) / 128.0f;
+        break;
+      case 2:
+        (*samples)[i] =
+            static_cast<int16_t>(p[0] | (p[1] << 8)) / 32768.0f;
+        break;
+      default:
+        (*samples)[i] =
+            static_cast<int32_t>(static_cast<uint32_t>(p[0]) |
+                                 static_cast<uint32_t>(p[1]) << 8 |
+                                 static_cast<uint32_t>(p[2]) << 16 |
+                                 static_cast<uint32_t>(p[3]) << 24) /
+            2147483648.0f;
+        break;
+    }
+  }
+}
+
+}  // namespace
+
+const char* WyomingStateName(WyomingState state) {
+  switch (state) {
+    case WyomingState::kStopped:
+      return "stopped";
+    case WyomingState::kConnecting:
+      return "connecting";
+    case WyomingState::kListening:
+      return "listening";
+    case WyomingState::kStreaming:
+      return "streaming";
+    case WyomingState::kWaiting:
+      return "waiting";
+    case WyomingState::kSpeaking:
+      return "speaking";
+  }
+  return "stopped";
+}
+
+WyomingClient::WyomingClient(std::unique_ptr<PcmSource> source,
+                             std::unique_ptr<PcmSink> sink,
+                             UpdateCallback callback)
+    : source_(std::move(source)),
+      sink_(std::move(sink)),
+      callback_(std::move(callback)),
+      wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+WyomingClient::~WyomingClient() {
+  Stop();
+  if (wake_fd_ >= 0) {
+    close(wake_fd_);
+  }
+}
+
+bool WyomingClient::Start(const WyomingConfig& config, std::string* error) {
+  Stop();
+  if (!source_) {
+    *error = "Built without an audio capture backend";
+    return false;
+  }
+  if (wake_fd_ < 0) {
+    *error = std::string("eventfd: ") + strerror(errno);
+    return false;
+  }
+  if (config.host.empty() || config.port <= 0 || config.port > 65535) {
+    *error = "Invalid Wyoming server address";
+    return false;
+  }
+  config_ = config;
+  config_.vad.sample_rate = source_->sample_rate();
+  vad_.reset(new VoiceActivityDetector(config_.vad));
+  frame_.assign(vad_->frame_samples(), 0.0f);
+  // Two seconds of slack for a client thread stuck in a slow send.
+  ring_.reset(new SampleRing(static_cast<size_t>(source_->sample_rate()) * 2));
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.last_error.clear();
+  }
+
+  running_ = true;
+  {
+    std::lock_guard<std::mutex> lock(playback_mutex_);
+    playback_running_ = true;
+    playback_queue_.clear();
+  }
+  playback_thread_ = std::thread(&WyomingClient::PlaybackLoop, this);
+  SampleRing* ring = ring_.get();
+  if (!source_->Start(
+          [this, ring](const float* samples, size_t count) {
+            ring->Write(samples, count);
+            Wake();
+          },
+          error)) {
+    Stop();
+    return false;
+  }
+  thread_ = std::thread(&WyomingClient::ClientLoop, this);
+  return true;
+}
+
+void WyomingClient::Stop() {
+  running_ = false;
+  if (source_) {
+    source_->Stop();
+  }
+  Wake();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  {
+    std::lock_guard<std::mutex> lock(playback_mutex_);
+    playback_running_ = false;
+    playback_queue_.clear();
+  }
+  playback_wake_.notify_all();
+  if (playback_thread_.joinable()) {
+    playback_thread_.join();
+  }
+  if (state_.load() != WyomingState::kStopped) {
+    SetState(WyomingState::kStopped);
+  }
+}
+
+WyomingStats WyomingClient::stats() const {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  WyomingStats stats = stats_;
+  stats.state = state_.load();
+  stats.connected = stats.state != WyomingState::kStopped &&
+                    stats.state != WyomingState::kConnecting;
+  stats.samples_dropped = ring_ ? ring_->dropped() : 0;
+  stats.transcript = Summarize(transcript_ms_);
+  stats.first_audio = Summarize(first_audio_ms_);
+  stats.heard = Summarize(heard_ms_);
+  return stats;
+}
+
+void WyomingClient::Wake() {
+  const uint64_t one = 1;
+  if (wake_fd_ >= 0 && write(wake_fd_, &one, sizeof(one)) < 0) {
+    // The counter only saturates if nobody has read it for ages.
+  }
+}
+
+bool WyomingClient::WaitForWake(int timeout_ms) {
+  const int64_t deadline = NowMicros() + timeout_ms * 1000LL;
+  while (running_.load()) {
+    const int64_t remaining_ms = (deadline - NowMicros()) / 1000;
+    if (remaining_ms <= 0) {
+      return true;
+    }
+    pollfd fd = {wake_fd_, POLLIN, 0};
+    // The microphone wakes us every block; only Stop() ends the wait.
+    poll(&fd, 1, static_cast<int>(std::min<int64_t>(remaining_ms, kPollMs)));
+    uint64_t count;
+    if (read(wake_fd_, &count, sizeof(count)) < 0) {
+      // Nothing pending.
+    }
+  }
+  return false;
+}
+
+void WyomingClient::ClientLoop() {
+  int delay_ms = config_.reconnect_min_ms;
+  while (running_.load()) {
+    SetState(WyomingState::kConnecting);
+    std::string error;
+    const int fd = Connect(&error);
+    if (fd >= 0) {
+      delay_ms = config_.reconnect_min_ms;
+      Session(fd);
+      close(fd);
+      if (!running_.load()) {
+        break;
+      }
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      stats_.reconnects++;
+    } else if (running_.load()) {
+      SetError(error);
+    }
+    SetState(WyomingState::kConnecting);
+    if (!WaitForWake(delay_ms)) {
+      break;
+    }
+    delay_ms = std::min(delay_ms * 2, config_.reconnect_max_ms);
+  }
+}
+
+int WyomingClient::Connect(std::string* error) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses = nullptr;
+  const std::string port = std::to_string(config_.port);
+  const int lookup =
+      getaddrinfo(config_.host.c_str(), port.c_str(), &hints, &addresses);
+  if (lookup != 0) {
+    *error = config_.host + ": " + gai_strerror(lookup);
+    return -1;
+  }
+
+  int connected = -1;
+  *error = "Connection to " + config_.host + ":" + port + " failed";
+  for (addrinfo* address = addresses; address != nullptr && connected < 0;
+       address = address->ai_next) {
+    const int fd = socket(address->ai_family,
+                          address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          address->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    int result = connect(fd, address->ai_addr, address->ai_addrlen);
+    if (result < 0 && errno == EINPROGRESS) {
+      const int64_t deadline =
+          NowMicros() + config_.connect_timeout_ms * 1000LL;
+      while (running_.load() && NowMicros() < deadline) {
+        pollfd poll_fd = {fd, POLLOUT, 0};
+        if (poll(&poll_fd, 1, kPollMs) > 0) {
+          int socket_error = 0;
+          socklen_t length = sizeof(socket_error);
+          getsockopt(fd, SOL_SOCKET, SO_ERROR, &socket_error, &length);
+          result = socket_error == 0 ? 0 : -1;
+          if (socket_error != 0) {
+            *error = config_.host + ":" + port + ": " +
+                     strerror(socket_error);
+          }
+          break;
+        }
+      }
+    }
+    if (result == 0) {
+      // Chunks are small and latency matters more than packet count.
+      const int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      connected = fd;
+    } else {
+      close(fd);
+    }
+  }
+  freeaddrinfo(addresses);
+  return connected;
+}
+
+void WyomingClient::Session(int socket_fd) {
+  socket_fd_ = socket_fd;
+  outgoing_.clear();
+  parser_.Reset();
+  vad_->Reset();
+  pre_roll_.clear();
+  frame_fill_ = 0;
+  ring_->Clear();
+  SetError(std::string());
+  SetState(WyomingState::kListening);
+
+  std::vector<uint8_t> buffer(64 * 1024);
+  while (running_.load()) {
+    pollfd fds[2] = {
+        {socket_fd, static_cast<short>(POLLIN | (outgoing_.empty() ? 0
+                                                                 : POLLOUT)),
+         0},
+        {wake_fd_, POLLIN, 0}};
+    if (poll(fds, 2, kPollMs) < 0 && errno != EINTR) {
+      SetError(std::string("poll: ") + strerror(errno));
+      break;
+    }
+    if (fds[1].revents & POLLIN) {
+      uint64_t count;
+      if (read(wake_fd_, &count, sizeof(count)) < 0) {
+        // Raced with another reader; nothing to do.
+      }
+    }
+    if (playback_done_.exchange(false) &&
+        state_.load() == WyomingState::kSpeaking) {
+      EndResponse();
+    }
+
+    ProcessMicrophone();
+
+    if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+      bool closed = false;
+      while (true) {
+        const ssize_t n = recv(socket_fd, buffer.data(), buffer.size(), 0);
+        if (n > 0) {
+          parser_.Feed(buffer.data(), static_cast<size_t>(n));
+          continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK &&
+                       errno != EINTR)) {
+          closed = true;
+        }
+        break;
+      }
+      WyomingEvent event;
+      while (parser_.Next(&event)) {
+        HandleEvent(event);
+      }
+      if (!parser_.error().empty()) {
+        SetError(parser_.error());
+        break;
+      }
+      if (closed) {
+        SetError("Wyoming server closed the connection");
+        break;
+      }
+    }
+    if (!FlushOutgoing()) {
+      break;
+    }
+
+    if (state_.load() == WyomingState::kWaiting &&
+        NowMicros() - speech_end_us_ > config_.response_timeout_ms * 1000LL) {
+      SetError("No response from the Wyoming server");
+      Notify({WyomingUpdate::Kind::kError, state_.load(),
+              "No response from the Wyoming server", 0});
+      SetState(WyomingState::kListening);
+    }
+  }
+  socket_fd_ = -1;
+}
+
+void WyomingClient::ProcessMicrophone() {
+  while (true) {
+    frame_fill_ += ring_->Read(&frame_[frame_fill_],
+                               frame_.size() - frame_fill_);
+    if (frame_fill_ < frame_.size()) {
+      break;
+    }
+    frame_fill_ = 0;
+    OnVadFrame(frame_.data());
+  }
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  stats_.noise_floor_db = vad_->noise_floor_db();
+}
+
+void WyomingClient::OnVadFrame(const float* frame) {
+  const WyomingState state = state_.load();
+  if (state != WyomingState::kListening &&
+      state != WyomingState::kStreaming) {
+    // One turn at a time, and the assistant must not hear its own reply.
+    return;
+  }
+  const VadEvent event = vad_->Process(frame);
+  const size_t count = frame_.size();
+
+  if (state == WyomingState::kListening) {
+    pre_roll_.emplace_back(frame, frame + count);
+    const size_t keep = std::max<size_t>(
+        1, config_.pre_roll_ms / std::max(config_.vad.frame_ms, 1));
+    while (pre_roll_.size() > keep) {
+      pre_roll_.pop_front();
+    }
+    if (event != VadEvent::kSpeechStart) {
+      return;
+    }
+    if (config_.pipeline) {
+      SendEvent("run-pipeline",
+                "{\"start_stage\":" + JsonQuote(config_.start_stage) +
+                    ",\"end_stage\":" + JsonQuote(config_.end_stage) +
+                    ",\"restart_on_end\":false}",
+                std::vector<uint8_t>());
+    } else {
+      SendEvent("transcribe",
+                config_.language.empty()
+                    ? std::string("{}")
+                    : "{\"language\":" + JsonQuote(config_.language) + "}",
+                std::vector<uint8_t>());
+    }
+    segment_samples_ = 0;
+    SendEvent("audio-start", AudioFormatJson(source_->sample_rate(), 0),
+              std::vector<uint8_t>());
+    for (const std::vector<float>& buffered : pre_roll_) {
+      SendAudioChunk(buffered.data(), buffered.size());
+    }
+    pre_roll_.clear();
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      stats_.segments++;
+    }
+    SetState(WyomingState::kStreaming);
+    return;
+  }
+
+  SendAudioChunk(frame, count);
+  if (event == VadEvent::kSpeechEnd) {
+    SendEvent("audio-stop",
+              "{\"timestamp\":" +
+                  std::to_string(segment_samples_ * 1000 /
+                                 source_->sample_rate()) +
+                  "}",
+              std::vector<uint8_t>());
+    speech_end_us_ = NowMicros();
+    response_audio_seen_ = false;
+    SetState(WyomingState::kWaiting);
+  }
+}
+
+void WyomingClient::SendAudioChunk(const float* frame, size_t count) {
+  pcm_.resize(count * 2);
+  for (size_t i = 0; i < count; ++i) {
+    const float clamped = std::min(1.0f, std::max(-1.0f, frame[i]));
+    const int16_t value = static_cast<int16_t>(std::lrint(clamped * 32767));
+    pcm_[i * 2] = static_cast<uint8_t>(value & 0xFF);
+    pcm_[i * 2 + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
+  }
+  const int64_t timestamp_ms = segment_samples_ * 1000 / source_->sample_rate();
+  SendEvent("audio-chunk",
+            AudioFormatJson(source_->sample_rate(), timestamp_ms), pcm_);
+  segment_samples_ += static_cast<int64_t>(count);
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  stats_.chunks_sent++;
+  stats_.bytes_sent += pcm_.size();
+}
+
+void WyomingClient::SendEvent(const std::string& type,
+                              const std::string& data,
+                              const std::vector<uint8_t>& payload) {
+  outgoing_ += EncodeWyomingEvent(type, data, payload.size());
+  outgoing_.append(reinterpret_cast<const char*>(payload.data()),
+                   payload.size());
+}
+
+bool WyomingClient::FlushOutgoing() {
+  while (!outgoing_.empty()) {
+    const ssize_t n = send(socket_fd_, outgoing_.data(), outgoing_.size(),
+                           MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (n > 0) {
+      outgoing_.erase(0, static_cast<size_t>(n));
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    SetError(std::string("send: ") + strerror(errno));
+    return false;
+  }
+  if (outgoing_.size() > kMaxOutgoingBytes) {
+    SetError("Wyoming server stopped reading");
+    return false;
+  }
+  return true;
+}
+
+void WyomingClient::HandleEvent(const WyomingEvent& event) {
+  if (event.type == "ping") {
+    SendEvent("pong", event.data, std::vector<uint8_t>());
+  } else if (event.type == "transcript") {
+    std::string text;
+    JsonGetString(event.data, "text", &text);
+    const double latency_ms =
+        speech_end_us_ > 0 ? (NowMicros() - speech_end_us_) / 1000.0 : 0;
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      stats_.last_transcript = text;
+      RecordLatency(&transcript_ms_, latency_ms);
+    }
+    Notify({WyomingUpdate::Kind::kTranscript, state_.load(), text,
+            latency_ms});
+    // Nothing else is coming unless the pipeline ends in speech.
+    if (state_.load() == WyomingState::kWaiting &&
+        (!config_.pipeline || config_.end_stage != "tts")) {
+      SetState(WyomingState::kListening);
+    }
+  } else if (event.type == "audio-start" || event.type == "audio-chunk") {
+    double rate = 22050;
+    double width = 2;
+    double channels = 1;
+    JsonGetNumber(event.data, "rate", &rate);
+    JsonGetNumber(event.data, "width", &width);
+    JsonGetNumber(event.data, "channels", &channels);
+    if (width != 1 && width != 2 && width != 4) {
+      SetError("Unsupported response sample width");
+      return;
+    }
+    if (state_.load() != WyomingState::kSpeaking) {
+      // A chunk without audio-start still opens the output.
+      PlaybackItem start;
+      start.kind = PlaybackItem::Kind::kStart;
+      start.rate = static_cast<int>(rate);
+      start.channels = std::max(1, static_cast<int>(channels));
+      playback_speech_end_us_ = speech_end_us_;
+      EnqueuePlayback(std::move(start));
+      SetState(WyomingState::kSpeaking);
+    }
+    if (event.type == "audio-chunk" && !event.payload.empty()) {
+      if (!response_audio_seen_ && speech_end_us_ > 0) {
+        response_audio_seen_ = true;
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        RecordLatency(&first_audio_ms_,
+                      (NowMicros() - speech_end_us_) / 1000.0);
+      }
+      PlaybackItem samples;
+      samples.kind = PlaybackItem::Kind::kSamples;
+      samples.channels = std::max(1, static_cast<int>(channels));
+      DecodePcm(event.payload, static_cast<int>(width), &samples.samples);
+      EnqueuePlayback(std::move(samples));
+    }
+  } else if (event.type == "audio-stop") {
+    if (state_.load() == WyomingState::kSpeaking) {
+      PlaybackItem stop;
+      stop.kind = PlaybackItem::Kind::kStop;
+      EnqueuePlayback(std::move(stop));
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      stats_.responses++;
+    }
+  } else if (event.type == "error") {
+    std::string text;
+    JsonGetString(event.data, "text", &text);
+    SetError("Wyoming: " + text);
+    Notify({WyomingUpdate::Kind::kError, state_.load(), text, 0});
+    if (state_.load() == WyomingState::kWaiting ||
+        state_.load() == WyomingState::kStreaming) {
+      vad_->Reset();
+      SetState(WyomingState::kListening);
+    }
+  }
+}
+
+void WyomingClient::EndResponse() {
+  // Whatever the microphone heard meanwhile is mostly the reply itself.
+  ring_->Clear();
+  frame_fill_ = 0;
+  pre_roll_.clear();
+  vad_->Reset();
+  speech_end_us_ = 0;
+  SetState(WyomingState::kListening);
+}
+
+void WyomingClient::SetState(WyomingState state) {
+  if (state_.exchange(state) != state) {
+    Notify({WyomingUpdate::Kind::kState, state, std::string(), 0});
+  }
+}
+
+void WyomingClient::EnqueuePlayback(PlaybackItem item) {
+  {
+    std::lock_guard<std::mutex> lock(playback_mutex_);
+    playback_queue_.push_back(std::move(item));
+  }
+  playback_wake_.notify_one();
+}
+
+void WyomingClient::PlaybackLoop() {
+  bool open = false;
+  bool first_samples = false;
+  int channels = 1;
+  std::unique_lock<std::mutex> lock(playback_mutex_);
+  while (true) {
+    playback_wake_.wait(lock, [this]() {
+      return !playback_running_ || !playback_queue_.empty();
+    });
+    if (!playback_running_) {
+      break;
+    }
+    PlaybackItem item = std::move(playback_queue_.front());
+    playback_queue_.pop_front();
+    lock.unlock();
+
+    std::string error;
+    switch (item.kind) {
+      case PlaybackItem::Kind::kStart:
+        if (open) {
+          sink_->Close();
+          open = false;
+        }
+        channels = item.channels;
+        first_samples = true;
+        if (!sink_) {
+          break;
+        }
+        // 20 ms blocks: the reply starts playing as soon as one arrives.
+        open = sink_->Open(item.rate, item.channels,
+                           std::max(item.rate / 50, 1), &error);
+        if (!open) {
+          SetError(error);
+        }
+        break;
+      case PlaybackItem::Kind::kSamples: {
+        // The first sample is heard one output latency after it is written.
+        const int64_t heard_us =
+            NowMicros() + (open ? sink_->latency_us() : 0);
+        if (open && !sink_->Write(item.samples.data(),
+                                  item.samples.size() / channels, &error)) {
+          SetError(error);
+          sink_->Close();
+          open = false;
+        }
+        if (first_samples && playback_speech_end_us_.load() > 0) {
+          first_samples = false;
+          const double latency_ms =
+              (heard_us - playback_speech_end_us_.load()) / 1000.0;
+          {
+            std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+            RecordLatency(&heard_ms_, latency_ms);
+          }
+          Notify({WyomingUpdate::Kind::kResponseAudio,
+                  WyomingState::kSpeaking, std::string(), latency_ms});
+        }
+        break;
+      }
+      case PlaybackItem::Kind::kStop:
+        if (open) {
+          // Drains, so the microphone opens again once the reply is over.
+          sink_->Close();
+          open = false;
+        }
+        playback_done_ = true;
+        Wake();
+        break;
+    }
+    lock.lock();
+  }
+  lock.unlock();
+  if (open) {
+    sink_->Close();
+  }
+}
+
+void WyomingClient::Notify(const WyomingUpdate& update) {
+  if (callback_) {
+    callback_(update);
+  }
+}
+
+void WyomingClient::RecordLatency(std::vector<double>* samples, double ms) {
+  samples->push_back(ms);
+  if (samples->size() > kLatencyWindow) {
+    samples->erase(samples->begin());
+  }
+}
+
+void WyomingClient::SetError(const std::string& error) {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  stats_.last_error = error;
+}
+
+}  // namespace kiosk_audio
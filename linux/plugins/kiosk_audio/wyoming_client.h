@@ -0,0 +1,209 @@
+#ifndef PLUGINS_KIOSK_AUDIO_WYOMING_CLIENT_H_
+#define PLUGINS_KIOSK_AUDIO_WYOMING_CLIENT_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "pcm_sink.h"
+#include "pcm_source.h"
+#include "sample_ring.h"
+#include "voice_activity.h"
+#include "wyoming_protocol.h"
+
+namespace kiosk_audio {
+
+struct WyomingConfig {
+  std::string host = "127.0.0.1";
+  int port = 10700;
+  // Send run-pipeline (Home Assistant style, from |start_stage| to
+  // |end_stage|) before each utterance; otherwise send transcribe and
+  // expect only a transcript back.
+  bool pipeline = true;
+  std::string start_stage = "asr";
+  std::string end_stage = "tts";
+  // Transcription language, empty for the server's default.
+  std::string language;
+  // Audio kept from before speech was detected, so the first syllable
+  // is not clipped.
+  int pre_roll_ms = 300;
+  // Give up on a response this long after the end of speech.
+  int response_timeout_ms = 30000;
+  int connect_timeout_ms = 3000;
+  int reconnect_min_ms = 500;
+  int reconnect_max_ms = 10000;
+  // |vad.sample_rate| is taken from the source; one audio-chunk is sent
+  // per VAD frame.
+  VadConfig vad;
+};
+
+enum class WyomingState {
+  kStopped,
+  kConnecting,
+  kListening,
+  // Speech detected; audio-chunk events are going out.
+  kStreaming,
+  // End of speech sent, nothing back yet.
+  kWaiting,
+  // Playing the response.
+  kSpeaking,
+};
+
+const char* WyomingStateName(WyomingState state);
+
+struct WyomingUpdate {
+  enum class Kind { kState, kTranscript, kResponseAudio, kError };
+  Kind kind = Kind::kState;
+  WyomingState state = WyomingState::kStopped;
+  // Transcript or error text.
+  std::string text;
+  // Since the end of speech: transcript arrival for kTranscript, first
+  // response audio heard for kResponseAudio.
+  double latency_ms = 0;
+};
+
+struct LatencySummary {
+  uint64_t count = 0;
+  double last_ms = 0;
+  double p50_ms = 0;
+  double p95_ms = 0;
+  double max_ms = 0;
+};
+
+struct WyomingStats {
+  WyomingState state = WyomingState::kStopped;
+  bool connected = false;
+  uint64_t reconnects = 0;
+  uint64_t segments = 0;
+  uint64_t chunks_sent = 0;
+  uint64_t bytes_sent = 0;
+  uint64_t responses = 0;
+  uint64_t samples_dropped = 0;
+  double noise_floor_db = 0;
+  // End of speech to transcript, to the first response audio arriving
+  // and to it being heard (arrival plus output latency).
+  LatencySummary transcript;
+  LatencySummary first_audio;
+  LatencySummary heard;
+  std::string last_transcript;
+  std::string last_error;
+};
+
+// Voice satellite speaking the Wyoming protocol over TCP.
+//
+// The microphone thread only copies samples into a lock-free ring and
+// pokes an eventfd. The client thread polls that and the socket: it runs
+// the VAD over the ring in 20 ms frames and frames audio-chunk events
+// straight onto the socket while speech lasts, so silence never leaves
+// the device. Response audio is handed to a playback thread as it
+// arrives and written to the sink without waiting for the whole reply.
+class WyomingClient {
+ public:
+  using UpdateCallback = std::function<void(const WyomingUpdate& update)>;
+
+  // |sink| may be null, in which case responses are timed but not played.
+  // |callback| runs on the client or playback thread.
+  WyomingClient(std::unique_ptr<PcmSource> source,
+                std::unique_ptr<PcmSink> sink, UpdateCallback callback);
+  ~WyomingClient();
+
+  // Disallow copy and assign.
+  WyomingClient(const WyomingClient&) = delete;
+  WyomingClient& operator=(const WyomingClient&) = delete;
+
+  // Connects in the background; restarts if already running.
+  bool Start(const WyomingConfig& config, std::string* error);
+  void Stop();
+  bool is_running() const { return running_.load(); }
+
+  WyomingStats stats() const;
+
+ private:
+  struct PlaybackItem {
+    enum class Kind { kStart, kSamples, kStop };
+    Kind kind;
+    int rate = 0;
+    int channels = 0;
+    std::vector<float> samples;
+  };
+
+  void ClientLoop();
+  // Runs one connection until it fails or the client stops.
+  void Session(int socket_fd);
+  int Connect(std::string* error);
+  bool WaitForWake(int timeout_ms);
+  void Wake();
+
+  // Client thread.
+  void ProcessMicrophone();
+  void OnVadFrame(const float* frame);
+  void SendAudioChunk(const float* frame, size_t count);
+  void SendEvent(const std::string& type, const std::string& data,
+                 const std::vector<uint8_t>& payload);
+  bool FlushOutgoing();
+  void HandleEvent(const WyomingEvent& event);
+  void SetState(WyomingState state);
+  void EndResponse();
+
+  // Playback thread.
+  void PlaybackLoop();
+  void EnqueuePlayback(PlaybackItem item);
+
+  void Notify(const WyomingUpdate& update);
+  void RecordLatency(std::vector<double>* samples, double ms);
+  void SetError(const std::string& error);
+
+  std::unique_ptr<PcmSource> source_;
+  std::unique_ptr<PcmSink> sink_;
+  UpdateCallback callback_;
+  WyomingConfig config_;
+
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+  // Written by the microphone and playback threads to wake the client.
+  int wake_fd_ = -1;
+  std::unique_ptr<SampleRing> ring_;
+
+  // Client thread only.
+  int socket_fd_ = -1;
+  std::string outgoing_;
+  WyomingParser parser_;
+  std::unique_ptr<VoiceActivityDetector> vad_;
+  std::vector<float> frame_;
+  size_t frame_fill_ = 0;
+  std::deque<std::vector<float>> pre_roll_;
+  // Samples sent since audio-start, for chunk timestamps.
+  int64_t segment_samples_ = 0;
+  int64_t speech_end_us_ = 0;
+  bool response_audio_seen_ = false;
+  std::vector<uint8_t> pcm_;
+
+  std::atomic<WyomingState> state_{WyomingState::kStopped};
+  // Set by the playback thread when a response finished playing.
+  std::atomic<bool> playback_done_{false};
+  // End of speech the playing response answers, for the heard latency.
+  std::atomic<int64_t> playback_speech_end_us_{0};
+
+  std::thread playback_thread_;
+  std::mutex playback_mutex_;
+  std::condition_variable playback_wake_;
+  std::deque<PlaybackItem> playback_queue_;
+  bool playback_running_ = false;
+
+  mutable std::mutex stats_mutex_;
+  WyomingStats stats_;
+  std::vector<double> transcript_ms_;
+  std::vector<double> first_audio_ms_;
+  std::vector<double> heard_ms_;
+};
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_WYOMING_CLIENT_H_
@@ -0,0 +1,365 @@
+#include "wyoming_protocol.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace kiosk_audio {
+
+namespace {
+
+// Wyoming protocol version sent in headers.
+const char kProtocolVersion[] = "1.5.2";
+// A header line longer than this means we lost framing.
+const size_t kMaxHeaderBytes = 64 * 1024;
+// Larger data or payloads are refused rather than buffered.
+const size_t kMaxEventBytes = 16 * 1024 * 1024;
+
+void SkipSpace(const std::string& json, size_t* pos) {
+  while (*pos < json.size() &&
+         (json[*pos] == ' ' || json[*pos] == '\t' || json[*pos] == '\n' ||
+          json[*pos] == '\r')) {
+    (*pos)++;
+  }
+}
+
+// Moves |pos| past the string starting at it (on the opening quote).
+bool SkipString(const std::string& json, size_t* pos) {
+  for (size_t i = *pos + 1; i < json.size(); ++i) {
+    if (json[i] == '\\') {
+      i++;
+    } else if (json[i] == '"') {
+      *pos = i + 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Moves |pos| past the value starting at it.
+bool SkipValue(const std::string& json, size_t* pos) {
+  if (*pos >= json.size()) {
+    return false;
+  }
+  if (json[*pos] == '"') {
+    return SkipString(json, pos);
+  }
+  if (json[*pos] == '{' || json[*pos] == '[') {
+    int depth = 0;
+    while (*pos < json.size()) {
+      const char c = json[*pos];
+      if (c == '"') {
+        if (!SkipString(json, pos)) {
+          return false;
+        }
+        continue;
+      }
+      if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        depth--;
+        if (depth == 0) {
+          (*pos)++;
+          return true;
+        }
+      }
+      (*pos)++;
+    }
+    return false;
+  }
+  // Number, true, false or null.
+  while (*pos < json.size() && json[*pos] != ',' && json[*pos] != '}' &&
+         json[*pos] != ']') {
+    (*pos)++;
+  }
+  return true;
+}
+
+// Finds the value of top-level member |key| as [begin, end).
+bool FindMember(const std::string& json, const char* key, size_t* begin,
+                size_t* end) {
+  size_t pos = 0;
+  SkipSpace(json, &pos);
+  if (pos >= json.size() || json[pos] != '{') {
+    return false;
+  }
+  pos++;
+  const size_t key_length = strlen(key);
+  while (true) {
+    SkipSpace(json, &pos);
+    if (pos >= json.size() || json[pos] != '"') {
+      return false;
+    }
+    const size_t key_start = pos + 1;
+    if (!SkipString(json, &pos)) {
+      return false;
+    }
+    const bool match = pos - 1 - key_start == key_length &&
+                       json.compare(key_start, key_length, key) == 0;
+    SkipSpace(json, &pos);
+    if (pos >= json.size() || json[pos] != ':') {
+      return false;
+    }
+    pos++;
+    SkipSpace(json, &pos);
+    const size_t value_start = pos;
+    if (!SkipValue(json, &pos)) {
+      return false;
+    }
+    if (match) {
+      *begin = value_start;
+      *end = pos;
+      while (*end > *begin && (json[*end - 1] == ' ' ||
+                               json[*end - 1] == '\n' ||
+                               json[*end - 1] == '\r' ||
+                               json[*end - 1] == '\t')) {
+        (*end)--;
+      }
+      return true;
+    }
+    SkipSpace(json, &pos);
+    if (pos >= json.size() || json[pos] != ',') {
+      return false;
+    }
+    pos++;
+  }
+}
+
+void AppendUtf8(uint32_t code, std::string* out) {
+  if (code < 0x80) {
+    out->push_back(static_cast<char>(code));
+  } else if (code < 0x800) {
+    out->push_back(static_cast<char>(0xC0 | (code >> 6)));
+    out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else if (code < 0x10000) {
+    out->push_back(static_cast<char>(0xE0 | (code >> 12)));
+    out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  } else {
+    out->push_back(static_cast<char>(0xF0 | (code >> 18)));
+    out->push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+    out->push_back(static_cast<char>(0x80 | (code & 0x3F)));
+  }
+}
+
+bool ParseHex4(const std::string& text, size_t pos, uint32_t* value) {
+  if (pos + 4 > text.size()) {
+    return false;
+  }
+  *value = 0;
+  for (size_t i = pos; i < pos + 4; ++i) {
+    const char c = text[i];
+    uint32_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return false;
+    }
+    *value = *value << 4 | digit;
+  }
+  return true;
+}
+
+}  // namespace
+
+std::string EncodeWyomingEvent(const std::string& type,
+                               const std::string& data,
+                               size_t payload_length) {
+  std::string header = "{\"type\":" + JsonQuote(type) +
+                       ",\"version\":\"" + kProtocolVersion + "\"";
+  if (!data.empty()) {
+    header += ",\"data_length\":" + std::to_string(data.size());
+  }
+  if (payload_length > 0) {
+    header += ",\"payload_length\":" + std::to_string(payload_length);
+  }
+  header += "}\n";
+  return header + data;
+}
+
+void WyomingParser::Feed(const uint8_t* bytes, size_t size) {
+  // Compact once the consumed prefix dominates.
+  if (offset_ > 0 && offset_ * 2 >= buffer_.size()) {
+    buffer_.erase(buffer_.begin(), buffer_.begin() + offset_);
+    offset_ = 0;
+  }
+  buffer_.insert(buffer_.end(), bytes, bytes + size);
+}
+
+void WyomingParser::Reset() {
+  buffer_.clear();
+  offset_ = 0;
+  error_.clear();
+}
+
+bool WyomingParser::Next(WyomingEvent* event) {
+  if (!error_.empty()) {
+    return false;
+  }
+  const uint8_t* start = buffer_.data() + offset_;
+  const size_t size = buffer_.size() - offset_;
+  const void* newline = memchr(start, '\n', size);
+  if (newline == nullptr) {
+    if (size > kMaxHeaderBytes) {
+      error_ = "Wyoming header too long";
+    }
+    return false;
+  }
+  const size_t header_length = static_cast<const uint8_t*>(newline) - start;
+  const std::string header(reinterpret_cast<const char*>(start),
+                           header_length);
+  std::string type;
+  if (!JsonGetString(header, "type", &type)) {
+    error_ = "Malformed Wyoming header";
+    return false;
+  }
+  double data_length = 0;
+  double payload_length = 0;
+  JsonGetNumber(header, "data_length", &data_length);
+  JsonGetNumber(header, "payload_length", &payload_length);
+  if (data_length < 0 || payload_length < 0 ||
+      data_length + payload_length > kMaxEventBytes) {
+    error_ = "Wyoming event too large";
+    return false;
+  }
+  const size_t data_size = static_cast<size_t>(data_length);
+  const size_t payload_size = static_cast<size_t>(payload_length);
+  if (size < header_length + 1 + data_size + payload_size) {
+    return false;
+  }
+
+  event->type = type;
+  const uint8_t* data = start + header_length + 1;
+  if (data_size > 0) {
+    event->data.assign(reinterpret_cast<const char*>(data), data_size);
+  } else if (!JsonGetRaw(header, "data", &event->data)) {
+    // Older servers put the data inline in the header.
+    event->data = "{}";
+  }
+  event->payload.assign(data + data_size, data + data_size + payload_size);
+  offset_ += header_length + 1 + data_size + payload_size;
+  return true;
+}
+
+bool JsonGetString(const std::string& json, const char* key,
+                   std::string* value) {
+  size_t begin;
+  size_t end;
+  if (!FindMember(json, key, &begin, &end) || json[begin] != '"') {
+    return false;
+  }
+  value->clear();
+  for (size_t i = begin + 1; i + 1 < end; ++i) {
+    const char c = json[i];
+    if (c != '\\') {
+      value->push_back(c);
+      continue;
+    }
+    const char escape = json[++i];
+    switch (escape) {
+      case 'n':
+        value->push_back('\n');
+        break;
+      case 't':
+        value->push_back('\t');
+        break;
+      case 'r':
+        value->push_back('\r');
+        break;
+      case 'b':
+        value->push_back('\b');
+        break;
+      case 'f':
+        value->push_back('\f');
+        break;
+      case 'u': {
+        uint32_t code;
+        if (!ParseHex4(json, i + 1, &code)) {
+          return false;
+        }
+        i += 4;
+        uint32_t low;
+        if (code >= 0xD800 && code < 0xDC00 && json[i + 1] == '\\' &&
+            json[i + 2] == 'u' && ParseHex4(json, i + 3, &low) &&
+            low >= 0xDC00 && low < 0xE000) {
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+          i += 6;
+        }
+        AppendUtf8(code, value);
+        break;
+      }
+      default:
+        value->push_back(escape);
+        break;
+    }
+  }
+  return true;
+}
+
+bool JsonGetNumber(const std::string& json, const char* key, double* value) {
+  size_t begin;
+  size_t end;
+  if (!FindMember(json, key, &begin, &end)) {
+    return false;
+  }
+  const std::string text = json.substr(begin, end - begin);
+  char* parsed_end = nullptr;
+  const double parsed = strtod(text.c_str(), &parsed_end);
+  if (parsed_end == text.c_str()) {
+    return false;
+  }
+  *value = parsed;
+  return true;
+}
+
+bool JsonGetRaw(const std::string& json, const char* key,
+                std::string* value) {
+  size_t begin;
+  size_t end;
+  if (!FindMember(json, key, &begin, &end) ||
+      (json[begin] != '{' && json[begin] != '[')) {
+    return false;
+  }
+  *value = json.substr(begin, end - begin);
+  return true;
+}
+
+std::string JsonQuote(const std::string& value) {
+  std::string out = "\"";
+  for (const char c : value) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out += escaped;
+        } else {
+          out.push_back(c);
+        }
+        break;
+    }
+  }
+  return out + "\"";
+}
+
+}  // namespace kiosk_audio
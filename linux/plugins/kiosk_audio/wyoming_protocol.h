@@ -0,0 +1,60 @@
+#ifndef PLUGINS_KIOSK_AUDIO_WYOMING_PROTOCOL_H_
+#define PLUGINS_KIOSK_AUDIO_WYOMING_PROTOCOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kiosk_audio {
+
+// One Wyoming event: a JSON header line, optional JSON data and an optional
+// binary payload (raw PCM for audio-chunk).
+struct WyomingEvent {
+  std::string type;
+  // JSON object text, "{}" when the event has no data.
+  std::string data;
+  std::vector<uint8_t> payload;
+};
+
+// Serializes an event header plus its data; the payload, if any, follows
+// on the wire as is. |data| is a JSON object or empty.
+std::string EncodeWyomingEvent(const std::string& type,
+                               const std::string& data,
+                               size_t payload_length);
+
+// Incremental reader for the event stream coming back from a server.
+class WyomingParser {
+ public:
+  WyomingParser() = default;
+
+  // Disallow copy and assign.
+  WyomingParser(const WyomingParser&) = delete;
+  WyomingParser& operator=(const WyomingParser&) = delete;
+
+  void Feed(const uint8_t* bytes, size_t size);
+  // Returns the next complete event. False when more bytes are needed or
+  // the stream is malformed, which error() then describes.
+  bool Next(WyomingEvent* event);
+  const std::string& error() const { return error_; }
+  void Reset();
+
+ private:
+  std::vector<uint8_t> buffer_;
+  size_t offset_ = 0;
+  std::string error_;
+};
+
+// Minimal accessors for the flat JSON objects Wyoming uses. They look at
+// top-level members of |json| only.
+bool JsonGetString(const std::string& json, const char* key,
+                   std::string* value);
+bool JsonGetNumber(const std::string& json, const char* key, double* value);
+// Raw text of a nested object or array member.
+bool JsonGetRaw(const std::string& json, const char* key, std::string* value);
+// |value| as a quoted, escaped JSON string.
+std::string JsonQuote(const std::string& value);
+
+}  // namespace kiosk_audio
+
+#endif  // PLUGINS_KIOSK_AUDIO_WYOMING_PROTOCOL_H_
@@ -0,0 +1,28 @@
+#ifndef FLUTTER_PLUGIN_KIOSK_MQTT_PLUGIN_H_
+#define FLUTTER_PLUGIN_KIOSK_MQTT_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_BEGIN_DECLS
+
+#ifdef FLUTTER_PLUGIN_IMPL
+#define FLUTTER_PLUGIN_EXPORT __attribute__((visibility("default")))
+#else
+#define FLUTTER_PLUGIN_EXPORT
+#endif
+
+typedef struct _KioskMqttPlugin KioskMqttPlugin;
+typedef struct {
+  GObjectClass parent_class;
+} KioskMqttPluginClass;
+
+FLUTTER_PLUGIN_EXPORT GType kiosk_mqtt_plugin_get_type();
+
+// Registers the native MQTT transport on the "com.ki.king_kiosk/mqtt"
+// method channel.
+FLUTTER_PLUGIN_EXPORT void kiosk_mqtt_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+G_END_DECLS
+
+#endif  // FLUTTER_PLUGIN_KIOSK_MQTT_PLUGIN_H_
@@ -0,0 +1,344 @@
+#include "json_reader.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <locale>
+#include <sstream>
+#include <utility>
+
+namespace kiosk_mqtt {
+
+namespace {
+
+// Deeper documents are rejected rather than risking the stack.
+const int kMaxDepth = 64;
+
+class Parser {
+ public:
+  explicit Parser(const std::string& text) : text_(text) {}
+
+  bool Parse(JsonValue* value, std::string* error) {
+    if (!ParseValue(value, 0)) {
+      *error = error_ + " at offset " + std::to_string(position_);
+      return false;
+    }
+    SkipSpace();
+    if (position_ != text_.size()) {
+      *error = "Trailing characters at offset " + std::to_string(position_);
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  bool Fail(const char* message) {
+    error_ = message;
+    return false;
+  }
+
+  void SkipSpace() {
+    while (position_ < text_.size()) {
+      const char c = text_[position_];
+      if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+        position_++;
+      } else if (c == '/' && position_ + 1 < text_.size() &&
+                 text_[position_ + 1] == '/') {
+        while (position_ < text_.size() && text_[position_] != '\n') {
+          position_++;
+        }
+      } else if (c == '/' && position_ + 1 < text_.size() &&
+                 text_[position_ + 1] == '*') {
+        const size_t end = text_.find("*/", position_ + 2);
+        position_ = end == std::string::npos ? text_.size() : end + 2;
+      } else {
+        break;
+      }
+    }
+  }
+
+  bool Consume(const char* literal) {
+    size_t i = 0;
+    while (literal[i] != '\0') {
+      if (position_ + i >= text_.size() ||
+          text_[position_ + i] != literal[i]) {
+        return false;
+      }
+      i++;
+    }
+    position_ += i;
+    return true;
+  }
+
+  bool ParseValue(JsonValue* value, int depth) {
+    if (depth > kMaxDepth) {
+      return Fail("JSON nested too deeply");
+    }
+    SkipSpace();
+    if (position_ >= text_.size()) {
+      return Fail("Unexpected end of JSON");
+    }
+    const char c = text_[position_];
+    if (c == '{') {
+      return ParseObject(value, depth);
+    }
+    if (c == '[') {
+      return ParseArray(value, depth);
+    }
+    if (c == '"') {
+      value->type = JsonValue::Type::kString;
+      return ParseString(&value->string_value);
+    }
+    if (Consume("true")) {
+      value->type = JsonValue::Type::kBool;
+      value->bool_value = true;
+      return true;
+    }
+    if (Consume("false")) {
+      value->type = JsonValue::Type::kBool;
+      value->bool_value = false;
+      return true;
+    }
+    if (Consume("null")) {
+      value->type = JsonValue::Type::kNull;
+      return true;
+    }
+    return ParseNumber(value);
+  }
+
+  bool ParseObject(JsonValue* value, int depth) {
+    value->type = JsonValue::Type::kObject;
+    position_++;
+    while (true) {
+      SkipSpace();
+      if (position_ < text_.size() && text_[position_] == '}') {
+        position_++;
+        return true;
+      }
+      if (position_ >= text_.size() || text_[position_] != '"') {
+        return Fail("Expected an object key");
+      }
+      value->object.emplace_back();
+      auto& member = value->object.back();
+      if (!ParseString(&member.first)) {
+        return false;
+      }
+      SkipSpace();
+      if (position_ >= text_.size() || text_[position_] != ':') {
+        return Fail("Expected ':'");
+      }
+      position_++;
+      if (!ParseValue(&member.second, depth + 1)) {
+        return false;
+      }
+      SkipSpace();
+      if (position_ < text_.size() && text_[position_] == ',') {
+        position_++;
+      } else if (position_ >= text_.size() || text_[position_] != '}') {
+        return Fail("Expected ',' or '}'");
+      }
+    }
+  }
+
+  bool ParseArray(JsonValue* value, int depth) {
+    value->type = JsonValue::Type::kArray;
+    position_++;
+    while (true) {
+      SkipSpace();
+      if (position_ < text_.size() && text_[position_] == ']') {
+        position_++;
+        return true;
+      }
+      value->array.emplace_back();
+      if (!ParseValue(&value->array.back(), depth + 1)) {
+        return false;
+      }
+      SkipSpace();
+      if (position_ < text_.size() && text_[position_] == ',') {
+        position_++;
+      } else if (position_ >= text_.size() || text_[position_] != ']') {
+        return Fail("Expected ',' or ']'");
+      }
+    }
+  }
+
+  bool ParseHex4(uint32_t* code) {
+    if (position_ + 4 > text_.size()) {
+      return Fail("Truncated \\u escape");
+    }
+    *code = 0;
+    for (int i = 0; i < 4; ++i) {
+      const char c = text_[position_++];
+      *code <<= 4;
+      if (c >= '0' && c <= '9') {
+        *code |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        *code |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        *code |= c - 'A' + 10;
+      } else {
+        return Fail("Invalid \\u escape");
+      }
+    }
+    return true;
+  }
+
+  static void AppendUtf8(uint32_t code, std::string* out) {
+    if (code < 0x80) {
+      out->push_back(static_cast<char>(code));
+    } else if (code < 0x800) {
+      out->push_back(static_cast<char>(0xc0 | code >> 6));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else if (code < 0x10000) {
+      out->push_back(static_cast<char>(0xe0 | code >> 12));
+      out->push_back(static_cast<char>(0x80 | (code >> 6 & 0x3f)));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    } else {
+      out->push_back(static_cast<char>(0xf0 | code >> 18));
+      out->push_back(static_cast<char>(0x80 | (code >> 12 & 0x3f)));
+      out->push_back(static_cast<char>(0x80 | (code >> 6 & 0x3f)));
+      out->push_back(static_cast<char>(0x80 | (code & 0x3f)));
+    }
+  }
+
+  bool ParseString(std::string* out) {
+    position_++;
+    while (position_ < text_.size()) {
+      const char c = text_[position_++];
+      if (c == '"') {
+        return true;
+      }
+      if (c != '\\') {
+        out->push_back(c);
+        continue;
+      }
+      if (position_ >= text_.size()) {
+        break;
+      }
+      const char escape = text_[position_++];
+      switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+          out->push_back(escape);
+          break;
+        case 'b':
+          out->push_back('\b');
+          break;
+        case 'f':
+          out->push_back('\f');
+          break;
+        case 'n':
+          out->push_back('\n');
+          break;
+        case 'r':
+          out->push_back('\r');
+          break;
+        case 't':
+          out->push_back('\t');
+          break;
+        case 'u': {
+          uint32_t code;
+          if (!ParseHex4(&code)) {
+            return false;
+          }
+          if (code >= 0xd800 && code < 0xdc00 && Consume("\\u")) {
+            uint32_t low;
+            if (!ParseHex4(&low)) {
+              return false;
+            }
+            if (low >= 0xdc00 && low < 0xe000) {
+              code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+            } else {
+              AppendUtf8(0xfffd, out);
+              code = low;
+            }
+          }
+          if (code >= 0xd800 && code < 0xe000) {
+            code = 0xfffd;
+          }
+          AppendUtf8(code, out);
+          break;
+        }
+        default:
+          return Fail("Invalid escape");
+      }
+    }
+    return Fail("Unterminated string");
+  }
+
+  bool ParseNumber(JsonValue* value) {
+    const size_t start = position_;
+    bool integral = true;
+    if (position_ < text_.size() && text_[position_] == '-') {
+      position_++;
+    }
+    while (position_ < text_.size()) {
+      const char c = text_[position_];
+      if (c >= '0' && c <= '9') {
+        position_++;
+      } else if (c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+        integral = false;
+        position_++;
+      } else {
+        break;
+      }
+    }
+    const std::string number = text_.substr(start, position_ - start);
+    if (number.empty() || number == "-") {
+      return Fail("Unexpected character");
+    }
+    if (integral) {
+      errno = 0;
+      char* end = nullptr;
+      const long long parsed = strtoll(number.c_str(), &end, 10);
+      if (errno == 0 && *end == '\0') {
+        value->type = JsonValue::Type::kInt;
+        value->int_value = parsed;
+        return true;
+      }
+    }
+    // strtod() follows the process locale, which GTK sets from the
+    // environment.
+    std::istringstream stream(number);
+    stream.imbue(std::locale::classic());
+    double parsed = 0;
+    stream >> parsed;
+    if (stream.fail() || !stream.eof()) {
+      return Fail("Invalid number");
+    }
+    value->type = JsonValue::Type::kDouble;
+    value->double_value = parsed;
+    return true;
+  }
+
+  const std::string& text_;
+  size_t position_ = 0;
+  std::string error_;
+};
+
+}  // namespace
+
+bool ParseJson(const std::string& text, JsonValue* value,
+               std::string* error) {
+  *value = JsonValue();
+  return Parser(text).Parse(value, error);
+}
+
+bool ParseCommandJson(const std::string& text, JsonValue* value,
+                      std::string* error) {
+  if (!ParseJson(text, value, error)) {
+    return false;
+  }
+  if (value->type == JsonValue::Type::kString) {
+    const std::string inner = value->string_value;
+    JsonValue nested;
+    std::string nested_error;
+    if (ParseJson(inner, &nested, &nested_error) &&
+        nested.type != JsonValue::Type::kString) {
+      *value = std::move(nested);
+    }
+  }
+  return true;
+}
+
+}  // namespace kiosk_mqtt
@@ -0,0 +1,37 @@
+#ifndef PLUGINS_KIOSK_MQTT_JSON_READER_H_
+#define PLUGINS_KIOSK_MQTT_JSON_READER_H_
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kiosk_mqtt {
+
+struct JsonValue {
+  enum class Type { kNull, kBool, kInt, kDouble, kString, kArray, kObject };
+
+  Type type = Type::kNull;
+  bool bool_value = false;
+  int64_t int_value = 0;
+  double double_value = 0;
+  std::string string_value;
+  std::vector<JsonValue> array;
+  // In document order.
+  std::vector<std::pair<std::string, JsonValue>> object;
+};
+
+// Parses |text| as JSON the way command payloads are written by hand in
+// Home Assistant automations: // and /* */ comments outside strings and
+// trailing commas are accepted. Numbers without a fraction or exponent
+// that fit 64 bits become kInt.
+bool ParseJson(const std::string& text, JsonValue* value, std::string* error);
+
+// ParseJson(), then once more if the document is a string holding JSON,
+// as when a payload was quoted twice on its way through a template.
+bool ParseCommandJson(const std::string& text, JsonValue* value,
+                      std::string* error);
+
+}  // namespace kiosk_mqtt
+
+#endif  // PLUGINS_KIOSK_MQTT_JSON_READER_H_
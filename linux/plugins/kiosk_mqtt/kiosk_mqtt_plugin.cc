@@ -0,0 +1,487 @@
+#include "include/kiosk_mqtt/kiosk_mqtt_plugin.h"
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "json_reader.h"
+#include "mqtt_client.h"
+
+#define KIOSK_MQTT_PLUGIN(obj)                                     \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), kiosk_mqtt_plugin_get_type(), \
+                              KioskMqttPlugin))
+
+namespace {
+
+const char kChannelName[] = "com.ki.king_kiosk/mqtt";
+const char kEventChannelName[] = "com.ki.king_kiosk/mqtt/events";
+const char kErrorCode[] = "MQTT_ERROR";
+
+FlValue* lookup(FlValue* args, const char* key, FlValueType type) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  FlValue* value = fl_value_lookup_string(args, key);
+  return value != nullptr && fl_value_get_type(value) == type ? value
+                                                              : nullptr;
+}
+
+int64_t lookup_int(FlValue* args, const char* key, int64_t fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_INT);
+  return value != nullptr ? fl_value_get_int(value) : fallback;
+}
+
+bool lookup_bool(FlValue* args, const char* key, bool fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_BOOL);
+  return value != nullptr ? fl_value_get_bool(value) : fallback;
+}
+
+std::string lookup_string(FlValue* args, const char* key,
+                          const char* fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_STRING);
+  return value != nullptr ? fl_value_get_string(value) : fallback;
+}
+
+// A payload sent as a String or as raw bytes.
+std::string lookup_payload(FlValue* args) {
+  FlValue* value = lookup(args, "payload", FL_VALUE_TYPE_UINT8_LIST);
+  if (value != nullptr) {
+    return std::string(
+        reinterpret_cast<const char*>(fl_value_get_uint8_list(value)),
+        fl_value_get_length(value));
+  }
+  return lookup_string(args, "payload", "");
+}
+
+std::vector<kiosk_mqtt::RateRule> rate_rules_from_value(FlValue* list) {
+  std::vector<kiosk_mqtt::RateRule> rules;
+  if (list == nullptr) {
+    return rules;
+  }
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* entry = fl_value_get_list_value(list, i);
+    kiosk_mqtt::RateRule rule;
+    rule.filter = lookup_string(entry, "filter", "");
+    rule.min_interval_ms =
+        static_cast<int>(lookup_int(entry, "intervalMs", 0));
+    if (!rule.filter.empty() && rule.min_interval_ms > 0) {
+      rules.push_back(rule);
+    }
+  }
+  return rules;
+}
+
+kiosk_mqtt::MqttConfig mqtt_config_from_args(FlValue* args) {
+  kiosk_mqtt::MqttConfig config;
+  config.host = lookup_string(args, "host", "");
+  config.port = static_cast<int>(lookup_int(args, "port", config.port));
+  kiosk_mqtt::ConnectOptions& connect = config.connect;
+  connect.protocol_version = static_cast<int>(
+      lookup_int(args, "protocolVersion", connect.protocol_version));
+  connect.client_id = lookup_string(args, "clientId", "");
+  connect.username = lookup_string(args, "username", "");
+  connect.password = lookup_string(args, "password", "");
+  connect.keep_alive_s = static_cast<int>(
+      lookup_int(args, "keepAliveSeconds", connect.keep_alive_s));
+  connect.will_topic = lookup_string(args, "willTopic", "");
+  connect.will_payload = lookup_string(args, "willPayload", "offline");
+  connect.will_retain = lookup_bool(args, "willRetain", connect.will_retain);
+  config.birth_payload =
+      lookup_string(args, "birthPayload", config.birth_payload.c_str());
+  config.linger_ms =
+      static_cast<int>(lookup_int(args, "lingerMs", config.linger_ms));
+  config.max_inflight =
+      static_cast<int>(lookup_int(args, "maxInflight", config.max_inflight));
+  config.queue.max_messages = static_cast<size_t>(lookup_int(
+      args, "maxQueuedMessages",
+      static_cast<int64_t>(config.queue.max_messages)));
+  config.queue.max_bytes = static_cast<size_t>(
+      lookup_int(args, "maxQueuedBytes",
+                 static_cast<int64_t>(config.queue.max_bytes)));
+  config.queue.drop_newest =
+      lookup_bool(args, "dropNewest", config.queue.drop_newest);
+  config.queue.rules =
+      rate_rules_from_value(lookup(args, "rateLimits", FL_VALUE_TYPE_LIST));
+  return config;
+}
+
+kiosk_mqtt::OutgoingMessage outgoing_from_args(FlValue* args) {
+  kiosk_mqtt::OutgoingMessage message;
+  message.topic = lookup_string(args, "topic", "");
+  message.payload = lookup_payload(args);
+  message.qos = static_cast<int>(lookup_int(args, "qos", 0));
+  message.retain = lookup_bool(args, "retain", false);
+  return message;
+}
+
+FlValue* json_to_value(const kiosk_mqtt::JsonValue& json) {
+  switch (json.type) {
+    case kiosk_mqtt::JsonValue::Type::kNull:
+      return fl_value_new_null();
+    case kiosk_mqtt::JsonValue::Type::kBool:
+      return fl_value_new_bool(json.bool_value);
+    case kiosk_mqtt::JsonValue::Type::kInt:
+      return fl_value_new_int(json.int_value);
+    case kiosk_mqtt::JsonValue::Type::kDouble:
+      return fl_value_new_float(json.double_value);
+    case kiosk_mqtt::JsonValue::Type::kString:
+      return fl_value_new_string_sized(json.string_value.data(),
+                                       json.string_value.size());
+    case kiosk_mqtt::JsonValue::Type::kArray: {
+      FlValue* list = fl_value_new_list();
+      for (const kiosk_mqtt::JsonValue& item : json.array) {
+        fl_value_append_take(list, json_to_value(item));
+      }
+      return list;
+    }
+    case kiosk_mqtt::JsonValue::Type::kObject: {
+      FlValue* map = fl_value_new_map();
+      for (const auto& member : json.object) {
+        fl_value_set_string_take(map, member.first.c_str(),
+                                 json_to_value(member.second));
+      }
+      return map;
+    }
+  }
+  return fl_value_new_null();
+}
+
+// Whether |payload| may be a JSON document, judged by its first
+// non-blank character, so plain sensor values are not parsed.
+bool looks_like_json(const std::string& payload) {
+  for (char c : payload) {
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      continue;
+    }
+    return c == '{' || c == '[' || c == '"' || c == '/';
+  }
+  return false;
+}
+
+FlValue* incoming_to_value(const kiosk_mqtt::IncomingMessage& message) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "topic",
+                           fl_value_new_string(message.topic.c_str()));
+  if (g_utf8_validate(message.payload.data(),
+                      static_cast<long>(message.payload.size()), nullptr)) {
+    fl_value_set_string_take(
+        map, "payload",
+        fl_value_new_string_sized(message.payload.data(),
+                                  message.payload.size()));
+  } else {
+    fl_value_set_string_take(
+        map, "payload",
+        fl_value_new_uint8_list(
+            reinterpret_cast<const uint8_t*>(message.payload.data()),
+            message.payload.size()));
+  }
+  fl_value_set_string_take(map, "qos", fl_value_new_int(message.qos));
+  fl_value_set_string_take(map, "retain", fl_value_new_bool(message.retain));
+  // Decoded here, on the client thread, so the UI isolate receives maps
+  // instead of running jsonDecode itself.
+  if (looks_like_json(message.payload)) {
+    kiosk_mqtt::JsonValue json;
+    std::string error;
+    if (kiosk_mqtt::ParseCommandJson(message.payload, &json, &error)) {
+      fl_value_set_string_take(map, "json", json_to_value(json));
+    }
+  }
+  return map;
+}
+
+FlValue* queue_stats_to_value(const kiosk_mqtt::PublishQueueStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "queued",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.queued)));
+  fl_value_set_string_take(map, "queuedBytes",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.queued_bytes)));
+  fl_value_set_string_take(map, "deferred",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.deferred)));
+  fl_value_set_string_take(map, "highWater",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.high_water)));
+  fl_value_set_string_take(map, "enqueued",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.enqueued)));
+  fl_value_set_string_take(map, "coalesced",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.coalesced)));
+  fl_value_set_string_take(map, "rateLimited",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.rate_limited)));
+  fl_value_set_string_take(map, "dropped",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.dropped)));
+  return map;
+}
+
+FlValue* mqtt_stats_to_value(const kiosk_mqtt::MqttStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(
+      map, "state",
+      fl_value_new_string(kiosk_mqtt::MqttStateName(stats.state)));
+  fl_value_set_string_take(map, "connects",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.connects)));
+  fl_value_set_string_take(map, "messagesIn",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.messages_in)));
+  fl_value_set_string_take(map, "messagesOut",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.messages_out)));
+  fl_value_set_string_take(map, "bytesIn",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.bytes_in)));
+  fl_value_set_string_take(map, "bytesOut",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.bytes_out)));
+  fl_value_set_string_take(map, "writes",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.writes)));
+  fl_value_set_string_take(map, "resent",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.resent)));
+  fl_value_set_string_take(map, "inflight", fl_value_new_int(stats.inflight));
+  fl_value_set_string_take(map, "unsentBytes",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.unsent_bytes)));
+  fl_value_set_string_take(map, "backpressure",
+                           fl_value_new_bool(stats.backpressure));
+  fl_value_set_string_take(map, "pingRttMs",
+                           fl_value_new_float(stats.ping_rtt_ms));
+  fl_value_set_string_take(map, "queue", queue_stats_to_value(stats.queue));
+  if (!stats.last_error.empty()) {
+    fl_value_set_string_take(map, "error",
+                             fl_value_new_string(stats.last_error.c_str()));
+  }
+  return map;
+}
+
+FlValue* mqtt_update_to_value(const kiosk_mqtt::MqttUpdate& update) {
+  FlValue* event = fl_value_new_map();
+  if (update.kind == kiosk_mqtt::MqttUpdate::Kind::kMessages) {
+    fl_value_set_string_take(event, "type", fl_value_new_string("messages"));
+    FlValue* messages = fl_value_new_list();
+    for (const kiosk_mqtt::IncomingMessage& message : update.messages) {
+      fl_value_append_take(messages, incoming_to_value(message));
+    }
+    fl_value_set_string_take(event, "messages", messages);
+    return event;
+  }
+  fl_value_set_string_take(event, "type", fl_value_new_string("state"));
+  fl_value_set_string_take(
+      event, "state",
+      fl_value_new_string(kiosk_mqtt::MqttStateName(update.state)));
+  if (!update.error.empty()) {
+    fl_value_set_string_take(event, "error",
+                             fl_value_new_string(update.error.c_str()));
+  }
+  return event;
+}
+
+}  // namespace
+
+struct _KioskMqttPlugin {
+  GObject parent_instance;
+
+  kiosk_mqtt::MqttClient* client;
+  FlEventChannel* event_channel;
+  gboolean listening;
+  // Events built on the client thread, sent from the main loop in order.
+  std::mutex* event_mutex;
+  std::vector<FlValue*>* events;
+  std::atomic<bool>* event_pending;
+};
+
+G_DEFINE_TYPE(KioskMqttPlugin, kiosk_mqtt_plugin, g_object_get_type())
+
+static gboolean deliver_events(gpointer user_data) {
+  KioskMqttPlugin* self = KIOSK_MQTT_PLUGIN(user_data);
+  self->event_pending->store(false);
+  std::vector<FlValue*> events;
+  {
+    std::lock_guard<std::mutex> lock(*self->event_mutex);
+    events.swap(*self->events);
+  }
+  for (FlValue* event : events) {
+    if (self->listening) {
+      fl_event_channel_send(self->event_channel, event, nullptr, nullptr);
+    }
+    fl_value_unref(event);
+  }
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Runs on the client thread.
+static void on_mqtt_update(KioskMqttPlugin* self,
+                           const kiosk_mqtt::MqttUpdate& update) {
+  FlValue* event = mqtt_update_to_value(update);
+  {
+    std::lock_guard<std::mutex> lock(*self->event_mutex);
+    self->events->push_back(event);
+  }
+  if (!self->event_pending->exchange(true)) {
+    g_idle_add(deliver_events, g_object_ref(self));
+  }
+}
+
+static FlMethodErrorResponse* listen_cb(FlEventChannel* channel,
+                                        FlValue* args, gpointer user_data) {
+  KIOSK_MQTT_PLUGIN(user_data)->listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* cancel_cb(FlEventChannel* channel,
+                                        FlValue* args, gpointer user_data) {
+  KIOSK_MQTT_PLUGIN(user_data)->listening = FALSE;
+  return nullptr;
+}
+
+static void handle_connect(KioskMqttPlugin* self, FlMethodCall* method_call,
+                           FlValue* args) {
+  const kiosk_mqtt::MqttConfig config = mqtt_config_from_args(args);
+  if (config.connect.client_id.empty()) {
+    fl_method_call_respond_error(method_call, kErrorCode,
+                                 "A client id is required", nullptr,
+                                 nullptr);
+    return;
+  }
+  std::string error;
+  if (!self->client->Start(config, &error)) {
+    fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                 nullptr, nullptr);
+    return;
+  }
+  fl_method_call_respond_success(method_call, nullptr, nullptr);
+}
+
+static void handle_publish_batch(KioskMqttPlugin* self,
+                                 FlMethodCall* method_call, FlValue* args) {
+  FlValue* list = lookup(args, "messages", FL_VALUE_TYPE_LIST);
+  std::vector<kiosk_mqtt::OutgoingMessage> messages;
+  if (list != nullptr) {
+    messages.reserve(fl_value_get_length(list));
+    for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+      kiosk_mqtt::OutgoingMessage message =
+          outgoing_from_args(fl_value_get_list_value(list, i));
+      if (!message.topic.empty()) {
+        messages.push_back(std::move(message));
+      }
+    }
+  }
+  const size_t dropped = self->client->PublishBatch(std::move(messages));
+  g_autoptr(FlValue) value = fl_value_new_int(static_cast<int64_t>(dropped));
+  fl_method_call_respond_success(method_call, value, nullptr);
+}
+
+static void kiosk_mqtt_plugin_handle_method_call(KioskMqttPlugin* self,
+                                                 FlMethodCall* method_call) {
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  if (strcmp(method, "connect") == 0) {
+    handle_connect(self, method_call, args);
+  } else if (strcmp(method, "disconnect") == 0) {
+    // The queue drains in the background so a final status publish goes
+    // out without blocking the main loop.
+    self->client->Disconnect(
+        static_cast<int>(lookup_int(args, "lingerMs", 1000)));
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "publish") == 0) {
+    kiosk_mqtt::OutgoingMessage message = outgoing_from_args(args);
+    if (message.topic.empty()) {
+      fl_method_call_respond_error(method_call, kErrorCode,
+                                   "A topic is required", nullptr, nullptr);
+      return;
+    }
+    g_autoptr(FlValue) value =
+        fl_value_new_bool(self->client->Publish(std::move(message)));
+    fl_method_call_respond_success(method_call, value, nullptr);
+  } else if (strcmp(method, "publishBatch") == 0) {
+    handle_publish_batch(self, method_call, args);
+  } else if (strcmp(method, "subscribe") == 0) {
+    self->client->Subscribe(lookup_string(args, "topic", ""),
+                            static_cast<int>(lookup_int(args, "qos", 0)));
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "unsubscribe") == 0) {
+    self->client->Unsubscribe(lookup_string(args, "topic", ""));
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "setRateLimits") == 0) {
+    self->client->SetRateRules(
+        rate_rules_from_value(lookup(args, "rules", FL_VALUE_TYPE_LIST)));
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "getInfo") == 0) {
+    g_autoptr(FlValue) stats = mqtt_stats_to_value(self->client->stats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+  } else {
+    fl_method_call_respond_not_implemented(method_call, nullptr);
+  }
+}
+
+static void kiosk_mqtt_plugin_dispose(GObject* object) {
+  KioskMqttPlugin* self = KIOSK_MQTT_PLUGIN(object);
+  // Joins the client thread, the only producer of events.
+  delete self->client;
+  self->client = nullptr;
+  if (self->events != nullptr) {
+    for (FlValue* event : *self->events) {
+      fl_value_unref(event);
+    }
+  }
+  delete self->events;
+  self->events = nullptr;
+  delete self->event_mutex;
+  self->event_mutex = nullptr;
+  delete self->event_pending;
+  self->event_pending = nullptr;
+  g_clear_object(&self->event_channel);
+  G_OBJECT_CLASS(kiosk_mqtt_plugin_parent_class)->dispose(object);
+}
+
+static void kiosk_mqtt_plugin_class_init(KioskMqttPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = kiosk_mqtt_plugin_dispose;
+}
+
+static void kiosk_mqtt_plugin_init(KioskMqttPlugin* self) {
+  self->event_mutex = new std::mutex();
+  self->events = new std::vector<FlValue*>();
+  self->event_pending = new std::atomic<bool>(false);
+  self->client = new kiosk_mqtt::MqttClient(
+      [self](kiosk_mqtt::MqttUpdate update) { on_mqtt_update(self, update); });
+}
+
+static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
+                           gpointer user_data) {
+  KioskMqttPlugin* plugin = KIOSK_MQTT_PLUGIN(user_data);
+  kiosk_mqtt_plugin_handle_method_call(plugin, method_call);
+}
+
+void kiosk_mqtt_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  KioskMqttPlugin* plugin = KIOSK_MQTT_PLUGIN(
+      g_object_new(kiosk_mqtt_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  plugin->event_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           kEventChannelName, FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->event_channel, listen_cb,
+                                       cancel_cb, plugin, nullptr);
+
+  g_object_unref(plugin);
+}
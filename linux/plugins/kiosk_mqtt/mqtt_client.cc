@@ -0,0 +1,761 @@
+#include "mqtt_client.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+
+namespace kiosk_mqtt {
+
+namespace {
+
+// Poll tick while connecting; bounds how late Stop() is noticed.
+const int kPollMs = 200;
+// Longest epoll_wait(), as a backstop for timers.
+const int kMaxWaitMs = 5000;
+// Bytes read per wakeup before giving the queue a turn.
+const size_t kMaxReadPerWake = 1 << 20;
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string ConnackError(int version, int code) {
+  if (version == kMqtt5) {
+    return "Broker refused the connection (reason " + std::to_string(code) +
+           ")";
+  }
+  switch (code) {
+    case 1:
+      return "Broker does not support MQTT 3.1.1";
+    case 2:
+      return "Broker rejected the client id";
+    case 3:
+      return "Broker unavailable";
+    case 4:
+      return "Bad user name or password";
+    case 5:
+      return "Not authorized";
+  }
+  return "Broker refused the connection (code " + std::to_string(code) + ")";
+}
+
+}  // namespace
+
+const char* MqttStateName(MqttState state) {
+  switch (state) {
+    case MqttState::kStopped:
+      return "stopped";
+    case MqttState::kConnecting:
+      return "connecting";
+    case MqttState::kConnected:
+      return "connected";
+  }
+  return "stopped";
+}
+
+MqttClient::MqttClient(UpdateCallback callback)
+    : callback_(std::move(callback)),
+      epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      queue_(PublishQueueConfig()) {
+  if (epoll_fd_ >= 0 && wake_fd_ >= 0) {
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+  }
+}
+
+MqttClient::~MqttClient() {
+  Stop(0);
+  if (wake_fd_ >= 0) {
+    close(wake_fd_);
+  }
+  if (epoll_fd_ >= 0) {
+    close(epoll_fd_);
+  }
+}
+
+bool MqttClient::Start(const MqttConfig& config, std::string* error) {
+  Stop(0);
+  if (epoll_fd_ < 0 || wake_fd_ < 0) {
+    *error = std::string("epoll: ") + strerror(errno);
+    return false;
+  }
+  if (config.host.empty() || config.port <= 0 || config.port > 65535) {
+    *error = "Invalid MQTT broker address";
+    return false;
+  }
+  config_ = config;
+  if (config_.connect.protocol_version != kMqtt5) {
+    config_.connect.protocol_version = kMqtt311;
+  }
+  config_.connect.will_qos = std::min(config_.connect.will_qos, 1);
+  config_.max_inflight = std::max(config_.max_inflight, 1);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.set_config(config_.queue);
+    stats_.last_error.clear();
+  }
+  running_ = true;
+  thread_ = std::thread(&MqttClient::ClientLoop, this);
+  return true;
+}
+
+void MqttClient::Stop(int linger_ms) {
+  if (!thread_.joinable()) {
+    return;
+  }
+  if (running_.load()) {
+    Disconnect(linger_ms);
+  }
+  thread_.join();
+  inflight_.clear();
+  std::lock_guard<std::mutex> lock(mutex_);
+  queue_.Clear();
+  subscribe_pending_.clear();
+  unsubscribe_pending_.clear();
+}
+
+void MqttClient::Disconnect(int linger_ms) {
+  stop_deadline_us_ = NowUs() + linger_ms * 1000LL;
+  running_ = false;
+  Wake();
+}
+
+bool MqttClient::Publish(OutgoingMessage message) {
+  std::vector<OutgoingMessage> messages;
+  messages.push_back(std::move(message));
+  return PublishBatch(std::move(messages)) == 0;
+}
+
+size_t MqttClient::PublishBatch(std::vector<OutgoingMessage> messages) {
+  const int64_t now_us = NowUs();
+  size_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!queue_.has_ready()) {
+      ready_since_us_ = now_us;
+    }
+    for (OutgoingMessage& message : messages) {
+      message.qos = std::min(std::max(message.qos, 0), 1);
+      if (!queue_.Push(std::move(message), now_us)) {
+        dropped++;
+      }
+    }
+  }
+  Wake();
+  return dropped;
+}
+
+void MqttClient::Subscribe(const std::string& filter, int qos) {
+  qos = std::min(std::max(qos, 0), 1);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscriptions_[filter] = qos;
+    subscribe_pending_.emplace_back(filter, qos);
+  }
+  Wake();
+}
+
+void MqttClient::Unsubscribe(const std::string& filter) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (subscriptions_.erase(filter) == 0) {
+      return;
+    }
+    unsubscribe_pending_.push_back(filter);
+  }
+  Wake();
+}
+
+void MqttClient::SetRateRules(const std::vector<RateRule>& rules) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_.queue.rules = rules;
+    queue_.set_config(config_.queue);
+  }
+  Wake();
+}
+
+MqttStats MqttClient::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MqttStats stats = stats_;
+  stats.queue = queue_.stats();
+  return stats;
+}
+
+void MqttClient::Wake() {
+  // One eventfd write per wakeup however many publishes land before it.
+  if (wake_pending_.exchange(true)) {
+    return;
+  }
+  const uint64_t one = 1;
+  if (wake_fd_ >= 0 && write(wake_fd_, &one, sizeof(one)) < 0) {
+    // The counter only saturates if nobody has read it for ages.
+  }
+}
+
+void MqttClient::DrainWake() {
+  wake_pending_ = false;
+  uint64_t count;
+  if (read(wake_fd_, &count, sizeof(count)) < 0) {
+    // Nothing pending.
+  }
+}
+
+bool MqttClient::WaitForWake(int timeout_ms) {
+  const int64_t deadline = NowUs() + timeout_ms * 1000LL;
+  while (running_.load()) {
+    const int64_t remaining_ms = (deadline - NowUs()) / 1000;
+    if (remaining_ms <= 0) {
+      return true;
+    }
+    epoll_event event;
+    // Publishes wake us too; only Stop() ends the wait.
+    if (epoll_wait(epoll_fd_, &event, 1,
+                   static_cast<int>(std::min<int64_t>(remaining_ms,
+                                                      kMaxWaitMs))) > 0) {
+      DrainWake();
+    }
+  }
+  return false;
+}
+
+void MqttClient::ClientLoop() {
+  int delay_ms = config_.reconnect_min_ms;
+  while (running_.load()) {
+    SetState(MqttState::kConnecting, std::string());
+    std::string error;
+    const int fd = Connect(&error);
+    if (fd >= 0) {
+      if (Session(fd)) {
+        delay_ms = config_.reconnect_min_ms;
+      }
+      close(fd);
+    } else if (running_.load()) {
+      SetError(error);
+    }
+    if (!running_.load()) {
+      break;
+    }
+    SetState(MqttState::kConnecting, stats().last_error);
+    if (!WaitForWake(delay_ms)) {
+      break;
+    }
+    delay_ms = std::min(delay_ms * 2, config_.reconnect_max_ms);
+  }
+  SetState(MqttState::kStopped, std::string());
+}
+
+int MqttClient::Connect(std::string* error) {
+  addrinfo hints;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* addresses = nullptr;
+  const std::string port = std::to_string(config_.port);
+  const int lookup =
+      getaddrinfo(config_.host.c_str(), port.c_str(), &hints, &addresses);
+  if (lookup != 0) {
+    *error = config_.host + ": " + gai_strerror(lookup);
+    return -1;
+  }
+
+  int connected = -1;
+  *error = "Connection to " + config_.host + ":" + port + " failed";
+  for (addrinfo* address = addresses; address != nullptr && connected < 0;
+       address = address->ai_next) {
+    const int fd = socket(address->ai_family,
+                          address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          address->ai_protocol);
+    if (fd < 0) {
+      continue;
+    }
+    int result = connect(fd, address->ai_addr, address->ai_addrlen);
+    if (result < 0 && errno == EINPROGRESS) {
+      const int64_t deadline = NowUs() + config_.connect_timeout_ms * 1000LL;
+      while (running_.load() && NowUs() < deadline) {
+        pollfd poll_fd = {fd, POLLOUT, 0};
+        if (poll(&poll_fd, 1, kPollMs) > 0) {
+          int socket_error = 0;
+          socklen_t length = sizeof(socket_error);
+          getsockopt(fd, SOL_SOCKET, SO_ERROR, &socket_error, &length);
+          result = socket_error == 0 ? 0 : -1;
+          if (socket_error != 0) {
+            *error = config_.host + ":" + port + ": " +
+                     strerror(socket_error);
+          }
+          break;
+        }
+      }
+    }
+    if (result == 0) {
+      // Batching happens in user space; Nagle would only add delay.
+      const int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      connected = fd;
+    } else {
+      close(fd);
+    }
+  }
+  freeaddrinfo(addresses);
+  return connected;
+}
+
+bool MqttClient::Session(int socket_fd) {
+  socket_fd_ = socket_fd;
+  connected_ = false;
+  outgoing_.clear();
+  outgoing_offset_ = 0;
+  reader_.reset(new PacketReader(config_.connect.protocol_version,
+                                 config_.max_packet_bytes));
+  ping_sent_us_ = 0;
+
+  epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN | EPOLLRDHUP;
+  event.data.fd = socket_fd;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket_fd, &event);
+  want_write_ = false;
+
+  const int64_t start_us = NowUs();
+  EncodeConnect(config_.connect, &outgoing_);
+  connect_deadline_us_ = start_us + config_.connect_timeout_ms * 1000LL;
+  last_send_us_ = last_receive_us_ = start_us;
+
+  bool accepted = false;
+  bool disconnect_sent = false;
+  std::string error;
+  std::vector<uint8_t> buffer(64 * 1024);
+  std::vector<IncomingMessage> incoming;
+  while (true) {
+    int64_t now_us = NowUs();
+    const bool stopping = !running_.load();
+    if (stopping) {
+      // Flush what is queued, then say goodbye so the will is not sent.
+      if (!connected_ || now_us >= stop_deadline_us_.load() ||
+          (disconnect_sent && outgoing_offset_ == outgoing_.size())) {
+        break;
+      }
+    }
+
+    epoll_event events[2];
+    const int count =
+        epoll_wait(epoll_fd_, events, 2, NextTimeoutMs(now_us));
+    if (count < 0 && errno != EINTR) {
+      error = std::string("epoll_wait: ") + strerror(errno);
+      break;
+    }
+    bool readable = false;
+    for (int i = 0; i < count; ++i) {
+      if (events[i].data.fd == wake_fd_) {
+        DrainWake();
+      } else if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP |
+                                     EPOLLERR)) {
+        readable = true;
+      }
+    }
+
+    if (readable) {
+      bool closed = false;
+      size_t total = 0;
+      while (total < kMaxReadPerWake) {
+        const ssize_t n = recv(socket_fd, buffer.data(), buffer.size(), 0);
+        if (n > 0) {
+          reader_->Feed(buffer.data(), static_cast<size_t>(n));
+          total += static_cast<size_t>(n);
+          continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK &&
+                       errno != EINTR)) {
+          closed = true;
+        }
+        break;
+      }
+      now_us = NowUs();
+      if (total > 0) {
+        last_receive_us_ = now_us;
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes_in += total;
+      }
+      Packet packet;
+      int result;
+      while ((result = reader_->Next(&packet)) == 1) {
+        if (!HandlePacket(packet, &incoming, &error)) {
+          break;
+        }
+        accepted = accepted || connected_;
+      }
+      if (!incoming.empty()) {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          stats_.messages_in += incoming.size();
+        }
+        MqttUpdate update;
+        update.kind = MqttUpdate::Kind::kMessages;
+        update.state = MqttState::kConnected;
+        update.messages.swap(incoming);
+        callback_(std::move(update));
+      }
+      if (result < 0) {
+        error = reader_->error();
+        break;
+      }
+      if (!error.empty()) {
+        break;
+      }
+      if (closed) {
+        error = "Broker closed the connection";
+        break;
+      }
+    }
+
+    if (!connected_) {
+      if (now_us >= connect_deadline_us_) {
+        error = "No CONNACK from the broker";
+        break;
+      }
+    } else {
+      const bool drained = FillOutgoing(now_us, stopping);
+      if (stopping && drained && !disconnect_sent) {
+        EncodeDisconnect(config_.connect.protocol_version, &outgoing_);
+        disconnect_sent = true;
+      }
+      const int64_t keep_alive_us = config_.connect.keep_alive_s * 1000000LL;
+      if (keep_alive_us > 0) {
+        if (ping_sent_us_ != 0 && now_us - ping_sent_us_ > keep_alive_us) {
+          error = "Broker stopped answering pings";
+          break;
+        }
+        if (ping_sent_us_ == 0 &&
+            (now_us - last_send_us_ >= keep_alive_us * 3 / 4 ||
+             now_us - last_receive_us_ >= keep_alive_us)) {
+          EncodePingreq(&outgoing_);
+          ping_sent_us_ = now_us;
+        }
+      }
+    }
+    if (!Flush(&error)) {
+      break;
+    }
+  }
+
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket_fd, nullptr);
+  socket_fd_ = -1;
+  connected_ = false;
+  if (!error.empty()) {
+    SetError(error);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.unsent_bytes = 0;
+  stats_.backpressure = false;
+  return accepted;
+}
+
+bool MqttClient::HandlePacket(const Packet& packet,
+                              std::vector<IncomingMessage>* incoming,
+                              std::string* error) {
+  const int version = config_.connect.protocol_version;
+  switch (packet.type) {
+    case PacketType::kConnack:
+      if (connected_) {
+        *error = "Unexpected CONNACK";
+        return false;
+      }
+      if (packet.reason_code != 0) {
+        *error = ConnackError(version, packet.reason_code);
+        return false;
+      }
+      OnConnack(NowUs());
+      return true;
+    case PacketType::kPublish: {
+      if (packet.qos == 1) {
+        EncodeAck(PacketType::kPuback, packet.packet_id, &outgoing_);
+      } else if (packet.qos == 2) {
+        // Only if a broker ignores the granted QoS; a resend after a lost
+        // PUBREC may then be delivered twice.
+        EncodeAck(PacketType::kPubrec, packet.packet_id, &outgoing_);
+      }
+      IncomingMessage message;
+      message.topic = packet.topic;
+      message.payload = packet.payload;
+      message.qos = packet.qos;
+      message.retain = packet.retain;
+      incoming->push_back(std::move(message));
+      return true;
+    }
+    case PacketType::kPuback:
+      inflight_.erase(packet.packet_id);
+      return true;
+    case PacketType::kPubrel:
+      EncodeAck(PacketType::kPubcomp, packet.packet_id, &outgoing_);
+      return true;
+    case PacketType::kSuback:
+      for (uint8_t code : packet.granted) {
+        if (code >= 0x80) {
+          SetError("Broker refused a subscription");
+        }
+      }
+      return true;
+    case PacketType::kPingresp:
+      if (ping_sent_us_ != 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.ping_rtt_ms = (NowUs() - ping_sent_us_) / 1000.0;
+      }
+      ping_sent_us_ = 0;
+      return true;
+    case PacketType::kDisconnect:
+      *error = "Broker disconnected (reason " +
+               std::to_string(packet.reason_code) + ")";
+      return false;
+    default:
+      return true;
+  }
+}
+
+void MqttClient::OnConnack(int64_t now_us) {
+  connected_ = true;
+  const int version = config_.connect.protocol_version;
+  std::vector<std::pair<std::string, int>> filters;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.connects++;
+    // A fresh session: everything subscribed so far, in one packet.
+    filters.assign(subscriptions_.begin(), subscriptions_.end());
+    subscribe_pending_.clear();
+    unsubscribe_pending_.clear();
+  }
+  if (!filters.empty()) {
+    EncodeSubscribe(version, NextPacketId(), filters, &outgoing_);
+  }
+  // Unacknowledged publishes from the last connection go first.
+  for (auto& entry : inflight_) {
+    EncodePublish(version, entry.second.message.topic,
+                  entry.second.message.payload, 1,
+                  entry.second.message.retain, true, entry.first,
+                  &outgoing_);
+    entry.second.sent_us = now_us;
+  }
+  if (!config_.connect.will_topic.empty() &&
+      !config_.birth_payload.empty()) {
+    OutgoingMessage birth;
+    birth.topic = config_.connect.will_topic;
+    birth.payload = config_.birth_payload;
+    birth.qos = 1;
+    birth.retain = true;
+    EncodeTracked(std::move(birth), false, now_us);
+  }
+  SetState(MqttState::kConnected, std::string());
+}
+
+bool MqttClient::FillOutgoing(int64_t now_us, bool flush_all) {
+  const int version = config_.connect.protocol_version;
+  std::vector<std::pair<std::string, int>> subscribe;
+  std::vector<std::string> unsubscribe;
+  bool drained = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    subscribe.swap(subscribe_pending_);
+    unsubscribe.swap(unsubscribe_pending_);
+    const size_t unsent = outgoing_.size() - outgoing_offset_;
+    stats_.backpressure = unsent >= config_.high_watermark_bytes;
+    const int64_t due_us = queue_.NextDueUs();
+    const bool lingered =
+        flush_all || now_us - ready_since_us_ >= config_.linger_ms * 1000LL ||
+        queue_.stats().queued_bytes >= config_.write_batch_bytes;
+    if (!stats_.backpressure &&
+        ((queue_.has_ready() && lingered) ||
+         (due_us >= 0 && due_us <= now_us))) {
+      const size_t slots =
+          static_cast<size_t>(std::max<int>(
+              0, config_.max_inflight - static_cast<int>(inflight_.size())));
+      queue_.Pop(now_us, config_.write_batch_bytes, slots, &batch_);
+      // Leftovers from a full batch go out on the next turn.
+      ready_since_us_ = now_us - config_.linger_ms * 1000LL;
+    }
+    drained = !queue_.has_ready();
+  }
+
+  if (!subscribe.empty()) {
+    EncodeSubscribe(version, NextPacketId(), subscribe, &outgoing_);
+  }
+  if (!unsubscribe.empty()) {
+    EncodeUnsubscribe(version, NextPacketId(), unsubscribe, &outgoing_);
+  }
+  uint64_t resent = 0;
+  for (auto& entry : inflight_) {
+    if (now_us - entry.second.sent_us >= config_.ack_timeout_ms * 1000LL) {
+      EncodePublish(version, entry.second.message.topic,
+                    entry.second.message.payload, 1,
+                    entry.second.message.retain, true, entry.first,
+                    &outgoing_);
+      entry.second.sent_us = now_us;
+      resent++;
+    }
+  }
+  const size_t published = batch_.size();
+  for (OutgoingMessage& message : batch_) {
+    if (message.qos > 0) {
+      EncodeTracked(std::move(message), false, now_us);
+    } else {
+      EncodePublish(version, message.topic, message.payload, 0,
+                    message.retain, false, 0, &outgoing_);
+    }
+  }
+  batch_.clear();
+  if (published > 0 || resent > 0) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.messages_out += published;
+    stats_.resent += resent;
+  }
+  return drained;
+}
+
+void MqttClient::EncodeTracked(OutgoingMessage message, bool dup,
+                               int64_t now_us) {
+  const uint16_t id = NextPacketId();
+  EncodePublish(config_.connect.protocol_version, message.topic,
+                message.payload, 1, message.retain, dup, id, &outgoing_);
+  Inflight& entry = inflight_[id];
+  entry.message = std::move(message);
+  entry.sent_us = now_us;
+}
+
+uint16_t MqttClient::NextPacketId() {
+  // Zero is not a valid id, and ids still awaiting PUBACK are skipped.
+  do {
+    last_packet_id_++;
+  } while (last_packet_id_ == 0 || inflight_.count(last_packet_id_) > 0);
+  return last_packet_id_;
+}
+
+bool MqttClient::Flush(std::string* error) {
+  size_t written = 0;
+  uint64_t writes = 0;
+  while (outgoing_offset_ < outgoing_.size()) {
+    const ssize_t n =
+        send(socket_fd_, outgoing_.data() + outgoing_offset_,
+             outgoing_.size() - outgoing_offset_, MSG_NOSIGNAL);
+    if (n > 0) {
+      outgoing_offset_ += static_cast<size_t>(n);
+      written += static_cast<size_t>(n);
+      writes++;
+      continue;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    *error = std::string("send: ") + strerror(errno);
+    return false;
+  }
+  if (outgoing_offset_ == outgoing_.size()) {
+    outgoing_.clear();
+    outgoing_offset_ = 0;
+  } else if (outgoing_offset_ > outgoing_.size() / 2) {
+    outgoing_.erase(0, outgoing_offset_);
+    outgoing_offset_ = 0;
+  }
+
+  // Ask for writability only while something is stuck.
+  const bool want_write = !outgoing_.empty();
+  if (want_write != want_write_) {
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLRDHUP | (want_write ? EPOLLOUT : 0u);
+    event.data.fd = socket_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, socket_fd_, &event);
+    want_write_ = want_write;
+  }
+
+  if (written > 0) {
+    last_send_us_ = NowUs();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.bytes_out += written;
+  stats_.writes += writes;
+  stats_.unsent_bytes = outgoing_.size() - outgoing_offset_;
+  stats_.inflight = static_cast<int>(inflight_.size());
+  return true;
+}
+
+int MqttClient::NextTimeoutMs(int64_t now_us) const {
+  int64_t next_us = now_us + kMaxWaitMs * 1000LL;
+  if (!running_.load()) {
+    next_us = std::min<int64_t>(next_us, stop_deadline_us_.load());
+  }
+  if (!connected_) {
+    next_us = std::min<int64_t>(next_us, connect_deadline_us_);
+  } else {
+    const int64_t keep_alive_us = config_.connect.keep_alive_s * 1000000LL;
+    if (keep_alive_us > 0) {
+      next_us = std::min<int64_t>(next_us, ping_sent_us_ != 0
+                                      ? ping_sent_us_ + keep_alive_us + 1
+                                      : std::min(last_send_us_ +
+                                                     keep_alive_us * 3 / 4,
+                                                 last_receive_us_ +
+                                                     keep_alive_us));
+    }
+    for (const auto& entry : inflight_) {
+      next_us = std::min<int64_t>(next_us, entry.second.sent_us +
+                                      config_.ack_timeout_ms * 1000LL);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    const bool can_send =
+        outgoing_.size() - outgoing_offset_ < config_.high_watermark_bytes;
+    if (can_send && queue_.has_ready() &&
+        static_cast<int>(inflight_.size()) < config_.max_inflight) {
+      next_us = std::min<int64_t>(next_us,
+                         ready_since_us_ + config_.linger_ms * 1000LL);
+    }
+    const int64_t due_us = queue_.NextDueUs();
+    if (can_send && due_us >= 0) {
+      next_us = std::min<int64_t>(next_us, due_us);
+    }
+    if (!subscribe_pending_.empty() || !unsubscribe_pending_.empty()) {
+      next_us = now_us;
+    }
+  }
+  // Rounded up, so a timer is never polled for early.
+  return static_cast<int>(std::max<int64_t>(0, next_us - now_us + 999) /
+                          1000);
+}
+
+void MqttClient::SetState(MqttState state, const std::string& error) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stats_.state == state && error.empty()) {
+      return;
+    }
+    stats_.state = state;
+  }
+  MqttUpdate update;
+  update.kind = MqttUpdate::Kind::kState;
+  update.state = state;
+  update.error = error;
+  callback_(std::move(update));
+}
+
+void MqttClient::SetError(const std::string& error) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.last_error = error;
+}
+
+}  // namespace kiosk_mqtt
@@ -0,0 +1,199 @@
+#ifndef PLUGINS_KIOSK_MQTT_MQTT_CLIENT_H_
+#define PLUGINS_KIOSK_MQTT_MQTT_CLIENT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mqtt_packet.h"
+#include "publish_queue.h"
+
+namespace kiosk_mqtt {
+
+struct MqttConfig {
+  std::string host;
+  int port = 1883;
+  // Client id, credentials, keepalive, protocol level and last will.
+  ConnectOptions connect;
+  // Published retained on the will topic after every CONNACK, so the
+  // broker shows the device online again after a reconnect.
+  std::string birth_payload = "online";
+  int connect_timeout_ms = 5000;
+  int reconnect_min_ms = 500;
+  int reconnect_max_ms = 30000;
+  // Publishes arriving within this long of the first one waiting go out in
+  // the same socket write.
+  int linger_ms = 2;
+  // Payload bytes taken from the queue per socket write.
+  size_t write_batch_bytes = 64 * 1024;
+  // Encoded bytes the kernel has not accepted yet. Above this the queue is
+  // left alone, so a slow broker fills it and its drop policy applies,
+  // rather than an unbounded send buffer.
+  size_t high_watermark_bytes = 256 * 1024;
+  // QoS 1 publishes awaiting PUBACK, and when they are sent again.
+  int max_inflight = 32;
+  int ack_timeout_ms = 10000;
+  size_t max_packet_bytes = 4 << 20;
+  PublishQueueConfig queue;
+};
+
+enum class MqttState { kStopped, kConnecting, kConnected };
+
+const char* MqttStateName(MqttState state);
+
+struct IncomingMessage {
+  std::string topic;
+  std::string payload;
+  int qos = 0;
+  bool retain = false;
+};
+
+struct MqttUpdate {
+  enum class Kind { kState, kMessages };
+  Kind kind = Kind::kState;
+  MqttState state = MqttState::kStopped;
+  // kState: why the connection was lost, if it was.
+  std::string error;
+  // kMessages: everything that arrived in one read from the socket.
+  std::vector<IncomingMessage> messages;
+};
+
+struct MqttStats {
+  MqttState state = MqttState::kStopped;
+  uint64_t connects = 0;
+  uint64_t messages_in = 0;
+  uint64_t messages_out = 0;
+  uint64_t bytes_in = 0;
+  uint64_t bytes_out = 0;
+  // send() calls that wrote something; messages_out / writes is the
+  // batching achieved.
+  uint64_t writes = 0;
+  uint64_t resent = 0;
+  int inflight = 0;
+  // Encoded bytes waiting for the socket.
+  size_t unsent_bytes = 0;
+  // The queue is being held back by a slow socket.
+  bool backpressure = false;
+  double ping_rtt_ms = 0;
+  PublishQueueStats queue;
+  std::string last_error;
+};
+
+// MQTT 3.1.1 / 5 client on its own thread.
+//
+// Publish() only appends to the queue and pokes an eventfd; the client
+// thread waits in epoll on the socket and that eventfd, drains the queue
+// into one buffer per wakeup and writes it with as few send() calls as the
+// socket allows. Incoming publishes are acknowledged on the client thread
+// and handed over in batches. QoS 2 is downgraded to QoS 1 both ways.
+class MqttClient {
+ public:
+  using UpdateCallback = std::function<void(MqttUpdate update)>;
+
+  // |callback| runs on the client thread.
+  explicit MqttClient(UpdateCallback callback);
+  ~MqttClient();
+
+  // Disallow copy and assign.
+  MqttClient(const MqttClient&) = delete;
+  MqttClient& operator=(const MqttClient&) = delete;
+
+  // Connects in the background and keeps reconnecting; restarts if
+  // already running. Subscriptions are kept across restarts.
+  bool Start(const MqttConfig& config, std::string* error);
+  // Sends what is queued and a DISCONNECT, waiting up to |linger_ms|.
+  void Stop(int linger_ms);
+  // Like Stop() but returns at once; the thread finishes on its own and
+  // is joined by the next Start() or Stop().
+  void Disconnect(int linger_ms);
+
+  // Returns false if the queue dropped the message.
+  bool Publish(OutgoingMessage message);
+  // Queues several publishes with one wakeup. Returns how many were
+  // dropped.
+  size_t PublishBatch(std::vector<OutgoingMessage> messages);
+  void Subscribe(const std::string& filter, int qos);
+  void Unsubscribe(const std::string& filter);
+  void SetRateRules(const std::vector<RateRule>& rules);
+
+  MqttStats stats() const;
+
+ private:
+  struct Inflight {
+    OutgoingMessage message;
+    int64_t sent_us = 0;
+  };
+
+  void ClientLoop();
+  int Connect(std::string* error);
+  // Runs one connection until it fails or the client stops. Returns
+  // whether the broker accepted it.
+  bool Session(int socket_fd);
+  bool WaitForWake(int timeout_ms);
+  void Wake();
+  void DrainWake();
+
+  // Client thread.
+  // Returns false when the connection must be dropped.
+  bool HandlePacket(const Packet& packet,
+                    std::vector<IncomingMessage>* incoming,
+                    std::string* error);
+  void OnConnack(int64_t now_us);
+  // Appends subscription changes, resends and queued publishes to
+  // |outgoing_|. |flush_all| skips the linger, for shutdown. Returns
+  // whether nothing is left ready in the queue.
+  bool FillOutgoing(int64_t now_us, bool flush_all);
+  void EncodeTracked(OutgoingMessage message, bool dup, int64_t now_us);
+  uint16_t NextPacketId();
+  // Writes |outgoing_| until the socket would block.
+  bool Flush(std::string* error);
+  // Milliseconds until the next timer, for epoll_wait().
+  int NextTimeoutMs(int64_t now_us) const;
+  void SetState(MqttState state, const std::string& error);
+  void SetError(const std::string& error);
+
+  const UpdateCallback callback_;
+  MqttConfig config_;
+  std::atomic<bool> running_{false};
+  std::thread thread_;
+  int epoll_fd_ = -1;
+  int wake_fd_ = -1;
+  std::atomic<bool> wake_pending_{false};
+  // Deadline for the graceful shutdown in Stop().
+  std::atomic<int64_t> stop_deadline_us_{0};
+
+  mutable std::mutex mutex_;
+  PublishQueue queue_;
+  // Oldest ready publish not yet taken, for |linger_ms|.
+  int64_t ready_since_us_ = 0;
+  std::map<std::string, int> subscriptions_;
+  std::vector<std::pair<std::string, int>> subscribe_pending_;
+  std::vector<std::string> unsubscribe_pending_;
+  MqttStats stats_;
+
+  // Client thread only.
+  int socket_fd_ = -1;
+  bool connected_ = false;
+  bool want_write_ = false;
+  std::string outgoing_;
+  size_t outgoing_offset_ = 0;
+  std::unique_ptr<PacketReader> reader_;
+  std::map<uint16_t, Inflight> inflight_;
+  uint16_t last_packet_id_ = 0;
+  int64_t connect_deadline_us_ = 0;
+  int64_t last_send_us_ = 0;
+  int64_t last_receive_us_ = 0;
+  int64_t ping_sent_us_ = 0;
+  std::vector<OutgoingMessage> batch_;
+};
+
+}  // namespace kiosk_mqtt
+
+#endif  // PLUGINS_KIOSK_MQTT_MQTT_CLIENT_H_
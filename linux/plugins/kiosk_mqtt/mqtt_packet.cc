@@ -0,0 +1,413 @@
+#include "mqtt_packet.h"
+
+namespace kiosk_mqtt {
+
+namespace {
+
+// The largest value a four-byte variable byte integer holds.
+const uint32_t kMaxRemainingLength = 268435455;
+
+void PutU8(uint8_t value, std::string* out) {
+  out->push_back(static_cast<char>(value));
+}
+
+void PutU16(uint16_t value, std::string* out) {
+  out->push_back(static_cast<char>(value >> 8));
+  out->push_back(static_cast<char>(value & 0xff));
+}
+
+void PutVarint(uint32_t value, std::string* out) {
+  do {
+    uint8_t byte = value % 128;
+    value /= 128;
+    if (value > 0) {
+      byte |= 0x80;
+    }
+    out->push_back(static_cast<char>(byte));
+  } while (value > 0);
+}
+
+void PutString(const std::string& value, std::string* out) {
+  PutU16(static_cast<uint16_t>(value.size()), out);
+  out->append(value);
+}
+
+// Prepends the fixed header to |body|.
+void Frame(uint8_t header, const std::string& body, std::string* out) {
+  PutU8(header, out);
+  PutVarint(static_cast<uint32_t>(body.size()), out);
+  out->append(body);
+}
+
+// Bounds-checked reads over a packet body.
+class Cursor {
+ public:
+  Cursor(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+  bool U8(uint8_t* value) {
+    if (offset_ + 1 > size_) {
+      return false;
+    }
+    *value = data_[offset_++];
+    return true;
+  }
+
+  bool U16(uint16_t* value) {
+    if (offset_ + 2 > size_) {
+      return false;
+    }
+    *value = static_cast<uint16_t>(data_[offset_] << 8 | data_[offset_ + 1]);
+    offset_ += 2;
+    return true;
+  }
+
+  bool Varint(uint32_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 28; shift += 7) {
+      uint8_t byte;
+      if (!U8(&byte)) {
+        return false;
+      }
+      *value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool String(std::string* value) {
+    uint16_t length;
+    if (!U16(&length) || offset_ + length > size_) {
+      return false;
+    }
+    value->assign(reinterpret_cast<const char*>(data_ + offset_), length);
+    offset_ += length;
+    return true;
+  }
+
+  // MQTT 5 property block; the client asks for no features whose
+  // properties it would need to act on.
+  bool SkipProperties() {
+    uint32_t length;
+    if (!Varint(&length) || offset_ + length > size_) {
+      return false;
+    }
+    offset_ += length;
+    return true;
+  }
+
+  void Rest(std::string* value) {
+    value->assign(reinterpret_cast<const char*>(data_ + offset_),
+                  size_ - offset_);
+    offset_ = size_;
+  }
+
+  size_t remaining() const { return size_ - offset_; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t offset_ = 0;
+};
+
+}  // namespace
+
+void EncodeConnect(const ConnectOptions& options, std::string* out) {
+  const bool v5 = options.protocol_version == kMqtt5;
+  const bool will = !options.will_topic.empty();
+  uint8_t flags = 0;
+  if (options.clean_start) {
+    flags |= 0x02;
+  }
+  if (will) {
+    flags |= 0x04 | (options.will_qos & 0x03) << 3;
+    if (options.will_retain) {
+      flags |= 0x20;
+    }
+  }
+  if (!options.password.empty()) {
+    flags |= 0x40;
+  }
+  if (!options.username.empty()) {
+    flags |= 0x80;
+  }
+
+  std::string body;
+  PutString("MQTT", &body);
+  PutU8(static_cast<uint8_t>(options.protocol_version), &body);
+  PutU8(flags, &body);
+  PutU16(static_cast<uint16_t>(options.keep_alive_s), &body);
+  if (v5) {
+    PutVarint(0, &body);
+  }
+  PutString(options.client_id, &body);
+  if (will) {
+    if (v5) {
+      PutVarint(0, &body);
+    }
+    PutString(options.will_topic, &body);
+    PutString(options.will_payload, &body);
+  }
+  if (!options.username.empty()) {
+    PutString(options.username, &body);
+  }
+  if (!options.password.empty()) {
+    PutString(options.password, &body);
+  }
+  Frame(static_cast<uint8_t>(PacketType::kConnect) << 4, body, out);
+}
+
+void EncodePublish(int version, const std::string& topic,
+                   const std::string& payload, int qos, bool retain,
+                   bool dup, uint16_t packet_id, std::string* out) {
+  uint8_t header = static_cast<uint8_t>(PacketType::kPublish) << 4 |
+                   (qos & 0x03) << 1;
+  if (retain) {
+    header |= 0x01;
+  }
+  if (dup) {
+    header |= 0x08;
+  }
+  const size_t length = 2 + topic.size() + (qos > 0 ? 2 : 0) +
+                        (version == kMqtt5 ? 1 : 0) + payload.size();
+  // Written in place: payloads are the bulk of what goes out.
+  PutU8(header, out);
+  PutVarint(static_cast<uint32_t>(length), out);
+  PutString(topic, out);
+  if (qos > 0) {
+    PutU16(packet_id, out);
+  }
+  if (version == kMqtt5) {
+    PutVarint(0, out);
+  }
+  out->append(payload);
+}
+
+void EncodeAck(PacketType type, uint16_t packet_id, std::string* out) {
+  // A bare packet id means success in MQTT 5 too.
+  PutU8(static_cast<uint8_t>(type) << 4 |
+            (type == PacketType::kPubrel ? 0x02 : 0x00),
+        out);
+  PutVarint(2, out);
+  PutU16(packet_id, out);
+}
+
+void EncodeSubscribe(int version, uint16_t packet_id,
+                     const std::vector<std::pair<std::string, int>>& filters,
+                     std::string* out) {
+  std::string body;
+  PutU16(packet_id, &body);
+  if (version == kMqtt5) {
+    PutVarint(0, &body);
+  }
+  for (const auto& filter : filters) {
+    PutString(filter.first, &body);
+    PutU8(static_cast<uint8_t>(filter.second & 0x03), &body);
+  }
+  Frame(static_cast<uint8_t>(PacketType::kSubscribe) << 4 | 0x02, body, out);
+}
+
+void EncodeUnsubscribe(int version, uint16_t packet_id,
+                       const std::vector<std::string>& filters,
+                       std::string* out) {
+  std::string body;
+  PutU16(packet_id, &body);
+  if (version == kMqtt5) {
+    PutVarint(0, &body);
+  }
+  for (const std::string& filter : filters) {
+    PutString(filter, &body);
+  }
+  Frame(static_cast<uint8_t>(PacketType::kUnsubscribe) << 4 | 0x02, body,
+        out);
+}
+
+void EncodePingreq(std::string* out) {
+  PutU8(static_cast<uint8_t>(PacketType::kPingreq) << 4, out);
+  PutU8(0, out);
+}
+
+void EncodeDisconnect(int version, std::string* out) {
+  std::string body;
+  if (version == kMqtt5) {
+    // Reason code 0, normal disconnection: the will is discarded. No
+    // properties.
+    PutU8(0, &body);
+    PutVarint(0, &body);
+  }
+  Frame(static_cast<uint8_t>(PacketType::kDisconnect) << 4, body, out);
+}
+
+PacketReader::PacketReader(int version, size_t max_packet_bytes)
+    : version_(version), max_packet_bytes_(max_packet_bytes) {}
+
+void PacketReader::Feed(const uint8_t* data, size_t size) {
+  if (offset_ > 0 && offset_ == buffer_.size()) {
+    buffer_.clear();
+    offset_ = 0;
+  } else if (offset_ > 64 * 1024) {
+    buffer_.erase(0, offset_);
+    offset_ = 0;
+  }
+  buffer_.append(reinterpret_cast<const char*>(data), size);
+}
+
+void PacketReader::Reset() {
+  buffer_.clear();
+  offset_ = 0;
+  error_.clear();
+}
+
+int PacketReader::Next(Packet* packet) {
+  if (!error_.empty()) {
+    return -1;
+  }
+  const uint8_t* data =
+      reinterpret_cast<const uint8_t*>(buffer_.data()) + offset_;
+  const size_t available = buffer_.size() - offset_;
+  if (available < 2) {
+    return 0;
+  }
+  uint32_t length = 0;
+  size_t header_bytes = 1;
+  for (int shift = 0;; shift += 7) {
+    if (header_bytes >= available) {
+      return 0;
+    }
+    const uint8_t byte = data[header_bytes++];
+    length |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      break;
+    }
+    if (shift == 21) {
+      error_ = "Malformed MQTT remaining length";
+      return -1;
+    }
+  }
+  if (length > kMaxRemainingLength || length > max_packet_bytes_) {
+    error_ = "MQTT packet of " + std::to_string(length) +
+             " bytes exceeds the limit";
+    return -1;
+  }
+  if (available - header_bytes < length) {
+    return 0;
+  }
+  if (!Decode(data[0], data + header_bytes, length, packet)) {
+    if (error_.empty()) {
+      error_ = "Malformed MQTT packet of type " +
+               std::to_string(data[0] >> 4);
+    }
+    return -1;
+  }
+  offset_ += header_bytes + length;
+  return 1;
+}
+
+bool PacketReader::Decode(uint8_t header, const uint8_t* body, size_t size,
+                          Packet* packet) {
+  const bool v5 = version_ == kMqtt5;
+  Cursor cursor(body, size);
+  *packet = Packet();
+  packet->type = static_cast<PacketType>(header >> 4);
+  switch (packet->type) {
+    case PacketType::kConnack: {
+      uint8_t flags;
+      uint8_t code;
+      if (!cursor.U8(&flags) || !cursor.U8(&code)) {
+        return false;
+      }
+      packet->session_present = flags & 0x01;
+      packet->reason_code = code;
+      return !v5 || cursor.remaining() == 0 || cursor.SkipProperties();
+    }
+    case PacketType::kPublish: {
+      packet->qos = (header >> 1) & 0x03;
+      packet->retain = header & 0x01;
+      packet->dup = header & 0x08;
+      if (packet->qos == 3 || !cursor.String(&packet->topic)) {
+        return false;
+      }
+      if (packet->qos > 0 && !cursor.U16(&packet->packet_id)) {
+        return false;
+      }
+      if (v5 && !cursor.SkipProperties()) {
+        return false;
+      }
+      cursor.Rest(&packet->payload);
+      return true;
+    }
+    case PacketType::kPuback:
+    case PacketType::kPubrec:
+    case PacketType::kPubrel:
+    case PacketType::kPubcomp:
+    case PacketType::kUnsuback: {
+      if (!cursor.U16(&packet->packet_id)) {
+        return false;
+      }
+      uint8_t code = 0;
+      if (v5 && packet->type != PacketType::kUnsuback &&
+          cursor.remaining() > 0) {
+        cursor.U8(&code);
+      }
+      packet->reason_code = code;
+      return true;
+    }
+    case PacketType::kSuback: {
+      if (!cursor.U16(&packet->packet_id) ||
+          (v5 && !cursor.SkipProperties())) {
+        return false;
+      }
+      uint8_t code;
+      while (cursor.U8(&code)) {
+        packet->granted.push_back(code);
+      }
+      return true;
+    }
+    case PacketType::kPingresp:
+      return size == 0;
+    case PacketType::kDisconnect: {
+      uint8_t code = 0;
+      if (cursor.remaining() > 0) {
+        cursor.U8(&code);
+      }
+      packet->reason_code = code;
+      return true;
+    }
+    default:
+      error_ = "Unexpected MQTT packet of type " + std::to_string(header >> 4);
+      return false;
+  }
+}
+
+bool TopicMatches(const std::string& filter, const std::string& topic) {
+  // Wildcards never match topics starting with $ (such as $SYS).
+  if (!topic.empty() && topic[0] == '$' &&
+      (filter.empty() || filter[0] == '+' || filter[0] == '#')) {
+    return false;
+  }
+  size_t f = 0;
+  size_t t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') {
+      return true;
+    }
+    if (filter[f] == '+') {
+      while (t < topic.size() && topic[t] != '/') {
+        t++;
+      }
+      f++;
+    } else {
+      if (t >= topic.size() || filter[f] != topic[t]) {
+        // "a/#" also matches "a".
+        return t == topic.size() && filter.compare(f, 2, "/#") == 0 &&
+               f + 2 == filter.size();
+      }
+      f++;
+      t++;
+    }
+  }
+  return t == topic.size();
+}
+
+}  // namespace kiosk_mqtt
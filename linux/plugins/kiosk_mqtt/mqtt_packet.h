@@ -0,0 +1,112 @@
+#ifndef PLUGINS_KIOSK_MQTT_MQTT_PACKET_H_
+#define PLUGINS_KIOSK_MQTT_MQTT_PACKET_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace kiosk_mqtt {
+
+// Protocol levels as sent in CONNECT.
+const int kMqtt311 = 4;
+const int kMqtt5 = 5;
+
+enum class PacketType : uint8_t {
+  kConnect = 1,
+  kConnack = 2,
+  kPublish = 3,
+  kPuback = 4,
+  kPubrec = 5,
+  kPubrel = 6,
+  kPubcomp = 7,
+  kSubscribe = 8,
+  kSuback = 9,
+  kUnsubscribe = 10,
+  kUnsuback = 11,
+  kPingreq = 12,
+  kPingresp = 13,
+  kDisconnect = 14,
+};
+
+struct ConnectOptions {
+  int protocol_version = kMqtt311;
+  std::string client_id;
+  // Sent when non-empty.
+  std::string username;
+  std::string password;
+  int keep_alive_s = 30;
+  bool clean_start = true;
+  // Sent when |will_topic| is non-empty.
+  std::string will_topic;
+  std::string will_payload;
+  int will_qos = 1;
+  bool will_retain = true;
+};
+
+// A decoded control packet. Only the fields of its type are set; MQTT 5
+// properties are skipped.
+struct Packet {
+  PacketType type = PacketType::kPingresp;
+  uint16_t packet_id = 0;
+  // PUBLISH.
+  std::string topic;
+  std::string payload;
+  int qos = 0;
+  bool retain = false;
+  bool dup = false;
+  // CONNACK return code (3.1.1) or reason code (5); PUBACK and server
+  // DISCONNECT reason code.
+  int reason_code = 0;
+  bool session_present = false;
+  // SUBACK return codes, one per filter.
+  std::vector<uint8_t> granted;
+};
+
+// Encoders append one packet to |out|; strings are used as byte buffers.
+void EncodeConnect(const ConnectOptions& options, std::string* out);
+void EncodePublish(int version, const std::string& topic,
+                   const std::string& payload, int qos, bool retain,
+                   bool dup, uint16_t packet_id, std::string* out);
+// PUBACK, PUBREC, PUBREL or PUBCOMP.
+void EncodeAck(PacketType type, uint16_t packet_id, std::string* out);
+void EncodeSubscribe(int version, uint16_t packet_id,
+                     const std::vector<std::pair<std::string, int>>& filters,
+                     std::string* out);
+void EncodeUnsubscribe(int version, uint16_t packet_id,
+                       const std::vector<std::string>& filters,
+                       std::string* out);
+void EncodePingreq(std::string* out);
+void EncodeDisconnect(int version, std::string* out);
+
+// Splits a TCP byte stream into packets.
+class PacketReader {
+ public:
+  PacketReader(int version, size_t max_packet_bytes);
+
+  void Feed(const uint8_t* data, size_t size);
+  // Returns 1 with |packet| filled, 0 when more bytes are needed, or -1
+  // when the stream is malformed (see error()); the connection must then
+  // be dropped.
+  int Next(Packet* packet);
+  void Reset();
+  const std::string& error() const { return error_; }
+
+ private:
+  bool Decode(uint8_t header, const uint8_t* body, size_t size,
+              Packet* packet);
+
+  const int version_;
+  const size_t max_packet_bytes_;
+  std::string buffer_;
+  size_t offset_ = 0;
+  std::string error_;
+};
+
+// MQTT topic filter matching with + and # wildcards.
+bool TopicMatches(const std::string& filter, const std::string& topic);
+
+}  // namespace kiosk_mqtt
+
+#endif  // PLUGINS_KIOSK_MQTT_MQTT_PACKET_H_
@@ -0,0 +1,187 @@
+#include "publish_queue.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "mqtt_packet.h"
+
+namespace kiosk_mqtt {
+
+PublishQueue::PublishQueue(const PublishQueueConfig& config)
+    : config_(config) {}
+
+void PublishQueue::set_config(const PublishQueueConfig& config) {
+  config_ = config;
+  // Intervals may have changed; what was held back goes out now.
+  for (auto& topic : topics_) {
+    if (topic.second.has_deferred) {
+      Append(std::move(topic.second.deferred), false);
+    }
+  }
+  topics_.clear();
+  deferred_ = 0;
+}
+
+int PublishQueue::IntervalFor(const std::string& topic) const {
+  for (const RateRule& rule : config_.rules) {
+    if (TopicMatches(rule.filter, topic)) {
+      return std::max(rule.min_interval_ms, 0);
+    }
+  }
+  return 0;
+}
+
+bool PublishQueue::Push(OutgoingMessage message, int64_t now_us) {
+  stats_.enqueued++;
+  const int interval_ms = IntervalFor(message.topic);
+  auto pending = pending_.find(message.topic);
+  if (pending != pending_.end() && (message.retain || interval_ms > 0)) {
+    OutgoingMessage& queued = *pending->second;
+    bytes_ = bytes_ - queued.payload.size() + message.payload.size();
+    queued = std::move(message);
+    stats_.coalesced++;
+    return true;
+  }
+  if (interval_ms == 0) {
+    const bool retain = message.retain;
+    return Append(std::move(message), retain);
+  }
+
+  TopicState& state = topics_[message.topic];
+  state.interval_ms = interval_ms;
+  if (state.has_deferred) {
+    state.deferred = std::move(message);
+    stats_.coalesced++;
+    return true;
+  }
+  const int64_t due_us = state.last_sent_us + interval_ms * 1000LL;
+  if (state.last_sent_us != 0 && now_us < due_us) {
+    state.deferred = std::move(message);
+    state.has_deferred = true;
+    state.due_us = due_us;
+    deferred_++;
+    stats_.rate_limited++;
+    return true;
+  }
+  return Append(std::move(message), true);
+}
+
+bool PublishQueue::Append(OutgoingMessage message, bool coalescable) {
+  if (!MakeRoom(message.payload.size())) {
+    stats_.dropped++;
+    return false;
+  }
+  bytes_ += message.payload.size();
+  const std::string topic = coalescable ? message.topic : std::string();
+  ready_.push_back(std::move(message));
+  if (coalescable) {
+    pending_[topic] = std::prev(ready_.end());
+  }
+  stats_.high_water = std::max(stats_.high_water, ready_.size());
+  return true;
+}
+
+void PublishQueue::RemoveReady(ReadyList::iterator position) {
+  bytes_ -= position->payload.size();
+  auto pending = pending_.find(position->topic);
+  if (pending != pending_.end() && pending->second == position) {
+    pending_.erase(pending);
+  }
+  ready_.erase(position);
+}
+
+bool PublishQueue::MakeRoom(size_t bytes) {
+  while (!ready_.empty() && (ready_.size() + 1 > config_.max_messages ||
+                             bytes_ + bytes > config_.max_bytes)) {
+    if (config_.drop_newest) {
+      return false;
+    }
+    auto victim = std::find_if(
+        ready_.begin(), ready_.end(),
+        [](const OutgoingMessage& message) { return message.qos == 0; });
+    if (victim == ready_.end()) {
+      victim = ready_.begin();
+    }
+    RemoveReady(victim);
+    stats_.dropped++;
+  }
+  return bytes <= config_.max_bytes;
+}
+
+void PublishQueue::Promote(int64_t now_us) {
+  if (deferred_ == 0) {
+    return;
+  }
+  for (auto& topic : topics_) {
+    TopicState& state = topic.second;
+    if (state.has_deferred && state.due_us <= now_us) {
+      state.has_deferred = false;
+      deferred_--;
+      Append(std::move(state.deferred), true);
+    }
+  }
+}
+
+size_t PublishQueue::Pop(int64_t now_us, size_t max_bytes,
+                         size_t max_acknowledged,
+                         std::vector<OutgoingMessage>* out) {
+  Promote(now_us);
+  size_t moved = 0;
+  size_t bytes = 0;
+  while (!ready_.empty() && (moved == 0 || bytes < max_bytes)) {
+    auto front = ready_.begin();
+    if (front->qos > 0) {
+      if (max_acknowledged == 0) {
+        break;
+      }
+      max_acknowledged--;
+    }
+    auto topic = topics_.find(front->topic);
+    if (topic != topics_.end()) {
+      topic->second.last_sent_us = now_us;
+    }
+    auto pending = pending_.find(front->topic);
+    if (pending != pending_.end() && pending->second == front) {
+      pending_.erase(pending);
+    }
+    bytes += front->payload.size();
+    bytes_ -= front->payload.size();
+    out->push_back(std::move(*front));
+    ready_.pop_front();
+    moved++;
+  }
+  stats_.dequeued += moved;
+  return moved;
+}
+
+int64_t PublishQueue::NextDueUs() const {
+  int64_t next = -1;
+  if (deferred_ == 0) {
+    return next;
+  }
+  for (const auto& topic : topics_) {
+    if (topic.second.has_deferred &&
+        (next < 0 || topic.second.due_us < next)) {
+      next = topic.second.due_us;
+    }
+  }
+  return next;
+}
+
+void PublishQueue::Clear() {
+  ready_.clear();
+  pending_.clear();
+  topics_.clear();
+  bytes_ = 0;
+  deferred_ = 0;
+}
+
+PublishQueueStats PublishQueue::stats() const {
+  PublishQueueStats stats = stats_;
+  stats.queued = ready_.size();
+  stats.queued_bytes = bytes_;
+  stats.deferred = deferred_;
+  return stats;
+}
+
+}  // namespace kiosk_mqtt
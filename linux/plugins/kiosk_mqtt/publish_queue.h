@@ -0,0 +1,116 @@
+#ifndef PLUGINS_KIOSK_MQTT_PUBLISH_QUEUE_H_
+#define PLUGINS_KIOSK_MQTT_PUBLISH_QUEUE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace kiosk_mqtt {
+
+struct OutgoingMessage {
+  std::string topic;
+  std::string payload;
+  int qos = 0;
+  bool retain = false;
+};
+
+// Topics matching |filter| are sent at most once per |min_interval_ms|;
+// what arrives in between replaces the value waiting to go out, so the
+// broker always ends up with the latest one.
+struct RateRule {
+  std::string filter;
+  int min_interval_ms = 0;
+};
+
+struct PublishQueueConfig {
+  size_t max_messages = 2048;
+  size_t max_bytes = 4 << 20;
+  // When full, true rejects the new message; otherwise the oldest QoS 0
+  // message goes first, then the oldest of any QoS.
+  bool drop_newest = false;
+  // First match wins.
+  std::vector<RateRule> rules;
+};
+
+struct PublishQueueStats {
+  size_t queued = 0;
+  size_t queued_bytes = 0;
+  // Waiting out a rate limit.
+  size_t deferred = 0;
+  size_t high_water = 0;
+  uint64_t enqueued = 0;
+  uint64_t dequeued = 0;
+  // Replaced by a newer value for the same topic before being sent.
+  uint64_t coalesced = 0;
+  uint64_t rate_limited = 0;
+  uint64_t dropped = 0;
+};
+
+// Outgoing publishes between the Dart side and the socket. Not
+// thread-safe; the client guards it.
+//
+// A retained message, or one on a rate-limited topic, replaces an unsent
+// message for the same topic in place, keeping its position: these carry
+// state, and only the latest value matters.
+class PublishQueue {
+ public:
+  explicit PublishQueue(const PublishQueueConfig& config);
+
+  // Disallow copy and assign.
+  PublishQueue(const PublishQueue&) = delete;
+  PublishQueue& operator=(const PublishQueue&) = delete;
+
+  void set_config(const PublishQueueConfig& config);
+
+  // Returns false if the message was dropped because the queue is full.
+  bool Push(OutgoingMessage message, int64_t now_us);
+  // Moves due messages into |out| until about |max_bytes| of payload;
+  // at least one if any is due. Stops before a QoS 1 message once
+  // |max_acknowledged| of them were taken, keeping publish order. Returns
+  // the number moved.
+  size_t Pop(int64_t now_us, size_t max_bytes, size_t max_acknowledged,
+             std::vector<OutgoingMessage>* out);
+  // When the earliest deferred message becomes due, or -1.
+  int64_t NextDueUs() const;
+  bool has_ready() const { return !ready_.empty(); }
+  void Clear();
+
+  PublishQueueStats stats() const;
+
+ private:
+  struct TopicState {
+    int interval_ms = 0;
+    int64_t last_sent_us = 0;
+    bool has_deferred = false;
+    int64_t due_us = 0;
+    OutgoingMessage deferred;
+  };
+
+  using ReadyList = std::list<OutgoingMessage>;
+
+  int IntervalFor(const std::string& topic) const;
+  // |coalescable| lets a newer value for the topic replace it.
+  bool Append(OutgoingMessage message, bool coalescable);
+  void RemoveReady(ReadyList::iterator position);
+  // Moves deferred messages that are due to the ready list.
+  void Promote(int64_t now_us);
+  // Makes room for |bytes| more; false if the new message must go.
+  bool MakeRoom(size_t bytes);
+
+  PublishQueueConfig config_;
+  ReadyList ready_;
+  // Unsent ready messages that a newer value may replace, by topic.
+  std::unordered_map<std::string, ReadyList::iterator> pending_;
+  // Rate-limited topics only.
+  std::unordered_map<std::string, TopicState> topics_;
+  size_t bytes_ = 0;
+  size_t deferred_ = 0;
+  PublishQueueStats stats_;
+};
+
+}  // namespace kiosk_mqtt
+
+#endif  // PLUGINS_KIOSK_MQTT_PUBLISH_QUEUE_H_
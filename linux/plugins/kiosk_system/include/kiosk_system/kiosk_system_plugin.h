@@ -0,0 +1,28 @@
+#ifndef FLUTTER_PLUGIN_KIOSK_SYSTEM_PLUGIN_H_
+#define FLUTTER_PLUGIN_KIOSK_SYSTEM_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+G_BEGIN_DECLS
+
+#ifdef FLUTTER_PLUGIN_IMPL
+#define FLUTTER_PLUGIN_EXPORT __attribute__((visibility("default")))
+#else
+#define FLUTTER_PLUGIN_EXPORT
+#endif
+
+typedef struct _KioskSystemPlugin KioskSystemPlugin;
+typedef struct {
+  GObjectClass parent_class;
+} KioskSystemPluginClass;
+
+FLUTTER_PLUGIN_EXPORT GType kiosk_system_plugin_get_type();
+
+// Registers the /proc and /sys metrics sampler on the
+// "com.ki.king_kiosk/system" method channel.
+FLUTTER_PLUGIN_EXPORT void kiosk_system_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+G_END_DECLS
+
+#endif  // FLUTTER_PLUGIN_KIOSK_SYSTEM_PLUGIN_H_
@@ -0,0 +1,553 @@
+#include "include/kiosk_system/kiosk_system_plugin.h"
+
+#include <flutter_linux/flutter_linux.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "memory_governor.h"
+#include "metrics_sampler.h"
+#include "proc_reader.h"
+
+#define KIOSK_SYSTEM_PLUGIN(obj)                                     \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), kiosk_system_plugin_get_type(), \
+                              KioskSystemPlugin))
+
+namespace {
+
+const char kChannelName[] = "com.ki.king_kiosk/system";
+const char kMemoryChannelName[] = "com.ki.king_kiosk/system/memory";
+
+// Applied at registration, before Dart starts and most threads get their
+// arena; startGovernor can change it for arenas created later.
+const int kDefaultArenaMax = 2;
+
+FlValue* lookup(FlValue* args, const char* key, FlValueType type) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  FlValue* value = fl_value_lookup_string(args, key);
+  return value != nullptr && fl_value_get_type(value) == type ? value
+                                                              : nullptr;
+}
+
+int64_t lookup_int(FlValue* args, const char* key, int64_t fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_INT);
+  return value != nullptr ? fl_value_get_int(value) : fallback;
+}
+
+double lookup_double(FlValue* args, const char* key, double fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_FLOAT);
+  if (value != nullptr) {
+    return fl_value_get_float(value);
+  }
+  value = lookup(args, key, FL_VALUE_TYPE_INT);
+  return value != nullptr ? static_cast<double>(fl_value_get_int(value))
+                          : fallback;
+}
+
+const char* lookup_string(FlValue* args, const char* key,
+                          const char* fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_STRING);
+  return value != nullptr ? fl_value_get_string(value) : fallback;
+}
+
+// Indices into kMetrics named by the "metrics" list, or all of them.
+std::vector<size_t> metric_indices(FlValue* args) {
+  std::vector<size_t> indices;
+  FlValue* list = lookup(args, "metrics", FL_VALUE_TYPE_LIST);
+  if (list == nullptr) {
+    for (size_t i = 0; i < kiosk_system::kMetricCount; ++i) {
+      indices.push_back(i);
+    }
+    return indices;
+  }
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* name = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(name) != FL_VALUE_TYPE_STRING) {
+      continue;
+    }
+    const int index = kiosk_system::FindMetric(fl_value_get_string(name));
+    if (index >= 0) {
+      indices.push_back(static_cast<size_t>(index));
+    }
+  }
+  return indices;
+}
+
+void set_int(FlValue* map, const char* key, int64_t value) {
+  fl_value_set_string_take(map, key, fl_value_new_int(value));
+}
+
+void set_float(FlValue* map, const char* key, double value) {
+  fl_value_set_string_take(map, key, fl_value_new_float(value));
+}
+
+FlValue* sample_to_value(const kiosk_system::MetricsSample& sample) {
+  using kiosk_system::MetricsSample;
+  FlValue* map = fl_value_new_map();
+  set_int(map, "timeMs", sample.time_us / 1000);
+  set_int(map, "wallMs", sample.wall_ms);
+  // Scalar metrics, leaving out sources that could not be read.
+  for (size_t i = 0; i < kiosk_system::kMetricCount; ++i) {
+    const kiosk_system::MetricInfo& metric = kiosk_system::kMetrics[i];
+    if ((sample.sources & metric.source) != 0) {
+      set_float(map, metric.name, metric.value(sample));
+    }
+  }
+  if ((sample.sources & kiosk_system::kSourceCpu) != 0) {
+    std::vector<double> cores(sample.cores, sample.cores + sample.core_count);
+    fl_value_set_string_take(
+        map, "cores", fl_value_new_float_list(cores.data(), cores.size()));
+  }
+  if ((sample.sources & kiosk_system::kSourceMemory) != 0) {
+    set_int(map, "memTotalKb", sample.mem_total_kb);
+    set_int(map, "swapTotalKb", sample.swap_total_kb);
+  }
+  if ((sample.sources & kiosk_system::kSourceThermal) != 0) {
+    std::vector<double> zones(sample.thermal_c,
+                              sample.thermal_c + sample.thermal_zone_count);
+    fl_value_set_string_take(
+        map, "thermalC", fl_value_new_float_list(zones.data(), zones.size()));
+    set_int(map, "thermalThrottleCount", sample.thermal_throttle_count);
+  }
+  if ((sample.sources & kiosk_system::kSourceCgroup) != 0) {
+    set_int(map, "cgroupMemoryMaxKb", sample.cgroup_memory_max_kb);
+    set_int(map, "cgroupMemoryHighKb", sample.cgroup_memory_high_kb);
+    set_int(map, "cgroupOomKills", sample.cgroup_oom_kills);
+    set_int(map, "cgroupHighEvents", sample.cgroup_high_events);
+  }
+  return map;
+}
+
+FlValue* sampler_stats_to_value(const kiosk_system::SamplerStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "running", fl_value_new_bool(stats.running));
+  set_int(map, "intervalMs", stats.config.interval_ms);
+  set_int(map, "processIntervalMs", stats.config.process_interval_ms);
+  set_int(map, "history", static_cast<int64_t>(stats.config.history));
+  set_int(map, "samples", static_cast<int64_t>(stats.samples));
+  set_float(map, "sampleCostUs", stats.sample_cost_us);
+  set_float(map, "maxSampleCostUs", stats.max_sample_cost_us);
+  fl_value_set_string_take(map, "cgroupPath",
+                           fl_value_new_string(stats.cgroup_path.c_str()));
+  FlValue* metrics = fl_value_new_list();
+  for (size_t i = 0; i < kiosk_system::kMetricCount; ++i) {
+    fl_value_append_take(metrics,
+                         fl_value_new_string(kiosk_system::kMetrics[i].name));
+  }
+  fl_value_set_string_take(map, "metrics", metrics);
+  return map;
+}
+
+kiosk_system::GovernorConfig governor_config_from_args(FlValue* args) {
+  kiosk_system::GovernorConfig config;
+  config.evaluate_ms =
+      static_cast<int>(lookup_int(args, "evaluateMs", config.evaluate_ms));
+  config.moderate_psi_some =
+      lookup_double(args, "moderatePsiSome", config.moderate_psi_some);
+  config.critical_psi_full =
+      lookup_double(args, "criticalPsiFull", config.critical_psi_full);
+  config.moderate_headroom =
+      lookup_double(args, "moderateHeadroom", config.moderate_headroom);
+  config.critical_headroom =
+      lookup_double(args, "criticalHeadroom", config.critical_headroom);
+  config.rss_soft_limit_kb =
+      lookup_int(args, "rssSoftLimitKb", config.rss_soft_limit_kb);
+  config.rss_hard_limit_kb =
+      lookup_int(args, "rssHardLimitKb", config.rss_hard_limit_kb);
+  config.trim_growth_kb =
+      lookup_int(args, "trimGrowthKb", config.trim_growth_kb);
+  config.cooldown_ms =
+      static_cast<int>(lookup_int(args, "cooldownMs", config.cooldown_ms));
+  config.trigger_stall_us = static_cast<int>(
+      lookup_int(args, "triggerStallUs", config.trigger_stall_us));
+  config.trigger_window_us = static_cast<int>(
+      lookup_int(args, "triggerWindowUs", config.trigger_window_us));
+  return config;
+}
+
+FlValue* release_report_to_value(const kiosk_system::ReleaseReport& report) {
+  FlValue* map = fl_value_new_map();
+  set_int(map, "wallMs", report.wall_ms);
+  fl_value_set_string_take(
+      map, "level",
+      fl_value_new_string(kiosk_system::PressureLevelName(report.level)));
+  fl_value_set_string_take(map, "reason",
+                           fl_value_new_string(report.reason.c_str()));
+  fl_value_set_string_take(map, "action",
+                           fl_value_new_string(report.action.c_str()));
+  set_int(map, "rssBeforeKb", report.rss_before_kb);
+  set_int(map, "rssAfterKb", report.rss_after_kb);
+  set_float(map, "durationMs", report.duration_ms);
+  return map;
+}
+
+FlValue* governor_update_to_value(
+    const kiosk_system::GovernorUpdate& update) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(
+      map, "level",
+      fl_value_new_string(kiosk_system::PressureLevelName(update.level)));
+  fl_value_set_string_take(map, "reason",
+                           fl_value_new_string(update.reason.c_str()));
+  set_int(map, "rssKb", update.rss_kb);
+  FlValue* reports = fl_value_new_list();
+  for (const kiosk_system::ReleaseReport& report : update.reports) {
+    fl_value_append_take(reports, release_report_to_value(report));
+  }
+  fl_value_set_string_take(map, "reports", reports);
+  return map;
+}
+
+FlValue* governor_stats_to_value(const kiosk_system::GovernorStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "running", fl_value_new_bool(stats.running));
+  fl_value_set_string_take(
+      map, "level",
+      fl_value_new_string(kiosk_system::PressureLevelName(stats.level)));
+  fl_value_set_string_take(map, "reason",
+                           fl_value_new_string(stats.reason.c_str()));
+  set_float(map, "headroom", stats.headroom);
+  set_int(map, "rssKb", stats.rss_kb);
+  set_int(map, "peakRssKb", stats.peak_rss_kb);
+  fl_value_set_string_take(map, "psiTrigger",
+                           fl_value_new_bool(stats.psi_trigger));
+  fl_value_set_string_take(map, "cgroupEvents",
+                           fl_value_new_bool(stats.cgroup_events));
+  set_int(map, "arenaMax", kiosk_system::MallocArenaLimit());
+  set_int(map, "evaluations", static_cast<int64_t>(stats.evaluations));
+  set_int(map, "releases", static_cast<int64_t>(stats.releases));
+  set_int(map, "trims", static_cast<int64_t>(stats.trims));
+  set_int(map, "releasedKb", stats.released_kb);
+  set_int(map, "cooldownMs", stats.config.cooldown_ms);
+  set_int(map, "rssSoftLimitKb", stats.config.rss_soft_limit_kb);
+  set_int(map, "rssHardLimitKb", stats.config.rss_hard_limit_kb);
+  set_int(map, "trimGrowthKb", stats.config.trim_growth_kb);
+  FlValue* recent = fl_value_new_list();
+  for (const kiosk_system::ReleaseReport& report : stats.recent) {
+    fl_value_append_take(recent, release_report_to_value(report));
+  }
+  fl_value_set_string_take(map, "recent", recent);
+  return map;
+}
+
+// CLOCK_MONOTONIC, the sampler's clock.
+int64_t monotonic_us() {
+  return g_get_monotonic_time();
+}
+
+}  // namespace
+
+struct _KioskSystemPlugin {
+  GObject parent_instance;
+
+  kiosk_system::MetricsSampler* sampler;
+  kiosk_system::MemoryGovernor* governor;
+
+  FlEventChannel* memory_channel;
+  gboolean memory_listening;
+  // Governor updates, sent from the main loop in order.
+  std::mutex* event_mutex;
+  std::vector<FlValue*>* events;
+  std::atomic<bool>* event_pending;
+};
+
+G_DEFINE_TYPE(KioskSystemPlugin, kiosk_system_plugin, g_object_get_type())
+
+static gboolean deliver_events(gpointer user_data) {
+  KioskSystemPlugin* self = KIOSK_SYSTEM_PLUGIN(user_data);
+  self->event_pending->store(false);
+  std::vector<FlValue*> events;
+  {
+    std::lock_guard<std::mutex> lock(*self->event_mutex);
+    events.swap(*self->events);
+  }
+  for (FlValue* event : events) {
+    if (self->memory_listening) {
+      fl_event_channel_send(self->memory_channel, event, nullptr, nullptr);
+    }
+    fl_value_unref(event);
+  }
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Runs on the governor thread.
+static void on_governor_update(KioskSystemPlugin* self,
+                               const kiosk_system::GovernorUpdate& update) {
+  FlValue* event = governor_update_to_value(update);
+  {
+    std::lock_guard<std::mutex> lock(*self->event_mutex);
+    self->events->push_back(event);
+  }
+  if (!self->event_pending->exchange(true)) {
+    g_idle_add(deliver_events, g_object_ref(self));
+  }
+}
+
+static FlMethodErrorResponse* listen_cb(FlEventChannel* channel,
+                                        FlValue* args, gpointer user_data) {
+  KIOSK_SYSTEM_PLUGIN(user_data)->memory_listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* cancel_cb(FlEventChannel* channel,
+                                        FlValue* args, gpointer user_data) {
+  KIOSK_SYSTEM_PLUGIN(user_data)->memory_listening = FALSE;
+  return nullptr;
+}
+
+static void handle_start_governor(KioskSystemPlugin* self,
+                                  FlMethodCall* method_call, FlValue* args) {
+  const int arena_max = static_cast<int>(lookup_int(args, "arenaMax", 0));
+  if (arena_max > 0) {
+    kiosk_system::LimitMallocArenas(arena_max);
+  }
+  // The governor judges the sampler's samples; start it if Dart has not.
+  if (self->sampler->ring() == nullptr) {
+    self->sampler->Start(kiosk_system::SamplerConfig());
+  }
+  kiosk_system::MemoryGovernor* governor = self->governor;
+  self->sampler->SetListener(
+      [governor](const kiosk_system::MetricsSample& sample) {
+        governor->OnSample(sample);
+      });
+  governor->Start(governor_config_from_args(args),
+                  kiosk_system::CgroupDirectory());
+  g_autoptr(FlValue) stats = governor_stats_to_value(governor->stats());
+  fl_method_call_respond_success(method_call, stats, nullptr);
+}
+
+static FlValue* window_to_value(KioskSystemPlugin* self, FlValue* args) {
+  const int64_t window_ms = lookup_int(args, "windowMs", 60000);
+  std::vector<kiosk_system::MetricsSample> samples;
+  self->sampler->ring()->Read(monotonic_us() - window_ms * 1000, SIZE_MAX,
+                              &samples);
+  const std::vector<kiosk_system::MetricSummary> summaries =
+      kiosk_system::Summarize(samples);
+
+  FlValue* map = fl_value_new_map();
+  set_int(map, "windowMs", window_ms);
+  set_int(map, "samples", static_cast<int64_t>(samples.size()));
+  for (size_t index : metric_indices(args)) {
+    const kiosk_system::MetricSummary& summary = summaries[index];
+    if (summary.count == 0) {
+      continue;
+    }
+    FlValue* entry = fl_value_new_map();
+    set_float(entry, "min", summary.min);
+    set_float(entry, "max", summary.max);
+    set_float(entry, "avg", summary.avg);
+    set_float(entry, "last", summary.last);
+    set_int(entry, "count", summary.count);
+    fl_value_set_string_take(map, kiosk_system::kMetrics[index].name, entry);
+  }
+  return map;
+}
+
+// Column per metric, so a long history crosses the channel as a few typed
+// lists rather than one map per sample.
+static FlValue* history_to_value(KioskSystemPlugin* self, FlValue* args) {
+  const int64_t window_ms = lookup_int(args, "windowMs", -1);
+  const int64_t max_samples = lookup_int(args, "maxSamples", -1);
+  std::vector<kiosk_system::MetricsSample> samples;
+  self->sampler->ring()->Read(
+      window_ms >= 0 ? monotonic_us() - window_ms * 1000 : INT64_MIN,
+      max_samples >= 0 ? static_cast<size_t>(max_samples) : SIZE_MAX,
+      &samples);
+
+  FlValue* map = fl_value_new_map();
+  std::vector<int64_t> times(samples.size());
+  std::vector<int64_t> wall(samples.size());
+  for (size_t i = 0; i < samples.size(); ++i) {
+    times[i] = samples[i].time_us / 1000;
+    wall[i] = samples[i].wall_ms;
+  }
+  fl_value_set_string_take(map, "timeMs",
+                           fl_value_new_int64_list(times.data(), times.size()));
+  fl_value_set_string_take(map, "wallMs",
+                           fl_value_new_int64_list(wall.data(), wall.size()));
+  std::vector<double> column(samples.size());
+  for (size_t index : metric_indices(args)) {
+    const kiosk_system::MetricInfo& metric = kiosk_system::kMetrics[index];
+    bool any = false;
+    for (size_t i = 0; i < samples.size(); ++i) {
+      // NaN marks samples where the source could not be read.
+      if ((samples[i].sources & metric.source) != 0) {
+        column[i] = metric.value(samples[i]);
+        any = true;
+      } else {
+        column[i] = NAN;
+      }
+    }
+    if (any) {
+      fl_value_set_string_take(
+          map, metric.name,
+          fl_value_new_float_list(column.data(), column.size()));
+    }
+  }
+  return map;
+}
+
+static void kiosk_system_plugin_handle_method_call(KioskSystemPlugin* self,
+                                                   FlMethodCall* method_call) {
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  if (strcmp(method, "startSampler") == 0) {
+    kiosk_system::SamplerConfig config;
+    config.interval_ms = static_cast<int>(
+        lookup_int(args, "intervalMs", config.interval_ms));
+    config.history = static_cast<size_t>(lookup_int(
+        args, "history", static_cast<int64_t>(config.history)));
+    config.process_interval_ms = static_cast<int>(lookup_int(
+        args, "processIntervalMs", config.process_interval_ms));
+    self->sampler->Start(config);
+    g_autoptr(FlValue) stats =
+        sampler_stats_to_value(self->sampler->stats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+    return;
+  }
+  if (strcmp(method, "stopSampler") == 0) {
+    self->sampler->Stop();
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+    return;
+  }
+  if (strcmp(method, "getInfo") == 0) {
+    g_autoptr(FlValue) stats =
+        sampler_stats_to_value(self->sampler->stats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+    return;
+  }
+  if (strcmp(method, "startGovernor") == 0) {
+    handle_start_governor(self, method_call, args);
+    return;
+  }
+  if (strcmp(method, "stopGovernor") == 0) {
+    self->governor->Stop();
+    self->sampler->SetListener(nullptr);
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+    return;
+  }
+  if (strcmp(method, "trimMemory") == 0) {
+    g_autoptr(FlValue) report = release_report_to_value(
+        self->governor->Trim(lookup_string(args, "reason", "requested")));
+    fl_method_call_respond_success(method_call, report, nullptr);
+    return;
+  }
+  if (strcmp(method, "getResidentKb") == 0) {
+    g_autoptr(FlValue) value =
+        fl_value_new_int(kiosk_system::ReadResidentKb());
+    fl_method_call_respond_success(method_call, value, nullptr);
+    return;
+  }
+  if (strcmp(method, "getGovernorInfo") == 0) {
+    g_autoptr(FlValue) stats =
+        governor_stats_to_value(self->governor->stats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+    return;
+  }
+
+  // The queries below read the ring, which exists once started.
+  if (self->sampler->ring() == nullptr) {
+    if (strcmp(method, "getCurrent") == 0 ||
+        strcmp(method, "getWindow") == 0 ||
+        strcmp(method, "getHistory") == 0) {
+      fl_method_call_respond_success(method_call, nullptr, nullptr);
+    } else {
+      fl_method_call_respond_not_implemented(method_call, nullptr);
+    }
+    return;
+  }
+
+  if (strcmp(method, "getCurrent") == 0) {
+    kiosk_system::MetricsSample sample;
+    if (!self->sampler->ring()->Latest(&sample)) {
+      fl_method_call_respond_success(method_call, nullptr, nullptr);
+      return;
+    }
+    g_autoptr(FlValue) value = sample_to_value(sample);
+    fl_method_call_respond_success(method_call, value, nullptr);
+  } else if (strcmp(method, "getWindow") == 0) {
+    g_autoptr(FlValue) value = window_to_value(self, args);
+    fl_method_call_respond_success(method_call, value, nullptr);
+  } else if (strcmp(method, "getHistory") == 0) {
+    g_autoptr(FlValue) value = history_to_value(self, args);
+    fl_method_call_respond_success(method_call, value, nullptr);
+  } else {
+    fl_method_call_respond_not_implemented(method_call, nullptr);
+  }
+}
+
+static void kiosk_system_plugin_dispose(GObject* object) {
+  KioskSystemPlugin* self = KIOSK_SYSTEM_PLUGIN(object);
+  // The sampler feeds the governor, which is the only producer of events.
+  delete self->sampler;
+  self->sampler = nullptr;
+  delete self->governor;
+  self->governor = nullptr;
+  if (self->events != nullptr) {
+    for (FlValue* event : *self->events) {
+      fl_value_unref(event);
+    }
+  }
+  delete self->events;
+  self->events = nullptr;
+  delete self->event_mutex;
+  self->event_mutex = nullptr;
+  delete self->event_pending;
+  self->event_pending = nullptr;
+  g_clear_object(&self->memory_channel);
+  G_OBJECT_CLASS(kiosk_system_plugin_parent_class)->dispose(object);
+}
+
+static void kiosk_system_plugin_class_init(KioskSystemPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = kiosk_system_plugin_dispose;
+}
+
+static void kiosk_system_plugin_init(KioskSystemPlugin* self) {
+  self->event_mutex = new std::mutex();
+  self->events = new std::vector<FlValue*>();
+  self->event_pending = new std::atomic<bool>(false);
+  self->sampler = new kiosk_system::MetricsSampler();
+  self->governor = new kiosk_system::MemoryGovernor(
+      [self](const kiosk_system::GovernorUpdate& update) {
+        on_governor_update(self, update);
+      });
+}
+
+static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
+                           gpointer user_data) {
+  KioskSystemPlugin* plugin = KIOSK_SYSTEM_PLUGIN(user_data);
+  kiosk_system_plugin_handle_method_call(plugin, method_call);
+}
+
+void kiosk_system_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar) {
+  kiosk_system::LimitMallocArenas(kDefaultArenaMax);
+
+  KioskSystemPlugin* plugin = KIOSK_SYSTEM_PLUGIN(
+      g_object_new(kiosk_system_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  plugin->memory_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           kMemoryChannelName, FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->memory_channel, listen_cb,
+                                       cancel_cb, plugin, nullptr);
+
+  g_object_unref(plugin);
+}
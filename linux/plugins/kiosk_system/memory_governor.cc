@@ -0,0 +1,522 @@
+#include "memory_governor.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace kiosk_system {
+
+namespace {
+
+constexpr size_t kRecentReports = 32;
+const char kTrimAction[] = "malloc_trim";
+// A sample this old is not judged: the sampler was stopped under us.
+constexpr int64_t kStaleSampleUs = 10 * 1000000;
+
+std::atomic<int> g_arena_limit{0};
+
+int64_t NowUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t WallMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+std::string Percent(const char* what, double share) {
+  char text[96];
+  snprintf(text, sizeof(text), "%s %.0f%%", what, share * 100);
+  return text;
+}
+
+std::string Megabytes(const char* what, int64_t kb) {
+  char text[96];
+  snprintf(text, sizeof(text), "%s %lld MB", what,
+           static_cast<long long>(kb / 1024));
+  return text;
+}
+
+void Raise(PressureAssessment* assessment, PressureLevel level,
+           std::string reason) {
+  if (level > assessment->level) {
+    assessment->level = level;
+    assessment->reason = std::move(reason);
+  }
+}
+
+// Finds "|key| N" at the start of a line of a cgroup key-value file.
+int64_t FindCount(const char* text, const char* key) {
+  const size_t key_length = strlen(key);
+  for (const char* line = text; line != nullptr && *line != '\0';) {
+    if (strncmp(line, key, key_length) == 0 && line[key_length] == ' ') {
+      return strtoll(line + key_length + 1, nullptr, 10);
+    }
+    line = strchr(line, '\n');
+    if (line != nullptr) {
+      ++line;
+    }
+  }
+  return 0;
+}
+
+// Arms a PSI trigger on /proc/pressure/memory; -1 without PSI or when the
+// kernel refuses the trigger.
+int OpenPressureTrigger(int stall_us, int window_us) {
+  const int fd =
+      open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  char trigger[64];
+  const int length =
+      snprintf(trigger, sizeof(trigger), "some %d %d", stall_us, window_us);
+  // The kernel expects the terminating NUL as part of the write.
+  if (write(fd, trigger, static_cast<size_t>(length) + 1) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+}  // namespace
+
+const char* PressureLevelName(PressureLevel level) {
+  switch (level) {
+    case PressureLevel::kNone:
+      return "none";
+    case PressureLevel::kModerate:
+      return "moderate";
+    case PressureLevel::kCritical:
+      return "critical";
+  }
+  return "none";
+}
+
+PressureAssessment AssessPressure(const MetricsSample* sample,
+                                  const MetricsSample* previous,
+                                  int64_t rss_kb,
+                                  const GovernorConfig& config) {
+  PressureAssessment assessment;
+  if (sample != nullptr) {
+    if ((sample->sources & kSourceMemory) != 0 && sample->mem_total_kb > 0) {
+      assessment.headroom = static_cast<double>(sample->mem_available_kb) /
+                            static_cast<double>(sample->mem_total_kb);
+      if (assessment.headroom < config.critical_headroom) {
+        Raise(&assessment, PressureLevel::kCritical,
+              Percent("memory available", assessment.headroom));
+      } else if (assessment.headroom < config.moderate_headroom) {
+        Raise(&assessment, PressureLevel::kModerate,
+              Percent("memory available", assessment.headroom));
+      }
+    }
+    if ((sample->sources & kSourcePressure) != 0) {
+      if (sample->psi_memory_full >= config.critical_psi_full) {
+        Raise(&assessment, PressureLevel::kCritical,
+              Percent("memory stall (full)", sample->psi_memory_full));
+      } else if (sample->psi_memory_some >= config.moderate_psi_some) {
+        Raise(&assessment, PressureLevel::kModerate,
+              Percent("memory stall (some)", sample->psi_memory_some));
+      }
+    }
+    if (previous != nullptr && (sample->sources & kSourceCgroup) != 0 &&
+        (previous->sources & kSourceCgroup) != 0) {
+      if (sample->cgroup_oom_kills > previous->cgroup_oom_kills) {
+        Raise(&assessment, PressureLevel::kCritical, "cgroup OOM kill");
+      } else if (sample->cgroup_high_events > previous->cgroup_high_events) {
+        Raise(&assessment, PressureLevel::kModerate,
+              "cgroup reached memory.high");
+      }
+    }
+  }
+  if (rss_kb > 0) {
+    if (config.rss_hard_limit_kb > 0 && rss_kb >= config.rss_hard_limit_kb) {
+      Raise(&assessment, PressureLevel::kCritical,
+            Megabytes("resident set", rss_kb));
+    } else if (config.rss_soft_limit_kb > 0 &&
+               rss_kb >= config.rss_soft_limit_kb) {
+      Raise(&assessment, PressureLevel::kModerate,
+            Megabytes("resident set", rss_kb));
+    }
+  }
+  return assessment;
+}
+
+int64_t ReadResidentKb() {
+  const int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+  char buffer[128];
+  const ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (n <= 0) {
+    return -1;
+  }
+  buffer[n] = '\0';
+  long long size = 0;
+  long long resident = 0;
+  if (sscanf(buffer, "%lld %lld", &size, &resident) != 2) {
+    return -1;
+  }
+  static const long page_kb = sysconf(_SC_PAGESIZE) / 1024;
+  return resident * page_kb;
+}
+
+int LimitMallocArenas(int arena_max) {
+#ifdef __GLIBC__
+  // An explicit MALLOC_ARENA_MAX was already applied by glibc and wins.
+  const char* env = getenv("MALLOC_ARENA_MAX");
+  if (env != nullptr && *env != '\0') {
+    g_arena_limit = atoi(env);
+  } else if (arena_max > 0 && mallopt(M_ARENA_MAX, arena_max) == 1) {
+    g_arena_limit = arena_max;
+  }
+#endif
+  return g_arena_limit.load();
+}
+
+int MallocArenaLimit() {
+  return g_arena_limit.load();
+}
+
+ReleaseReport TrimMalloc(PressureLevel level, const std::string& reason) {
+  ReleaseReport report;
+  report.wall_ms = WallMs();
+  report.level = level;
+  report.reason = reason;
+  report.action = kTrimAction;
+  report.rss_before_kb = ReadResidentKb();
+  const int64_t start_us = NowUs();
+#ifdef __GLIBC__
+  malloc_trim(0);
+#endif
+  report.duration_ms = static_cast<double>(NowUs() - start_us) / 1000.0;
+  report.rss_after_kb = ReadResidentKb();
+  return report;
+}
+
+MemoryGovernor::MemoryGovernor(Listener listener)
+    : listener_(std::move(listener)),
+      wake_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+
+MemoryGovernor::~MemoryGovernor() {
+  Stop();
+  if (wake_fd_ >= 0) {
+    close(wake_fd_);
+  }
+}
+
+void MemoryGovernor::AddAction(const std::string& name, PressureLevel level,
+                               Action action) {
+  actions_.push_back(NamedAction{name, level, std::move(action)});
+}
+
+void MemoryGovernor::Start(const GovernorConfig& requested,
+                           const std::string& cgroup_path) {
+  GovernorConfig config = requested;
+  config.evaluate_ms = std::max(config.evaluate_ms, 100);
+  config.cooldown_ms = std::max(config.cooldown_ms, 0);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  config_ = config;
+  stats_.config = config;
+  cgroup_path_ = cgroup_path;
+  if (thread_.joinable()) {
+    Wake();
+    return;
+  }
+  stop_ = false;
+  stats_.running = true;
+  last_trim_rss_kb_ = std::max<int64_t>(ReadResidentKb(), 0);
+  thread_ = std::thread(&MemoryGovernor::Run, this);
+}
+
+void MemoryGovernor::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    stats_.running = false;
+  }
+  Wake();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void MemoryGovernor::OnSample(const MetricsSample& sample) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sample_ = sample;
+  has_sample_ = true;
+}
+
+ReleaseReport MemoryGovernor::Trim(const std::string& reason) {
+  const ReleaseReport report = TrimMalloc(PressureLevel::kNone, reason);
+  std::lock_guard<std::mutex> lock(mutex_);
+  Record(report);
+  return report;
+}
+
+GovernorStats MemoryGovernor::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void MemoryGovernor::Wake() {
+  const uint64_t one = 1;
+  if (wake_fd_ >= 0 && write(wake_fd_, &one, sizeof(one)) < 0) {
+    // The counter only saturates if nobody has read it for ages.
+  }
+}
+
+void MemoryGovernor::Record(const ReleaseReport& report) {
+  if (report.rss_before_kb > report.rss_after_kb && report.rss_after_kb > 0) {
+    stats_.released_kb += report.rss_before_kb - report.rss_after_kb;
+  }
+  if (report.action == kTrimAction) {
+    stats_.trims++;
+    if (report.rss_after_kb > 0) {
+      last_trim_rss_kb_ = report.rss_after_kb;
+    }
+  }
+  stats_.recent.push_back(report);
+  while (stats_.recent.size() > kRecentReports) {
+    stats_.recent.pop_front();
+  }
+}
+
+void MemoryGovernor::Run() {
+  int trigger_fd = -1;
+  int armed_stall_us = 0;
+  int armed_window_us = 0;
+  int events_fd = -1;
+  std::string events_path;
+  int64_t oom_kills = 0;
+  int64_t high_events = 0;
+  char events[512];
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    const GovernorConfig config = config_;
+    const std::string cgroup_path = cgroup_path_;
+    lock.unlock();
+
+    if (config.trigger_stall_us != armed_stall_us ||
+        config.trigger_window_us != armed_window_us) {
+      if (trigger_fd >= 0) {
+        close(trigger_fd);
+      }
+      trigger_fd = OpenPressureTrigger(config.trigger_stall_us,
+                                       config.trigger_window_us);
+      armed_stall_us = config.trigger_stall_us;
+      armed_window_us = config.trigger_window_us;
+    }
+    const std::string path =
+        cgroup_path.empty() ? std::string() : cgroup_path + "/memory.events";
+    if (path != events_path) {
+      if (events_fd >= 0) {
+        close(events_fd);
+      }
+      events_path = path;
+      events_fd = path.empty() ? -1 : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      // Reading arms the change notification and sets the baseline.
+      const ssize_t n =
+          events_fd >= 0 ? pread(events_fd, events, sizeof(events) - 1, 0)
+                         : -1;
+      if (n > 0) {
+        events[n] = '\0';
+        oom_kills = FindCount(events, "oom_kill");
+        high_events = FindCount(events, "high");
+      }
+    }
+
+    struct pollfd fds[3];
+    nfds_t count = 0;
+    fds[count++] = {wake_fd_, POLLIN, 0};
+    const nfds_t trigger_index = count;
+    if (trigger_fd >= 0) {
+      fds[count++] = {trigger_fd, POLLPRI, 0};
+    }
+    const nfds_t events_index = count;
+    if (events_fd >= 0) {
+      fds[count++] = {events_fd, POLLPRI, 0};
+    }
+    const int ready = poll(fds, count, config.evaluate_ms);
+
+    PressureAssessment notified;
+    if (ready > 0) {
+      if ((fds[0].revents & POLLIN) != 0) {
+        uint64_t drained;
+        if (read(wake_fd_, &drained, sizeof(drained)) < 0) {
+          // Already drained.
+        }
+      }
+      if (trigger_fd >= 0) {
+        const short revents = fds[trigger_index].revents;
+        if ((revents & POLLERR) != 0) {
+          // The kernel dropped the trigger; rely on the samples.
+          close(trigger_fd);
+          trigger_fd = -1;
+        } else if ((revents & POLLPRI) != 0) {
+          notified.level = PressureLevel::kModerate;
+          notified.reason = "kernel memory stall trigger";
+        }
+      }
+      if (events_fd >= 0 &&
+          (fds[events_index].revents & (POLLPRI | POLLERR)) != 0) {
+        const ssize_t n = pread(events_fd, events, sizeof(events) - 1, 0);
+        if (n > 0) {
+          events[n] = '\0';
+          const int64_t now_oom_kills = FindCount(events, "oom_kill");
+          const int64_t now_high_events = FindCount(events, "high");
+          if (now_oom_kills > oom_kills) {
+            Raise(&notified, PressureLevel::kCritical, "cgroup OOM kill");
+          } else if (now_high_events > high_events) {
+            Raise(&notified, PressureLevel::kModerate,
+                  "cgroup reached memory.high");
+          }
+          oom_kills = now_oom_kills;
+          high_events = now_high_events;
+        }
+      }
+    }
+
+    lock.lock();
+    stats_.psi_trigger = trigger_fd >= 0;
+    stats_.cgroup_events = events_fd >= 0;
+    if (stop_) {
+      break;
+    }
+    lock.unlock();
+    Evaluate(notified);
+    lock.lock();
+  }
+  lock.unlock();
+
+  if (trigger_fd >= 0) {
+    close(trigger_fd);
+  }
+  if (events_fd >= 0) {
+    close(events_fd);
+  }
+}
+
+void MemoryGovernor::Evaluate(const PressureAssessment& notified) {
+  GovernorConfig config;
+  MetricsSample sample;
+  bool has_sample = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config = config_;
+    has_sample = has_sample_ && NowUs() - sample_.time_us < kStaleSampleUs;
+    if (has_sample) {
+      sample = sample_;
+    }
+  }
+
+  const int64_t rss_kb = ReadResidentKb();
+  PressureAssessment assessment =
+      AssessPressure(has_sample ? &sample : nullptr,
+                     has_judged_ ? &judged_ : nullptr, rss_kb, config);
+  if (has_sample) {
+    judged_ = sample;
+    has_judged_ = true;
+  }
+  Raise(&assessment, notified.level, notified.reason);
+
+  PressureLevel previous_level;
+  int64_t trim_baseline_kb;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    previous_level = stats_.level;
+    stats_.level = assessment.level;
+    stats_.reason = assessment.reason;
+    stats_.headroom = assessment.headroom;
+    stats_.evaluations++;
+    if (rss_kb > 0) {
+      stats_.rss_kb = rss_kb;
+      stats_.peak_rss_kb = std::max(stats_.peak_rss_kb, rss_kb);
+      // Growth counts from the lowest point since the last trim.
+      last_trim_rss_kb_ = std::min(last_trim_rss_kb_, rss_kb);
+    }
+    trim_baseline_kb = last_trim_rss_kb_;
+  }
+
+  std::vector<ReleaseReport> reports;
+  const int64_t now_us = NowUs();
+  if (assessment.level != PressureLevel::kNone) {
+    // Escalation acts at once; the same level waits out the cooldown so
+    // sustained pressure does not keep emptying caches.
+    if (assessment.level > last_release_level_ ||
+        now_us - last_release_us_ >=
+            static_cast<int64_t>(config.cooldown_ms) * 1000) {
+      reports = Release(assessment.level, assessment.reason);
+      last_release_level_ = assessment.level;
+      last_release_us_ = now_us;
+    }
+  } else if (config.trim_growth_kb > 0 && rss_kb > 0 &&
+             rss_kb - trim_baseline_kb >= config.trim_growth_kb) {
+    reports.push_back(TrimMalloc(
+        PressureLevel::kNone,
+        Megabytes("resident set grew by", rss_kb - trim_baseline_kb)));
+    std::lock_guard<std::mutex> lock(mutex_);
+    Record(reports.back());
+  }
+
+  if (listener_ &&
+      (assessment.level != previous_level || !reports.empty())) {
+    GovernorUpdate update;
+    update.level = assessment.level;
+    update.reason = assessment.reason;
+    update.rss_kb = reports.empty() ? rss_kb : reports.back().rss_after_kb;
+    update.reports = std::move(reports);
+    listener_(update);
+  }
+}
+
+std::vector<ReleaseReport> MemoryGovernor::Release(
+    PressureLevel level, const std::string& reason) {
+  std::vector<ReleaseReport> reports;
+  for (const NamedAction& action : actions_) {
+    if (action.level > level) {
+      continue;
+    }
+    ReleaseReport report;
+    report.wall_ms = WallMs();
+    report.level = level;
+    report.reason = reason;
+    report.action = action.name;
+    report.rss_before_kb = ReadResidentKb();
+    const int64_t start_us = NowUs();
+    action.run(level);
+    report.duration_ms = static_cast<double>(NowUs() - start_us) / 1000.0;
+    report.rss_after_kb = ReadResidentKb();
+    reports.push_back(std::move(report));
+  }
+  // Last, so it returns what the actions above freed.
+  reports.push_back(TrimMalloc(level, reason));
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.releases++;
+  for (const ReleaseReport& report : reports) {
+    Record(report);
+  }
+  return reports;
+}
+
+}  // namespace kiosk_system
@@ -0,0 +1,204 @@
+#ifndef PLUGINS_KIOSK_SYSTEM_MEMORY_GOVERNOR_H_
+#define PLUGINS_KIOSK_SYSTEM_MEMORY_GOVERNOR_H_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "metrics_sample.h"
+
+namespace kiosk_system {
+
+enum class PressureLevel { kNone, kModerate, kCritical };
+
+const char* PressureLevelName(PressureLevel level);
+
+struct GovernorConfig {
+  // How often the latest sample is judged; kernel notifications wake the
+  // governor sooner.
+  int evaluate_ms = 1000;
+  // Share of the last sampler interval with tasks stalled on memory
+  // (PSI "some") that is moderate pressure, and fully stalled ("full")
+  // that is critical.
+  double moderate_psi_some = 0.10;
+  double critical_psi_full = 0.05;
+  // MemAvailable as a share of MemTotal below which pressure is moderate
+  // or critical.
+  double moderate_headroom = 0.15;
+  double critical_headroom = 0.05;
+  // Our resident set beyond which there is pressure whatever the system
+  // says; 0 disables.
+  int64_t rss_soft_limit_kb = 0;
+  int64_t rss_hard_limit_kb = 0;
+  // Without pressure, trim once the resident set has grown this much
+  // since the last trim; 0 disables.
+  int64_t trim_growth_kb = 64 * 1024;
+  // Releases at the same or a lower level are at least this far apart.
+  int cooldown_ms = 30000;
+  // Kernel PSI trigger on /proc/pressure/memory: wake when tasks stall
+  // |trigger_stall_us| within |trigger_window_us|. Unprivileged processes
+  // need a window that is a multiple of two seconds.
+  int trigger_stall_us = 150000;
+  int trigger_window_us = 2000000;
+};
+
+struct PressureAssessment {
+  PressureLevel level = PressureLevel::kNone;
+  std::string reason;
+  // MemAvailable / MemTotal, 1 when unknown.
+  double headroom = 1;
+};
+
+// Judges |sample| and our resident set against |config|. Either sample
+// may be null; |previous| is the one judged before, for the cgroup event
+// counters. memory.current counts page cache the kernel reclaims on its
+// own, so the cgroup is judged by its memory.high and OOM events rather
+// than by how close it is to its limits.
+PressureAssessment AssessPressure(const MetricsSample* sample,
+                                  const MetricsSample* previous,
+                                  int64_t rss_kb,
+                                  const GovernorConfig& config);
+
+// One release action and what it did to the resident set.
+struct ReleaseReport {
+  int64_t wall_ms = 0;
+  PressureLevel level = PressureLevel::kNone;
+  std::string reason;
+  std::string action;
+  int64_t rss_before_kb = 0;
+  int64_t rss_after_kb = 0;
+  double duration_ms = 0;
+};
+
+struct GovernorUpdate {
+  PressureLevel level = PressureLevel::kNone;
+  std::string reason;
+  int64_t rss_kb = 0;
+  // Native releases just made, in order.
+  std::vector<ReleaseReport> reports;
+};
+
+struct GovernorStats {
+  bool running = false;
+  GovernorConfig config;
+  PressureLevel level = PressureLevel::kNone;
+  std::string reason;
+  double headroom = 1;
+  int64_t rss_kb = 0;
+  int64_t peak_rss_kb = 0;
+  // Whether the kernel PSI trigger and memory.events notifications are
+  // armed; without them pressure is only seen every |evaluate_ms|.
+  bool psi_trigger = false;
+  bool cgroup_events = false;
+  uint64_t evaluations = 0;
+  // Releases under pressure, and malloc_trim calls with or without it.
+  uint64_t releases = 0;
+  uint64_t trims = 0;
+  // Sum of what every action took off the resident set.
+  int64_t released_kb = 0;
+  // Newest last.
+  std::deque<ReleaseReport> recent;
+};
+
+// Resident set of this process from /proc/self/statm, or -1.
+int64_t ReadResidentKb();
+
+// Caps the number of glibc malloc arenas, which otherwise grow to eight
+// per core and fragment independently, unless MALLOC_ARENA_MAX is set in
+// the environment. Only arenas created afterwards are affected, so call
+// it early. Returns the cap in effect, 0 for glibc's default.
+int LimitMallocArenas(int arena_max);
+int MallocArenaLimit();
+
+// Returns free heap at the top of every arena and whole free pages inside
+// them to the kernel, measured.
+ReleaseReport TrimMalloc(PressureLevel level, const std::string& reason);
+
+// Watches memory pressure and releases memory in priority order.
+//
+// The sampler feeds it samples (PSI shares, MemAvailable, cgroup events);
+// its own thread sleeps in poll() on a kernel PSI trigger and on our
+// cgroup's memory.events, so pressure is acted on as soon as the kernel
+// reports it rather than at the next sample. Each release runs the
+// registered actions up to the current level, cheapest first, then
+// malloc_trim to hand what they freed back to the kernel, and reports the
+// resident set before and after every step.
+class MemoryGovernor {
+ public:
+  // Called on the governor thread when the level changes or releases ran.
+  using Listener = std::function<void(const GovernorUpdate& update)>;
+  using Action = std::function<void(PressureLevel level)>;
+
+  explicit MemoryGovernor(Listener listener);
+  ~MemoryGovernor();
+
+  // Disallow copy and assign.
+  MemoryGovernor(const MemoryGovernor&) = delete;
+  MemoryGovernor& operator=(const MemoryGovernor&) = delete;
+
+  // Runs |action| on the governor thread once pressure reaches |level|.
+  // Actions run in the order added; call before Start().
+  void AddAction(const std::string& name, PressureLevel level,
+                 Action action);
+
+  // Starts watching, or applies |config| to the running governor.
+  // |cgroup_path| is our cgroup v2 directory, or empty.
+  void Start(const GovernorConfig& config, const std::string& cgroup_path);
+  void Stop();
+
+  // The sampler's newest sample; any thread.
+  void OnSample(const MetricsSample& sample);
+
+  // Measured malloc_trim on the calling thread, recorded with the
+  // releases; for after memory was freed elsewhere.
+  ReleaseReport Trim(const std::string& reason);
+
+  GovernorStats stats() const;
+
+ private:
+  struct NamedAction {
+    std::string name;
+    PressureLevel level;
+    Action run;
+  };
+
+  void Run();
+  // Judges the newest sample, raised to |notified| when the kernel has
+  // reported pressure the sample does not show yet, and releases memory
+  // when due.
+  void Evaluate(const PressureAssessment& notified);
+  std::vector<ReleaseReport> Release(PressureLevel level,
+                                     const std::string& reason);
+  // Called with |mutex_| held.
+  void Record(const ReleaseReport& report);
+  void Wake();
+
+  const Listener listener_;
+  std::vector<NamedAction> actions_;
+  std::thread thread_;
+  // eventfd that interrupts poll() for Stop() and new settings.
+  const int wake_fd_;
+
+  mutable std::mutex mutex_;
+  bool stop_ = false;
+  GovernorConfig config_;
+  std::string cgroup_path_;
+  bool has_sample_ = false;
+  MetricsSample sample_;
+  GovernorStats stats_;
+  int64_t last_trim_rss_kb_ = 0;
+
+  // Governor thread only.
+  bool has_judged_ = false;
+  MetricsSample judged_;
+  PressureLevel last_release_level_ = PressureLevel::kNone;
+  int64_t last_release_us_ = 0;
+};
+
+}  // namespace kiosk_system
+
+#endif  // PLUGINS_KIOSK_SYSTEM_MEMORY_GOVERNOR_H_
@@ -0,0 +1,84 @@
+#include "metrics_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace kiosk_system {
+
+namespace {
+
+size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+}  // namespace
+
+MetricsRing::MetricsRing(size_t capacity)
+    : slots_(new Slot[RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2))]),
+      mask_(RoundUpToPowerOfTwo(std::max<size_t>(capacity, 2)) - 1) {}
+
+void MetricsRing::Push(const MetricsSample& sample) {
+  uint64_t words[kWords] = {};
+  memcpy(words, &sample, sizeof(sample));
+
+  const uint64_t index = head_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[index & mask_];
+  slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t i = 0; i < kWords; ++i) {
+    slot.words[i].store(words[i], std::memory_order_relaxed);
+  }
+  slot.sequence.store(index * 2 + 2, std::memory_order_release);
+  head_.store(index + 1, std::memory_order_release);
+}
+
+bool MetricsRing::ReadSlot(uint64_t index, MetricsSample* out) const {
+  const Slot& slot = slots_[index & mask_];
+  const uint64_t before = slot.sequence.load(std::memory_order_acquire);
+  if (before != index * 2 + 2) {
+    return false;
+  }
+  uint64_t words[kWords];
+  for (size_t i = 0; i < kWords; ++i) {
+    words[i] = slot.words[i].load(std::memory_order_relaxed);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (slot.sequence.load(std::memory_order_relaxed) != before) {
+    return false;
+  }
+  memcpy(out, words, sizeof(*out));
+  return true;
+}
+
+bool MetricsRing::Latest(MetricsSample* out) const {
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  // The newest slot cannot be overwritten before the writer laps the whole
+  // ring, so this only fails on an empty ring.
+  return head > 0 && ReadSlot(head - 1, out);
+}
+
+void MetricsRing::Read(int64_t since_us, size_t max_samples,
+                       std::vector<MetricsSample>* out) const {
+  const uint64_t head = head_.load(std::memory_order_acquire);
+  const uint64_t available = std::min<uint64_t>(head, capacity());
+  const size_t limit = std::min<uint64_t>(available, max_samples);
+  const size_t first = out->size();
+  MetricsSample sample;
+  for (uint64_t n = 0; n < available && out->size() - first < limit; ++n) {
+    if (!ReadSlot(head - 1 - n, &sample)) {
+      // Lapped by the writer; everything older is gone too.
+      break;
+    }
+    if (sample.time_us < since_us) {
+      break;
+    }
+    out->push_back(sample);
+  }
+  std::reverse(out->begin() + first, out->end());
+}
+
+}  // namespace kiosk_system
@@ -0,0 +1,62 @@
+#ifndef PLUGINS_KIOSK_SYSTEM_METRICS_RING_H_
+#define PLUGINS_KIOSK_SYSTEM_METRICS_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "metrics_sample.h"
+
+namespace kiosk_system {
+
+// Fixed-size history of samples with one writer and any number of
+// readers, none of which ever wait.
+//
+// Each slot carries a sequence number that is odd while the writer is in
+// it; a reader copies the slot and keeps the copy only if the number was
+// even and unchanged on both sides, so the sampler thread overwrites the
+// oldest sample while the main thread reads without taking a lock. The
+// sample is stored as atomic words to keep the racing copy well defined.
+class MetricsRing {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit MetricsRing(size_t capacity);
+
+  // Disallow copy and assign.
+  MetricsRing(const MetricsRing&) = delete;
+  MetricsRing& operator=(const MetricsRing&) = delete;
+
+  // Writer only.
+  void Push(const MetricsSample& sample);
+
+  // Returns false while the ring is empty.
+  bool Latest(MetricsSample* out) const;
+  // Appends the newest samples taken at or after |since_us|, at most
+  // |max_samples| of them, oldest first.
+  void Read(int64_t since_us, size_t max_samples,
+            std::vector<MetricsSample>* out) const;
+
+  size_t capacity() const { return mask_ + 1; }
+  uint64_t written() const { return head_.load(std::memory_order_acquire); }
+
+ private:
+  static constexpr size_t kWords = (sizeof(MetricsSample) + 7) / 8;
+
+  struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<uint64_t> words[kWords];
+  };
+
+  // Copies sample number |index|; false if it was overwritten meanwhile.
+  bool ReadSlot(uint64_t index, MetricsSample* out) const;
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  std::atomic<uint64_t> head_{0};
+};
+
+}  // namespace kiosk_system
+
+#endif  // PLUGINS_KIOSK_SYSTEM_METRICS_RING_H_
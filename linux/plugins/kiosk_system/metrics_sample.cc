@@ -0,0 +1,109 @@
+#include "metrics_sample.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace kiosk_system {
+
+namespace {
+
+double MemUsedRatio(const MetricsSample& s) {
+  if (s.mem_total_kb <= 0) {
+    return 0;
+  }
+  return 1.0 - static_cast<double>(s.mem_available_kb) / s.mem_total_kb;
+}
+
+double SwapUsedKb(const MetricsSample& s) {
+  return static_cast<double>(s.swap_total_kb - s.swap_free_kb);
+}
+
+}  // namespace
+
+const MetricInfo kMetrics[] = {
+    {"cpu", kSourceCpu, [](const MetricsSample& s) -> double { return s.cpu; }},
+    {"cpuIowait", kSourceCpu,
+     [](const MetricsSample& s) -> double { return s.cpu_iowait; }},
+    {"cpuFreqRatio", kSourceFrequency,
+     [](const MetricsSample& s) -> double { return s.cpu_freq_ratio; }},
+    {"memAvailableKb", kSourceMemory,
+     [](const MetricsSample& s) -> double {
+       return static_cast<double>(s.mem_available_kb);
+     }},
+    {"memUsedRatio", kSourceMemory, MemUsedRatio},
+    {"swapUsedKb", kSourceMemory, SwapUsedKb},
+    {"rssKb", kSourceProcess,
+     [](const MetricsSample& s) -> double {
+       return static_cast<double>(s.rss_kb);
+     }},
+    {"pssKb", kSourceProcess,
+     [](const MetricsSample& s) -> double {
+       return static_cast<double>(s.pss_kb);
+     }},
+    {"processSwapKb", kSourceProcess,
+     [](const MetricsSample& s) -> double {
+       return static_cast<double>(s.process_swap_kb);
+     }},
+    {"psiCpuSome", kSourcePressure,
+     [](const MetricsSample& s) -> double { return s.psi_cpu_some; }},
+    {"psiMemorySome", kSourcePressure,
+     [](const MetricsSample& s) -> double { return s.psi_memory_some; }},
+    {"psiMemoryFull", kSourcePressure,
+     [](const MetricsSample& s) -> double { return s.psi_memory_full; }},
+    {"psiIoSome", kSourcePressure,
+     [](const MetricsSample& s) -> double { return s.psi_io_some; }},
+    {"psiIoFull", kSourcePressure,
+     [](const MetricsSample& s) -> double { return s.psi_io_full; }},
+    {"tempMaxC", kSourceThermal,
+     [](const MetricsSample& s) -> double { return s.temp_max_c; }},
+    {"cgroupMemoryKb", kSourceCgroup,
+     [](const MetricsSample& s) -> double {
+       return static_cast<double>(s.cgroup_memory_kb);
+     }},
+    {"cgroupCpuThrottled", kSourceCgroup,
+     [](const MetricsSample& s) -> double { return s.cgroup_cpu_throttled; }},
+};
+
+const size_t kMetricCount = sizeof(kMetrics) / sizeof(kMetrics[0]);
+
+int FindMetric(const char* name) {
+  for (size_t i = 0; i < kMetricCount; ++i) {
+    if (strcmp(kMetrics[i].name, name) == 0) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+std::vector<MetricSummary> Summarize(
+    const std::vector<MetricsSample>& samples) {
+  std::vector<MetricSummary> summaries(kMetricCount);
+  std::vector<double> sums(kMetricCount, 0.0);
+  for (const MetricsSample& sample : samples) {
+    for (size_t i = 0; i < kMetricCount; ++i) {
+      if ((sample.sources & kMetrics[i].source) == 0) {
+        continue;
+      }
+      const double value = kMetrics[i].value(sample);
+      MetricSummary& summary = summaries[i];
+      if (summary.count == 0) {
+        summary.min = value;
+        summary.max = value;
+      } else {
+        summary.min = std::min(summary.min, value);
+        summary.max = std::max(summary.max, value);
+      }
+      summary.last = value;
+      sums[i] += value;
+      summary.count++;
+    }
+  }
+  for (size_t i = 0; i < kMetricCount; ++i) {
+    if (summaries[i].count > 0) {
+      summaries[i].avg = sums[i] / summaries[i].count;
+    }
+  }
+  return summaries;
+}
+
+}  // namespace kiosk_system
@@ -0,0 +1,100 @@
+#ifndef PLUGINS_KIOSK_SYSTEM_METRICS_SAMPLE_H_
+#define PLUGINS_KIOSK_SYSTEM_METRICS_SAMPLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kiosk_system {
+
+constexpr int kMaxCores = 64;
+constexpr int kMaxThermalZones = 16;
+
+// Which sources could be read for a sample.
+enum MetricsSource : uint32_t {
+  kSourceCpu = 1 << 0,
+  kSourceMemory = 1 << 1,
+  kSourceProcess = 1 << 2,
+  kSourcePressure = 1 << 3,
+  kSourceThermal = 1 << 4,
+  kSourceFrequency = 1 << 5,
+  kSourceCgroup = 1 << 6,
+};
+
+// One reading of the system, plain data so the ring can copy it without
+// locks. Rates and fractions cover the interval since the previous sample.
+struct MetricsSample {
+  // CLOCK_MONOTONIC and wall clock.
+  int64_t time_us;
+  int64_t wall_ms;
+  uint32_t sources;
+
+  // Busy and iowait share of all cores, and busy share of each.
+  float cpu;
+  float cpu_iowait;
+  int32_t core_count;
+  float cores[kMaxCores];
+  // Mean current / maximum frequency over the cores; low while throttled.
+  float cpu_freq_ratio;
+
+  int64_t mem_total_kb;
+  int64_t mem_available_kb;
+  int64_t swap_total_kb;
+  int64_t swap_free_kb;
+
+  // This process, from /proc/self/smaps_rollup.
+  int64_t rss_kb;
+  int64_t pss_kb;
+  int64_t process_swap_kb;
+
+  // Share of the interval with tasks stalled, from /proc/pressure totals.
+  float psi_cpu_some;
+  float psi_memory_some;
+  float psi_memory_full;
+  float psi_io_some;
+  float psi_io_full;
+
+  float temp_max_c;
+  int32_t thermal_zone_count;
+  float thermal_c[kMaxThermalZones];
+  // Cumulative core throttle events where the CPU reports them (x86).
+  int64_t thermal_throttle_count;
+
+  // Our cgroup v2; max and high are -1 when unlimited.
+  int64_t cgroup_memory_kb;
+  int64_t cgroup_memory_max_kb;
+  int64_t cgroup_memory_high_kb;
+  int64_t cgroup_oom_kills;
+  int64_t cgroup_high_events;
+  // Share of the interval the cgroup's CPU quota held it back.
+  float cgroup_cpu_throttled;
+};
+
+// A scalar view of a sample, for windows and history.
+struct MetricInfo {
+  const char* name;
+  uint32_t source;
+  double (*value)(const MetricsSample& sample);
+};
+
+extern const MetricInfo kMetrics[];
+extern const size_t kMetricCount;
+
+// Returns the index into kMetrics, or -1.
+int FindMetric(const char* name);
+
+struct MetricSummary {
+  int count = 0;
+  double min = 0;
+  double max = 0;
+  double avg = 0;
+  double last = 0;
+};
+
+// Per-metric min/max/avg over |samples|; entries are indexed like kMetrics
+// and left with count 0 when no sample had the source.
+std::vector<MetricSummary> Summarize(const std::vector<MetricsSample>& samples);
+
+}  // namespace kiosk_system
+
+#endif  // PLUGINS_KIOSK_SYSTEM_METRICS_SAMPLE_H_
@@ -0,0 +1,148 @@
+#include "metrics_sampler.h"
+
+#include <time.h>
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "proc_reader.h"
+
+namespace kiosk_system {
+
+namespace {
+
+int64_t NowUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+int64_t WallMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+}  // namespace
+
+MetricsSampler::MetricsSampler() = default;
+
+MetricsSampler::~MetricsSampler() {
+  Stop();
+}
+
+void MetricsSampler::Start(const SamplerConfig& requested) {
+  SamplerConfig config = requested;
+  config.interval_ms = std::max(config.interval_ms, 50);
+  config.process_interval_ms =
+      std::max(config.process_interval_ms, config.interval_ms);
+  config.history = std::max<size_t>(config.history, 16);
+
+  if (ring_ != nullptr && ring_->capacity() < config.history) {
+    // A new ring means a new history; the writer must not be in the old
+    // one when it goes away.
+    Stop();
+    ring_.reset();
+  }
+  if (ring_ == nullptr) {
+    ring_.reset(new MetricsRing(config.history));
+  }
+  config.history = ring_->capacity();
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  config_ = config;
+  stats_.config = config;
+  if (thread_.joinable()) {
+    wake_.notify_all();
+    return;
+  }
+  stop_ = false;
+  stats_.running = true;
+  thread_ = std::thread(&MetricsSampler::Run, this);
+}
+
+void MetricsSampler::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    stats_.running = false;
+  }
+  wake_.notify_all();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+}
+
+void MetricsSampler::SetListener(SampleListener listener) {
+  std::lock_guard<std::mutex> lock(listener_mutex_);
+  listener_ = std::move(listener);
+}
+
+SamplerStats MetricsSampler::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void MetricsSampler::Run() {
+  ProcReader reader;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.cgroup_path = reader.cgroup_path();
+  }
+  MetricsRing* ring = ring_.get();
+  int64_t next_us = NowUs();
+  int64_t last_process_us = 0;
+  double total_cost_us = 0;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    const SamplerConfig config = config_;
+    lock.unlock();
+
+    const int64_t start_us = NowUs();
+    const bool read_process =
+        start_us - last_process_us >=
+        static_cast<int64_t>(config.process_interval_ms) * 1000;
+    if (read_process) {
+      last_process_us = start_us;
+    }
+    MetricsSample sample;
+    reader.Read(start_us, read_process, &sample);
+    sample.wall_ms = WallMs();
+    ring->Push(sample);
+    {
+      std::lock_guard<std::mutex> listener_lock(listener_mutex_);
+      if (listener_) {
+        listener_(sample);
+      }
+    }
+    const double cost_us = static_cast<double>(NowUs() - start_us);
+    total_cost_us += cost_us;
+
+    // Fixed rate: the next sample is due one interval after the last one
+    // was due, unless we fell a whole interval behind.
+    const int64_t interval_us =
+        static_cast<int64_t>(config.interval_ms) * 1000;
+    next_us += interval_us;
+    if (next_us < start_us) {
+      next_us = start_us + interval_us;
+    }
+
+    lock.lock();
+    stats_.samples++;
+    stats_.sample_cost_us = total_cost_us / stats_.samples;
+    stats_.max_sample_cost_us = std::max(stats_.max_sample_cost_us, cost_us);
+    // Start() notifies after changing the interval so it applies at once.
+    const int interval_ms = config.interval_ms;
+    wake_.wait_for(lock, std::chrono::microseconds(next_us - NowUs()),
+                   [this, interval_ms] {
+                     return stop_ || config_.interval_ms != interval_ms;
+                   });
+    if (config_.interval_ms != interval_ms) {
+      next_us = NowUs();
+    }
+  }
+}
+
+}  // namespace kiosk_system
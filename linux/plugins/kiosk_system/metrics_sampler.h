@@ -0,0 +1,82 @@
+#ifndef PLUGINS_KIOSK_SYSTEM_METRICS_SAMPLER_H_
+#define PLUGINS_KIOSK_SYSTEM_METRICS_SAMPLER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "metrics_ring.h"
+#include "metrics_sample.h"
+
+namespace kiosk_system {
+
+struct SamplerConfig {
+  int interval_ms = 1000;
+  // Samples kept; rounded up to a power of two.
+  size_t history = 1024;
+  // smaps_rollup walks every mapping, so it is read at most this often.
+  int process_interval_ms = 1000;
+};
+
+struct SamplerStats {
+  bool running = false;
+  SamplerConfig config;
+  uint64_t samples = 0;
+  // Mean and worst time spent taking one sample.
+  double sample_cost_us = 0;
+  double max_sample_cost_us = 0;
+  std::string cgroup_path;
+};
+
+// Samples the system on its own thread into a MetricsRing. Readers go
+// straight to the ring and never block the sampler.
+class MetricsSampler {
+ public:
+  // Called on the sampler thread after each sample; keep it short.
+  using SampleListener = std::function<void(const MetricsSample& sample)>;
+
+  MetricsSampler();
+  ~MetricsSampler();
+
+  // Disallow copy and assign.
+  MetricsSampler(const MetricsSampler&) = delete;
+  MetricsSampler& operator=(const MetricsSampler&) = delete;
+
+  // Starts sampling, or applies |config| to the running sampler. History
+  // survives unless its size changes.
+  void Start(const SamplerConfig& config);
+  void Stop();
+
+  // Replaces the listener; null removes it. Any thread.
+  void SetListener(SampleListener listener);
+
+  // Null until the first Start(). Replaced only by Start(), which must
+  // run on the same thread as the readers.
+  const MetricsRing* ring() const { return ring_.get(); }
+  SamplerStats stats() const;
+
+ private:
+  void Run();
+
+  std::unique_ptr<MetricsRing> ring_;
+  std::thread thread_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_ = false;
+  SamplerConfig config_;
+  SamplerStats stats_;
+
+  // Held by the sampler thread while it calls |listener_|.
+  std::mutex listener_mutex_;
+  SampleListener listener_;
+};
+
+}  // namespace kiosk_system
+
+#endif  // PLUGINS_KIOSK_SYSTEM_METRICS_SAMPLER_H_
@@ -0,0 +1,462 @@
+#include "proc_reader.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace kiosk_system {
+
+namespace {
+
+// Finds |key| at the start of a line and parses the integer after it.
+bool FindValue(const std::string& text, const char* key, int64_t* value) {
+  const size_t key_length = strlen(key);
+  size_t pos = 0;
+  while (pos < text.size()) {
+    if (text.compare(pos, key_length, key) == 0) {
+      const char* start = text.c_str() + pos + key_length;
+      char* end = nullptr;
+      const long long parsed = strtoll(start, &end, 10);
+      if (end == start) {
+        return false;
+      }
+      *value = parsed;
+      return true;
+    }
+    pos = text.find('\n', pos);
+    if (pos == std::string::npos) {
+      break;
+    }
+    ++pos;
+  }
+  return false;
+}
+
+// Parses "total=N" on the line starting with |prefix| in a PSI file.
+bool FindPressureTotal(const std::string& text, const char* prefix,
+                       uint64_t* total) {
+  const size_t prefix_length = strlen(prefix);
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const size_t end = std::min(text.find('\n', pos), text.size());
+    if (text.compare(pos, prefix_length, prefix) == 0) {
+      const size_t at = text.find("total=", pos);
+      if (at == std::string::npos || at > end) {
+        return false;
+      }
+      *total = strtoull(text.c_str() + at + 6, nullptr, 10);
+      return true;
+    }
+    pos = end + 1;
+  }
+  return false;
+}
+
+void CloseFd(int* fd) {
+  if (*fd >= 0) {
+    close(*fd);
+    *fd = -1;
+  }
+}
+
+float Share(double part, double whole) {
+  if (whole <= 0) {
+    return 0;
+  }
+  return static_cast<float>(std::min(1.0, std::max(0.0, part / whole)));
+}
+
+}  // namespace
+
+std::string CgroupDirectory(const std::string& root) {
+  const int fd = open((root + "/proc/self/cgroup").c_str(),
+                      O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::string();
+  }
+  char buffer[4096];
+  const ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (n <= 0) {
+    return std::string();
+  }
+  // "0::/user.slice/..." is our cgroup v2 membership.
+  const std::string text(buffer, static_cast<size_t>(n));
+  const size_t pos = text.find("0::");
+  if (pos == std::string::npos || (pos != 0 && text[pos - 1] != '\n')) {
+    return std::string();
+  }
+  const size_t end = text.find('\n', pos);
+  const size_t length =
+      end == std::string::npos ? std::string::npos : end - pos - 3;
+  return "/sys/fs/cgroup" + text.substr(pos + 3, length);
+}
+
+ProcReader::ProcReader(const std::string& root) : root_(root) {
+  buffer_.resize(8192);
+
+  stat_fd_ = Open("/proc/stat");
+  meminfo_fd_ = Open("/proc/meminfo");
+  smaps_fd_ = Open("/proc/self/smaps_rollup");
+  if (smaps_fd_ < 0) {
+    // Pre-4.14 kernels: RSS from status, without PSS.
+    smaps_fd_ = Open("/proc/self/status");
+  }
+  pressure_cpu_.fd = Open("/proc/pressure/cpu");
+  pressure_memory_.fd = Open("/proc/pressure/memory");
+  pressure_io_.fd = Open("/proc/pressure/io");
+
+  // Thermal zones in numeric order.
+  std::vector<int> zones;
+  DIR* dir = opendir((root_ + "/sys/class/thermal").c_str());
+  if (dir != nullptr) {
+    while (struct dirent* entry = readdir(dir)) {
+      if (strncmp(entry->d_name, "thermal_zone", 12) == 0) {
+        zones.push_back(atoi(entry->d_name + 12));
+      }
+    }
+    closedir(dir);
+  }
+  std::sort(zones.begin(), zones.end());
+  for (int zone : zones) {
+    if (static_cast<int>(thermal_fds_.size()) >= kMaxThermalZones) {
+      break;
+    }
+    const int fd = Open("/sys/class/thermal/thermal_zone" +
+                        std::to_string(zone) + "/temp");
+    if (fd >= 0) {
+      thermal_fds_.push_back(fd);
+    }
+  }
+
+  for (int cpu = 0; cpu < kMaxCores; ++cpu) {
+    const std::string base =
+        "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    const int throttle_fd =
+        Open(base + "/thermal_throttle/core_throttle_count");
+    if (throttle_fd >= 0) {
+      throttle_fds_.push_back(throttle_fd);
+    }
+    const int cur_fd = Open(base + "/cpufreq/scaling_cur_freq");
+    if (cur_fd < 0) {
+      continue;
+    }
+    int max_fd = Open(base + "/cpufreq/cpuinfo_max_freq");
+    int64_t max_khz = 0;
+    if (max_fd >= 0 && Load(max_fd)) {
+      max_khz = strtoll(buffer_.c_str(), nullptr, 10);
+    }
+    CloseFd(&max_fd);
+    if (max_khz <= 0) {
+      close(cur_fd);
+      continue;
+    }
+    freq_fds_.push_back(cur_fd);
+    freq_max_khz_.push_back(max_khz);
+  }
+
+  const std::string dir_path = CgroupDirectory(root_);
+  if (!dir_path.empty()) {
+    cgroup_current_fd_ = Open(dir_path + "/memory.current");
+  }
+  if (cgroup_current_fd_ >= 0) {
+    cgroup_path_ = root_ + dir_path;
+    cgroup_max_fd_ = Open(dir_path + "/memory.max");
+    cgroup_high_fd_ = Open(dir_path + "/memory.high");
+    cgroup_events_fd_ = Open(dir_path + "/memory.events");
+    cgroup_cpu_fd_ = Open(dir_path + "/cpu.stat");
+  }
+}
+
+ProcReader::~ProcReader() {
+  CloseFd(&stat_fd_);
+  CloseFd(&meminfo_fd_);
+  CloseFd(&smaps_fd_);
+  CloseFd(&pressure_cpu_.fd);
+  CloseFd(&pressure_memory_.fd);
+  CloseFd(&pressure_io_.fd);
+  for (int& fd : thermal_fds_) {
+    CloseFd(&fd);
+  }
+  for (int& fd : throttle_fds_) {
+    CloseFd(&fd);
+  }
+  for (int& fd : freq_fds_) {
+    CloseFd(&fd);
+  }
+  CloseFd(&cgroup_current_fd_);
+  CloseFd(&cgroup_max_fd_);
+  CloseFd(&cgroup_high_fd_);
+  CloseFd(&cgroup_events_fd_);
+  CloseFd(&cgroup_cpu_fd_);
+}
+
+int ProcReader::Open(const std::string& path) const {
+  return open((root_ + path).c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+bool ProcReader::Load(int fd) {
+  buffer_.resize(buffer_.capacity());
+  size_t total = 0;
+  while (true) {
+    if (total == buffer_.size()) {
+      buffer_.resize(buffer_.size() * 2);
+    }
+    const ssize_t n = pread(fd, &buffer_[total], buffer_.size() - total,
+                            static_cast<off_t>(total));
+    if (n < 0) {
+      buffer_.clear();
+      return false;
+    }
+    if (n == 0) {
+      break;
+    }
+    total += static_cast<size_t>(n);
+  }
+  buffer_.resize(total);
+  return total > 0;
+}
+
+void ProcReader::Read(int64_t now_us, bool read_process,
+                      MetricsSample* sample) {
+  memset(sample, 0, sizeof(*sample));
+  sample->time_us = now_us;
+  const double interval_us =
+      last_us_ > 0 ? static_cast<double>(now_us - last_us_) : 0.0;
+  last_us_ = now_us;
+
+  ReadCpu(interval_us, sample);
+  ReadMemory(sample);
+  if (read_process || !process_read_) {
+    ReadProcess();
+  }
+  if (process_read_) {
+    sample->rss_kb = rss_kb_;
+    sample->pss_kb = pss_kb_;
+    sample->process_swap_kb = swap_kb_;
+    sample->sources |= kSourceProcess;
+  }
+  ReadPressure(interval_us, sample);
+  ReadThermal(sample);
+  ReadFrequency(sample);
+  ReadCgroup(interval_us, sample);
+}
+
+void ProcReader::ReadCpu(double interval_us, MetricsSample* sample) {
+  if (stat_fd_ < 0 || !Load(stat_fd_)) {
+    return;
+  }
+  // "cpu" is the total, "cpuN" each core; fields are user nice system
+  // idle iowait irq softirq steal, in clock ticks.
+  size_t line = 0;
+  size_t index = 0;
+  bool primed = !cpu_times_.empty();
+  while (line < buffer_.size() && buffer_.compare(line, 3, "cpu") == 0 &&
+         index <= static_cast<size_t>(kMaxCores)) {
+    const char* p = buffer_.c_str() + line + 3;
+    while (*p != ' ' && *p != '\0') {
+      ++p;
+    }
+    uint64_t fields[8] = {};
+    for (uint64_t& field : fields) {
+      char* end = nullptr;
+      field = strtoull(p, &end, 10);
+      p = end;
+    }
+    CpuTimes now;
+    for (uint64_t field : fields) {
+      now.total += field;
+    }
+    now.iowait = fields[4];
+    now.busy = now.total - fields[3] - fields[4];
+
+    if (index >= cpu_times_.size()) {
+      cpu_times_.resize(index + 1);
+      primed = false;
+    }
+    const CpuTimes& before = cpu_times_[index];
+    const double total = static_cast<double>(now.total - before.total);
+    const float busy = Share(static_cast<double>(now.busy - before.busy),
+                             total);
+    if (index == 0) {
+      sample->cpu = busy;
+      sample->cpu_iowait =
+          Share(static_cast<double>(now.iowait - before.iowait), total);
+    } else {
+      sample->cores[index - 1] = busy;
+    }
+    cpu_times_[index] = now;
+    ++index;
+
+    const size_t next = buffer_.find('\n', line);
+    if (next == std::string::npos) {
+      break;
+    }
+    line = next + 1;
+  }
+  sample->core_count = index > 0 ? static_cast<int32_t>(index - 1) : 0;
+  if (primed && interval_us > 0) {
+    sample->sources |= kSourceCpu;
+  }
+}
+
+void ProcReader::ReadMemory(MetricsSample* sample) {
+  if (meminfo_fd_ < 0 || !Load(meminfo_fd_)) {
+    return;
+  }
+  int64_t value = 0;
+  if (!FindValue(buffer_, "MemTotal:", &value)) {
+    return;
+  }
+  sample->mem_total_kb = value;
+  if (FindValue(buffer_, "MemAvailable:", &value)) {
+    sample->mem_available_kb = value;
+  }
+  if (FindValue(buffer_, "SwapTotal:", &value)) {
+    sample->swap_total_kb = value;
+  }
+  if (FindValue(buffer_, "SwapFree:", &value)) {
+    sample->swap_free_kb = value;
+  }
+  sample->sources |= kSourceMemory;
+}
+
+void ProcReader::ReadProcess() {
+  if (smaps_fd_ < 0 || !Load(smaps_fd_)) {
+    return;
+  }
+  int64_t value = 0;
+  if (FindValue(buffer_, "Rss:", &value)) {
+    rss_kb_ = value;
+    pss_kb_ = FindValue(buffer_, "Pss:", &value) ? value : rss_kb_;
+    swap_kb_ = FindValue(buffer_, "Swap:", &value) ? value : 0;
+  } else if (FindValue(buffer_, "VmRSS:", &value)) {
+    rss_kb_ = value;
+    pss_kb_ = value;
+    swap_kb_ = FindValue(buffer_, "VmSwap:", &value) ? value : 0;
+  } else {
+    return;
+  }
+  process_read_ = true;
+}
+
+bool ProcReader::ReadPressureFile(PressureFile* file, double interval_us,
+                                  float* some, float* full) {
+  if (file->fd < 0 || !Load(file->fd)) {
+    return false;
+  }
+  uint64_t some_us = 0;
+  uint64_t full_us = 0;
+  if (!FindPressureTotal(buffer_, "some", &some_us)) {
+    return false;
+  }
+  FindPressureTotal(buffer_, "full", &full_us);
+  const bool primed = file->primed;
+  *some = Share(static_cast<double>(some_us - file->some_us), interval_us);
+  *full = Share(static_cast<double>(full_us - file->full_us), interval_us);
+  file->some_us = some_us;
+  file->full_us = full_us;
+  file->primed = true;
+  return primed && interval_us > 0;
+}
+
+void ProcReader::ReadPressure(double interval_us, MetricsSample* sample) {
+  float unused = 0;
+  const bool cpu = ReadPressureFile(&pressure_cpu_, interval_us,
+                                    &sample->psi_cpu_some, &unused);
+  const bool memory =
+      ReadPressureFile(&pressure_memory_, interval_us,
+                       &sample->psi_memory_some, &sample->psi_memory_full);
+  const bool io = ReadPressureFile(&pressure_io_, interval_us,
+                                   &sample->psi_io_some, &sample->psi_io_full);
+  if (cpu || memory || io) {
+    sample->sources |= kSourcePressure;
+  }
+}
+
+void ProcReader::ReadThermal(MetricsSample* sample) {
+  int count = 0;
+  float hottest = 0;
+  for (int fd : thermal_fds_) {
+    if (!Load(fd)) {
+      continue;
+    }
+    const float celsius = strtol(buffer_.c_str(), nullptr, 10) / 1000.0f;
+    sample->thermal_c[count++] = celsius;
+    hottest = count == 1 ? celsius : std::max(hottest, celsius);
+  }
+  int64_t throttles = 0;
+  for (int fd : throttle_fds_) {
+    if (Load(fd)) {
+      throttles += strtoll(buffer_.c_str(), nullptr, 10);
+    }
+  }
+  sample->thermal_throttle_count = throttles;
+  sample->thermal_zone_count = count;
+  sample->temp_max_c = hottest;
+  if (count > 0) {
+    sample->sources |= kSourceThermal;
+  }
+}
+
+void ProcReader::ReadFrequency(MetricsSample* sample) {
+  double sum = 0;
+  int count = 0;
+  for (size_t i = 0; i < freq_fds_.size(); ++i) {
+    if (!Load(freq_fds_[i])) {
+      continue;
+    }
+    sum += static_cast<double>(strtoll(buffer_.c_str(), nullptr, 10)) /
+           static_cast<double>(freq_max_khz_[i]);
+    ++count;
+  }
+  if (count > 0) {
+    sample->cpu_freq_ratio = static_cast<float>(sum / count);
+    sample->sources |= kSourceFrequency;
+  }
+}
+
+void ProcReader::ReadCgroup(double interval_us, MetricsSample* sample) {
+  if (cgroup_current_fd_ < 0 || !Load(cgroup_current_fd_)) {
+    return;
+  }
+  sample->cgroup_memory_kb = strtoll(buffer_.c_str(), nullptr, 10) / 1024;
+  sample->cgroup_memory_max_kb = -1;
+  sample->cgroup_memory_high_kb = -1;
+  if (cgroup_max_fd_ >= 0 && Load(cgroup_max_fd_) &&
+      buffer_.compare(0, 3, "max") != 0) {
+    sample->cgroup_memory_max_kb =
+        strtoll(buffer_.c_str(), nullptr, 10) / 1024;
+  }
+  if (cgroup_high_fd_ >= 0 && Load(cgroup_high_fd_) &&
+      buffer_.compare(0, 3, "max") != 0) {
+    sample->cgroup_memory_high_kb =
+        strtoll(buffer_.c_str(), nullptr, 10) / 1024;
+  }
+  int64_t value = 0;
+  if (cgroup_events_fd_ >= 0 && Load(cgroup_events_fd_)) {
+    if (FindValue(buffer_, "high ", &value)) {
+      sample->cgroup_high_events = value;
+    }
+    if (FindValue(buffer_, "oom_kill ", &value)) {
+      sample->cgroup_oom_kills = value;
+    }
+  }
+  if (cgroup_cpu_fd_ >= 0 && Load(cgroup_cpu_fd_) &&
+      FindValue(buffer_, "throttled_usec ", &value)) {
+    const uint64_t throttled = static_cast<uint64_t>(value);
+    if (cgroup_cpu_primed_) {
+      sample->cgroup_cpu_throttled = Share(
+          static_cast<double>(throttled - cgroup_throttled_us_), interval_us);
+    }
+    cgroup_throttled_us_ = throttled;
+    cgroup_cpu_primed_ = true;
+  }
+  sample->sources |= kSourceCgroup;
+}
+
+}  // namespace kiosk_system
@@ -0,0 +1,106 @@
+#ifndef PLUGINS_KIOSK_SYSTEM_PROC_READER_H_
+#define PLUGINS_KIOSK_SYSTEM_PROC_READER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "metrics_sample.h"
+
+namespace kiosk_system {
+
+// Our cgroup v2 directory, "/sys/fs/cgroup/...", from /proc/self/cgroup
+// under |root|; empty without cgroup v2.
+std::string CgroupDirectory(const std::string& root = "");
+
+// Reads /proc, /sys and our cgroup v2 directory into MetricsSample.
+//
+// Every file is opened once and re-read with pread() from offset 0, which
+// procfs, sysfs and cgroupfs regenerate on each read, so a sample costs a
+// few syscalls per source and no allocation. Sources that are missing
+// (no PSI, no thermal zones, cgroup v1) are left out of |sources|.
+class ProcReader {
+ public:
+  // |root| prefixes every path, for reading a captured tree in tests.
+  explicit ProcReader(const std::string& root = "");
+  ~ProcReader();
+
+  // Disallow copy and assign.
+  ProcReader(const ProcReader&) = delete;
+  ProcReader& operator=(const ProcReader&) = delete;
+
+  // Fills |sample|. Interval values compare against the previous call.
+  // smaps_rollup walks every mapping of the process, so it is only re-read
+  // when |read_process| is set; otherwise the previous values are kept.
+  void Read(int64_t now_us, bool read_process, MetricsSample* sample);
+
+  // The cgroup directory in use, empty without cgroup v2.
+  const std::string& cgroup_path() const { return cgroup_path_; }
+
+ private:
+  struct CpuTimes {
+    uint64_t busy = 0;
+    uint64_t iowait = 0;
+    uint64_t total = 0;
+  };
+  struct PressureFile {
+    int fd = -1;
+    uint64_t some_us = 0;
+    uint64_t full_us = 0;
+    bool primed = false;
+  };
+
+  int Open(const std::string& path) const;
+  // Reads the whole file behind |fd| into |buffer_|.
+  bool Load(int fd);
+
+  void ReadCpu(double interval_us, MetricsSample* sample);
+  void ReadMemory(MetricsSample* sample);
+  // Refreshes the cached rss_kb_, pss_kb_ and swap_kb_.
+  void ReadProcess();
+  void ReadPressure(double interval_us, MetricsSample* sample);
+  // Updates |file| from its totals and returns the some/full stall share.
+  bool ReadPressureFile(PressureFile* file, double interval_us, float* some,
+                        float* full);
+  void ReadThermal(MetricsSample* sample);
+  void ReadFrequency(MetricsSample* sample);
+  void ReadCgroup(double interval_us, MetricsSample* sample);
+
+  std::string root_;
+  std::string buffer_;
+  int64_t last_us_ = 0;
+
+  int stat_fd_ = -1;
+  std::vector<CpuTimes> cpu_times_;
+
+  int meminfo_fd_ = -1;
+
+  int smaps_fd_ = -1;
+  int64_t rss_kb_ = 0;
+  int64_t pss_kb_ = 0;
+  int64_t swap_kb_ = 0;
+  bool process_read_ = false;
+
+  PressureFile pressure_cpu_;
+  PressureFile pressure_memory_;
+  PressureFile pressure_io_;
+
+  std::vector<int> thermal_fds_;
+  std::vector<int> throttle_fds_;
+
+  std::vector<int> freq_fds_;
+  std::vector<int64_t> freq_max_khz_;
+
+  std::string cgroup_path_;
+  int cgroup_current_fd_ = -1;
+  int cgroup_max_fd_ = -1;
+  int cgroup_high_fd_ = -1;
+  int cgroup_events_fd_ = -1;
+  int cgroup_cpu_fd_ = -1;
+  uint64_t cgroup_throttled_us_ = 0;
+  bool cgroup_cpu_primed_ = false;
+};
+
+}  // namespace kiosk_system
+
+#endif  // PLUGINS_KIOSK_SYSTEM_PROC_READER_H_
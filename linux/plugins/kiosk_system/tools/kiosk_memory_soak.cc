@@ -0,0 +1,406 @@
+// Churns kiosk-like tiles through the allocator for simulated days and
+// reports whether the resident set stays bounded, with the memory
+// governor or without it, so allocator settings can be compared without
+// waiting weeks on a real kiosk.
+//
+//   kiosk_memory_soak [--days=7] [--no-governor] [options]
+//
+// Every tile a kiosk opens (web view, image, camera, media) leaves the
+// same pattern behind: thousands of small objects, decoded chunks and a
+// few frame-sized buffers, allocated on one thread and freed on another,
+// with a little of it kept in long-lived caches between the rest. The
+// live set is bounded by construction and counted, so what the resident
+// set holds beyond it is heap the allocator keeps; that must not grow.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "memory_governor.h"
+#include "metrics_sampler.h"
+#include "proc_reader.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char kUsage[] =
+    "Usage: kiosk_memory_soak [options]\n"
+    "\n"
+    "  --days=N              Simulated days (default 7).\n"
+    "  --tiles-per-hour=N    Tiles opened per simulated hour (default 120).\n"
+    "  --open-tiles=N        Tiles open at once (default 12).\n"
+    "  --threads=N           Threads opening and closing tiles (default 4).\n"
+    "  --no-governor         Leave glibc to itself, for the baseline.\n"
+    "  --arena-max=N         Malloc arenas with the governor (default 2).\n"
+    "  --trim-growth-mb=N    Trim after this much growth (default 32).\n"
+    "  --soft-limit-mb=N     Resident set that counts as pressure and\n"
+    "                        empties the tile caches (default off).\n"
+    "  --tolerance=F         Allowed growth of the retained heap after the\n"
+    "                        first day, as a share of it (default 0.10).\n"
+    "  --seed=N              Random seed (default 1).\n";
+
+// Long-lived strings kept across tiles, like parsed styles and log lines.
+const size_t kCacheEntries = 20000;
+
+// Bytes the simulation holds on purpose.
+std::atomic<int64_t> g_live_bytes{0};
+
+struct Options {
+  int days = 7;
+  int tiles_per_hour = 120;
+  int open_tiles = 12;
+  int threads = 4;
+  bool governor = true;
+  int arena_max = 2;
+  int trim_growth_mb = 32;
+  int soft_limit_mb = 0;
+  double tolerance = 0.10;
+  unsigned seed = 1;
+};
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    const std::string name = arg.substr(0, equals);
+    const std::string value =
+        equals == std::string::npos ? std::string() : arg.substr(equals + 1);
+    if (name == "--days") {
+      options->days = std::max(1, atoi(value.c_str()));
+    } else if (name == "--tiles-per-hour") {
+      options->tiles_per_hour = std::max(1, atoi(value.c_str()));
+    } else if (name == "--open-tiles") {
+      options->open_tiles = std::max(1, atoi(value.c_str()));
+    } else if (name == "--threads") {
+      options->threads = std::max(1, atoi(value.c_str()));
+    } else if (name == "--no-governor") {
+      options->governor = false;
+    } else if (name == "--arena-max") {
+      options->arena_max = std::max(0, atoi(value.c_str()));
+    } else if (name == "--trim-growth-mb") {
+      options->trim_growth_mb = std::max(0, atoi(value.c_str()));
+    } else if (name == "--soft-limit-mb") {
+      options->soft_limit_mb = std::max(0, atoi(value.c_str()));
+    } else if (name == "--tolerance") {
+      options->tolerance = atof(value.c_str());
+    } else if (name == "--seed") {
+      options->seed = static_cast<unsigned>(strtoul(value.c_str(), nullptr,
+                                                    10));
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs tasks on its own thread, so each worker allocates from the arena
+// glibc gave that thread.
+class Worker {
+ public:
+  Worker() : thread_(&Worker::Loop, this) {}
+  ~Worker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+  }
+
+  // Disallow copy and assign.
+  Worker(const Worker&) = delete;
+  Worker& operator=(const Worker&) = delete;
+
+  // Runs |task| on the worker and waits for it.
+  void Run(std::function<void()> task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    task_ = std::move(task);
+    wake_.notify_all();
+    wake_.wait(lock, [this]() { return !task_; });
+  }
+
+ private:
+  void Loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      wake_.wait(lock, [this]() { return stopping_ || task_; });
+      if (!task_) {
+        return;
+      }
+      lock.unlock();
+      task_();
+      lock.lock();
+      task_ = nullptr;
+      wake_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::function<void()> task_;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+class Cache {
+ public:
+  void Add(std::string entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    g_live_bytes += static_cast<int64_t>(entry.size());
+    entries_.push_back(std::move(entry));
+    while (entries_.size() > kCacheEntries) {
+      g_live_bytes -= static_cast<int64_t>(entries_.front().size());
+      entries_.pop_front();
+    }
+  }
+
+  // Drops the older half, as a tile cache would under pressure.
+  void Shrink() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < entries_.size() / 2; ++i) {
+      g_live_bytes -= static_cast<int64_t>(entries_[i].size());
+    }
+    entries_.erase(entries_.begin(),
+                   entries_.begin() + static_cast<long>(entries_.size() / 2));
+    entries_.shrink_to_fit();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::deque<std::string> entries_;
+};
+
+struct Tile {
+  ~Tile() { g_live_bytes -= bytes; }
+
+  int64_t bytes = 0;
+  std::vector<std::unique_ptr<char[]>> nodes;
+  std::vector<std::vector<uint8_t>> chunks;
+  std::vector<std::vector<uint8_t>> frames;
+};
+
+size_t Uniform(std::mt19937* random, size_t low, size_t high) {
+  return std::uniform_int_distribution<size_t>(low, high)(*random);
+}
+
+std::unique_ptr<Tile> OpenTile(std::mt19937* random, Cache* cache) {
+  std::unique_ptr<Tile> tile(new Tile());
+  const size_t nodes = Uniform(random, 1000, 3000);
+  tile->nodes.reserve(nodes);
+  for (size_t i = 0; i < nodes; ++i) {
+    const size_t size = Uniform(random, 32, 512);
+    tile->nodes.emplace_back(new char[size]);
+    memset(tile->nodes.back().get(), static_cast<int>(i), size);
+    tile->bytes += static_cast<int64_t>(size);
+    // A few survive the tile, between its other allocations.
+    if (i % 64 == 0) {
+      cache->Add(std::string(Uniform(random, 64, 1024), 'c'));
+    }
+  }
+  const size_t chunks = Uniform(random, 20, 80);
+  for (size_t i = 0; i < chunks; ++i) {
+    tile->chunks.emplace_back(Uniform(random, 4 << 10, 64 << 10),
+                              static_cast<uint8_t>(i));
+    tile->bytes += static_cast<int64_t>(tile->chunks.back().size());
+  }
+  // VGA to 720p RGBA frames and decoded images.
+  const size_t frames = Uniform(random, 1, 4);
+  for (size_t i = 0; i < frames; ++i) {
+    tile->frames.emplace_back(Uniform(random, 256 << 10, 3600 << 10),
+                              static_cast<uint8_t>(i));
+    tile->bytes += static_cast<int64_t>(tile->frames.back().size());
+  }
+  g_live_bytes += tile->bytes;
+  return tile;
+}
+
+struct DayStats {
+  int64_t min_kb = -1;
+  int64_t max_kb = 0;
+  // Resident set beyond the live bytes, sampled hourly.
+  std::vector<int64_t> retained_kb;
+
+  // Median, since a sample can land between a burst of frees and the
+  // trim that follows it.
+  int64_t retained_median_kb() const {
+    std::vector<int64_t> sorted = retained_kb;
+    if (sorted.empty()) {
+      return 0;
+    }
+    std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2,
+                     sorted.end());
+    return sorted[sorted.size() / 2];
+  }
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    fputs(kUsage, stderr);
+    return 2;
+  }
+
+  Cache cache;
+  // Before any worker thread exists, so the cap covers their arenas.
+  const int arena_limit = options.governor
+                              ? kiosk_system::LimitMallocArenas(
+                                    options.arena_max)
+                              : 0;
+  kiosk_system::MetricsSampler sampler;
+  kiosk_system::MemoryGovernor governor(
+      [](const kiosk_system::GovernorUpdate& update) {
+        for (const kiosk_system::ReleaseReport& report : update.reports) {
+          if (report.action != "malloc_trim" ||
+              update.level != kiosk_system::PressureLevel::kNone) {
+            printf("  %s (%s): %s %lld -> %lld MB\n",
+                   kiosk_system::PressureLevelName(report.level),
+                   report.reason.c_str(), report.action.c_str(),
+                   static_cast<long long>(report.rss_before_kb / 1024),
+                   static_cast<long long>(report.rss_after_kb / 1024));
+          }
+        }
+      });
+  if (options.governor) {
+    governor.AddAction("tile_cache", kiosk_system::PressureLevel::kModerate,
+                       [&cache](kiosk_system::PressureLevel) {
+                         cache.Shrink();
+                       });
+    kiosk_system::GovernorConfig config;
+    config.evaluate_ms = 100;
+    config.cooldown_ms = 2000;
+    config.trim_growth_kb = static_cast<int64_t>(options.trim_growth_mb)
+                            << 10;
+    config.rss_soft_limit_kb = static_cast<int64_t>(options.soft_limit_mb)
+                               << 10;
+    sampler.SetListener([&governor](const kiosk_system::MetricsSample& s) {
+      governor.OnSample(s);
+    });
+    kiosk_system::SamplerConfig sampler_config;
+    sampler_config.interval_ms = 100;
+    sampler_config.history = 64;
+    sampler.Start(sampler_config);
+    governor.Start(config, kiosk_system::CgroupDirectory());
+  }
+
+  printf("%d simulated days, %d tiles per hour, %d open, %d threads, %s\n",
+         options.days, options.tiles_per_hour, options.open_tiles,
+         options.threads,
+         options.governor ? "governor on" : "governor off");
+  if (options.governor) {
+    printf("Malloc arenas capped at %d, trim after %d MB of growth\n",
+           arena_limit, options.trim_growth_mb);
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (int i = 0; i < options.threads; ++i) {
+    workers.emplace_back(new Worker());
+  }
+  std::mt19937 random(options.seed);
+  std::deque<std::unique_ptr<Tile>> open;
+  std::vector<DayStats> days(static_cast<size_t>(options.days));
+  const Clock::time_point start = Clock::now();
+
+  const int64_t hours = static_cast<int64_t>(options.days) * 24;
+  int64_t tile = 0;
+  for (int64_t hour = 0; hour < hours; ++hour) {
+    for (int i = 0; i < options.tiles_per_hour; ++i, ++tile) {
+      // Opened on one thread and closed on the next, as decoded frames
+      // are handed from decoder threads to the UI.
+      const size_t opener = static_cast<size_t>(tile % options.threads);
+      workers[opener]->Run([&]() {
+        open.push_back(OpenTile(&random, &cache));
+      });
+      if (static_cast<int>(open.size()) > options.open_tiles) {
+        workers[(opener + 1) % workers.size()]->Run(
+            [&]() { open.pop_front(); });
+      }
+    }
+    const int64_t rss_kb = kiosk_system::ReadResidentKb();
+    DayStats& day = days[static_cast<size_t>(hour / 24)];
+    day.min_kb = day.min_kb < 0 ? rss_kb : std::min(day.min_kb, rss_kb);
+    day.max_kb = std::max(day.max_kb, rss_kb);
+    const int64_t retained_kb = rss_kb - g_live_bytes.load() / 1024;
+    day.retained_kb.push_back(retained_kb);
+    if (hour % 6 == 5) {
+      printf("day %2lld %02lld:00  rss %6lld MB  retained %6lld MB\n",
+             static_cast<long long>(hour / 24),
+             static_cast<long long>(hour % 24 + 1),
+             static_cast<long long>(rss_kb / 1024),
+             static_cast<long long>(retained_kb / 1024));
+      fflush(stdout);
+    }
+  }
+  const double wall_s =
+      std::chrono::duration<double>(Clock::now() - start).count();
+
+  printf("\nResident set per simulated day (MB):\n");
+  for (size_t i = 0; i < days.size(); ++i) {
+    printf("  day %2zu  min %6lld  max %6lld  retained %6lld\n", i,
+           static_cast<long long>(days[i].min_kb / 1024),
+           static_cast<long long>(days[i].max_kb / 1024),
+           static_cast<long long>(days[i].retained_median_kb() / 1024));
+  }
+  if (options.governor) {
+    const kiosk_system::GovernorStats stats = governor.stats();
+    printf("Governor: %llu evaluations, %llu releases, %llu trims, "
+           "%lld MB released, peak %lld MB\n",
+           static_cast<unsigned long long>(stats.evaluations),
+           static_cast<unsigned long long>(stats.releases),
+           static_cast<unsigned long long>(stats.trims),
+           static_cast<long long>(stats.released_kb / 1024),
+           static_cast<long long>(stats.peak_rss_kb / 1024));
+  }
+  printf("Wall time %.1f s for %lld tiles\n", wall_s,
+         static_cast<long long>(tile));
+
+  // The first day includes warm-up; the question is whether retention
+  // keeps climbing after it. A least-squares line through the hourly
+  // samples of the later days says so without hanging on one noisy day.
+  const size_t first_day = days.size() > 1 ? 1 : 0;
+  double n = 0, sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+  for (size_t i = first_day; i < days.size(); ++i) {
+    for (size_t h = 0; h < days[i].retained_kb.size(); ++h) {
+      const double x = static_cast<double>(i * 24 + h);
+      const double y = static_cast<double>(days[i].retained_kb[h]);
+      n += 1;
+      sum_x += x;
+      sum_y += y;
+      sum_xx += x * x;
+      sum_xy += x * y;
+    }
+  }
+  const double denominator = n * sum_xx - sum_x * sum_x;
+  const double slope_kb_per_hour =
+      denominator > 0 ? (n * sum_xy - sum_x * sum_y) / denominator : 0;
+  const double mean_kb = n > 0 ? sum_y / n : 0;
+  const double span_hours = static_cast<double>(
+      (days.size() - first_day) * 24);
+  const double growth_kb = slope_kb_per_hour * span_hours;
+  const bool bounded = growth_kb <= mean_kb * options.tolerance;
+  printf("%s: retained heap %.0f MB on average after day %zu, trending "
+         "%+.1f MB over %zu days (%.0f%% of it allowed)\n",
+         bounded ? "BOUNDED" : "GROWING", mean_kb / 1024, first_day,
+         growth_kb / 1024, days.size() - first_day, options.tolerance * 100);
+
+  open.clear();
+  workers.clear();
+  governor.Stop();
+  sampler.Stop();
+  return bounded ? 0 : 1;
+}
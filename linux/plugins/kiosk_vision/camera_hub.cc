@@ -0,0 +1,175 @@
+#include "camera_hub.h"
+
+#include <algorithm>
+
+namespace kiosk_vision {
+
+namespace {
+
+bool SameCapture(const CaptureConfig& a, const CaptureConfig& b) {
+  return a.device == b.device && a.width == b.width && a.height == b.height &&
+         a.fps == b.fps && a.format == b.format;
+}
+
+}  // namespace
+
+CameraHub::~CameraHub() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& entry : sessions_) {
+    entry.second->capture->Stop();
+  }
+  sessions_.clear();
+  consumers_.clear();
+}
+
+void CameraHub::SetJpegDecoder(V4l2Capture::JpegDecoder decoder) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  jpeg_decoder_ = std::move(decoder);
+}
+
+int CameraHub::Acquire(const CameraConsumerRequest& request,
+                       std::string* error) {
+  if (request.ring == nullptr) {
+    *error = "No ring to publish into";
+    return 0;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::unique_ptr<Session>& slot = sessions_[request.capture.device];
+  if (slot == nullptr) {
+    slot.reset(new Session());
+    slot->config = request.capture;
+    slot->capture.reset(new V4l2Capture(nullptr));
+    slot->capture->SetJpegDecoder(jpeg_decoder_);
+  }
+  Session* session = slot.get();
+  const CaptureConfig previous = session->config;
+
+  Consumer consumer;
+  consumer.id = next_id_++;
+  consumer.device = request.capture.device;
+  consumer.capture = request.capture;
+  consumer.output_id = session->capture->AddOutput(
+      request.ring, request.capture.publish_fps,
+      request.capture.publish_width, request.capture.publish_height);
+  consumers_[consumer.id] = consumer;
+  session->consumers.push_back(consumer.id);
+
+  if (Reconfigure(session, Combined(*session), error)) {
+    return consumer.id;
+  }
+
+  session->capture->RemoveOutput(consumer.output_id);
+  session->consumers.pop_back();
+  consumers_.erase(consumer.id);
+  if (session->consumers.empty()) {
+    session->capture->Stop();
+    sessions_.erase(consumer.device);
+  } else {
+    // Keep the others going at the size they had.
+    std::string ignored;
+    Reconfigure(session, previous, &ignored);
+  }
+  return 0;
+}
+
+bool CameraHub::Update(int id, double publish_fps, int publish_width,
+                       int publish_height) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto consumer = consumers_.find(id);
+  if (consumer == consumers_.end()) {
+    return false;
+  }
+  consumer->second.capture.publish_fps = publish_fps;
+  consumer->second.capture.publish_width = publish_width;
+  consumer->second.capture.publish_height = publish_height;
+  return sessions_[consumer->second.device]->capture->UpdateOutput(
+      consumer->second.output_id, publish_fps, publish_width,
+      publish_height);
+}
+
+void CameraHub::Release(int id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto consumer = consumers_.find(id);
+  if (consumer == consumers_.end()) {
+    return;
+  }
+  const std::string device = consumer->second.device;
+  Session* session = sessions_[device].get();
+  session->capture->RemoveOutput(consumer->second.output_id);
+  session->consumers.erase(std::remove(session->consumers.begin(),
+                                       session->consumers.end(), id),
+                           session->consumers.end());
+  consumers_.erase(consumer);
+
+  if (session->consumers.empty()) {
+    session->capture->Stop();
+    sessions_.erase(device);
+    return;
+  }
+  // Drop to the largest size still needed; stay as is if that fails.
+  const CaptureConfig previous = session->config;
+  std::string ignored;
+  if (!Reconfigure(session, Combined(*session), &ignored)) {
+    Reconfigure(session, previous, &ignored);
+  }
+}
+
+CaptureStats CameraHub::consumer_stats(int id) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto consumer = consumers_.find(id);
+  if (consumer == consumers_.end()) {
+    return CaptureStats();
+  }
+  const Session& session = *sessions_.at(consumer->second.device);
+  return session.capture->output_stats(consumer->second.output_id);
+}
+
+std::vector<CameraSessionInfo> CameraHub::sessions() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<CameraSessionInfo> sessions;
+  for (const auto& entry : sessions_) {
+    const Session& session = *entry.second;
+    CameraSessionInfo info;
+    info.capture = session.capture->stats();
+    for (int id : session.consumers) {
+      const Consumer& consumer = consumers_.at(id);
+      CameraConsumerInfo consumer_info;
+      consumer_info.id = id;
+      consumer_info.publish_fps = consumer.capture.publish_fps;
+      const CaptureStats stats =
+          session.capture->output_stats(consumer.output_id);
+      consumer_info.publish_width = stats.publish_width;
+      consumer_info.publish_height = stats.publish_height;
+      consumer_info.frames_published = stats.frames_published;
+      info.consumers.push_back(consumer_info);
+    }
+    sessions.push_back(info);
+  }
+  return sessions;
+}
+
+CaptureConfig CameraHub::Combined(const Session& session) const {
+  CaptureConfig config = session.config;
+  bool first = true;
+  for (int id : session.consumers) {
+    const CaptureConfig& wanted = consumers_.at(id).capture;
+    config.width = first ? wanted.width : std::max(config.width, wanted.width);
+    config.height =
+        first ? wanted.height : std::max(config.height, wanted.height);
+    config.fps = first ? wanted.fps : std::max(config.fps, wanted.fps);
+    first = false;
+  }
+  return config;
+}
+
+bool CameraHub::Reconfigure(Session* session, const CaptureConfig& config,
+                            std::string* error) {
+  if (session->capture->is_running() && SameCapture(session->config, config)) {
+    return true;
+  }
+  // Outputs survive the restart; only the stream is reopened.
+  session->config = config;
+  return session->capture->Start(config, error);
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,109 @@
+#ifndef PLUGINS_KIOSK_VISION_CAMERA_HUB_H_
+#define PLUGINS_KIOSK_VISION_CAMERA_HUB_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame_ring.h"
+#include "v4l2_capture.h"
+
+namespace kiosk_vision {
+
+// What one consumer wants from a camera. |capture| sets the device and the
+// smallest capture size and rate it needs; its publish fields set the rate
+// and size of the frames written into |ring|.
+struct CameraConsumerRequest {
+  CaptureConfig capture;
+  FrameRing* ring = nullptr;
+};
+
+struct CameraConsumerInfo {
+  int id = 0;
+  double publish_fps = 0;
+  int publish_width = 0;
+  int publish_height = 0;
+  uint64_t frames_published = 0;
+};
+
+struct CameraSessionInfo {
+  CaptureStats capture;
+  std::vector<CameraConsumerInfo> consumers;
+};
+
+// Shares each camera between any number of consumers, such as the detector
+// and on-screen previews.
+//
+// The first consumer of a device opens one V4L2 capture session; later ones
+// are added as outputs of the same session, each with its own ring, rate
+// and size, and the last one to leave closes it. The session captures at
+// the largest size and rate any consumer asked for and is restarted only
+// when a newcomer needs more, or the consumers still there need less. The
+// first consumer's pixel format is kept for the life of the session.
+//
+// All methods may block while a device is opened, so call them off the UI
+// thread where possible. They are serialized by one lock.
+class CameraHub {
+ public:
+  CameraHub() = default;
+  ~CameraHub();
+
+  // Disallow copy and assign.
+  CameraHub(const CameraHub&) = delete;
+  CameraHub& operator=(const CameraHub&) = delete;
+
+  // Used by sessions opened after the call.
+  void SetJpegDecoder(V4l2Capture::JpegDecoder decoder);
+
+  // Starts feeding |request.ring|, opening or restarting the device as
+  // needed. Returns the consumer id, or 0 with |error| set. A ring must be
+  // fed by one consumer only.
+  int Acquire(const CameraConsumerRequest& request, std::string* error);
+
+  // Changes the publish rate and size of consumer |id| without touching
+  // the stream.
+  bool Update(int id, double publish_fps, int publish_width,
+              int publish_height);
+
+  // Stops feeding the consumer's ring; returns once nothing writes into it
+  // any more. Unknown ids are ignored.
+  void Release(int id);
+
+  // Capture stats with the publish size and count of consumer |id|; not
+  // running for unknown ids.
+  CaptureStats consumer_stats(int id) const;
+
+  std::vector<CameraSessionInfo> sessions() const;
+
+ private:
+  struct Consumer {
+    int id = 0;
+    int output_id = 0;
+    std::string device;
+    CaptureConfig capture;
+  };
+
+  struct Session {
+    CaptureConfig config;
+    std::unique_ptr<V4l2Capture> capture;
+    std::vector<int> consumers;
+  };
+
+  // Capture config covering every consumer of |session|.
+  CaptureConfig Combined(const Session& session) const;
+  // Restarts |session| with |config| unless it already runs with it.
+  bool Reconfigure(Session* session, const CaptureConfig& config,
+                   std::string* error);
+
+  mutable std::mutex mutex_;
+  V4l2Capture::JpegDecoder jpeg_decoder_;
+  std::map<std::string, std::unique_ptr<Session>> sessions_;
+  std::map<int, Consumer> consumers_;
+  int next_id_ = 1;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_CAMERA_HUB_H_
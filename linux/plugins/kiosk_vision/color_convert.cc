@@ -0,0 +1,704 @@
+#include "color_convert.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KIOSK_VISION_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KIOSK_VISION_NEON 1
+#endif
+
+namespace kiosk_vision {
+
+namespace {
+
+// BT.601 limited range coefficients, scaled by 256.
+const int kYScale = 298;
+const int kVToR = 409;
+const int kUToG = -100;
+const int kVToG = -208;
+const int kUToB = 516;
+
+inline uint8_t Clamp255(int value) {
+  return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+// Writes one pixel as R, G, B, A (or B, G, R, A when |bgra|).
+inline void YuvToRgbaPixel(int y, int u, int v, bool bgra, uint8_t* out) {
+  const int c = (y - 16) * kYScale;
+  const int d = u - 128;
+  const int e = v - 128;
+  const uint8_t r = Clamp255((c + kVToR * e + 128) >> 8);
+  const uint8_t g = Clamp255((c + kUToG * d + kVToG * e + 128) >> 8);
+  const uint8_t b = Clamp255((c + kUToB * d + 128) >> 8);
+  out[0] = bgra ? b : r;
+  out[1] = g;
+  out[2] = bgra ? r : b;
+  out[3] = 255;
+}
+
+// Center-aligned nearest source index for output index |i|.
+inline int SampleIndex(int i, int src_extent, int dst_extent) {
+  const int s = static_cast<int>(
+      (static_cast<int64_t>(2 * i + 1) * src_extent) / (2 * dst_extent));
+  return std::min(s, src_extent - 1);
+}
+
+int ChromaRow(YuvFormat format, int luma_row) {
+  return format == YuvFormat::kYuyv ? luma_row : luma_row / 2;
+}
+
+// Offsets of the Y, U and V bytes for source column |x|, relative to the
+// start of the respective plane row.
+void SampleOffsets(YuvFormat format, int x, int* y, int* u, int* v) {
+  switch (format) {
+    case YuvFormat::kYuyv:
+      *y = x * 2;
+      *u = (x / 2) * 4 + 1;
+      *v = (x / 2) * 4 + 3;
+      break;
+    case YuvFormat::kNv12:
+      *y = x;
+      *u = (x / 2) * 2;
+      *v = (x / 2) * 2 + 1;
+      break;
+    case YuvFormat::kI420:
+    default:
+      *y = x;
+      *u = x / 2;
+      *v = x / 2;
+      break;
+  }
+}
+
+// Plane rows holding U and V. YUYV keeps everything in plane 0, NV12 keeps
+// both chroma samples in plane 1.
+const uint8_t* URow(const YuvImage& src, int chroma_row) {
+  const int plane = src.format == YuvFormat::kYuyv ? 0 : 1;
+  return src.planes[plane] +
+         static_cast<size_t>(chroma_row) * src.strides[plane];
+}
+
+const uint8_t* VRow(const YuvImage& src, int chroma_row) {
+  const int plane = src.format == YuvFormat::kYuyv
+                        ? 0
+                        : (src.format == YuvFormat::kNv12 ? 1 : 2);
+  return src.planes[plane] +
+         static_cast<size_t>(chroma_row) * src.strides[plane];
+}
+
+void PackRgbaToRgb(const uint8_t* rgba, uint8_t* rgb, int width) {
+  for (int x = 0; x < width; ++x) {
+    rgb[x * 3 + 0] = rgba[x * 4 + 0];
+    rgb[x * 3 + 1] = rgba[x * 4 + 1];
+    rgb[x * 3 + 2] = rgba[x * 4 + 2];
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Row kernels: planar Y/U/V (one chroma sample per pixel) to RGBA/BGRA.
+// All of them compute exactly the same 32-bit fixed point as
+// YuvToRgbaPixel(); the saturating packs implement Clamp255().
+// ---------------------------------------------------------------------------
+
+void YuvRowToRgbaScalar(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                        uint8_t* out, int width, bool bgra) {
+  for (int x = 0; x < width; ++x) {
+    YuvToRgbaPixel(y[x], u[x], v[x], bgra, out + x * 4);
+  }
+}
+
+#if defined(KIOSK_VISION_X86)
+
+// Eight pixels: |y|, |d| and |e| hold (Y - 16), (U - 128) and (V - 128) as
+// int16. Returns R, G and B as int16 in [0, 255], in pixel order.
+inline void YuvToRgb16Sse2(__m128i y, __m128i d, __m128i e, __m128i* r,
+                           __m128i* g, __m128i* b) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i round = _mm_set1_epi32(128);
+  const __m128i max = _mm_set1_epi16(255);
+  const __m128i k_y = _mm_setr_epi16(kYScale, 0, kYScale, 0, kYScale, 0,
+                                     kYScale, 0);
+  const __m128i k_r = _mm_setr_epi16(kVToR, 0, kVToR, 0, kVToR, 0, kVToR, 0);
+  const __m128i k_g = _mm_setr_epi16(kUToG, kVToG, kUToG, kVToG, kUToG,
+                                     kVToG, kUToG, kVToG);
+  const __m128i k_b = _mm_setr_epi16(kUToB, 0, kUToB, 0, kUToB, 0, kUToB, 0);
+
+  const __m128i c_lo =
+      _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, zero), k_y), round);
+  const __m128i c_hi =
+      _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, zero), k_y), round);
+
+  const __m128i r_lo = _mm_srai_epi32(
+      _mm_add_epi32(c_lo, _mm_madd_epi16(_mm_unpacklo_epi16(e, zero), k_r)),
+      8);
+  const __m128i r_hi = _mm_srai_epi32(
+      _mm_add_epi32(c_hi, _mm_madd_epi16(_mm_unpackhi_epi16(e, zero), k_r)),
+      8);
+  const __m128i g_lo = _mm_srai_epi32(
+      _mm_add_epi32(c_lo, _mm_madd_epi16(_mm_unpacklo_epi16(d, e), k_g)), 8);
+  const __m128i g_hi = _mm_srai_epi32(
+      _mm_add_epi32(c_hi, _mm_madd_epi16(_mm_unpackhi_epi16(d, e), k_g)), 8);
+  const __m128i b_lo = _mm_srai_epi32(
+      _mm_add_epi32(c_lo, _mm_madd_epi16(_mm_unpacklo_epi16(d, zero), k_b)),
+      8);
+  const __m128i b_hi = _mm_srai_epi32(
+      _mm_add_epi32(c_hi, _mm_madd_epi16(_mm_unpackhi_epi16(d, zero), k_b)),
+      8);
+
+  *r = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(r_lo, r_hi), zero), max);
+  *g = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(g_lo, g_hi), zero), max);
+  *b = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(b_lo, b_hi), zero), max);
+}
+
+void YuvRowToRgbaSse2(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                      uint8_t* out, int width, bool bgra) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i y_bias = _mm_set1_epi16(16);
+  const __m128i uv_bias = _mm_set1_epi16(128);
+  const __m128i alpha = _mm_set1_epi16(static_cast<int16_t>(0xFF00));
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m128i y16 = _mm_sub_epi16(
+        _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x)), zero),
+        y_bias);
+    const __m128i d16 = _mm_sub_epi16(
+        _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x)), zero),
+        uv_bias);
+    const __m128i e16 = _mm_sub_epi16(
+        _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x)), zero),
+        uv_bias);
+    __m128i r, g, b;
+    YuvToRgb16Sse2(y16, d16, e16, &r, &g, &b);
+    if (bgra) {
+      std::swap(r, b);
+    }
+    // Each 16-bit lane becomes two output bytes: (R, G) and (B, A).
+    const __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+    const __m128i ba = _mm_or_si128(b, alpha);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4),
+                     _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4 + 16),
+                     _mm_unpackhi_epi16(rg, ba));
+  }
+  YuvRowToRgbaScalar(y + x, u + x, v + x, out + x * 4, width - x, bgra);
+}
+
+// Same as the SSE2 kernel on sixteen pixels. Widening with cvtepu8 keeps
+// pixel order across both 128-bit lanes; the in-lane unpack/pack pairs
+// cancel out, so only the final RGBA interleave needs a lane permute.
+__attribute__((target("avx2"))) void YuvRowToRgbaAvx2(const uint8_t* y,
+                                                      const uint8_t* u,
+                                                      const uint8_t* v,
+                                                      uint8_t* out,
+                                                      int width, bool bgra) {
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i round = _mm256_set1_epi32(128);
+  const __m256i max = _mm256_set1_epi16(255);
+  const __m256i y_bias = _mm256_set1_epi16(16);
+  const __m256i uv_bias = _mm256_set1_epi16(128);
+  const __m256i alpha = _mm256_set1_epi16(static_cast<int16_t>(0xFF00));
+  const __m256i k_y = _mm256_set1_epi32(kYScale);
+  const __m256i k_r = _mm256_set1_epi32(kVToR);
+  const __m256i k_g = _mm256_set1_epi32(
+      static_cast<int32_t>((static_cast<uint32_t>(kVToG) << 16) |
+                           static_cast<uint16_t>(kUToG)));
+  const __m256i k_b = _mm256_set1_epi32(kUToB);
+
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m256i y16 = _mm256_sub_epi16(
+        _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x))),
+        y_bias);
+    const __m256i d16 = _mm256_sub_epi16(
+        _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x))),
+        uv_bias);
+    const __m256i e16 = _mm256_sub_epi16(
+        _mm256_cvtepu8_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + x))),
+        uv_bias);
+
+    const __m256i c_lo = _mm256_add_epi32(
+        _mm256_madd_epi16(_mm256_unpacklo_epi16(y16, zero), k_y), round);
+    const __m256i c_hi = _mm256_add_epi32(
+        _mm256_madd_epi16(_mm256_unpackhi_epi16(y16, zero), k_y), round);
+    const __m256i r_lo = _mm256_srai_epi32(
+        _mm256_add_epi32(
+            c_lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(e16, zero), k_r)),
+        8);
+    const __m256i r_hi = _mm256_srai_epi32(
+        _mm256_add_epi32(
+            c_hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(e16, zero), k_r)),
+        8);
+    const __m256i g_lo = _mm256_srai_epi32(
+        _mm256_add_epi32(
+            c_lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(d16, e16), k_g)),
+        8);
+    const __m256i g_hi = _mm256_srai_epi32(
+        _mm256_add_epi32(
+            c_hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(d16, e16), k_g)),
+        8);
+    const __m256i b_lo = _mm256_srai_epi32(
+        _mm256_add_epi32(
+            c_lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(d16, zero), k_b)),
+        8);
+    const __m256i b_hi = _mm256_srai_epi32(
+        _mm256_add_epi32(
+            c_hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(d16, zero), k_b)),
+        8);
+
+    __m256i r = _mm256_min_epi16(
+        _mm256_max_epi16(_mm256_packs_epi32(r_lo, r_hi), zero), max);
+    const __m256i g = _mm256_min_epi16(
+        _mm256_max_epi16(_mm256_packs_epi32(g_lo, g_hi), zero), max);
+    __m256i b = _mm256_min_epi16(
+        _mm256_max_epi16(_mm256_packs_epi32(b_lo, b_hi), zero), max);
+    if (bgra) {
+      std::swap(r, b);
+    }
+
+    const __m256i rg = _mm256_or_si256(r, _mm256_slli_epi16(g, 8));
+    const __m256i ba = _mm256_or_si256(b, alpha);
+    const __m256i lo = _mm256_unpacklo_epi16(rg, ba);  // 0-3 | 8-11
+    const __m256i hi = _mm256_unpackhi_epi16(rg, ba);  // 4-7 | 12-15
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4),
+                        _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4 + 32),
+                        _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+  YuvRowToRgbaSse2(y + x, u + x, v + x, out + x * 4, width - x, bgra);
+}
+
+bool CpuHasAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+#elif defined(KIOSK_VISION_NEON)
+
+void YuvRowToRgbaNeon(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                      uint8_t* out, int width, bool bgra) {
+  const int16x8_t y_bias = vdupq_n_s16(16);
+  const int16x8_t uv_bias = vdupq_n_s16(128);
+  const int32x4_t round = vdupq_n_s32(128);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const int16x8_t y16 = vsubq_s16(
+        vreinterpretq_s16_u16(vmovl_u8(vld1_u8(y + x))), y_bias);
+    const int16x8_t d16 = vsubq_s16(
+        vreinterpretq_s16_u16(vmovl_u8(vld1_u8(u + x))), uv_bias);
+    const int16x8_t e16 = vsubq_s16(
+        vreinterpretq_s16_u16(vmovl_u8(vld1_u8(v + x))), uv_bias);
+
+    const int32x4_t c_lo =
+        vmlal_n_s16(round, vget_low_s16(y16), kYScale);
+    const int32x4_t c_hi =
+        vmlal_n_s16(round, vget_high_s16(y16), kYScale);
+    const int32x4_t r_lo = vmlal_n_s16(c_lo, vget_low_s16(e16), kVToR);
+    const int32x4_t r_hi = vmlal_n_s16(c_hi, vget_high_s16(e16), kVToR);
+    const int32x4_t g_lo = vmlal_n_s16(
+        vmlal_n_s16(c_lo, vget_low_s16(d16), kUToG), vget_low_s16(e16),
+        kVToG);
+    const int32x4_t g_hi = vmlal_n_s16(
+        vmlal_n_s16(c_hi, vget_high_s16(d16), kUToG), vget_high_s16(e16),
+        kVToG);
+    const int32x4_t b_lo = vmlal_n_s16(c_lo, vget_low_s16(d16), kUToB);
+    const int32x4_t b_hi = vmlal_n_s16(c_hi, vget_high_s16(d16), kUToB);
+
+    const uint8x8_t r = vqmovun_s16(
+        vcombine_s16(vshrn_n_s32(r_lo, 8), vshrn_n_s32(r_hi, 8)));
+    const uint8x8_t g = vqmovun_s16(
+        vcombine_s16(vshrn_n_s32(g_lo, 8), vshrn_n_s32(g_hi, 8)));
+    const uint8x8_t b = vqmovun_s16(
+        vcombine_s16(vshrn_n_s32(b_lo, 8), vshrn_n_s32(b_hi, 8)));
+    uint8x8x4_t rgba;
+    rgba.val[0] = bgra ? b : r;
+    rgba.val[1] = g;
+    rgba.val[2] = bgra ? r : b;
+    rgba.val[3] = vdup_n_u8(255);
+    vst4_u8(out + x * 4, rgba);
+  }
+  YuvRowToRgbaScalar(y + x, u + x, v + x, out + x * 4, width - x, bgra);
+}
+
+#endif
+
+}  // namespace
+
+bool WrapYuvBuffer(const uint8_t* data, size_t size, YuvFormat format,
+                   int width, int height, int stride, YuvImage* image) {
+  if (data == nullptr || width <= 0 || height <= 0) {
+    return false;
+  }
+  const int chroma_width = (width + 1) / 2;
+  const int chroma_height = (height + 1) / 2;
+  YuvImage result;
+  result.format = format;
+  result.width = width;
+  result.height = height;
+  result.planes[0] = data;
+
+  size_t needed = 0;
+  switch (format) {
+    case YuvFormat::kYuyv:
+      result.strides[0] = stride > 0 ? stride : chroma_width * 4;
+      needed = static_cast<size_t>(result.strides[0]) * height;
+      break;
+    case YuvFormat::kNv12: {
+      result.strides[0] = stride > 0 ? stride : width;
+      result.strides[1] = std::max(result.strides[0], chroma_width * 2);
+      const size_t luma = static_cast<size_t>(result.strides[0]) * height;
+      result.planes[1] = data + luma;
+      needed = luma + static_cast<size_t>(result.strides[1]) * chroma_height;
+      break;
+    }
+    case YuvFormat::kI420:
+    default: {
+      result.strides[0] = stride > 0 ? stride : width;
+      result.strides[1] = stride > 0 ? (stride + 1) / 2 : chroma_width;
+      result.strides[2] = result.strides[1];
+      const size_t luma = static_cast<size_t>(result.strides[0]) * height;
+      const size_t chroma =
+          static_cast<size_t>(result.strides[1]) * chroma_height;
+      result.planes[1] = data + luma;
+      result.planes[2] = data + luma + chroma;
+      needed = luma + 2 * chroma;
+      break;
+    }
+  }
+  if (size < needed) {
+    return false;
+  }
+  *image = result;
+  return true;
+}
+
+void ConvertYuvScalar(const YuvImage& src, uint8_t* dst, int dst_stride,
+                      int dst_width, int dst_height, PixelFormat dst_format) {
+  const bool bgra = dst_format == PixelFormat::kBgra;
+  const int bytes_per_pixel = dst_format == PixelFormat::kRgb ? 3 : 4;
+  for (int y = 0; y < dst_height; ++y) {
+    const int sy = SampleIndex(y, src.height, dst_height);
+    const int cy = ChromaRow(src.format, sy);
+    const uint8_t* y_row =
+        src.planes[0] + static_cast<size_t>(sy) * src.strides[0];
+    const uint8_t* u_row = URow(src, cy);
+    const uint8_t* v_row = VRow(src, cy);
+    uint8_t* out = dst + static_cast<size_t>(y) * dst_stride;
+    for (int x = 0; x < dst_width; ++x) {
+      int y_offset, u_offset, v_offset;
+      SampleOffsets(src.format, SampleIndex(x, src.width, dst_width),
+                    &y_offset, &u_offset, &v_offset);
+      uint8_t rgba[4];
+      YuvToRgbaPixel(y_row[y_offset], u_row[u_offset], v_row[v_offset], bgra,
+                     rgba);
+      memcpy(out + x * bytes_per_pixel, rgba, bytes_per_pixel);
+    }
+  }
+}
+
+void ResamplePacked(const ImageView& src, uint8_t* dst, int dst_stride,
+                    int dst_width, int dst_height) {
+  const int bytes_per_pixel = src.format == PixelFormat::kRgb ? 3 : 4;
+  const size_t row_bytes = static_cast<size_t>(dst_width) * bytes_per_pixel;
+  for (int y = 0; y < dst_height; ++y) {
+    const uint8_t* row =
+        src.data +
+        static_cast<size_t>(SampleIndex(y, src.height, dst_height)) *
+            src.stride;
+    uint8_t* out = dst + static_cast<size_t>(y) * dst_stride;
+    if (dst_width == src.width) {
+      memcpy(out, row, row_bytes);
+      continue;
+    }
+    for (int x = 0; x < dst_width; ++x) {
+      memcpy(out + x * bytes_per_pixel,
+             row + SampleIndex(x, src.width, dst_width) * bytes_per_pixel,
+             bytes_per_pixel);
+    }
+  }
+}
+
+YuvConverter::YuvConverter() {
+#if defined(KIOSK_VISION_X86)
+  use_avx2_ = CpuHasAvx2();
+#endif
+}
+
+const char* YuvConverter::kernel_name() const {
+#if defined(KIOSK_VISION_X86)
+  return use_avx2_ ? "avx2" : "sse2";
+#elif defined(KIOSK_VISION_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+void YuvConverter::UpdatePlan(const YuvImage& src, int dst_width,
+                              int dst_height) {
+  if (src.format == format_ && src.width == src_width_ &&
+      src.height == src_height_ && dst_width == dst_width_ &&
+      dst_height == dst_height_) {
+    return;
+  }
+  format_ = src.format;
+  src_width_ = src.width;
+  src_height_ = src.height;
+  dst_width_ = dst_width;
+  dst_height_ = dst_height;
+
+  y_offset_.resize(dst_width);
+  u_offset_.resize(dst_width);
+  v_offset_.resize(dst_width);
+  for (int x = 0; x < dst_width; ++x) {
+    SampleOffsets(src.format, SampleIndex(x, src.width, dst_width),
+                  &y_offset_[x], &u_offset_[x], &v_offset_[x]);
+  }
+  src_row_.resize(dst_height);
+  for (int y = 0; y < dst_height; ++y) {
+    src_row_[y] = SampleIndex(y, src.height, dst_height);
+  }
+  luma_in_place_ =
+      src.format != YuvFormat::kYuyv && dst_width == src.width;
+
+  y_row_.resize(dst_width);
+  u_row_.resize(dst_width);
+  v_row_.resize(dst_width);
+  rgba_row_.resize(static_cast<size_t>(dst_width) * 4);
+}
+
+void YuvConverter::Convert(const YuvImage& src, uint8_t* dst, int dst_stride,
+                           int dst_width, int dst_height,
+                           PixelFormat dst_format) {
+  if (src.width <= 0 || src.height <= 0 || dst_width <= 0 ||
+      dst_height <= 0) {
+    return;
+  }
+  UpdatePlan(src, dst_width, dst_height);
+
+  const bool bgra = dst_format == PixelFormat::kBgra;
+  const bool packed_rgb = dst_format == PixelFormat::kRgb;
+  const int* y_offset = y_offset_.data();
+  const int* u_offset = u_offset_.data();
+  const int* v_offset = v_offset_.data();
+  uint8_t* y_row = y_row_.data();
+  uint8_t* u_row = u_row_.data();
+  uint8_t* v_row = v_row_.data();
+
+  for (int y = 0; y < dst_height; ++y) {
+    const int sy = src_row_[y];
+    const int cy = ChromaRow(src.format, sy);
+    const uint8_t* y_src =
+        src.planes[0] + static_cast<size_t>(sy) * src.strides[0];
+    const uint8_t* u_src = URow(src, cy);
+    const uint8_t* v_src = VRow(src, cy);
+
+    const uint8_t* luma = y_row;
+    if (luma_in_place_) {
+      luma = y_src;
+    } else {
+      for (int x = 0; x < dst_width; ++x) {
+        y_row[x] = y_src[y_offset[x]];
+      }
+    }
+    for (int x = 0; x < dst_width; ++x) {
+      u_row[x] = u_src[u_offset[x]];
+      v_row[x] = v_src[v_offset[x]];
+    }
+
+    uint8_t* out = dst + static_cast<size_t>(y) * dst_stride;
+    uint8_t* rgba = packed_rgb ? rgba_row_.data() : out;
+#if defined(KIOSK_VISION_X86)
+    if (use_avx2_) {
+      YuvRowToRgbaAvx2(luma, u_row, v_row, rgba, dst_width, bgra);
+    } else {
+      YuvRowToRgbaSse2(luma, u_row, v_row, rgba, dst_width, bgra);
+    }
+#elif defined(KIOSK_VISION_NEON)
+    YuvRowToRgbaNeon(luma, u_row, v_row, rgba, dst_width, bgra);
+#else
+    YuvRowToRgbaScalar(luma, u_row, v_row, rgba, dst_width, bgra);
+#endif
+    if (packed_rgb) {
+      PackRgbaToRgb(rgba, out, dst_width);
+    }
+  }
+}
+
+const char* YuvFormatName(YuvFormat format) {
+  switch (format) {
+    case YuvFormat::kYuyv:
+      return "yuyv";
+    case YuvFormat::kNv12:
+      return "nv12";
+    case YuvFormat::kI420:
+    default:
+      return "i420";
+  }
+}
+
+namespace {
+
+size_t YuvBufferSize(YuvFormat format, int width, int height) {
+  const size_t chroma =
+      static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+  switch (format) {
+    case YuvFormat::kYuyv:
+      return static_cast<size_t>((width + 1) / 2) * 4 * height;
+    case YuvFormat::kNv12:
+    case YuvFormat::kI420:
+    default:
+      return static_cast<size_t>(width) * height + 2 * chroma;
+  }
+}
+
+const YuvFormat kAllYuvFormats[] = {YuvFormat::kYuyv, YuvFormat::kNv12,
+                                    YuvFormat::kI420};
+
+}  // namespace
+
+int VerifyYuvConverter(std::string* report) {
+  struct Case {
+    int src_width;
+    int src_height;
+    int dst_width;
+    int dst_height;
+  };
+  // Odd sizes and widths that are not a multiple of the vector width
+  // exercise the chroma edge and the scalar tails.
+  const Case kCases[] = {
+      {640, 480, 640, 480}, {640, 480, 300, 300}, {1280, 720, 320, 180},
+      {33, 17, 33, 17},     {37, 29, 15, 9},      {8, 2, 16, 4},
+      {1, 1, 1, 1},         {1920, 1080, 300, 300},
+  };
+  const PixelFormat kOutputs[] = {PixelFormat::kRgba, PixelFormat::kBgra,
+                                  PixelFormat::kRgb};
+
+  std::mt19937 random(1234);
+  YuvConverter converter;
+  int failures = 0;
+  int checked = 0;
+  for (const Case& c : kCases) {
+    for (YuvFormat format : kAllYuvFormats) {
+      std::vector<uint8_t> buffer(
+          YuvBufferSize(format, c.src_width, c.src_height));
+      for (uint8_t& byte : buffer) {
+        byte = static_cast<uint8_t>(random());
+      }
+      YuvImage image;
+      if (!WrapYuvBuffer(buffer.data(), buffer.size(), format, c.src_width,
+                         c.src_height, 0, &image)) {
+        failures++;
+        continue;
+      }
+      for (PixelFormat output : kOutputs) {
+        const int stride = c.dst_width * (output == PixelFormat::kRgb ? 3 : 4);
+        std::vector<uint8_t> expected(
+            static_cast<size_t>(stride) * c.dst_height);
+        std::vector<uint8_t> actual(expected.size());
+        ConvertYuvScalar(image, expected.data(), stride, c.dst_width,
+                         c.dst_height, output);
+        converter.Convert(image, actual.data(), stride, c.dst_width,
+                          c.dst_height, output);
+        checked++;
+        if (expected != actual) {
+          if (failures == 0) {
+            const size_t index = static_cast<size_t>(
+                std::mismatch(expected.begin(), expected.end(),
+                              actual.begin())
+                    .first -
+                expected.begin());
+            std::ostringstream message;
+            message << YuvFormatName(format) << " " << c.src_width << "x"
+                    << c.src_height << " -> " << c.dst_width << "x"
+                    << c.dst_height << " differs at byte " << index
+                    << ": expected " << static_cast<int>(expected[index])
+                    << ", got " << static_cast<int>(actual[index]);
+            *report = message.str();
+          }
+          failures++;
+        }
+      }
+    }
+  }
+  if (failures == 0) {
+    std::ostringstream message;
+    message << checked << " conversions match the scalar reference ("
+            << converter.kernel_name() << ")";
+    *report = message.str();
+  }
+  return failures;
+}
+
+std::vector<ColorBenchmark> BenchmarkYuvConverter(int src_width,
+                                                  int src_height,
+                                                  int dst_width,
+                                                  int dst_height,
+                                                  int iterations) {
+  using Clock = std::chrono::steady_clock;
+  std::vector<ColorBenchmark> results;
+  if (src_width <= 0 || src_height <= 0 || dst_width <= 0 ||
+      dst_height <= 0 || iterations <= 0) {
+    return results;
+  }
+
+  std::mt19937 random(42);
+  YuvConverter converter;
+  const int stride = dst_width * 4;
+  std::vector<uint8_t> output(static_cast<size_t>(stride) * dst_height);
+  for (YuvFormat format : kAllYuvFormats) {
+    std::vector<uint8_t> buffer(YuvBufferSize(format, src_width, src_height));
+    for (uint8_t& byte : buffer) {
+      byte = static_cast<uint8_t>(random());
+    }
+    YuvImage image;
+    WrapYuvBuffer(buffer.data(), buffer.size(), format, src_width, src_height,
+                  0, &image);
+
+    ColorBenchmark result;
+    result.format = format;
+    // One untimed pass builds the sampling tables.
+    converter.Convert(image, output.data(), stride, dst_width, dst_height,
+                      PixelFormat::kRgba);
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      converter.Convert(image, output.data(), stride, dst_width, dst_height,
+                        PixelFormat::kRgba);
+    }
+    result.simd_ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count() /
+        iterations;
+
+    start = Clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      ConvertYuvScalar(image, output.data(), stride, dst_width, dst_height,
+                       PixelFormat::kRgba);
+    }
+    result.scalar_ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start)
+            .count() /
+        iterations;
+    result.megapixels_per_second =
+        result.simd_ms > 0
+            ? static_cast<double>(dst_width) * dst_height / 1000.0 /
+                  result.simd_ms
+            : 0;
+    results.push_back(result);
+  }
+  return results;
+}
+
+}  // namespace kiosk_vision
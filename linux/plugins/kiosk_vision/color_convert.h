@@ -0,0 +1,115 @@
+#ifndef PLUGINS_KIOSK_VISION_COLOR_CONVERT_H_
+#define PLUGINS_KIOSK_VISION_COLOR_CONVERT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "frame_preprocessor.h"
+
+namespace kiosk_vision {
+
+// Camera and WebRTC frame layouts.
+enum class YuvFormat {
+  kYuyv,  // Packed 4:2:2, Y0 U Y1 V.
+  kNv12,  // Y plane, then interleaved U/V at half resolution.
+  kI420,  // Y, U and V planes, chroma at half resolution.
+};
+
+// Non-owning view of a YUV image. Unused planes are null.
+struct YuvImage {
+  YuvFormat format = YuvFormat::kYuyv;
+  int width = 0;
+  int height = 0;
+  const uint8_t* planes[3] = {nullptr, nullptr, nullptr};
+  int strides[3] = {0, 0, 0};
+};
+
+// Describes a tightly packed buffer as delivered by V4L2 or libwebrtc.
+// |stride| is the luma (or YUYV) row pitch; 0 means no padding. Returns
+// false if |size| is too small.
+bool WrapYuvBuffer(const uint8_t* data, size_t size, YuvFormat format,
+                   int width, int height, int stride, YuvImage* image);
+
+// Converts |src| to |dst_format| (RGBA, BGRA or RGB) at |dst_width| x
+// |dst_height|, point-sampling at pixel centers when the sizes differ, so
+// downscaling costs nothing extra. BT.601 limited range, 8-bit fixed point,
+// alpha 255. Plain scalar version, kept as the exact reference for
+// YuvConverter.
+void ConvertYuvScalar(const YuvImage& src, uint8_t* dst, int dst_stride,
+                      int dst_width, int dst_height, PixelFormat dst_format);
+
+// Point-samples packed |src| to |dst_width| x |dst_height| in the same
+// pixel format, at pixel centers like the YUV conversions. Copies rows
+// unchanged when the sizes match.
+void ResamplePacked(const ImageView& src, uint8_t* dst, int dst_stride,
+                    int dst_width, int dst_height);
+
+// Vectorized ConvertYuvScalar(), bit-exact with it.
+//
+// Each output row is first gathered into planar Y/U/V scratch rows through
+// cached sampling tables (which is where the downscale and chroma
+// upsampling happen), then converted with AVX2, SSE2 or NEON integer
+// kernels. Not thread-safe; each producer owns its own instance.
+class YuvConverter {
+ public:
+  YuvConverter();
+
+  void Convert(const YuvImage& src, uint8_t* dst, int dst_stride,
+               int dst_width, int dst_height, PixelFormat dst_format);
+
+  // "avx2", "sse2", "neon" or "scalar".
+  const char* kernel_name() const;
+
+ private:
+  void UpdatePlan(const YuvImage& src, int dst_width, int dst_height);
+
+  // Cache key for the sampling tables.
+  YuvFormat format_ = YuvFormat::kYuyv;
+  int src_width_ = 0;
+  int src_height_ = 0;
+  int dst_width_ = 0;
+  int dst_height_ = 0;
+
+  // Byte offsets within a source row for each output pixel.
+  std::vector<int> y_offset_;
+  std::vector<int> u_offset_;
+  std::vector<int> v_offset_;
+  std::vector<int> src_row_;
+  // Luma can be read in place when it is planar and not resampled.
+  bool luma_in_place_ = false;
+
+  std::vector<uint8_t> y_row_;
+  std::vector<uint8_t> u_row_;
+  std::vector<uint8_t> v_row_;
+  std::vector<uint8_t> rgba_row_;
+  bool use_avx2_ = false;
+};
+
+// Converts random frames of every format, output layout and a range of
+// sizes and scale factors with both YuvConverter and ConvertYuvScalar and
+// compares them byte for byte. Returns the number of mismatching frames and
+// describes the first one in |report|.
+int VerifyYuvConverter(std::string* report);
+
+struct ColorBenchmark {
+  YuvFormat format = YuvFormat::kYuyv;
+  double simd_ms = 0;    // Per frame.
+  double scalar_ms = 0;  // Per frame.
+  double megapixels_per_second = 0;  // Output pixels, SIMD path.
+};
+
+// Times |iterations| conversions per format from |src_width| x |src_height|
+// to |dst_width| x |dst_height| RGBA.
+std::vector<ColorBenchmark> BenchmarkYuvConverter(int src_width,
+                                                  int src_height,
+                                                  int dst_width,
+                                                  int dst_height,
+                                                  int iterations);
+
+const char* YuvFormatName(YuvFormat format);
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_COLOR_CONVERT_H_
@@ -0,0 +1,57 @@
+#include "decode_pool.h"
+
+#include <algorithm>
+
+#include "inference_threads.h"
+
+namespace kiosk_vision {
+
+DecodePool::DecodePool(int threads) {
+  if (threads <= 0) {
+    threads = DefaultThreads();
+  }
+  for (int i = 0; i < threads; ++i) {
+    threads_.emplace_back(&DecodePool::Run, this);
+  }
+}
+
+DecodePool::~DecodePool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void DecodePool::Post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  wake_.notify_one();
+}
+
+int DecodePool::DefaultThreads() {
+  return std::max(1, std::min(2, OnlineCpuCount() / 2));
+}
+
+void DecodePool::Run() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,48 @@
+#ifndef PLUGINS_KIOSK_VISION_DECODE_POOL_H_
+#define PLUGINS_KIOSK_VISION_DECODE_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kiosk_vision {
+
+// Fixed set of threads that decode for every stream source, so adding
+// cameras adds work to a bounded pool instead of decoder threads. Sources
+// keep at most one task queued or running each, which serializes their
+// own decoding and bounds the queue by the number of sources.
+class DecodePool {
+ public:
+  // 0 picks DefaultThreads().
+  explicit DecodePool(int threads);
+  // Runs the tasks still queued, then joins.
+  ~DecodePool();
+
+  // Disallow copy and assign.
+  DecodePool(const DecodePool&) = delete;
+  DecodePool& operator=(const DecodePool&) = delete;
+
+  void Post(std::function<void()> task);
+
+  int thread_count() const { return static_cast<int>(threads_.size()); }
+
+  // Half the online CPUs, between one and two: decoding shares the
+  // machine with inference and the UI.
+  static int DefaultThreads();
+
+ private:
+  void Run();
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_DECODE_POOL_H_
@@ -0,0 +1,1009 @@
+#include "detection_engine.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+namespace kiosk_vision {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// The first invoke pays for XNNPACK packing the weights and the pool
+// spinning up; a couple more settle the caches.
+const int kWarmupRuns = 3;
+// Thread setups within this factor of the best p95 count as equally fast.
+const double kThreadTolerance = 1.1;
+
+double Percentile(std::vector<double> samples, int percent) {
+  if (samples.empty()) {
+    return 0;
+  }
+  std::sort(samples.begin(), samples.end());
+  const size_t rank = (samples.size() * percent + 99) / 100;
+  return samples[std::min(samples.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+// Minimum IoU for a benchmark detection to count as the reference object.
+const float kMatchIou = 0.5f;
+
+ImageView SubView(const ImageView& src, const CropRect& rect) {
+  const int bytes_per_pixel = src.format == PixelFormat::kRgb ? 3 : 4;
+  ImageView view = src;
+  view.data = src.data + static_cast<size_t>(rect.y) * src.stride +
+              static_cast<size_t>(rect.x) * bytes_per_pixel;
+  view.width = rect.width;
+  view.height = rect.height;
+  return view;
+}
+
+bool SameRect(const CropRect& a, const CropRect& b) {
+  return a.x == b.x && a.y == b.y && a.width == b.width &&
+         a.height == b.height;
+}
+
+// Regions worth a closer look: confirmed tracks, best first, then the
+// bounding box of the motion, all normalized to |area|.
+void CollectRois(const std::vector<Track>& tracks,
+                 const MotionDecision* motion, int frame_width,
+                 int frame_height, const CropRect& area,
+                 std::vector<Detection>* rois) {
+  rois->clear();
+  for (const Track& track : tracks) {
+    Detection roi;
+    roi.x1 = track.x1;
+    roi.y1 = track.y1;
+    roi.x2 = track.x2;
+    roi.y2 = track.y2;
+    roi.score = track.score;
+    roi.class_id = track.class_id;
+    rois->push_back(roi);
+  }
+  std::stable_sort(rois->begin(), rois->end(),
+                   [](const Detection& a, const Detection& b) {
+                     return a.score > b.score;
+                   });
+  if (motion != nullptr && motion->region_x2 > motion->region_x1 &&
+      motion->region_y2 > motion->region_y1) {
+    Detection roi;
+    roi.x1 = std::max(
+        0.0f, (motion->region_x1 * frame_width - area.x) / area.width);
+    roi.y1 = std::max(
+        0.0f, (motion->region_y1 * frame_height - area.y) / area.height);
+    roi.x2 = std::min(
+        1.0f, (motion->region_x2 * frame_width - area.x) / area.width);
+    roi.y2 = std::min(
+        1.0f, (motion->region_y2 * frame_height - area.y) / area.height);
+    if (roi.x2 > roi.x1 && roi.y2 > roi.y1) {
+      rois->push_back(roi);
+    }
+  }
+}
+
+bool HasImageExtension(const std::string& name) {
+  const size_t dot = name.rfind('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  std::string extension = name.substr(dot + 1);
+  for (char& c : extension) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return extension == "png" || extension == "jpg" || extension == "jpeg";
+}
+
+// Reads up to |max_frames| PNG/JPEG files of |dir| in name order, still
+// encoded, timestamped at |fps|.
+bool LoadImageClip(const std::string& dir, int max_frames, double fps,
+                   std::vector<Frame>* frames, std::string* error) {
+  DIR* handle = opendir(dir.c_str());
+  if (handle == nullptr) {
+    *error = "Cannot open clip directory " + dir + ": " + strerror(errno);
+    return false;
+  }
+  std::vector<std::string> names;
+  while (const dirent* entry = readdir(handle)) {
+    if (HasImageExtension(entry->d_name)) {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(handle);
+  std::sort(names.begin(), names.end());
+  if (max_frames > 0 && names.size() > static_cast<size_t>(max_frames)) {
+    names.resize(max_frames);
+  }
+
+  const int64_t interval_us =
+      static_cast<int64_t>(1e6 / (fps > 0 ? fps : 10.0));
+  frames->clear();
+  for (const std::string& name : names) {
+    std::ifstream file(dir + "/" + name, std::ios::binary);
+    if (!file) {
+      *error = "Cannot read " + name;
+      return false;
+    }
+    Frame frame;
+    frame.pixels.assign(std::istreambuf_iterator<char>(file),
+                        std::istreambuf_iterator<char>());
+    frame.encoded = true;
+    frame.timestamp_us = (frames->size() + 1) * interval_us;
+    frames->push_back(std::move(frame));
+  }
+  if (frames->empty()) {
+    *error = "No PNG or JPEG frames in " + dir;
+    return false;
+  }
+  return true;
+}
+
+// Greedy matching of |detections| against |reference|, best IoU first.
+int CountMatches(const std::vector<Detection>& reference,
+                 const std::vector<Detection>& detections) {
+  std::vector<bool> used(detections.size(), false);
+  int matched = 0;
+  for (const Detection& object : reference) {
+    int best = -1;
+    float best_iou = kMatchIou;
+    for (size_t d = 0; d < detections.size(); ++d) {
+      if (used[d] || detections[d].class_id != object.class_id) {
+        continue;
+      }
+      const float iou = BoxIou(object, detections[d]);
+      if (iou >= best_iou) {
+        best_iou = iou;
+        best = static_cast<int>(d);
+      }
+    }
+    if (best >= 0) {
+      used[best] = true;
+      matched++;
+    }
+  }
+  return matched;
+}
+
+}  // namespace
+
+DetectionEngine::DetectionEngine() {
+  worker_ = std::thread(&DetectionEngine::WorkerLoop, this);
+}
+
+DetectionEngine::~DetectionEngine() {
+  Post([this]() { UnloadOnWorker(); });
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_one();
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void DetectionEngine::SetFrameDecoder(FrameDecoder decoder) {
+  Post([this, decoder]() { decoder_ = decoder; });
+}
+
+void DetectionEngine::LoadModel(std::vector<uint8_t> model_bytes,
+                                const InferenceThreadConfig& threads,
+                                LoadCallback callback) {
+  Post([this, bytes = std::move(model_bytes), threads,
+        callback]() mutable {
+    std::string error;
+    const bool ok = LoadOnWorker(std::move(bytes), threads, &error);
+    callback(ok, model_info(), error);
+  });
+}
+
+void DetectionEngine::BenchmarkThreads(std::vector<int> thread_counts,
+                                       int iterations,
+                                       ThreadBenchmarkCallback callback) {
+  Post([this, thread_counts = std::move(thread_counts), iterations,
+        callback]() {
+    std::vector<ThreadBenchmark> results;
+    InferenceThreadConfig chosen;
+    std::string error;
+    const bool ok = BenchmarkThreadsOnWorker(thread_counts, iterations,
+                                             &results, &chosen, &error);
+    callback(ok, results, chosen, error);
+  });
+}
+
+void DetectionEngine::Detect(Frame frame, float score_threshold,
+                             DetectCallback callback) {
+  Post([this, frame = std::move(frame), score_threshold,
+        callback]() mutable {
+    callback(DetectOnWorker(&frame, score_threshold));
+  });
+}
+
+void DetectionEngine::DetectFromRing(FrameRing* ring, int slot,
+                                     uint64_t frame_id, bool allow_newer,
+                                     float score_threshold,
+                                     DetectCallback callback) {
+  Post([this, ring, slot, frame_id, allow_newer, score_threshold,
+        callback]() {
+    callback(DetectFromRingOnWorker(ring, slot, frame_id, allow_newer,
+                                    score_threshold));
+  });
+}
+
+void DetectionEngine::SetPostprocess(const PostprocessConfig& postprocess,
+                                     const TrackerConfig& tracker) {
+  Post([this, postprocess, tracker]() {
+    postprocess_ = postprocess;
+    tracker_.Reset();
+    tracker_.Configure(tracker);
+  });
+}
+
+void DetectionEngine::SetTiling(const TilingConfig& config) {
+  Post([this, config]() { tile_planner_.Configure(config); });
+}
+
+void DetectionEngine::BenchmarkTiling(
+    std::string clip_dir, int max_frames, double clip_fps,
+    const TilingConfig& tiling, float score_threshold,
+    std::vector<std::vector<Detection>> labels, BenchmarkCallback callback) {
+  Post([this, clip_dir = std::move(clip_dir), max_frames, clip_fps, tiling,
+        score_threshold, labels = std::move(labels), callback]() {
+    std::vector<TilingBenchmark> results;
+    std::string error;
+    const bool ok =
+        BenchmarkOnWorker(clip_dir, max_frames, clip_fps, tiling,
+                          score_threshold, labels, &results, &error);
+    callback(ok, results, error);
+  });
+}
+
+void DetectionEngine::Unload() {
+  Post([this]() { UnloadOnWorker(); });
+}
+
+void DetectionEngine::ReleaseIdle(int idle_ms, ReleaseCallback callback) {
+  Post([this, idle_ms, callback]() {
+    const bool idle =
+        interpreter_ != nullptr && MillisSince(last_used_) >= idle_ms;
+    if (idle) {
+      DestroyInterpreter();
+      // Scratch keeps the capacity of the busiest frame seen.
+      std::vector<CropRect>().swap(crops_);
+      std::vector<Detection>().swap(rois_);
+      std::vector<Detection>().swap(crop_detections_);
+      std::vector<Track>().swap(roi_tracks_);
+    }
+    callback(idle);
+  });
+}
+
+ModelInfo DetectionEngine::model_info() const {
+  std::lock_guard<std::mutex> lock(info_mutex_);
+  return info_;
+}
+
+void DetectionEngine::Post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  condition_.notify_one();
+}
+
+void DetectionEngine::WorkerLoop() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+bool DetectionEngine::LoadOnWorker(std::vector<uint8_t> model_bytes,
+                                   const InferenceThreadConfig& threads,
+                                   std::string* error) {
+  const Clock::time_point start = Clock::now();
+  UnloadOnWorker();
+
+  api_ = TfLiteApi::Load(error);
+  if (api_ == nullptr) {
+    *error = "TensorFlow Lite C library not available: " + *error;
+    return false;
+  }
+
+  model_bytes_ = std::move(model_bytes);
+  model_ = api_->ModelCreate(model_bytes_.data(), model_bytes_.size());
+  if (model_ == nullptr) {
+    *error = "Failed to parse TensorFlow Lite model";
+    UnloadOnWorker();
+    return false;
+  }
+
+  if (!CreateInterpreter(threads, error)) {
+    UnloadOnWorker();
+    return false;
+  }
+
+  const TfLiteTensor* input = api_->InterpreterGetInputTensor(interpreter_, 0);
+  if (input == nullptr || api_->TensorNumDims(input) != 4 ||
+      api_->TensorDim(input, 3) != 3) {
+    *error = "Unsupported model input; expected [1, height, width, 3]";
+    UnloadOnWorker();
+    return false;
+  }
+  const TfLiteType input_type = api_->TensorType(input);
+  if (input_type != kTfLiteUInt8 && input_type != kTfLiteFloat32) {
+    *error = "Unsupported model input type";
+    UnloadOnWorker();
+    return false;
+  }
+
+  ModelInfo info;
+  info.input_height = api_->TensorDim(input, 1);
+  info.input_width = api_->TensorDim(input, 2);
+  info.channels = api_->TensorDim(input, 3);
+  info.quantized = input_type == kTfLiteUInt8;
+  info.num_outputs = api_->InterpreterGetOutputTensorCount(interpreter_);
+  info.load_ms = MillisSince(start);
+  info.num_threads = threads_.num_threads;
+  info.cpus = threads_.cpus;
+  info.nice = threads_.nice;
+  info.thread_warning = thread_warning_;
+  WarmUp(kWarmupRuns, &info.warmup_first_ms, &info.warmup_ms);
+  {
+    std::lock_guard<std::mutex> lock(info_mutex_);
+    info_ = info;
+  }
+  loaded_ = true;
+  return true;
+}
+
+bool DetectionEngine::CreateInterpreter(const InferenceThreadConfig& threads,
+                                        std::string* error) {
+  DestroyInterpreter();
+
+  // Before the interpreter exists, so its pool threads inherit both.
+  thread_warning_.clear();
+  ApplyToCurrentThread(threads, &thread_warning_);
+
+  threads_ = threads;
+  if (threads_.num_threads <= 0) {
+    threads_.num_threads = DefaultInferenceThreads();
+  }
+  options_ = api_->InterpreterOptionsCreate();
+  api_->InterpreterOptionsSetNumThreads(options_, threads_.num_threads);
+  interpreter_ = api_->InterpreterCreate(model_, options_);
+  if (interpreter_ == nullptr ||
+      api_->InterpreterAllocateTensors(interpreter_) != kTfLiteOk) {
+    *error = "Failed to create interpreter or allocate tensors";
+    DestroyInterpreter();
+    return false;
+  }
+  batch_size_ = 1;
+  batch_unsupported_ = false;
+  last_used_ = Clock::now();
+  return true;
+}
+
+void DetectionEngine::DestroyInterpreter() {
+  if (api_ != nullptr) {
+    if (interpreter_ != nullptr) {
+      api_->InterpreterDelete(interpreter_);
+    }
+    if (options_ != nullptr) {
+      api_->InterpreterOptionsDelete(options_);
+    }
+  }
+  interpreter_ = nullptr;
+  options_ = nullptr;
+}
+
+bool DetectionEngine::EnsureInterpreter(std::string* error) {
+  if (interpreter_ == nullptr) {
+    if (model_ == nullptr) {
+      *error = "Model not loaded";
+      return false;
+    }
+    const InferenceThreadConfig threads = threads_;
+    if (!CreateInterpreter(threads, error)) {
+      return false;
+    }
+  }
+  last_used_ = Clock::now();
+  return true;
+}
+
+void DetectionEngine::WarmUp(int runs, double* first_ms, double* mean_ms) {
+  *first_ms = 0;
+  *mean_ms = 0;
+  TfLiteTensor* input = api_->InterpreterGetInputTensor(interpreter_, 0);
+  void* data = api_->TensorData(input);
+  const size_t bytes = api_->TensorByteSize(input);
+  if (api_->TensorType(input) == kTfLiteUInt8) {
+    memset(data, 128, bytes);
+  } else {
+    std::fill(static_cast<float*>(data),
+              static_cast<float*>(data) + bytes / sizeof(float), 0.5f);
+  }
+  for (int run = 0; run < runs; ++run) {
+    const Clock::time_point start = Clock::now();
+    if (api_->InterpreterInvoke(interpreter_) != kTfLiteOk) {
+      return;
+    }
+    const double elapsed = MillisSince(start);
+    if (run == 0) {
+      *first_ms = elapsed;
+    } else {
+      *mean_ms += elapsed / (runs - 1);
+    }
+  }
+}
+
+void DetectionEngine::UnloadOnWorker() {
+  loaded_ = false;
+  DestroyInterpreter();
+  if (api_ != nullptr && model_ != nullptr) {
+    api_->ModelDelete(model_);
+  }
+  model_ = nullptr;
+  model_bytes_.clear();
+  model_bytes_.shrink_to_fit();
+  tracker_.Reset();
+}
+
+bool DetectionEngine::BenchmarkThreadsOnWorker(
+    const std::vector<int>& thread_counts, int iterations,
+    std::vector<ThreadBenchmark>* results, InferenceThreadConfig* chosen,
+    std::string* error) {
+  if (!EnsureInterpreter(error)) {
+    return false;
+  }
+  const int cpus = OnlineCpuCount();
+  std::vector<int> counts = thread_counts;
+  if (counts.empty()) {
+    for (int count = 1; count <= std::min(cpus, 8); ++count) {
+      counts.push_back(count);
+    }
+  }
+  iterations = std::max(5, iterations);
+  const InferenceThreadConfig original = threads_;
+
+  // Each count unpinned, and pinned to as many of the highest CPUs.
+  std::vector<InferenceThreadConfig> setups;
+  for (int count : counts) {
+    if (count <= 0 || count > cpus) {
+      continue;
+    }
+    InferenceThreadConfig setup;
+    setup.num_threads = count;
+    setup.nice = original.nice;
+    setups.push_back(setup);
+    if (count < cpus) {
+      setup.cpus = HighestCpus(count);
+      setups.push_back(setup);
+    }
+  }
+
+  results->clear();
+  std::vector<double> samples;
+  for (const InferenceThreadConfig& setup : setups) {
+    if (!CreateInterpreter(setup, error)) {
+      std::string ignored;
+      CreateInterpreter(original, &ignored);
+      return false;
+    }
+    ThreadBenchmark result;
+    result.threads = setup.num_threads;
+    result.cpus = setup.cpus;
+    double unused = 0;
+    WarmUp(1, &result.first_ms, &unused);
+    samples.clear();
+    for (int i = 0; i < iterations; ++i) {
+      const Clock::time_point start = Clock::now();
+      if (api_->InterpreterInvoke(interpreter_) != kTfLiteOk) {
+        *error = "Interpreter invoke failed";
+        std::string ignored;
+        CreateInterpreter(original, &ignored);
+        return false;
+      }
+      samples.push_back(MillisSince(start));
+    }
+    for (double sample : samples) {
+      result.mean_ms += sample / samples.size();
+    }
+    result.p50_ms = Percentile(samples, 50);
+    result.p95_ms = Percentile(samples, 95);
+    results->push_back(result);
+  }
+  if (results->empty()) {
+    *error = "No valid thread counts";
+    return false;
+  }
+
+  // Fewest threads within tolerance of the best p95, pinned on a tie, and
+  // always leaving a core to the UI when there is more than one.
+  const auto eligible = [cpus](const ThreadBenchmark& result) {
+    return cpus == 1 || result.threads < cpus;
+  };
+  double best = -1;
+  for (const ThreadBenchmark& result : *results) {
+    if (eligible(result) && (best < 0 || result.p95_ms < best)) {
+      best = result.p95_ms;
+    }
+  }
+  const ThreadBenchmark* pick = &results->front();
+  bool picked = false;
+  for (const ThreadBenchmark& result : *results) {
+    if (!eligible(result) || result.p95_ms > best * kThreadTolerance) {
+      continue;
+    }
+    if (!picked || result.threads < pick->threads ||
+        (result.threads == pick->threads && !result.cpus.empty() &&
+         pick->cpus.empty())) {
+      pick = &result;
+      picked = true;
+    }
+  }
+  chosen->num_threads = pick->threads;
+  chosen->cpus = pick->cpus;
+  chosen->nice = original.nice;
+
+  if (!CreateInterpreter(*chosen, error)) {
+    return false;
+  }
+  ModelInfo info = model_info();
+  info.num_threads = threads_.num_threads;
+  info.cpus = threads_.cpus;
+  info.nice = threads_.nice;
+  info.thread_warning = thread_warning_;
+  WarmUp(kWarmupRuns, &info.warmup_first_ms, &info.warmup_ms);
+  {
+    std::lock_guard<std::mutex> lock(info_mutex_);
+    info_ = info;
+  }
+  return true;
+}
+
+DetectionResult DetectionEngine::DetectOnWorker(Frame* frame,
+                                                float score_threshold) {
+  DetectionResult result;
+  const Clock::time_point start = Clock::now();
+  if (!EnsureInterpreter(&result.error)) {
+    return result;
+  }
+
+  if (frame->encoded) {
+    const Clock::time_point decode_start = Clock::now();
+    if (!decoder_ || !decoder_(frame, &result.error)) {
+      if (result.error.empty()) {
+        result.error = "No decoder for encoded frame";
+      }
+      return result;
+    }
+    result.timings.decode_ms = MillisSince(decode_start);
+  }
+
+  const int bytes_per_pixel = frame->format == PixelFormat::kRgb ? 3 : 4;
+  if (frame->stride == 0) {
+    frame->stride = frame->width * bytes_per_pixel;
+  }
+  if (frame->width <= 0 || frame->height <= 0 ||
+      frame->pixels.size() <
+          static_cast<size_t>(frame->stride) * frame->height) {
+    result.error = "Frame dimensions do not match pixel data";
+    return result;
+  }
+
+  ImageView src;
+  src.data = frame->pixels.data();
+  src.width = frame->width;
+  src.height = frame->height;
+  src.stride = frame->stride;
+  src.format = frame->format;
+  result.timestamp_us = frame->timestamp_us;
+  InferOnWorker(src, nullptr, score_threshold, start, &result);
+  return result;
+}
+
+DetectionResult DetectionEngine::DetectFromRingOnWorker(FrameRing* ring,
+                                                        int slot,
+                                                        uint64_t frame_id,
+                                                        bool allow_newer,
+                                                        float score_threshold) {
+  DetectionResult result;
+  const Clock::time_point start = Clock::now();
+  if (!EnsureInterpreter(&result.error)) {
+    return result;
+  }
+
+  FrameRing::ReadLease lease;
+  const bool acquired =
+      (frame_id != 0 && ring->Acquire(slot, frame_id, &lease)) ||
+      ((frame_id == 0 || allow_newer) && ring->AcquireLatest(&lease));
+  if (!acquired) {
+    result.error = frame_id == 0 ? "No frame available"
+                                 : "Frame slot was reused by a newer frame";
+    return result;
+  }
+  result.frame_id = lease.info().frame_id;
+  result.timestamp_us = lease.info().timestamp_us;
+  InferOnWorker(lease.view(), &lease, score_threshold, start, &result);
+  return result;
+}
+
+void DetectionEngine::InferOnWorker(const ImageView& src,
+                                    FrameRing::ReadLease* lease,
+                                    float score_threshold,
+                                    Clock::time_point start,
+                                    DetectionResult* result) {
+  result->frame_width = src.width;
+  result->frame_height = src.height;
+
+  if (result->timestamp_us == 0) {
+    result->timestamp_us =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            start.time_since_epoch())
+            .count();
+  }
+
+  MotionDecision decision;
+  if (motion_gate_.enabled()) {
+    const Clock::time_point motion_start = Clock::now();
+    decision = motion_gate_.Evaluate(src, result->timestamp_us);
+    result->motion_checked = true;
+    result->motion_score = decision.motion_score;
+    result->keepalive = decision.keepalive;
+    result->timings.motion_ms = MillisSince(motion_start);
+    if (!decision.run_inference) {
+      result->skipped = true;
+      UpdateTracks(true, result);
+      result->timings.total_ms = MillisSince(start);
+      result->ok = true;
+      return;
+    }
+  }
+
+  const CropRect area = CenterCrop(src.width, src.height, info_.input_width,
+                                   info_.input_height);
+  rois_.clear();
+  if (tile_planner_.enabled()) {
+    tracker_.ConfirmedTracks(&roi_tracks_);
+    CollectRois(roi_tracks_,
+                result->motion_checked ? &decision : nullptr, src.width,
+                src.height, area, &rois_);
+  }
+  tile_planner_.Plan(area, info_.input_width, info_.input_height, rois_,
+                     &crops_);
+  if (!RunCrops(src, area, crops_, tile_planner_.config(), lease,
+                score_threshold, result)) {
+    return;
+  }
+
+  const Clock::time_point track_start = Clock::now();
+  UpdateTracks(false, result);
+  result->timings.track_ms = MillisSince(track_start);
+  result->timings.parse_ms += result->timings.track_ms;
+  result->timings.total_ms = MillisSince(start);
+  result->ok = true;
+}
+
+bool DetectionEngine::RunCrops(const ImageView& src, const CropRect& area,
+                               const std::vector<CropRect>& crops,
+                               const TilingConfig& tiling,
+                               FrameRing::ReadLease* lease,
+                               float score_threshold,
+                               DetectionResult* result) {
+  const int count = static_cast<int>(crops.size());
+  const bool batched = count > 1 && tiling.batch && SetBatchSize(count);
+  if (!batched && !SetBatchSize(1)) {
+    result->error = "Failed to resize the interpreter input";
+    return false;
+  }
+  result->crops = count;
+  result->batched = batched;
+  result->raw_count = 0;
+  result->detections.clear();
+
+  TensorView dst;
+  dst.width = info_.input_width;
+  dst.height = info_.input_height;
+  dst.quantized = info_.quantized;
+  const size_t input_bytes = static_cast<size_t>(dst.width) * dst.height *
+                             3 * (dst.quantized ? 1 : sizeof(float));
+
+  // One round with every crop in the batch, or one round per crop.
+  const int rounds = batched ? 1 : count;
+  const int per_round = batched ? count : 1;
+  for (int round = 0; round < rounds; ++round) {
+    const Clock::time_point preprocess_start = Clock::now();
+    TfLiteTensor* input = api_->InterpreterGetInputTensor(interpreter_, 0);
+    uint8_t* base = static_cast<uint8_t*>(api_->TensorData(input));
+    for (int i = 0; i < per_round; ++i) {
+      dst.data = base + i * input_bytes;
+      preprocessor_.Run(SubView(src, crops[round * per_round + i]), dst);
+    }
+    if (lease != nullptr && round == rounds - 1) {
+      lease->Release();
+    }
+    result->timings.preprocess_ms += MillisSince(preprocess_start);
+
+    const Clock::time_point inference_start = Clock::now();
+    if (api_->InterpreterInvoke(interpreter_) != kTfLiteOk) {
+      result->error = "Interpreter invoke failed";
+      return false;
+    }
+    result->timings.inference_ms += MillisSince(inference_start);
+
+    const Clock::time_point parse_start = Clock::now();
+    for (int i = 0; i < per_round; ++i) {
+      const CropRect& crop = crops[round * per_round + i];
+      int raw_count = 0;
+      if (!ReadDetections(i, score_threshold, &crop_detections_, &raw_count,
+                          &result->error)) {
+        return false;
+      }
+      result->raw_count += raw_count;
+      const bool whole = SameRect(crop, area);
+      for (Detection& detection : crop_detections_) {
+        if (!whole) {
+          MapCropDetection(crop, area, &detection);
+        }
+        result->detections.push_back(detection);
+      }
+    }
+    result->timings.parse_ms += MillisSince(parse_start);
+  }
+
+  if (count > 1) {
+    const Clock::time_point merge_start = Clock::now();
+    MergeDetections(postprocess_.nms_iou, tiling.merge_containment,
+                    postprocess_.class_agnostic_nms,
+                    postprocess_.max_detections, &result->detections);
+    result->timings.parse_ms += MillisSince(merge_start);
+  }
+  return true;
+}
+
+bool DetectionEngine::SetBatchSize(int batch) {
+  if (batch == batch_size_) {
+    return true;
+  }
+  if (batch > 1 && batch_unsupported_) {
+    return false;
+  }
+  const int dims[4] = {batch, info_.input_height, info_.input_width, 3};
+  bool ok = api_->InterpreterResizeInputTensor(interpreter_, 0, dims, 4) ==
+                kTfLiteOk &&
+            api_->InterpreterAllocateTensors(interpreter_) == kTfLiteOk;
+  // The TFLite_Detection_PostProcess op at the end of the SSD models only
+  // ever emits a batch of one; such models are fed crop by crop.
+  if (ok && batch > 1) {
+    const TfLiteTensor* scores =
+        api_->InterpreterGetOutputTensor(interpreter_, 2);
+    ok = scores != nullptr && api_->TensorNumDims(scores) >= 2 &&
+         api_->TensorDim(scores, 0) == batch;
+  }
+  if (ok) {
+    batch_size_ = batch;
+    return true;
+  }
+  if (batch == 1) {
+    return false;
+  }
+  batch_unsupported_ = true;
+  // The interpreter may be half resized; force it back to one.
+  batch_size_ = 0;
+  SetBatchSize(1);
+  return false;
+}
+
+bool DetectionEngine::ReadDetections(int batch_index, float score_threshold,
+                                     std::vector<Detection>* detections,
+                                     int* raw_count, std::string* error) {
+  // SSD MobileNet post-processed outputs: boxes [B, N, 4] as (y1, x1, y2,
+  // x2), classes [B, N], scores [B, N] and the detection count [B].
+  if (info_.num_outputs < 3) {
+    *error = "Unsupported model output layout";
+    return false;
+  }
+  const TfLiteTensor* boxes_tensor =
+      api_->InterpreterGetOutputTensor(interpreter_, 0);
+  const TfLiteTensor* classes_tensor =
+      api_->InterpreterGetOutputTensor(interpreter_, 1);
+  const TfLiteTensor* scores_tensor =
+      api_->InterpreterGetOutputTensor(interpreter_, 2);
+  if (api_->TensorType(boxes_tensor) != kTfLiteFloat32 ||
+      api_->TensorType(classes_tensor) != kTfLiteFloat32 ||
+      api_->TensorType(scores_tensor) != kTfLiteFloat32) {
+    *error = "Expected float32 detection outputs";
+    return false;
+  }
+
+  const int per_item = static_cast<int>(
+      api_->TensorByteSize(scores_tensor) / sizeof(float) / batch_size_);
+  const size_t offset = static_cast<size_t>(batch_index) * per_item;
+  const float* boxes =
+      static_cast<const float*>(api_->TensorData(boxes_tensor)) + offset * 4;
+  const float* classes =
+      static_cast<const float*>(api_->TensorData(classes_tensor)) + offset;
+  const float* scores =
+      static_cast<const float*>(api_->TensorData(scores_tensor)) + offset;
+  int count = per_item;
+  if (info_.num_outputs >= 4) {
+    const TfLiteTensor* count_tensor =
+        api_->InterpreterGetOutputTensor(interpreter_, 3);
+    const float* reported =
+        static_cast<const float*>(api_->TensorData(count_tensor));
+    count = std::min(count, static_cast<int>(reported[batch_index]));
+  }
+  *raw_count = count;
+
+  DecodeSsdDetections(boxes, classes, scores, count, score_threshold,
+                      postprocess_, detections);
+  return true;
+}
+
+void DetectionEngine::UpdateTracks(bool skipped, DetectionResult* result) {
+  if (!tracker_.config().enabled) {
+    return;
+  }
+  if (!skipped) {
+    tracker_.Update(result->detections, result->timestamp_us);
+  }
+  tracker_.ConfirmedTracks(&result->tracks);
+  result->tracking = true;
+}
+
+bool DetectionEngine::BenchmarkOnWorker(
+    const std::string& clip_dir, int max_frames, double clip_fps,
+    const TilingConfig& tiling, float score_threshold,
+    const std::vector<std::vector<Detection>>& labels,
+    std::vector<TilingBenchmark>* results, std::string* error) {
+  if (!EnsureInterpreter(error)) {
+    return false;
+  }
+  std::vector<Frame> clip;
+  if (!LoadImageClip(clip_dir, max_frames, clip_fps, &clip, error)) {
+    return false;
+  }
+  for (Frame& frame : clip) {
+    if (!decoder_ || !decoder_(&frame, error)) {
+      if (error->empty()) {
+        *error = "No decoder for encoded frame";
+      }
+      return false;
+    }
+    if (frame.stride == 0) {
+      frame.stride =
+          frame.width * (frame.format == PixelFormat::kRgb ? 3 : 4);
+    }
+  }
+
+  TilingConfig single;
+  TilingConfig tiled = tiling;
+  if (tiled.mode == TilingMode::kOff) {
+    tiled.mode = TilingMode::kGrid;
+  }
+  const struct {
+    const char* name;
+    const TilingConfig* config;
+  } passes[] = {{"single", &single}, {"tiled", &tiled}};
+  const size_t pass_count = sizeof(passes) / sizeof(passes[0]);
+
+  // detections[pass][frame]
+  std::vector<std::vector<std::vector<Detection>>> detections(pass_count);
+  results->assign(pass_count, TilingBenchmark());
+  for (size_t p = 0; p < pass_count; ++p) {
+    const TilingConfig& config = *passes[p].config;
+    // Each pass gets its own planner, tracker and motion gate so the ROIs
+    // evolve as they would live, without touching the live state.
+    TilePlanner planner;
+    planner.Configure(config);
+    ObjectTracker tracker;
+    tracker.Configure(tracker_.config());
+    MotionGate gate;
+    MotionGateConfig gate_config = motion_gate_.config();
+    gate_config.enabled = true;
+    gate.Configure(gate_config);
+
+    TilingBenchmark& result = (*results)[p];
+    result.name = passes[p].name;
+    std::vector<double> samples;
+    DetectionResult scratch;
+    std::vector<Track> tracks;
+    std::vector<Detection> rois;
+    std::vector<CropRect> crops;
+    for (const Frame& frame : clip) {
+      ImageView view;
+      view.data = frame.pixels.data();
+      view.width = frame.width;
+      view.height = frame.height;
+      view.stride = frame.stride;
+      view.format = frame.format;
+      const CropRect area = CenterCrop(view.width, view.height,
+                                       info_.input_width, info_.input_height);
+      if (planner.enabled()) {
+        const MotionDecision motion = gate.Evaluate(view, frame.timestamp_us);
+        tracker.ConfirmedTracks(&tracks);
+        CollectRois(tracks, &motion, view.width, view.height, area, &rois);
+      }
+      planner.Plan(area, info_.input_width, info_.input_height, rois,
+                   &crops);
+
+      const Clock::time_point start = Clock::now();
+      scratch.timings = StageTimings();
+      if (!RunCrops(view, area, crops, config, nullptr, score_threshold,
+                    &scratch)) {
+        *error = scratch.error;
+        return false;
+      }
+      samples.push_back(MillisSince(start));
+      tracker.Update(scratch.detections, frame.timestamp_us);
+      result.crops_per_frame += scratch.crops;
+      result.batched = scratch.batched;
+      result.detections += static_cast<int>(scratch.detections.size());
+      detections[p].push_back(scratch.detections);
+    }
+
+    result.frames = static_cast<int>(clip.size());
+    double total = 0;
+    for (double sample : samples) {
+      total += sample;
+    }
+    result.mean_ms = total / samples.size();
+    result.p95_ms = Percentile(samples, 95);
+    result.crops_per_frame /= clip.size();
+  }
+
+  // Reference objects per frame: the labels, or the union of both passes.
+  const bool labeled = labels.size() == clip.size();
+  std::vector<Detection> reference;
+  for (size_t f = 0; f < clip.size(); ++f) {
+    if (labeled) {
+      reference = labels[f];
+    } else {
+      reference.clear();
+      for (size_t p = 0; p < pass_count; ++p) {
+        reference.insert(reference.end(), detections[p][f].begin(),
+                         detections[p][f].end());
+      }
+      MergeDetections(kMatchIou, tiled.merge_containment, false, 0,
+                      &reference);
+    }
+    for (size_t p = 0; p < pass_count; ++p) {
+      (*results)[p].reference += static_cast<int>(reference.size());
+      (*results)[p].matched += CountMatches(reference, detections[p][f]);
+    }
+  }
+  for (TilingBenchmark& result : *results) {
+    result.recall = result.reference > 0
+                        ? static_cast<double>(result.matched) / result.reference
+                        : 0;
+    result.precision =
+        result.detections > 0
+            ? static_cast<double>(result.matched) / result.detections
+            : 0;
+  }
+  return true;
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,317 @@
+#ifndef PLUGINS_KIOSK_VISION_DETECTION_ENGINE_H_
+#define PLUGINS_KIOSK_VISION_DETECTION_ENGINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "detection_postprocess.h"
+#include "frame_preprocessor.h"
+#include "frame_ring.h"
+#include "inference_threads.h"
+#include "motion_gate.h"
+#include "object_tracker.h"
+#include "tflite_c_api.h"
+#include "tile_planner.h"
+
+namespace kiosk_vision {
+
+// Frame handed to the engine. Pixels are owned so the caller can return
+// immediately while the worker thread processes it.
+struct Frame {
+  std::vector<uint8_t> pixels;
+  int width = 0;
+  int height = 0;
+  int stride = 0;
+  PixelFormat format = PixelFormat::kRgba;
+  // Set when |pixels| holds a PNG/JPEG payload that still needs decoding.
+  bool encoded = false;
+  int64_t timestamp_us = 0;
+};
+
+// Per-stage wall-clock timings in milliseconds. Names match the debug
+// metrics already reported by the Dart isolate path.
+struct StageTimings {
+  double decode_ms = 0;
+  double motion_ms = 0;
+  double preprocess_ms = 0;
+  double inference_ms = 0;
+  double parse_ms = 0;
+  // Tracker update; included in |parse_ms|.
+  double track_ms = 0;
+  double total_ms = 0;
+};
+
+struct DetectionResult {
+  bool ok = false;
+  std::string error;
+  std::vector<Detection> detections;
+  int raw_count = 0;
+  int frame_width = 0;
+  int frame_height = 0;
+  // Ring frame the result belongs to; 0 for frames passed by value.
+  uint64_t frame_id = 0;
+  int64_t timestamp_us = 0;
+  // Filled in when the motion gate is enabled. A |skipped| result is ok but
+  // carries no detections: the scene has not changed since the last run.
+  bool motion_checked = false;
+  bool skipped = false;
+  bool keepalive = false;
+  double motion_score = 0;
+  // Confirmed tracks after this frame, when tracking is enabled. Also
+  // filled for skipped frames, where they are simply carried over.
+  bool tracking = false;
+  std::vector<Track> tracks;
+  // Crops run through the interpreter for this frame, and whether they
+  // went in as one batch.
+  int crops = 0;
+  bool batched = false;
+  StageTimings timings;
+};
+
+// One configuration's pass over a recorded clip, see BenchmarkTiling().
+struct TilingBenchmark {
+  std::string name;
+  int frames = 0;
+  // Preprocess + inference + parse per frame.
+  double mean_ms = 0;
+  double p95_ms = 0;
+  double crops_per_frame = 0;
+  bool batched = false;
+  int detections = 0;
+  // Reference objects found, at IoU 0.5 with a box of the same class.
+  int matched = 0;
+  int reference = 0;
+  double recall = 0;
+  double precision = 0;
+};
+
+struct ModelInfo {
+  int input_width = 0;
+  int input_height = 0;
+  int channels = 0;
+  bool quantized = false;
+  int num_outputs = 0;
+  double load_ms = 0;
+  // Thread setup the interpreter was created with.
+  int num_threads = 0;
+  std::vector<int> cpus;
+  int nice = 0;
+  // Set when the affinity or nice value was refused; inference still runs.
+  std::string thread_warning;
+  // First invoke after creation, and the mean of the remaining warm-up
+  // invokes.
+  double warmup_first_ms = 0;
+  double warmup_ms = 0;
+};
+
+// One thread setup measured by BenchmarkThreads().
+struct ThreadBenchmark {
+  int threads = 0;
+  std::vector<int> cpus;
+  double first_ms = 0;
+  double mean_ms = 0;
+  double p50_ms = 0;
+  double p95_ms = 0;
+};
+
+// Keeps one TensorFlow Lite interpreter warm on a dedicated worker thread.
+//
+// The model is parsed and its tensors are allocated once in LoadModel().
+// Every Detect() call then only preprocesses into the already allocated input
+// tensor, invokes, and reads the outputs in place. All interpreter access
+// happens on the worker thread; callbacks are also invoked there, so callers
+// must marshal results back to their own thread.
+class DetectionEngine {
+ public:
+  using LoadCallback = std::function<void(bool ok, const ModelInfo& info,
+                                          const std::string& error)>;
+  using DetectCallback = std::function<void(const DetectionResult& result)>;
+  using ReleaseCallback = std::function<void(bool released)>;
+  using ThreadBenchmarkCallback = std::function<void(
+      bool ok, const std::vector<ThreadBenchmark>& results,
+      const InferenceThreadConfig& chosen, const std::string& error)>;
+  using BenchmarkCallback =
+      std::function<void(bool ok, const std::vector<TilingBenchmark>& results,
+                          const std::string& error)>;
+  // Decodes an encoded frame in place into packed pixels. Runs on the
+  // worker thread.
+  using FrameDecoder = std::function<bool(Frame* frame, std::string* error)>;
+
+  DetectionEngine();
+  ~DetectionEngine();
+
+  // Disallow copy and assign.
+  DetectionEngine(const DetectionEngine&) = delete;
+  DetectionEngine& operator=(const DetectionEngine&) = delete;
+
+  void SetFrameDecoder(FrameDecoder decoder);
+
+  // Replaces any loaded model. |model_bytes| is kept alive for the lifetime
+  // of the interpreter as required by TfLiteModelCreate. |threads| is
+  // applied to the worker before the interpreter and its thread pool are
+  // created, and a few warm-up invokes run before |callback|.
+  void LoadModel(std::vector<uint8_t> model_bytes,
+                 const InferenceThreadConfig& threads, LoadCallback callback);
+
+  // Recreates the interpreter with each of |thread_counts| threads (1 to
+  // the core count when empty), unpinned and pinned to the highest CPUs,
+  // and times |iterations| invokes of each. Keeps the setup with the fewest
+  // threads whose p95 is within 10% of the best, never using every core.
+  void BenchmarkThreads(std::vector<int> thread_counts, int iterations,
+                        ThreadBenchmarkCallback callback);
+
+  void Detect(Frame frame, float score_threshold, DetectCallback callback);
+
+  // Runs detection on a frame still held in |ring|, reading its pixels in
+  // place. |frame_id| 0 selects the newest frame at the time the worker gets
+  // to the request; with |allow_newer| the newest frame is also used when
+  // the requested one has already been recycled. |ring| must outlive the
+  // engine.
+  void DetectFromRing(FrameRing* ring, int slot, uint64_t frame_id,
+                      bool allow_newer, float score_threshold,
+                      DetectCallback callback);
+
+  // Takes effect from the next frame; may be called from any thread.
+  void SetMotionGate(const MotionGateConfig& config) {
+    motion_gate_.Configure(config);
+  }
+  MotionGateConfig motion_gate_config() const {
+    return motion_gate_.config();
+  }
+  MotionStats motion_stats() const { return motion_gate_.stats(); }
+
+  // Per-class thresholds, NMS and tracker settings; applied in order with
+  // queued frames. Changing the tracker settings restarts tracking.
+  void SetPostprocess(const PostprocessConfig& postprocess,
+                      const TrackerConfig& tracker);
+
+  // Tiled / ROI inference; applied in order with queued frames.
+  void SetTiling(const TilingConfig& config);
+
+  // Runs the PNG/JPEG frames of |clip_dir|, in name order, once through
+  // the single resize and once with |tiling|, and reports cost and recall
+  // for both. Without |labels| (one list per frame, normalized to the
+  // center crop) the reference is every object either pass found. Live
+  // frames queue behind the benchmark.
+  void BenchmarkTiling(std::string clip_dir, int max_frames,
+                       double clip_fps, const TilingConfig& tiling,
+                       float score_threshold,
+                       std::vector<std::vector<Detection>> labels,
+                       BenchmarkCallback callback);
+
+  void Unload();
+
+  // Destroys the interpreter, and with it the tensor arena and the
+  // inference thread pool, when no frame has run for |idle_ms|. The model
+  // stays parsed; the next frame recreates the interpreter with the same
+  // threads, paying one allocation and a cold first invoke.
+  void ReleaseIdle(int idle_ms, ReleaseCallback callback);
+
+  bool is_loaded() const { return loaded_.load(); }
+  ModelInfo model_info() const;
+  // SIMD variant picked for preprocessing; fixed at construction.
+  const char* preprocess_kernel() const {
+    return preprocessor_.kernel_name();
+  }
+
+ private:
+  void Post(std::function<void()> task);
+  void WorkerLoop();
+
+  // Worker-thread only.
+  bool LoadOnWorker(std::vector<uint8_t> model_bytes,
+                    const InferenceThreadConfig& threads, std::string* error);
+  // (Re)creates the options and interpreter for the loaded model.
+  bool CreateInterpreter(const InferenceThreadConfig& threads,
+                         std::string* error);
+  void DestroyInterpreter();
+  // Recreates an interpreter released while idle and marks it used; fails
+  // without a model.
+  bool EnsureInterpreter(std::string* error);
+  // Invokes |runs| times on a mid-gray input.
+  void WarmUp(int runs, double* first_ms, double* mean_ms);
+  bool BenchmarkThreadsOnWorker(const std::vector<int>& thread_counts,
+                                int iterations,
+                                std::vector<ThreadBenchmark>* results,
+                                InferenceThreadConfig* chosen,
+                                std::string* error);
+  void UnloadOnWorker();
+  DetectionResult DetectOnWorker(Frame* frame, float score_threshold);
+  DetectionResult DetectFromRingOnWorker(FrameRing* ring, int slot,
+                                         uint64_t frame_id, bool allow_newer,
+                                         float score_threshold);
+  // Runs the motion gate, plans the crops, then runs them through the
+  // interpreter and the tracker; shared by both entry points. |lease|, when
+  // set, is released as soon as the pixels have been consumed so the
+  // producer gets its slot back before inference.
+  void InferOnWorker(const ImageView& src, FrameRing::ReadLease* lease,
+                     float score_threshold,
+                     std::chrono::steady_clock::time_point start,
+                     DetectionResult* result);
+  // Preprocesses each of |crops| into the input tensor, as one batch when
+  // the model allows it, invokes and collects the detections in normalized
+  // |area| coordinates. Fills the detections, counts and stage timings of
+  // |result|.
+  bool RunCrops(const ImageView& src, const CropRect& area,
+                const std::vector<CropRect>& crops,
+                const TilingConfig& tiling, FrameRing::ReadLease* lease,
+                float score_threshold, DetectionResult* result);
+  // Resizes the input tensor to |batch| crops. Fails, and leaves a batch of
+  // one, for models whose outputs do not follow the batch.
+  bool SetBatchSize(int batch);
+  bool ReadDetections(int batch_index, float score_threshold,
+                      std::vector<Detection>* detections, int* raw_count,
+                      std::string* error);
+  void UpdateTracks(bool skipped, DetectionResult* result);
+  bool BenchmarkOnWorker(const std::string& clip_dir, int max_frames,
+                         double clip_fps, const TilingConfig& tiling,
+                         float score_threshold,
+                         const std::vector<std::vector<Detection>>& labels,
+                         std::vector<TilingBenchmark>* results,
+                         std::string* error);
+
+  std::thread worker_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_ = false;
+
+  mutable std::mutex info_mutex_;
+  ModelInfo info_;
+  std::atomic<bool> loaded_{false};
+  FrameDecoder decoder_;
+
+  FramePreprocessor preprocessor_;
+  MotionGate motion_gate_;
+  PostprocessConfig postprocess_;
+  ObjectTracker tracker_;
+  TilePlanner tile_planner_;
+  const TfLiteApi* api_ = nullptr;
+  std::vector<uint8_t> model_bytes_;
+  TfLiteModel* model_ = nullptr;
+  TfLiteInterpreterOptions* options_ = nullptr;
+  TfLiteInterpreter* interpreter_ = nullptr;
+  std::chrono::steady_clock::time_point last_used_;
+  InferenceThreadConfig threads_;
+  std::string thread_warning_;
+  int batch_size_ = 1;
+  bool batch_unsupported_ = false;
+
+  // Scratch, reused between frames.
+  std::vector<CropRect> crops_;
+  std::vector<Detection> rois_;
+  std::vector<Detection> crop_detections_;
+  std::vector<Track> roi_tracks_;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_DETECTION_ENGINE_H_
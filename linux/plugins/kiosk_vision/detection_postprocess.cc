@@ -0,0 +1,134 @@
+#include "detection_postprocess.h"
+
+#include <algorithm>
+
+namespace kiosk_vision {
+
+float BoxIou(const Detection& a, const Detection& b) {
+  const float width = std::min(a.x2, b.x2) - std::max(a.x1, b.x1);
+  const float height = std::min(a.y2, b.y2) - std::max(a.y1, b.y1);
+  if (width <= 0 || height <= 0) {
+    return 0;
+  }
+  const float intersection = width * height;
+  const float area_a = (a.x2 - a.x1) * (a.y2 - a.y1);
+  const float area_b = (b.x2 - b.x1) * (b.y2 - b.y1);
+  const float union_area = area_a + area_b - intersection;
+  return union_area > 0 ? intersection / union_area : 0;
+}
+
+void DecodeSsdDetections(const float* boxes, const float* classes,
+                         const float* scores, int count,
+                         float default_threshold,
+                         const PostprocessConfig& config,
+                         std::vector<Detection>* detections) {
+  detections->clear();
+  const int thresholds = static_cast<int>(config.class_thresholds.size());
+  for (int i = 0; i < count; ++i) {
+    const int class_id = static_cast<int>(classes[i]);
+    float threshold = default_threshold;
+    if (class_id >= 0 && class_id < thresholds &&
+        config.class_thresholds[class_id] >= 0) {
+      threshold = config.class_thresholds[class_id];
+    }
+    if (scores[i] <= threshold) {
+      continue;
+    }
+    Detection detection;
+    detection.y1 = std::max(0.0f, boxes[i * 4 + 0]);
+    detection.x1 = std::max(0.0f, boxes[i * 4 + 1]);
+    detection.y2 = std::min(1.0f, boxes[i * 4 + 2]);
+    detection.x2 = std::min(1.0f, boxes[i * 4 + 3]);
+    if (detection.x2 <= detection.x1 || detection.y2 <= detection.y1) {
+      continue;
+    }
+    detection.score = scores[i];
+    detection.class_id = class_id;
+    detections->push_back(detection);
+  }
+  NonMaxSuppression(config.nms_iou, config.class_agnostic_nms,
+                    config.max_detections, detections);
+}
+
+void NonMaxSuppression(float iou_threshold, bool class_agnostic,
+                       int max_detections,
+                       std::vector<Detection>* detections) {
+  std::stable_sort(detections->begin(), detections->end(),
+                   [](const Detection& a, const Detection& b) {
+                     return a.score > b.score;
+                   });
+  // The SSD graph already ran its own NMS, so this is a handful of boxes
+  // and the quadratic scan is cheaper than anything cleverer.
+  size_t kept = 0;
+  for (size_t i = 0; i < detections->size(); ++i) {
+    if (max_detections > 0 && static_cast<int>(kept) >= max_detections) {
+      break;
+    }
+    const Detection& candidate = (*detections)[i];
+    bool suppressed = false;
+    for (size_t j = 0; j < kept; ++j) {
+      const Detection& winner = (*detections)[j];
+      if ((class_agnostic || winner.class_id == candidate.class_id) &&
+          BoxIou(winner, candidate) > iou_threshold) {
+        suppressed = true;
+        break;
+      }
+    }
+    if (!suppressed) {
+      (*detections)[kept++] = candidate;
+    }
+  }
+  detections->resize(kept);
+}
+
+void MergeDetections(float iou_threshold, float containment,
+                     bool class_agnostic, int max_detections,
+                     std::vector<Detection>* detections) {
+  std::stable_sort(detections->begin(), detections->end(),
+                   [](const Detection& a, const Detection& b) {
+                     return a.score > b.score;
+                   });
+  size_t kept = 0;
+  for (size_t i = 0; i < detections->size(); ++i) {
+    const Detection candidate = (*detections)[i];
+    bool absorbed = false;
+    for (size_t j = 0; j < kept; ++j) {
+      Detection& winner = (*detections)[j];
+      const bool same_class = winner.class_id == candidate.class_id;
+      if (!same_class && !class_agnostic) {
+        continue;
+      }
+      if (same_class) {
+        const float width = std::min(winner.x2, candidate.x2) -
+                            std::max(winner.x1, candidate.x1);
+        const float height = std::min(winner.y2, candidate.y2) -
+                             std::max(winner.y1, candidate.y1);
+        const float smaller = std::min(
+            (winner.x2 - winner.x1) * (winner.y2 - winner.y1),
+            (candidate.x2 - candidate.x1) * (candidate.y2 - candidate.y1));
+        if (width > 0 && height > 0 && smaller > 0 &&
+            width * height >= containment * smaller) {
+          winner.x1 = std::min(winner.x1, candidate.x1);
+          winner.y1 = std::min(winner.y1, candidate.y1);
+          winner.x2 = std::max(winner.x2, candidate.x2);
+          winner.y2 = std::max(winner.y2, candidate.y2);
+          absorbed = true;
+          break;
+        }
+      }
+      if (BoxIou(winner, candidate) > iou_threshold) {
+        absorbed = true;
+        break;
+      }
+    }
+    if (!absorbed) {
+      if (max_detections > 0 && static_cast<int>(kept) >= max_detections) {
+        break;
+      }
+      (*detections)[kept++] = candidate;
+    }
+  }
+  detections->resize(kept);
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,59 @@
+#ifndef PLUGINS_KIOSK_VISION_DETECTION_POSTPROCESS_H_
+#define PLUGINS_KIOSK_VISION_DETECTION_POSTPROCESS_H_
+
+#include <vector>
+
+namespace kiosk_vision {
+
+// One detection in normalized [0, 1] coordinates of the cropped frame, the
+// same convention as DetectionBox in person_detection_service.dart.
+struct Detection {
+  float x1 = 0;
+  float y1 = 0;
+  float x2 = 0;
+  float y2 = 0;
+  float score = 0;
+  int class_id = 0;
+};
+
+struct PostprocessConfig {
+  // Minimum score per class id. Classes past the end, or with a negative
+  // entry, use the threshold passed with the frame.
+  std::vector<float> class_thresholds;
+  // Boxes overlapping a higher scoring box by more than this are dropped.
+  float nms_iou = 0.5f;
+  // Suppress across classes, e.g. when the model reports one object as
+  // both "cat" and "dog".
+  bool class_agnostic_nms = false;
+  int max_detections = 50;
+};
+
+float BoxIou(const Detection& a, const Detection& b);
+
+// Decodes SSD MobileNet post-processed outputs, read in place from the
+// interpreter: |boxes| holds |count| (y1, x1, y2, x2) quads, |classes| and
+// |scores| one value per box. Applies the per-class thresholds and NMS and
+// leaves the survivors in |detections|, best first.
+void DecodeSsdDetections(const float* boxes, const float* classes,
+                         const float* scores, int count,
+                         float default_threshold,
+                         const PostprocessConfig& config,
+                         std::vector<Detection>* detections);
+
+// Greedy non-maximum suppression in place; keeps at most |max_detections|.
+void NonMaxSuppression(float iou_threshold, bool class_agnostic,
+                       int max_detections,
+                       std::vector<Detection>* detections);
+
+// Merges detections gathered from overlapping crops, already mapped into
+// one coordinate space. Suppresses like NonMaxSuppression, and in addition
+// folds a box whose intersection with a kept box of the same class covers
+// |containment| of the smaller one into that box, growing it to their
+// union: an object cut by a tile edge and the same object seen whole.
+void MergeDetections(float iou_threshold, float containment,
+                     bool class_agnostic, int max_detections,
+                     std::vector<Detection>* detections);
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_DETECTION_POSTPROCESS_H_
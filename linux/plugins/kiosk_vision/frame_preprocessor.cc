@@ -0,0 +1,449 @@
+#include "frame_preprocessor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KIOSK_VISION_X86 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define KIOSK_VISION_NEON 1
+#endif
+
+namespace kiosk_vision {
+
+namespace {
+
+// Byte offsets of R, G and B within a source pixel, plus its size.
+struct ChannelLayout {
+  int r;
+  int g;
+  int b;
+  int bytes_per_pixel;
+};
+
+ChannelLayout LayoutFor(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::kBgra:
+      return {2, 1, 0, 4};
+    case PixelFormat::kRgb:
+      return {0, 1, 2, 3};
+    case PixelFormat::kRgba:
+    default:
+      return {0, 1, 2, 4};
+  }
+}
+
+const float kNormalize = 1.0f / 255.0f;
+
+// Source coordinate for output index |i| with pixel-center alignment,
+// clamped to [0, extent - 1].
+float SourceCoordinate(int i, float scale, int extent) {
+  const float s = (i + 0.5f) * scale - 0.5f;
+  return std::min(std::max(s, 0.0f), static_cast<float>(extent - 1));
+}
+
+// ---------------------------------------------------------------------------
+// Vertical pass: out[i] = a[i] + (b[i] - a[i]) * weight over |count| bytes.
+// ---------------------------------------------------------------------------
+
+void BlendRowsScalar(const uint8_t* a, const uint8_t* b, float weight,
+                     float* out, int count) {
+  for (int i = 0; i < count; ++i) {
+    out[i] = a[i] + (b[i] - a[i]) * weight;
+  }
+}
+
+#if defined(KIOSK_VISION_X86)
+
+inline void BlendFourSse2(__m128i a32, __m128i b32, __m128 weight,
+                          float* out) {
+  const __m128 fa = _mm_cvtepi32_ps(a32);
+  const __m128 fb = _mm_cvtepi32_ps(b32);
+  _mm_storeu_ps(out, _mm_add_ps(fa, _mm_mul_ps(_mm_sub_ps(fb, fa), weight)));
+}
+
+void BlendRowsSse2(const uint8_t* a, const uint8_t* b, float weight,
+                   float* out, int count) {
+  const __m128 w = _mm_set1_ps(weight);
+  const __m128i zero = _mm_setzero_si128();
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m128i ra =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i rb =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    const __m128i a_lo = _mm_unpacklo_epi8(ra, zero);
+    const __m128i a_hi = _mm_unpackhi_epi8(ra, zero);
+    const __m128i b_lo = _mm_unpacklo_epi8(rb, zero);
+    const __m128i b_hi = _mm_unpackhi_epi8(rb, zero);
+    BlendFourSse2(_mm_unpacklo_epi16(a_lo, zero),
+                  _mm_unpacklo_epi16(b_lo, zero), w, out + i);
+    BlendFourSse2(_mm_unpackhi_epi16(a_lo, zero),
+                  _mm_unpackhi_epi16(b_lo, zero), w, out + i + 4);
+    BlendFourSse2(_mm_unpacklo_epi16(a_hi, zero),
+                  _mm_unpacklo_epi16(b_hi, zero), w, out + i + 8);
+    BlendFourSse2(_mm_unpackhi_epi16(a_hi, zero),
+                  _mm_unpackhi_epi16(b_hi, zero), w, out + i + 12);
+  }
+  BlendRowsScalar(a + i, b + i, weight, out + i, count - i);
+}
+
+__attribute__((target("avx2,fma"))) void BlendRowsAvx2(const uint8_t* a,
+                                                       const uint8_t* b,
+                                                       float weight,
+                                                       float* out,
+                                                       int count) {
+  const __m256 w = _mm256_set1_ps(weight);
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    const __m128i ra =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i rb =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    const __m256 a0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(ra));
+    const __m256 b0 = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(rb));
+    const __m256 a1 =
+        _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(ra, 8)));
+    const __m256 b1 =
+        _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(rb, 8)));
+    // Multiply and add rather than FMA, whose single rounding would not
+    // match the other kernels bit for bit.
+    _mm256_storeu_ps(
+        out + i, _mm256_add_ps(a0, _mm256_mul_ps(_mm256_sub_ps(b0, a0), w)));
+    _mm256_storeu_ps(
+        out + i + 8,
+        _mm256_add_ps(a1, _mm256_mul_ps(_mm256_sub_ps(b1, a1), w)));
+  }
+  BlendRowsScalar(a + i, b + i, weight, out + i, count - i);
+}
+
+bool CpuHasAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+
+#elif defined(KIOSK_VISION_NEON)
+
+void BlendRowsNeon(const uint8_t* a, const uint8_t* b, float weight,
+                   float* out, int count) {
+  const float32x4_t w = vdupq_n_f32(weight);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    const uint16x8_t a16 = vmovl_u8(vld1_u8(a + i));
+    const uint16x8_t b16 = vmovl_u8(vld1_u8(b + i));
+    const float32x4_t a0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(a16)));
+    const float32x4_t a1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(a16)));
+    const float32x4_t b0 = vcvtq_f32_u32(vmovl_u16(vget_low_u16(b16)));
+    const float32x4_t b1 = vcvtq_f32_u32(vmovl_u16(vget_high_u16(b16)));
+    vst1q_f32(out + i, vmlaq_f32(a0, vsubq_f32(b0, a0), w));
+    vst1q_f32(out + i + 4, vmlaq_f32(a1, vsubq_f32(b1, a1), w));
+  }
+  BlendRowsScalar(a + i, b + i, weight, out + i, count - i);
+}
+
+#endif
+
+// ---------------------------------------------------------------------------
+// Horizontal pass: blend two neighbouring pixels of the scratch row as one
+// 4-lane vector, reorder to RGB and store into the tensor row. The fourth
+// lane spills into the next pixel, which is overwritten right after, so only
+// the last pixel of a row needs a narrow store.
+// ---------------------------------------------------------------------------
+
+void ResampleRowScalar(const float* row, const int* offset0,
+                       const int* offset1, const float* weight, int width,
+                       bool swap_rb, bool quantized, void* out) {
+  uint8_t* out_u8 = static_cast<uint8_t*>(out);
+  float* out_f32 = static_cast<float*>(out);
+  const int r = swap_rb ? 2 : 0;
+  const int b = swap_rb ? 0 : 2;
+  for (int x = 0; x < width; ++x) {
+    const float* p0 = row + offset0[x];
+    const float* p1 = row + offset1[x];
+    const float w = weight[x];
+    const float rgb[3] = {p0[r] + (p1[r] - p0[r]) * w,
+                          p0[1] + (p1[1] - p0[1]) * w,
+                          p0[b] + (p1[b] - p0[b]) * w};
+    for (int c = 0; c < 3; ++c) {
+      if (quantized) {
+        out_u8[x * 3 + c] = static_cast<uint8_t>(
+            std::min(255.0f, std::max(0.0f, rgb[c] + 0.5f)));
+      } else {
+        out_f32[x * 3 + c] = rgb[c] * kNormalize;
+      }
+    }
+  }
+}
+
+#if defined(KIOSK_VISION_X86)
+
+void ResampleRowSse2(const float* row, const int* offset0, const int* offset1,
+                     const float* weight, int width, bool swap_rb,
+                     bool quantized, void* out) {
+  uint8_t* out_u8 = static_cast<uint8_t*>(out);
+  float* out_f32 = static_cast<float*>(out);
+  const __m128 normalize = _mm_set1_ps(kNormalize);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const int vector_width = width - 1;
+  for (int x = 0; x < vector_width; ++x) {
+    const __m128 p0 = _mm_loadu_ps(row + offset0[x]);
+    const __m128 p1 = _mm_loadu_ps(row + offset1[x]);
+    __m128 v = _mm_add_ps(
+        p0, _mm_mul_ps(_mm_sub_ps(p1, p0), _mm_set1_ps(weight[x])));
+    if (swap_rb) {
+      v = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2));
+    }
+    if (quantized) {
+      // Values are in [0, 255], so truncating after +0.5 rounds and the
+      // saturating packs cannot overflow.
+      const __m128i i32 = _mm_cvttps_epi32(_mm_add_ps(v, half));
+      const __m128i i16 = _mm_packs_epi32(i32, i32);
+      const int32_t packed = _mm_cvtsi128_si32(_mm_packus_epi16(i16, i16));
+      memcpy(out_u8 + x * 3, &packed, sizeof(packed));
+    } else {
+      _mm_storeu_ps(out_f32 + x * 3, _mm_mul_ps(v, normalize));
+    }
+  }
+  if (width > 0) {
+    const int last = width - 1;
+    if (quantized) {
+      ResampleRowScalar(row, offset0 + last, offset1 + last, weight + last, 1,
+                        swap_rb, true, out_u8 + last * 3);
+    } else {
+      ResampleRowScalar(row, offset0 + last, offset1 + last, weight + last, 1,
+                        swap_rb, false, out_f32 + last * 3);
+    }
+  }
+}
+
+#elif defined(KIOSK_VISION_NEON)
+
+void ResampleRowNeon(const float* row, const int* offset0, const int* offset1,
+                     const float* weight, int width, bool swap_rb,
+                     bool quantized, void* out) {
+  uint8_t* out_u8 = static_cast<uint8_t*>(out);
+  float* out_f32 = static_cast<float*>(out);
+  const float32x4_t normalize = vdupq_n_f32(kNormalize);
+  const float32x4_t half = vdupq_n_f32(0.5f);
+  const int vector_width = width - 1;
+  for (int x = 0; x < vector_width; ++x) {
+    const float32x4_t p0 = vld1q_f32(row + offset0[x]);
+    const float32x4_t p1 = vld1q_f32(row + offset1[x]);
+    float32x4_t v = vmlaq_n_f32(p0, vsubq_f32(p1, p0), weight[x]);
+    if (swap_rb) {
+      float lanes[4];
+      vst1q_f32(lanes, v);
+      std::swap(lanes[0], lanes[2]);
+      v = vld1q_f32(lanes);
+    }
+    if (quantized) {
+      const uint32x4_t u32 = vcvtq_u32_f32(vaddq_f32(v, half));
+      const uint8x8_t u8 = vqmovn_u16(vcombine_u16(vqmovn_u32(u32),
+                                                    vqmovn_u32(u32)));
+      const uint32_t packed = vget_lane_u32(vreinterpret_u32_u8(u8), 0);
+      memcpy(out_u8 + x * 3, &packed, sizeof(packed));
+    } else {
+      vst1q_f32(out_f32 + x * 3, vmulq_f32(v, normalize));
+    }
+  }
+  if (width > 0) {
+    const int last = width - 1;
+    if (quantized) {
+      ResampleRowScalar(row, offset0 + last, offset1 + last, weight + last, 1,
+                        swap_rb, true, out_u8 + last * 3);
+    } else {
+      ResampleRowScalar(row, offset0 + last, offset1 + last, weight + last, 1,
+                        swap_rb, false, out_f32 + last * 3);
+    }
+  }
+}
+
+#endif
+
+}  // namespace
+
+CropRect CenterCrop(int source_width, int source_height, int target_width,
+                    int target_height) {
+  CropRect crop{0, 0, source_width, source_height};
+  if (source_width <= 0 || source_height <= 0 || target_width <= 0 ||
+      target_height <= 0) {
+    return crop;
+  }
+
+  const double source_aspect =
+      static_cast<double>(source_width) / source_height;
+  const double target_aspect =
+      static_cast<double>(target_width) / target_height;
+  if (source_aspect > target_aspect) {
+    crop.width = static_cast<int>(std::lround(source_height * target_aspect));
+    crop.x = static_cast<int>(std::lround((source_width - crop.width) / 2.0));
+  } else {
+    crop.height = static_cast<int>(std::lround(source_width / target_aspect));
+    crop.y = static_cast<int>(std::lround((source_height - crop.height) / 2.0));
+  }
+  crop.width = std::max(1, std::min(crop.width, source_width - crop.x));
+  crop.height = std::max(1, std::min(crop.height, source_height - crop.y));
+  return crop;
+}
+
+void PreprocessFrameScalar(const ImageView& src, const TensorView& dst) {
+  const CropRect crop =
+      CenterCrop(src.width, src.height, dst.width, dst.height);
+  const ChannelLayout layout = LayoutFor(src.format);
+  const float scale_x = static_cast<float>(crop.width) / dst.width;
+  const float scale_y = static_cast<float>(crop.height) / dst.height;
+
+  uint8_t* out_u8 = static_cast<uint8_t*>(dst.data);
+  float* out_f32 = static_cast<float*>(dst.data);
+
+  for (int y = 0; y < dst.height; ++y) {
+    // Pixel-center sampling, clamped to the crop rectangle.
+    const float sy = SourceCoordinate(y, scale_y, crop.height);
+    const int y0 = static_cast<int>(sy);
+    const int y1 = std::min(y0 + 1, crop.height - 1);
+    const float wy = sy - y0;
+    const uint8_t* row0 =
+        src.data + static_cast<size_t>(crop.y + y0) * src.stride;
+    const uint8_t* row1 =
+        src.data + static_cast<size_t>(crop.y + y1) * src.stride;
+
+    for (int x = 0; x < dst.width; ++x) {
+      const float sx = SourceCoordinate(x, scale_x, crop.width);
+      const int x0 = static_cast<int>(sx);
+      const int x1 = std::min(x0 + 1, crop.width - 1);
+      const float wx = sx - x0;
+      const int off0 = (crop.x + x0) * layout.bytes_per_pixel;
+      const int off1 = (crop.x + x1) * layout.bytes_per_pixel;
+
+      const int channel_offsets[3] = {layout.r, layout.g, layout.b};
+      const size_t index = (static_cast<size_t>(y) * dst.width + x) * 3;
+      for (int c = 0; c < 3; ++c) {
+        // Vertical first, then horizontal, in the same float operations as
+        // the vectorized passes so the results match them exactly.
+        const int ch = channel_offsets[c];
+        const float left =
+            row0[off0 + ch] + (row1[off0 + ch] - row0[off0 + ch]) * wy;
+        const float right =
+            row0[off1 + ch] + (row1[off1 + ch] - row0[off1 + ch]) * wy;
+        const float value = left + (right - left) * wx;
+        if (dst.quantized) {
+          out_u8[index + c] = static_cast<uint8_t>(
+              std::min(255.0f, std::max(0.0f, value + 0.5f)));
+        } else {
+          out_f32[index + c] = value * kNormalize;
+        }
+      }
+    }
+  }
+}
+
+FramePreprocessor::FramePreprocessor() {
+#if defined(KIOSK_VISION_X86)
+  use_avx2_ = CpuHasAvx2();
+#endif
+}
+
+const char* FramePreprocessor::kernel_name() const {
+#if defined(KIOSK_VISION_X86)
+  return use_avx2_ ? "avx2" : "sse2";
+#elif defined(KIOSK_VISION_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+void FramePreprocessor::UpdatePlan(const ImageView& src,
+                                   const TensorView& dst) {
+  if (src.width == src_width_ && src.height == src_height_ &&
+      dst.width == dst_width_ && dst.height == dst_height_ &&
+      src.format == format_) {
+    return;
+  }
+  src_width_ = src.width;
+  src_height_ = src.height;
+  dst_width_ = dst.width;
+  dst_height_ = dst.height;
+  format_ = src.format;
+
+  crop_ = CenterCrop(src.width, src.height, dst.width, dst.height);
+  bytes_per_pixel_ = LayoutFor(src.format).bytes_per_pixel;
+  const float scale_x = static_cast<float>(crop_.width) / dst.width;
+  const float scale_y = static_cast<float>(crop_.height) / dst.height;
+
+  x_offset0_.resize(dst.width);
+  x_offset1_.resize(dst.width);
+  x_weight_.resize(dst.width);
+  for (int x = 0; x < dst.width; ++x) {
+    const float sx = SourceCoordinate(x, scale_x, crop_.width);
+    const int x0 = static_cast<int>(sx);
+    const int x1 = std::min(x0 + 1, crop_.width - 1);
+    x_offset0_[x] = x0 * bytes_per_pixel_;
+    x_offset1_[x] = x1 * bytes_per_pixel_;
+    x_weight_[x] = sx - x0;
+  }
+
+  y_row0_.resize(dst.height);
+  y_row1_.resize(dst.height);
+  y_weight_.resize(dst.height);
+  for (int y = 0; y < dst.height; ++y) {
+    const float sy = SourceCoordinate(y, scale_y, crop_.height);
+    const int y0 = static_cast<int>(sy);
+    y_row0_[y] = crop_.y + y0;
+    y_row1_[y] = crop_.y + std::min(y0 + 1, crop_.height - 1);
+    y_weight_[y] = sy - y0;
+  }
+
+  // One spare pixel so 4-lane loads of packed RGB never run off the end.
+  scratch_row_.assign(static_cast<size_t>(crop_.width + 1) * bytes_per_pixel_,
+                      0.0f);
+}
+
+void FramePreprocessor::Run(const ImageView& src, const TensorView& dst) {
+  if (src.width <= 0 || src.height <= 0 || dst.width <= 0 ||
+      dst.height <= 0) {
+    return;
+  }
+  UpdatePlan(src, dst);
+
+  const bool swap_rb = src.format == PixelFormat::kBgra;
+  const int row_bytes = crop_.width * bytes_per_pixel_;
+  const size_t crop_offset = static_cast<size_t>(crop_.x) * bytes_per_pixel_;
+  const size_t element_size = dst.quantized ? sizeof(uint8_t) : sizeof(float);
+  uint8_t* out = static_cast<uint8_t*>(dst.data);
+  float* scratch = scratch_row_.data();
+
+  for (int y = 0; y < dst.height; ++y) {
+    const uint8_t* row0 =
+        src.data + static_cast<size_t>(y_row0_[y]) * src.stride + crop_offset;
+    const uint8_t* row1 =
+        src.data + static_cast<size_t>(y_row1_[y]) * src.stride + crop_offset;
+    void* out_row = out + static_cast<size_t>(y) * dst.width * 3 * element_size;
+
+#if defined(KIOSK_VISION_X86)
+    if (use_avx2_) {
+      BlendRowsAvx2(row0, row1, y_weight_[y], scratch, row_bytes);
+    } else {
+      BlendRowsSse2(row0, row1, y_weight_[y], scratch, row_bytes);
+    }
+    ResampleRowSse2(scratch, x_offset0_.data(), x_offset1_.data(),
+                    x_weight_.data(), dst.width, swap_rb, dst.quantized,
+                    out_row);
+#elif defined(KIOSK_VISION_NEON)
+    BlendRowsNeon(row0, row1, y_weight_[y], scratch, row_bytes);
+    ResampleRowNeon(scratch, x_offset0_.data(), x_offset1_.data(),
+                    x_weight_.data(), dst.width, swap_rb, dst.quantized,
+                    out_row);
+#else
+    BlendRowsScalar(row0, row1, y_weight_[y], scratch, row_bytes);
+    ResampleRowScalar(scratch, x_offset0_.data(), x_offset1_.data(),
+                      x_weight_.data(), dst.width, swap_rb, dst.quantized,
+                      out_row);
+#endif
+  }
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,100 @@
+#ifndef PLUGINS_KIOSK_VISION_FRAME_PREPROCESSOR_H_
+#define PLUGINS_KIOSK_VISION_FRAME_PREPROCESSOR_H_
+
+#include <cstdint>
+#include <vector>
+
+namespace kiosk_vision {
+
+// Pixel layouts accepted by the preprocessing kernels.
+enum class PixelFormat {
+  kRgba,
+  kBgra,
+  kRgb,
+};
+
+// Non-owning view of a packed source image.
+struct ImageView {
+  const uint8_t* data = nullptr;
+  int width = 0;
+  int height = 0;
+  int stride = 0;  // Bytes per row.
+  PixelFormat format = PixelFormat::kRgba;
+};
+
+// Destination model input tensor (NHWC, batch of one, 3 channels).
+struct TensorView {
+  void* data = nullptr;
+  int width = 0;
+  int height = 0;
+  bool quantized = false;  // uint8 when true, float32 in [0, 1] otherwise.
+};
+
+// Source rectangle selected by the center crop, in source pixels.
+struct CropRect {
+  int x = 0;
+  int y = 0;
+  int width = 0;
+  int height = 0;
+};
+
+// Returns the centered crop of |source_width|x|source_height| matching the
+// aspect ratio of the target. Mirrors _centerCropAndResize in
+// person_detection_service.dart so both paths produce the same framing.
+CropRect CenterCrop(int source_width, int source_height, int target_width,
+                    int target_height);
+
+// Center-crops |src|, resizes it bilinearly to the tensor size, drops the
+// alpha channel and writes the result straight into |dst|. Plain scalar
+// version, kept as the exact reference for the vectorized kernels: both
+// blend vertically, then horizontally, with the same float operations, so
+// uint8 and float outputs match bit for bit.
+void PreprocessFrameScalar(const ImageView& src, const TensorView& dst);
+
+// Fused crop + bilinear resize + channel drop + uint8/float conversion.
+//
+// The resize is split into a vertical pass that blends the two source rows
+// of each output row into a float scratch row (AVX2, SSE2 or NEON depending
+// on the CPU) and a horizontal pass that blends whole RGBA pixels as one
+// 4-lane vector and stores them straight into the tensor. Sampling tables
+// and the scratch row are cached, so steady-state frames do not allocate.
+//
+// Not thread-safe; each worker owns its own instance.
+class FramePreprocessor {
+ public:
+  FramePreprocessor();
+
+  void Run(const ImageView& src, const TensorView& dst);
+
+  // Name of the kernel selected for this CPU ("avx2", "sse2", "neon" or
+  // "scalar").
+  const char* kernel_name() const;
+
+ private:
+  void UpdatePlan(const ImageView& src, const TensorView& dst);
+
+  // Cache key for the sampling tables.
+  int src_width_ = 0;
+  int src_height_ = 0;
+  int dst_width_ = 0;
+  int dst_height_ = 0;
+  PixelFormat format_ = PixelFormat::kRgba;
+
+  CropRect crop_;
+  int bytes_per_pixel_ = 4;
+  // Per output column: float offsets of the two source pixels in the
+  // scratch row and the weight of the right one.
+  std::vector<int> x_offset0_;
+  std::vector<int> x_offset1_;
+  std::vector<float> x_weight_;
+  // Per output row: the two source rows and the weight of the lower one.
+  std::vector<int> y_row0_;
+  std::vector<int> y_row1_;
+  std::vector<float> y_weight_;
+  std::vector<float> scratch_row_;
+  bool use_avx2_ = false;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_FRAME_PREPROCESSOR_H_
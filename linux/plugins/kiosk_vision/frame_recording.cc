@@ -0,0 +1,299 @@
+#include "frame_recording.h"
+
+#include <cstring>
+
+namespace kiosk_vision {
+
+namespace {
+
+const char kFileMagic[8] = {'K', 'V', 'R', 'E', 'C', '0', '0', '1'};
+const uint32_t kFrameMagic = 0x5246564B;  // "KVFR"
+
+// Frames the producer can hand over before the writer catches up.
+const int kMaxQueuedFrames = 8;
+
+// Larger than any camera frame; anything bigger is corruption.
+const uint32_t kMaxFrameBytes = 64u << 20;
+
+struct FrameRecordHeader {
+  uint32_t magic;
+  uint32_t payload_bytes;
+  int64_t timestamp_us;
+  uint64_t frame_id;
+  uint16_t width;
+  uint16_t height;
+  uint32_t reserved;
+};
+static_assert(sizeof(FrameRecordHeader) == 32, "Recording layout is fixed");
+
+// Packs |frame| into RGB rows, dropping alpha and undoing BGR order.
+void PackRgb(const ImageView& frame, std::vector<uint8_t>* out) {
+  out->resize(static_cast<size_t>(frame.width) * frame.height * 3);
+  uint8_t* dst = out->data();
+  for (int y = 0; y < frame.height; ++y) {
+    const uint8_t* row = frame.data + static_cast<size_t>(y) * frame.stride;
+    if (frame.format == PixelFormat::kRgb) {
+      memcpy(dst, row, static_cast<size_t>(frame.width) * 3);
+      dst += frame.width * 3;
+      continue;
+    }
+    const bool bgr = frame.format == PixelFormat::kBgra;
+    for (int x = 0; x < frame.width; ++x) {
+      const uint8_t* pixel = row + x * 4;
+      dst[0] = pixel[bgr ? 2 : 0];
+      dst[1] = pixel[1];
+      dst[2] = pixel[bgr ? 0 : 2];
+      dst += 3;
+    }
+  }
+}
+
+}  // namespace
+
+ImageView RecordedFrame::view() const {
+  ImageView view;
+  view.data = pixels.data();
+  view.width = width;
+  view.height = height;
+  view.stride = width * 3;
+  view.format = PixelFormat::kRgb;
+  return view;
+}
+
+FrameRecorder::~FrameRecorder() {
+  Stop();
+}
+
+bool FrameRecorder::Start(const std::string& path,
+                          const RecordingMetadata& metadata,
+                          uint64_t max_bytes, std::string* error) {
+  Stop();
+  file_.open(path, std::ios::binary | std::ios::trunc);
+  if (!file_) {
+    *error = "Failed to create " + path;
+    return false;
+  }
+  std::string text;
+  for (const auto& entry : metadata) {
+    text += entry.first + "=" + entry.second + "\n";
+  }
+  const uint32_t size = static_cast<uint32_t>(text.size());
+  file_.write(kFileMagic, sizeof(kFileMagic));
+  file_.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  file_.write(text.data(), text.size());
+
+  max_bytes_ = max_bytes;
+  first_timestamp_us_ = 0;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_ = RecordingStats();
+    stats_.recording = true;
+    stats_.path = path;
+    stats_.bytes_written = sizeof(kFileMagic) + sizeof(size) + text.size();
+  }
+  {
+    // Frames that raced the previous Stop() belong to no recording.
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (RecordedFrame& frame : queue_) {
+      spare_.push_back(std::move(frame));
+    }
+    queue_.clear();
+    stopping_ = false;
+  }
+  writer_ = std::thread(&FrameRecorder::WriterLoop, this);
+  recording_ = true;
+  return true;
+}
+
+void FrameRecorder::Stop() {
+  if (!writer_.joinable()) {
+    return;
+  }
+  recording_ = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  writer_.join();
+  file_.close();
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  stats_.recording = false;
+}
+
+void FrameRecorder::Record(const ImageView& frame, uint64_t frame_id,
+                           int64_t timestamp_us) {
+  if (!recording_.load() || frame.width > 0xFFFF || frame.height > 0xFFFF) {
+    return;
+  }
+  RecordedFrame buffer;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!spare_.empty()) {
+      buffer = std::move(spare_.back());
+      spare_.pop_back();
+    } else if (buffers_ < kMaxQueuedFrames) {
+      buffers_++;
+    } else {
+      std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+      stats_.frames_dropped++;
+      return;
+    }
+  }
+  // The copy happens outside the lock so the writer is never held up.
+  PackRgb(frame, &buffer.pixels);
+  buffer.width = frame.width;
+  buffer.height = frame.height;
+  buffer.frame_id = frame_id;
+  buffer.timestamp_us = timestamp_us;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(std::move(buffer));
+  }
+  wake_.notify_one();
+}
+
+RecordingStats FrameRecorder::stats() const {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  return stats_;
+}
+
+void FrameRecorder::WriterLoop() {
+  while (true) {
+    RecordedFrame frame;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      frame = std::move(queue_.front());
+      queue_.pop_front();
+    }
+
+    FrameRecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kFrameMagic;
+    header.payload_bytes = static_cast<uint32_t>(frame.pixels.size());
+    header.timestamp_us = frame.timestamp_us;
+    header.frame_id = frame.frame_id;
+    header.width = static_cast<uint16_t>(frame.width);
+    header.height = static_cast<uint16_t>(frame.height);
+    const uint64_t bytes = sizeof(header) + frame.pixels.size();
+
+    bool written = false;
+    std::string error;
+    uint64_t total = 0;
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      total = stats_.bytes_written;
+    }
+    if (max_bytes_ == 0 || total + bytes <= max_bytes_) {
+      file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file_.write(reinterpret_cast<const char*>(frame.pixels.data()),
+                  frame.pixels.size());
+      written = file_.good();
+      if (!written) {
+        error = "Write failed; disk full?";
+      }
+    }
+    if (written && first_timestamp_us_ == 0) {
+      first_timestamp_us_ = frame.timestamp_us;
+    }
+    {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      if (written) {
+        stats_.frames_written++;
+        stats_.bytes_written += bytes;
+        stats_.duration_us = frame.timestamp_us - first_timestamp_us_;
+      } else {
+        stats_.frames_dropped++;
+        if (!error.empty()) {
+          stats_.error = error;
+        }
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    spare_.push_back(std::move(frame));
+  }
+}
+
+bool RecordingReader::Open(const std::string& path, std::string* error) {
+  file_.close();
+  file_.clear();
+  metadata_.clear();
+  file_.open(path, std::ios::binary);
+  char magic[sizeof(kFileMagic)] = {};
+  uint32_t size = 0;
+  if (!file_ || !file_.read(magic, sizeof(magic)) ||
+      memcmp(magic, kFileMagic, sizeof(magic)) != 0 ||
+      !file_.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+    *error = "Not a frame recording: " + path;
+    return false;
+  }
+  std::string text(size, '\0');
+  if (!file_.read(&text[0], size)) {
+    *error = "Recording metadata is cut short";
+    return false;
+  }
+  size_t start = 0;
+  while (start < text.size()) {
+    size_t end = text.find('\n', start);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    const std::string line = text.substr(start, end - start);
+    const size_t equals = line.find('=');
+    if (equals != std::string::npos) {
+      metadata_.emplace_back(line.substr(0, equals), line.substr(equals + 1));
+    }
+    start = end + 1;
+  }
+  first_frame_ = file_.tellg();
+  return true;
+}
+
+std::string RecordingReader::metadata_value(const std::string& key) const {
+  for (const auto& entry : metadata_) {
+    if (entry.first == key) {
+      return entry.second;
+    }
+  }
+  return std::string();
+}
+
+bool RecordingReader::Next(RecordedFrame* frame, std::string* error) {
+  FrameRecordHeader header;
+  if (!file_.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+    if (file_.gcount() != 0) {
+      *error = "Recording is cut short";
+    }
+    return false;
+  }
+  if (header.magic != kFrameMagic ||
+      header.payload_bytes !=
+          static_cast<uint32_t>(header.width) * header.height * 3 ||
+      header.payload_bytes > kMaxFrameBytes) {
+    *error = "Corrupt frame record";
+    return false;
+  }
+  frame->pixels.resize(header.payload_bytes);
+  if (!file_.read(reinterpret_cast<char*>(frame->pixels.data()),
+                  header.payload_bytes)) {
+    *error = "Recording is cut short";
+    return false;
+  }
+  frame->width = header.width;
+  frame->height = header.height;
+  frame->frame_id = header.frame_id;
+  frame->timestamp_us = header.timestamp_us;
+  return true;
+}
+
+void RecordingReader::Rewind() {
+  file_.clear();
+  file_.seekg(first_frame_);
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,121 @@
+#ifndef PLUGINS_KIOSK_VISION_FRAME_RECORDING_H_
+#define PLUGINS_KIOSK_VISION_FRAME_RECORDING_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "frame_preprocessor.h"
+
+namespace kiosk_vision {
+
+// Recording file layout, little-endian:
+//
+//   "KVREC001", uint32 metadata size, metadata as "key=value\n" lines
+//   per frame: 32-byte FrameRecordHeader, then height rows of
+//              width * 3 bytes of RGB, without padding
+//
+// Frames are stored exactly as the detector received them, minus the
+// alpha channel it never reads, so a replay feeds the pipeline the same
+// pixels.
+using RecordingMetadata = std::vector<std::pair<std::string, std::string>>;
+
+struct RecordedFrame {
+  std::vector<uint8_t> pixels;  // Packed RGB.
+  int width = 0;
+  int height = 0;
+  uint64_t frame_id = 0;
+  int64_t timestamp_us = 0;
+
+  ImageView view() const;
+};
+
+struct RecordingStats {
+  bool recording = false;
+  std::string path;
+  uint64_t frames_written = 0;
+  // Not written because the disk fell behind or the size limit was hit.
+  uint64_t frames_dropped = 0;
+  uint64_t bytes_written = 0;
+  // First to last recorded frame.
+  int64_t duration_us = 0;
+  std::string error;
+};
+
+// Writes ring frames to a recording from the capture path. Record() only
+// copies the frame into a spare buffer on the producer thread; a writer
+// thread does the disk I/O, and frames arriving while every buffer is
+// queued are dropped and counted rather than stalling the camera.
+class FrameRecorder {
+ public:
+  FrameRecorder() = default;
+  ~FrameRecorder();
+
+  // Disallow copy and assign.
+  FrameRecorder(const FrameRecorder&) = delete;
+  FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+  // Replaces any recording in progress. Frames past |max_bytes| (0 for no
+  // limit) are dropped.
+  bool Start(const std::string& path, const RecordingMetadata& metadata,
+             uint64_t max_bytes, std::string* error);
+  // Writes out what is queued and closes the file.
+  void Stop();
+
+  // Producer thread.
+  void Record(const ImageView& frame, uint64_t frame_id,
+              int64_t timestamp_us);
+
+  bool is_recording() const { return recording_.load(); }
+  RecordingStats stats() const;
+
+ private:
+  void WriterLoop();
+
+  std::atomic<bool> recording_{false};
+  std::ofstream file_;
+  uint64_t max_bytes_ = 0;
+  std::thread writer_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<RecordedFrame> queue_;
+  std::vector<RecordedFrame> spare_;
+  int buffers_ = 0;
+  bool stopping_ = false;
+
+  mutable std::mutex stats_mutex_;
+  RecordingStats stats_;
+  int64_t first_timestamp_us_ = 0;
+};
+
+// Reads a recording back frame by frame.
+class RecordingReader {
+ public:
+  bool Open(const std::string& path, std::string* error);
+
+  const RecordingMetadata& metadata() const { return metadata_; }
+  // Empty when absent.
+  std::string metadata_value(const std::string& key) const;
+
+  // False at the end of the file, with |error| set when the file is cut
+  // short or corrupt.
+  bool Next(RecordedFrame* frame, std::string* error);
+  void Rewind();
+
+ private:
+  std::ifstream file_;
+  std::streampos first_frame_ = 0;
+  RecordingMetadata metadata_;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_FRAME_RECORDING_H_
@@ -0,0 +1,197 @@
+#include "frame_ring.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace kiosk_vision {
+
+namespace {
+
+// The producer skips the latest slot and any pinned ones, so fewer than
+// three slots would stall as soon as one reader holds a frame.
+const int kMinSlots = 3;
+const int kMaxSlots = 64;
+const int kSlotBits = 8;
+const uint64_t kSlotMask = (1u << kSlotBits) - 1;
+
+// AcquireLatest() retries when the producer publishes a newer frame between
+// reading |latest_| and pinning its slot.
+const int kAcquireAttempts = 4;
+
+}  // namespace
+
+FrameRing::ReadLease::~ReadLease() {
+  Release();
+}
+
+FrameRing::ReadLease::ReadLease(ReadLease&& other)
+    : ring_(other.ring_), info_(other.info_), data_(other.data_) {
+  other.ring_ = nullptr;
+  other.data_ = nullptr;
+}
+
+FrameRing::ReadLease& FrameRing::ReadLease::operator=(ReadLease&& other) {
+  if (this != &other) {
+    Release();
+    ring_ = other.ring_;
+    info_ = other.info_;
+    data_ = other.data_;
+    other.ring_ = nullptr;
+    other.data_ = nullptr;
+  }
+  return *this;
+}
+
+ImageView FrameRing::ReadLease::view() const {
+  ImageView view;
+  view.data = data_;
+  view.width = info_.width;
+  view.height = info_.height;
+  view.stride = info_.stride;
+  view.format = info_.format;
+  return view;
+}
+
+void FrameRing::ReadLease::Release() {
+  if (ring_ != nullptr) {
+    ring_->Unpin(info_.slot);
+    ring_ = nullptr;
+    data_ = nullptr;
+  }
+}
+
+FrameRing::FrameRing(int slot_count) {
+  const int count = std::min(std::max(slot_count, kMinSlots), kMaxSlots);
+  slots_.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    slots_.emplace_back(new Slot());
+    slots_.back()->info.slot = i;
+  }
+}
+
+FrameRing::~FrameRing() = default;
+
+void FrameRing::SetFrameListener(FrameListener listener) {
+  listener_ = std::move(listener);
+}
+
+uint8_t* FrameRing::BeginWrite(int width, int height, int stride,
+                               PixelFormat format) {
+  if (width <= 0 || height <= 0 || stride <= 0) {
+    return nullptr;
+  }
+  const uint64_t latest = latest_.load();
+  const int latest_slot =
+      latest != 0 ? static_cast<int>(latest & kSlotMask) : -1;
+  const uint64_t writing_sequence = next_frame_id_ * 2 + 1;
+
+  const int count = slot_count();
+  for (int i = 1; i <= count; ++i) {
+    const int index = (std::max(latest_slot, 0) + i) % count;
+    if (index == latest_slot) {
+      continue;
+    }
+    Slot* slot = slots_[index].get();
+    const uint64_t previous = slot->sequence.load();
+    slot->sequence.store(writing_sequence);
+    if (slot->readers.load() != 0) {
+      // A reader pinned it first; leave its frame untouched.
+      slot->sequence.store(previous);
+      continue;
+    }
+
+    writing_slot_ = index;
+    const size_t size = static_cast<size_t>(stride) * height;
+    if (slot->pixels.size() < size) {
+      slot->pixels.resize(size);
+    }
+    slot->info.width = width;
+    slot->info.height = height;
+    slot->info.stride = stride;
+    slot->info.format = format;
+    return slot->pixels.data();
+  }
+
+  frames_dropped_++;
+  return nullptr;
+}
+
+void FrameRing::CommitWrite(int64_t timestamp_us) {
+  if (writing_slot_ < 0) {
+    return;
+  }
+  Slot* slot = slots_[writing_slot_].get();
+  const uint64_t frame_id = next_frame_id_++;
+  slot->info.frame_id = frame_id;
+  slot->info.timestamp_us = timestamp_us;
+  slot->sequence.store(frame_id * 2);
+  latest_.store((frame_id << kSlotBits) |
+                static_cast<uint64_t>(writing_slot_));
+  writing_slot_ = -1;
+  frames_written_++;
+
+  if (listener_) {
+    listener_(slot->info);
+  }
+}
+
+void FrameRing::AbortWrite() {
+  if (writing_slot_ < 0) {
+    return;
+  }
+  // The old contents may be partially overwritten, so the slot cannot go
+  // back to its previous frame; mark it as holding nothing.
+  Slot* slot = slots_[writing_slot_].get();
+  slot->info.frame_id = 0;
+  slot->sequence.store(0);
+  writing_slot_ = -1;
+  frames_dropped_++;
+}
+
+bool FrameRing::Acquire(int slot_index, uint64_t frame_id, ReadLease* lease) {
+  if (slot_index < 0 || slot_index >= slot_count() || frame_id == 0) {
+    return false;
+  }
+  Slot* slot = slots_[slot_index].get();
+  slot->readers.fetch_add(1);
+  if (slot->sequence.load() != frame_id * 2) {
+    slot->readers.fetch_sub(1);
+    return false;
+  }
+
+  lease->Release();
+  lease->ring_ = this;
+  lease->info_ = slot->info;
+  lease->data_ = slot->pixels.data();
+  return true;
+}
+
+bool FrameRing::AcquireLatest(ReadLease* lease) {
+  for (int attempt = 0; attempt < kAcquireAttempts; ++attempt) {
+    const uint64_t latest = latest_.load();
+    if (latest == 0) {
+      return false;
+    }
+    if (Acquire(static_cast<int>(latest & kSlotMask), latest >> kSlotBits,
+                lease)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+FrameInfo FrameRing::latest() const {
+  FrameInfo info;
+  const uint64_t latest = latest_.load();
+  if (latest != 0) {
+    info.slot = static_cast<int>(latest & kSlotMask);
+    info.frame_id = latest >> kSlotBits;
+  }
+  return info;
+}
+
+void FrameRing::Unpin(int slot) {
+  slots_[slot]->readers.fetch_sub(1);
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,122 @@
+#ifndef PLUGINS_KIOSK_VISION_FRAME_RING_H_
+#define PLUGINS_KIOSK_VISION_FRAME_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "frame_preprocessor.h"
+
+namespace kiosk_vision {
+
+// Describes one frame published into a FrameRing slot.
+struct FrameInfo {
+  int slot = -1;
+  uint64_t frame_id = 0;  // Monotonic, starts at 1. 0 means "no frame".
+  int64_t timestamp_us = 0;
+  int width = 0;
+  int height = 0;
+  int stride = 0;
+  PixelFormat format = PixelFormat::kRgba;
+};
+
+// Fixed set of reusable frame buffers shared between one capture thread and
+// any number of readers, without locks and without per-frame allocation.
+//
+// Every slot carries a sequence number that is odd while the producer writes
+// into it and 2 * frame_id once published, plus a reader pin count. Readers
+// pin a slot and then confirm the sequence still names the frame they want;
+// the producer marks a slot odd and then checks that nobody has it pinned.
+// Both sides use sequentially consistent operations, so at least one of them
+// always sees the other and backs off. The producer never reuses the most
+// recent slot, so with more slots than concurrent readers it always finds a
+// free buffer; otherwise the frame is dropped and counted.
+//
+// Buffers grow to the largest frame seen and are then reused.
+class FrameRing {
+ public:
+  // Pins one published frame for reading. Move-only; unpins on destruction.
+  class ReadLease {
+   public:
+    ReadLease() = default;
+    ~ReadLease();
+    ReadLease(ReadLease&& other);
+    ReadLease& operator=(ReadLease&& other);
+    ReadLease(const ReadLease&) = delete;
+    ReadLease& operator=(const ReadLease&) = delete;
+
+    bool valid() const { return ring_ != nullptr; }
+    const FrameInfo& info() const { return info_; }
+    const uint8_t* data() const { return data_; }
+    ImageView view() const;
+    void Release();
+
+   private:
+    friend class FrameRing;
+
+    FrameRing* ring_ = nullptr;
+    FrameInfo info_;
+    const uint8_t* data_ = nullptr;
+  };
+
+  // Invoked on the producer thread after each published frame.
+  using FrameListener = std::function<void(const FrameInfo& info)>;
+
+  explicit FrameRing(int slot_count);
+  ~FrameRing();
+
+  // Disallow copy and assign.
+  FrameRing(const FrameRing&) = delete;
+  FrameRing& operator=(const FrameRing&) = delete;
+
+  // Must be set before any producer starts.
+  void SetFrameListener(FrameListener listener);
+
+  // Producer side; only one thread may write at a time. Returns a buffer of
+  // at least |stride| * |height| bytes, or nullptr when every slot is pinned.
+  // Follow with CommitWrite() or AbortWrite().
+  uint8_t* BeginWrite(int width, int height, int stride, PixelFormat format);
+  void CommitWrite(int64_t timestamp_us);
+  void AbortWrite();
+
+  // Reader side, any thread. Acquire() fails once the producer has recycled
+  // the slot for a newer frame.
+  bool Acquire(int slot, uint64_t frame_id, ReadLease* lease);
+  bool AcquireLatest(ReadLease* lease);
+
+  // Latest published frame without pinning it; frame_id is 0 when empty.
+  FrameInfo latest() const;
+
+  int slot_count() const { return static_cast<int>(slots_.size()); }
+  uint64_t frames_written() const { return frames_written_.load(); }
+  uint64_t frames_dropped() const { return frames_dropped_.load(); }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> sequence{0};
+    std::atomic<int> readers{0};
+    FrameInfo info;
+    std::vector<uint8_t> pixels;
+  };
+
+  void Unpin(int slot);
+
+  std::vector<std::unique_ptr<Slot>> slots_;
+  FrameListener listener_;
+
+  // Packed (frame_id << 8) | slot of the most recent published frame.
+  std::atomic<uint64_t> latest_{0};
+  std::atomic<uint64_t> frames_written_{0};
+  std::atomic<uint64_t> frames_dropped_{0};
+
+  // Producer-only state.
+  uint64_t next_frame_id_ = 1;
+  int writing_slot_ = -1;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_FRAME_RING_H_
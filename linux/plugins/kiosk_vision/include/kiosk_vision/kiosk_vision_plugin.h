@@ -0,0 +1,49 @@
+#ifndef FLUTTER_PLUGIN_KIOSK_VISION_PLUGIN_H_
+#define FLUTTER_PLUGIN_KIOSK_VISION_PLUGIN_H_
+
+#include <flutter_linux/flutter_linux.h>
+#include <stddef.h>
+#include <stdint.h>
+
+G_BEGIN_DECLS
+
+#ifdef FLUTTER_PLUGIN_IMPL
+#define FLUTTER_PLUGIN_EXPORT __attribute__((visibility("default")))
+#else
+#define FLUTTER_PLUGIN_EXPORT
+#endif
+
+typedef struct _KioskVisionPlugin KioskVisionPlugin;
+typedef struct {
+  GObjectClass parent_class;
+} KioskVisionPluginClass;
+
+FLUTTER_PLUGIN_EXPORT GType kiosk_vision_plugin_get_type();
+
+// Registers the native person detection pipeline on the
+// "com.ki.king_kiosk/vision" method channel.
+FLUTTER_PLUGIN_EXPORT void kiosk_vision_plugin_register_with_registrar(
+    FlPluginRegistrar* registrar);
+
+// Feeds the detector's frame ring from a flutter_webrtc video track.
+// |track| is the libwebrtc::RTCVideoTrack* behind the local camera stream;
+// nullptr detaches the current one. Returns FALSE when the plugin is not
+// registered or was built without the libwebrtc headers.
+FLUTTER_PLUGIN_EXPORT gboolean kiosk_vision_attach_video_track(
+    gpointer track);
+
+// Converts one YUV frame to packed pixels, downscaling by point sampling
+// when the sizes differ. Exported for dart:ffi so Dart-side frame sources
+// share the native kernels; safe to call from any thread.
+//
+// |format|: 0 YUYV, 1 NV12, 2 I420, tightly packed apart from the luma row
+// pitch |stride| (0 for none). |dst_format|: 0 RGBA, 1 BGRA, 2 RGB.
+// Returns FALSE if |size| is too small or an argument is out of range.
+FLUTTER_PLUGIN_EXPORT gboolean kiosk_vision_convert_yuv(
+    const uint8_t* data, size_t size, int32_t format, int32_t width,
+    int32_t height, int32_t stride, uint8_t* dst, int32_t dst_stride,
+    int32_t dst_width, int32_t dst_height, int32_t dst_format);
+
+G_END_DECLS
+
+#endif  // FLUTTER_PLUGIN_KIOSK_VISION_PLUGIN_H_
@@ -0,0 +1,100 @@
+#include "inference_threads.h"
+
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace kiosk_vision {
+
+int OnlineCpuCount() {
+  const long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? static_cast<int>(count) : 1;
+}
+
+int DefaultInferenceThreads() {
+  const int cpus = OnlineCpuCount();
+  return cpus > 2 ? cpus - 1 : cpus;
+}
+
+std::vector<int> HighestCpus(int count) {
+  std::vector<int> cpus;
+  const int online = OnlineCpuCount();
+  for (int cpu = online - 1; cpu >= 0 && static_cast<int>(cpus.size()) < count;
+       --cpu) {
+    cpus.push_back(cpu);
+  }
+  std::sort(cpus.begin(), cpus.end());
+  return cpus;
+}
+
+bool ApplyToCurrentThread(const InferenceThreadConfig& config,
+                          std::string* error) {
+  std::string failures;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (config.cpus.empty()) {
+    for (int cpu = 0; cpu < OnlineCpuCount() && cpu < CPU_SETSIZE; ++cpu) {
+      CPU_SET(cpu, &set);
+    }
+  } else {
+    for (int cpu : config.cpus) {
+      if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &set);
+      }
+    }
+  }
+  // pid 0 is the calling thread.
+  if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+    failures = std::string("sched_setaffinity: ") + strerror(errno);
+  }
+
+  // With a thread id, PRIO_PROCESS applies to that thread only on Linux.
+  const pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+  errno = 0;
+  const int current = getpriority(PRIO_PROCESS, tid);
+  if (errno == 0 && current != config.nice &&
+      setpriority(PRIO_PROCESS, tid, config.nice) != 0) {
+    if (!failures.empty()) {
+      failures += "; ";
+    }
+    failures += std::string("setpriority: ") + strerror(errno);
+  }
+
+  if (!failures.empty()) {
+    *error = failures;
+    return false;
+  }
+  return true;
+}
+
+std::string CpuListToString(const std::vector<int>& cpus) {
+  if (cpus.empty()) {
+    return "all";
+  }
+  std::vector<int> sorted = cpus;
+  std::sort(sorted.begin(), sorted.end());
+  std::string text;
+  size_t i = 0;
+  while (i < sorted.size()) {
+    size_t end = i;
+    while (end + 1 < sorted.size() && sorted[end + 1] == sorted[end] + 1) {
+      ++end;
+    }
+    if (!text.empty()) {
+      text += ",";
+    }
+    text += std::to_string(sorted[i]);
+    if (end > i) {
+      text += "-" + std::to_string(sorted[end]);
+    }
+    i = end + 1;
+  }
+  return text;
+}
+
+}  // namespace kiosk_vision
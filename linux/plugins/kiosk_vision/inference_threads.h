@@ -0,0 +1,47 @@
+#ifndef PLUGINS_KIOSK_VISION_INFERENCE_THREADS_H_
+#define PLUGINS_KIOSK_VISION_INFERENCE_THREADS_H_
+
+#include <string>
+#include <vector>
+
+namespace kiosk_vision {
+
+// Where and how hard the interpreter runs. The TensorFlow Lite C library
+// applies its default XNNPACK delegate to float models and sizes the
+// delegate's thread pool from |num_threads|. The pool threads are spawned
+// by the engine worker when the interpreter is created and inherit its CPU
+// affinity and nice value, so applying both to the worker first pins the
+// whole inference.
+struct InferenceThreadConfig {
+  // 0 picks DefaultInferenceThreads().
+  int num_threads = 0;
+  // CPUs the worker and the pool may run on; empty allows all of them.
+  std::vector<int> cpus;
+  // Nice value of the worker and the pool. A positive value lets the
+  // Flutter UI and raster threads win when they compete for a core.
+  // Lowering it again later needs CAP_SYS_NICE.
+  int nice = 0;
+};
+
+int OnlineCpuCount();
+
+// One thread per core, minus one core left to the Flutter UI and raster
+// threads on machines with more than two.
+int DefaultInferenceThreads();
+
+// The |count| highest numbered online CPUs. On big.LITTLE boards those are
+// the big cores; elsewhere they are the ones the kernel hands out last.
+std::vector<int> HighestCpus(int count);
+
+// Applies the affinity and nice value of |config| to the calling thread.
+// Returns false with |error| set when either is refused; the other one is
+// still applied.
+bool ApplyToCurrentThread(const InferenceThreadConfig& config,
+                          std::string* error);
+
+// "2-3", "0,2" or "all".
+std::string CpuListToString(const std::vector<int>& cpus);
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_INFERENCE_THREADS_H_
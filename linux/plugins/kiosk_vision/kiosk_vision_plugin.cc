@@ -0,0 +1,1811 @@
+#include "include/kiosk_vision/kiosk_vision_plugin.h"
+
+#include <flutter_linux/flutter_linux.h>
+#include <gtk/gtk.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "camera_hub.h"
+#include "color_convert.h"
+#include "detection_engine.h"
+#include "frame_recording.h"
+#include "frame_ring.h"
+#include "preview_texture.h"
+#include "v4l2_capture.h"
+
+#ifdef KIOSK_VISION_HAVE_LIBAV
+#include "decode_pool.h"
+#include "stream_capture.h"
+#endif
+
+#ifdef KIOSK_VISION_HAVE_LIBWEBRTC
+#include "webrtc_frame_sink.h"
+#endif
+
+#define KIOSK_VISION_PLUGIN(obj)                                     \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), kiosk_vision_plugin_get_type(), \
+                              KioskVisionPlugin))
+
+namespace {
+
+const char kChannelName[] = "com.ki.king_kiosk/vision";
+const char kFrameChannelName[] = "com.ki.king_kiosk/vision/frames";
+const char kErrorCode[] = "VISION_ERROR";
+
+// Values per box in the Float32List returned to Dart:
+// x1, y1, x2, y2, score, class id.
+const int kBoxStride = 6;
+
+// Enough slots for the producer, the detector and one extra reader without
+// ever dropping a frame.
+const int kFrameRingSlots = 4;
+
+// A camera preview ring only has the producer and the texture reading it.
+const int kCameraPreviewSlots = 3;
+
+// A response produced on a worker thread and delivered on the GTK main
+// thread, where the Flutter engine expects method call replies.
+struct PendingResponse {
+  FlMethodCall* method_call;
+  std::function<FlMethodResponse*()> build;
+};
+
+gboolean deliver_pending_response(gpointer user_data) {
+  PendingResponse* pending = static_cast<PendingResponse*>(user_data);
+  g_autoptr(FlMethodResponse) response = pending->build();
+  g_autoptr(GError) error = nullptr;
+  if (!fl_method_call_respond(pending->method_call, response, &error)) {
+    g_warning("Failed to send vision response: %s", error->message);
+  }
+  g_object_unref(pending->method_call);
+  delete pending;
+  return G_SOURCE_REMOVE;
+}
+
+void respond_on_main_thread(FlMethodCall* method_call,
+                            std::function<FlMethodResponse*()> build) {
+  PendingResponse* pending = new PendingResponse{
+      FL_METHOD_CALL(g_object_ref(method_call)), std::move(build)};
+  g_idle_add(deliver_pending_response, pending);
+}
+
+FlValue* lookup(FlValue* args, const char* key, FlValueType type) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return nullptr;
+  }
+  FlValue* value = fl_value_lookup_string(args, key);
+  return value != nullptr && fl_value_get_type(value) == type ? value
+                                                              : nullptr;
+}
+
+int64_t lookup_int(FlValue* args, const char* key, int64_t fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_INT);
+  return value != nullptr ? fl_value_get_int(value) : fallback;
+}
+
+double lookup_double(FlValue* args, const char* key, double fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_FLOAT);
+  return value != nullptr ? fl_value_get_float(value) : fallback;
+}
+
+bool lookup_bool(FlValue* args, const char* key, bool fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_BOOL);
+  return value != nullptr ? fl_value_get_bool(value) : fallback;
+}
+
+std::string lookup_string(FlValue* args, const char* key,
+                          const char* fallback) {
+  FlValue* value = lookup(args, key, FL_VALUE_TYPE_STRING);
+  return value != nullptr ? fl_value_get_string(value) : fallback;
+}
+
+bool looks_encoded(const std::vector<uint8_t>& bytes) {
+  static const uint8_t kPng[] = {0x89, 0x50, 0x4E, 0x47};
+  static const uint8_t kJpeg[] = {0xFF, 0xD8, 0xFF};
+  return (bytes.size() > sizeof(kPng) &&
+          memcmp(bytes.data(), kPng, sizeof(kPng)) == 0) ||
+         (bytes.size() > sizeof(kJpeg) &&
+          memcmp(bytes.data(), kJpeg, sizeof(kJpeg)) == 0);
+}
+
+// Decodes PNG/JPEG bytes with gdk-pixbuf into |frame|. Runs on the engine
+// worker or the capture thread.
+bool decode_image_bytes(const uint8_t* data, size_t size,
+                        kiosk_vision::Frame* frame, std::string* error) {
+  g_autoptr(GdkPixbufLoader) loader = gdk_pixbuf_loader_new();
+  g_autoptr(GError) gerror = nullptr;
+  if (!gdk_pixbuf_loader_write(loader, data, size, &gerror) ||
+      !gdk_pixbuf_loader_close(loader, &gerror)) {
+    *error = gerror != nullptr ? gerror->message : "Failed to decode frame";
+    return false;
+  }
+
+  GdkPixbuf* pixbuf = gdk_pixbuf_loader_get_pixbuf(loader);
+  const int width = gdk_pixbuf_get_width(pixbuf);
+  const int height = gdk_pixbuf_get_height(pixbuf);
+  const int stride = gdk_pixbuf_get_rowstride(pixbuf);
+  const bool has_alpha = gdk_pixbuf_get_has_alpha(pixbuf);
+  const guint8* pixels = gdk_pixbuf_read_pixels(pixbuf);
+
+  frame->pixels.assign(pixels, pixels + static_cast<size_t>(stride) * height);
+  frame->width = width;
+  frame->height = height;
+  frame->stride = stride;
+  frame->format = has_alpha ? kiosk_vision::PixelFormat::kRgba
+                            : kiosk_vision::PixelFormat::kRgb;
+  frame->encoded = false;
+  return true;
+}
+
+bool decode_with_pixbuf(kiosk_vision::Frame* frame, std::string* error) {
+  return decode_image_bytes(frame->pixels.data(), frame->pixels.size(), frame,
+                            error);
+}
+
+kiosk_vision::CaptureFormat capture_format_from_string(
+    const std::string& name) {
+  if (name == "yuyv") {
+    return kiosk_vision::CaptureFormat::kYuyv;
+  } else if (name == "nv12") {
+    return kiosk_vision::CaptureFormat::kNv12;
+  } else if (name == "mjpeg") {
+    return kiosk_vision::CaptureFormat::kMjpeg;
+  }
+  return kiosk_vision::CaptureFormat::kAuto;
+}
+
+FlValue* capture_stats_to_value(const kiosk_vision::CaptureStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "running", fl_value_new_bool(stats.running));
+  fl_value_set_string_take(map, "device",
+                           fl_value_new_string(stats.device.c_str()));
+  fl_value_set_string_take(map, "format",
+                           fl_value_new_string(stats.format.c_str()));
+  fl_value_set_string_take(map, "width", fl_value_new_int(stats.width));
+  fl_value_set_string_take(map, "height", fl_value_new_int(stats.height));
+  fl_value_set_string_take(map, "fps", fl_value_new_float(stats.fps));
+  fl_value_set_string_take(map, "publishWidth",
+                           fl_value_new_int(stats.publish_width));
+  fl_value_set_string_take(map, "publishHeight",
+                           fl_value_new_int(stats.publish_height));
+  fl_value_set_string_take(map, "convertKernel",
+                           fl_value_new_string(stats.convert_kernel.c_str()));
+  fl_value_set_string_take(map, "framesCaptured",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_captured)));
+  fl_value_set_string_take(map, "framesPublished",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_published)));
+  fl_value_set_string_take(map, "framesFailed",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_failed)));
+  return map;
+}
+
+FlValue* cameras_to_value(const std::vector<kiosk_vision::CameraDevice>& list) {
+  FlValue* cameras = fl_value_new_list();
+  for (const kiosk_vision::CameraDevice& camera : list) {
+    FlValue* map = fl_value_new_map();
+    fl_value_set_string_take(map, "path",
+                             fl_value_new_string(camera.path.c_str()));
+    fl_value_set_string_take(map, "name",
+                             fl_value_new_string(camera.name.c_str()));
+    fl_value_set_string_take(map, "busInfo",
+                             fl_value_new_string(camera.bus_info.c_str()));
+    fl_value_append_take(cameras, map);
+  }
+  return cameras;
+}
+
+// Ints of a Dart List<int>, which the standard codec sends as a plain list.
+std::vector<int> lookup_int_list(FlValue* args, const char* key) {
+  std::vector<int> values;
+  FlValue* list = lookup(args, key, FL_VALUE_TYPE_LIST);
+  if (list == nullptr) {
+    return values;
+  }
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* value = fl_value_get_list_value(list, i);
+    if (fl_value_get_type(value) == FL_VALUE_TYPE_INT) {
+      values.push_back(static_cast<int>(fl_value_get_int(value)));
+    }
+  }
+  return values;
+}
+
+std::vector<std::string> lookup_string_list(FlValue* args, const char* key) {
+  std::vector<std::string> values;
+  FlValue* list = lookup(args, key, FL_VALUE_TYPE_LIST);
+  if (list == nullptr) {
+    return values;
+  }
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* value = fl_value_get_list_value(list, i);
+    values.push_back(fl_value_get_type(value) == FL_VALUE_TYPE_STRING
+                         ? fl_value_get_string(value)
+                         : "");
+  }
+  return values;
+}
+
+FlValue* cpus_to_value(const std::vector<int>& cpus) {
+  FlValue* list = fl_value_new_list();
+  for (int cpu : cpus) {
+    fl_value_append_take(list, fl_value_new_int(cpu));
+  }
+  return list;
+}
+
+FlValue* model_info_to_value(const kiosk_vision::ModelInfo& info) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "inputWidth",
+                           fl_value_new_int(info.input_width));
+  fl_value_set_string_take(map, "inputHeight",
+                           fl_value_new_int(info.input_height));
+  fl_value_set_string_take(map, "channels", fl_value_new_int(info.channels));
+  fl_value_set_string_take(map, "quantized", fl_value_new_bool(info.quantized));
+  fl_value_set_string_take(map, "modelLoadTime",
+                           fl_value_new_float(info.load_ms));
+  fl_value_set_string_take(map, "numThreads",
+                           fl_value_new_int(info.num_threads));
+  fl_value_set_string_take(map, "cpus", cpus_to_value(info.cpus));
+  fl_value_set_string_take(map, "nice", fl_value_new_int(info.nice));
+  fl_value_set_string_take(map, "warmupFirstMs",
+                           fl_value_new_float(info.warmup_first_ms));
+  fl_value_set_string_take(map, "warmupMs",
+                           fl_value_new_float(info.warmup_ms));
+  if (!info.thread_warning.empty()) {
+    fl_value_set_string_take(
+        map, "threadWarning",
+        fl_value_new_string(info.thread_warning.c_str()));
+  }
+  return map;
+}
+
+FlValue* thread_benchmark_to_value(
+    const std::vector<kiosk_vision::ThreadBenchmark>& results,
+    const kiosk_vision::InferenceThreadConfig& chosen) {
+  FlValue* map = fl_value_new_map();
+  FlValue* list = fl_value_new_list();
+  for (const kiosk_vision::ThreadBenchmark& result : results) {
+    FlValue* entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "threads",
+                             fl_value_new_int(result.threads));
+    fl_value_set_string_take(entry, "cpus", cpus_to_value(result.cpus));
+    fl_value_set_string_take(entry, "firstMs",
+                             fl_value_new_float(result.first_ms));
+    fl_value_set_string_take(entry, "meanMs",
+                             fl_value_new_float(result.mean_ms));
+    fl_value_set_string_take(entry, "p50Ms",
+                             fl_value_new_float(result.p50_ms));
+    fl_value_set_string_take(entry, "p95Ms",
+                             fl_value_new_float(result.p95_ms));
+    fl_value_append_take(list, entry);
+  }
+  fl_value_set_string_take(map, "results", list);
+  fl_value_set_string_take(map, "numThreads",
+                           fl_value_new_int(chosen.num_threads));
+  fl_value_set_string_take(map, "cpus", cpus_to_value(chosen.cpus));
+  fl_value_set_string_take(map, "nice", fl_value_new_int(chosen.nice));
+  return map;
+}
+
+FlValue* boxes_to_value(const kiosk_vision::DetectionResult& result) {
+  std::vector<float> boxes;
+  boxes.reserve(result.detections.size() * kBoxStride);
+  for (const kiosk_vision::Detection& detection : result.detections) {
+    boxes.push_back(detection.x1);
+    boxes.push_back(detection.y1);
+    boxes.push_back(detection.x2);
+    boxes.push_back(detection.y2);
+    boxes.push_back(detection.score);
+    boxes.push_back(static_cast<float>(detection.class_id));
+  }
+  return fl_value_new_float32_list(boxes.data(), boxes.size());
+}
+
+// Wire format of one confirmed track, read with ByteData in
+// native_detection_engine.dart. Host byte order.
+struct TrackRecord {
+  uint32_t id;
+  int32_t class_id;
+  float x1;
+  float y1;
+  float x2;
+  float y2;
+  float score;
+  uint16_t hits;
+  uint16_t misses;
+};
+static_assert(sizeof(TrackRecord) == 32, "TrackRecord layout is shared");
+
+FlValue* tracks_to_value(const std::vector<kiosk_vision::Track>& tracks) {
+  std::vector<TrackRecord> records(tracks.size());
+  for (size_t i = 0; i < tracks.size(); ++i) {
+    const kiosk_vision::Track& track = tracks[i];
+    TrackRecord& record = records[i];
+    record.id = track.id;
+    record.class_id = track.class_id;
+    record.x1 = track.x1;
+    record.y1 = track.y1;
+    record.x2 = track.x2;
+    record.y2 = track.y2;
+    record.score = track.score;
+    record.hits = static_cast<uint16_t>(std::min(track.hits, 0xFFFF));
+    record.misses = static_cast<uint16_t>(std::min(track.misses, 0xFFFF));
+  }
+  return fl_value_new_uint8_list(
+      reinterpret_cast<const uint8_t*>(records.data()),
+      records.size() * sizeof(TrackRecord));
+}
+
+FlValue* detection_result_to_value(
+    const kiosk_vision::DetectionResult& result) {
+  FlValue* map = fl_value_new_map();
+  // With tracking on, Dart only gets the confirmed tracks.
+  if (result.tracking) {
+    fl_value_set_string_take(map, "tracks", tracks_to_value(result.tracks));
+  } else {
+    fl_value_set_string_take(map, "boxes", boxes_to_value(result));
+  }
+
+  fl_value_set_string_take(map, "rawCount",
+                           fl_value_new_int(result.raw_count));
+  fl_value_set_string_take(map, "frameWidth",
+                           fl_value_new_int(result.frame_width));
+  fl_value_set_string_take(map, "frameHeight",
+                           fl_value_new_int(result.frame_height));
+  fl_value_set_string_take(map, "frameId",
+                           fl_value_new_int(static_cast<int64_t>(
+                               result.frame_id)));
+  fl_value_set_string_take(map, "timestampUs",
+                           fl_value_new_int(result.timestamp_us));
+  fl_value_set_string_take(map, "decodeTime",
+                           fl_value_new_float(result.timings.decode_ms));
+  fl_value_set_string_take(map, "preprocessingTime",
+                           fl_value_new_float(result.timings.preprocess_ms));
+  fl_value_set_string_take(map, "inferenceTime",
+                           fl_value_new_float(result.timings.inference_ms));
+  fl_value_set_string_take(map, "resultsParsingTime",
+                           fl_value_new_float(result.timings.parse_ms));
+  fl_value_set_string_take(map, "trackingTime",
+                           fl_value_new_float(result.timings.track_ms));
+  fl_value_set_string_take(map, "totalProcessingTime",
+                           fl_value_new_float(result.timings.total_ms));
+  // The interpreter stays warm between frames, so no per-frame load cost.
+  fl_value_set_string_take(map, "modelLoadTime", fl_value_new_float(0.0));
+  if (result.crops > 1) {
+    fl_value_set_string_take(map, "crops", fl_value_new_int(result.crops));
+    fl_value_set_string_take(map, "batched",
+                             fl_value_new_bool(result.batched));
+  }
+  if (result.motion_checked) {
+    fl_value_set_string_take(map, "skipped",
+                             fl_value_new_bool(result.skipped));
+    fl_value_set_string_take(map, "keepAlive",
+                             fl_value_new_bool(result.keepalive));
+    fl_value_set_string_take(map, "motionScore",
+                             fl_value_new_float(result.motion_score));
+    fl_value_set_string_take(map, "motionTime",
+                             fl_value_new_float(result.timings.motion_ms));
+  }
+  return map;
+}
+
+kiosk_vision::TilingMode tiling_mode_from_string(const std::string& name) {
+  if (name == "grid") {
+    return kiosk_vision::TilingMode::kGrid;
+  } else if (name == "roi") {
+    return kiosk_vision::TilingMode::kRoi;
+  } else if (name == "gridAndRoi") {
+    return kiosk_vision::TilingMode::kGridAndRoi;
+  }
+  return kiosk_vision::TilingMode::kOff;
+}
+
+kiosk_vision::TilingConfig tiling_config_from_args(FlValue* args) {
+  kiosk_vision::TilingConfig config;
+  config.mode = tiling_mode_from_string(lookup_string(args, "mode", "off"));
+  config.include_full_frame =
+      lookup_bool(args, "includeFullFrame", config.include_full_frame);
+  config.grid_size =
+      static_cast<int>(lookup_int(args, "gridSize", config.grid_size));
+  config.overlap =
+      static_cast<float>(lookup_double(args, "overlap", config.overlap));
+  config.max_tiles =
+      static_cast<int>(lookup_int(args, "maxTiles", config.max_tiles));
+  config.roi_margin = static_cast<float>(
+      lookup_double(args, "roiMargin", config.roi_margin));
+  config.merge_containment = static_cast<float>(
+      lookup_double(args, "mergeContainment", config.merge_containment));
+  config.batch = lookup_bool(args, "batch", config.batch);
+  return config;
+}
+
+// "labels" is one Float32List per frame in the box layout sent to Dart.
+std::vector<std::vector<kiosk_vision::Detection>> labels_from_args(
+    FlValue* args) {
+  std::vector<std::vector<kiosk_vision::Detection>> labels;
+  FlValue* list = lookup(args, "labels", FL_VALUE_TYPE_LIST);
+  if (list == nullptr) {
+    return labels;
+  }
+  for (size_t i = 0; i < fl_value_get_length(list); ++i) {
+    FlValue* boxes = fl_value_get_list_value(list, i);
+    std::vector<kiosk_vision::Detection> frame;
+    if (fl_value_get_type(boxes) == FL_VALUE_TYPE_FLOAT32_LIST) {
+      const float* values = fl_value_get_float32_list(boxes);
+      const size_t count = fl_value_get_length(boxes) / kBoxStride;
+      for (size_t b = 0; b < count; ++b) {
+        const float* box = values + b * kBoxStride;
+        kiosk_vision::Detection detection;
+        detection.x1 = box[0];
+        detection.y1 = box[1];
+        detection.x2 = box[2];
+        detection.y2 = box[3];
+        detection.score = box[4];
+        detection.class_id = static_cast<int>(box[5]);
+        frame.push_back(detection);
+      }
+    }
+    labels.push_back(std::move(frame));
+  }
+  return labels;
+}
+
+FlValue* tiling_benchmark_to_value(
+    const std::vector<kiosk_vision::TilingBenchmark>& results) {
+  FlValue* list = fl_value_new_list();
+  for (const kiosk_vision::TilingBenchmark& result : results) {
+    FlValue* entry = fl_value_new_map();
+    fl_value_set_string_take(entry, "name",
+                             fl_value_new_string(result.name.c_str()));
+    fl_value_set_string_take(entry, "frames", fl_value_new_int(result.frames));
+    fl_value_set_string_take(entry, "meanMs",
+                             fl_value_new_float(result.mean_ms));
+    fl_value_set_string_take(entry, "p95Ms", fl_value_new_float(result.p95_ms));
+    fl_value_set_string_take(entry, "cropsPerFrame",
+                             fl_value_new_float(result.crops_per_frame));
+    fl_value_set_string_take(entry, "batched",
+                             fl_value_new_bool(result.batched));
+    fl_value_set_string_take(entry, "detections",
+                             fl_value_new_int(result.detections));
+    fl_value_set_string_take(entry, "matched",
+                             fl_value_new_int(result.matched));
+    fl_value_set_string_take(entry, "reference",
+                             fl_value_new_int(result.reference));
+    fl_value_set_string_take(entry, "recall",
+                             fl_value_new_float(result.recall));
+    fl_value_set_string_take(entry, "precision",
+                             fl_value_new_float(result.precision));
+    fl_value_append_take(list, entry);
+  }
+  return list;
+}
+
+FlValue* recording_stats_to_value(const kiosk_vision::RecordingStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "recording",
+                           fl_value_new_bool(stats.recording));
+  fl_value_set_string_take(map, "path",
+                           fl_value_new_string(stats.path.c_str()));
+  fl_value_set_string_take(map, "framesWritten",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_written)));
+  fl_value_set_string_take(map, "framesDropped",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_dropped)));
+  fl_value_set_string_take(map, "bytesWritten",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.bytes_written)));
+  fl_value_set_string_take(map, "durationUs",
+                           fl_value_new_int(stats.duration_us));
+  if (!stats.error.empty()) {
+    fl_value_set_string_take(map, "error",
+                             fl_value_new_string(stats.error.c_str()));
+  }
+  return map;
+}
+
+#ifdef KIOSK_VISION_HAVE_LIBAV
+FlValue* stream_stats_to_value(const kiosk_vision::StreamStats& stats) {
+  FlValue* map = capture_stats_to_value(stats.capture);
+  fl_value_set_string_take(map, "source", fl_value_new_string("stream"));
+  fl_value_set_string_take(map, "connected",
+                           fl_value_new_bool(stats.connected));
+  fl_value_set_string_take(map, "keyframesOnly",
+                           fl_value_new_bool(stats.keyframes_only));
+  fl_value_set_string_take(map, "reconnects",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.reconnects)));
+  fl_value_set_string_take(map, "packetsSkipped",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.packets_skipped)));
+  fl_value_set_string_take(map, "packetsDropped",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.packets_dropped)));
+  fl_value_set_string_take(map, "framesDecoded",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_decoded)));
+  fl_value_set_string_take(map, "lastError",
+                           fl_value_new_string(stats.last_error.c_str()));
+  return map;
+}
+#endif
+
+// Capture and publish settings shared by startCapture and acquireCamera.
+kiosk_vision::CaptureConfig capture_config_from_args(FlValue* args) {
+  kiosk_vision::CaptureConfig config;
+  config.device = lookup_string(args, "device", config.device.c_str());
+  config.width = static_cast<int>(lookup_int(args, "width", config.width));
+  config.height = static_cast<int>(lookup_int(args, "height", config.height));
+  config.fps = static_cast<int>(lookup_int(args, "fps", config.fps));
+  config.publish_fps =
+      lookup_double(args, "publishFps", config.publish_fps);
+  config.format = capture_format_from_string(
+      lookup_string(args, "format", "auto"));
+  config.publish_width =
+      static_cast<int>(lookup_int(args, "publishWidth", 0));
+  config.publish_height =
+      static_cast<int>(lookup_int(args, "publishHeight", 0));
+  return config;
+}
+
+FlValue* camera_sessions_to_value(
+    const std::vector<kiosk_vision::CameraSessionInfo>& sessions) {
+  FlValue* list = fl_value_new_list();
+  for (const kiosk_vision::CameraSessionInfo& session : sessions) {
+    FlValue* map = capture_stats_to_value(session.capture);
+    FlValue* consumers = fl_value_new_list();
+    for (const kiosk_vision::CameraConsumerInfo& consumer :
+         session.consumers) {
+      FlValue* item = fl_value_new_map();
+      fl_value_set_string_take(item, "consumerId",
+                               fl_value_new_int(consumer.id));
+      fl_value_set_string_take(item, "publishFps",
+                               fl_value_new_float(consumer.publish_fps));
+      fl_value_set_string_take(item, "publishWidth",
+                               fl_value_new_int(consumer.publish_width));
+      fl_value_set_string_take(item, "publishHeight",
+                               fl_value_new_int(consumer.publish_height));
+      fl_value_set_string_take(item, "framesPublished",
+                               fl_value_new_int(static_cast<int64_t>(
+                                   consumer.frames_published)));
+      fl_value_append_take(consumers, item);
+    }
+    fl_value_set_string_take(map, "consumers", consumers);
+    fl_value_append_take(list, map);
+  }
+  return list;
+}
+
+// A texture fed by its own camera hub consumer, so a preview runs at its
+// own rate and size and never competes with the detector for ring slots.
+struct CameraPreview {
+  int consumer_id = 0;
+  std::unique_ptr<kiosk_vision::FrameRing> ring;
+  KioskPreviewTexture* texture = nullptr;
+  // Set while a frame-available notification is queued on the main loop.
+  std::atomic<bool> event_pending{false};
+};
+
+FlValue* motion_stats_to_value(const kiosk_vision::MotionGateConfig& config,
+                               const kiosk_vision::MotionStats& stats) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "enabled", fl_value_new_bool(config.enabled));
+  fl_value_set_string_take(map, "motionThreshold",
+                           fl_value_new_float(config.motion_threshold));
+  fl_value_set_string_take(map, "keepAliveMs",
+                           fl_value_new_int(config.keepalive_us / 1000));
+  fl_value_set_string_take(map, "lastScore",
+                           fl_value_new_float(stats.last_score));
+  fl_value_set_string_take(map, "framesEvaluated",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_evaluated)));
+  fl_value_set_string_take(map, "framesSkipped",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_skipped)));
+  fl_value_set_string_take(map, "framesTriggered",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_triggered)));
+  fl_value_set_string_take(map, "keepAliveRuns",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.keepalive_runs)));
+  return map;
+}
+
+}  // namespace
+
+struct _KioskVisionPlugin {
+  GObject parent_instance;
+
+  kiosk_vision::DetectionEngine* engine;
+
+  // Frames published by native producers. Dart only ever sees slot indices
+  // and frame ids through |frame_channel|.
+  kiosk_vision::FrameRing* frame_ring;
+  FlEventChannel* frame_channel;
+  gboolean frame_listening;
+  // Set while a frame notification is queued on the main loop, so a fast
+  // producer collapses into one event per main loop iteration.
+  std::atomic<bool>* frame_event_pending;
+  // Copies |frame_ring| frames to disk for replay, when started.
+  kiosk_vision::FrameRecorder* recorder;
+
+  // Cameras shared between the detector and camera previews, captured
+  // without WebRTC.
+  kiosk_vision::CameraHub* camera_hub;
+  // Hub consumer feeding |frame_ring| for the detector, or 0.
+  int capture_consumer;
+#ifdef KIOSK_VISION_HAVE_LIBAV
+  // Network camera or file feeding |frame_ring| instead of a local camera.
+  // Both are created on first use.
+  kiosk_vision::DecodePool* decode_pool;
+  kiosk_vision::StreamCapture* stream;
+#endif
+  // Only changed on the main thread; each preview's ring listener reaches
+  // its preview directly.
+  std::vector<CameraPreview*>* camera_previews;
+
+  // Textures showing ring frames in Flutter. The list only changes on the
+  // main thread, under |preview_mutex|, which the producer holds while it
+  // renders into them.
+  FlTextureRegistrar* texture_registrar;
+  std::vector<KioskPreviewTexture*>* previews;
+  std::mutex* preview_mutex;
+  // Set while a frame-available notification is queued on the main loop.
+  std::atomic<bool>* preview_event_pending;
+
+#ifdef KIOSK_VISION_HAVE_LIBWEBRTC
+  kiosk_vision::WebRtcFrameSink* webrtc_sink;
+#endif
+};
+
+G_DEFINE_TYPE(KioskVisionPlugin, kiosk_vision_plugin, g_object_get_type())
+
+// Plugin instance for the exported C entry points.
+static KioskVisionPlugin* active_plugin = nullptr;
+
+static FlValue* frame_info_to_value(const kiosk_vision::FrameInfo& info) {
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(map, "slot", fl_value_new_int(info.slot));
+  fl_value_set_string_take(map, "frameId",
+                           fl_value_new_int(static_cast<int64_t>(
+                               info.frame_id)));
+  fl_value_set_string_take(map, "timestampUs",
+                           fl_value_new_int(info.timestamp_us));
+  fl_value_set_string_take(map, "width", fl_value_new_int(info.width));
+  fl_value_set_string_take(map, "height", fl_value_new_int(info.height));
+  return map;
+}
+
+static gboolean deliver_frame_event(gpointer user_data) {
+  KioskVisionPlugin* self = KIOSK_VISION_PLUGIN(user_data);
+  self->frame_event_pending->store(false);
+
+  // Pin briefly to read a consistent description of the newest frame.
+  kiosk_vision::FrameRing::ReadLease lease;
+  if (self->frame_listening && self->frame_ring->AcquireLatest(&lease)) {
+    g_autoptr(FlValue) event = frame_info_to_value(lease.info());
+    lease.Release();
+    fl_event_channel_send(self->frame_channel, event, nullptr, nullptr);
+  }
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean deliver_preview_event(gpointer user_data) {
+  KioskVisionPlugin* self = KIOSK_VISION_PLUGIN(user_data);
+  self->preview_event_pending->store(false);
+  // Only the main thread changes the list, so no lock is needed to read it.
+  for (KioskPreviewTexture* texture : *self->previews) {
+    fl_texture_registrar_mark_texture_frame_available(self->texture_registrar,
+                                                      FL_TEXTURE(texture));
+  }
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Renders the frame into every preview texture, on the producer thread so
+// the pixels are read while still hot and the main thread only has to
+// announce them.
+static void render_previews(KioskVisionPlugin* self,
+                            const kiosk_vision::FrameInfo& info) {
+  bool rendered = false;
+  {
+    std::lock_guard<std::mutex> lock(*self->preview_mutex);
+    if (self->previews->empty()) {
+      return;
+    }
+    kiosk_vision::FrameRing::ReadLease lease;
+    if (!self->frame_ring->Acquire(info.slot, info.frame_id, &lease)) {
+      return;
+    }
+    for (KioskPreviewTexture* texture : *self->previews) {
+      rendered |= kiosk_preview_texture_get_renderer(texture)->Render(
+          lease.view(), info.timestamp_us);
+    }
+  }
+  if (rendered && !self->preview_event_pending->exchange(true)) {
+    g_idle_add(deliver_preview_event, g_object_ref(self));
+  }
+}
+
+static gboolean deliver_camera_preview_event(gpointer user_data) {
+  KioskVisionPlugin* self = KIOSK_VISION_PLUGIN(user_data);
+  for (CameraPreview* preview : *self->camera_previews) {
+    if (preview->event_pending.exchange(false)) {
+      fl_texture_registrar_mark_texture_frame_available(
+          self->texture_registrar, FL_TEXTURE(preview->texture));
+    }
+  }
+  g_object_unref(self);
+  return G_SOURCE_REMOVE;
+}
+
+// Runs on the capture thread of the preview's camera.
+static void render_camera_preview(KioskVisionPlugin* self,
+                                  CameraPreview* preview,
+                                  const kiosk_vision::FrameInfo& info) {
+  kiosk_vision::FrameRing::ReadLease lease;
+  if (!preview->ring->Acquire(info.slot, info.frame_id, &lease)) {
+    return;
+  }
+  const bool rendered =
+      kiosk_preview_texture_get_renderer(preview->texture)
+          ->Render(lease.view(), info.timestamp_us);
+  lease.Release();
+  if (rendered && !preview->event_pending.exchange(true)) {
+    g_idle_add(deliver_camera_preview_event, g_object_ref(self));
+  }
+}
+
+// Feeds the detector's latest boxes to the preview overlays. Runs on the
+// engine worker.
+static void update_preview_overlays(
+    KioskVisionPlugin* self, const kiosk_vision::DetectionResult& result) {
+  if (!result.ok || result.skipped) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(*self->preview_mutex);
+  if (self->previews->empty()) {
+    return;
+  }
+  const kiosk_vision::ModelInfo info = self->engine->model_info();
+  const kiosk_vision::CropRect area =
+      kiosk_vision::CenterCrop(result.frame_width, result.frame_height,
+                               info.input_width, info.input_height);
+  for (KioskPreviewTexture* texture : *self->previews) {
+    kiosk_preview_texture_get_renderer(texture)->SetOverlay(
+        result.detections, result.tracks, result.tracking, area,
+        result.frame_width, result.frame_height);
+  }
+}
+
+// Runs on the producer thread.
+static void on_frame_published(KioskVisionPlugin* self,
+                               const kiosk_vision::FrameInfo& info) {
+  render_previews(self, info);
+  if (self->recorder->is_recording()) {
+    kiosk_vision::FrameRing::ReadLease lease;
+    if (self->frame_ring->Acquire(info.slot, info.frame_id, &lease)) {
+      self->recorder->Record(lease.view(), info.frame_id, info.timestamp_us);
+    }
+  }
+  if (!self->frame_listening || self->frame_event_pending->exchange(true)) {
+    return;
+  }
+  g_idle_add(deliver_frame_event, g_object_ref(self));
+}
+
+static FlMethodErrorResponse* frame_listen_cb(FlEventChannel* channel,
+                                              FlValue* args,
+                                              gpointer user_data) {
+  KIOSK_VISION_PLUGIN(user_data)->frame_listening = TRUE;
+  return nullptr;
+}
+
+static FlMethodErrorResponse* frame_cancel_cb(FlEventChannel* channel,
+                                              FlValue* args,
+                                              gpointer user_data) {
+  KIOSK_VISION_PLUGIN(user_data)->frame_listening = FALSE;
+  return nullptr;
+}
+
+static void respond_with_detection(
+    FlMethodCall* method_call, const kiosk_vision::DetectionResult& result) {
+  respond_on_main_thread(method_call, [result]() {
+    if (!result.ok) {
+      return FL_METHOD_RESPONSE(fl_method_error_response_new(
+          kErrorCode, result.error.c_str(), nullptr));
+    }
+    g_autoptr(FlValue) value = detection_result_to_value(result);
+    return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+  });
+}
+
+static void handle_load_model(KioskVisionPlugin* self,
+                              FlMethodCall* method_call, FlValue* args) {
+  FlValue* model = lookup(args, "modelBytes", FL_VALUE_TYPE_UINT8_LIST);
+  if (model == nullptr) {
+    fl_method_call_respond_error(method_call, kErrorCode,
+                                 "modelBytes is required", nullptr, nullptr);
+    return;
+  }
+
+  const uint8_t* data = fl_value_get_uint8_list(model);
+  std::vector<uint8_t> bytes(data, data + fl_value_get_length(model));
+  kiosk_vision::InferenceThreadConfig threads;
+  threads.num_threads = static_cast<int>(lookup_int(args, "numThreads", 0));
+  threads.cpus = lookup_int_list(args, "cpus");
+  threads.nice = static_cast<int>(lookup_int(args, "nice", 0));
+
+  g_object_ref(method_call);
+  self->engine->LoadModel(
+      std::move(bytes), threads,
+      [method_call](bool ok, const kiosk_vision::ModelInfo& info,
+                    const std::string& error) {
+        respond_on_main_thread(method_call, [ok, info, error]() {
+          if (!ok) {
+            return FL_METHOD_RESPONSE(
+                fl_method_error_response_new(kErrorCode, error.c_str(),
+                                             nullptr));
+          }
+          g_autoptr(FlValue) value = model_info_to_value(info);
+          return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+        });
+        g_object_unref(method_call);
+      });
+}
+
+static void handle_detect_frame(KioskVisionPlugin* self,
+                                FlMethodCall* method_call, FlValue* args) {
+  if (!self->engine->is_loaded()) {
+    fl_method_call_respond_error(method_call, kErrorCode, "Model not loaded",
+                                 nullptr, nullptr);
+    return;
+  }
+  FlValue* pixels = lookup(args, "frame", FL_VALUE_TYPE_UINT8_LIST);
+  if (pixels == nullptr) {
+    fl_method_call_respond_error(method_call, kErrorCode, "frame is required",
+                                 nullptr, nullptr);
+    return;
+  }
+
+  kiosk_vision::Frame frame;
+  const uint8_t* data = fl_value_get_uint8_list(pixels);
+  frame.pixels.assign(data, data + fl_value_get_length(pixels));
+  frame.width = static_cast<int>(lookup_int(args, "width", 0));
+  frame.height = static_cast<int>(lookup_int(args, "height", 0));
+  frame.timestamp_us = g_get_monotonic_time();
+
+  const std::string format = lookup_string(args, "format", "auto");
+  if (format == "bgra") {
+    frame.format = kiosk_vision::PixelFormat::kBgra;
+  } else if (format == "rgb") {
+    frame.format = kiosk_vision::PixelFormat::kRgb;
+  } else if (format == "encoded" ||
+             (format == "auto" && looks_encoded(frame.pixels))) {
+    frame.encoded = true;
+  }
+
+  const float threshold =
+      static_cast<float>(lookup_double(args, "threshold", 0.5));
+
+  g_object_ref(method_call);
+  self->engine->Detect(
+      std::move(frame), threshold,
+      [self, method_call](const kiosk_vision::DetectionResult& result) {
+        update_preview_overlays(self, result);
+        respond_with_detection(method_call, result);
+        g_object_unref(method_call);
+      });
+}
+
+// Detects on a frame that is already in the ring; without "frameId" the
+// newest frame is used. "allowNewer" substitutes the newest frame when the
+// requested one has been recycled in the meantime.
+static void handle_detect_ring_frame(KioskVisionPlugin* self,
+                                     FlMethodCall* method_call,
+                                     FlValue* args) {
+  if (!self->engine->is_loaded()) {
+    fl_method_call_respond_error(method_call, kErrorCode, "Model not loaded",
+                                 nullptr, nullptr);
+    return;
+  }
+  const int slot = static_cast<int>(lookup_int(args, "slot", -1));
+  const uint64_t frame_id =
+      static_cast<uint64_t>(lookup_int(args, "frameId", 0));
+  FlValue* allow_newer = lookup(args, "allowNewer", FL_VALUE_TYPE_BOOL);
+  const float threshold =
+      static_cast<float>(lookup_double(args, "threshold", 0.5));
+
+  g_object_ref(method_call);
+  self->engine->DetectFromRing(
+      self->frame_ring, slot, frame_id,
+      allow_newer != nullptr && fl_value_get_bool(allow_newer), threshold,
+      [self, method_call](const kiosk_vision::DetectionResult& result) {
+        update_preview_overlays(self, result);
+        respond_with_detection(method_call, result);
+        g_object_unref(method_call);
+      });
+}
+
+static FlValue* frame_ring_info_to_value(KioskVisionPlugin* self) {
+  FlValue* map = frame_info_to_value(self->frame_ring->latest());
+  fl_value_set_string_take(map, "slots",
+                           fl_value_new_int(self->frame_ring->slot_count()));
+  fl_value_set_string_take(map, "framesWritten",
+                           fl_value_new_int(static_cast<int64_t>(
+                               self->frame_ring->frames_written())));
+  fl_value_set_string_take(map, "framesDropped",
+                           fl_value_new_int(static_cast<int64_t>(
+                               self->frame_ring->frames_dropped())));
+  gboolean attached = FALSE;
+#ifdef KIOSK_VISION_HAVE_LIBWEBRTC
+  attached = self->webrtc_sink != nullptr;
+#endif
+  fl_value_set_string_take(map, "webrtcAttached", fl_value_new_bool(attached));
+  return map;
+}
+
+static void detach_webrtc_sink(KioskVisionPlugin* self) {
+#ifdef KIOSK_VISION_HAVE_LIBWEBRTC
+  delete self->webrtc_sink;
+  self->webrtc_sink = nullptr;
+#endif
+}
+
+static kiosk_vision::PreviewConfig preview_config_from_args(
+    FlValue* args, const kiosk_vision::PreviewConfig& current) {
+  kiosk_vision::PreviewConfig config = current;
+  config.max_width =
+      static_cast<int>(lookup_int(args, "maxWidth", config.max_width));
+  config.max_fps = lookup_double(args, "maxFps", config.max_fps);
+  config.overlay = lookup_bool(args, "overlay", config.overlay);
+  if (lookup(args, "labels", FL_VALUE_TYPE_LIST) != nullptr) {
+    config.labels = lookup_string_list(args, "labels");
+  }
+  return config;
+}
+
+static FlValue* preview_to_value(KioskPreviewTexture* texture) {
+  const kiosk_vision::PreviewStats stats =
+      kiosk_preview_texture_get_renderer(texture)->stats();
+  FlValue* map = fl_value_new_map();
+  fl_value_set_string_take(
+      map, "textureId",
+      fl_value_new_int(fl_texture_get_id(FL_TEXTURE(texture))));
+  fl_value_set_string_take(map, "width", fl_value_new_int(stats.width));
+  fl_value_set_string_take(map, "height", fl_value_new_int(stats.height));
+  fl_value_set_string_take(map, "framesRendered",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_rendered)));
+  fl_value_set_string_take(map, "framesSkipped",
+                           fl_value_new_int(static_cast<int64_t>(
+                               stats.frames_skipped)));
+  fl_value_set_string_take(map, "renderTime",
+                           fl_value_new_float(stats.render_ms));
+  return map;
+}
+
+static KioskPreviewTexture* find_preview(KioskVisionPlugin* self,
+                                         FlValue* args) {
+  const int64_t id = lookup_int(args, "textureId", -1);
+  for (KioskPreviewTexture* texture : *self->previews) {
+    if (fl_texture_get_id(FL_TEXTURE(texture)) == id) {
+      return texture;
+    }
+  }
+  return nullptr;
+}
+
+static void handle_create_preview_texture(KioskVisionPlugin* self,
+                                          FlMethodCall* method_call,
+                                          FlValue* args) {
+  KioskPreviewTexture* texture = kiosk_preview_texture_new();
+  kiosk_preview_texture_get_renderer(texture)->Configure(
+      preview_config_from_args(args, kiosk_vision::PreviewConfig()));
+  if (!fl_texture_registrar_register_texture(self->texture_registrar,
+                                             FL_TEXTURE(texture))) {
+    g_object_unref(texture);
+    fl_method_call_respond_error(method_call, kErrorCode,
+                                 "Failed to register preview texture",
+                                 nullptr, nullptr);
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(*self->preview_mutex);
+    self->previews->push_back(texture);
+  }
+  g_autoptr(FlValue) value = preview_to_value(texture);
+  fl_method_call_respond_success(method_call, value, nullptr);
+}
+
+static void handle_configure_preview_texture(KioskVisionPlugin* self,
+                                             FlMethodCall* method_call,
+                                             FlValue* args) {
+  KioskPreviewTexture* texture = find_preview(self, args);
+  if (texture == nullptr) {
+    fl_method_call_respond_error(method_call, kErrorCode,
+                                 "Unknown preview texture", nullptr, nullptr);
+    return;
+  }
+  kiosk_vision::PreviewRenderer* renderer =
+      kiosk_preview_texture_get_renderer(texture);
+  renderer->Configure(preview_config_from_args(args, renderer->config()));
+  if (!lookup_bool(args, "overlay", true)) {
+    renderer->ClearOverlay();
+  }
+  g_autoptr(FlValue) value = preview_to_value(texture);
+  fl_method_call_respond_success(method_call, value, nullptr);
+}
+
+static void dispose_preview(KioskVisionPlugin* self,
+                            KioskPreviewTexture* texture) {
+  {
+    std::lock_guard<std::mutex> lock(*self->preview_mutex);
+    self->previews->erase(std::remove(self->previews->begin(),
+                                      self->previews->end(), texture),
+                          self->previews->end());
+  }
+  // The engine keeps its own reference until the raster thread is done.
+  fl_texture_registrar_unregister_texture(self->texture_registrar,
+                                          FL_TEXTURE(texture));
+  g_object_unref(texture);
+}
+
+// Stops whichever camera or stream feeds |frame_ring|.
+static void release_capture(KioskVisionPlugin* self) {
+  self->camera_hub->Release(self->capture_consumer);
+  self->capture_consumer = 0;
+#ifdef KIOSK_VISION_HAVE_LIBAV
+  if (self->stream != nullptr) {
+    self->stream->Stop();
+  }
+#endif
+}
+
+static bool stream_running(KioskVisionPlugin* self) {
+#ifdef KIOSK_VISION_HAVE_LIBAV
+  return self->stream != nullptr && self->stream->is_running();
+#else
+  return false;
+#endif
+}
+
+static FlValue* capture_info_to_value(KioskVisionPlugin* self) {
+#ifdef KIOSK_VISION_HAVE_LIBAV
+  if (stream_running(self)) {
+    return stream_stats_to_value(self->stream->stats());
+  }
+#endif
+  FlValue* map = capture_stats_to_value(
+      self->camera_hub->consumer_stats(self->capture_consumer));
+  fl_value_set_string_take(map, "source", fl_value_new_string("v4l2"));
+  return map;
+}
+
+static void handle_start_stream(KioskVisionPlugin* self,
+                                FlMethodCall* method_call, FlValue* args) {
+#ifdef KIOSK_VISION_HAVE_LIBAV
+  kiosk_vision::StreamConfig config;
+  config.url = lookup_string(args, "url", "");
+  config.rtsp_tcp = lookup_bool(args, "rtspTcp", config.rtsp_tcp);
+  config.publish_fps = lookup_double(args, "publishFps", config.publish_fps);
+  config.publish_width =
+      static_cast<int>(lookup_int(args, "publishWidth", 0));
+  config.publish_height =
+      static_cast<int>(lookup_int(args, "publishHeight", 0));
+  config.idle = lookup_bool(args, "idle", false);
+  config.timeout_ms =
+      static_cast<int>(lookup_int(args, "timeoutMs", config.timeout_ms));
+  if (self->stream == nullptr) {
+    self->decode_pool = new kiosk_vision::DecodePool(0);
+    self->stream =
+        new kiosk_vision::StreamCapture(self->frame_ring, self->decode_pool);
+  }
+  std::string error;
+  if (!self->stream->Start(config, &error)) {
+    fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                 nullptr, nullptr);
+    return;
+  }
+  g_autoptr(FlValue) stats = stream_stats_to_value(self->stream->stats());
+  fl_method_call_respond_success(method_call, stats, nullptr);
+#else
+  fl_method_call_respond_error(
+      method_call, kErrorCode,
+      "Network streams need the FFmpeg development packages at build time",
+      nullptr, nullptr);
+#endif
+}
+
+// Starts feeding |frame_ring| from a local camera, or from a network
+// camera or file when "url" is given.
+static void handle_start_capture(KioskVisionPlugin* self,
+                                 FlMethodCall* method_call, FlValue* args) {
+  // The ring has a single producer.
+  detach_webrtc_sink(self);
+  release_capture(self);
+  if (lookup(args, "url", FL_VALUE_TYPE_STRING) != nullptr) {
+    handle_start_stream(self, method_call, args);
+    return;
+  }
+
+  kiosk_vision::CameraConsumerRequest request;
+  request.capture = capture_config_from_args(args);
+  request.ring = self->frame_ring;
+  std::string error;
+  self->capture_consumer = self->camera_hub->Acquire(request, &error);
+  if (self->capture_consumer == 0) {
+    fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                 nullptr, nullptr);
+    return;
+  }
+  g_autoptr(FlValue) stats = capture_info_to_value(self);
+  fl_method_call_respond_success(method_call, stats, nullptr);
+}
+
+static void handle_set_capture_publishing(KioskVisionPlugin* self,
+                                          FlMethodCall* method_call,
+                                          FlValue* args) {
+  const double publish_fps = lookup_double(args, "publishFps", 0);
+  const int publish_width =
+      static_cast<int>(lookup_int(args, "publishWidth", 0));
+  const int publish_height =
+      static_cast<int>(lookup_int(args, "publishHeight", 0));
+#ifdef KIOSK_VISION_HAVE_LIBAV
+  if (stream_running(self)) {
+    self->stream->SetPublishing(publish_fps, publish_width, publish_height);
+  }
+#endif
+  self->camera_hub->Update(self->capture_consumer, publish_fps,
+                           publish_width, publish_height);
+  g_autoptr(FlValue) stats = capture_info_to_value(self);
+  fl_method_call_respond_success(method_call, stats, nullptr);
+}
+
+// Records |frame_ring| to "path" until stopRecording, with the capture
+// settings and any "metadata" strings from Dart in the file header.
+static void handle_start_recording(KioskVisionPlugin* self,
+                                   FlMethodCall* method_call, FlValue* args) {
+  const std::string path = lookup_string(args, "path", "");
+  if (path.empty()) {
+    fl_method_call_respond_error(method_call, kErrorCode,
+                                 "Missing recording path", nullptr, nullptr);
+    return;
+  }
+  std::string source = self->capture_consumer != 0 ? "v4l2" : "external";
+  kiosk_vision::CaptureStats capture =
+      self->camera_hub->consumer_stats(self->capture_consumer);
+#ifdef KIOSK_VISION_HAVE_LIBAV
+  if (stream_running(self)) {
+    source = "stream";
+    capture = self->stream->stats().capture;
+  }
+#endif
+  g_autoptr(GDateTime) now = g_date_time_new_now_utc();
+  g_autofree gchar* created = g_date_time_format_iso8601(now);
+  kiosk_vision::RecordingMetadata metadata = {
+      {"created", created},
+      {"source", source},
+      {"device", capture.device},
+      {"format", capture.format},
+      {"captureWidth", std::to_string(capture.width)},
+      {"captureHeight", std::to_string(capture.height)},
+      {"captureFps", std::to_string(capture.fps)},
+  };
+  FlValue* extra = lookup(args, "metadata", FL_VALUE_TYPE_MAP);
+  if (extra != nullptr) {
+    for (size_t i = 0; i < fl_value_get_length(extra); ++i) {
+      FlValue* key = fl_value_get_map_key(extra, i);
+      FlValue* value = fl_value_get_map_value(extra, i);
+      if (fl_value_get_type(key) == FL_VALUE_TYPE_STRING &&
+          fl_value_get_type(value) == FL_VALUE_TYPE_STRING) {
+        metadata.emplace_back(fl_value_get_string(key),
+                              fl_value_get_string(value));
+      }
+    }
+  }
+
+  // Size limit in MiB; 0 records until stopped.
+  const int64_t max_mb = std::max<int64_t>(lookup_int(args, "maxMb", 0), 0);
+  std::string error;
+  if (!self->recorder->Start(path, metadata,
+                             static_cast<uint64_t>(max_mb) << 20, &error)) {
+    fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                 nullptr, nullptr);
+    return;
+  }
+  g_autoptr(FlValue) stats = recording_stats_to_value(self->recorder->stats());
+  fl_method_call_respond_success(method_call, stats, nullptr);
+}
+
+static CameraPreview* find_camera_preview(KioskVisionPlugin* self,
+                                          FlValue* args) {
+  const int64_t id = lookup_int(args, "consumerId", 0);
+  for (CameraPreview* preview : *self->camera_previews) {
+    if (preview->consumer_id == id) {
+      return preview;
+    }
+  }
+  return nullptr;
+}
+
+static FlValue* camera_preview_to_value(KioskVisionPlugin* self,
+                                        CameraPreview* preview) {
+  FlValue* map = capture_stats_to_value(
+      self->camera_hub->consumer_stats(preview->consumer_id));
+  fl_value_set_string_take(map, "consumerId",
+                           fl_value_new_int(preview->consumer_id));
+  fl_value_set_string_take(map, "preview", preview_to_value(preview->texture));
+  return map;
+}
+
+// Opens (or joins) a camera through the hub and shows it in a new texture,
+// fed through a ring of its own at the requested publish rate and size.
+static void handle_acquire_camera(KioskVisionPlugin* self,
+                                  FlMethodCall* method_call, FlValue* args) {
+  kiosk_vision::PreviewConfig preview_config;
+  preview_config.overlay = false;
+  preview_config.max_fps = 0;  // The publish rate already limits it.
+  std::unique_ptr<CameraPreview> preview(new CameraPreview());
+  preview->texture = kiosk_preview_texture_new();
+  kiosk_preview_texture_get_renderer(preview->texture)
+      ->Configure(preview_config_from_args(args, preview_config));
+  preview->ring.reset(new kiosk_vision::FrameRing(kCameraPreviewSlots));
+  CameraPreview* raw = preview.get();
+  preview->ring->SetFrameListener(
+      [self, raw](const kiosk_vision::FrameInfo& info) {
+        render_camera_preview(self, raw, info);
+      });
+  if (!fl_texture_registrar_register_texture(self->texture_registrar,
+                                             FL_TEXTURE(preview->texture))) {
+    g_object_unref(preview->texture);
+    fl_method_call_respond_error(method_call, kErrorCode,
+                                 "Failed to register preview texture",
+                                 nullptr, nullptr);
+    return;
+  }
+
+  kiosk_vision::CameraConsumerRequest request;
+  request.capture = capture_config_from_args(args);
+  request.ring = preview->ring.get();
+  std::string error;
+  preview->consumer_id = self->camera_hub->Acquire(request, &error);
+  if (preview->consumer_id == 0) {
+    fl_texture_registrar_unregister_texture(self->texture_registrar,
+                                            FL_TEXTURE(preview->texture));
+    g_object_unref(preview->texture);
+    fl_method_call_respond_error(method_call, kErrorCode, error.c_str(),
+                                 nullptr, nullptr);
+    return;
+  }
+  self->camera_previews->push_back(preview.release());
+  g_autoptr(FlValue) value = camera_preview_to_value(self, raw);
+  fl_method_call_respond_success(method_call, value, nullptr);
+}
+
+static void handle_update_camera_consumer(KioskVisionPlugin* self,
+                                          FlMethodCall* method_call,
+                                          FlValue* args) {
+  CameraPreview* preview = find_camera_preview(self, args);
+  if (preview == nullptr) {
+    fl_method_call_respond_error(method_call, kErrorCode,
+                                 "Unknown camera consumer", nullptr, nullptr);
+    return;
+  }
+  self->camera_hub->Update(
+      preview->consumer_id, lookup_double(args, "publishFps", 0),
+      static_cast<int>(lookup_int(args, "publishWidth", 0)),
+      static_cast<int>(lookup_int(args, "publishHeight", 0)));
+  kiosk_vision::PreviewRenderer* renderer =
+      kiosk_preview_texture_get_renderer(preview->texture);
+  renderer->Configure(preview_config_from_args(args, renderer->config()));
+  g_autoptr(FlValue) value = camera_preview_to_value(self, preview);
+  fl_method_call_respond_success(method_call, value, nullptr);
+}
+
+static void dispose_camera_preview(KioskVisionPlugin* self,
+                                   CameraPreview* preview) {
+  self->camera_previews->erase(
+      std::remove(self->camera_previews->begin(),
+                  self->camera_previews->end(), preview),
+      self->camera_previews->end());
+  // Returns once the capture thread is done with the ring and the texture.
+  self->camera_hub->Release(preview->consumer_id);
+  fl_texture_registrar_unregister_texture(self->texture_registrar,
+                                          FL_TEXTURE(preview->texture));
+  g_object_unref(preview->texture);
+  delete preview;
+}
+
+// "classThresholds" maps class ids to minimum scores; the other keys fall
+// back to the defaults when unset.
+static void handle_configure_postprocess(KioskVisionPlugin* self,
+                                         FlMethodCall* method_call,
+                                         FlValue* args) {
+  kiosk_vision::PostprocessConfig postprocess;
+  FlValue* thresholds = lookup(args, "classThresholds", FL_VALUE_TYPE_MAP);
+  if (thresholds != nullptr) {
+    for (size_t i = 0; i < fl_value_get_length(thresholds); ++i) {
+      FlValue* key = fl_value_get_map_key(thresholds, i);
+      FlValue* value = fl_value_get_map_value(thresholds, i);
+      if (fl_value_get_type(key) != FL_VALUE_TYPE_INT ||
+          fl_value_get_type(value) != FL_VALUE_TYPE_FLOAT) {
+        continue;
+      }
+      const int64_t class_id = fl_value_get_int(key);
+      if (class_id < 0 || class_id > 1000) {
+        continue;
+      }
+      if (postprocess.class_thresholds.size() <=
+          static_cast<size_t>(class_id)) {
+        postprocess.class_thresholds.resize(class_id + 1, -1.0f);
+      }
+      postprocess.class_thresholds[class_id] =
+          static_cast<float>(fl_value_get_float(value));
+    }
+  }
+  postprocess.nms_iou =
+      static_cast<float>(lookup_double(args, "nmsIou", postprocess.nms_iou));
+  postprocess.class_agnostic_nms =
+      lookup_bool(args, "classAgnosticNms", postprocess.class_agnostic_nms);
+  postprocess.max_detections = static_cast<int>(
+      lookup_int(args, "maxDetections", postprocess.max_detections));
+
+  kiosk_vision::TrackerConfig tracker;
+  tracker.enabled = lookup_bool(args, "tracking", tracker.enabled);
+  tracker.match_iou = static_cast<float>(
+      lookup_double(args, "trackMatchIou", tracker.match_iou));
+  tracker.min_hits =
+      static_cast<int>(lookup_int(args, "trackMinHits", tracker.min_hits));
+  tracker.max_misses = static_cast<int>(
+      lookup_int(args, "trackMaxMisses", tracker.max_misses));
+
+  self->engine->SetPostprocess(postprocess, tracker);
+  fl_method_call_respond_success(method_call, nullptr, nullptr);
+}
+
+// Unset keys keep their current value.
+static void handle_set_motion_gate(KioskVisionPlugin* self,
+                                   FlMethodCall* method_call, FlValue* args) {
+  kiosk_vision::MotionGateConfig config = self->engine->motion_gate_config();
+  config.enabled = lookup_bool(args, "enabled", config.enabled);
+  config.grid_width =
+      static_cast<int>(lookup_int(args, "gridWidth", config.grid_width));
+  config.grid_height =
+      static_cast<int>(lookup_int(args, "gridHeight", config.grid_height));
+  config.pixel_threshold = static_cast<int>(
+      lookup_int(args, "pixelThreshold", config.pixel_threshold));
+  config.motion_threshold =
+      lookup_double(args, "motionThreshold", config.motion_threshold);
+  config.background_rate =
+      lookup_double(args, "backgroundRate", config.background_rate);
+  config.keepalive_us =
+      lookup_int(args, "keepAliveMs", config.keepalive_us / 1000) * 1000;
+  self->engine->SetMotionGate(config);
+  g_autoptr(FlValue) stats =
+      motion_stats_to_value(self->engine->motion_gate_config(),
+                            self->engine->motion_stats());
+  fl_method_call_respond_success(method_call, stats, nullptr);
+}
+
+// Sweeps interpreter thread counts and keeps the best setup; takes a few
+// seconds, during which live frames queue behind it.
+static void handle_benchmark_threads(KioskVisionPlugin* self,
+                                     FlMethodCall* method_call,
+                                     FlValue* args) {
+  if (!self->engine->is_loaded()) {
+    fl_method_call_respond_error(method_call, kErrorCode, "Model not loaded",
+                                 nullptr, nullptr);
+    return;
+  }
+  g_object_ref(method_call);
+  self->engine->BenchmarkThreads(
+      lookup_int_list(args, "threadCounts"),
+      static_cast<int>(lookup_int(args, "iterations", 20)),
+      [method_call](bool ok,
+                    const std::vector<kiosk_vision::ThreadBenchmark>& results,
+                    const kiosk_vision::InferenceThreadConfig& chosen,
+                    const std::string& error) {
+        respond_on_main_thread(method_call, [ok, results, chosen, error]() {
+          if (!ok) {
+            return FL_METHOD_RESPONSE(fl_method_error_response_new(
+                kErrorCode, error.c_str(), nullptr));
+          }
+          g_autoptr(FlValue) value = thread_benchmark_to_value(results, chosen);
+          return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+        });
+        g_object_unref(method_call);
+      });
+}
+
+// Releases the interpreter when the detector has been idle; answers after
+// the frames already queued on the engine worker.
+static void handle_trim_memory(KioskVisionPlugin* self,
+                               FlMethodCall* method_call, FlValue* args) {
+  g_object_ref(method_call);
+  self->engine->ReleaseIdle(
+      static_cast<int>(lookup_int(args, "idleMs", 60000)),
+      [method_call](bool released) {
+        respond_on_main_thread(method_call, [released]() {
+          g_autoptr(FlValue) value = fl_value_new_map();
+          fl_value_set_string_take(value, "interpreterReleased",
+                                   fl_value_new_bool(released));
+          return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+        });
+        g_object_unref(method_call);
+      });
+}
+
+// Compares the single resize with tiled inference on a directory of PNG or
+// JPEG frames; runs on the engine worker, after any queued frames.
+static void handle_benchmark_tiling(KioskVisionPlugin* self,
+                                    FlMethodCall* method_call,
+                                    FlValue* args) {
+  if (!self->engine->is_loaded()) {
+    fl_method_call_respond_error(method_call, kErrorCode, "Model not loaded",
+                                 nullptr, nullptr);
+    return;
+  }
+  const std::string clip = lookup_string(args, "clipPath", "");
+  if (clip.empty()) {
+    fl_method_call_respond_error(method_call, kErrorCode,
+                                 "clipPath is required", nullptr, nullptr);
+    return;
+  }
+  const int max_frames = static_cast<int>(lookup_int(args, "maxFrames", 200));
+  const double clip_fps = lookup_double(args, "clipFps", 10.0);
+  const float threshold =
+      static_cast<float>(lookup_double(args, "threshold", 0.5));
+
+  g_object_ref(method_call);
+  self->engine->BenchmarkTiling(
+      clip, max_frames, clip_fps, tiling_config_from_args(args), threshold,
+      labels_from_args(args),
+      [method_call](bool ok,
+                    const std::vector<kiosk_vision::TilingBenchmark>& results,
+                    const std::string& error) {
+        respond_on_main_thread(method_call, [ok, results, error]() {
+          if (!ok) {
+            return FL_METHOD_RESPONSE(fl_method_error_response_new(
+                kErrorCode, error.c_str(), nullptr));
+          }
+          g_autoptr(FlValue) value = tiling_benchmark_to_value(results);
+          return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+        });
+        g_object_unref(method_call);
+      });
+}
+
+// Diagnostics for the color conversion kernels. Both run on a short-lived
+// thread since the benchmark takes a few seconds on a Pi.
+static void handle_verify_color_conversion(FlMethodCall* method_call) {
+  g_object_ref(method_call);
+  std::thread([method_call]() {
+    std::string report;
+    const int failures = kiosk_vision::VerifyYuvConverter(&report);
+    respond_on_main_thread(method_call, [failures, report]() {
+      g_autoptr(FlValue) value = fl_value_new_map();
+      fl_value_set_string_take(value, "passed",
+                               fl_value_new_bool(failures == 0));
+      fl_value_set_string_take(value, "failures", fl_value_new_int(failures));
+      fl_value_set_string_take(value, "report",
+                               fl_value_new_string(report.c_str()));
+      return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+    });
+    g_object_unref(method_call);
+  }).detach();
+}
+
+static void handle_benchmark_color_conversion(FlMethodCall* method_call,
+                                              FlValue* args) {
+  const int src_width = static_cast<int>(lookup_int(args, "srcWidth", 640));
+  const int src_height = static_cast<int>(lookup_int(args, "srcHeight", 480));
+  const int dst_width = static_cast<int>(lookup_int(args, "dstWidth", 300));
+  const int dst_height = static_cast<int>(lookup_int(args, "dstHeight", 300));
+  const int iterations =
+      static_cast<int>(lookup_int(args, "iterations", 200));
+  g_object_ref(method_call);
+  std::thread([=]() {
+    kiosk_vision::YuvConverter converter;
+    const std::string kernel = converter.kernel_name();
+    std::vector<kiosk_vision::ColorBenchmark> results =
+        kiosk_vision::BenchmarkYuvConverter(src_width, src_height, dst_width,
+                                            dst_height, iterations);
+    respond_on_main_thread(method_call, [kernel, results]() {
+      g_autoptr(FlValue) value = fl_value_new_map();
+      fl_value_set_string_take(value, "kernel",
+                               fl_value_new_string(kernel.c_str()));
+      FlValue* list = fl_value_new_list();
+      for (const kiosk_vision::ColorBenchmark& result : results) {
+        FlValue* entry = fl_value_new_map();
+        fl_value_set_string_take(
+            entry, "format",
+            fl_value_new_string(kiosk_vision::YuvFormatName(result.format)));
+        fl_value_set_string_take(entry, "simdMs",
+                                 fl_value_new_float(result.simd_ms));
+        fl_value_set_string_take(entry, "scalarMs",
+                                 fl_value_new_float(result.scalar_ms));
+        fl_value_set_string_take(
+            entry, "megapixelsPerSecond",
+            fl_value_new_float(result.megapixels_per_second));
+        fl_value_append_take(list, entry);
+      }
+      fl_value_set_string_take(value, "results", list);
+      return FL_METHOD_RESPONSE(fl_method_success_response_new(value));
+    });
+    g_object_unref(method_call);
+  }).detach();
+}
+
+static void kiosk_vision_plugin_handle_method_call(KioskVisionPlugin* self,
+                                                   FlMethodCall* method_call) {
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  if (strcmp(method, "loadModel") == 0) {
+    handle_load_model(self, method_call, args);
+  } else if (strcmp(method, "detectFrame") == 0) {
+    handle_detect_frame(self, method_call, args);
+  } else if (strcmp(method, "detectRingFrame") == 0) {
+    handle_detect_ring_frame(self, method_call, args);
+  } else if (strcmp(method, "getFrameRingInfo") == 0) {
+    g_autoptr(FlValue) info = frame_ring_info_to_value(self);
+    fl_method_call_respond_success(method_call, info, nullptr);
+  } else if (strcmp(method, "listCameras") == 0) {
+    g_autoptr(FlValue) cameras = cameras_to_value(kiosk_vision::ListCameras());
+    fl_method_call_respond_success(method_call, cameras, nullptr);
+  } else if (strcmp(method, "startCapture") == 0) {
+    handle_start_capture(self, method_call, args);
+  } else if (strcmp(method, "stopCapture") == 0) {
+    release_capture(self);
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "setCapturePublishing") == 0) {
+    handle_set_capture_publishing(self, method_call, args);
+  } else if (strcmp(method, "setCaptureIdle") == 0) {
+#ifdef KIOSK_VISION_HAVE_LIBAV
+    if (self->stream != nullptr) {
+      self->stream->SetIdle(lookup_bool(args, "idle", false));
+    }
+#endif
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "getCaptureInfo") == 0) {
+    g_autoptr(FlValue) stats = capture_info_to_value(self);
+    fl_method_call_respond_success(method_call, stats, nullptr);
+  } else if (strcmp(method, "startRecording") == 0) {
+    handle_start_recording(self, method_call, args);
+  } else if (strcmp(method, "stopRecording") == 0) {
+    self->recorder->Stop();
+    g_autoptr(FlValue) stats =
+        recording_stats_to_value(self->recorder->stats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+  } else if (strcmp(method, "getRecordingInfo") == 0) {
+    g_autoptr(FlValue) stats =
+        recording_stats_to_value(self->recorder->stats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+  } else if (strcmp(method, "acquireCamera") == 0) {
+    handle_acquire_camera(self, method_call, args);
+  } else if (strcmp(method, "updateCameraConsumer") == 0) {
+    handle_update_camera_consumer(self, method_call, args);
+  } else if (strcmp(method, "releaseCamera") == 0) {
+    CameraPreview* preview = find_camera_preview(self, args);
+    if (preview != nullptr) {
+      dispose_camera_preview(self, preview);
+    }
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "getCameraHubInfo") == 0) {
+    g_autoptr(FlValue) sessions =
+        camera_sessions_to_value(self->camera_hub->sessions());
+    fl_method_call_respond_success(method_call, sessions, nullptr);
+  } else if (strcmp(method, "createPreviewTexture") == 0) {
+    handle_create_preview_texture(self, method_call, args);
+  } else if (strcmp(method, "configurePreviewTexture") == 0) {
+    handle_configure_preview_texture(self, method_call, args);
+  } else if (strcmp(method, "disposePreviewTexture") == 0) {
+    KioskPreviewTexture* texture = find_preview(self, args);
+    if (texture != nullptr) {
+      dispose_preview(self, texture);
+    }
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "configurePostprocess") == 0) {
+    handle_configure_postprocess(self, method_call, args);
+  } else if (strcmp(method, "setMotionGate") == 0) {
+    handle_set_motion_gate(self, method_call, args);
+  } else if (strcmp(method, "setTiling") == 0) {
+    self->engine->SetTiling(tiling_config_from_args(args));
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "benchmarkThreads") == 0) {
+    handle_benchmark_threads(self, method_call, args);
+  } else if (strcmp(method, "benchmarkTiling") == 0) {
+    handle_benchmark_tiling(self, method_call, args);
+  } else if (strcmp(method, "getMotionStats") == 0) {
+    g_autoptr(FlValue) stats =
+        motion_stats_to_value(self->engine->motion_gate_config(),
+                              self->engine->motion_stats());
+    fl_method_call_respond_success(method_call, stats, nullptr);
+  } else if (strcmp(method, "verifyColorConversion") == 0) {
+    handle_verify_color_conversion(method_call);
+  } else if (strcmp(method, "benchmarkColorConversion") == 0) {
+    handle_benchmark_color_conversion(method_call, args);
+  } else if (strcmp(method, "trimMemory") == 0) {
+    handle_trim_memory(self, method_call, args);
+  } else if (strcmp(method, "unloadModel") == 0) {
+    self->engine->Unload();
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else if (strcmp(method, "getEngineInfo") == 0) {
+    g_autoptr(FlValue) info =
+        model_info_to_value(self->engine->model_info());
+    fl_value_set_string_take(info, "loaded",
+                             fl_value_new_bool(self->engine->is_loaded()));
+    fl_value_set_string_take(
+        info, "preprocessKernel",
+        fl_value_new_string(self->engine->preprocess_kernel()));
+    fl_method_call_respond_success(method_call, info, nullptr);
+  } else {
+    fl_method_call_respond_not_implemented(method_call, nullptr);
+  }
+}
+
+static void kiosk_vision_plugin_dispose(GObject* object) {
+  KioskVisionPlugin* self = KIOSK_VISION_PLUGIN(object);
+  if (active_plugin == self) {
+    active_plugin = nullptr;
+  }
+  // Producers and the engine may still be using the ring and the previews,
+  // so they go first.
+  detach_webrtc_sink(self);
+  if (self->camera_previews != nullptr) {
+    while (!self->camera_previews->empty()) {
+      dispose_camera_preview(self, self->camera_previews->back());
+    }
+  }
+  delete self->camera_previews;
+  self->camera_previews = nullptr;
+  delete self->camera_hub;
+  self->camera_hub = nullptr;
+#ifdef KIOSK_VISION_HAVE_LIBAV
+  delete self->stream;
+  self->stream = nullptr;
+  delete self->decode_pool;
+  self->decode_pool = nullptr;
+#endif
+  delete self->engine;
+  self->engine = nullptr;
+  delete self->recorder;
+  self->recorder = nullptr;
+  if (self->previews != nullptr) {
+    while (!self->previews->empty()) {
+      dispose_preview(self, self->previews->back());
+    }
+  }
+  delete self->previews;
+  self->previews = nullptr;
+  delete self->preview_mutex;
+  self->preview_mutex = nullptr;
+  delete self->preview_event_pending;
+  self->preview_event_pending = nullptr;
+  g_clear_object(&self->texture_registrar);
+  delete self->frame_ring;
+  self->frame_ring = nullptr;
+  delete self->frame_event_pending;
+  self->frame_event_pending = nullptr;
+  g_clear_object(&self->frame_channel);
+  G_OBJECT_CLASS(kiosk_vision_plugin_parent_class)->dispose(object);
+}
+
+static void kiosk_vision_plugin_class_init(KioskVisionPluginClass* klass) {
+  G_OBJECT_CLASS(klass)->dispose = kiosk_vision_plugin_dispose;
+}
+
+static void kiosk_vision_plugin_init(KioskVisionPlugin* self) {
+  self->engine = new kiosk_vision::DetectionEngine();
+  self->engine->SetFrameDecoder(decode_with_pixbuf);
+  self->frame_event_pending = new std::atomic<bool>(false);
+  self->frame_ring = new kiosk_vision::FrameRing(kFrameRingSlots);
+  self->recorder = new kiosk_vision::FrameRecorder();
+  self->previews = new std::vector<KioskPreviewTexture*>();
+  self->preview_mutex = new std::mutex();
+  self->preview_event_pending = new std::atomic<bool>(false);
+  self->frame_ring->SetFrameListener(
+      [self](const kiosk_vision::FrameInfo& info) {
+        on_frame_published(self, info);
+      });
+  self->camera_hub = new kiosk_vision::CameraHub();
+  self->camera_hub->SetJpegDecoder(decode_image_bytes);
+  self->capture_consumer = 0;
+#ifdef KIOSK_VISION_HAVE_LIBAV
+  self->decode_pool = nullptr;
+  self->stream = nullptr;
+#endif
+  self->camera_previews = new std::vector<CameraPreview*>();
+}
+
+static void method_call_cb(FlMethodChannel* channel, FlMethodCall* method_call,
+                           gpointer user_data) {
+  KioskVisionPlugin* plugin = KIOSK_VISION_PLUGIN(user_data);
+  kiosk_vision_plugin_handle_method_call(plugin, method_call);
+}
+
+void kiosk_vision_plugin_register_with_registrar(FlPluginRegistrar* registrar) {
+  KioskVisionPlugin* plugin = KIOSK_VISION_PLUGIN(
+      g_object_new(kiosk_vision_plugin_get_type(), nullptr));
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  g_autoptr(FlMethodChannel) channel =
+      fl_method_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                            kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel, method_call_cb,
+                                            g_object_ref(plugin),
+                                            g_object_unref);
+
+  plugin->frame_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           kFrameChannelName, FL_METHOD_CODEC(codec));
+  fl_event_channel_set_stream_handlers(plugin->frame_channel, frame_listen_cb,
+                                       frame_cancel_cb, plugin, nullptr);
+  plugin->texture_registrar = FL_TEXTURE_REGISTRAR(
+      g_object_ref(fl_plugin_registrar_get_texture_registrar(registrar)));
+  active_plugin = plugin;
+
+  g_object_unref(plugin);
+}
+
+gboolean kiosk_vision_attach_video_track(gpointer track) {
+  if (active_plugin == nullptr) {
+    return FALSE;
+  }
+#ifdef KIOSK_VISION_HAVE_LIBWEBRTC
+  detach_webrtc_sink(active_plugin);
+  if (track != nullptr) {
+    release_capture(active_plugin);
+    active_plugin->webrtc_sink = new kiosk_vision::WebRtcFrameSink(
+        static_cast<libwebrtc::RTCVideoTrack*>(track),
+        active_plugin->frame_ring);
+  }
+  return TRUE;
+#else
+  return track == nullptr;
+#endif
+}
+
+gboolean kiosk_vision_convert_yuv(const uint8_t* data, size_t size,
+                                  int32_t format, int32_t width,
+                                  int32_t height, int32_t stride,
+                                  uint8_t* dst, int32_t dst_stride,
+                                  int32_t dst_width, int32_t dst_height,
+                                  int32_t dst_format) {
+  if (format < 0 || format > 2 || dst_format < 0 || dst_format > 2 ||
+      dst == nullptr || dst_width <= 0 || dst_height <= 0) {
+    return FALSE;
+  }
+  const kiosk_vision::PixelFormat pixel_format =
+      static_cast<kiosk_vision::PixelFormat>(dst_format);
+  const int bytes_per_pixel =
+      pixel_format == kiosk_vision::PixelFormat::kRgb ? 3 : 4;
+  if (dst_stride < dst_width * bytes_per_pixel) {
+    return FALSE;
+  }
+  kiosk_vision::YuvImage image;
+  if (!kiosk_vision::WrapYuvBuffer(data, size,
+                                   static_cast<kiosk_vision::YuvFormat>(format),
+                                   width, height, stride, &image)) {
+    return FALSE;
+  }
+  // Callers on different isolates may convert concurrently.
+  static thread_local kiosk_vision::YuvConverter converter;
+  converter.Convert(image, dst, dst_stride, dst_width, dst_height,
+                    pixel_format);
+  return TRUE;
+}
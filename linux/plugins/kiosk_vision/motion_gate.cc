@@ -0,0 +1,170 @@
+#include "motion_gate.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace kiosk_vision {
+
+namespace {
+
+// BT.601 luma, scaled by 256.
+inline int Luma(const uint8_t* pixel, PixelFormat format) {
+  const int r = format == PixelFormat::kBgra ? pixel[2] : pixel[0];
+  const int b = format == PixelFormat::kBgra ? pixel[0] : pixel[2];
+  return r * 77 + pixel[1] * 150 + b * 29;
+}
+
+}  // namespace
+
+void MotionGate::Configure(const MotionGateConfig& config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MotionGateConfig clamped = config;
+  clamped.grid_width = std::max(4, std::min(config.grid_width, 256));
+  clamped.grid_height = std::max(4, std::min(config.grid_height, 256));
+  clamped.background_rate =
+      std::max(0.001, std::min(config.background_rate, 1.0));
+  clamped.keepalive_us = std::max<int64_t>(0, config.keepalive_us);
+  if (clamped.grid_width != config_.grid_width ||
+      clamped.grid_height != config_.grid_height ||
+      clamped.enabled != config_.enabled) {
+    background_.clear();
+  }
+  config_ = clamped;
+}
+
+MotionGateConfig MotionGate::config() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return config_;
+}
+
+bool MotionGate::enabled() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return config_.enabled;
+}
+
+void MotionGate::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  background_.clear();
+}
+
+MotionStats MotionGate::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void MotionGate::SampleLuma(const ImageView& frame) {
+  const int grid_width = config_.grid_width;
+  const int grid_height = config_.grid_height;
+  const int bytes_per_pixel = frame.format == PixelFormat::kRgb ? 3 : 4;
+  luma_.resize(static_cast<size_t>(grid_width) * grid_height);
+  // Average the pixels at the quarter points of each cell.
+  for (int gy = 0; gy < grid_height; ++gy) {
+    const int y0 = std::min(
+        static_cast<int>((static_cast<int64_t>(4 * gy + 1) * frame.height) /
+                         (4 * grid_height)),
+        frame.height - 1);
+    const int y1 = std::min(
+        static_cast<int>((static_cast<int64_t>(4 * gy + 3) * frame.height) /
+                         (4 * grid_height)),
+        frame.height - 1);
+    const uint8_t* row0 = frame.data + static_cast<size_t>(y0) * frame.stride;
+    const uint8_t* row1 = frame.data + static_cast<size_t>(y1) * frame.stride;
+    for (int gx = 0; gx < grid_width; ++gx) {
+      const int x0 = std::min(
+          static_cast<int>((static_cast<int64_t>(4 * gx + 1) * frame.width) /
+                           (4 * grid_width)),
+          frame.width - 1);
+      const int x1 = std::min(
+          static_cast<int>((static_cast<int64_t>(4 * gx + 3) * frame.width) /
+                           (4 * grid_width)),
+          frame.width - 1);
+      const int sum = Luma(row0 + x0 * bytes_per_pixel, frame.format) +
+                      Luma(row0 + x1 * bytes_per_pixel, frame.format) +
+                      Luma(row1 + x0 * bytes_per_pixel, frame.format) +
+                      Luma(row1 + x1 * bytes_per_pixel, frame.format);
+      luma_[gy * grid_width + gx] = sum * (1.0f / 1024.0f);
+    }
+  }
+}
+
+MotionDecision MotionGate::Evaluate(const ImageView& frame,
+                                    int64_t timestamp_us) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  MotionDecision decision;
+  if (!config_.enabled || frame.data == nullptr || frame.width <= 0 ||
+      frame.height <= 0) {
+    return decision;
+  }
+
+  SampleLuma(frame);
+  stats_.frames_evaluated++;
+
+  const bool first = background_.size() != luma_.size() ||
+                     frame.width != frame_width_ ||
+                     frame.height != frame_height_;
+  if (first) {
+    background_ = luma_;
+    frame_width_ = frame.width;
+    frame_height_ = frame.height;
+    decision.motion_score = 1.0;
+  } else {
+    const size_t cells = luma_.size();
+    double mean_difference = 0;
+    for (size_t i = 0; i < cells; ++i) {
+      mean_difference += luma_[i] - background_[i];
+    }
+    const float offset = static_cast<float>(mean_difference / cells);
+    const float threshold = static_cast<float>(config_.pixel_threshold);
+    const float rate = static_cast<float>(config_.background_rate);
+    const int grid_width = config_.grid_width;
+    const int grid_height = config_.grid_height;
+    int min_x = grid_width;
+    int min_y = grid_height;
+    int max_x = -1;
+    int max_y = -1;
+    size_t changed = 0;
+    for (size_t i = 0; i < cells; ++i) {
+      const float difference = luma_[i] - background_[i];
+      if (std::fabs(difference - offset) > threshold) {
+        changed++;
+        const int gx = static_cast<int>(i % grid_width);
+        const int gy = static_cast<int>(i / grid_width);
+        min_x = std::min(min_x, gx);
+        max_x = std::max(max_x, gx);
+        min_y = std::min(min_y, gy);
+        max_y = std::max(max_y, gy);
+      }
+      background_[i] += rate * difference;
+    }
+    decision.motion_score = static_cast<double>(changed) / cells;
+    if (changed > 0) {
+      decision.region_x1 = static_cast<float>(min_x) / grid_width;
+      decision.region_y1 = static_cast<float>(min_y) / grid_height;
+      decision.region_x2 = static_cast<float>(max_x + 1) / grid_width;
+      decision.region_y2 = static_cast<float>(max_y + 1) / grid_height;
+    }
+  }
+  stats_.last_score = decision.motion_score;
+
+  const bool motion =
+      first || decision.motion_score >= config_.motion_threshold;
+  // A clock going backwards means the frame source changed.
+  const bool keepalive_due =
+      timestamp_us < last_inference_us_ ||
+      timestamp_us - last_inference_us_ >= config_.keepalive_us;
+  decision.run_inference = motion || keepalive_due;
+  decision.keepalive = !motion && keepalive_due;
+  if (decision.run_inference) {
+    last_inference_us_ = timestamp_us;
+    if (decision.keepalive) {
+      stats_.keepalive_runs++;
+    } else {
+      stats_.frames_triggered++;
+    }
+  } else {
+    stats_.frames_skipped++;
+  }
+  return decision;
+}
+
+}  // namespace kiosk_vision
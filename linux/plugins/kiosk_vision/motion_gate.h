@@ -0,0 +1,100 @@
+#ifndef PLUGINS_KIOSK_VISION_MOTION_GATE_H_
+#define PLUGINS_KIOSK_VISION_MOTION_GATE_H_
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "frame_preprocessor.h"
+
+namespace kiosk_vision {
+
+struct MotionGateConfig {
+  bool enabled = false;
+  // Luma is compared on a grid of this many cells, each averaged from a
+  // few source pixels, so the cost is independent of the frame size.
+  int grid_width = 64;
+  int grid_height = 48;
+  // A cell counts as changed when it differs from the background by more
+  // than this many luma levels.
+  int pixel_threshold = 18;
+  // Fraction of changed cells that triggers inference.
+  double motion_threshold = 0.02;
+  // Weight of each new frame in the running-average background.
+  double background_rate = 0.05;
+  // Inference still runs at least this often on a static scene, so a
+  // person standing still is not forgotten.
+  int64_t keepalive_us = 10 * 1000000LL;
+};
+
+struct MotionDecision {
+  bool run_inference = true;
+  // True when inference runs only because the keep-alive was due.
+  bool keepalive = false;
+  // Fraction of changed cells in [0, 1].
+  double motion_score = 0;
+  // Bounding box of the changed cells in normalized frame coordinates;
+  // empty (x2 <= x1) when nothing changed or there is no background yet.
+  float region_x1 = 0;
+  float region_y1 = 0;
+  float region_x2 = 0;
+  float region_y2 = 0;
+};
+
+struct MotionStats {
+  uint64_t frames_evaluated = 0;
+  uint64_t frames_skipped = 0;
+  uint64_t frames_triggered = 0;  // Ran because of motion.
+  uint64_t keepalive_runs = 0;
+  double last_score = 0;
+};
+
+// Decides whether a frame is worth running through the detector.
+//
+// Each frame is reduced to a small luma grid and compared against a
+// running-average background. The mean difference is subtracted first so
+// that camera auto-exposure steps do not count as motion. Evaluate() is
+// called from the engine worker; configuration and stats may be accessed
+// from any thread.
+class MotionGate {
+ public:
+  MotionGate() = default;
+
+  // Disallow copy and assign.
+  MotionGate(const MotionGate&) = delete;
+  MotionGate& operator=(const MotionGate&) = delete;
+
+  // Resets the background when the grid changes.
+  void Configure(const MotionGateConfig& config);
+  MotionGateConfig config() const;
+  bool enabled() const;
+
+  // Updates the background with |frame| and decides whether to infer.
+  // Always runs inference while disabled, on the first frame and when the
+  // frame size changes.
+  MotionDecision Evaluate(const ImageView& frame, int64_t timestamp_us);
+
+  // Forgets the background so the next frame always runs inference.
+  void Reset();
+
+  MotionStats stats() const;
+
+ private:
+  void SampleLuma(const ImageView& frame);
+
+  mutable std::mutex mutex_;
+  MotionGateConfig config_;
+  MotionStats stats_;
+
+  // Worker-thread state, also guarded by |mutex_| so Configure() can reset
+  // it. The lock is uncontended apart from the odd stats read.
+  std::vector<float> background_;
+  std::vector<float> luma_;
+  int frame_width_ = 0;
+  int frame_height_ = 0;
+  int64_t last_inference_us_ = 0;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_MOTION_GATE_H_
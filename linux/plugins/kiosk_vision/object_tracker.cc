@@ -0,0 +1,210 @@
+#include "object_tracker.h"
+
+#include <algorithm>
+
+namespace kiosk_vision {
+
+namespace {
+
+// Frames further apart than this are treated as this far apart, so a long
+// pause does not fling coasting tracks across the frame.
+const float kMaxDeltaSeconds = 5.0f;
+// Initial velocity variance, (frame widths per second)^2.
+const float kInitialVelocityVariance = 1.0f;
+const float kMinBoxSize = 1e-3f;
+
+}  // namespace
+
+void ObjectTracker::Configure(const TrackerConfig& config) {
+  config_ = config;
+  config_.min_hits = std::max(1, config.min_hits);
+  config_.max_misses = std::max(1, config.max_misses);
+  if (!config_.enabled) {
+    Reset();
+  }
+}
+
+void ObjectTracker::Reset() {
+  states_.clear();
+  last_timestamp_us_ = 0;
+}
+
+void ObjectTracker::InitState(State* state, const Detection& detection) const {
+  const float measurement[4] = {
+      (detection.x1 + detection.x2) * 0.5f,
+      (detection.y1 + detection.y2) * 0.5f,
+      detection.x2 - detection.x1,
+      detection.y2 - detection.y1,
+  };
+  const float r = config_.measurement_noise * config_.measurement_noise;
+  for (int i = 0; i < 4; ++i) {
+    Axis& axis = state->axes[i];
+    axis.position = measurement[i];
+    axis.velocity = 0;
+    axis.p00 = r;
+    axis.p01 = 0;
+    axis.p11 = kInitialVelocityVariance;
+  }
+  state->track.class_id = detection.class_id;
+  state->track.score = detection.score;
+  StateToBox(state);
+}
+
+void ObjectTracker::Predict(State* state, float dt) const {
+  if (dt <= 0) {
+    return;
+  }
+  const float q = config_.process_noise * config_.process_noise;
+  const float dt2 = dt * dt;
+  for (Axis& axis : state->axes) {
+    axis.position += axis.velocity * dt;
+    // P = F P F' + Q for F = [1 dt; 0 1] and white-noise acceleration.
+    axis.p00 += 2 * dt * axis.p01 + dt2 * axis.p11 + q * dt2 * dt2 * 0.25f;
+    axis.p01 += dt * axis.p11 + q * dt2 * dt * 0.5f;
+    axis.p11 += q * dt2;
+  }
+  for (int i = 2; i < 4; ++i) {
+    state->axes[i].position = std::max(kMinBoxSize, state->axes[i].position);
+  }
+}
+
+void ObjectTracker::Correct(State* state, const Detection& detection) const {
+  const float measurement[4] = {
+      (detection.x1 + detection.x2) * 0.5f,
+      (detection.y1 + detection.y2) * 0.5f,
+      detection.x2 - detection.x1,
+      detection.y2 - detection.y1,
+  };
+  const float r = config_.measurement_noise * config_.measurement_noise;
+  for (int i = 0; i < 4; ++i) {
+    Axis& axis = state->axes[i];
+    const float innovation = measurement[i] - axis.position;
+    const float s = axis.p00 + r;
+    const float k0 = axis.p00 / s;
+    const float k1 = axis.p01 / s;
+    axis.position += k0 * innovation;
+    axis.velocity += k1 * innovation;
+    axis.p11 -= k1 * axis.p01;
+    axis.p01 *= 1 - k0;
+    axis.p00 *= 1 - k0;
+  }
+  state->track.score = detection.score;
+  StateToBox(state);
+}
+
+void ObjectTracker::StateToBox(State* state) {
+  const float cx = state->axes[0].position;
+  const float cy = state->axes[1].position;
+  const float half_width =
+      std::max(kMinBoxSize, state->axes[2].position) * 0.5f;
+  const float half_height =
+      std::max(kMinBoxSize, state->axes[3].position) * 0.5f;
+  state->track.x1 = cx - half_width;
+  state->track.y1 = cy - half_height;
+  state->track.x2 = cx + half_width;
+  state->track.y2 = cy + half_height;
+}
+
+void ObjectTracker::Update(const std::vector<Detection>& detections,
+                           int64_t timestamp_us) {
+  if (!config_.enabled) {
+    return;
+  }
+
+  float dt = 0;
+  if (last_timestamp_us_ != 0 && timestamp_us > last_timestamp_us_) {
+    dt = std::min(kMaxDeltaSeconds,
+                  (timestamp_us - last_timestamp_us_) / 1e6f);
+  }
+  last_timestamp_us_ = timestamp_us;
+  for (State& state : states_) {
+    Predict(&state, dt);
+    StateToBox(&state);
+  }
+
+  // Greedy association, best overlap first. With a few objects in view
+  // this matches the Hungarian assignment in all but contrived cases.
+  Detection predicted;
+  candidates_.clear();
+  for (size_t s = 0; s < states_.size(); ++s) {
+    const Track& track = states_[s].track;
+    predicted.x1 = track.x1;
+    predicted.y1 = track.y1;
+    predicted.x2 = track.x2;
+    predicted.y2 = track.y2;
+    for (size_t d = 0; d < detections.size(); ++d) {
+      if (detections[d].class_id != track.class_id) {
+        continue;
+      }
+      const float iou = BoxIou(predicted, detections[d]);
+      if (iou >= config_.match_iou) {
+        candidates_.push_back(
+            {iou, static_cast<int>(s), static_cast<int>(d)});
+      }
+    }
+  }
+  std::sort(candidates_.begin(), candidates_.end(),
+            [](const Candidate& a, const Candidate& b) {
+              return a.iou > b.iou;
+            });
+
+  state_matched_.assign(states_.size(), false);
+  detection_matched_.assign(detections.size(), false);
+  for (const Candidate& candidate : candidates_) {
+    if (state_matched_[candidate.state] ||
+        detection_matched_[candidate.detection]) {
+      continue;
+    }
+    state_matched_[candidate.state] = true;
+    detection_matched_[candidate.detection] = true;
+    State& state = states_[candidate.state];
+    Correct(&state, detections[candidate.detection]);
+    state.track.hits++;
+    state.track.misses = 0;
+    if (state.track.hits >= config_.min_hits) {
+      state.track.confirmed = true;
+    }
+  }
+
+  // Unconfirmed tracks die on their first miss, confirmed ones coast.
+  size_t kept = 0;
+  for (size_t s = 0; s < states_.size(); ++s) {
+    State& state = states_[s];
+    if (!state_matched_[s]) {
+      state.track.hits = 0;
+      state.track.misses++;
+      if (!state.track.confirmed ||
+          state.track.misses >= config_.max_misses) {
+        continue;
+      }
+    }
+    if (kept != s) {
+      states_[kept] = state;
+    }
+    kept++;
+  }
+  states_.resize(kept);
+
+  for (size_t d = 0; d < detections.size(); ++d) {
+    if (detection_matched_[d]) {
+      continue;
+    }
+    State state;
+    InitState(&state, detections[d]);
+    state.track.id = next_id_++;
+    state.track.hits = 1;
+    state.track.confirmed = config_.min_hits <= 1;
+    states_.push_back(state);
+  }
+}
+
+void ObjectTracker::ConfirmedTracks(std::vector<Track>* tracks) const {
+  tracks->clear();
+  for (const State& state : states_) {
+    if (state.track.confirmed) {
+      tracks->push_back(state.track);
+    }
+  }
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,100 @@
+#ifndef PLUGINS_KIOSK_VISION_OBJECT_TRACKER_H_
+#define PLUGINS_KIOSK_VISION_OBJECT_TRACKER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "detection_postprocess.h"
+
+namespace kiosk_vision {
+
+struct TrackerConfig {
+  bool enabled = true;
+  // Minimum IoU between a predicted track box and a detection to match.
+  float match_iou = 0.3f;
+  // Hysteresis: a track is reported after |min_hits| consecutive matches
+  // and dropped after |max_misses| consecutive frames without one.
+  int min_hits = 2;
+  int max_misses = 3;
+  // Kalman noise, in normalized frame units: acceleration (per s^2) and
+  // measured box edge jitter.
+  float process_noise = 0.3f;
+  float measurement_noise = 0.02f;
+};
+
+// One tracked object. The box is the filtered estimate, not the raw
+// detection.
+struct Track {
+  uint32_t id = 0;  // Stable for the life of the track, starts at 1.
+  int class_id = 0;
+  float x1 = 0;
+  float y1 = 0;
+  float x2 = 0;
+  float y2 = 0;
+  float score = 0;  // Score of the last matched detection.
+  int hits = 0;     // Consecutive matched frames.
+  int misses = 0;   // Consecutive frames without a match.
+  bool confirmed = false;
+};
+
+// SORT-style multi-object tracker: a constant-velocity Kalman filter per
+// track, greedy IoU association against the predicted boxes within a class,
+// and hit/miss hysteresis so a detection flickering for one frame neither
+// creates nor drops an object. Not thread-safe; owned by the engine worker.
+class ObjectTracker {
+ public:
+  ObjectTracker() = default;
+
+  void Configure(const TrackerConfig& config);
+  const TrackerConfig& config() const { return config_; }
+
+  // Advances all tracks to |timestamp_us| and associates |detections|.
+  void Update(const std::vector<Detection>& detections,
+              int64_t timestamp_us);
+
+  // Confirmed tracks, including ones coasting through a few misses.
+  void ConfirmedTracks(std::vector<Track>* tracks) const;
+
+  void Reset();
+
+ private:
+  // Position and velocity of one box coordinate (center x/y, width,
+  // height) with its 2x2 covariance. The axes are independent under this
+  // model, so four tiny filters replace one 8x8 filter.
+  struct Axis {
+    float position = 0;
+    float velocity = 0;
+    float p00 = 0;
+    float p01 = 0;
+    float p11 = 0;
+  };
+
+  struct State {
+    Track track;
+    Axis axes[4];  // cx, cy, w, h
+  };
+
+  void Predict(State* state, float dt) const;
+  void Correct(State* state, const Detection& detection) const;
+  void InitState(State* state, const Detection& detection) const;
+  static void StateToBox(State* state);
+
+  TrackerConfig config_;
+  std::vector<State> states_;
+  uint32_t next_id_ = 1;
+  int64_t last_timestamp_us_ = 0;
+
+  // Scratch, reused between frames.
+  struct Candidate {
+    float iou;
+    int state;
+    int detection;
+  };
+  std::vector<Candidate> candidates_;
+  std::vector<bool> state_matched_;
+  std::vector<bool> detection_matched_;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_OBJECT_TRACKER_H_
@@ -0,0 +1,377 @@
+#include "preview_renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace kiosk_vision {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Boxes not refreshed for this long are dropped, so a stopped detector
+// does not leave stale boxes over a live picture.
+const int64_t kOverlayTtlUs = 3 * 1000000LL;
+
+const int kGlyphWidth = 5;
+const int kGlyphHeight = 7;
+
+struct Glyph {
+  char c;
+  uint8_t rows[kGlyphHeight];  // Bit 4 is the leftmost column.
+};
+
+// 5x7 glyphs for the characters labels use. Lowercase is drawn as
+// uppercase; anything else as a space.
+const Glyph kGlyphs[] = {
+    {'0', {0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E}},
+    {'1', {0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'2', {0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F}},
+    {'3', {0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E}},
+    {'4', {0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02}},
+    {'5', {0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E}},
+    {'6', {0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E}},
+    {'7', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E}},
+    {'9', {0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C}},
+    {'A', {0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'B', {0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E}},
+    {'C', {0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E}},
+    {'D', {0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C}},
+    {'E', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F}},
+    {'F', {0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10}},
+    {'G', {0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F}},
+    {'H', {0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11}},
+    {'I', {0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E}},
+    {'J', {0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C}},
+    {'K', {0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11}},
+    {'L', {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F}},
+    {'M', {0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11}},
+    {'N', {0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11}},
+    {'O', {0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'P', {0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10}},
+    {'Q', {0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D}},
+    {'R', {0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11}},
+    {'S', {0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E}},
+    {'T', {0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04}},
+    {'U', {0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E}},
+    {'V', {0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04}},
+    {'W', {0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A}},
+    {'X', {0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11}},
+    {'Y', {0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04}},
+    {'Z', {0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F}},
+    {'#', {0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A}},
+    {'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C}},
+    {':', {0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00}},
+    {'-', {0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00}},
+};
+
+const uint8_t* GlyphRows(char c) {
+  if (c >= 'a' && c <= 'z') {
+    c = static_cast<char>(c - 'a' + 'A');
+  }
+  for (const Glyph& glyph : kGlyphs) {
+    if (glyph.c == c) {
+      return glyph.rows;
+    }
+  }
+  return nullptr;
+}
+
+struct Color {
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+};
+
+// Green for people (COCO class 0), then a fixed palette by class id.
+Color ClassColor(int class_id) {
+  static const Color kPalette[] = {
+      {0, 230, 64},   {255, 170, 0}, {0, 170, 255}, {255, 64, 160},
+      {160, 96, 255}, {255, 230, 0}, {0, 230, 200}, {255, 96, 64},
+  };
+  const int count = static_cast<int>(sizeof(kPalette) / sizeof(kPalette[0]));
+  return kPalette[((class_id % count) + count) % count];
+}
+
+void FillRect(uint8_t* pixels, int width, int height, int x1, int y1, int x2,
+              int y2, Color color) {
+  x1 = std::max(0, x1);
+  y1 = std::max(0, y1);
+  x2 = std::min(width, x2);
+  y2 = std::min(height, y2);
+  for (int y = y1; y < y2; ++y) {
+    uint8_t* row = pixels + (static_cast<size_t>(y) * width + x1) * 4;
+    for (int x = x1; x < x2; ++x) {
+      row[0] = color.r;
+      row[1] = color.g;
+      row[2] = color.b;
+      row[3] = 255;
+      row += 4;
+    }
+  }
+}
+
+void DrawText(uint8_t* pixels, int width, int height, int x, int y,
+              int scale, const std::string& text, Color color) {
+  for (char c : text) {
+    const uint8_t* rows = GlyphRows(c);
+    if (rows != nullptr) {
+      for (int row = 0; row < kGlyphHeight; ++row) {
+        for (int column = 0; column < kGlyphWidth; ++column) {
+          if (rows[row] & (0x10 >> column)) {
+            const int px = x + column * scale;
+            const int py = y + row * scale;
+            FillRect(pixels, width, height, px, py, px + scale, py + scale,
+                     color);
+          }
+        }
+      }
+    }
+    x += (kGlyphWidth + 1) * scale;
+  }
+}
+
+std::string ClassLabel(const std::vector<std::string>& labels, int class_id) {
+  if (class_id >= 0 && class_id < static_cast<int>(labels.size()) &&
+      !labels[class_id].empty()) {
+    return labels[class_id];
+  }
+  return "#" + std::to_string(class_id);
+}
+
+int64_t NowUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+void PreviewRenderer::Configure(const PreviewConfig& config) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  config_ = config;
+  config_.max_width = std::max(0, config.max_width);
+  config_.max_fps = std::max(0.0, config.max_fps);
+}
+
+PreviewConfig PreviewRenderer::config() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return config_;
+}
+
+void PreviewRenderer::SetOverlay(const std::vector<Detection>& detections,
+                                 const std::vector<Track>& tracks,
+                                 bool tracking, const CropRect& area,
+                                 int frame_width, int frame_height) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  overlay_.clear();
+  if (frame_width <= 0 || frame_height <= 0) {
+    return;
+  }
+  // Boxes are kept in units of the frame size so they still line up when
+  // the preview is scaled differently from the frame that was detected.
+  const float sx = 1.0f / frame_width;
+  const float sy = 1.0f / frame_height;
+  const auto add = [&](float x1, float y1, float x2, float y2, int class_id,
+                       const std::string& label) {
+    OverlayBox box;
+    box.x1 = (area.x + x1 * area.width) * sx;
+    box.y1 = (area.y + y1 * area.height) * sy;
+    box.x2 = (area.x + x2 * area.width) * sx;
+    box.y2 = (area.y + y2 * area.height) * sy;
+    box.class_id = class_id;
+    box.label = label;
+    overlay_.push_back(box);
+  };
+  char score[8];
+  if (tracking) {
+    for (const Track& track : tracks) {
+      snprintf(score, sizeof(score), " %d%%",
+               static_cast<int>(std::lround(track.score * 100)));
+      add(track.x1, track.y1, track.x2, track.y2, track.class_id,
+          "#" + std::to_string(track.id) + " " +
+              ClassLabel(config_.labels, track.class_id) + score);
+    }
+  } else {
+    for (const Detection& detection : detections) {
+      snprintf(score, sizeof(score), " %d%%",
+               static_cast<int>(std::lround(detection.score * 100)));
+      add(detection.x1, detection.y1, detection.x2, detection.y2,
+          detection.class_id,
+          ClassLabel(config_.labels, detection.class_id) + score);
+    }
+  }
+  overlay_at_us_ = NowUs();
+}
+
+void PreviewRenderer::ClearOverlay() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  overlay_.clear();
+}
+
+bool PreviewRenderer::Render(const ImageView& frame, int64_t timestamp_us) {
+  if (frame.data == nullptr || frame.width <= 0 || frame.height <= 0) {
+    return false;
+  }
+  const Clock::time_point start = Clock::now();
+  bool overlay = false;
+  int max_width = 0;
+  Buffer* buffer = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A source switch may restart the clock; render then as well.
+    if (config_.max_fps > 0 && last_render_us_ != 0 &&
+        timestamp_us >= last_render_us_ &&
+        timestamp_us - last_render_us_ <
+            static_cast<int64_t>(1000000.0 / config_.max_fps)) {
+      ++stats_.frames_skipped;
+      return false;
+    }
+    overlay = config_.overlay && !overlay_.empty() &&
+              NowUs() - overlay_at_us_ < kOverlayTtlUs;
+    if (overlay) {
+      overlay_copy_ = overlay_;
+    }
+    max_width = config_.max_width;
+    buffer = &buffers_[back_];
+  }
+  last_render_us_ = timestamp_us;
+
+  int width = frame.width;
+  int height = frame.height;
+  if (max_width > 0 && width > max_width) {
+    height = std::max(1, static_cast<int>(std::lround(
+                             static_cast<double>(height) * max_width /
+                             width)));
+    width = max_width;
+  }
+  buffer->width = width;
+  buffer->height = height;
+  buffer->pixels.resize(static_cast<size_t>(width) * height * 4);
+  Scale(frame, buffer);
+  if (overlay) {
+    DrawOverlay(overlay_copy_, buffer);
+  }
+
+  const double elapsed =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::swap(back_, ready_);
+  fresh_ = true;
+  has_frame_ = true;
+  ++stats_.frames_rendered;
+  stats_.width = width;
+  stats_.height = height;
+  stats_.render_ms = elapsed;
+  return true;
+}
+
+bool PreviewRenderer::Acquire(const uint8_t** pixels, int* width,
+                              int* height) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!has_frame_) {
+    return false;
+  }
+  if (fresh_) {
+    std::swap(front_, ready_);
+    fresh_ = false;
+  }
+  const Buffer& buffer = buffers_[front_];
+  *pixels = buffer.pixels.data();
+  *width = buffer.width;
+  *height = buffer.height;
+  return true;
+}
+
+PreviewStats PreviewRenderer::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void PreviewRenderer::Scale(const ImageView& frame, Buffer* buffer) {
+  const int width = buffer->width;
+  const int height = buffer->height;
+  const int bytes_per_pixel = frame.format == PixelFormat::kRgb ? 3 : 4;
+  if (plan_source_width_ != frame.width || plan_width_ != width ||
+      plan_format_ != frame.format) {
+    plan_source_width_ = frame.width;
+    plan_width_ = width;
+    plan_format_ = frame.format;
+    x_offsets_.resize(width);
+    for (int x = 0; x < width; ++x) {
+      const int source_x = std::min(
+          frame.width - 1,
+          static_cast<int>((static_cast<int64_t>(2 * x + 1) * frame.width) /
+                           (2 * width)));
+      x_offsets_[x] = source_x * bytes_per_pixel;
+    }
+  }
+
+  const bool bgra = frame.format == PixelFormat::kBgra;
+  for (int y = 0; y < height; ++y) {
+    const int source_y = std::min(
+        frame.height - 1,
+        static_cast<int>((static_cast<int64_t>(2 * y + 1) * frame.height) /
+                         (2 * height)));
+    const uint8_t* source =
+        frame.data + static_cast<size_t>(source_y) * frame.stride;
+    uint8_t* out = buffer->pixels.data() + static_cast<size_t>(y) * width * 4;
+    if (width == frame.width && frame.format == PixelFormat::kRgba) {
+      memcpy(out, source, static_cast<size_t>(width) * 4);
+      continue;
+    }
+    for (int x = 0; x < width; ++x) {
+      const uint8_t* pixel = source + x_offsets_[x];
+      out[0] = bgra ? pixel[2] : pixel[0];
+      out[1] = pixel[1];
+      out[2] = bgra ? pixel[0] : pixel[2];
+      out[3] = 255;
+      out += 4;
+    }
+  }
+}
+
+void PreviewRenderer::DrawOverlay(const std::vector<OverlayBox>& boxes,
+                                  Buffer* buffer) const {
+  const int width = buffer->width;
+  const int height = buffer->height;
+  uint8_t* pixels = buffer->pixels.data();
+  const int line = std::max(2, width / 320);
+  const int scale = std::max(1, width / 400);
+  const int text_height = kGlyphHeight * scale;
+  const Color kText = {0, 0, 0};
+
+  for (const OverlayBox& box : boxes) {
+    const int x1 = static_cast<int>(std::lround(box.x1 * width));
+    const int y1 = static_cast<int>(std::lround(box.y1 * height));
+    const int x2 = static_cast<int>(std::lround(box.x2 * width));
+    const int y2 = static_cast<int>(std::lround(box.y2 * height));
+    if (x2 <= x1 || y2 <= y1) {
+      continue;
+    }
+    const Color color = ClassColor(box.class_id);
+    FillRect(pixels, width, height, x1, y1, x2, y1 + line, color);
+    FillRect(pixels, width, height, x1, y2 - line, x2, y2, color);
+    FillRect(pixels, width, height, x1, y1, x1 + line, y2, color);
+    FillRect(pixels, width, height, x2 - line, y1, x2, y2, color);
+
+    // Label strip above the box, or inside it at the top edge.
+    const int strip = text_height + 2 * scale;
+    const int text_width =
+        static_cast<int>(box.label.size()) * (kGlyphWidth + 1) * scale +
+        scale;
+    const int label_y = y1 - strip >= 0 ? y1 - strip : y1;
+    const int label_x = std::max(0, std::min(x1, width - text_width));
+    FillRect(pixels, width, height, label_x, label_y, label_x + text_width,
+             label_y + strip, color);
+    DrawText(pixels, width, height, label_x + scale, label_y + scale, scale,
+             box.label, kText);
+  }
+}
+
+}  // namespace kiosk_vision
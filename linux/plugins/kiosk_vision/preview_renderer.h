@@ -0,0 +1,120 @@
+#ifndef PLUGINS_KIOSK_VISION_PREVIEW_RENDERER_H_
+#define PLUGINS_KIOSK_VISION_PREVIEW_RENDERER_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "detection_postprocess.h"
+#include "frame_preprocessor.h"
+#include "object_tracker.h"
+
+namespace kiosk_vision {
+
+struct PreviewConfig {
+  // Frames wider than this are point-sampled down to it; 0 keeps the
+  // source width.
+  int max_width = 640;
+  // Frames arriving faster than this are not rendered; 0 renders all.
+  double max_fps = 15;
+  // Draw the latest detections (or tracks) and their labels.
+  bool overlay = true;
+  // Label per class id; ids past the end are drawn as "#<id>".
+  std::vector<std::string> labels;
+};
+
+struct PreviewStats {
+  int width = 0;
+  int height = 0;
+  uint64_t frames_rendered = 0;
+  uint64_t frames_skipped = 0;  // Over |max_fps|.
+  double render_ms = 0;         // Last frame, overlay included.
+};
+
+// Renders ring frames into RGBA buffers for a Flutter pixel buffer texture,
+// with the detector's boxes and labels drawn in, so a live preview needs no
+// PNG encoding, base64 string or Dart image decode.
+//
+// Render() runs on the frame producer and Acquire() on whichever thread
+// Flutter copies texture pixels on. Three buffers rotate between them: the
+// producer fills the back buffer and swaps it with the ready one, and the
+// reader swaps the ready one into the front buffer it keeps until its next
+// call. Only the index swaps take the lock, never the pixel work.
+class PreviewRenderer {
+ public:
+  PreviewRenderer() = default;
+
+  // Disallow copy and assign.
+  PreviewRenderer(const PreviewRenderer&) = delete;
+  PreviewRenderer& operator=(const PreviewRenderer&) = delete;
+
+  void Configure(const PreviewConfig& config);
+  PreviewConfig config() const;
+
+  // Replaces the overlay with |detections| (or |tracks| when |tracking|),
+  // normalized to |area| of a |frame_width| x |frame_height| frame as the
+  // engine reports them. Any thread.
+  void SetOverlay(const std::vector<Detection>& detections,
+                  const std::vector<Track>& tracks, bool tracking,
+                  const CropRect& area, int frame_width, int frame_height);
+  void ClearOverlay();
+
+  // Producer thread. Returns true when a new frame became ready.
+  bool Render(const ImageView& frame, int64_t timestamp_us);
+
+  // Reader thread. Returns the newest complete frame, or the previous one
+  // when nothing new arrived; false before the first frame. |pixels| stays
+  // valid until the next call.
+  bool Acquire(const uint8_t** pixels, int* width, int* height);
+
+  PreviewStats stats() const;
+
+ private:
+  struct Buffer {
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+  };
+
+  // One box in source frame pixels, ready to draw.
+  struct OverlayBox {
+    float x1 = 0;
+    float y1 = 0;
+    float x2 = 0;
+    float y2 = 0;
+    int class_id = 0;
+    std::string label;
+  };
+
+  void Scale(const ImageView& frame, Buffer* buffer);
+  // Box coordinates are normalized, and |buffer| keeps the frame's aspect
+  // ratio, so they map straight to buffer pixels.
+  void DrawOverlay(const std::vector<OverlayBox>& boxes,
+                   Buffer* buffer) const;
+
+  mutable std::mutex mutex_;
+  PreviewConfig config_;
+  PreviewStats stats_;
+  std::vector<OverlayBox> overlay_;
+  int64_t overlay_at_us_ = 0;
+  Buffer buffers_[3];
+  int back_ = 0;
+  int ready_ = 1;
+  int front_ = 2;
+  bool fresh_ = false;
+  bool has_frame_ = false;
+
+  // Producer-only state.
+  int64_t last_render_us_ = 0;
+  std::vector<OverlayBox> overlay_copy_;
+  // Source byte offset of each output column, cached per size and format.
+  std::vector<int> x_offsets_;
+  int plan_source_width_ = 0;
+  int plan_width_ = 0;
+  PixelFormat plan_format_ = PixelFormat::kRgba;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_PREVIEW_RENDERER_H_
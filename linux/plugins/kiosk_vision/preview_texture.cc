@@ -0,0 +1,53 @@
+#include "preview_texture.h"
+
+struct _KioskPreviewTexture {
+  FlPixelBufferTexture parent_instance;
+
+  kiosk_vision::PreviewRenderer* renderer;
+};
+
+G_DEFINE_TYPE(KioskPreviewTexture, kiosk_preview_texture,
+              fl_pixel_buffer_texture_get_type())
+
+static gboolean kiosk_preview_texture_copy_pixels(
+    FlPixelBufferTexture* texture, const uint8_t** buffer, uint32_t* width,
+    uint32_t* height, GError** error) {
+  KioskPreviewTexture* self = KIOSK_PREVIEW_TEXTURE(texture);
+  int frame_width = 0;
+  int frame_height = 0;
+  if (!self->renderer->Acquire(buffer, &frame_width, &frame_height)) {
+    g_set_error(error, g_quark_from_static_string("kiosk_vision"), 0,
+                "No preview frame yet");
+    return FALSE;
+  }
+  *width = static_cast<uint32_t>(frame_width);
+  *height = static_cast<uint32_t>(frame_height);
+  return TRUE;
+}
+
+static void kiosk_preview_texture_finalize(GObject* object) {
+  KioskPreviewTexture* self = KIOSK_PREVIEW_TEXTURE(object);
+  delete self->renderer;
+  self->renderer = nullptr;
+  G_OBJECT_CLASS(kiosk_preview_texture_parent_class)->finalize(object);
+}
+
+static void kiosk_preview_texture_class_init(KioskPreviewTextureClass* klass) {
+  G_OBJECT_CLASS(klass)->finalize = kiosk_preview_texture_finalize;
+  FL_PIXEL_BUFFER_TEXTURE_CLASS(klass)->copy_pixels =
+      kiosk_preview_texture_copy_pixels;
+}
+
+static void kiosk_preview_texture_init(KioskPreviewTexture* self) {
+  self->renderer = new kiosk_vision::PreviewRenderer();
+}
+
+KioskPreviewTexture* kiosk_preview_texture_new() {
+  return KIOSK_PREVIEW_TEXTURE(
+      g_object_new(kiosk_preview_texture_get_type(), nullptr));
+}
+
+kiosk_vision::PreviewRenderer* kiosk_preview_texture_get_renderer(
+    KioskPreviewTexture* texture) {
+  return texture->renderer;
+}
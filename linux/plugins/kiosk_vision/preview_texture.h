@@ -0,0 +1,21 @@
+#ifndef PLUGINS_KIOSK_VISION_PREVIEW_TEXTURE_H_
+#define PLUGINS_KIOSK_VISION_PREVIEW_TEXTURE_H_
+
+#include <flutter_linux/flutter_linux.h>
+
+#include "preview_renderer.h"
+
+G_DECLARE_FINAL_TYPE(KioskPreviewTexture, kiosk_preview_texture, KIOSK,
+                     PREVIEW_TEXTURE, FlPixelBufferTexture)
+
+// Pixel buffer texture that hands Flutter the newest frame of its own
+// PreviewRenderer. Flutter copies the pixels on its raster thread after
+// fl_texture_registrar_mark_texture_frame_available(); frames rendered in
+// between replace each other, so a slow compositor never queues them.
+KioskPreviewTexture* kiosk_preview_texture_new();
+
+// Owned by |texture|, valid until it is finalized.
+kiosk_vision::PreviewRenderer* kiosk_preview_texture_get_renderer(
+    KioskPreviewTexture* texture);
+
+#endif  // PLUGINS_KIOSK_VISION_PREVIEW_TEXTURE_H_
@@ -0,0 +1,501 @@
+#include "stream_capture.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+}
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace kiosk_vision {
+
+namespace {
+
+// About two seconds of a 30 fps stream. Past that decoding is behind and
+// the queue is dropped up to the next keyframe.
+const size_t kMaxQueuedPackets = 64;
+
+int64_t MonotonicMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string AvErrorMessage(const char* what, int code) {
+  char buffer[AV_ERROR_MAX_STRING_SIZE] = {};
+  av_strerror(code, buffer, sizeof(buffer));
+  return std::string(what) + ": " + buffer;
+}
+
+bool IsFileUrl(const std::string& url) {
+  return url.find("://") == std::string::npos ||
+         url.compare(0, 7, "file://") == 0;
+}
+
+}  // namespace
+
+StreamCapture::StreamCapture(FrameRing* ring, DecodePool* pool)
+    : ring_(ring), pool_(pool) {}
+
+StreamCapture::~StreamCapture() {
+  Stop();
+}
+
+bool StreamCapture::Start(const StreamConfig& config, std::string* error) {
+  Stop();
+  if (config.url.empty()) {
+    *error = "No stream URL";
+    return false;
+  }
+  config_ = config;
+  SetPublishing(config.publish_fps, config.publish_width,
+                config.publish_height);
+  idle_ = config.idle;
+  last_publish_us_ = 0;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_ = StreamStats();
+    stats_.capture.device = config.url;
+    stats_.capture.convert_kernel = "swscale";
+  }
+  running_ = true;
+  thread_ = std::thread(&StreamCapture::DemuxLoop, this);
+  return true;
+}
+
+void StreamCapture::Stop() {
+  if (!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(wait_mutex_);
+    running_ = false;
+  }
+  wait_.notify_all();
+  thread_.join();
+}
+
+void StreamCapture::SetPublishing(double publish_fps, int publish_width,
+                                  int publish_height) {
+  publish_interval_us_ =
+      publish_fps > 0 ? static_cast<int64_t>(1000000.0 / publish_fps) : 0;
+  const uint32_t width = static_cast<uint32_t>(
+      std::max(0, std::min(publish_width, 0xFFFF)));
+  const uint32_t height = static_cast<uint32_t>(
+      std::max(0, std::min(publish_height, 0xFFFF)));
+  publish_size_ = width > 0 && height > 0 ? (width << 16) | height : 0;
+}
+
+void StreamCapture::SetIdle(bool idle) {
+  idle_ = idle;
+}
+
+StreamStats StreamCapture::stats() const {
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  StreamStats stats = stats_;
+  stats.capture.running = running_.load();
+  stats.keyframes_only = idle_.load();
+  const uint32_t packed = publish_size_.load();
+  if (packed != 0 && stats.capture.width > 0) {
+    stats.capture.publish_width =
+        std::min(static_cast<int>(packed >> 16), stats.capture.width);
+    stats.capture.publish_height =
+        std::min(static_cast<int>(packed & 0xFFFF), stats.capture.height);
+  } else {
+    stats.capture.publish_width = stats.capture.width;
+    stats.capture.publish_height = stats.capture.height;
+  }
+  return stats;
+}
+
+bool StreamCapture::WaitFor(int64_t micros) {
+  std::unique_lock<std::mutex> lock(wait_mutex_);
+  wait_.wait_for(lock, std::chrono::microseconds(micros),
+                 [this]() { return !running_.load(); });
+  return running_.load();
+}
+
+int StreamCapture::InterruptCallback(void* opaque) {
+  StreamCapture* self = static_cast<StreamCapture*>(opaque);
+  return !self->running_.load() ||
+         MonotonicMicros() > self->io_deadline_us_.load();
+}
+
+void StreamCapture::DemuxLoop() {
+  static std::once_flag network_init;
+  std::call_once(network_init, []() { avformat_network_init(); });
+
+  int failures = 0;
+  bool first_attempt = true;
+  while (running_) {
+    if (!first_attempt) {
+      std::lock_guard<std::mutex> lock(stats_mutex_);
+      stats_.reconnects++;
+    }
+    first_attempt = false;
+    std::string error;
+    if (!Open(&error)) {
+      Close();
+      {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.last_error = error;
+      }
+      const int64_t delay_ms = std::min<int64_t>(
+          config_.reconnect_max_ms,
+          static_cast<int64_t>(config_.reconnect_min_ms)
+              << std::min(failures, 16));
+      failures++;
+      WaitFor(delay_ms * 1000);
+      continue;
+    }
+
+    AVPacket* packet = av_packet_alloc();
+    bool was_idle = idle_.load();
+    while (running_) {
+      io_deadline_us_ = MonotonicMicros() + config_.timeout_ms * 1000LL;
+      const int result = av_read_frame(format_, packet);
+      if (result == AVERROR_EOF && is_file_) {
+        // Loop the file; the decoder restarts at the first keyframe.
+        av_seek_frame(format_, stream_index_, 0, AVSEEK_FLAG_BACKWARD);
+        pace_origin_us_ = 0;
+        waiting_for_keyframe_ = true;
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        for (AVPacket* stale : queue_) {
+          av_packet_free(&stale);
+        }
+        queue_.clear();
+        flush_decoder_ = true;
+        continue;
+      }
+      if (result < 0) {
+        if (running_) {
+          std::lock_guard<std::mutex> lock(stats_mutex_);
+          stats_.last_error = result == AVERROR_EXIT
+                                  ? "Stream stalled"
+                                  : AvErrorMessage("av_read_frame", result);
+        }
+        break;
+      }
+      if (packet->stream_index != stream_index_) {
+        av_packet_unref(packet);
+        continue;
+      }
+      failures = 0;
+      if (is_file_ && !PaceFile(packet)) {
+        av_packet_unref(packet);
+        break;
+      }
+
+      // Leaving idle: the frames since the last keyframe were never
+      // decoded, so later ones cannot be either until the next keyframe.
+      const bool idle = idle_.load();
+      if (was_idle && !idle) {
+        waiting_for_keyframe_ = true;
+      }
+      was_idle = idle;
+
+      const bool wanted = WantPacket(packet);
+      {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.capture.frames_captured++;
+        stats_.packets_skipped += wanted ? 0 : 1;
+      }
+      if (!wanted) {
+        av_packet_unref(packet);
+        continue;
+      }
+      AVPacket* queued = av_packet_alloc();
+      av_packet_move_ref(queued, packet);
+      Enqueue(queued);
+    }
+    av_packet_free(&packet);
+    Close();
+    if (running_) {
+      WaitFor(config_.reconnect_min_ms * 1000LL);
+    }
+  }
+}
+
+bool StreamCapture::Open(std::string* error) {
+  is_file_ = IsFileUrl(config_.url);
+  const std::string url = config_.url.compare(0, 7, "file://") == 0
+                              ? config_.url.substr(7)
+                              : config_.url;
+
+  format_ = avformat_alloc_context();
+  format_->interrupt_callback.callback = &StreamCapture::InterruptCallback;
+  format_->interrupt_callback.opaque = this;
+
+  AVDictionary* options = nullptr;
+  if (url.compare(0, 7, "rtsp://") == 0 && config_.rtsp_tcp) {
+    av_dict_set(&options, "rtsp_transport", "tcp", 0);
+  }
+  if (!is_file_) {
+    // Live sources: hand packets over as they arrive.
+    av_dict_set(&options, "fflags", "nobuffer", 0);
+    av_dict_set(&options, "probesize", "500000", 0);
+    av_dict_set(&options, "analyzeduration", "1000000", 0);
+  }
+  io_deadline_us_ = MonotonicMicros() + config_.timeout_ms * 1000LL;
+  int result = avformat_open_input(&format_, url.c_str(), nullptr, &options);
+  av_dict_free(&options);
+  if (result < 0) {
+    // avformat_open_input frees the context on failure.
+    format_ = nullptr;
+    *error = AvErrorMessage("Failed to open stream", result);
+    return false;
+  }
+  io_deadline_us_ = MonotonicMicros() + config_.timeout_ms * 1000LL;
+  result = avformat_find_stream_info(format_, nullptr);
+  if (result < 0) {
+    *error = AvErrorMessage("Failed to read stream info", result);
+    return false;
+  }
+
+  stream_index_ =
+      av_find_best_stream(format_, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+  if (stream_index_ < 0) {
+    *error = "No video stream";
+    return false;
+  }
+  AVStream* stream = format_->streams[stream_index_];
+  // Looked up separately: av_find_best_stream() only returns a const
+  // decoder from FFmpeg 5 on.
+  const AVCodec* decoder = avcodec_find_decoder(stream->codecpar->codec_id);
+  if (decoder == nullptr) {
+    *error = "No decoder for the video stream";
+    return false;
+  }
+  AVCodecContext* codec = avcodec_alloc_context3(decoder);
+  avcodec_parameters_to_context(codec, stream->codecpar);
+  // Sources decode in parallel on the pool, one thread each.
+  codec->thread_count = 1;
+  codec->flags |= AV_CODEC_FLAG_LOW_DELAY;
+  result = avcodec_open2(codec, decoder, nullptr);
+  if (result < 0) {
+    avcodec_free_context(&codec);
+    *error = AvErrorMessage("Failed to open decoder", result);
+    return false;
+  }
+
+  const AVCodecDescriptor* descriptor =
+      avcodec_descriptor_get(stream->codecpar->codec_id);
+  intra_only_ = descriptor != nullptr &&
+                (descriptor->props & AV_CODEC_PROP_INTRA_ONLY);
+  const AVRational rate = av_guess_frame_rate(format_, stream, nullptr);
+  const double fps = rate.num > 0 && rate.den > 0 ? av_q2d(rate) : 0;
+  frame_interval_us_ = fps > 0 ? static_cast<int64_t>(1000000 / fps) : 0;
+  pace_origin_us_ = 0;
+  waiting_for_keyframe_ = true;
+
+  {
+    std::lock_guard<std::mutex> lock(decode_mutex_);
+    codec_ = codec;
+    frame_ = av_frame_alloc();
+  }
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  stats_.connected = true;
+  stats_.last_error.clear();
+  stats_.capture.format = decoder->name;
+  stats_.capture.width = stream->codecpar->width;
+  stats_.capture.height = stream->codecpar->height;
+  stats_.capture.fps = fps;
+  return true;
+}
+
+void StreamCapture::Close() {
+  {
+    // Let the decode task finish what it has before the decoder goes.
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    for (AVPacket* packet : queue_) {
+      av_packet_free(&packet);
+    }
+    queue_.clear();
+    flush_decoder_ = false;
+    drained_.wait(lock, [this]() { return !drain_scheduled_; });
+  }
+  {
+    std::lock_guard<std::mutex> lock(decode_mutex_);
+    avcodec_free_context(&codec_);
+    av_frame_free(&frame_);
+    sws_freeContext(sws_);
+    sws_ = nullptr;
+  }
+  if (format_ != nullptr) {
+    avformat_close_input(&format_);
+  }
+  stream_index_ = -1;
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  stats_.connected = false;
+}
+
+bool StreamCapture::PaceFile(const AVPacket* packet) {
+  const int64_t pts =
+      packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+  if (pts == AV_NOPTS_VALUE) {
+    return true;
+  }
+  const int64_t pts_us = av_rescale_q(
+      pts, format_->streams[stream_index_]->time_base, AVRational{1, 1000000});
+  const int64_t now = MonotonicMicros();
+  if (pace_origin_us_ == 0 || pts_us < pace_origin_pts_us_) {
+    pace_origin_us_ = now;
+    pace_origin_pts_us_ = pts_us;
+    return true;
+  }
+  const int64_t due = pace_origin_us_ + (pts_us - pace_origin_pts_us_);
+  return due <= now || WaitFor(due - now);
+}
+
+bool StreamCapture::WantPacket(const AVPacket* packet) {
+  const bool key = packet->flags & AV_PKT_FLAG_KEY;
+  if (waiting_for_keyframe_ && !key) {
+    return false;
+  }
+  if (idle_.load() && !key) {
+    return false;
+  }
+  if (intra_only_) {
+    // Every frame stands alone, so only the ones due get decoded.
+    const int64_t interval = publish_interval_us_.load();
+    const int64_t last = last_publish_us_.load();
+    const int64_t now = MonotonicMicros();
+    if (interval > 0 && last != 0 && now >= last &&
+        now - last < interval - frame_interval_us_ / 2) {
+      return false;
+    }
+  }
+  waiting_for_keyframe_ = false;
+  return true;
+}
+
+void StreamCapture::Enqueue(AVPacket* packet) {
+  bool schedule = false;
+  size_t dropped = 0;
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    if (queue_.size() >= kMaxQueuedPackets) {
+      dropped = queue_.size();
+      for (AVPacket* stale : queue_) {
+        av_packet_free(&stale);
+      }
+      queue_.clear();
+      flush_decoder_ = true;
+      waiting_for_keyframe_ = true;
+    }
+    if (!waiting_for_keyframe_ || (packet->flags & AV_PKT_FLAG_KEY)) {
+      waiting_for_keyframe_ = false;
+      queue_.push_back(packet);
+      packet = nullptr;
+    }
+    schedule = !queue_.empty() && !drain_scheduled_;
+    drain_scheduled_ = drain_scheduled_ || schedule;
+  }
+  if (packet != nullptr) {
+    av_packet_free(&packet);
+    dropped++;
+  }
+  if (dropped > 0) {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.packets_dropped += dropped;
+  }
+  if (schedule) {
+    pool_->Post([this]() { DrainPackets(); });
+  }
+}
+
+void StreamCapture::DrainPackets() {
+  std::lock_guard<std::mutex> decode_lock(decode_mutex_);
+  while (true) {
+    AVPacket* packet = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex_);
+      if (flush_decoder_ && codec_ != nullptr) {
+        avcodec_flush_buffers(codec_);
+      }
+      flush_decoder_ = false;
+      if (queue_.empty()) {
+        drain_scheduled_ = false;
+        drained_.notify_all();
+        return;
+      }
+      packet = queue_.front();
+      queue_.pop_front();
+    }
+    Decode(packet);
+    av_packet_free(&packet);
+  }
+}
+
+void StreamCapture::Decode(AVPacket* packet) {
+  if (codec_ == nullptr) {
+    return;
+  }
+  // Far below the stream rate nothing is lost by skipping the frames no
+  // other frame refers to, typically B-frames.
+  const int64_t interval = publish_interval_us_.load();
+  codec_->skip_frame =
+      frame_interval_us_ > 0 && interval >= 2 * frame_interval_us_
+          ? AVDISCARD_NONREF
+          : AVDISCARD_DEFAULT;
+
+  uint64_t decoded = 0;
+  uint64_t published = 0;
+  uint64_t failed = 0;
+  if (avcodec_send_packet(codec_, packet) < 0) {
+    failed++;
+  }
+  while (avcodec_receive_frame(codec_, frame_) == 0) {
+    decoded++;
+    const int64_t now = MonotonicMicros();
+    const int64_t last = last_publish_us_.load();
+    if (interval == 0 || last == 0 || now < last || now - last >= interval) {
+      if (Publish(frame_)) {
+        last_publish_us_ = now;
+        published++;
+      } else {
+        failed++;
+      }
+    }
+    av_frame_unref(frame_);
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  stats_.frames_decoded += decoded;
+  stats_.capture.frames_published += published;
+  stats_.capture.frames_failed += failed;
+}
+
+bool StreamCapture::Publish(const AVFrame* frame) {
+  const uint32_t packed = publish_size_.load();
+  const int width =
+      packed != 0 ? std::min(static_cast<int>(packed >> 16), frame->width)
+                  : frame->width;
+  const int height =
+      packed != 0 ? std::min(static_cast<int>(packed & 0xFFFF), frame->height)
+                  : frame->height;
+  sws_ = sws_getCachedContext(
+      sws_, frame->width, frame->height,
+      static_cast<AVPixelFormat>(frame->format), width, height,
+      AV_PIX_FMT_RGBA, SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+  if (sws_ == nullptr) {
+    return false;
+  }
+  const int stride = width * 4;
+  uint8_t* out = ring_->BeginWrite(width, height, stride, PixelFormat::kRgba);
+  if (out == nullptr) {
+    return false;
+  }
+  uint8_t* planes[4] = {out, nullptr, nullptr, nullptr};
+  int strides[4] = {stride, 0, 0, 0};
+  sws_scale(sws_, frame->data, frame->linesize, 0, frame->height, planes,
+            strides);
+  ring_->CommitWrite(MonotonicMicros());
+  return true;
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,156 @@
+#ifndef PLUGINS_KIOSK_VISION_STREAM_CAPTURE_H_
+#define PLUGINS_KIOSK_VISION_STREAM_CAPTURE_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "decode_pool.h"
+#include "frame_ring.h"
+#include "v4l2_capture.h"
+
+// libavformat / libavcodec / libswscale types, kept out of this header.
+struct AVCodecContext;
+struct AVFormatContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+namespace kiosk_vision {
+
+struct StreamConfig {
+  // rtsp://, http(s):// (MJPEG or anything else libavformat reads) or a
+  // local file, which loops at its own frame rate.
+  std::string url;
+  // RTSP over TCP; UDP loses packets on busy Wi-Fi.
+  bool rtsp_tcp = true;
+  // Same meaning as the CaptureConfig fields.
+  double publish_fps = 5;
+  int publish_width = 0;
+  int publish_height = 0;
+  // Decode keyframes only, for a detector with nothing to look at.
+  bool idle = false;
+  // Longest wait for the connection or the next packet before the source
+  // counts as lost.
+  int timeout_ms = 5000;
+  // Reconnect delay, doubled after each failed attempt up to the maximum.
+  int reconnect_min_ms = 500;
+  int reconnect_max_ms = 30000;
+};
+
+struct StreamStats {
+  // |device| is the URL, |format| the codec and |frames_captured| the video
+  // packets read.
+  CaptureStats capture;
+  bool connected = false;
+  bool keyframes_only = false;
+  uint64_t reconnects = 0;
+  // Never sent to the decoder: not due, not a keyframe while idle, or
+  // waiting for the next keyframe.
+  uint64_t packets_skipped = 0;
+  // Dropped because decoding fell behind.
+  uint64_t packets_dropped = 0;
+  uint64_t frames_decoded = 0;
+  std::string last_error;
+};
+
+// Network camera or file source, feeding a FrameRing like V4l2Capture.
+//
+// A demux thread per source reads packets (network I/O, reconnects, file
+// pacing) and hands them to a DecodePool shared by all sources, which
+// decodes and converts them into the ring. Only what the detector will use
+// is decoded: intra-only codecs such as MJPEG decode just the frames due
+// at the publish rate, other codecs skip non-reference frames when the
+// publish rate is well below the stream rate, and an idle source decodes
+// keyframes only. When decoding falls behind, queued packets are dropped
+// up to the next keyframe rather than growing latency.
+class StreamCapture {
+ public:
+  // |pool| must outlive the capture.
+  StreamCapture(FrameRing* ring, DecodePool* pool);
+  ~StreamCapture();
+
+  // Disallow copy and assign.
+  StreamCapture(const StreamCapture&) = delete;
+  StreamCapture& operator=(const StreamCapture&) = delete;
+
+  // Starts connecting in the background; restarts if already running.
+  // Fails only for an empty URL.
+  bool Start(const StreamConfig& config, std::string* error);
+  void Stop();
+
+  void SetPublishing(double publish_fps, int publish_width,
+                     int publish_height);
+  void SetIdle(bool idle);
+
+  bool is_running() const { return running_.load(); }
+  StreamStats stats() const;
+
+ private:
+  void DemuxLoop();
+  bool Open(std::string* error);
+  void Close();
+  // Paces file sources to their timestamps; false when stopped.
+  bool PaceFile(const AVPacket* packet);
+  // True when the packet should reach the decoder.
+  bool WantPacket(const AVPacket* packet);
+  void Enqueue(AVPacket* packet);
+  // Pool task; decodes until the queue is empty.
+  void DrainPackets();
+  void Decode(AVPacket* packet);
+  bool Publish(const AVFrame* frame);
+  bool WaitFor(int64_t micros);
+  static int InterruptCallback(void* opaque);
+
+  FrameRing* ring_;
+  DecodePool* pool_;
+  StreamConfig config_;
+
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  // Wakes the demux thread out of reconnect and pacing waits.
+  std::mutex wait_mutex_;
+  std::condition_variable wait_;
+  // Monotonic deadline for the blocking libavformat call in progress.
+  std::atomic<int64_t> io_deadline_us_{0};
+
+  std::atomic<int64_t> publish_interval_us_{0};
+  // Requested publish size as (width << 16) | height, 0 for stream size.
+  std::atomic<uint32_t> publish_size_{0};
+  std::atomic<bool> idle_{false};
+  std::atomic<int64_t> last_publish_us_{0};
+
+  // Demux thread only.
+  AVFormatContext* format_ = nullptr;
+  int stream_index_ = -1;
+  bool is_file_ = false;
+  bool intra_only_ = false;
+  int64_t frame_interval_us_ = 0;
+  int64_t pace_origin_us_ = 0;
+  int64_t pace_origin_pts_us_ = 0;
+  bool waiting_for_keyframe_ = true;
+
+  // Queue between the demux thread and the decode task.
+  std::mutex queue_mutex_;
+  std::condition_variable drained_;
+  std::deque<AVPacket*> queue_;
+  bool drain_scheduled_ = false;
+  bool flush_decoder_ = false;
+
+  // Held by the decode task; the demux thread takes it to swap decoders.
+  std::mutex decode_mutex_;
+  AVCodecContext* codec_ = nullptr;
+  AVFrame* frame_ = nullptr;
+  SwsContext* sws_ = nullptr;
+
+  mutable std::mutex stats_mutex_;
+  StreamStats stats_;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_STREAM_CAPTURE_H_
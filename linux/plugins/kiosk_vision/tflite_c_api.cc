@@ -0,0 +1,128 @@
+#include "tflite_c_api.h"
+
+#include <dlfcn.h>
+#include <limits.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace kiosk_vision {
+
+namespace {
+
+// Library names in lookup order. The first one is what tflite_flutter ships
+// in the bundle's lib/ directory; the others cover system-wide installs.
+const char* const kLibraryNames[] = {
+    "libtensorflowlite_c-linux.so",
+    "libtensorflowlite_c.so",
+    "libtensorflowlite_c.so.2",
+};
+
+// Directory containing the running executable, with a trailing slash.
+std::string ExecutableDir() {
+  char path[PATH_MAX];
+  ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  if (length <= 0) {
+    return std::string();
+  }
+  path[length] = '\0';
+  std::string dir(path);
+  size_t slash = dir.rfind('/');
+  return slash == std::string::npos ? std::string() : dir.substr(0, slash + 1);
+}
+
+void* OpenLibrary(std::string* error) {
+  std::vector<std::string> candidates;
+  const std::string exe_dir = ExecutableDir();
+  for (const char* name : kLibraryNames) {
+    if (!exe_dir.empty()) {
+      candidates.push_back(exe_dir + "lib/" + name);
+    }
+    candidates.push_back(name);
+  }
+
+  for (const std::string& candidate : candidates) {
+    void* handle = dlopen(candidate.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle != nullptr) {
+      return handle;
+    }
+    const char* message = dlerror();
+    if (message != nullptr) {
+      *error = message;
+    }
+  }
+  return nullptr;
+}
+
+template <typename T>
+bool Resolve(void* handle, const char* symbol, T* out, std::string* error) {
+  *out = reinterpret_cast<T>(dlsym(handle, symbol));
+  if (*out == nullptr) {
+    *error = std::string("missing symbol ") + symbol;
+    return false;
+  }
+  return true;
+}
+
+bool LoadInto(TfLiteApi* api, std::string* error) {
+  void* handle = OpenLibrary(error);
+  if (handle == nullptr) {
+    return false;
+  }
+
+  bool ok = true;
+  ok &= Resolve(handle, "TfLiteModelCreate", &api->ModelCreate, error);
+  ok &= Resolve(handle, "TfLiteModelDelete", &api->ModelDelete, error);
+  ok &= Resolve(handle, "TfLiteInterpreterOptionsCreate",
+                &api->InterpreterOptionsCreate, error);
+  ok &= Resolve(handle, "TfLiteInterpreterOptionsDelete",
+                &api->InterpreterOptionsDelete, error);
+  ok &= Resolve(handle, "TfLiteInterpreterOptionsSetNumThreads",
+                &api->InterpreterOptionsSetNumThreads, error);
+  ok &= Resolve(handle, "TfLiteInterpreterCreate", &api->InterpreterCreate,
+                error);
+  ok &= Resolve(handle, "TfLiteInterpreterDelete", &api->InterpreterDelete,
+                error);
+  ok &= Resolve(handle, "TfLiteInterpreterGetInputTensorCount",
+                &api->InterpreterGetInputTensorCount, error);
+  ok &= Resolve(handle, "TfLiteInterpreterGetInputTensor",
+                &api->InterpreterGetInputTensor, error);
+  ok &= Resolve(handle, "TfLiteInterpreterResizeInputTensor",
+                &api->InterpreterResizeInputTensor, error);
+  ok &= Resolve(handle, "TfLiteInterpreterAllocateTensors",
+                &api->InterpreterAllocateTensors, error);
+  ok &= Resolve(handle, "TfLiteInterpreterInvoke", &api->InterpreterInvoke,
+                error);
+  ok &= Resolve(handle, "TfLiteInterpreterGetOutputTensorCount",
+                &api->InterpreterGetOutputTensorCount, error);
+  ok &= Resolve(handle, "TfLiteInterpreterGetOutputTensor",
+                &api->InterpreterGetOutputTensor, error);
+  ok &= Resolve(handle, "TfLiteTensorType", &api->TensorType, error);
+  ok &= Resolve(handle, "TfLiteTensorNumDims", &api->TensorNumDims, error);
+  ok &= Resolve(handle, "TfLiteTensorDim", &api->TensorDim, error);
+  ok &= Resolve(handle, "TfLiteTensorByteSize", &api->TensorByteSize, error);
+  ok &= Resolve(handle, "TfLiteTensorData", &api->TensorData, error);
+  ok &= Resolve(handle, "TfLiteTensorQuantizationParams",
+                &api->TensorQuantizationParams, error);
+
+  // The handle is intentionally never closed: the interpreter lives for the
+  // lifetime of the process.
+  return ok;
+}
+
+}  // namespace
+
+const TfLiteApi* TfLiteApi::Load(std::string* error) {
+  static std::string load_error;
+  static TfLiteApi api;
+  static const bool loaded = LoadInto(&api, &load_error);
+  if (!loaded) {
+    if (error != nullptr) {
+      *error = load_error;
+    }
+    return nullptr;
+  }
+  return &api;
+}
+
+}  // namespace kiosk_vision
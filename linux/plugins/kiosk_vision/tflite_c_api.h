@@ -0,0 +1,88 @@
+#ifndef PLUGINS_KIOSK_VISION_TFLITE_C_API_H_
+#define PLUGINS_KIOSK_VISION_TFLITE_C_API_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace kiosk_vision {
+
+// Minimal subset of the TensorFlow Lite C API (tensorflow/lite/c/c_api.h).
+// The tflite_flutter plugin already bundles libtensorflowlite_c-linux.so
+// next to the executable, so the symbols are resolved at runtime with dlopen
+// instead of requiring the TensorFlow headers at build time.
+extern "C" {
+typedef struct TfLiteModel TfLiteModel;
+typedef struct TfLiteInterpreterOptions TfLiteInterpreterOptions;
+typedef struct TfLiteInterpreter TfLiteInterpreter;
+typedef struct TfLiteTensor TfLiteTensor;
+typedef struct TfLiteDelegate TfLiteDelegate;
+
+typedef enum TfLiteStatus {
+  kTfLiteOk = 0,
+  kTfLiteError = 1,
+  kTfLiteDelegateError = 2,
+  kTfLiteApplicationError = 3,
+} TfLiteStatus;
+
+typedef enum {
+  kTfLiteNoType = 0,
+  kTfLiteFloat32 = 1,
+  kTfLiteInt32 = 2,
+  kTfLiteUInt8 = 3,
+  kTfLiteInt64 = 4,
+  kTfLiteInt8 = 9,
+} TfLiteType;
+
+typedef struct TfLiteQuantizationParams {
+  float scale;
+  int32_t zero_point;
+} TfLiteQuantizationParams;
+}
+
+// Function table filled from the shared library. Every pointer is non-null
+// once Load() has returned true.
+struct TfLiteApi {
+  TfLiteModel* (*ModelCreate)(const void* model_data, size_t model_size);
+  void (*ModelDelete)(TfLiteModel* model);
+
+  TfLiteInterpreterOptions* (*InterpreterOptionsCreate)();
+  void (*InterpreterOptionsDelete)(TfLiteInterpreterOptions* options);
+  void (*InterpreterOptionsSetNumThreads)(TfLiteInterpreterOptions* options,
+                                          int32_t num_threads);
+
+  TfLiteInterpreter* (*InterpreterCreate)(
+      const TfLiteModel* model,
+      const TfLiteInterpreterOptions* optional_options);
+  void (*InterpreterDelete)(TfLiteInterpreter* interpreter);
+  int32_t (*InterpreterGetInputTensorCount)(
+      const TfLiteInterpreter* interpreter);
+  TfLiteTensor* (*InterpreterGetInputTensor)(
+      const TfLiteInterpreter* interpreter, int32_t input_index);
+  TfLiteStatus (*InterpreterResizeInputTensor)(TfLiteInterpreter* interpreter,
+                                               int32_t input_index,
+                                               const int* input_dims,
+                                               int32_t input_dims_size);
+  TfLiteStatus (*InterpreterAllocateTensors)(TfLiteInterpreter* interpreter);
+  TfLiteStatus (*InterpreterInvoke)(TfLiteInterpreter* interpreter);
+  int32_t (*InterpreterGetOutputTensorCount)(
+      const TfLiteInterpreter* interpreter);
+  const TfLiteTensor* (*InterpreterGetOutputTensor)(
+      const TfLiteInterpreter* interpreter, int32_t output_index);
+
+  TfLiteType (*TensorType)(const TfLiteTensor* tensor);
+  int32_t (*TensorNumDims)(const TfLiteTensor* tensor);
+  int32_t (*TensorDim)(const TfLiteTensor* tensor, int32_t dim_index);
+  size_t (*TensorByteSize)(const TfLiteTensor* tensor);
+  void* (*TensorData)(const TfLiteTensor* tensor);
+  TfLiteQuantizationParams (*TensorQuantizationParams)(
+      const TfLiteTensor* tensor);
+
+  // Loads the library once per process. Subsequent calls return the cached
+  // result. |error| receives the dlerror() text on failure.
+  static const TfLiteApi* Load(std::string* error);
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_TFLITE_C_API_H_
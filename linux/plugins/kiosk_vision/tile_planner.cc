@@ -0,0 +1,216 @@
+#include "tile_planner.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace kiosk_vision {
+
+namespace {
+
+// ROI crop sides are rounded up to this many pixels so a slowly moving
+// track does not rebuild the preprocessor's sampling tables every frame.
+const int kRoiQuantum = 16;
+// Crops smaller than half the model input would only be upsampled further
+// without adding detail.
+const float kMinRoiScale = 0.5f;
+// A crop mostly inside an already planned crop of about the same scale
+// adds nothing.
+const float kCoveredFraction = 0.9f;
+const float kSameScale = 1.25f;
+
+// Shrinks |rect| to the model aspect ratio around its center.
+CropRect FitAspect(const CropRect& rect, int model_width, int model_height) {
+  const CropRect fit =
+      CenterCrop(rect.width, rect.height, model_width, model_height);
+  return CropRect{rect.x + fit.x, rect.y + fit.y, fit.width, fit.height};
+}
+
+float CoveredFraction(const CropRect& inner, const CropRect& outer) {
+  const int width = std::min(inner.x + inner.width, outer.x + outer.width) -
+                    std::max(inner.x, outer.x);
+  const int height = std::min(inner.y + inner.height, outer.y + outer.height) -
+                     std::max(inner.y, outer.y);
+  if (width <= 0 || height <= 0) {
+    return 0;
+  }
+  return static_cast<float>(width) * height /
+         (static_cast<float>(inner.width) * inner.height);
+}
+
+bool SameRect(const CropRect& a, const CropRect& b) {
+  return a.x == b.x && a.y == b.y && a.width == b.width &&
+         a.height == b.height;
+}
+
+}  // namespace
+
+void TilePlanner::Configure(const TilingConfig& config) {
+  config_ = config;
+  config_.grid_size = std::max(1, std::min(config.grid_size, 6));
+  config_.overlap = std::max(0.0f, std::min(config.overlap, 0.5f));
+  config_.max_tiles = std::max(0, std::min(config.max_tiles, 16));
+  config_.roi_margin = std::max(0.0f, config.roi_margin);
+  config_.max_roi_fraction =
+      std::max(0.1f, std::min(config.max_roi_fraction, 1.0f));
+  grid_.clear();
+  next_grid_tile_ = 0;
+}
+
+void TilePlanner::GridTiles(const CropRect& area, int model_width,
+                            int model_height) {
+  if (!grid_.empty() && SameRect(area, grid_area_) &&
+      model_width == grid_model_width_ && model_height == grid_model_height_ &&
+      config_.grid_size == grid_size_ && config_.overlap == grid_overlap_) {
+    return;
+  }
+  grid_area_ = area;
+  grid_model_width_ = model_width;
+  grid_model_height_ = model_height;
+  grid_size_ = config_.grid_size;
+  grid_overlap_ = config_.overlap;
+  grid_.clear();
+  next_grid_tile_ = 0;
+  if (config_.grid_size <= 1) {
+    return;
+  }
+
+  // |grid_size| rows of tiles with the model's aspect ratio; the column
+  // count follows from the area's aspect ratio.
+  const float rows = static_cast<float>(config_.grid_size);
+  const int tile_height = std::min(
+      area.height,
+      static_cast<int>(std::ceil(area.height /
+                                 (rows - (rows - 1) * config_.overlap))));
+  const int tile_width =
+      std::min(area.width, static_cast<int>(std::lround(
+                               static_cast<double>(tile_height) *
+                               model_width / model_height)));
+  const float step = tile_width * (1.0f - config_.overlap);
+  const int columns =
+      tile_width >= area.width
+          ? 1
+          : std::max(2, static_cast<int>(std::ceil(
+                            (area.width - tile_width) / step)) + 1);
+
+  for (int row = 0; row < config_.grid_size; ++row) {
+    const int y = area.y + static_cast<int>(std::lround(
+                               static_cast<double>(row) *
+                               (area.height - tile_height) /
+                               (config_.grid_size - 1)));
+    for (int column = 0; column < columns; ++column) {
+      const int x =
+          columns == 1
+              ? area.x
+              : area.x + static_cast<int>(std::lround(
+                             static_cast<double>(column) *
+                             (area.width - tile_width) / (columns - 1)));
+      grid_.push_back(FitAspect(CropRect{x, y, tile_width, tile_height},
+                                model_width, model_height));
+    }
+  }
+}
+
+bool TilePlanner::RoiCrop(const CropRect& area, int model_width,
+                          int model_height, const Detection& roi,
+                          CropRect* crop) const {
+  const float box_width = (roi.x2 - roi.x1) * area.width;
+  const float box_height = (roi.y2 - roi.y1) * area.height;
+  if (box_width <= 0 || box_height <= 0) {
+    return false;
+  }
+  const float aspect = static_cast<float>(model_width) / model_height;
+  float height = std::max(box_height, box_width / aspect) *
+                 (1.0f + 2.0f * config_.roi_margin);
+  height = std::max(height, model_height * kMinRoiScale);
+  if (height > config_.max_roi_fraction * area.height) {
+    return false;
+  }
+
+  int crop_height =
+      (static_cast<int>(std::ceil(height)) + kRoiQuantum - 1) / kRoiQuantum *
+      kRoiQuantum;
+  crop_height = std::min(crop_height, area.height);
+  int crop_width = static_cast<int>(std::lround(crop_height * aspect));
+  if (crop_width > area.width) {
+    crop_width = area.width;
+    crop_height = std::min(
+        area.height, static_cast<int>(std::lround(crop_width / aspect)));
+  }
+
+  const float center_x = area.x + (roi.x1 + roi.x2) * 0.5f * area.width;
+  const float center_y = area.y + (roi.y1 + roi.y2) * 0.5f * area.height;
+  int x = static_cast<int>(std::lround(center_x - crop_width * 0.5f));
+  int y = static_cast<int>(std::lround(center_y - crop_height * 0.5f));
+  x = std::max(area.x, std::min(x, area.x + area.width - crop_width));
+  y = std::max(area.y, std::min(y, area.y + area.height - crop_height));
+  *crop = FitAspect(CropRect{x, y, crop_width, crop_height}, model_width,
+                    model_height);
+  return true;
+}
+
+void TilePlanner::Plan(const CropRect& area, int model_width,
+                       int model_height, const std::vector<Detection>& rois,
+                       std::vector<CropRect>* crops) {
+  crops->clear();
+  if (config_.include_full_frame || config_.mode == TilingMode::kOff) {
+    crops->push_back(area);
+  }
+  if (config_.mode == TilingMode::kOff || area.width <= 0 ||
+      area.height <= 0 || model_width <= 0 || model_height <= 0) {
+    return;
+  }
+  const size_t limit = crops->size() + config_.max_tiles;
+
+  const auto covered = [crops](const CropRect& candidate) {
+    for (const CropRect& planned : *crops) {
+      if (CoveredFraction(candidate, planned) >= kCoveredFraction &&
+          planned.width <= candidate.width * kSameScale) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // ROIs first: they are where people were or things moved.
+  if (config_.mode == TilingMode::kRoi ||
+      config_.mode == TilingMode::kGridAndRoi) {
+    CropRect crop;
+    for (const Detection& roi : rois) {
+      if (crops->size() >= limit) {
+        break;
+      }
+      if (RoiCrop(area, model_width, model_height, roi, &crop) &&
+          !covered(crop)) {
+        crops->push_back(crop);
+      }
+    }
+  }
+
+  // Then the grid, resuming where the previous frame left off.
+  if (config_.mode == TilingMode::kGrid ||
+      config_.mode == TilingMode::kGridAndRoi) {
+    GridTiles(area, model_width, model_height);
+    const size_t tiles = grid_.size();
+    for (size_t i = 0; i < tiles && crops->size() < limit; ++i) {
+      const CropRect& tile = grid_[next_grid_tile_];
+      next_grid_tile_ = (next_grid_tile_ + 1) % tiles;
+      if (!covered(tile)) {
+        crops->push_back(tile);
+      }
+    }
+  }
+}
+
+void MapCropDetection(const CropRect& crop, const CropRect& area,
+                      Detection* detection) {
+  const float scale_x = static_cast<float>(crop.width) / area.width;
+  const float scale_y = static_cast<float>(crop.height) / area.height;
+  const float offset_x = static_cast<float>(crop.x - area.x) / area.width;
+  const float offset_y = static_cast<float>(crop.y - area.y) / area.height;
+  detection->x1 = offset_x + detection->x1 * scale_x;
+  detection->x2 = offset_x + detection->x2 * scale_x;
+  detection->y1 = offset_y + detection->y1 * scale_y;
+  detection->y2 = offset_y + detection->y2 * scale_y;
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,90 @@
+#ifndef PLUGINS_KIOSK_VISION_TILE_PLANNER_H_
+#define PLUGINS_KIOSK_VISION_TILE_PLANNER_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "detection_postprocess.h"
+#include "frame_preprocessor.h"
+
+namespace kiosk_vision {
+
+enum class TilingMode {
+  kOff,   // Single center-crop resize, as before.
+  kGrid,  // Overlapping grid over the crop.
+  kRoi,   // Crops around tracks and the motion region.
+  kGridAndRoi,
+};
+
+struct TilingConfig {
+  TilingMode mode = TilingMode::kOff;
+  // Also run the single resize of the whole crop, for objects larger than
+  // a tile.
+  bool include_full_frame = true;
+  // Grid tiles per side of the crop and the fraction of a tile shared with
+  // its neighbour.
+  int grid_size = 2;
+  float overlap = 0.2f;
+  // Tile budget: crops per frame besides the full-frame pass. Grid tiles
+  // beyond the budget are visited round-robin over the following frames.
+  int max_tiles = 4;
+  // ROIs grow by this fraction of their size on each side. ROIs needing a
+  // crop larger than |max_roi_fraction| of the crop height are left to the
+  // full-frame pass.
+  float roi_margin = 0.5f;
+  float max_roi_fraction = 0.6f;
+  // Same-class boxes from different crops whose intersection covers this
+  // fraction of the smaller box are merged into one.
+  float merge_containment = 0.7f;
+  // Run all crops in one interpreter call when the model accepts a batch.
+  bool batch = true;
+};
+
+// Picks the source rectangles for one frame. Detections are reported in
+// normalized coordinates of |area|, the center crop of the single-resize
+// path, so tiles never leave it and results, tracks and the Dart overlays
+// keep one coordinate space.
+//
+// Not thread-safe; owned by the engine worker.
+class TilePlanner {
+ public:
+  TilePlanner() = default;
+
+  void Configure(const TilingConfig& config);
+  const TilingConfig& config() const { return config_; }
+  bool enabled() const { return config_.mode != TilingMode::kOff; }
+
+  // Fills |crops| with at most 1 + max_tiles rectangles inside |area|, each
+  // with the model's aspect ratio. The first one is |area| itself when the
+  // full-frame pass is on. |rois| are normalized to |area|, highest
+  // priority first.
+  void Plan(const CropRect& area, int model_width, int model_height,
+            const std::vector<Detection>& rois, std::vector<CropRect>* crops);
+
+  void Reset() { next_grid_tile_ = 0; }
+
+ private:
+  void GridTiles(const CropRect& area, int model_width, int model_height);
+  bool RoiCrop(const CropRect& area, int model_width, int model_height,
+               const Detection& roi, CropRect* crop) const;
+
+  TilingConfig config_;
+  // Round-robin position in |grid_| for grids larger than the budget.
+  size_t next_grid_tile_ = 0;
+
+  // Cached grid for the last area and model size.
+  CropRect grid_area_;
+  int grid_model_width_ = 0;
+  int grid_model_height_ = 0;
+  int grid_size_ = 0;
+  float grid_overlap_ = 0;
+  std::vector<CropRect> grid_;
+};
+
+// Maps a detection normalized to |crop| into normalized |area| coordinates.
+void MapCropDetection(const CropRect& crop, const CropRect& area,
+                      Detection* detection);
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_TILE_PLANNER_H_
@@ -0,0 +1,161 @@
+// Runs the vectorized image kernels selected for this CPU against their
+// scalar references on random frames and exits non-zero on the first
+// mismatch, so a regression in a SIMD path fails the build step that runs
+// it instead of shifting detections on a kiosk.
+//
+//   kiosk_vision_kernel_check [--seed=N] [--benchmark]
+//
+// Every kernel checked here promises bit-exact output; there is no
+// tolerance.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "color_convert.h"
+#include "frame_preprocessor.h"
+
+namespace {
+
+const char kUsage[] =
+    "Usage: kiosk_vision_kernel_check [options]\n"
+    "\n"
+    "  --seed=N           Random seed (default 1).\n"
+    "  --benchmark        Also time the YUV conversions against the scalar\n"
+    "                     reference, 1080p to 640x360 RGBA.\n";
+
+struct Size {
+  int width;
+  int height;
+};
+
+// Camera frames into the model input sizes in use, plus odd sizes that
+// leave vector remainders and upscaling.
+const Size kFrames[] = {{640, 480}, {1280, 720}, {1920, 1080}, {333, 211},
+                        {64, 48}};
+const Size kTensors[] = {{300, 300}, {320, 320}, {224, 224}, {192, 192}};
+
+const char* FormatName(kiosk_vision::PixelFormat format) {
+  switch (format) {
+    case kiosk_vision::PixelFormat::kBgra:
+      return "bgra";
+    case kiosk_vision::PixelFormat::kRgb:
+      return "rgb";
+    case kiosk_vision::PixelFormat::kRgba:
+    default:
+      return "rgba";
+  }
+}
+
+// Returns the number of cases that did not match.
+int CheckPreprocessing(std::mt19937* random) {
+  const kiosk_vision::PixelFormat formats[] = {
+      kiosk_vision::PixelFormat::kRgba, kiosk_vision::PixelFormat::kBgra,
+      kiosk_vision::PixelFormat::kRgb};
+  kiosk_vision::FramePreprocessor preprocessor;
+  int cases = 0;
+  int failures = 0;
+  for (const Size& frame : kFrames) {
+    for (const Size& tensor : kTensors) {
+      for (kiosk_vision::PixelFormat format : formats) {
+        const int bytes_per_pixel =
+            format == kiosk_vision::PixelFormat::kRgb ? 3 : 4;
+        // Padded rows, as V4L2 and GStreamer buffers often have.
+        const int stride = frame.width * bytes_per_pixel + (cases % 2) * 16;
+        std::vector<uint8_t> pixels(static_cast<size_t>(stride) *
+                                    frame.height);
+        for (uint8_t& byte : pixels) {
+          byte = static_cast<uint8_t>((*random)());
+        }
+        kiosk_vision::ImageView src;
+        src.data = pixels.data();
+        src.width = frame.width;
+        src.height = frame.height;
+        src.stride = stride;
+        src.format = format;
+
+        for (bool quantized : {true, false}) {
+          ++cases;
+          const size_t bytes = static_cast<size_t>(tensor.width) *
+                               tensor.height * 3 *
+                               (quantized ? sizeof(uint8_t) : sizeof(float));
+          std::vector<uint8_t> expected(bytes);
+          std::vector<uint8_t> actual(bytes);
+          kiosk_vision::TensorView dst;
+          dst.width = tensor.width;
+          dst.height = tensor.height;
+          dst.quantized = quantized;
+          dst.data = expected.data();
+          kiosk_vision::PreprocessFrameScalar(src, dst);
+          dst.data = actual.data();
+          preprocessor.Run(src, dst);
+          if (memcmp(expected.data(), actual.data(), bytes) != 0) {
+            ++failures;
+            fprintf(stderr, "preprocess %s: %dx%d %s -> %dx%d %s differs\n",
+                    preprocessor.kernel_name(), frame.width, frame.height,
+                    FormatName(format), tensor.width, tensor.height,
+                    quantized ? "uint8" : "float32");
+          }
+        }
+      }
+    }
+  }
+  printf("preprocess (%s): %d cases, %d mismatched\n",
+         preprocessor.kernel_name(), cases, failures);
+  return failures;
+}
+
+// VerifyYuvConverter() covers every YUV layout, output format and a range
+// of scale factors. Returns the number of mismatched frames.
+int CheckColorConversion() {
+  kiosk_vision::YuvConverter converter;
+  std::string report;
+  const int failures = kiosk_vision::VerifyYuvConverter(&report);
+  if (failures > 0) {
+    fprintf(stderr, "yuv %s: %d mismatched, first: %s\n",
+            converter.kernel_name(), failures, report.c_str());
+  } else {
+    printf("yuv: %s\n", report.c_str());
+  }
+  return failures;
+}
+
+void BenchmarkColorConversion() {
+  for (const kiosk_vision::ColorBenchmark& result :
+       kiosk_vision::BenchmarkYuvConverter(1920, 1080, 640, 360, 200)) {
+    printf("  %-5s %7.3f ms  scalar %7.3f ms  %7.1f MP/s\n",
+           kiosk_vision::YuvFormatName(result.format), result.simd_ms,
+           result.scalar_ms, result.megapixels_per_second);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned seed = 1;
+  bool benchmark = false;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg.compare(0, 7, "--seed=") == 0) {
+      seed = static_cast<unsigned>(strtoul(arg.c_str() + 7, nullptr, 10));
+    } else if (arg == "--benchmark") {
+      benchmark = true;
+    } else {
+      fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+      fputs(kUsage, stderr);
+      return 2;
+    }
+  }
+
+  std::mt19937 random(seed);
+  int failures = 0;
+  failures += CheckPreprocessing(&random);
+  failures += CheckColorConversion();
+  if (benchmark) {
+    BenchmarkColorConversion();
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,388 @@
+// Replays a frame recording through the native detection pipeline without
+// Flutter, and reports per-stage latency and detection counts, so builds
+// and settings can be compared on the same footage.
+//
+//   kiosk_vision_replay --model=detect.tflite [options] recording.kvrec
+//
+// Recordings are made by the plugin's startRecording method.
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "detection_engine.h"
+#include "frame_recording.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char kUsage[] =
+    "Usage: kiosk_vision_replay --model=FILE [options] RECORDING\n"
+    "\n"
+    "  --realtime         Feed frames at their recorded times; frames that\n"
+    "                     arrive while the detector is busy are skipped,\n"
+    "                     as they would be live. Default: as fast as\n"
+    "                     possible, every frame.\n"
+    "  --loops=N          Play the recording N times (default 1).\n"
+    "  --threads=N        Interpreter threads (default: as in the app).\n"
+    "  --threshold=F      Score threshold (default 0.5).\n"
+    "  --motion           Enable the motion gate with default settings.\n"
+    "  --tiling=MODE      off, grid, roi or grid+roi (default off).\n"
+    "  --no-tracking      Disable the tracker.\n"
+    "  --csv=FILE         Write per-frame timings and counts to FILE.\n";
+
+// Upper bucket edges in milliseconds; the last bucket is open.
+const double kBucketsMs[] = {1, 2, 5, 10, 20, 35, 50, 75, 100, 150, 250, 500};
+const int kBarWidth = 40;
+
+struct Options {
+  std::string model;
+  std::string recording;
+  std::string csv;
+  bool realtime = false;
+  int loops = 1;
+  int threads = 0;
+  float threshold = 0.5f;
+  bool motion = false;
+  bool tracking = true;
+  kiosk_vision::TilingMode tiling = kiosk_vision::TilingMode::kOff;
+};
+
+// Everything collected from the detection callbacks.
+struct Report {
+  std::vector<double> preprocess_ms;
+  std::vector<double> inference_ms;
+  std::vector<double> nms_ms;
+  std::vector<double> track_ms;
+  std::vector<double> total_ms;
+  int frames_run = 0;
+  int frames_gated = 0;
+  int errors = 0;
+  int detections = 0;
+  std::map<int, int> detections_per_class;
+  int max_tracks = 0;
+  std::string last_error;
+};
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const size_t equals = arg.find('=');
+    const std::string name = arg.substr(0, equals);
+    const std::string value =
+        equals == std::string::npos ? std::string() : arg.substr(equals + 1);
+    if (name == "--model") {
+      options->model = value;
+    } else if (name == "--realtime") {
+      options->realtime = true;
+    } else if (name == "--loops") {
+      options->loops = std::max(1, atoi(value.c_str()));
+    } else if (name == "--threads") {
+      options->threads = std::max(0, atoi(value.c_str()));
+    } else if (name == "--threshold") {
+      options->threshold = static_cast<float>(atof(value.c_str()));
+    } else if (name == "--motion") {
+      options->motion = true;
+    } else if (name == "--no-tracking") {
+      options->tracking = false;
+    } else if (name == "--csv") {
+      options->csv = value;
+    } else if (name == "--tiling") {
+      if (value == "grid") {
+        options->tiling = kiosk_vision::TilingMode::kGrid;
+      } else if (value == "roi") {
+        options->tiling = kiosk_vision::TilingMode::kRoi;
+      } else if (value == "grid+roi") {
+        options->tiling = kiosk_vision::TilingMode::kGridAndRoi;
+      } else if (value != "off") {
+        fprintf(stderr, "Unknown tiling mode: %s\n", value.c_str());
+        return false;
+      }
+    } else if (arg.compare(0, 2, "--") == 0) {
+      fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+      return false;
+    } else {
+      options->recording = arg;
+    }
+  }
+  return !options->model.empty() && !options->recording.empty();
+}
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>* bytes) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  bytes->assign(std::istreambuf_iterator<char>(file),
+                std::istreambuf_iterator<char>());
+  return !bytes->empty();
+}
+
+double Percentile(std::vector<double> samples, int percent) {
+  if (samples.empty()) {
+    return 0;
+  }
+  std::sort(samples.begin(), samples.end());
+  const size_t rank = (samples.size() * percent + 99) / 100;
+  return samples[std::min(samples.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+void PrintHistogram(const char* name, const std::vector<double>& samples) {
+  if (samples.empty()) {
+    return;
+  }
+  double sum = 0;
+  for (double sample : samples) {
+    sum += sample;
+  }
+  printf("\n%s: mean %.2f  p50 %.2f  p95 %.2f  p99 %.2f  max %.2f ms\n",
+         name, sum / samples.size(), Percentile(samples, 50),
+         Percentile(samples, 95), Percentile(samples, 99),
+         *std::max_element(samples.begin(), samples.end()));
+
+  const int bucket_count = sizeof(kBucketsMs) / sizeof(kBucketsMs[0]) + 1;
+  std::vector<int> counts(bucket_count, 0);
+  for (double sample : samples) {
+    const double* edge =
+        std::lower_bound(std::begin(kBucketsMs), std::end(kBucketsMs), sample);
+    counts[edge - std::begin(kBucketsMs)]++;
+  }
+  const int most = *std::max_element(counts.begin(), counts.end());
+  for (int i = 0; i < bucket_count; ++i) {
+    if (counts[i] == 0) {
+      continue;
+    }
+    char label[32];
+    if (i < bucket_count - 1) {
+      snprintf(label, sizeof(label), "<= %g ms", kBucketsMs[i]);
+    } else {
+      snprintf(label, sizeof(label), "> %g ms", kBucketsMs[i - 1]);
+    }
+    const int bar = std::max(1, counts[i] * kBarWidth / most);
+    printf("  %10s %6d %s\n", label, counts[i], std::string(bar, '#').c_str());
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    fputs(kUsage, stderr);
+    return 2;
+  }
+
+  kiosk_vision::RecordingReader reader;
+  std::string error;
+  if (!reader.Open(options.recording, &error)) {
+    fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+  std::vector<uint8_t> model;
+  if (!ReadFile(options.model, &model)) {
+    fprintf(stderr, "Failed to read model %s\n", options.model.c_str());
+    return 1;
+  }
+
+  kiosk_vision::DetectionEngine engine;
+  std::mutex mutex;
+  std::condition_variable done;
+  bool busy = true;
+  bool load_ok = false;
+  kiosk_vision::ModelInfo info;
+  kiosk_vision::InferenceThreadConfig threads;
+  threads.num_threads = options.threads;
+  engine.LoadModel(std::move(model), threads,
+                   [&](bool ok, const kiosk_vision::ModelInfo& loaded,
+                       const std::string& load_error) {
+                     std::lock_guard<std::mutex> lock(mutex);
+                     load_ok = ok;
+                     info = loaded;
+                     error = load_error;
+                     busy = false;
+                     done.notify_all();
+                   });
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return !busy; });
+  }
+  if (!load_ok) {
+    fprintf(stderr, "Failed to load model: %s\n", error.c_str());
+    return 1;
+  }
+  error.clear();
+
+  printf("Recording %s\n", options.recording.c_str());
+  for (const auto& entry : reader.metadata()) {
+    printf("  %s: %s\n", entry.first.c_str(), entry.second.c_str());
+  }
+  printf("Model %s: %dx%d%s, %d threads, preprocess %s\n",
+         options.model.c_str(), info.input_width, info.input_height,
+         info.quantized ? " quantized" : "", info.num_threads,
+         engine.preprocess_kernel());
+  printf("Loaded in %.1f ms, warm-up %.1f ms first, then %.1f ms\n",
+         info.load_ms, info.warmup_first_ms, info.warmup_ms);
+  if (!info.thread_warning.empty()) {
+    printf("Threads: %s\n", info.thread_warning.c_str());
+  }
+  printf("Mode: %s, %d loop(s)\n",
+         options.realtime ? "realtime" : "as fast as possible", options.loops);
+
+  FILE* csv = nullptr;
+  if (!options.csv.empty()) {
+    csv = fopen(options.csv.c_str(), "w");
+    if (csv == nullptr) {
+      fprintf(stderr, "Failed to create %s\n", options.csv.c_str());
+      return 1;
+    }
+    fputs("loop,frame_id,timestamp_us,skipped,preprocess_ms,inference_ms,"
+          "nms_ms,track_ms,total_ms,detections,tracks\n",
+          csv);
+  }
+
+  kiosk_vision::TilingConfig tiling;
+  tiling.mode = options.tiling;
+  engine.SetTiling(tiling);
+
+  Report report;
+  int loop = 0;
+  auto on_result = [&](const kiosk_vision::DetectionResult& result) {
+    std::lock_guard<std::mutex> lock(mutex);
+    busy = false;
+    done.notify_all();
+    if (!result.ok) {
+      report.errors++;
+      report.last_error = result.error;
+      return;
+    }
+    const kiosk_vision::StageTimings& timings = result.timings;
+    if (result.skipped) {
+      report.frames_gated++;
+    } else {
+      report.frames_run++;
+      report.preprocess_ms.push_back(timings.preprocess_ms);
+      report.inference_ms.push_back(timings.inference_ms);
+      report.nms_ms.push_back(timings.parse_ms - timings.track_ms);
+      if (result.tracking) {
+        report.track_ms.push_back(timings.track_ms);
+      }
+      report.total_ms.push_back(timings.total_ms);
+      report.detections += static_cast<int>(result.detections.size());
+      for (const kiosk_vision::Detection& detection : result.detections) {
+        report.detections_per_class[detection.class_id]++;
+      }
+    }
+    report.max_tracks =
+        std::max(report.max_tracks, static_cast<int>(result.tracks.size()));
+    if (csv != nullptr) {
+      fprintf(csv, "%d,%llu,%lld,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%zu,%zu\n", loop,
+              static_cast<unsigned long long>(result.frame_id),
+              static_cast<long long>(result.timestamp_us),
+              result.skipped ? 1 : 0, timings.preprocess_ms,
+              timings.inference_ms, timings.parse_ms - timings.track_ms,
+              timings.track_ms, timings.total_ms, result.detections.size(),
+              result.tracks.size());
+    }
+  };
+
+  int frames_read = 0;
+  int frames_skipped_busy = 0;
+  const Clock::time_point run_start = Clock::now();
+  for (loop = 0; loop < options.loops; ++loop) {
+    // Each pass starts from a fresh tracker and background, so every loop
+    // sees the same pipeline state.
+    kiosk_vision::TrackerConfig tracker;
+    tracker.enabled = options.tracking;
+    engine.SetPostprocess(kiosk_vision::PostprocessConfig(), tracker);
+    kiosk_vision::MotionGateConfig motion;
+    motion.enabled = options.motion;
+    engine.SetMotionGate(motion);
+
+    reader.Rewind();
+    const Clock::time_point loop_start = Clock::now();
+    int64_t first_timestamp_us = -1;
+    kiosk_vision::RecordedFrame recorded;
+    while (reader.Next(&recorded, &error)) {
+      frames_read++;
+      if (first_timestamp_us < 0) {
+        first_timestamp_us = recorded.timestamp_us;
+      }
+      if (options.realtime) {
+        std::this_thread::sleep_until(
+            loop_start + std::chrono::microseconds(recorded.timestamp_us -
+                                                   first_timestamp_us));
+      }
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (options.realtime && busy) {
+          frames_skipped_busy++;
+          continue;
+        }
+        busy = true;
+      }
+
+      kiosk_vision::Frame frame;
+      frame.width = recorded.width;
+      frame.height = recorded.height;
+      frame.stride = recorded.width * 3;
+      frame.format = kiosk_vision::PixelFormat::kRgb;
+      frame.timestamp_us = recorded.timestamp_us;
+      frame.pixels = std::move(recorded.pixels);
+      engine.Detect(std::move(frame), options.threshold, on_result);
+
+      if (!options.realtime) {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]() { return !busy; });
+      }
+    }
+    if (!error.empty()) {
+      fprintf(stderr, "%s\n", error.c_str());
+      break;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&]() { return !busy; });
+  }
+  const double wall_s =
+      std::chrono::duration<double>(Clock::now() - run_start).count();
+  if (csv != nullptr) {
+    fclose(csv);
+  }
+
+  printf("\nFrames: %d read, %d inferred, %d gated by motion, %d skipped "
+         "while busy, %d errors\n",
+         frames_read, report.frames_run, report.frames_gated,
+         frames_skipped_busy, report.errors);
+  if (!report.last_error.empty()) {
+    printf("Last error: %s\n", report.last_error.c_str());
+  }
+  printf("Wall time %.2f s, %.1f inferred frames/s\n", wall_s,
+         wall_s > 0 ? report.frames_run / wall_s : 0);
+  printf("Detections: %d (%.2f per inferred frame), at most %d tracks\n",
+         report.detections,
+         report.frames_run > 0
+             ? static_cast<double>(report.detections) / report.frames_run
+             : 0,
+         report.max_tracks);
+  for (const auto& entry : report.detections_per_class) {
+    printf("  class %3d: %d\n", entry.first, entry.second);
+  }
+
+  PrintHistogram("Preprocess", report.preprocess_ms);
+  PrintHistogram("Inference", report.inference_ms);
+  PrintHistogram("Decode + NMS", report.nms_ms);
+  PrintHistogram("Tracking", report.track_ms);
+  PrintHistogram("Total", report.total_ms);
+  return report.errors > 0 || !error.empty() ? 1 : 0;
+}
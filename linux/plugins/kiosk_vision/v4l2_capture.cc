@@ -0,0 +1,585 @@
+#include "v4l2_capture.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace kiosk_vision {
+
+namespace {
+
+// Enough to keep the driver streaming while one buffer is being converted.
+const uint32_t kBufferCount = 4;
+const int kPollTimeoutMs = 1000;
+
+int Xioctl(int fd, unsigned long request, void* arg) {
+  int result;
+  do {
+    result = ioctl(fd, request, arg);
+  } while (result == -1 && errno == EINTR);
+  return result;
+}
+
+std::string ErrnoMessage(const std::string& what) {
+  return what + ": " + strerror(errno);
+}
+
+int64_t MonotonicMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint32_t FourccFor(CaptureFormat format) {
+  switch (format) {
+    case CaptureFormat::kYuyv:
+      return V4L2_PIX_FMT_YUYV;
+    case CaptureFormat::kNv12:
+      return V4L2_PIX_FMT_NV12;
+    case CaptureFormat::kMjpeg:
+      return V4L2_PIX_FMT_MJPEG;
+    case CaptureFormat::kAuto:
+    default:
+      return 0;
+  }
+}
+
+const char* FourccName(uint32_t fourcc) {
+  switch (fourcc) {
+    case V4L2_PIX_FMT_YUYV:
+      return "yuyv";
+    case V4L2_PIX_FMT_NV12:
+      return "nv12";
+    case V4L2_PIX_FMT_MJPEG:
+      return "mjpeg";
+    default:
+      return "unknown";
+  }
+}
+
+// Picks the capture format. Uncompressed formats come first because they
+// convert far cheaper than an MJPEG decode at detection resolutions.
+uint32_t ChooseFourcc(int fd, CaptureFormat requested) {
+  std::vector<uint32_t> offered;
+  v4l2_fmtdesc desc;
+  memset(&desc, 0, sizeof(desc));
+  desc.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  while (Xioctl(fd, VIDIOC_ENUM_FMT, &desc) == 0) {
+    offered.push_back(desc.pixelformat);
+    desc.index++;
+  }
+
+  const uint32_t wanted = FourccFor(requested);
+  if (wanted != 0) {
+    return std::find(offered.begin(), offered.end(), wanted) != offered.end()
+               ? wanted
+               : 0;
+  }
+  for (uint32_t candidate :
+       {static_cast<uint32_t>(V4L2_PIX_FMT_YUYV),
+        static_cast<uint32_t>(V4L2_PIX_FMT_NV12),
+        static_cast<uint32_t>(V4L2_PIX_FMT_MJPEG)}) {
+    if (std::find(offered.begin(), offered.end(), candidate) !=
+        offered.end()) {
+      return candidate;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+std::vector<CameraDevice> ListCameras() {
+  std::vector<CameraDevice> cameras;
+  DIR* dir = opendir("/dev");
+  if (dir == nullptr) {
+    return cameras;
+  }
+  while (dirent* entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "video", 5) != 0) {
+      continue;
+    }
+    const std::string path = std::string("/dev/") + entry->d_name;
+    const int fd = open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    v4l2_capability caps;
+    memset(&caps, 0, sizeof(caps));
+    if (Xioctl(fd, VIDIOC_QUERYCAP, &caps) == 0) {
+      const uint32_t device_caps = (caps.capabilities & V4L2_CAP_DEVICE_CAPS)
+                                       ? caps.device_caps
+                                       : caps.capabilities;
+      if ((device_caps & V4L2_CAP_VIDEO_CAPTURE) &&
+          (device_caps & V4L2_CAP_STREAMING)) {
+        CameraDevice camera;
+        camera.path = path;
+        camera.name = reinterpret_cast<const char*>(caps.card);
+        camera.bus_info = reinterpret_cast<const char*>(caps.bus_info);
+        cameras.push_back(camera);
+      }
+    }
+    close(fd);
+  }
+  closedir(dir);
+  std::sort(cameras.begin(), cameras.end(),
+            [](const CameraDevice& a, const CameraDevice& b) {
+              return a.path < b.path;
+            });
+  return cameras;
+}
+
+V4l2Capture::V4l2Capture(FrameRing* ring) {
+  if (ring != nullptr) {
+    primary_output_ = AddOutput(ring, 0, 0, 0);
+  }
+}
+
+V4l2Capture::~V4l2Capture() {
+  Stop();
+}
+
+void V4l2Capture::SetJpegDecoder(JpegDecoder decoder) {
+  jpeg_decoder_ = std::move(decoder);
+}
+
+bool V4l2Capture::Start(const CaptureConfig& config, std::string* error) {
+  Stop();
+  if (!OpenDevice(config, error)) {
+    CloseDevice();
+    return false;
+  }
+
+  SetPublishing(config.publish_fps, config.publish_width,
+                config.publish_height);
+  {
+    std::lock_guard<std::mutex> lock(outputs_mutex_);
+    for (const std::unique_ptr<Output>& output : outputs_) {
+      output->last_publish_us = 0;
+    }
+  }
+  running_ = true;
+  thread_ = std::thread(&V4l2Capture::CaptureLoop, this);
+  return true;
+}
+
+void V4l2Capture::SetPublishing(double publish_fps, int publish_width,
+                                int publish_height) {
+  if (primary_output_ != 0) {
+    UpdateOutput(primary_output_, publish_fps, publish_width,
+                 publish_height);
+  }
+}
+
+int V4l2Capture::AddOutput(FrameRing* ring, double publish_fps,
+                           int publish_width, int publish_height) {
+  std::unique_ptr<Output> output(new Output());
+  output->ring = ring;
+  int id = 0;
+  {
+    std::lock_guard<std::mutex> lock(outputs_mutex_);
+    id = next_output_id_++;
+    output->id = id;
+    outputs_.push_back(std::move(output));
+  }
+  UpdateOutput(id, publish_fps, publish_width, publish_height);
+  return id;
+}
+
+bool V4l2Capture::UpdateOutput(int id, double publish_fps, int publish_width,
+                               int publish_height) {
+  std::lock_guard<std::mutex> lock(outputs_mutex_);
+  for (const std::unique_ptr<Output>& output : outputs_) {
+    if (output->id == id) {
+      output->interval_us =
+          publish_fps > 0 ? static_cast<int64_t>(1000000.0 / publish_fps)
+                          : 0;
+      const bool sized = publish_width > 0 && publish_height > 0;
+      output->width = sized ? publish_width : 0;
+      output->height = sized ? publish_height : 0;
+      return true;
+    }
+  }
+  return false;
+}
+
+void V4l2Capture::RemoveOutput(int id) {
+  std::lock_guard<std::mutex> lock(outputs_mutex_);
+  outputs_.erase(std::remove_if(outputs_.begin(), outputs_.end(),
+                                [id](const std::unique_ptr<Output>& output) {
+                                  return output->id == id;
+                                }),
+                 outputs_.end());
+  if (id == primary_output_) {
+    primary_output_ = 0;
+  }
+}
+
+int V4l2Capture::output_count() const {
+  std::lock_guard<std::mutex> lock(outputs_mutex_);
+  return static_cast<int>(outputs_.size());
+}
+
+void V4l2Capture::OutputSize(const Output& output, int width, int height,
+                             int* output_width, int* output_height) {
+  const bool sized = output.width > 0 && output.height > 0;
+  *output_width = sized ? std::min(output.width, width) : width;
+  *output_height = sized ? std::min(output.height, height) : height;
+}
+
+void V4l2Capture::FillOutputStats(const Output& output,
+                                  CaptureStats* stats) const {
+  if (!stats->device.empty()) {
+    OutputSize(output, stats->width, stats->height, &stats->publish_width,
+               &stats->publish_height);
+  }
+  stats->frames_published = output.frames_published;
+}
+
+void V4l2Capture::Stop() {
+  if (thread_.joinable()) {
+    running_ = false;
+    const uint64_t one = 1;
+    if (write(wake_fd_, &one, sizeof(one)) < 0) {
+      // The poll timeout still ends the loop.
+    }
+    thread_.join();
+  }
+  running_ = false;
+  CloseDevice();
+}
+
+CaptureStats V4l2Capture::stats() const {
+  return output_stats(primary_output_);
+}
+
+CaptureStats V4l2Capture::output_stats(int id) const {
+  CaptureStats stats;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats = stats_;
+  }
+  stats.running = running_.load();
+  // With no such output, frames_published counts frames any output got.
+  std::lock_guard<std::mutex> lock(outputs_mutex_);
+  for (const std::unique_ptr<Output>& output : outputs_) {
+    if (output->id == id) {
+      FillOutputStats(*output, &stats);
+    }
+  }
+  return stats;
+}
+
+bool V4l2Capture::OpenDevice(const CaptureConfig& config,
+                             std::string* error) {
+  fd_ = open(config.device.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (fd_ < 0) {
+    *error = ErrnoMessage("Cannot open " + config.device);
+    return false;
+  }
+  wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wake_fd_ < 0) {
+    *error = ErrnoMessage("eventfd");
+    return false;
+  }
+
+  v4l2_capability caps;
+  memset(&caps, 0, sizeof(caps));
+  if (Xioctl(fd_, VIDIOC_QUERYCAP, &caps) < 0) {
+    *error = ErrnoMessage("VIDIOC_QUERYCAP");
+    return false;
+  }
+  const uint32_t device_caps = (caps.capabilities & V4L2_CAP_DEVICE_CAPS)
+                                   ? caps.device_caps
+                                   : caps.capabilities;
+  if (!(device_caps & V4L2_CAP_VIDEO_CAPTURE) ||
+      !(device_caps & V4L2_CAP_STREAMING)) {
+    *error = config.device + " is not a streaming capture device";
+    return false;
+  }
+
+  const uint32_t fourcc = ChooseFourcc(fd_, config.format);
+  if (fourcc == 0) {
+    *error = config.device + " offers none of the requested formats";
+    return false;
+  }
+  if (fourcc == V4L2_PIX_FMT_MJPEG && !jpeg_decoder_) {
+    *error = "MJPEG capture needs a JPEG decoder";
+    return false;
+  }
+
+  v4l2_format format;
+  memset(&format, 0, sizeof(format));
+  format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  format.fmt.pix.width = config.width;
+  format.fmt.pix.height = config.height;
+  format.fmt.pix.pixelformat = fourcc;
+  format.fmt.pix.field = V4L2_FIELD_NONE;
+  if (Xioctl(fd_, VIDIOC_S_FMT, &format) < 0) {
+    *error = ErrnoMessage("VIDIOC_S_FMT");
+    return false;
+  }
+  // The driver may adjust the size, and in rare cases the format.
+  if (format.fmt.pix.pixelformat != fourcc) {
+    *error = "Driver rejected pixel format " + std::string(FourccName(fourcc));
+    return false;
+  }
+  fourcc_ = fourcc;
+  width_ = static_cast<int>(format.fmt.pix.width);
+  height_ = static_cast<int>(format.fmt.pix.height);
+  bytes_per_line_ = static_cast<int>(format.fmt.pix.bytesperline);
+  if (bytes_per_line_ == 0) {
+    bytes_per_line_ = fourcc == V4L2_PIX_FMT_YUYV ? width_ * 2 : width_;
+  }
+
+  // Frame rate is best effort; not every driver supports it.
+  double fps = 0;
+  v4l2_streamparm parm;
+  memset(&parm, 0, sizeof(parm));
+  parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (config.fps > 0 && Xioctl(fd_, VIDIOC_G_PARM, &parm) == 0 &&
+      (parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) {
+    parm.parm.capture.timeperframe.numerator = 1;
+    parm.parm.capture.timeperframe.denominator = config.fps;
+    Xioctl(fd_, VIDIOC_S_PARM, &parm);
+  }
+  if (Xioctl(fd_, VIDIOC_G_PARM, &parm) == 0 &&
+      parm.parm.capture.timeperframe.numerator != 0) {
+    fps = static_cast<double>(parm.parm.capture.timeperframe.denominator) /
+          parm.parm.capture.timeperframe.numerator;
+  }
+
+  v4l2_requestbuffers request;
+  memset(&request, 0, sizeof(request));
+  request.count = kBufferCount;
+  request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  request.memory = V4L2_MEMORY_MMAP;
+  if (Xioctl(fd_, VIDIOC_REQBUFS, &request) < 0 || request.count < 2) {
+    *error = ErrnoMessage("VIDIOC_REQBUFS");
+    return false;
+  }
+
+  buffers_.resize(request.count);
+  for (uint32_t i = 0; i < request.count; ++i) {
+    v4l2_buffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    buffer.index = i;
+    if (Xioctl(fd_, VIDIOC_QUERYBUF, &buffer) < 0) {
+      *error = ErrnoMessage("VIDIOC_QUERYBUF");
+      return false;
+    }
+    void* data = mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd_, buffer.m.offset);
+    if (data == MAP_FAILED) {
+      *error = ErrnoMessage("mmap");
+      return false;
+    }
+    buffers_[i].data = data;
+    buffers_[i].length = buffer.length;
+    if (Xioctl(fd_, VIDIOC_QBUF, &buffer) < 0) {
+      *error = ErrnoMessage("VIDIOC_QBUF");
+      return false;
+    }
+  }
+
+  v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (Xioctl(fd_, VIDIOC_STREAMON, &type) < 0) {
+    *error = ErrnoMessage("VIDIOC_STREAMON");
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(stats_mutex_);
+  stats_ = CaptureStats();
+  stats_.device = config.device;
+  stats_.format = FourccName(fourcc_);
+  stats_.width = width_;
+  stats_.height = height_;
+  stats_.convert_kernel = YuvConverter().kernel_name();
+  stats_.fps = fps;
+  return true;
+}
+
+void V4l2Capture::CloseDevice() {
+  if (fd_ >= 0) {
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    Xioctl(fd_, VIDIOC_STREAMOFF, &type);
+  }
+  for (const MappedBuffer& buffer : buffers_) {
+    if (buffer.data != nullptr) {
+      munmap(buffer.data, buffer.length);
+    }
+  }
+  buffers_.clear();
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  if (wake_fd_ >= 0) {
+    close(wake_fd_);
+    wake_fd_ = -1;
+  }
+}
+
+void V4l2Capture::CaptureLoop() {
+  pollfd fds[2];
+  fds[0].fd = fd_;
+  fds[0].events = POLLIN;
+  fds[1].fd = wake_fd_;
+  fds[1].events = POLLIN;
+
+  while (running_) {
+    fds[0].revents = 0;
+    fds[1].revents = 0;
+    const int ready = poll(fds, 2, kPollTimeoutMs);
+    if (ready < 0 && errno != EINTR) {
+      break;
+    }
+    if (!running_ || (fds[1].revents & POLLIN)) {
+      break;
+    }
+    if (fds[0].revents & (POLLERR | POLLHUP)) {
+      // Camera unplugged.
+      break;
+    }
+    if (!(fds[0].revents & POLLIN)) {
+      continue;
+    }
+
+    v4l2_buffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    if (Xioctl(fd_, VIDIOC_DQBUF, &buffer) < 0) {
+      if (errno == EAGAIN) {
+        continue;
+      }
+      break;
+    }
+
+    int64_t timestamp_us = MonotonicMicros();
+    if ((buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) ==
+        V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+      timestamp_us = static_cast<int64_t>(buffer.timestamp.tv_sec) * 1000000 +
+                     buffer.timestamp.tv_usec;
+    }
+
+    bool published = false;
+    bool failed = buffer.flags & V4L2_BUF_FLAG_ERROR;
+    if (!failed) {
+      const MappedBuffer& mapped = buffers_[buffer.index];
+      failed = !PublishFrame(static_cast<const uint8_t*>(mapped.data),
+                             std::min<size_t>(buffer.bytesused, mapped.length),
+                             timestamp_us, &published);
+    }
+
+    // Hand the buffer straight back so the driver never runs dry.
+    Xioctl(fd_, VIDIOC_QBUF, &buffer);
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.frames_captured++;
+    stats_.frames_published += published ? 1 : 0;
+    stats_.frames_failed += failed ? 1 : 0;
+  }
+  running_ = false;
+}
+
+bool V4l2Capture::PublishFrame(const uint8_t* data, size_t size,
+                               int64_t timestamp_us, bool* published) {
+  std::lock_guard<std::mutex> lock(outputs_mutex_);
+  // Outputs due for this frame; a clock that went backwards counts as due.
+  std::vector<Output*> due;
+  for (const std::unique_ptr<Output>& output : outputs_) {
+    if (output->interval_us == 0 || output->last_publish_us == 0 ||
+        timestamp_us < output->last_publish_us ||
+        timestamp_us - output->last_publish_us >= output->interval_us) {
+      due.push_back(output.get());
+    }
+  }
+  if (due.empty()) {
+    return true;
+  }
+
+  YuvImage image;
+  if (fourcc_ == V4L2_PIX_FMT_MJPEG) {
+    // Decoded once, however many outputs want it.
+    std::string error;
+    if (!jpeg_decoder_(data, size, &jpeg_frame_, &error)) {
+      return false;
+    }
+  } else {
+    const YuvFormat format = fourcc_ == V4L2_PIX_FMT_NV12 ? YuvFormat::kNv12
+                                                          : YuvFormat::kYuyv;
+    if (!WrapYuvBuffer(data, size, format, width_, height_, bytes_per_line_,
+                       &image)) {
+      return false;
+    }
+  }
+
+  bool ok = true;
+  for (Output* output : due) {
+    if (PublishToOutput(fourcc_ == V4L2_PIX_FMT_MJPEG ? nullptr : &image,
+                        output, timestamp_us)) {
+      output->last_publish_us = timestamp_us;
+      output->frames_published++;
+      *published = true;
+    } else {
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool V4l2Capture::PublishToOutput(const YuvImage* image, Output* output,
+                                  int64_t timestamp_us) {
+  if (image == nullptr) {
+    int output_width = 0;
+    int output_height = 0;
+    OutputSize(*output, jpeg_frame_.width, jpeg_frame_.height, &output_width,
+               &output_height);
+    const int bytes_per_pixel =
+        jpeg_frame_.format == PixelFormat::kRgb ? 3 : 4;
+    const int stride = output_width * bytes_per_pixel;
+    uint8_t* out = output->ring->BeginWrite(output_width, output_height,
+                                            stride, jpeg_frame_.format);
+    if (out == nullptr) {
+      return false;
+    }
+    ImageView view;
+    view.data = jpeg_frame_.pixels.data();
+    view.width = jpeg_frame_.width;
+    view.height = jpeg_frame_.height;
+    view.stride = jpeg_frame_.stride;
+    view.format = jpeg_frame_.format;
+    ResamplePacked(view, out, stride, output_width, output_height);
+    output->ring->CommitWrite(timestamp_us);
+    return true;
+  }
+
+  int output_width = 0;
+  int output_height = 0;
+  OutputSize(*output, width_, height_, &output_width, &output_height);
+  const int stride = output_width * 4;
+  uint8_t* out = output->ring->BeginWrite(output_width, output_height, stride,
+                                          PixelFormat::kRgba);
+  if (out == nullptr) {
+    return false;
+  }
+  output->converter.Convert(*image, out, stride, output_width, output_height,
+                            PixelFormat::kRgba);
+  output->ring->CommitWrite(timestamp_us);
+  return true;
+}
+
+}  // namespace kiosk_vision
@@ -0,0 +1,188 @@
+#ifndef PLUGINS_KIOSK_VISION_V4L2_CAPTURE_H_
+#define PLUGINS_KIOSK_VISION_V4L2_CAPTURE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "color_convert.h"
+#include "detection_engine.h"
+#include "frame_ring.h"
+
+namespace kiosk_vision {
+
+// A V4L2 node that can capture video.
+struct CameraDevice {
+  std::string path;      // e.g. /dev/video0
+  std::string name;      // Driver card name.
+  std::string bus_info;  // What libwebrtc reports as the device unique id.
+};
+
+// Lists capture-capable /dev/video* nodes, skipping metadata-only nodes.
+std::vector<CameraDevice> ListCameras();
+
+enum class CaptureFormat {
+  kAuto,  // First of YUYV, NV12, MJPEG the driver offers.
+  kYuyv,
+  kNv12,
+  kMjpeg,
+};
+
+struct CaptureConfig {
+  std::string device = "/dev/video0";
+  int width = 640;
+  int height = 480;
+  int fps = 15;
+  CaptureFormat format = CaptureFormat::kAuto;
+  // Frames are dequeued at the driver rate but only converted and published
+  // into the ring at most this often; 0 publishes every frame.
+  double publish_fps = 5;
+  // Size of the frames published into the ring; 0 keeps the capture size.
+  // YUV frames are downscaled during color conversion, MJPEG frames are
+  // point-sampled after decoding.
+  int publish_width = 0;
+  int publish_height = 0;
+};
+
+struct CaptureStats {
+  bool running = false;
+  std::string device;
+  std::string format;
+  int width = 0;
+  int height = 0;
+  double fps = 0;
+  int publish_width = 0;
+  int publish_height = 0;
+  std::string convert_kernel;
+  uint64_t frames_captured = 0;
+  uint64_t frames_published = 0;
+  uint64_t frames_failed = 0;
+};
+
+// Camera capture straight from V4L2, without the WebRTC stack.
+//
+// Driver buffers are mmap'd and recycled in place; each published frame is
+// converted from the camera format directly into a FrameRing slot on the
+// capture thread, which is the ring's single producer. Only one capture may
+// feed a ring at a time.
+//
+// One capture can feed several rings ("outputs"), each at its own rate and
+// size: YUV frames are converted straight to each output's size, and an
+// MJPEG frame is decoded once and then resampled per output. Frames no
+// output is due for are returned to the driver untouched.
+class V4l2Capture {
+ public:
+  // Decodes one MJPEG frame into packed pixels. Runs on the capture thread.
+  using JpegDecoder = std::function<bool(const uint8_t* data, size_t size,
+                                         Frame* frame, std::string* error)>;
+
+  // The output |ring| is fed with the rate and size from Start() and
+  // SetPublishing(). May be null for a capture fed only through
+  // AddOutput().
+  explicit V4l2Capture(FrameRing* ring);
+  ~V4l2Capture();
+
+  // Disallow copy and assign.
+  V4l2Capture(const V4l2Capture&) = delete;
+  V4l2Capture& operator=(const V4l2Capture&) = delete;
+
+  // Required for MJPEG; must be set before Start().
+  void SetJpegDecoder(JpegDecoder decoder);
+
+  // Opens and configures the device and starts streaming. Restarts if
+  // already running.
+  bool Start(const CaptureConfig& config, std::string* error);
+  void Stop();
+
+  // Changes the publish rate and size of a running capture from the next
+  // frame on, without restarting the stream. Same meaning as the
+  // CaptureConfig fields; also applies to later Start() calls until they
+  // pass their own config.
+  void SetPublishing(double publish_fps, int publish_width,
+                     int publish_height);
+
+  // Adds another destination ring, publishing at most |publish_fps| frames
+  // per second (0 for every frame) at |publish_width| x |publish_height|
+  // (0 for the capture size). Any thread, also while running. Returns the
+  // output id.
+  int AddOutput(FrameRing* ring, double publish_fps, int publish_width,
+                int publish_height);
+  bool UpdateOutput(int id, double publish_fps, int publish_width,
+                    int publish_height);
+  // Returns once the capture thread no longer writes into the ring.
+  void RemoveOutput(int id);
+  int output_count() const;
+
+  bool is_running() const { return running_.load(); }
+  // Device stats, with the publish size and count of the constructor's
+  // ring.
+  CaptureStats stats() const;
+  // Device stats with the publish size and count of output |id|.
+  CaptureStats output_stats(int id) const;
+
+ private:
+  struct MappedBuffer {
+    void* data = nullptr;
+    size_t length = 0;
+  };
+
+  struct Output {
+    int id = 0;
+    FrameRing* ring = nullptr;
+    int64_t interval_us = 0;
+    // Requested size; 0 x 0 for the capture size.
+    int width = 0;
+    int height = 0;
+    int64_t last_publish_us = 0;
+    uint64_t frames_published = 0;
+    // Per output, since its sampling tables are cached for one size.
+    YuvConverter converter;
+  };
+
+  bool OpenDevice(const CaptureConfig& config, std::string* error);
+  void CloseDevice();
+  void CaptureLoop();
+  // Publishes into every output that is due; false if one of them failed.
+  bool PublishFrame(const uint8_t* data, size_t size, int64_t timestamp_us,
+                    bool* published);
+  bool PublishToOutput(const YuvImage* image, Output* output,
+                       int64_t timestamp_us);
+  // Publish size of |output|, clamped to |width| x |height|.
+  static void OutputSize(const Output& output, int width, int height,
+                         int* output_width, int* output_height);
+  void FillOutputStats(const Output& output, CaptureStats* stats) const;
+
+  JpegDecoder jpeg_decoder_;
+
+  int fd_ = -1;
+  int wake_fd_ = -1;
+  std::vector<MappedBuffer> buffers_;
+  uint32_t fourcc_ = 0;
+  int width_ = 0;
+  int height_ = 0;
+  int bytes_per_line_ = 0;
+  Frame jpeg_frame_;
+
+  // Guards |outputs_|; held by the capture thread while it publishes.
+  mutable std::mutex outputs_mutex_;
+  std::vector<std::unique_ptr<Output>> outputs_;
+  int next_output_id_ = 1;
+  // Output of the constructor's ring, or 0.
+  std::atomic<int> primary_output_{0};
+
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+
+  mutable std::mutex stats_mutex_;
+  CaptureStats stats_;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_V4L2_CAPTURE_H_
@@ -0,0 +1,36 @@
+#include "webrtc_frame_sink.h"
+
+#include <chrono>
+
+namespace kiosk_vision {
+
+WebRtcFrameSink::WebRtcFrameSink(libwebrtc::RTCVideoTrack* track,
+                                 FrameRing* ring)
+    : track_(track), ring_(ring) {
+  track_->AddRenderer(this);
+}
+
+WebRtcFrameSink::~WebRtcFrameSink() {
+  track_->RemoveRenderer(this);
+}
+
+void WebRtcFrameSink::OnFrame(
+    libwebrtc::scoped_refptr<libwebrtc::RTCVideoFrame> frame) {
+  const int width = frame->width();
+  const int height = frame->height();
+  const int stride = width * 4;
+  uint8_t* pixels =
+      ring_->BeginWrite(width, height, stride, PixelFormat::kRgba);
+  if (pixels == nullptr) {
+    return;
+  }
+  // libyuv names formats by 32-bit word order, so "ABGR" is R, G, B, A in
+  // memory.
+  frame->ConvertToARGB(libwebrtc::RTCVideoFrame::Type::kABGR, pixels, stride,
+                       width, height);
+  ring_->CommitWrite(std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch())
+                         .count());
+}
+
+}  // namespace kiosk_vision
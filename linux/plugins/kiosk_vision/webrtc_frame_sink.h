@@ -0,0 +1,43 @@
+#ifndef PLUGINS_KIOSK_VISION_WEBRTC_FRAME_SINK_H_
+#define PLUGINS_KIOSK_VISION_WEBRTC_FRAME_SINK_H_
+
+#include <rtc_video_frame.h>
+#include <rtc_video_renderer.h>
+#include <rtc_video_track.h>
+
+#include "frame_ring.h"
+
+namespace kiosk_vision {
+
+using RtcFrameRenderer = libwebrtc::RTCVideoRenderer<
+    libwebrtc::scoped_refptr<libwebrtc::RTCVideoFrame>>;
+
+// Renderer attached to a flutter_webrtc (libwebrtc wrapper) video track that
+// converts each decoded I420 frame straight into a FrameRing slot, so the
+// detector never sees an encoded or Dart-owned copy of the frame.
+//
+// OnFrame() runs on the WebRTC worker thread, which is the ring's single
+// producer.
+class WebRtcFrameSink : public RtcFrameRenderer {
+ public:
+  // Adds itself as a renderer of |track|; removed again on destruction.
+  WebRtcFrameSink(libwebrtc::RTCVideoTrack* track, FrameRing* ring);
+  ~WebRtcFrameSink() override;
+
+  // Disallow copy and assign.
+  WebRtcFrameSink(const WebRtcFrameSink&) = delete;
+  WebRtcFrameSink& operator=(const WebRtcFrameSink&) = delete;
+
+  void OnFrame(
+      libwebrtc::scoped_refptr<libwebrtc::RTCVideoFrame> frame) override;
+
+  libwebrtc::RTCVideoTrack* track() const { return track_.get(); }
+
+ private:
+  libwebrtc::scoped_refptr<libwebrtc::RTCVideoTrack> track_;
+  FrameRing* ring_;
+};
+
+}  // namespace kiosk_vision
+
+#endif  // PLUGINS_KIOSK_VISION_WEBRTC_FRAME_SINK_H_
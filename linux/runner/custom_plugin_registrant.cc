@@ -1,5 +1,22 @@
 #include "custom_plugin_registrant.h"
 
+#include <kiosk_audio/kiosk_audio_plugin.h>
+#include <kiosk_mqtt/kiosk_mqtt_plugin.h>
+#include <kiosk_system/kiosk_system_plugin.h>
+#include <kiosk_vision/kiosk_vision_plugin.h>
+
 void register_custom_plugins(FlPluginRegistry* registry) {
-  // No custom plugins to register
+  g_autoptr(FlPluginRegistrar) kiosk_audio_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, "KioskAudioPlugin");
+  kiosk_audio_plugin_register_with_registrar(kiosk_audio_registrar);
+  g_autoptr(FlPluginRegistrar) kiosk_mqtt_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, "KioskMqttPlugin");
+  kiosk_mqtt_plugin_register_with_registrar(kiosk_mqtt_registrar);
+  g_autoptr(FlPluginRegistrar) kiosk_system_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry,
+                                                  "KioskSystemPlugin");
+  kiosk_system_plugin_register_with_registrar(kiosk_system_registrar);
+  g_autoptr(FlPluginRegistrar) kiosk_vision_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(registry, "KioskVisionPlugin");
+  kiosk_vision_plugin_register_with_registrar(kiosk_vision_registrar);
 }
@@ -0,0 +1,202 @@
+#include "frame_clock_monitor.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace kiosk_runner {
+
+namespace {
+
+const char kChannelName[] = "com.ki.king_kiosk/frame_timing";
+
+int64_t lookup_int(FlValue* args, const char* key, int64_t fallback) {
+  if (args == nullptr || fl_value_get_type(args) != FL_VALUE_TYPE_MAP) {
+    return fallback;
+  }
+  FlValue* value = fl_value_lookup_string(args, key);
+  return value != nullptr && fl_value_get_type(value) == FL_VALUE_TYPE_INT
+             ? fl_value_get_int(value)
+             : fallback;
+}
+
+void set_int(FlValue* map, const char* key, int64_t value) {
+  fl_value_set_string_take(map, key, fl_value_new_int(value));
+}
+
+void set_float(FlValue* map, const char* key, double value) {
+  fl_value_set_string_take(map, key, fl_value_new_float(value));
+}
+
+double ms(int64_t us) {
+  return static_cast<double>(us) / 1000.0;
+}
+
+FlValue* histogram_to_value(const LatencyHistogram& histogram) {
+  FlValue* map = fl_value_new_map();
+  set_int(map, "count", static_cast<int64_t>(histogram.count()));
+  set_float(map, "minMs", ms(histogram.min_us()));
+  set_float(map, "meanMs", histogram.mean_us() / 1000.0);
+  set_float(map, "p50Ms", ms(histogram.ValueAtPercentile(50)));
+  set_float(map, "p90Ms", ms(histogram.ValueAtPercentile(90)));
+  set_float(map, "p99Ms", ms(histogram.ValueAtPercentile(99)));
+  set_float(map, "p999Ms", ms(histogram.ValueAtPercentile(99.9)));
+  set_float(map, "maxMs", ms(histogram.max_us()));
+  return map;
+}
+
+FlValue* timing_set_to_value(const FrameTimingSet& set) {
+  FlValue* map = fl_value_new_map();
+  const int64_t duration_us = set.end_us - set.start_us;
+  set_float(map, "durationMs", ms(duration_us));
+  set_int(map, "frames", static_cast<int64_t>(set.frames));
+  set_int(map, "jankyFrames", static_cast<int64_t>(set.janky_frames));
+  set_int(map, "missedVsyncs", static_cast<int64_t>(set.missed_vsyncs));
+  set_int(map, "idleGaps", static_cast<int64_t>(set.idle_gaps));
+  set_int(map, "presentedFrames", static_cast<int64_t>(set.presented_frames));
+  set_float(map, "fps",
+            duration_us > 0 ? static_cast<double>(set.frames) * 1e6 /
+                                  static_cast<double>(duration_us)
+                            : 0);
+  fl_value_set_string_take(map, "interval", histogram_to_value(set.interval));
+  fl_value_set_string_take(map, "paint", histogram_to_value(set.paint));
+  fl_value_set_string_take(map, "presentLatency",
+                           histogram_to_value(set.present_latency));
+  return map;
+}
+
+}  // namespace
+
+FrameClockMonitor::FrameClockMonitor(GtkWidget* window,
+                                     FlBinaryMessenger* messenger)
+    : recorder_(g_get_monotonic_time()) {
+  GdkFrameClock* clock = gtk_widget_get_frame_clock(window);
+  if (clock != nullptr) {
+    clock_ = GDK_FRAME_CLOCK(g_object_ref(clock));
+    before_paint_handler_ = g_signal_connect(
+        clock_, "before-paint", G_CALLBACK(OnBeforePaint), this);
+    after_paint_handler_ = g_signal_connect(
+        clock_, "after-paint", G_CALLBACK(OnAfterPaint), this);
+    collected_counter_ = gdk_frame_clock_get_frame_counter(clock_);
+  } else {
+    g_warning("Window has no frame clock; frame timings are unavailable");
+  }
+
+  g_autoptr(FlStandardMethodCodec) codec = fl_standard_method_codec_new();
+  channel_ =
+      fl_method_channel_new(messenger, kChannelName, FL_METHOD_CODEC(codec));
+  fl_method_channel_set_method_call_handler(channel_, OnMethodCall, this,
+                                            nullptr);
+}
+
+FrameClockMonitor::~FrameClockMonitor() {
+  if (channel_ != nullptr) {
+    fl_method_channel_set_method_call_handler(channel_, nullptr, nullptr,
+                                              nullptr);
+    g_clear_object(&channel_);
+  }
+  if (clock_ != nullptr) {
+    g_signal_handler_disconnect(clock_, before_paint_handler_);
+    g_signal_handler_disconnect(clock_, after_paint_handler_);
+    g_clear_object(&clock_);
+  }
+}
+
+void FrameClockMonitor::OnBeforePaint(GdkFrameClock* clock,
+                                      gpointer user_data) {
+  static_cast<FrameClockMonitor*>(user_data)->paint_start_us_ =
+      g_get_monotonic_time();
+}
+
+void FrameClockMonitor::OnAfterPaint(GdkFrameClock* clock,
+                                     gpointer user_data) {
+  FrameClockMonitor* self = static_cast<FrameClockMonitor*>(user_data);
+  const int64_t now_us = g_get_monotonic_time();
+  if (self->paint_start_us_ > 0) {
+    self->recorder_.RecordPaint(now_us - self->paint_start_us_, now_us);
+    self->paint_start_us_ = 0;
+  }
+  self->CollectCompletedFrames();
+}
+
+void FrameClockMonitor::CollectCompletedFrames() {
+  if (clock_ == nullptr) {
+    return;
+  }
+  const int64_t now_us = g_get_monotonic_time();
+  const int64_t current = gdk_frame_clock_get_frame_counter(clock_);
+  const int64_t history_start = gdk_frame_clock_get_history_start(clock_);
+  if (history_start > collected_counter_ + 1) {
+    // GDK keeps a short history; frames older than it are lost.
+    recorder_.Discontinue();
+    collected_counter_ = history_start - 1;
+  }
+  for (int64_t counter = collected_counter_ + 1; counter <= current;
+       ++counter) {
+    GdkFrameTimings* timings = gdk_frame_clock_get_timings(clock_, counter);
+    if (timings == nullptr || !gdk_frame_timings_get_complete(timings)) {
+      break;
+    }
+    FrameTimes frame;
+    frame.frame_time_us = gdk_frame_timings_get_frame_time(timings);
+    frame.presentation_time_us =
+        gdk_frame_timings_get_presentation_time(timings);
+    frame.refresh_interval_us =
+        gdk_frame_timings_get_refresh_interval(timings);
+    if (frame.refresh_interval_us == 0) {
+      // The frame clock's estimate, 60 Hz unless the backend knows better.
+      gint64 refresh_interval_us = 0;
+      gint64 presentation_us = 0;
+      gdk_frame_clock_get_refresh_info(clock_, frame.frame_time_us,
+                                       &refresh_interval_us,
+                                       &presentation_us);
+      frame.refresh_interval_us = refresh_interval_us;
+    }
+    recorder_.RecordFrame(frame, now_us);
+    collected_counter_ = counter;
+  }
+}
+
+FlValue* FrameClockMonitor::TimingsToValue() {
+  CollectCompletedFrames();
+  recorder_.Update(g_get_monotonic_time());
+  FlValue* map = fl_value_new_map();
+  set_int(map, "refreshIntervalUs", recorder_.refresh_interval_us());
+  set_int(map, "windowMs", recorder_.config().window_ms);
+  set_int(map, "idleGapMs", recorder_.config().idle_gap_ms);
+  fl_value_set_string_take(map, "window",
+                           timing_set_to_value(recorder_.last_window()));
+  fl_value_set_string_take(map, "total",
+                           timing_set_to_value(recorder_.total()));
+  return map;
+}
+
+void FrameClockMonitor::OnMethodCall(FlMethodChannel* channel,
+                                     FlMethodCall* method_call,
+                                     gpointer user_data) {
+  FrameClockMonitor* self = static_cast<FrameClockMonitor*>(user_data);
+  const gchar* method = fl_method_call_get_name(method_call);
+  FlValue* args = fl_method_call_get_args(method_call);
+
+  if (strcmp(method, "getFrameTimings") == 0) {
+    g_autoptr(FlValue) value = self->TimingsToValue();
+    fl_method_call_respond_success(method_call, value, nullptr);
+  } else if (strcmp(method, "configureFrameTimings") == 0) {
+    FrameTimingConfig config = self->recorder_.config();
+    config.window_ms =
+        static_cast<int>(lookup_int(args, "windowMs", config.window_ms));
+    config.idle_gap_ms =
+        static_cast<int>(lookup_int(args, "idleGapMs", config.idle_gap_ms));
+    self->recorder_.Configure(config, g_get_monotonic_time());
+    g_autoptr(FlValue) value = self->TimingsToValue();
+    fl_method_call_respond_success(method_call, value, nullptr);
+  } else if (strcmp(method, "resetFrameTimings") == 0) {
+    // Frames painted before the reset are not counted after it.
+    self->CollectCompletedFrames();
+    self->recorder_.Reset(g_get_monotonic_time());
+    fl_method_call_respond_success(method_call, nullptr, nullptr);
+  } else {
+    fl_method_call_respond_not_implemented(method_call, nullptr);
+  }
+}
+
+}  // namespace kiosk_runner
@@ -0,0 +1,53 @@
+#ifndef RUNNER_FRAME_CLOCK_MONITOR_H_
+#define RUNNER_FRAME_CLOCK_MONITOR_H_
+
+#include <flutter_linux/flutter_linux.h>
+#include <gtk/gtk.h>
+
+#include <cstdint>
+
+#include "frame_timings.h"
+
+namespace kiosk_runner {
+
+// Watches the GdkFrameClock of the top-level window, which is what
+// actually puts Flutter's frames on the glass, and serves the timings on
+// the "com.ki.king_kiosk/frame_timing" method channel.
+//
+// Dart frame callbacks only see the engine's side; compositor stalls,
+// missed vsyncs and slow presents show up here.
+class FrameClockMonitor {
+ public:
+  // |window| must be realized.
+  FrameClockMonitor(GtkWidget* window, FlBinaryMessenger* messenger);
+  ~FrameClockMonitor();
+
+  // Disallow copy and assign.
+  FrameClockMonitor(const FrameClockMonitor&) = delete;
+  FrameClockMonitor& operator=(const FrameClockMonitor&) = delete;
+
+ private:
+  static void OnBeforePaint(GdkFrameClock* clock, gpointer user_data);
+  static void OnAfterPaint(GdkFrameClock* clock, gpointer user_data);
+  static void OnMethodCall(FlMethodChannel* channel,
+                           FlMethodCall* method_call, gpointer user_data);
+
+  // Records the frames whose timings GDK has completed since the last
+  // call; the compositor reports presentation a frame or two late.
+  void CollectCompletedFrames();
+  FlValue* TimingsToValue();
+
+  GdkFrameClock* clock_ = nullptr;
+  gulong before_paint_handler_ = 0;
+  gulong after_paint_handler_ = 0;
+  FlMethodChannel* channel_ = nullptr;
+
+  FrameTimingRecorder recorder_;
+  int64_t paint_start_us_ = 0;
+  // Newest frame counter already recorded.
+  int64_t collected_counter_ = -1;
+};
+
+}  // namespace kiosk_runner
+
+#endif  // RUNNER_FRAME_CLOCK_MONITOR_H_
@@ -0,0 +1,106 @@
+#include "frame_timings.h"
+
+#include <algorithm>
+#include <initializer_list>
+
+namespace kiosk_runner {
+
+void FrameTimingSet::Reset(int64_t now_us) {
+  interval.Reset();
+  paint.Reset();
+  present_latency.Reset();
+  frames = 0;
+  janky_frames = 0;
+  missed_vsyncs = 0;
+  idle_gaps = 0;
+  presented_frames = 0;
+  start_us = now_us;
+  end_us = now_us;
+}
+
+FrameTimingRecorder::FrameTimingRecorder(int64_t now_us) {
+  Reset(now_us);
+}
+
+void FrameTimingRecorder::Configure(const FrameTimingConfig& config,
+                                    int64_t now_us) {
+  config_ = config;
+  config_.window_ms = std::max(config_.window_ms, 1000);
+  config_.idle_gap_ms = std::max(config_.idle_gap_ms, 50);
+  Update(now_us);
+}
+
+void FrameTimingRecorder::RecordPaint(int64_t paint_us, int64_t now_us) {
+  Update(now_us);
+  total_.paint.Record(paint_us);
+  window_.paint.Record(paint_us);
+}
+
+void FrameTimingRecorder::RecordFrame(const FrameTimes& frame,
+                                      int64_t now_us) {
+  Update(now_us);
+  if (frame.refresh_interval_us > 0) {
+    refresh_interval_us_ = frame.refresh_interval_us;
+  }
+  const bool presented = frame.presentation_time_us > 0;
+
+  // On the glass when both frames were presented, otherwise as the frame
+  // clock scheduled them.
+  int64_t interval_us = 0;
+  if (has_previous_) {
+    interval_us = presented && previous_.presentation_time_us > 0
+                      ? frame.presentation_time_us -
+                            previous_.presentation_time_us
+                      : frame.frame_time_us - previous_.frame_time_us;
+  }
+  const bool idle =
+      interval_us > static_cast<int64_t>(config_.idle_gap_ms) * 1000;
+  // Vsyncs this frame took, rounded: 2 or more means it came at least
+  // half a refresh interval late.
+  const int64_t vsyncs =
+      refresh_interval_us_ > 0 && interval_us > 0 && !idle
+          ? (interval_us + refresh_interval_us_ / 2) / refresh_interval_us_
+          : 1;
+
+  for (FrameTimingSet* set : {&total_, &window_}) {
+    set->frames++;
+    if (presented) {
+      set->presented_frames++;
+      if (frame.frame_time_us > 0 &&
+          frame.presentation_time_us >= frame.frame_time_us) {
+        set->present_latency.Record(frame.presentation_time_us -
+                                    frame.frame_time_us);
+      }
+    }
+    if (idle) {
+      set->idle_gaps++;
+    } else if (interval_us > 0) {
+      set->interval.Record(interval_us);
+      if (vsyncs > 1) {
+        set->janky_frames++;
+        set->missed_vsyncs += static_cast<uint64_t>(vsyncs - 1);
+      }
+    }
+  }
+  previous_ = frame;
+  has_previous_ = true;
+}
+
+void FrameTimingRecorder::Reset(int64_t now_us) {
+  total_.Reset(now_us);
+  window_.Reset(now_us);
+  last_window_.Reset(now_us);
+  has_previous_ = false;
+}
+
+void FrameTimingRecorder::Update(int64_t now_us) {
+  total_.end_us = now_us;
+  window_.end_us = now_us;
+  if (now_us - window_.start_us >=
+      static_cast<int64_t>(config_.window_ms) * 1000) {
+    last_window_ = window_;
+    window_.Reset(now_us);
+  }
+}
+
+}  // namespace kiosk_runner
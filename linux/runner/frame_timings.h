@@ -0,0 +1,92 @@
+#ifndef RUNNER_FRAME_TIMINGS_H_
+#define RUNNER_FRAME_TIMINGS_H_
+
+#include <cstdint>
+
+#include "latency_histogram.h"
+
+namespace kiosk_runner {
+
+struct FrameTimingConfig {
+  // Length of the rolling window reported next to the totals.
+  int window_ms = 60000;
+  // The frame clock stops while nothing animates, so a longer gap between
+  // frames is idle time rather than a stall and is not recorded.
+  int idle_gap_ms = 250;
+};
+
+// What GDK knows about one frame once its timings are complete. Times are
+// on the monotonic clock; 0 means unknown.
+struct FrameTimes {
+  int64_t frame_time_us = 0;
+  // When the frame reached the glass, reported by the compositor.
+  int64_t presentation_time_us = 0;
+  int64_t refresh_interval_us = 0;
+};
+
+struct FrameTimingSet {
+  // Between consecutive frames, on the glass when the compositor reports
+  // presentation times and on the frame clock otherwise.
+  LatencyHistogram interval;
+  // Frame clock work from before-paint to after-paint: update, layout,
+  // paint and handing the frame to the compositor.
+  LatencyHistogram paint;
+  // From the frame clock's frame time to presentation on the glass.
+  LatencyHistogram present_latency;
+
+  uint64_t frames = 0;
+  // Frames that came more than half a refresh interval late, and the
+  // vsyncs skipped before them.
+  uint64_t janky_frames = 0;
+  uint64_t missed_vsyncs = 0;
+  uint64_t idle_gaps = 0;
+  uint64_t presented_frames = 0;
+  int64_t start_us = 0;
+  int64_t end_us = 0;
+
+  void Reset(int64_t now_us);
+};
+
+// Turns frame clock callbacks into histograms of frame intervals, paint
+// times and presentation latency, for all time and for the last complete
+// window. Not thread-safe; the frame clock and the method channel both
+// run on the main thread.
+class FrameTimingRecorder {
+ public:
+  explicit FrameTimingRecorder(int64_t now_us);
+
+  // Disallow copy and assign.
+  FrameTimingRecorder(const FrameTimingRecorder&) = delete;
+  FrameTimingRecorder& operator=(const FrameTimingRecorder&) = delete;
+
+  void Configure(const FrameTimingConfig& config, int64_t now_us);
+  void RecordPaint(int64_t paint_us, int64_t now_us);
+  // Frames in order; call Discontinue() when some went unrecorded so no
+  // interval spans them.
+  void RecordFrame(const FrameTimes& frame, int64_t now_us);
+  void Discontinue() { has_previous_ = false; }
+  // Starts the totals and the window over.
+  void Reset(int64_t now_us);
+  // Closes the window if it is due; call before reading.
+  void Update(int64_t now_us);
+
+  const FrameTimingConfig& config() const { return config_; }
+  const FrameTimingSet& total() const { return total_; }
+  // The last complete window; empty until one has passed.
+  const FrameTimingSet& last_window() const { return last_window_; }
+  int64_t refresh_interval_us() const { return refresh_interval_us_; }
+
+ private:
+  FrameTimingConfig config_;
+  FrameTimingSet total_;
+  FrameTimingSet window_;
+  FrameTimingSet last_window_;
+  int64_t refresh_interval_us_ = 0;
+  // The frame before, for intervals.
+  bool has_previous_ = false;
+  FrameTimes previous_;
+};
+
+}  // namespace kiosk_runner
+
+#endif  // RUNNER_FRAME_TIMINGS_H_
@@ -0,0 +1,89 @@
+#include "latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace kiosk_runner {
+
+namespace {
+
+int HighestBit(uint64_t value) {
+  return 63 - __builtin_clzll(value);
+}
+
+}  // namespace
+
+LatencyHistogram::LatencyHistogram(int64_t max_us, int sub_bucket_bits)
+    : max_value_us_(std::max<int64_t>(max_us, 1)),
+      sub_bucket_bits_(std::max(sub_bucket_bits, 2)),
+      sub_bucket_count_(int64_t{1} << sub_bucket_bits_),
+      half_count_(sub_bucket_count_ / 2) {
+  counts_.resize(IndexOf(max_value_us_) + 1);
+}
+
+void LatencyHistogram::Record(int64_t value_us) {
+  value_us = std::min(std::max<int64_t>(value_us, 0), max_value_us_);
+  counts_[IndexOf(value_us)]++;
+  if (count_ == 0 || value_us < min_us_) {
+    min_us_ = value_us;
+  }
+  max_us_ = std::max(max_us_, value_us);
+  count_++;
+  sum_us_ += static_cast<double>(value_us);
+}
+
+void LatencyHistogram::Reset() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  count_ = 0;
+  sum_us_ = 0;
+  min_us_ = 0;
+  max_us_ = 0;
+}
+
+double LatencyHistogram::mean_us() const {
+  return count_ > 0 ? sum_us_ / static_cast<double>(count_) : 0;
+}
+
+int64_t LatencyHistogram::ValueAtPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+  // At least one value, so percentile 0 is the minimum.
+  const uint64_t rank = std::max<uint64_t>(
+      1, static_cast<uint64_t>(
+             std::ceil(percentile / 100.0 * static_cast<double>(count_))));
+  uint64_t seen = 0;
+  for (size_t index = 0; index < counts_.size(); ++index) {
+    seen += counts_[index];
+    if (seen >= rank) {
+      return std::min(HighestEquivalent(index), max_us_);
+    }
+  }
+  return max_us_;
+}
+
+size_t LatencyHistogram::IndexOf(int64_t value_us) const {
+  if (value_us < sub_bucket_count_) {
+    return static_cast<size_t>(value_us);
+  }
+  // Shifted so the top |sub_bucket_bits_| bits remain: [half, count).
+  const int shift =
+      HighestBit(static_cast<uint64_t>(value_us)) - sub_bucket_bits_ + 1;
+  const int64_t top = value_us >> shift;
+  return static_cast<size_t>(sub_bucket_count_ + (shift - 1) * half_count_ +
+                             (top - half_count_));
+}
+
+int64_t LatencyHistogram::HighestEquivalent(size_t index) const {
+  const int64_t i = static_cast<int64_t>(index);
+  if (i < sub_bucket_count_) {
+    return i;
+  }
+  const int64_t offset = i - sub_bucket_count_;
+  const int shift = static_cast<int>(offset / half_count_) + 1;
+  const int64_t top = offset % half_count_ + half_count_;
+  return ((top + 1) << shift) - 1;
+}
+
+}  // namespace kiosk_runner
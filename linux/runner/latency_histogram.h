@@ -0,0 +1,50 @@
+#ifndef RUNNER_LATENCY_HISTOGRAM_H_
+#define RUNNER_LATENCY_HISTOGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kiosk_runner {
+
+// HdrHistogram-style log-linear histogram of durations in microseconds.
+//
+// Values below 2^|sub_bucket_bits| get a bucket each; above that every
+// power of two is split into 2^(|sub_bucket_bits| - 1) equal buckets, so
+// any recorded value is known to within 1 / 2^(|sub_bucket_bits| - 1) of
+// itself (under 2% with the default) at any magnitude, in fixed memory
+// and with O(1) recording. Values above |max_us| are clamped to it.
+class LatencyHistogram {
+ public:
+  explicit LatencyHistogram(int64_t max_us = 60 * 1000000,
+                            int sub_bucket_bits = 7);
+
+  void Record(int64_t value_us);
+  void Reset();
+
+  uint64_t count() const { return count_; }
+  int64_t min_us() const { return count_ > 0 ? min_us_ : 0; }
+  int64_t max_us() const { return max_us_; }
+  double mean_us() const;
+  // Highest value equivalent to the one at |percentile| (0 to 100), as
+  // HdrHistogram reports it; 0 when empty.
+  int64_t ValueAtPercentile(double percentile) const;
+
+ private:
+  size_t IndexOf(int64_t value_us) const;
+  int64_t HighestEquivalent(size_t index) const;
+
+  int64_t max_value_us_;
+  int sub_bucket_bits_;
+  int64_t sub_bucket_count_;
+  int64_t half_count_;
+  std::vector<uint64_t> counts_;
+  uint64_t count_ = 0;
+  double sum_us_ = 0;
+  int64_t min_us_ = 0;
+  int64_t max_us_ = 0;
+};
+
+}  // namespace kiosk_runner
+
+#endif  // RUNNER_LATENCY_HISTOGRAM_H_
@@ -7,10 +7,12 @@
 
 #include "flutter/generated_plugin_registrant.h"
 #include "custom_plugin_registrant.h"
+#include "frame_clock_monitor.h"
 
 struct _MyApplication {
   GtkApplication parent_instance;
   char** dart_entrypoint_arguments;
+  kiosk_runner::FrameClockMonitor* frame_clock_monitor;
 };
 
 G_DEFINE_TYPE(MyApplication, my_application, GTK_TYPE_APPLICATION)
@@ -61,6 +63,16 @@ static void my_application_activate(GApplication* application) {
   fl_register_plugins(FL_PLUGIN_REGISTRY(view));
   register_custom_plugins(FL_PLUGIN_REGISTRY(view));
 
+  // Frame intervals, paint times and missed vsyncs as the window's frame
+  // clock sees them; the window is realized by now.
+  g_autoptr(FlPluginRegistrar) frame_timing_registrar =
+      fl_plugin_registry_get_registrar_for_plugin(FL_PLUGIN_REGISTRY(view),
+                                                  "FrameClockMonitor");
+  delete self->frame_clock_monitor;
+  self->frame_clock_monitor = new kiosk_runner::FrameClockMonitor(
+      GTK_WIDGET(window),
+      fl_plugin_registrar_get_messenger(frame_timing_registrar));
+
   gtk_widget_grab_focus(GTK_WIDGET(view));
 }
 
@@ -105,6 +117,8 @@ static void my_application_shutdown(GApplication* application) {
 static void my_application_dispose(GObject* object) {
   MyApplication* self = MY_APPLICATION(object);
   g_clear_pointer(&self->dart_entrypoint_arguments, g_strfreev);
+  delete self->frame_clock_monitor;
+  self->frame_clock_monitor = nullptr;
   G_OBJECT_CLASS(my_application_parent_class)->dispose(object);
 }
 
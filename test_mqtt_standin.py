@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+"""
+MQTT Stand-in Broker
+Small local stand-in for mosquitto, for testing the kiosk's native MQTT
+transport without a broker install. Speaks MQTT 3.1.1 and 5 (QoS 0/1,
+retained messages, wildcards, last will) and reports how many publishes
+arrived per socket read, which shows the client's write batching.
+
+Options:
+  --command JSON   publish JSON to kingkiosk/<client>/command once a
+                   client subscribes to it
+  --stall-ms N     stop reading from clients for N ms after they connect,
+                   to exercise the client's backpressure and drop policy
+
+Usage: python3 test_mqtt_standin.py [--port 1883] [--command '{"command": "notify"}']
+"""
+
+import argparse
+import asyncio
+import time
+
+
+def encode_varint(value):
+    out = bytearray()
+    while True:
+        byte = value % 128
+        value //= 128
+        if value:
+            byte |= 0x80
+        out.append(byte)
+        if not value:
+            return bytes(out)
+
+
+def encode_string(value):
+    data = value.encode() if isinstance(value, str) else value
+    return len(data).to_bytes(2, "big") + data
+
+
+def packet(header, body=b""):
+    return bytes([header]) + encode_varint(len(body)) + body
+
+
+def decode_varint(data, offset):
+    value, shift = 0, 0
+    while True:
+        byte = data[offset]
+        offset += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, offset
+        shift += 7
+
+
+def read_string(data, offset):
+    length = int.from_bytes(data[offset:offset + 2], "big")
+    return data[offset + 2:offset + 2 + length], offset + 2 + length
+
+
+def topic_matches(topic_filter, topic):
+    if topic.startswith("$") and topic_filter[:1] in ("+", "#"):
+        return False
+    filter_levels = topic_filter.split("/")
+    topic_levels = topic.split("/")
+    for i, level in enumerate(filter_levels):
+        if level == "#":
+            return True
+        if i >= len(topic_levels):
+            return False
+        if level != "+" and level != topic_levels[i]:
+            return False
+    return len(filter_levels) == len(topic_levels)
+
+
+class Broker:
+    def __init__(self, args):
+        self.args = args
+        self.clients = {}
+        self.retained = {}
+
+    def publish(self, topic, payload, retain):
+        if retain:
+            if payload:
+                self.retained[topic] = payload
+            else:
+                self.retained.pop(topic, None)
+        for client in list(self.clients.values()):
+            for topic_filter, qos in client.subscriptions.items():
+                if topic_matches(topic_filter, topic):
+                    client.send_publish(topic, payload, qos, False)
+                    break
+
+
+class Session:
+    def __init__(self, broker, reader, writer):
+        self.broker = broker
+        self.reader = reader
+        self.writer = writer
+        self.version = 4
+        self.client_id = "?"
+        self.subscriptions = {}
+        self.will = None
+        self.next_id = 1
+        self.reads = 0
+        self.publishes = 0
+        self.bytes = 0
+        self.started = time.monotonic()
+        self.command_sent = False
+        self.graceful = False
+
+    def properties(self):
+        return b"\x00" if self.version == 5 else b""
+
+    def send(self, data):
+        self.writer.write(data)
+
+    def send_publish(self, topic, payload, qos, retain):
+        header = 0x30 | (qos << 1) | (1 if retain else 0)
+        body = encode_string(topic)
+        if qos:
+            body += self.next_id.to_bytes(2, "big")
+            self.next_id = self.next_id % 65535 + 1
+        self.send(packet(header, body + self.properties() + payload))
+
+    async def run(self):
+        buffer = b""
+        try:
+            while True:
+                data = await self.reader.read(65536)
+                if not data:
+                    break
+                self.reads += 1
+                self.bytes += len(data)
+                buffer += data
+                in_read = 0
+                open_session = True
+                while open_session and len(buffer) >= 2:
+                    try:
+                        length, offset = decode_varint(buffer, 1)
+                    except IndexError:
+                        break
+                    if len(buffer) < offset + length:
+                        break
+                    header = buffer[0]
+                    body = buffer[offset:offset + length]
+                    buffer = buffer[offset + length:]
+                    if header >> 4 == 3:
+                        in_read += 1
+                        self.publishes += 1
+                    open_session = await self.handle(header, body)
+                if in_read:
+                    print(f"  {self.client_id}: {in_read} publish(es) "
+                          f"in one read of {len(data)} bytes")
+                if not open_session:
+                    return
+                await self.writer.drain()
+        except (ConnectionError, asyncio.IncompleteReadError):
+            pass
+        finally:
+            self.close(graceful=self.graceful)
+
+    def close(self, graceful):
+        if self.broker.clients.get(self.client_id) is self:
+            del self.broker.clients[self.client_id]
+            elapsed = time.monotonic() - self.started
+            print(f"- {self.client_id} gone after {elapsed:.1f}s: "
+                  f"{self.publishes} publishes in {self.reads} reads "
+                  f"({self.bytes} bytes)")
+            if self.will and not graceful:
+                print(f"  sending last will to {self.will[0]}")
+                self.broker.publish(*self.will)
+        self.writer.close()
+
+    async def handle(self, header, body):
+        kind = header >> 4
+        if kind == 1:
+            _, offset = read_string(body, 0)
+            self.version = body[offset]
+            flags = body[offset + 1]
+            keep_alive = int.from_bytes(body[offset + 2:offset + 4], "big")
+            offset += 4
+            if self.version == 5:
+                length, offset = decode_varint(body, offset)
+                offset += length
+            client_id, offset = read_string(body, offset)
+            self.client_id = client_id.decode() or "anonymous"
+            if flags & 0x04:
+                if self.version == 5:
+                    length, offset = decode_varint(body, offset)
+                    offset += length
+                will_topic, offset = read_string(body, offset)
+                will_payload, offset = read_string(body, offset)
+                self.will = (will_topic.decode(), will_payload,
+                             bool(flags & 0x20))
+            previous = self.broker.clients.get(self.client_id)
+            if previous:
+                previous.close(graceful=False)
+            self.broker.clients[self.client_id] = self
+            print(f"+ {self.client_id} connected (MQTT "
+                  f"{'5' if self.version == 5 else '3.1.1'}, "
+                  f"keepalive {keep_alive}s)")
+            self.send(packet(0x20, b"\x00\x00" + self.properties()))
+            if self.broker.args.stall_ms:
+                print(f"  not reading for {self.broker.args.stall_ms} ms")
+                await self.writer.drain()
+                await asyncio.sleep(self.broker.args.stall_ms / 1000)
+        elif kind == 3:
+            qos = (header >> 1) & 0x03
+            topic, offset = read_string(body, 0)
+            if qos:
+                packet_id = body[offset:offset + 2]
+                offset += 2
+                self.send(packet(0x40, packet_id))
+            if self.version == 5:
+                length, offset = decode_varint(body, offset)
+                offset += length
+            payload = body[offset:]
+            self.broker.publish(topic.decode(), payload, bool(header & 0x01))
+        elif kind == 8:
+            packet_id = body[:2]
+            offset = 2
+            if self.version == 5:
+                length, offset = decode_varint(body, offset)
+                offset += length
+            granted = bytearray()
+            while offset < len(body):
+                topic_filter, offset = read_string(body, offset)
+                qos = min(body[offset] & 0x03, 1)
+                offset += 1
+                self.subscriptions[topic_filter.decode()] = qos
+                granted.append(qos)
+                print(f"  {self.client_id} subscribed to "
+                      f"{topic_filter.decode()}")
+                for topic, payload in self.broker.retained.items():
+                    if topic_matches(topic_filter.decode(), topic):
+                        self.send_publish(topic, payload, qos, True)
+            self.send(packet(0x90, packet_id + self.properties() + granted))
+            self.maybe_send_command()
+        elif kind == 10:
+            offset = 2
+            if self.version == 5:
+                length, offset = decode_varint(body, offset)
+                offset += length
+            while offset < len(body):
+                topic_filter, offset = read_string(body, offset)
+                self.subscriptions.pop(topic_filter.decode(), None)
+            self.send(packet(0xB0, body[:2] + (b"\x00" if self.version == 5
+                                              else b"")))
+        elif kind == 12:
+            self.send(packet(0xD0))
+        elif kind == 14:
+            print(f"  {self.client_id} sent DISCONNECT")
+            self.graceful = True
+            return False
+        return True
+
+    def maybe_send_command(self):
+        command = self.broker.args.command
+        topic = f"kingkiosk/{self.client_id.split('_')[0]}/command"
+        if (command and not self.command_sent and
+                any(topic_matches(f, topic) for f in self.subscriptions)):
+            self.command_sent = True
+            print(f"  sending command to {topic}")
+            self.send_publish(topic, command.encode(), 0, False)
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--command")
+    parser.add_argument("--stall-ms", type=int, default=0)
+    args = parser.parse_args()
+    broker = Broker(args)
+    server = await asyncio.start_server(
+        lambda r, w: Session(broker, r, w).run(), args.host, args.port)
+    print(f"MQTT stand-in listening on {args.host}:{args.port}")
+    async with server:
+        await server.serve_forever()
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass
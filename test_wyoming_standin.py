@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+"""
+Wyoming Stand-in Server
+Local stand-in for a Wyoming speech pipeline, for testing the kiosk's native
+Wyoming client without Home Assistant, faster-whisper or piper.
+
+Every utterance the kiosk streams gets a transcript describing what arrived
+and, for run-pipeline requests ending in tts, a short spoken-tone reply.
+Point the kiosk at it with the wyoming_host / wyoming_port settings.
+
+Usage: python3 test_wyoming_standin.py [--port 10700] [--delay-ms 150]
+"""
+
+import argparse
+import asyncio
+import json
+import math
+import struct
+import time
+
+TTS_RATE = 22050
+TTS_CHUNK_SAMPLES = 1024
+
+
+def encode_event(event_type, data=None, payload=b""):
+    header = {"type": event_type, "version": "1.5.2"}
+    data_bytes = json.dumps(data).encode() if data else b""
+    if data_bytes:
+        header["data_length"] = len(data_bytes)
+    if payload:
+        header["payload_length"] = len(payload)
+    return json.dumps(header).encode() + b"\n" + data_bytes + payload
+
+
+async def read_event(reader):
+    line = await reader.readline()
+    if not line:
+        return None
+    header = json.loads(line)
+    data = header.get("data") or {}
+    if header.get("data_length"):
+        data.update(json.loads(await reader.readexactly(header["data_length"])))
+    payload = b""
+    if header.get("payload_length"):
+        payload = await reader.readexactly(header["payload_length"])
+    return header["type"], data, payload
+
+
+def reply_tone(seconds=0.6):
+    """A falling two-tone chime, as 16-bit mono PCM"""
+    samples = []
+    for i in range(int(TTS_RATE * seconds)):
+        t = i / TTS_RATE
+        freq = 880 if t < seconds / 2 else 660
+        fade = min(1.0, (seconds - t) * 20)
+        samples.append(int(8000 * fade * math.sin(2 * math.pi * freq * t)))
+    return struct.pack(f"<{len(samples)}h", *samples)
+
+
+async def handle(reader, writer, args):
+    peer = writer.get_extra_info("peername")
+    print(f"🔌 Kiosk connected from {peer}")
+    wants_tts = False
+    audio_bytes = 0
+    rate = 16000
+    chunks = 0
+    try:
+        while True:
+            event = await read_event(reader)
+            if event is None:
+                break
+            event_type, data, payload = event
+            if event_type == "describe":
+                writer.write(encode_event("info", {"asr": [], "tts": []}))
+            elif event_type == "run-pipeline":
+                wants_tts = data.get("end_stage") == "tts"
+                print(f"▶️  run-pipeline {data}")
+            elif event_type == "transcribe":
+                wants_tts = False
+                print(f"▶️  transcribe {data}")
+            elif event_type == "audio-start":
+                audio_bytes = 0
+                chunks = 0
+                rate = data.get("rate", rate)
+            elif event_type == "audio-chunk":
+                audio_bytes += len(payload)
+                chunks += 1
+            elif event_type == "audio-stop":
+                stopped = time.monotonic()
+                seconds = audio_bytes / 2 / rate
+                print(f"⏹️  {chunks} chunks, {seconds:.2f} s of speech")
+                await asyncio.sleep(args.delay_ms / 1000)
+                text = f"Heard {seconds:.1f} seconds of speech"
+                writer.write(encode_event("transcript", {"text": text}))
+                if wants_tts:
+                    fmt = {"rate": TTS_RATE, "width": 2, "channels": 1}
+                    writer.write(encode_event("audio-start", fmt))
+                    pcm = reply_tone()
+                    step = TTS_CHUNK_SAMPLES * 2
+                    for offset in range(0, len(pcm), step):
+                        writer.write(encode_event(
+                            "audio-chunk", fmt, pcm[offset:offset + step]))
+                    writer.write(encode_event("audio-stop", {}))
+                await writer.drain()
+                elapsed = (time.monotonic() - stopped) * 1000
+                print(f"💬 Replied in {elapsed:.0f} ms: {text}")
+            elif event_type == "ping":
+                writer.write(encode_event("pong", data))
+            await writer.drain()
+    except (ConnectionError, asyncio.IncompleteReadError) as e:
+        print(f"⚠️ Connection error: {e}")
+    finally:
+        print(f"🔌 Kiosk {peer} disconnected")
+        writer.close()
+
+
+async def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[1])
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=10700)
+    parser.add_argument("--delay-ms", type=int, default=150,
+                        help="simulated processing time per utterance")
+    args = parser.parse_args()
+    server = await asyncio.start_server(
+        lambda r, w: handle(r, w, args), args.host, args.port)
+    print(f"🎙️ Wyoming stand-in listening on {args.host}:{args.port}")
+    async with server:
+        await server.serve_forever()
+
+
+if __name__ == "__main__":
+    try:
+        asyncio.run(main())
+    except KeyboardInterrupt:
+        pass